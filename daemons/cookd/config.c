@@ -73,9 +73,14 @@ static json_t* __serialize_config_address(struct config_address* address)
     return root;
 }
 
+// the number of project workspaces kept around for incremental
+// builds, when not configured
+#define __DEFAULT_WORKSPACE_LIMIT 8
+
 struct config {
     struct config_address api_address;
     struct config_address cvd_address;
+    unsigned int          workspace_limit;
 };
 
 static struct config g_config = { 0 };
@@ -109,6 +114,7 @@ static json_t* __serialize_config(struct config* config)
     
     json_object_set_new(root, "api-address", api_address);
     json_object_set_new(root, "cvd-address", cvd_address);
+    json_object_set_new(root, "workspace-limit", json_integer((long long)config->workspace_limit));
     return root;
 }
 
@@ -150,6 +156,11 @@ static int __parse_config(struct config* config, json_t* root)
             return status;
         }
     }
+
+    member = json_object_get(root, "workspace-limit");
+    if (member != NULL) {
+        config->workspace_limit = (unsigned int)json_integer_value(member);
+    }
     return 0;
 }
 
@@ -166,6 +177,7 @@ static int __initialize_config(struct config* config)
     config->api_address.address = platform_strdup("127.0.0.1");
     config->api_address.port = 51002;
 #endif
+    config->workspace_limit = __DEFAULT_WORKSPACE_LIMIT;
     return 0;
 }
 
@@ -229,3 +241,11 @@ void cookd_config_cvd_address(struct cookd_config_address* address)
     address->address = g_config.cvd_address.address;
     address->port = g_config.cvd_address.port;
 }
+
+unsigned int cookd_config_workspace_limit(void)
+{
+    if (g_config.workspace_limit == 0) {
+        return __DEFAULT_WORKSPACE_LIMIT;
+    }
+    return g_config.workspace_limit;
+}
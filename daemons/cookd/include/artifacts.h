@@ -0,0 +1,62 @@
+/**
+ * Copyright, Philip Meulengracht
+ *
+ * This program is free software : you can redistribute it and / or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation ? , either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ * 
+ */
+
+#ifndef __COOKD_ARTIFACTS_H__
+#define __COOKD_ARTIFACTS_H__
+
+#include <gracht/client.h>
+#include <notify.h>
+
+enum cookd_artifact_status {
+    COOKD_ARTIFACT_STATUS_STORED,
+    COOKD_ARTIFACT_STATUS_UPLOAD,
+    COOKD_ARTIFACT_STATUS_FAILED
+};
+
+struct cookd_artifact {
+    enum cookd_notify_artifact_type type;
+    const char*                     path;
+};
+
+/**
+ * @brief Initializes the bookkeeping for artifact uploads
+ */
+extern int cookd_artifacts_init(void);
+
+/**
+ * @brief Cleans up the bookkeeping for artifact uploads
+ */
+extern void cookd_artifacts_cleanup(void);
+
+/**
+ * @brief Uploads the artifacts of a build to waiterd over the existing connection.
+ * All artifacts are offered by the digest of their content first, and only content
+ * that waiterd does not already hold is streamed. Blocks until waiterd reported
+ * the outcome for every artifact.
+ *
+ * @return 0 if all artifacts were stored, -1 otherwise
+ */
+extern int cookd_artifacts_upload(gracht_client_t* client, const char* id, struct cookd_artifact* artifacts, int count);
+
+/**
+ * @brief Called when waiterd reports the status of an artifact offered by
+ * cookd_artifacts_upload
+ */
+extern void cookd_artifacts_status(const char* id, enum cookd_notify_artifact_type type, enum cookd_artifact_status status);
+
+#endif //!__COOKD_ARTIFACTS_H__
@@ -20,6 +20,8 @@
 #define __COOKD_NOTIFY_H__
 
 #include <gracht/client.h>
+#include <stddef.h>
+#include <stdint.h>
 
 enum cookd_notify_build_status {
     COOKD_BUILD_STATUS_QUEUED,
@@ -41,8 +43,13 @@ enum cookd_notify_artifact_type {
 };
 
 /**
- * @brief
+ * @brief Offers an artifact of a build to waiterd by the digest of its content
+ */
+extern int cookd_notify_artifact_offer(gracht_client_t* client, const char* id, enum cookd_notify_artifact_type type, const char* name, const char* digest, uint64_t size);
+
+/**
+ * @brief Sends a chunk of an artifact that waiterd asked to have uploaded
  */
-extern int cookd_notify_artifact_ready(gracht_client_t* client, const char* id, enum cookd_notify_artifact_type type, const char* uri);
+extern int cookd_notify_artifact_chunk(gracht_client_t* client, const char* digest, uint64_t offset, const void* data, size_t length);
 
 #endif //!__COOKD_NOTIFY_H__
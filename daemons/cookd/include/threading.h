@@ -51,6 +51,7 @@ typedef pthread_t thrd_t;
 #define cnd_init(cnd) pthread_cond_init(cnd, NULL)
 #define cnd_destroy   pthread_cond_destroy
 #define cnd_wait      pthread_cond_wait
+#define cnd_timedwait pthread_cond_timedwait
 #define cnd_signal    pthread_cond_signal
 #define cnd_broadcast pthread_cond_broadcast
 
@@ -59,6 +60,7 @@ typedef pthread_t thrd_t;
 
 #elif defined(_WIN32)
 #include <windows.h>
+#include <time.h>
 
 typedef CRITICAL_SECTION mtx_t;
 typedef CONDITION_VARIABLE cnd_t;
@@ -118,6 +120,18 @@ static inline int cnd_wait(cnd_t* cnd, mtx_t* mtx)
     return status == TRUE ? thrd_success : thrd_error;
 }
 
+static inline int cnd_timedwait(cnd_t* cnd, mtx_t* mtx, const struct timespec* deadline)
+{
+    struct timespec now;
+    long long       remaining;
+    BOOL            status;
+
+    timespec_get(&now, TIME_UTC);
+    remaining = (deadline->tv_sec - now.tv_sec) * 1000LL + (deadline->tv_nsec - now.tv_nsec) / 1000000LL;
+    status = SleepConditionVariableCS(cnd, mtx, remaining > 0 ? (DWORD)remaining : 0);
+    return status == TRUE ? thrd_success : thrd_error;
+}
+
 static inline int thrd_create(thrd_t* thrp, int (*start)(void*), void* arg) {
     thrd_t thr = CreateThread(NULL, 0, (LPTHREAD_START_ROUTINE)start, arg, 0, NULL);
     if (thr == NULL) {
@@ -0,0 +1,86 @@
+/**
+ * Copyright, Philip Meulengracht
+ *
+ * This program is free software : you can redistribute it and / or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation ? , either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ * 
+ */
+
+#ifndef __COOKD_WORKSPACE_H__
+#define __COOKD_WORKSPACE_H__
+
+struct cookd_workspace;
+
+struct cookd_workspace_sync_stats {
+    unsigned int added;
+    unsigned int modified;
+    unsigned int removed;
+    unsigned int unchanged;
+};
+
+/**
+ * @brief Initializes the workspace cache in the given root directory. Workspaces are
+ * persistent per project/platform/architecture, and the least recently used ones are
+ * evicted when there are more than <limit> of them.
+ */
+extern int cookd_workspaces_initialize(const char* root, unsigned int limit);
+
+/**
+ * @brief
+ */
+extern void cookd_workspaces_cleanup(void);
+
+/**
+ * @brief Acquires the workspace for the project, creating it if it does not exist. A workspace
+ * can only be used by one build at the time, if it is busy this returns NULL with errno set to EBUSY.
+ */
+extern struct cookd_workspace* cookd_workspace_acquire(const char* project, const char* platform, const char* architecture);
+
+/**
+ * @brief Releases a workspace acquired by cookd_workspace_acquire. The rootfs uuid is the build cache
+ * uuid used for the build, it is recorded so the rootfs can be removed together with the workspace.
+ */
+extern void cookd_workspace_release(struct cookd_workspace* workspace, const char* rootfsUuid);
+
+/**
+ * @brief Returns the root directory of the workspace, which is where the build cache is kept.
+ */
+extern const char* cookd_workspace_path(struct cookd_workspace* workspace);
+
+/**
+ * @brief Returns the directory of the workspace that holds the project sources.
+ */
+extern const char* cookd_workspace_sources(struct cookd_workspace* workspace);
+
+/**
+ * @brief Synchronizes the workspace sources with the sources in the staging directory. Files are
+ * compared by content hash, and only files that were added or changed are written, so unchanged files
+ * keep their timestamps and incremental builds only rebuild what changed. Files that were removed from
+ * the sources since the last sync are deleted, other files in the workspace (build artifacts) are left alone.
+ *
+ * @param[In]  workspace      The workspace to synchronize.
+ * @param[In]  stagingPath    The directory holding the freshly unpacked sources.
+ * @param[In]  recipePath     The recipe path relative to the sources, included in the fingerprint.
+ * @param[Out] stats          Optional, receives the number of files per kind of change.
+ * @param[Out] fingerprintOut The configuration fingerprint of the sources, which changes when files are
+ *                            added, removed or the recipe changes. Must be freed by the caller.
+ * @return int 0 on success, -1 on failure with errno set.
+ */
+extern int cookd_workspace_sync(
+    struct cookd_workspace*            workspace,
+    const char*                        stagingPath,
+    const char*                        recipePath,
+    struct cookd_workspace_sync_stats* stats,
+    char**                             fingerprintOut);
+
+#endif //!__COOKD_WORKSPACE_H__
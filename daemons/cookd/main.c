@@ -88,6 +88,9 @@ int main(int argc, char** argv)
     vlog_add_output(debuglog, 1);
     vlog_set_output_level(debuglog, VLOG_LEVEL_DEBUG);
 
+    // the daemon logs from multiple threads, keep them off the log I/O
+    vlog_set_async(1);
+
     // initialize the client
     status = cookd_initialize_client(&client);
     if (status) {
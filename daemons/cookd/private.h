@@ -47,6 +47,12 @@ extern void cookd_config_api_address(struct cookd_config_address* address);
  */
 extern void cookd_config_cvd_address(struct cookd_config_address* address);
 
+/**
+ * @brief Returns the maximum number of project workspaces that are kept for
+ * incremental builds before the least recently used ones are evicted.
+ */
+extern unsigned int cookd_config_workspace_limit(void);
+
 /**
  * @brief
  */
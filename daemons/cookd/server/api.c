@@ -16,6 +16,7 @@
  * 
  */
 
+#include <artifacts.h>
 #include <chef/platform.h>
 #include "chef_waiterd_cook_service_client.h"
 #include <server.h>
@@ -83,3 +84,27 @@ void chef_waiterd_cook_event_build_request_invocation(gracht_client_t* client, c
         VLOG_ERROR("api", "failed to update the waiterd daemon for build id %s\n", id);
     }
 }
+
+void chef_waiterd_cook_event_artifact_status_invocation(gracht_client_t* client, const struct chef_cook_artifact_status* status)
+{
+    enum cookd_notify_artifact_type type = COOKD_ARTIFACT_TYPE_LOG;
+    enum cookd_artifact_status      result = COOKD_ARTIFACT_STATUS_FAILED;
+    VLOG_DEBUG("api", "chef_waiterd_cook_event_artifact_status_invocation(id=%s, status=%u)\n", status->id, status->status);
+
+    if (status->type == CHEF_ARTIFACT_TYPE_PACKAGE) {
+        type = COOKD_ARTIFACT_TYPE_PACKAGE;
+    }
+
+    switch (status->status) {
+        case CHEF_ARTIFACT_UPLOAD_STATUS_STORED:
+            result = COOKD_ARTIFACT_STATUS_STORED;
+            break;
+        case CHEF_ARTIFACT_UPLOAD_STATUS_UPLOAD:
+            result = COOKD_ARTIFACT_STATUS_UPLOAD;
+            break;
+        case CHEF_ARTIFACT_UPLOAD_STATUS_FAILED:
+            result = COOKD_ARTIFACT_STATUS_FAILED;
+            break;
+    }
+    cookd_artifacts_status(status->id, type, result);
+}
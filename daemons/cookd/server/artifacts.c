@@ -0,0 +1,278 @@
+/**
+ * Copyright, Philip Meulengracht
+ *
+ * This program is free software : you can redistribute it and / or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation ? , either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ * 
+ */
+
+#include <artifacts.h>
+#include <chef/list.h>
+#include <chef/platform.h>
+#include <errno.h>
+#include <openssl/evp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <threading.h>
+#include <time.h>
+#include <vlog.h>
+
+// Chunks must fit in a single gracht message together with the digest and offset
+#define __CHUNK_SIZE       (3 * 1024)
+#define __DIGEST_LENGTH    64
+#define __STATUS_TIMEOUT_S 60
+
+struct __artifact_wait {
+    struct list_item                list_header;
+    const char*                     id;
+    enum cookd_notify_artifact_type type;
+    int                             has_status;
+    enum cookd_artifact_status      status;
+};
+
+struct __artifact_upload {
+    struct cookd_artifact* artifact;
+    char                   digest[__DIGEST_LENGTH + 1];
+    uint64_t               size;
+    int                    offered;
+    struct __artifact_wait wait;
+};
+
+static struct {
+    mtx_t       lock;
+    cnd_t       signal;
+    struct list waits; // list<__artifact_wait>
+} g_artifacts;
+
+int cookd_artifacts_init(void)
+{
+    mtx_init(&g_artifacts.lock, mtx_plain);
+    cnd_init(&g_artifacts.signal);
+    list_init(&g_artifacts.waits);
+    return 0;
+}
+
+void cookd_artifacts_cleanup(void)
+{
+    mtx_destroy(&g_artifacts.lock);
+    cnd_destroy(&g_artifacts.signal);
+}
+
+void cookd_artifacts_status(const char* id, enum cookd_notify_artifact_type type, enum cookd_artifact_status status)
+{
+    struct list_item* i;
+
+    mtx_lock(&g_artifacts.lock);
+    list_foreach(&g_artifacts.waits, i) {
+        struct __artifact_wait* wait = (struct __artifact_wait*)i;
+        if (wait->type == type && strcmp(wait->id, id) == 0) {
+            wait->status = status;
+            wait->has_status = 1;
+            break;
+        }
+    }
+    cnd_broadcast(&g_artifacts.signal);
+    mtx_unlock(&g_artifacts.lock);
+}
+
+static int __hash_file(const char* path, char* hex, uint64_t* sizeOut)
+{
+    unsigned char digest[EVP_MAX_MD_SIZE];
+    unsigned int  digestLength;
+    char          buffer[64 * 1024];
+    EVP_MD_CTX*   ctx;
+    FILE*         file;
+    size_t        read;
+    uint64_t      size = 0;
+    int           status = -1;
+
+    file = fopen(path, "rb");
+    if (file == NULL) {
+        return -1;
+    }
+
+    ctx = EVP_MD_CTX_new();
+    if (ctx == NULL || EVP_DigestInit_ex(ctx, EVP_sha256(), NULL) != 1) {
+        goto cleanup;
+    }
+
+    while ((read = fread(&buffer[0], 1, sizeof(buffer), file)) > 0) {
+        if (EVP_DigestUpdate(ctx, &buffer[0], read) != 1) {
+            goto cleanup;
+        }
+        size += read;
+    }
+    if (ferror(file) || EVP_DigestFinal_ex(ctx, &digest[0], &digestLength) != 1) {
+        goto cleanup;
+    }
+
+    for (unsigned int i = 0; i < digestLength; i++) {
+        snprintf(&hex[i * 2], 3, "%02x", digest[i]);
+    }
+    *sizeOut = size;
+    status = 0;
+
+cleanup:
+    EVP_MD_CTX_free(ctx);
+    fclose(file);
+    return status;
+}
+
+// Streams the first size bytes of the file, which is what the digest was
+// computed over. Logs may keep growing while they are uploaded.
+static int __stream_file(gracht_client_t* client, const char* path, const char* digest, uint64_t size)
+{
+    char     buffer[__CHUNK_SIZE];
+    FILE*    file;
+    uint64_t offset = 0;
+    int      status = 0;
+
+    file = fopen(path, "rb");
+    if (file == NULL) {
+        return -1;
+    }
+
+    while (offset < size) {
+        size_t length = size - offset < sizeof(buffer) ? (size_t)(size - offset) : sizeof(buffer);
+        if (fread(&buffer[0], 1, length, file) != length) {
+            status = -1;
+            break;
+        }
+
+        status = cookd_notify_artifact_chunk(client, digest, offset, &buffer[0], length);
+        if (status) {
+            break;
+        }
+        offset += length;
+    }
+
+    fclose(file);
+    return status;
+}
+
+static void __wait_register(struct __artifact_wait* wait)
+{
+    mtx_lock(&g_artifacts.lock);
+    wait->has_status = 0;
+    list_add(&g_artifacts.waits, &wait->list_header);
+    mtx_unlock(&g_artifacts.lock);
+}
+
+static void __wait_unregister(struct __artifact_wait* wait)
+{
+    mtx_lock(&g_artifacts.lock);
+    list_remove(&g_artifacts.waits, &wait->list_header);
+    mtx_unlock(&g_artifacts.lock);
+}
+
+static void __wait_reset(struct __artifact_wait* wait)
+{
+    mtx_lock(&g_artifacts.lock);
+    wait->has_status = 0;
+    mtx_unlock(&g_artifacts.lock);
+}
+
+static enum cookd_artifact_status __wait_status(struct __artifact_wait* wait)
+{
+    struct timespec            deadline;
+    enum cookd_artifact_status status;
+
+    timespec_get(&deadline, TIME_UTC);
+    deadline.tv_sec += __STATUS_TIMEOUT_S;
+
+    mtx_lock(&g_artifacts.lock);
+    while (!wait->has_status) {
+        if (cnd_timedwait(&g_artifacts.signal, &g_artifacts.lock, &deadline) != thrd_success && !wait->has_status) {
+            VLOG_ERROR("cookd", "timed out waiting for waiterd to store artifact\n");
+            mtx_unlock(&g_artifacts.lock);
+            return COOKD_ARTIFACT_STATUS_FAILED;
+        }
+    }
+    status = wait->status;
+    mtx_unlock(&g_artifacts.lock);
+    return status;
+}
+
+int cookd_artifacts_upload(gracht_client_t* client, const char* id, struct cookd_artifact* artifacts, int count)
+{
+    struct __artifact_upload* uploads;
+    int                       failed = 0;
+    int                       status;
+
+    uploads = calloc(count, sizeof(struct __artifact_upload));
+    if (uploads == NULL) {
+        return -1;
+    }
+
+    // offer everything up front, so waiterd can look up all of the digests
+    // while we wait for its replies
+    for (int i = 0; i < count; i++) {
+        struct __artifact_upload* upload = &uploads[i];
+        const char*               name;
+
+        upload->artifact = &artifacts[i];
+        upload->wait.id = id;
+        upload->wait.type = artifacts[i].type;
+
+        if (__hash_file(artifacts[i].path, &upload->digest[0], &upload->size)) {
+            VLOG_ERROR("cookd", "failed to hash artifact %s: %s\n", artifacts[i].path, strerror(errno));
+            failed++;
+            continue;
+        }
+
+        name = strrchr(artifacts[i].path, CHEF_PATH_SEPARATOR);
+        name = name != NULL ? name + 1 : artifacts[i].path;
+
+        __wait_register(&upload->wait);
+        status = cookd_notify_artifact_offer(client, id, artifacts[i].type, name, &upload->digest[0], upload->size);
+        if (status) {
+            VLOG_ERROR("cookd", "failed to offer artifact %s\n", artifacts[i].path);
+            __wait_unregister(&upload->wait);
+            failed++;
+            continue;
+        }
+        upload->offered = 1;
+    }
+
+    for (int i = 0; i < count; i++) {
+        struct __artifact_upload*  upload = &uploads[i];
+        enum cookd_artifact_status result;
+
+        if (!upload->offered) {
+            continue;
+        }
+
+        result = __wait_status(&upload->wait);
+        if (result == COOKD_ARTIFACT_STATUS_UPLOAD) {
+            VLOG_DEBUG("cookd", "uploading %s (%llu bytes)\n", upload->artifact->path, (unsigned long long)upload->size);
+            __wait_reset(&upload->wait);
+            if (__stream_file(client, upload->artifact->path, &upload->digest[0], upload->size)) {
+                VLOG_ERROR("cookd", "failed to upload artifact %s\n", upload->artifact->path);
+                result = COOKD_ARTIFACT_STATUS_FAILED;
+            } else {
+                result = __wait_status(&upload->wait);
+            }
+        } else if (result == COOKD_ARTIFACT_STATUS_STORED) {
+            VLOG_DEBUG("cookd", "artifact %s was already stored\n", upload->artifact->path);
+        }
+        __wait_unregister(&upload->wait);
+
+        if (result != COOKD_ARTIFACT_STATUS_STORED) {
+            failed++;
+        }
+    }
+
+    free(uploads);
+    return failed != 0 ? -1 : 0;
+}
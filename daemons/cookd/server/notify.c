@@ -52,11 +52,23 @@ enum chef_artifact_type __to_protocol_atype(enum cookd_notify_artifact_type ctyp
     return CHEF_ARTIFACT_TYPE_LOG;
 }
 
-int cookd_notify_artifact_ready(gracht_client_t* client, const char* id, enum cookd_notify_artifact_type type, const char* uri)
+int cookd_notify_artifact_offer(gracht_client_t* client, const char* id, enum cookd_notify_artifact_type type, const char* name, const char* digest, uint64_t size)
 {
     return chef_waiterd_cook_artifact(client, NULL, &(struct chef_cook_artifact_event) {
         .id = (char*)id,
         .type = __to_protocol_atype(type),
-        .uri = (char*)uri
+        .name = (char*)name,
+        .digest = (char*)digest,
+        .size = size
     });
-}
\ No newline at end of file
+}
+
+int cookd_notify_artifact_chunk(gracht_client_t* client, const char* digest, uint64_t offset, const void* data, size_t length)
+{
+    return chef_waiterd_cook_artifact_chunk(client, NULL, &(struct chef_cook_artifact_chunk) {
+        .digest = (char*)digest,
+        .offset = offset,
+        .data = (uint8_t*)data,
+        .data_count = (uint32_t)length
+    });
+}
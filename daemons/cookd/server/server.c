@@ -16,6 +16,7 @@
  * 
  */
 
+#include <artifacts.h>
 #include <chef/client.h>
 #include <chef/cvd.h>
 #include <chef/pack.h>
@@ -32,6 +33,7 @@
 #include <string.h>
 #include <threading.h>
 #include <vlog.h>
+#include <workspace.h>
 
 #include "../private.h"
 
@@ -271,7 +273,8 @@ static struct __cookd_server* g_server = NULL;
 
 int cookd_server_init(gracht_client_t* client, int builderCount)
 {
-    int status;
+    char* workspaces;
+    int   status;
     VLOG_DEBUG("cookd", "cookd_server_init(builders=%i)\n", builderCount);
 
     status = chefclient_initialize();
@@ -291,9 +294,29 @@ int cookd_server_init(gracht_client_t* client, int builderCount)
         return status;
     }
 
+    workspaces = strpathcombine(chef_dirs_cache(), "workspaces");
+    if (workspaces == NULL) {
+        store_cleanup();
+        chefclient_cleanup();
+        return -1;
+    }
+
+    status = cookd_workspaces_initialize(workspaces, cookd_config_workspace_limit());
+    free(workspaces);
+    if (status) {
+        VLOG_ERROR("cookd", "failed to initialize build workspaces\n");
+        store_cleanup();
+        chefclient_cleanup();
+        return status;
+    }
+
+    cookd_artifacts_init();
+
     g_server = __cookd_server_new(client);
     if (g_server == NULL) {
         VLOG_ERROR("cookd", "failed to allocate memory for server\n");
+        cookd_artifacts_cleanup();
+        cookd_workspaces_cleanup();
         store_cleanup();
         chefclient_cleanup();
         return -1;
@@ -303,6 +326,8 @@ int cookd_server_init(gracht_client_t* client, int builderCount)
     if (status) {
         VLOG_ERROR("cookd", "failed to start cookd server\n");
         __cookd_server_delete(g_server);
+        cookd_artifacts_cleanup();
+        cookd_workspaces_cleanup();
         store_cleanup();
         chefclient_cleanup();
         return status;
@@ -319,6 +344,8 @@ void cookd_server_cleanup(void)
 
     __cookd_server_stop(g_server);
     __cookd_server_delete(g_server);
+    cookd_artifacts_cleanup();
+    cookd_workspaces_cleanup();
     store_cleanup();
     chefclient_cleanup();
 }
@@ -515,6 +542,7 @@ static int __load_recipe(const char* projectPath, const char* recipePath, struct
 {
     struct recipe* recipe;
     char*          combined = NULL;
+    char*          recipes = NULL;
     void*          buffer = NULL;
     size_t         length;
     int            status;
@@ -533,7 +561,10 @@ static int __load_recipe(const char* projectPath, const char* recipePath, struct
         goto cleanup;
     }
 
-    status = recipe_parse(buffer, length, &recipe);
+    // compiled recipes are shared between all builds, as they are keyed
+    // by the recipe content and not by the project
+    recipes = strpathcombine(chef_dirs_cache(), "recipes");
+    status = recipe_load(recipes, buffer, length, &recipe);
     if (status) {
         VLOG_ERROR("cookd", "__load_recipe: failed to parse recipe %s\n", combined);
     }
@@ -541,11 +572,87 @@ static int __load_recipe(const char* projectPath, const char* recipePath, struct
     *recipeOut = recipe;
 
 cleanup:
+    free(recipes);
     free(combined);
     free(buffer);
     return status;
 }
 
+static void __invalidate_configuration(struct build_cache* cache, struct recipe* recipe)
+{
+    struct list_item* i;
+    struct list_item* j;
+
+    list_foreach(&recipe->parts, i) {
+        struct recipe_part* part = (struct recipe_part*)i;
+        list_foreach(&part->steps, j) {
+            struct recipe_step* step = (struct recipe_step*)j;
+            build_cache_mark_step_incomplete(cache, part->name, step->name);
+        }
+    }
+}
+
+// Moves the unpacked sources into the persistent workspace of the project, and opens
+// the build cache that lives in it. If the workspace is busy with another build of the
+// same project, this falls back to a full build in the per-build storage.
+static int __prepare_workspace(
+    const char*                 buildPath,
+    const char*                 stagingPath,
+    struct recipe*              recipe,
+    struct cookd_build_options* options,
+    struct cookd_workspace**    workspaceOut,
+    struct build_cache**        cacheOut)
+{
+    struct cookd_workspace_sync_stats stats;
+    struct cookd_workspace*           workspace;
+    struct build_cache*               cache;
+    const char*                       previous;
+    char*                             fingerprint;
+    int                               status;
+    VLOG_DEBUG("cookd", "__prepare_workspace(project=%s)\n", recipe->project.name);
+
+    workspace = cookd_workspace_acquire(recipe->project.name, options->platform, options->architecture);
+    if (workspace == NULL) {
+        VLOG_WARNING("cookd", "__prepare_workspace: no workspace available for %s (%s), doing a full build\n",
+            recipe->project.name, strerror(errno));
+        *workspaceOut = NULL;
+        return build_cache_create(recipe, buildPath, cacheOut);
+    }
+
+    status = cookd_workspace_sync(workspace, stagingPath, options->recipe_path, &stats, &fingerprint);
+    if (status) {
+        VLOG_ERROR("cookd", "__prepare_workspace: failed to synchronize sources for %s\n", recipe->project.name);
+        cookd_workspace_release(workspace, NULL);
+        return status;
+    }
+    VLOG_TRACE("cookd", "sources: %u added, %u modified, %u removed, %u unchanged\n",
+        stats.added, stats.modified, stats.removed, stats.unchanged);
+
+    status = build_cache_create(recipe, cookd_workspace_path(workspace), &cache);
+    if (status) {
+        VLOG_ERROR("cookd", "__prepare_workspace: failed to initialize build cache\n");
+        cookd_workspace_release(workspace, NULL);
+        free(fingerprint);
+        return status;
+    }
+
+    // files added or removed, or a changed recipe, means the project must be
+    // configured again, otherwise the existing configuration is reused
+    previous = build_cache_key_string(cache, "workspace-fingerprint");
+    if (previous == NULL || strcmp(previous, fingerprint) != 0) {
+        VLOG_TRACE("cookd", "source layout changed, project will be reconfigured\n");
+        build_cache_transaction_begin(cache);
+        __invalidate_configuration(cache, recipe);
+        build_cache_key_set_string(cache, "workspace-fingerprint", fingerprint);
+        build_cache_transaction_commit(cache);
+    }
+    free(fingerprint);
+
+    *workspaceOut = workspace;
+    *cacheOut = cache;
+    return 0;
+}
+
 // <root> / <id> / build.log
 static FILE* __cookd_build_log_new(const char* id, const char* root, char** logPathOut)
 {
@@ -580,31 +687,23 @@ static void __cookd_build_log_cleanup(FILE* log)
     fclose(log);
 }
 
-static void __notify(const char* id, enum cookd_notify_artifact_type atype, const char* uri)
-{
-    if (cookd_notify_artifact_ready(g_server->client, id, atype, uri)) {
-        VLOG_ERROR("cookd", "__cookd_server_build: %s failed to notify of status change => %u\n", id, atype);
-    }
-}
-
 static void __cookd_upload_artifacts(const char* id, const char* log, const char* pack)
 {
-    char* downloadUrl;
-    int   status;
+    struct cookd_artifact artifacts[2];
+    int                   count = 0;
+    int                   status;
 
     if (pack != NULL) {
-        status = remote_upload(pack, &downloadUrl);
-        if (!status) {
-            __notify(id, COOKD_ARTIFACT_TYPE_PACKAGE, downloadUrl);
-        }
-        VLOG_TRACE("cookd", "__cookd_upload_artifacts: result of uploading pack for %s: %i", id, status);
+        artifacts[count].type = COOKD_ARTIFACT_TYPE_PACKAGE;
+        artifacts[count++].path = pack;
     }
+    artifacts[count].type = COOKD_ARTIFACT_TYPE_LOG;
+    artifacts[count++].path = log;
 
-    status = remote_upload(log, &downloadUrl);
-    if (!status) {
-        __notify(id, COOKD_ARTIFACT_TYPE_LOG, downloadUrl);
-    }
-    VLOG_TRACE("cookd", "__cookd_upload_artifacts: result of uploading log for %s: %i", id, status);
+    // artifacts are stored by waiterd, which only asks for the content
+    // it does not already hold
+    status = cookd_artifacts_upload(g_server->client, id, &artifacts[0], count);
+    VLOG_TRACE("cookd", "__cookd_upload_artifacts: result of uploading artifacts for %s: %i", id, status);
 }
 
 static void __notify_status(const char* id, enum cookd_notify_build_status status) {
@@ -617,8 +716,10 @@ static void __cookd_server_build(const char* id, struct cookd_build_options* opt
 {
     struct __bake_build_context* context;
     struct build_cache*          cache = NULL;
+    struct cookd_workspace*      workspace = NULL;
     struct cookd_config_address  cvdAddress;
-    char*                        projectPath;
+    char*                        stagingPath = NULL;
+    const char*                  projectPath;
     char*                        buildPath;
     struct recipe*               recipe;
     FILE*                        log;
@@ -646,25 +747,37 @@ static void __cookd_server_build(const char* id, struct cookd_build_options* opt
         return;
     }
 
-    status = __prepare_sources(id, buildPath, options->url, &projectPath);
+    status = __prepare_sources(id, buildPath, options->url, &stagingPath);
     if (status) {
         VLOG_ERROR("cookd", "failed to prepare sources for build id %s (%s)\n", id, options->url);
         goto cleanup;
     }
 
-    status = __load_recipe(projectPath, options->recipe_path, &recipe);
+    status = __load_recipe(stagingPath, options->recipe_path, &recipe);
     if (status) {
         VLOG_ERROR("cookd", "failed to load the recipe for build id %s (%s)\n", id, options->recipe_path);
         goto cleanup;
     }
 
-    // we want the recipe cache in this case for regular builds
-    status = build_cache_create_null(recipe, &cache);
+    // builds of the same project reuse the workspace and build cache from the
+    // previous build, so only what changed in the sources is rebuilt
+    status = __prepare_workspace(buildPath, stagingPath, recipe, options, &workspace, &cache);
     if (status) {
-        VLOG_ERROR("kitchen", "failed to initialize recipe cache\n");
+        VLOG_ERROR("cookd", "failed to prepare workspace for build id %s\n", id);
         goto cleanup;
     }
 
+    if (workspace != NULL) {
+        projectPath = cookd_workspace_sources(workspace);
+
+        // the sources live on in the workspace, remove the staged copy
+        if (platform_rmdir(stagingPath)) {
+            VLOG_WARNING("cookd", "failed to cleanup %s for build id %s\n", stagingPath, id);
+        }
+    } else {
+        projectPath = stagingPath;
+    }
+
     cookd_config_cvd_address(&cvdAddress);
     context = build_context_create(&(struct __bake_build_options) {
         .cwd = projectPath,
@@ -678,7 +791,8 @@ static void __cookd_server_build(const char* id, struct cookd_build_options* opt
             .type = cvdAddress.type,
             .address = cvdAddress.address,
             .port = cvdAddress.port
-        }
+        },
+        .incremental = workspace != NULL
     });
     if (status) {
         VLOG_ERROR("cookd", "failed to initialize kitchen area for build id %s\n", id);
@@ -718,13 +832,18 @@ static void __cookd_server_build(const char* id, struct cookd_build_options* opt
     }
 
 cleanup:
+    fflush(log);
     __cookd_upload_artifacts(id, log_path, pack_path);
     __notify_status(id, status == 0 ? COOKD_BUILD_STATUS_DONE : COOKD_BUILD_STATUS_FAILED);
     
-    free(buildPath);
     if (cleanupKitchen) {
         build_context_destroy(context);
     }
+    if (workspace != NULL) {
+        cookd_workspace_release(workspace, build_cache_uuid(cache));
+    }
+    free(stagingPath);
+    free(buildPath);
     __cookd_build_log_cleanup(log);
 }
 
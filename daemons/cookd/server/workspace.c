@@ -0,0 +1,784 @@
+/**
+ * Copyright, Philip Meulengracht
+ *
+ * This program is free software : you can redistribute it and / or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation ? , either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ * 
+ */
+
+#include <chef/dirs.h>
+#include <chef/list.h>
+#include <chef/platform.h>
+#include <ctype.h>
+#include <errno.h>
+#include <jansson.h>
+#include <openssl/evp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <threading.h>
+#include <time.h>
+#include <vlog.h>
+#include <workspace.h>
+
+#define __WORKSPACE_MANIFEST_VERSION 1
+#define __HASH_HEX_LENGTH            (EVP_MAX_MD_SIZE * 2 + 1)
+
+// <root> / index.json
+// <root> / <key> / manifest.json
+// <root> / <key> / .vchcache
+// <root> / <key> / sources /
+struct __workspace_entry {
+    struct list_item list_header;
+    char*            key;
+    char*            rootfs_uuid;
+    long long        last_used;
+    int              in_use;
+};
+
+struct cookd_workspace {
+    struct __workspace_entry* entry;
+    char*                     path;
+    char*                     sources;
+};
+
+static struct {
+    mtx_t        lock;
+    char*        root;
+    unsigned int limit;
+    struct list  entries;
+} g_workspaces = { 0 };
+
+static struct __workspace_entry* __workspace_entry_new(const char* key, const char* rootfsUuid, long long lastUsed)
+{
+    struct __workspace_entry* entry;
+
+    entry = calloc(1, sizeof(struct __workspace_entry));
+    if (entry == NULL) {
+        return NULL;
+    }
+
+    entry->key = platform_strdup(key);
+    if (entry->key == NULL) {
+        free(entry);
+        return NULL;
+    }
+
+    if (rootfsUuid != NULL) {
+        entry->rootfs_uuid = platform_strdup(rootfsUuid);
+    }
+    entry->last_used = lastUsed;
+    return entry;
+}
+
+static void __workspace_entry_delete(struct __workspace_entry* entry)
+{
+    if (entry == NULL) {
+        return;
+    }
+    free(entry->key);
+    free(entry->rootfs_uuid);
+    free(entry);
+}
+
+static char* __index_path(void)
+{
+    return strpathcombine(g_workspaces.root, "index.json");
+}
+
+static int __load_index(void)
+{
+    json_error_t error;
+    json_t*      root;
+    json_t*      workspaces;
+    char*        path;
+    size_t       i;
+    json_t*      item;
+
+    path = __index_path();
+    if (path == NULL) {
+        return -1;
+    }
+
+    root = json_load_file(path, 0, &error);
+    free(path);
+    if (root == NULL) {
+        if (json_error_code(&error) == json_error_cannot_open_file) {
+            // no workspaces yet
+            return 0;
+        }
+        VLOG_WARNING("cookd", "__load_index: workspace index is corrupt, starting over: %s\n", error.text);
+        return 0;
+    }
+
+    workspaces = json_object_get(root, "workspaces");
+    json_array_foreach(workspaces, i, item) {
+        struct __workspace_entry* entry;
+        const char*               key = json_string_value(json_object_get(item, "key"));
+        if (key == NULL) {
+            continue;
+        }
+
+        entry = __workspace_entry_new(
+            key,
+            json_string_value(json_object_get(item, "rootfs")),
+            json_integer_value(json_object_get(item, "last-used"))
+        );
+        if (entry == NULL) {
+            json_decref(root);
+            return -1;
+        }
+        list_add(&g_workspaces.entries, &entry->list_header);
+    }
+    json_decref(root);
+    return 0;
+}
+
+static int __save_index(void)
+{
+    struct list_item* i;
+    json_t*           root;
+    json_t*           workspaces;
+    char*             path;
+    int               status;
+
+    root = json_object();
+    workspaces = json_array();
+    if (root == NULL || workspaces == NULL) {
+        json_decref(root);
+        json_decref(workspaces);
+        return -1;
+    }
+
+    list_foreach(&g_workspaces.entries, i) {
+        struct __workspace_entry* entry = (struct __workspace_entry*)i;
+        json_t*                   item = json_object();
+        if (item == NULL) {
+            continue;
+        }
+
+        json_object_set_new(item, "key", json_string(entry->key));
+        if (entry->rootfs_uuid != NULL) {
+            json_object_set_new(item, "rootfs", json_string(entry->rootfs_uuid));
+        }
+        json_object_set_new(item, "last-used", json_integer(entry->last_used));
+        json_array_append_new(workspaces, item);
+    }
+    json_object_set_new(root, "workspaces", workspaces);
+
+    path = __index_path();
+    if (path == NULL) {
+        json_decref(root);
+        return -1;
+    }
+
+    status = json_dump_file(root, path, JSON_INDENT(2));
+    if (status) {
+        VLOG_ERROR("cookd", "__save_index: failed to write %s\n", path);
+    }
+    free(path);
+    json_decref(root);
+    return status;
+}
+
+static void __remove_workspace_storage(struct __workspace_entry* entry)
+{
+    char* path;
+    VLOG_DEBUG("cookd", "__remove_workspace_storage(key=%s)\n", entry->key);
+
+    path = strpathcombine(g_workspaces.root, entry->key);
+    if (path != NULL) {
+        if (platform_rmdir(path) && errno != ENOENT) {
+            VLOG_WARNING("cookd", "__remove_workspace_storage: failed to remove %s\n", path);
+        }
+        free(path);
+    }
+
+    if (entry->rootfs_uuid != NULL) {
+        path = chef_dirs_rootfs_alloc(entry->rootfs_uuid);
+        if (path != NULL) {
+            if (platform_rmdir(path) && errno != ENOENT) {
+                VLOG_WARNING("cookd", "__remove_workspace_storage: failed to remove %s\n", path);
+            }
+            free(path);
+        }
+    }
+}
+
+// Must be called with the lock held, the evicted entries are moved to
+// the victims list so their storage can be removed without holding it.
+static void __evict_least_recently_used(struct list* victims)
+{
+    while (g_workspaces.entries.count > (int)g_workspaces.limit) {
+        struct __workspace_entry* oldest = NULL;
+        struct list_item*         i;
+
+        list_foreach(&g_workspaces.entries, i) {
+            struct __workspace_entry* entry = (struct __workspace_entry*)i;
+            if (entry->in_use) {
+                continue;
+            }
+            if (oldest == NULL || entry->last_used < oldest->last_used) {
+                oldest = entry;
+            }
+        }
+
+        if (oldest == NULL) {
+            // everything is in use, we go above the limit for now
+            break;
+        }
+
+        VLOG_DEBUG("cookd", "__evict_least_recently_used: evicting workspace %s\n", oldest->key);
+        list_remove(&g_workspaces.entries, &oldest->list_header);
+        list_add(victims, &oldest->list_header);
+    }
+}
+
+static char* __workspace_key(const char* project, const char* platform, const char* architecture)
+{
+    char buffer[256];
+
+    snprintf(&buffer[0], sizeof(buffer), "%s-%s-%s", project, platform, architecture);
+    for (char* p = &buffer[0]; *p; p++) {
+        if (!isalnum((unsigned char)*p) && *p != '-' && *p != '_' && *p != '.') {
+            *p = '_';
+        }
+    }
+    return platform_strdup(&buffer[0]);
+}
+
+int cookd_workspaces_initialize(const char* root, unsigned int limit)
+{
+    VLOG_DEBUG("cookd", "cookd_workspaces_initialize(root=%s, limit=%u)\n", root, limit);
+
+    if (mtx_init(&g_workspaces.lock, mtx_plain) != thrd_success) {
+        return -1;
+    }
+
+    g_workspaces.root = platform_strdup(root);
+    g_workspaces.limit = limit > 0 ? limit : 1;
+    if (g_workspaces.root == NULL) {
+        mtx_destroy(&g_workspaces.lock);
+        return -1;
+    }
+
+    if (platform_mkdir(g_workspaces.root)) {
+        VLOG_ERROR("cookd", "cookd_workspaces_initialize: failed to create %s\n", g_workspaces.root);
+        cookd_workspaces_cleanup();
+        return -1;
+    }
+
+    if (__load_index()) {
+        VLOG_ERROR("cookd", "cookd_workspaces_initialize: failed to load workspace index\n");
+        cookd_workspaces_cleanup();
+        return -1;
+    }
+    return 0;
+}
+
+void cookd_workspaces_cleanup(void)
+{
+    if (g_workspaces.root == NULL) {
+        return;
+    }
+
+    list_destroy(&g_workspaces.entries, (void(*)(void*))__workspace_entry_delete);
+    free(g_workspaces.root);
+    g_workspaces.root = NULL;
+    mtx_destroy(&g_workspaces.lock);
+}
+
+struct cookd_workspace* cookd_workspace_acquire(const char* project, const char* platform, const char* architecture)
+{
+    struct cookd_workspace*   workspace;
+    struct __workspace_entry* entry = NULL;
+    struct list               victims = { 0 };
+    struct list_item*         i;
+    char*                     key;
+    VLOG_DEBUG("cookd", "cookd_workspace_acquire(project=%s, platform=%s, arch=%s)\n", project, platform, architecture);
+
+    key = __workspace_key(project, platform, architecture);
+    workspace = calloc(1, sizeof(struct cookd_workspace));
+    if (key == NULL || workspace == NULL) {
+        free(key);
+        free(workspace);
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    workspace->path = strpathcombine(g_workspaces.root, key);
+    if (workspace->path != NULL) {
+        workspace->sources = strpathcombine(workspace->path, "sources");
+    }
+    if (workspace->sources == NULL) {
+        free(workspace->path);
+        free(workspace);
+        free(key);
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    mtx_lock(&g_workspaces.lock);
+    list_foreach(&g_workspaces.entries, i) {
+        struct __workspace_entry* candidate = (struct __workspace_entry*)i;
+        if (strcmp(candidate->key, key) == 0) {
+            entry = candidate;
+            break;
+        }
+    }
+
+    if (entry != NULL && entry->in_use) {
+        mtx_unlock(&g_workspaces.lock);
+        VLOG_DEBUG("cookd", "cookd_workspace_acquire: workspace %s is busy\n", key);
+        free(workspace->sources);
+        free(workspace->path);
+        free(workspace);
+        free(key);
+        errno = EBUSY;
+        return NULL;
+    }
+
+    if (entry == NULL) {
+        entry = __workspace_entry_new(key, NULL, 0);
+        if (entry == NULL) {
+            mtx_unlock(&g_workspaces.lock);
+            free(workspace->sources);
+            free(workspace->path);
+            free(workspace);
+            free(key);
+            errno = ENOMEM;
+            return NULL;
+        }
+        list_add(&g_workspaces.entries, &entry->list_header);
+    }
+
+    entry->in_use = 1;
+    entry->last_used = (long long)time(NULL);
+    workspace->entry = entry;
+
+    __evict_least_recently_used(&victims);
+    (void)__save_index();
+    mtx_unlock(&g_workspaces.lock);
+    free(key);
+
+    // evicted workspaces are no longer reachable, so their storage
+    // can be removed without blocking the other builders
+    for (i = victims.head; i != NULL;) {
+        struct __workspace_entry* victim = (struct __workspace_entry*)i;
+        i = i->next;
+        __remove_workspace_storage(victim);
+        __workspace_entry_delete(victim);
+    }
+
+    if (platform_mkdir(workspace->sources)) {
+        VLOG_ERROR("cookd", "cookd_workspace_acquire: failed to create %s\n", workspace->sources);
+        cookd_workspace_release(workspace, NULL);
+        return NULL;
+    }
+    return workspace;
+}
+
+void cookd_workspace_release(struct cookd_workspace* workspace, const char* rootfsUuid)
+{
+    if (workspace == NULL) {
+        return;
+    }
+    VLOG_DEBUG("cookd", "cookd_workspace_release(key=%s)\n", workspace->entry->key);
+
+    mtx_lock(&g_workspaces.lock);
+    if (rootfsUuid != NULL && (workspace->entry->rootfs_uuid == NULL ||
+        strcmp(workspace->entry->rootfs_uuid, rootfsUuid) != 0)) {
+        free(workspace->entry->rootfs_uuid);
+        workspace->entry->rootfs_uuid = platform_strdup(rootfsUuid);
+    }
+    workspace->entry->in_use = 0;
+    workspace->entry->last_used = (long long)time(NULL);
+    (void)__save_index();
+    mtx_unlock(&g_workspaces.lock);
+
+    free(workspace->sources);
+    free(workspace->path);
+    free(workspace);
+}
+
+const char* cookd_workspace_path(struct cookd_workspace* workspace)
+{
+    return workspace->path;
+}
+
+const char* cookd_workspace_sources(struct cookd_workspace* workspace)
+{
+    return workspace->sources;
+}
+
+static void __digest_to_hex(const unsigned char* digest, unsigned int length, char* hex)
+{
+    static const char* digits = "0123456789abcdef";
+    for (unsigned int i = 0; i < length; i++) {
+        hex[i * 2]     = digits[(digest[i] >> 4) & 0xF];
+        hex[i * 2 + 1] = digits[digest[i] & 0xF];
+    }
+    hex[length * 2] = '\0';
+}
+
+static int __hash_file(const char* path, char* hex)
+{
+    unsigned char digest[EVP_MAX_MD_SIZE];
+    unsigned int  digestLength;
+    char          buffer[64 * 1024];
+    EVP_MD_CTX*   ctx;
+    FILE*         file;
+    size_t        read;
+    int           status = -1;
+
+    file = fopen(path, "rb");
+    if (file == NULL) {
+        return -1;
+    }
+
+    ctx = EVP_MD_CTX_new();
+    if (ctx == NULL || EVP_DigestInit_ex(ctx, EVP_sha256(), NULL) != 1) {
+        goto cleanup;
+    }
+
+    while ((read = fread(&buffer[0], 1, sizeof(buffer), file)) > 0) {
+        if (EVP_DigestUpdate(ctx, &buffer[0], read) != 1) {
+            goto cleanup;
+        }
+    }
+    if (ferror(file) || EVP_DigestFinal_ex(ctx, &digest[0], &digestLength) != 1) {
+        goto cleanup;
+    }
+
+    __digest_to_hex(&digest[0], digestLength, hex);
+    status = 0;
+
+cleanup:
+    EVP_MD_CTX_free(ctx);
+    fclose(file);
+    return status;
+}
+
+static int __hash_string(const char* prefix, const char* value, char* hex)
+{
+    unsigned char digest[EVP_MAX_MD_SIZE];
+    unsigned int  digestLength;
+    EVP_MD_CTX*   ctx;
+    int           status = -1;
+
+    ctx = EVP_MD_CTX_new();
+    if (ctx != NULL &&
+        EVP_DigestInit_ex(ctx, EVP_sha256(), NULL) == 1 &&
+        EVP_DigestUpdate(ctx, prefix, strlen(prefix)) == 1 &&
+        EVP_DigestUpdate(ctx, value, strlen(value)) == 1 &&
+        EVP_DigestFinal_ex(ctx, &digest[0], &digestLength) == 1) {
+        __digest_to_hex(&digest[0], digestLength, hex);
+        status = 0;
+    }
+    EVP_MD_CTX_free(ctx);
+    return status;
+}
+
+static json_t* __load_manifest(const char* path)
+{
+    json_error_t error;
+    json_t*      root;
+    json_t*      files;
+
+    root = json_load_file(path, 0, &error);
+    if (root == NULL) {
+        return NULL;
+    }
+
+    if (json_integer_value(json_object_get(root, "version")) != __WORKSPACE_MANIFEST_VERSION) {
+        json_decref(root);
+        return NULL;
+    }
+
+    files = json_object_get(root, "files");
+    if (!json_is_object(files)) {
+        json_decref(root);
+        return NULL;
+    }
+    json_incref(files);
+    json_decref(root);
+    return files;
+}
+
+static int __save_manifest(const char* path, json_t* files)
+{
+    json_t* root;
+    int     status;
+
+    root = json_object();
+    if (root == NULL) {
+        return -1;
+    }
+
+    json_object_set_new(root, "version", json_integer(__WORKSPACE_MANIFEST_VERSION));
+    json_object_set(root, "files", files);
+    status = json_dump_file(root, path, JSON_COMPACT);
+    json_decref(root);
+    return status;
+}
+
+// The manifest records what we wrote last time, but the build may have touched the
+// sources since then, so the destination must still look like what we recorded.
+static int __destination_matches(const char* path, struct platform_scandir_entry* entry)
+{
+    struct platform_stat stats;
+
+    if (platform_stat(path, &stats)) {
+        return 0;
+    }
+    if (stats.type != entry->type) {
+        return 0;
+    }
+    return entry->type != PLATFORM_FILETYPE_FILE || stats.size == entry->size;
+}
+
+static int __write_destination(const char* path, struct platform_scandir_entry* entry, const char* linkTarget)
+{
+    if (platform_unlink(path) && errno != ENOENT) {
+        // it might be a directory that is now a file
+        if (platform_rmdir(path)) {
+            return -1;
+        }
+    }
+
+    if (entry->type == PLATFORM_FILETYPE_SYMLINK) {
+        return platform_symlink(path, linkTarget, platform_isdir(entry->path) == 0);
+    }
+
+    if (platform_copyfile(entry->path, path)) {
+        return -1;
+    }
+    return platform_chmod(path, entry->permissions);
+}
+
+int cookd_workspace_sync(
+    struct cookd_workspace*            workspace,
+    const char*                        stagingPath,
+    const char*                        recipePath,
+    struct cookd_workspace_sync_stats* stats,
+    char**                             fingerprintOut)
+{
+    struct cookd_workspace_sync_stats counts = { 0 };
+    struct platform_scandir           scan = { 0 };
+    unsigned char                     digest[EVP_MAX_MD_SIZE];
+    unsigned int                      digestLength;
+    char                              fingerprint[__HASH_HEX_LENGTH];
+    EVP_MD_CTX*                       fpctx = NULL;
+    json_t*                           previous;
+    json_t*                           files = NULL;
+    size_t*                           links = NULL;
+    size_t                            linkCount = 0;
+    char*                             manifestPath;
+    const char*                       key;
+    json_t*                           value;
+    int                               status = -1;
+    VLOG_DEBUG("cookd", "cookd_workspace_sync(workspace=%s, staging=%s)\n", workspace->path, stagingPath);
+
+    manifestPath = strpathcombine(workspace->path, "manifest.json");
+    if (manifestPath == NULL) {
+        return -1;
+    }
+
+    // Without a valid manifest there is no way of telling what in the workspace
+    // came from the sources, so start over from a clean source tree.
+    previous = __load_manifest(manifestPath);
+    if (previous == NULL) {
+        VLOG_DEBUG("cookd", "cookd_workspace_sync: no valid manifest, resetting sources\n");
+        if (platform_rmdir(workspace->sources) && errno != ENOENT) {
+            VLOG_ERROR("cookd", "cookd_workspace_sync: failed to reset %s\n", workspace->sources);
+            goto cleanup;
+        }
+        if (platform_mkdir(workspace->sources)) {
+            goto cleanup;
+        }
+        previous = json_object();
+    } else {
+        // The manifest is rewritten once the sync completes, an interrupted sync
+        // leaves the workspace in an unknown state and must reset it next time.
+        (void)platform_unlink(manifestPath);
+    }
+
+    files = json_object();
+    fpctx = EVP_MD_CTX_new();
+    if (previous == NULL || files == NULL || fpctx == NULL ||
+        EVP_DigestInit_ex(fpctx, EVP_sha256(), NULL) != 1) {
+        errno = ENOMEM;
+        goto cleanup;
+    }
+
+    if (platform_scandir(stagingPath, PLATFORM_SCANDIR_RECURSIVE | PLATFORM_SCANDIR_DIRECTORIES | PLATFORM_SCANDIR_STAT, 0, &scan)) {
+        VLOG_ERROR("cookd", "cookd_workspace_sync: failed to scan %s\n", stagingPath);
+        goto cleanup;
+    }
+
+    links = calloc(scan.count + 1, sizeof(size_t));
+    if (links == NULL) {
+        errno = ENOMEM;
+        goto cleanup;
+    }
+
+    for (size_t i = 0; i < scan.count; i++) {
+        struct platform_scandir_entry* entry = &scan.entries[i];
+        char                           hash[__HASH_HEX_LENGTH];
+        char*                          linkTarget = NULL;
+        char*                          destination;
+        const char*                    recorded;
+
+        destination = strpathcombine(workspace->sources, entry->sub_path);
+        if (destination == NULL) {
+            goto cleanup;
+        }
+
+        if (entry->type == PLATFORM_FILETYPE_DIRECTORY) {
+            status = platform_mkdir(destination);
+            free(destination);
+            if (status) {
+                VLOG_ERROR("cookd", "cookd_workspace_sync: failed to create directory %s\n", entry->sub_path);
+                goto cleanup;
+            }
+            status = -1;
+            continue;
+        }
+
+        if (entry->type == PLATFORM_FILETYPE_SYMLINK) {
+            if (platform_readlink(entry->path, &linkTarget) || __hash_string("link:", linkTarget, &hash[0])) {
+                VLOG_ERROR("cookd", "cookd_workspace_sync: failed to read link %s\n", entry->sub_path);
+                free(linkTarget);
+                free(destination);
+                goto cleanup;
+            }
+        } else if (entry->type == PLATFORM_FILETYPE_FILE) {
+            if (__hash_file(entry->path, &hash[0])) {
+                VLOG_ERROR("cookd", "cookd_workspace_sync: failed to hash %s\n", entry->sub_path);
+                free(destination);
+                goto cleanup;
+            }
+        } else {
+            free(destination);
+            continue;
+        }
+
+        recorded = json_string_value(json_object_get(previous, entry->sub_path));
+        if (recorded != NULL && strcmp(recorded, &hash[0]) == 0 && __destination_matches(destination, entry)) {
+            counts.unchanged++;
+        } else if (entry->type == PLATFORM_FILETYPE_SYMLINK) {
+            // links are created once all files are in place, so they
+            // never point to something that does not exist yet
+            links[linkCount++] = i;
+            if (recorded != NULL) {
+                counts.modified++;
+            } else {
+                counts.added++;
+            }
+        } else {
+            if (__write_destination(destination, entry, NULL)) {
+                VLOG_ERROR("cookd", "cookd_workspace_sync: failed to write %s\n", destination);
+                free(destination);
+                goto cleanup;
+            }
+            if (recorded != NULL) {
+                counts.modified++;
+            } else {
+                counts.added++;
+            }
+        }
+        free(linkTarget);
+        free(destination);
+
+        json_object_set_new(files, entry->sub_path, json_string(&hash[0]));
+
+        // the fingerprint only covers the layout of the sources, content
+        // changes are picked up by the incremental build itself
+        EVP_DigestUpdate(fpctx, entry->sub_path, strlen(entry->sub_path) + 1);
+    }
+
+    for (size_t i = 0; i < linkCount; i++) {
+        struct platform_scandir_entry* entry = &scan.entries[links[i]];
+        char*                          linkTarget = NULL;
+        char*                          destination;
+
+        destination = strpathcombine(workspace->sources, entry->sub_path);
+        if (destination == NULL || platform_readlink(entry->path, &linkTarget) ||
+            __write_destination(destination, entry, linkTarget)) {
+            VLOG_ERROR("cookd", "cookd_workspace_sync: failed to write link %s\n", entry->sub_path);
+            free(linkTarget);
+            free(destination);
+            goto cleanup;
+        }
+        free(linkTarget);
+        free(destination);
+    }
+
+    // remove the files that are no longer part of the sources, anything
+    // that was not written by us (i.e build artifacts) is left alone
+    json_object_foreach(previous, key, value) {
+        char* destination;
+        if (json_object_get(files, key) != NULL) {
+            continue;
+        }
+
+        destination = strpathcombine(workspace->sources, key);
+        if (destination == NULL) {
+            goto cleanup;
+        }
+        if (platform_unlink(destination) && errno != ENOENT) {
+            VLOG_WARNING("cookd", "cookd_workspace_sync: failed to remove %s\n", destination);
+        }
+        free(destination);
+        counts.removed++;
+    }
+
+    // a changed recipe can change how the project is configured
+    if (recipePath != NULL) {
+        const char* recipeHash = json_string_value(json_object_get(files, recipePath));
+        if (recipeHash != NULL) {
+            EVP_DigestUpdate(fpctx, recipeHash, strlen(recipeHash));
+        }
+    }
+
+    if (EVP_DigestFinal_ex(fpctx, &digest[0], &digestLength) != 1) {
+        goto cleanup;
+    }
+    __digest_to_hex(&digest[0], digestLength, &fingerprint[0]);
+
+    if (__save_manifest(manifestPath, files)) {
+        VLOG_ERROR("cookd", "cookd_workspace_sync: failed to write %s\n", manifestPath);
+        goto cleanup;
+    }
+
+    *fingerprintOut = platform_strdup(&fingerprint[0]);
+    if (*fingerprintOut == NULL) {
+        goto cleanup;
+    }
+
+    VLOG_DEBUG("cookd", "cookd_workspace_sync: %u added, %u modified, %u removed, %u unchanged\n",
+        counts.added, counts.modified, counts.removed, counts.unchanged);
+    if (stats != NULL) {
+        *stats = counts;
+    }
+    status = 0;
+
+cleanup:
+    platform_scandir_destroy(&scan);
+    free(links);
+    EVP_MD_CTX_free(fpctx);
+    json_decref(previous);
+    json_decref(files);
+    free(manifestPath);
+    return status;
+}
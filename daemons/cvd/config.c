@@ -76,6 +76,7 @@ static json_t* __serialize_config_address(struct config_address* address)
 
 struct config {
     struct config_address api_address;
+    int                   network_pool_size;
 };
 
 static struct config g_config = { 0 };
@@ -100,6 +101,7 @@ static json_t* __serialize_config(struct config* config)
     }
 
     json_object_set_new(root, "api-address", api_address);
+    json_object_set_new(root, "network-pool-size", json_integer(config->network_pool_size));
 
     return root;
 }
@@ -127,6 +129,11 @@ static int __parse_config(struct config* config, json_t* root)
     json_t* member;
     int     status;
 
+    member = json_object_get(root, "network-pool-size");
+    if (member != NULL) {
+        config->network_pool_size = (int)json_integer_value(member);
+    }
+
     member = json_object_get(root, "api-address");
     if (member == NULL) {
         return 0;
@@ -195,3 +202,8 @@ void cvd_config_api_address(struct cvd_config_address* address)
     address->address = g_config.api_address.address;
     address->port = g_config.api_address.port;
 }
+
+int cvd_config_network_pool_size(void)
+{
+    return g_config.network_pool_size;
+}
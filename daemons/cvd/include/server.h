@@ -21,15 +21,24 @@
 
 #include "chef_cvd_service_server.h"
 
+struct containerv_stats;
+struct containerv_process_streams;
+
+/**
+ * @brief Initializes the container registry, must be called before the server is started.
+ */
+extern int cvd_initialize(void);
+
 /**
  * @brief
  */
 extern enum chef_status cvd_create(const struct chef_create_parameters* params, const char** id);
 
 /**
- * @brief 
+ * @brief Spawns a process in a container. For CHEF_SPAWN_OPTIONS_STREAM the output and exit
+ * status descriptors are returned in streamsOut, which the caller must hand to cvd_streams_watch.
  */
-extern enum chef_status cvd_spawn(const struct chef_spawn_parameters* params, unsigned int* pIDOut);
+extern enum chef_status cvd_spawn(const struct chef_spawn_parameters* params, unsigned int* pIDOut, struct containerv_process_streams* streamsOut);
 
 /**
  * @brief
@@ -54,4 +63,63 @@ extern enum chef_status cvd_kill(const char* containerID, const unsigned int pID
  */
 extern enum chef_status cvd_destroy(const char* containerID);
 
+typedef void (*cvd_stats_callback_fn)(const char* containerID, struct containerv_stats* stats, void* context);
+
+/**
+ * @brief Samples the resource usage of all active containers in one batch, and invokes
+ * the callback once per container. The container registry is locked while the callback
+ * runs, so it must not call back into the cvd_* functions. Safe to call from any thread.
+ */
+extern int cvd_sample_stats(cvd_stats_callback_fn callback, void* context);
+
+/**
+ * @brief Initializes the stats subscription state, the publisher thread itself
+ * is started when the first client subscribes.
+ */
+extern int cvd_stats_initialize(void);
+
+/**
+ * @brief Subscribes a client to periodic container_stats events. An empty containerID
+ * subscribes the client to all containers. Re-subscribing replaces the previous subscription.
+ */
+extern enum chef_status cvd_stats_subscribe(gracht_server_t* server, gracht_conn_t client, const char* containerID, unsigned int intervalMs);
+
+/**
+ * @brief Removes any stats subscription the client might have.
+ */
+extern enum chef_status cvd_stats_unsubscribe(gracht_conn_t client);
+
+/**
+ * @brief Server callback for disconnected clients, drops their stats subscriptions.
+ */
+extern void cvd_stats_client_disconnected(gracht_conn_t client);
+
+/**
+ * @brief Stops the stats publisher thread and removes all subscriptions.
+ */
+extern void cvd_stats_cleanup(void);
+
+/**
+ * @brief Initializes the process stream state, the pump thread itself is started
+ * when the first streamed process is watched.
+ */
+extern int cvd_streams_initialize(void);
+
+/**
+ * @brief Takes ownership of the stream descriptors of a process, and delivers its output as
+ * process_output events to the client, followed by a process_exit event once it exits.
+ */
+extern int cvd_streams_watch(gracht_server_t* server, gracht_conn_t client, const char* containerID, unsigned int pID, struct containerv_process_streams* streams);
+
+/**
+ * @brief Server callback for disconnected clients, their processes are still drained
+ * until they exit, but nothing is sent anymore.
+ */
+extern void cvd_streams_client_disconnected(gracht_conn_t client);
+
+/**
+ * @brief Stops the pump thread and closes all stream descriptors.
+ */
+extern void cvd_streams_cleanup(void);
+
 #endif //!__CVD_SERVER_H__
@@ -17,6 +17,7 @@
  */
 
 #include "chef-config.h"
+#include <chef/containerv.h>
 #include <chef/dirs.h>
 #include <server.h>
 #include <vlog.h>
@@ -27,6 +28,12 @@
 // the server object
 static gracht_server_t* g_server = NULL;
 
+static void __client_disconnected(gracht_conn_t client)
+{
+    cvd_stats_client_disconnected(client);
+    cvd_streams_client_disconnected(client);
+}
+
 static void __print_help(void)
 {
     printf("Usage: cvd [options]\n\n");
@@ -95,12 +102,33 @@ int main(int argc, char** argv)
     vlog_add_output(debuglog, 1);
     vlog_set_output_level(debuglog, VLOG_LEVEL_DEBUG);
 
+    // the daemon logs from multiple threads, keep them off the log I/O
+    vlog_set_async(1);
+
     printf("log opened at %s\n", debuglogPath);
     free(debuglogPath);
 
+    // initialize the container registry, stats publisher and process streams
+    if (cvd_initialize() || cvd_stats_initialize() || cvd_streams_initialize()) {
+        fprintf(stderr, "cvd: failed to initialize server state\n");
+        return -1;
+    }
+    atexit(cvd_stats_cleanup);
+    atexit(cvd_streams_cleanup);
+
+    // pre-create veth pairs so networked containers don't wait on them
+    if (containerv_network_pool_initialize(cvd_config_network_pool_size())) {
+        fprintf(stderr, "cvd: failed to initialize the network pool\n");
+        return -1;
+    }
+    atexit(containerv_network_pool_cleanup);
+
     // initialize the server configuration
     gracht_server_configuration_init(&config);
 
+    // drop stats subscriptions and stream events of clients that go away
+    config.callbacks.clientDisconnected = __client_disconnected;
+
     // start up the server
     status = cvd_initialize_server(&config, &g_server);
 
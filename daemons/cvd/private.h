@@ -47,6 +47,11 @@ extern void cvd_config_destroy(void);
  */
 extern void cvd_config_api_address(struct cvd_config_address* address);
 
+/**
+ * @brief Number of veth pairs to keep ready for networked containers, 0 if disabled.
+ */
+extern int cvd_config_network_pool_size(void);
+
 /**
  * @brief
  */
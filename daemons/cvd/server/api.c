@@ -16,6 +16,7 @@
  * 
  */
 
+#include <chef/containerv.h>
 #include <chef/platform.h>
 #include <server.h>
 #include <vlog.h>
@@ -32,12 +33,19 @@ void chef_cvd_create_invocation(struct gracht_message* message, const struct che
 
 void chef_cvd_spawn_invocation(struct gracht_message* message, const struct chef_spawn_parameters* params)
 {
-    enum chef_status status;
-    unsigned int     pID;
+    struct containerv_process_streams streams;
+    enum chef_status                  status;
+    unsigned int                      pID = 0;
     VLOG_DEBUG("api", "spawn(id=%s, command=%s)\n", params->container_id, params->command);
 
-    status = cvd_spawn(params, &pID);
+    status = cvd_spawn(params, &pID, &streams);
     chef_cvd_spawn_response(message, pID, status);
+
+    // streams are attached once the response is out, so the client always
+    // knows the pid before the first event for it arrives
+    if (status == CHEF_STATUS_SUCCESS && (params->options & CHEF_SPAWN_OPTIONS_STREAM)) {
+        (void)cvd_streams_watch(message->server, message->client, params->container_id, pID, &streams);
+    }
 }
 
 void chef_cvd_kill_invocation(struct gracht_message* message, const char* container_id, const unsigned int pid)
@@ -63,3 +71,15 @@ void chef_cvd_destroy_invocation(struct gracht_message* message, const char* con
     VLOG_DEBUG("api", "destroy(id=%s)\n", container_id);
     chef_cvd_destroy_response(message, cvd_destroy(container_id));
 }
+
+void chef_cvd_subscribe_stats_invocation(struct gracht_message* message, const char* container_id, const unsigned int interval_ms)
+{
+    VLOG_DEBUG("api", "subscribe_stats(id=%s, interval=%u)\n", container_id, interval_ms);
+    chef_cvd_subscribe_stats_response(message, cvd_stats_subscribe(message->server, message->client, container_id, interval_ms));
+}
+
+void chef_cvd_unsubscribe_stats_invocation(struct gracht_message* message)
+{
+    VLOG_DEBUG("api", "unsubscribe_stats()\n");
+    chef_cvd_unsubscribe_stats_response(message, cvd_stats_unsubscribe(message->client));
+}
@@ -28,9 +28,14 @@
 #include <server.h>
 #include <stdlib.h>
 #include <string.h>
+#include <threads.h>
 #include <time.h>
 #include <vlog.h>
 
+#ifdef CHEF_ON_LINUX
+#include <unistd.h>
+#endif
+
 #include "../private.h"
 
 struct __container {
@@ -129,9 +134,21 @@ static struct __container_process* __container_find_process(struct __container*
 }
 
 static struct {
+    // the container list is only modified by the server thread, but it
+    // is read by the stats publisher, so modifications must hold the lock
+    mtx_t       lock;
     struct list containers;
 } g_server = { 0 };
 
+int cvd_initialize(void)
+{
+    if (mtx_init(&g_server.lock, mtx_plain) != thrd_success) {
+        VLOG_ERROR("cvd", "cvd_initialize: failed to initialize the container lock\n");
+        return -1;
+    }
+    return 0;
+}
+
 static enum chef_status __chef_status_from_errno(void) {
     switch (errno) {
 
@@ -557,7 +574,9 @@ enum chef_status cvd_create(const struct chef_create_parameters* params, const c
     // Store the layer context for cleanup later
     _container->layer_context = containerParams.layer_context;
     
+    mtx_lock(&g_server.lock);
     list_add(&g_server.containers, &_container->item_header);
+    mtx_unlock(&g_server.lock);
     *id = _container->id;
     return CHEF_STATUS_SUCCESS;
 }
@@ -591,6 +610,9 @@ static enum container_spawn_flags __convert_to_spawn_flags(enum chef_spawn_optio
     if (options & CHEF_SPAWN_OPTIONS_WAIT) {
         flags |= CV_SPAWN_WAIT;
     }
+    if (options & CHEF_SPAWN_OPTIONS_STREAM) {
+        flags |= CV_SPAWN_STREAM;
+    }
     return flags;
 }
 
@@ -609,7 +631,7 @@ static struct __container* __find_container(const char* id)
     return NULL;
 }
 
-enum chef_status cvd_spawn(const struct chef_spawn_parameters* params, unsigned int* pIDOut)
+enum chef_status cvd_spawn(const struct chef_spawn_parameters* params, unsigned int* pIDOut, struct containerv_process_streams* streamsOut)
 {
     struct __container*             container;
     int                             status;
@@ -653,7 +675,8 @@ enum chef_status cvd_spawn(const struct chef_spawn_parameters* params, unsigned
     struct containerv_spawn_options opts = {
         .arguments = arguments,
         .environment = (const char* const*)environment,
-        .flags = __convert_to_spawn_flags(params->options)
+        .flags = __convert_to_spawn_flags(params->options),
+        .streams = streamsOut
     };
     status = containerv_spawn(
         container->handle,
@@ -671,6 +694,13 @@ enum chef_status cvd_spawn(const struct chef_spawn_parameters* params, unsigned
     if (public_id == 0) {
         VLOG_ERROR("cvd", "cvd_spawn: failed to register process handle\n");
         containerv_kill(container->handle, handle);
+#ifdef CHEF_ON_LINUX
+        if (opts.flags & CV_SPAWN_STREAM) {
+            close(streamsOut->stdout_fd);
+            close(streamsOut->stderr_fd);
+            close(streamsOut->exit_fd);
+        }
+#endif
         ret = CHEF_STATUS_INTERNAL_ERROR;
         goto cleanup;
     }
@@ -769,7 +799,9 @@ enum chef_status cvd_destroy(const char* containerID)
     }
 
     // Remove from list first
+    mtx_lock(&g_server.lock);
     list_remove(&g_server.containers, &container->item_header);
+    mtx_unlock(&g_server.lock);
 
     status = containerv_destroy(container->handle);
     if (status) {
@@ -785,3 +817,50 @@ enum chef_status cvd_destroy(const char* containerID)
     __container_delete(container);
     return status == 0 ? CHEF_STATUS_SUCCESS : __chef_status_from_errno();
 }
+
+int cvd_sample_stats(cvd_stats_callback_fn callback, void* context)
+{
+    struct containerv_container** handles;
+    struct containerv_stats*      stats;
+    struct list_item*             i;
+    int                           count;
+    int                           status;
+
+    mtx_lock(&g_server.lock);
+    count = g_server.containers.count;
+    if (count == 0) {
+        mtx_unlock(&g_server.lock);
+        return 0;
+    }
+
+    handles = calloc(count, sizeof(struct containerv_container*));
+    stats = calloc(count, sizeof(struct containerv_stats));
+    if (handles == NULL || stats == NULL) {
+        mtx_unlock(&g_server.lock);
+        free(handles);
+        free(stats);
+        return -1;
+    }
+
+    count = 0;
+    list_foreach(&g_server.containers, i) {
+        handles[count++] = ((struct __container*)i)->handle;
+    }
+
+    status = containerv_get_stats_batch(handles, count, stats);
+    if (status == 0) {
+        // keep the lock while reporting, the container ids are owned
+        // by the containers and they must not be destroyed meanwhile
+        count = 0;
+        list_foreach(&g_server.containers, i) {
+            callback(((struct __container*)i)->id, &stats[count++], context);
+        }
+    } else {
+        VLOG_ERROR("cvd", "cvd_sample_stats: failed to sample container stats\n");
+    }
+    mtx_unlock(&g_server.lock);
+
+    free(handles);
+    free(stats);
+    return status;
+}
@@ -0,0 +1,282 @@
+/**
+ * Copyright, Philip Meulengracht
+ *
+ * This program is free software : you can redistribute it and / or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation ? , either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ * 
+ */
+
+#include <chef/containerv.h>
+#include <chef/list.h>
+#include <errno.h>
+#include <server.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <threads.h>
+#include <time.h>
+#include <vlog.h>
+
+// Intervals below this are clamped, the cgroup counters are not
+// updated often enough for faster sampling to make sense
+#define __STATS_INTERVAL_MIN_MS     100
+#define __STATS_INTERVAL_DEFAULT_MS 1000
+
+struct __stats_subscriber {
+    struct list_item item_header;
+    gracht_conn_t    client;
+    char*            container_id; // NULL for all containers
+    unsigned int     interval_ms;
+    uint64_t         next_due_ms;
+    int              due;
+};
+
+static struct {
+    mtx_t            lock;
+    cnd_t            signal;
+    thrd_t           thread;
+    int              thread_started;
+    int              should_stop;
+    gracht_server_t* server;
+    struct list      subscribers;
+} g_stats = { 0 };
+
+static uint64_t __now_ms(void)
+{
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return (uint64_t)ts.tv_sec * 1000ULL + (uint64_t)(ts.tv_nsec / 1000000);
+}
+
+static struct __stats_subscriber* __subscriber_find(gracht_conn_t client)
+{
+    struct list_item* i;
+
+    list_foreach(&g_stats.subscribers, i) {
+        struct __stats_subscriber* subscriber = (struct __stats_subscriber*)i;
+        if (subscriber->client == client) {
+            return subscriber;
+        }
+    }
+    return NULL;
+}
+
+static void __subscriber_delete(struct __stats_subscriber* subscriber)
+{
+    free(subscriber->container_id);
+    free(subscriber);
+}
+
+static void __publish_stats(const char* containerID, struct containerv_stats* stats, void* context)
+{
+    struct chef_container_stats event;
+    struct list_item*           i;
+    double                      cpuPercent;
+    (void)context;
+
+    cpuPercent = stats->cpu_percent * 100.0;
+    if (cpuPercent > (double)UINT32_MAX) {
+        cpuPercent = (double)UINT32_MAX;
+    }
+
+    event.container_id = (char*)containerID;
+    event.timestamp = stats->timestamp;
+    event.memory_usage = stats->memory_usage;
+    event.memory_peak = stats->memory_peak;
+    event.cpu_time_ns = stats->cpu_time_ns;
+    event.cpu_percent_x100 = (unsigned int)cpuPercent;
+    event.read_bytes = stats->read_bytes;
+    event.write_bytes = stats->write_bytes;
+    event.read_ops = stats->read_ops;
+    event.write_ops = stats->write_ops;
+    event.network_rx_bytes = stats->network_rx_bytes;
+    event.network_tx_bytes = stats->network_tx_bytes;
+    event.network_rx_packets = stats->network_rx_packets;
+    event.network_tx_packets = stats->network_tx_packets;
+    event.active_processes = stats->active_processes;
+    event.total_processes = stats->total_processes;
+
+    list_foreach(&g_stats.subscribers, i) {
+        struct __stats_subscriber* subscriber = (struct __stats_subscriber*)i;
+        if (!subscriber->due) {
+            continue;
+        }
+        if (subscriber->container_id != NULL && strcmp(subscriber->container_id, containerID) != 0) {
+            continue;
+        }
+        chef_cvd_event_container_stats_single(g_stats.server, subscriber->client, &event);
+    }
+}
+
+static int __stats_publisher_main(void* arg)
+{
+    (void)arg;
+
+    VLOG_DEBUG("cvd", "stats publisher started\n");
+
+    mtx_lock(&g_stats.lock);
+    while (!g_stats.should_stop) {
+        struct list_item* i;
+        uint64_t          now = __now_ms();
+        uint64_t          next = UINT64_MAX;
+        int               due = 0;
+
+        list_foreach(&g_stats.subscribers, i) {
+            struct __stats_subscriber* subscriber = (struct __stats_subscriber*)i;
+            subscriber->due = subscriber->next_due_ms <= now;
+            if (subscriber->due) {
+                subscriber->next_due_ms = now + subscriber->interval_ms;
+                due++;
+            }
+            if (subscriber->next_due_ms < next) {
+                next = subscriber->next_due_ms;
+            }
+        }
+
+        // One batched sample serves every subscriber that is due, the
+        // subscriber lock is held so subscriptions cannot go away meanwhile
+        if (due > 0) {
+            (void)cvd_sample_stats(__publish_stats, NULL);
+        }
+
+        if (next == UINT64_MAX) {
+            cnd_wait(&g_stats.signal, &g_stats.lock);
+        } else {
+            struct timespec deadline = {
+                .tv_sec = (time_t)(next / 1000ULL),
+                .tv_nsec = (long)(next % 1000ULL) * 1000000L
+            };
+            cnd_timedwait(&g_stats.signal, &g_stats.lock, &deadline);
+        }
+    }
+    mtx_unlock(&g_stats.lock);
+
+    VLOG_DEBUG("cvd", "stats publisher stopped\n");
+    return 0;
+}
+
+int cvd_stats_initialize(void)
+{
+    if (mtx_init(&g_stats.lock, mtx_plain) != thrd_success) {
+        VLOG_ERROR("cvd", "cvd_stats_initialize: failed to initialize mutex\n");
+        return -1;
+    }
+
+    if (cnd_init(&g_stats.signal) != thrd_success) {
+        VLOG_ERROR("cvd", "cvd_stats_initialize: failed to initialize condition variable\n");
+        mtx_destroy(&g_stats.lock);
+        return -1;
+    }
+    return 0;
+}
+
+enum chef_status cvd_stats_subscribe(gracht_server_t* server, gracht_conn_t client, const char* containerID, unsigned int intervalMs)
+{
+    struct __stats_subscriber* subscriber;
+    char*                      id = NULL;
+    VLOG_DEBUG("cvd", "cvd_stats_subscribe(client=%i, id=%s, interval=%u)\n", client, containerID, intervalMs);
+
+    if (intervalMs == 0) {
+        intervalMs = __STATS_INTERVAL_DEFAULT_MS;
+    } else if (intervalMs < __STATS_INTERVAL_MIN_MS) {
+        intervalMs = __STATS_INTERVAL_MIN_MS;
+    }
+
+    if (containerID != NULL && containerID[0] != '\0') {
+        id = strdup(containerID);
+        if (id == NULL) {
+            return CHEF_STATUS_INTERNAL_ERROR;
+        }
+    }
+
+    mtx_lock(&g_stats.lock);
+    g_stats.server = server;
+
+    subscriber = __subscriber_find(client);
+    if (subscriber == NULL) {
+        subscriber = calloc(1, sizeof(struct __stats_subscriber));
+        if (subscriber == NULL) {
+            mtx_unlock(&g_stats.lock);
+            free(id);
+            return CHEF_STATUS_INTERNAL_ERROR;
+        }
+        subscriber->client = client;
+        list_add(&g_stats.subscribers, &subscriber->item_header);
+    }
+
+    free(subscriber->container_id);
+    subscriber->container_id = id;
+    subscriber->interval_ms = intervalMs;
+    subscriber->next_due_ms = 0;
+
+    // the publisher is started with the first subscription, most
+    // cvd instances never have anyone listening for stats
+    if (!g_stats.thread_started) {
+        if (thrd_create(&g_stats.thread, __stats_publisher_main, NULL) != thrd_success) {
+            VLOG_ERROR("cvd", "cvd_stats_subscribe: failed to start the stats publisher\n");
+            list_remove(&g_stats.subscribers, &subscriber->item_header);
+            __subscriber_delete(subscriber);
+            mtx_unlock(&g_stats.lock);
+            return CHEF_STATUS_INTERNAL_ERROR;
+        }
+        g_stats.thread_started = 1;
+    }
+    cnd_signal(&g_stats.signal);
+    mtx_unlock(&g_stats.lock);
+    return CHEF_STATUS_SUCCESS;
+}
+
+enum chef_status cvd_stats_unsubscribe(gracht_conn_t client)
+{
+    struct __stats_subscriber* subscriber;
+    VLOG_DEBUG("cvd", "cvd_stats_unsubscribe(client=%i)\n", client);
+
+    mtx_lock(&g_stats.lock);
+    subscriber = __subscriber_find(client);
+    if (subscriber != NULL) {
+        list_remove(&g_stats.subscribers, &subscriber->item_header);
+        __subscriber_delete(subscriber);
+    }
+    mtx_unlock(&g_stats.lock);
+    return CHEF_STATUS_SUCCESS;
+}
+
+void cvd_stats_client_disconnected(gracht_conn_t client)
+{
+    (void)cvd_stats_unsubscribe(client);
+}
+
+void cvd_stats_cleanup(void)
+{
+    struct list_item* i;
+
+    mtx_lock(&g_stats.lock);
+    g_stats.should_stop = 1;
+    cnd_signal(&g_stats.signal);
+    mtx_unlock(&g_stats.lock);
+
+    if (g_stats.thread_started) {
+        thrd_join(g_stats.thread, NULL);
+        g_stats.thread_started = 0;
+    }
+
+    for (i = g_stats.subscribers.head; i != NULL;) {
+        struct __stats_subscriber* subscriber = (struct __stats_subscriber*)i;
+        i = i->next;
+        __subscriber_delete(subscriber);
+    }
+    list_init(&g_stats.subscribers);
+
+    cnd_destroy(&g_stats.signal);
+    mtx_destroy(&g_stats.lock);
+}
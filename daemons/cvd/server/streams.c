@@ -0,0 +1,430 @@
+/**
+ * Copyright, Philip Meulengracht
+ *
+ * This program is free software : you can redistribute it and / or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation ? , either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ * 
+ */
+
+#define _GNU_SOURCE
+
+#include <chef/containerv.h>
+#include <chef/list.h>
+#include <errno.h>
+#include <server.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <threads.h>
+#include <vlog.h>
+
+#ifdef CHEF_ON_LINUX
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+
+// Output is forwarded in chunks of at most this size, and only one chunk per
+// stream is read per wakeup, so a chatty process cannot starve the others
+#define __STREAM_CHUNK_SIZE 4096
+
+enum __stream_index {
+    __STREAM_STDOUT,
+    __STREAM_STDERR,
+    __STREAM_EXIT,
+    __STREAM_COUNT
+};
+
+struct __stream_process {
+    struct list_item item_header;
+    gracht_conn_t    client;
+    int              connected;
+    char*            container_id;
+    unsigned int     pid;
+    int              fds[__STREAM_COUNT];
+    int              poll_index[__STREAM_COUNT];
+    int              exited;
+    int              exit_code;
+};
+
+static struct {
+    mtx_t            lock;
+    thrd_t           thread;
+    int              thread_started;
+    int              should_stop;
+    int              wakeup[2];
+    gracht_server_t* server;
+    struct list      processes;
+} g_streams = { .wakeup = { -1, -1 } };
+
+static void __close_stream(struct __stream_process* proc, enum __stream_index stream)
+{
+    if (proc->fds[stream] >= 0) {
+        close(proc->fds[stream]);
+        proc->fds[stream] = -1;
+    }
+}
+
+static void __stream_process_delete(struct __stream_process* proc)
+{
+    for (int i = 0; i < __STREAM_COUNT; i++) {
+        __close_stream(proc, i);
+    }
+    free(proc->container_id);
+    free(proc);
+}
+
+// Forwards output of a stream to the owning client. A single chunk is read unless
+// drain is set, in which case everything currently buffered in the pipe is read.
+static void __forward_output(struct __stream_process* proc, enum __stream_index stream, int drain)
+{
+    uint8_t buffer[__STREAM_CHUNK_SIZE];
+    ssize_t bytesRead;
+
+    while (proc->fds[stream] >= 0) {
+        bytesRead = read(proc->fds[stream], &buffer[0], sizeof(buffer));
+        if (bytesRead < 0 && errno == EINTR) {
+            continue;
+        }
+        if (bytesRead < 0 && errno == EAGAIN) {
+            return;
+        }
+        if (bytesRead <= 0) {
+            __close_stream(proc, stream);
+            return;
+        }
+
+        if (proc->connected) {
+            chef_cvd_event_process_output_single(
+                g_streams.server,
+                proc->client,
+                &(struct chef_process_output) {
+                    .container_id = proc->container_id,
+                    .pid = proc->pid,
+                    .stream = (stream == __STREAM_STDOUT) ? CHEF_PROCESS_STREAM_STDOUT : CHEF_PROCESS_STREAM_STDERR,
+                    .data = &buffer[0],
+                    .data_count = (uint32_t)bytesRead
+                }
+            );
+        }
+
+        if (!drain) {
+            return;
+        }
+    }
+}
+
+static void __collect_exit(struct __stream_process* proc)
+{
+    int     exitCode;
+    ssize_t bytesRead;
+
+    bytesRead = read(proc->fds[__STREAM_EXIT], &exitCode, sizeof(int));
+    if (bytesRead < 0 && (errno == EINTR || errno == EAGAIN)) {
+        return;
+    }
+
+    // EOF without a status means the container went away first
+    proc->exit_code = (bytesRead == sizeof(int)) ? exitCode : -1;
+    proc->exited = 1;
+    __close_stream(proc, __STREAM_EXIT);
+}
+
+static void __publish_exit(struct __stream_process* proc)
+{
+    VLOG_DEBUG("cvd", "process %u in %s exited with %i\n", proc->pid, proc->container_id, proc->exit_code);
+    if (!proc->connected) {
+        return;
+    }
+
+    chef_cvd_event_process_exit_single(
+        g_streams.server,
+        proc->client,
+        &(struct chef_process_exit) {
+            .container_id = proc->container_id,
+            .pid = proc->pid,
+            .exit_code = proc->exit_code
+        }
+    );
+}
+
+// Builds the poll set from the watched processes, slot 0 is the wakeup pipe.
+// Returns the number of slots used, or 0 if the set could not be allocated.
+static size_t __build_pollset(struct pollfd** fdsInOut, size_t* capacityInOut)
+{
+    struct list_item* i;
+    size_t            count = 1;
+    size_t            needed;
+
+    needed = 1 + ((size_t)g_streams.processes.count * __STREAM_COUNT);
+    if (needed > *capacityInOut) {
+        struct pollfd* fds = realloc(*fdsInOut, needed * sizeof(struct pollfd));
+        if (fds == NULL) {
+            return 0;
+        }
+        *fdsInOut = fds;
+        *capacityInOut = needed;
+    }
+
+    (*fdsInOut)[0].fd = g_streams.wakeup[0];
+    (*fdsInOut)[0].events = POLLIN;
+    (*fdsInOut)[0].revents = 0;
+
+    list_foreach(&g_streams.processes, i) {
+        struct __stream_process* proc = (struct __stream_process*)i;
+        for (int j = 0; j < __STREAM_COUNT; j++) {
+            proc->poll_index[j] = -1;
+            if (proc->fds[j] < 0) {
+                continue;
+            }
+            proc->poll_index[j] = (int)count;
+            (*fdsInOut)[count].fd = proc->fds[j];
+            (*fdsInOut)[count].events = POLLIN;
+            (*fdsInOut)[count].revents = 0;
+            count++;
+        }
+    }
+    return count;
+}
+
+static int __is_ready(struct pollfd* fds, struct __stream_process* proc, enum __stream_index stream)
+{
+    int index = proc->poll_index[stream];
+    return index >= 0 && (fds[index].revents & (POLLIN | POLLHUP | POLLERR));
+}
+
+static int __streams_pump_main(void* arg)
+{
+    struct pollfd* fds = NULL;
+    size_t         capacity = 0;
+    (void)arg;
+
+    VLOG_DEBUG("cvd", "stream pump started\n");
+
+    for (;;) {
+        struct list_item* i;
+        size_t            count;
+        int               status;
+
+        mtx_lock(&g_streams.lock);
+        if (g_streams.should_stop) {
+            mtx_unlock(&g_streams.lock);
+            break;
+        }
+        count = __build_pollset(&fds, &capacity);
+        mtx_unlock(&g_streams.lock);
+
+        if (count == 0) {
+            VLOG_ERROR("cvd", "__streams_pump_main: failed to allocate the poll set\n");
+            thrd_sleep(&(struct timespec) { .tv_nsec = 100000000L }, NULL);
+            continue;
+        }
+
+        // processes watched while we sleep are not in the set, they
+        // wake us through the pipe which rebuilds it
+        status = poll(fds, (nfds_t)count, -1);
+        if (status < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            VLOG_ERROR("cvd", "__streams_pump_main: poll failed: %i\n", errno);
+            break;
+        }
+
+        if (fds[0].revents & POLLIN) {
+            char drain[64];
+            while (read(g_streams.wakeup[0], &drain[0], sizeof(drain)) > 0) { }
+        }
+
+        mtx_lock(&g_streams.lock);
+        for (i = g_streams.processes.head; i != NULL;) {
+            struct __stream_process* proc = (struct __stream_process*)i;
+            i = i->next;
+
+            if (__is_ready(fds, proc, __STREAM_STDOUT)) {
+                __forward_output(proc, __STREAM_STDOUT, 0);
+            }
+            if (__is_ready(fds, proc, __STREAM_STDERR)) {
+                __forward_output(proc, __STREAM_STDERR, 0);
+            }
+            if (__is_ready(fds, proc, __STREAM_EXIT)) {
+                __collect_exit(proc);
+            }
+
+            // whatever is still buffered is delivered before the exit event. Output
+            // held open by orphaned descendants is not waited for.
+            if (proc->exited) {
+                __forward_output(proc, __STREAM_STDOUT, 1);
+                __forward_output(proc, __STREAM_STDERR, 1);
+                __publish_exit(proc);
+                list_remove(&g_streams.processes, &proc->item_header);
+                __stream_process_delete(proc);
+            }
+        }
+        mtx_unlock(&g_streams.lock);
+    }
+
+    free(fds);
+    VLOG_DEBUG("cvd", "stream pump stopped\n");
+    return 0;
+}
+
+static void __wakeup_pump(void)
+{
+    char signal = 1;
+
+    // a full pipe already guarantees a wakeup
+    if (write(g_streams.wakeup[1], &signal, 1) < 0 && errno != EAGAIN) {
+        VLOG_WARNING("cvd", "__wakeup_pump: failed to signal the stream pump\n");
+    }
+}
+
+int cvd_streams_initialize(void)
+{
+    if (mtx_init(&g_streams.lock, mtx_plain) != thrd_success) {
+        VLOG_ERROR("cvd", "cvd_streams_initialize: failed to initialize mutex\n");
+        return -1;
+    }
+
+    if (pipe2(g_streams.wakeup, O_CLOEXEC | O_NONBLOCK)) {
+        VLOG_ERROR("cvd", "cvd_streams_initialize: failed to create the wakeup pipe\n");
+        mtx_destroy(&g_streams.lock);
+        return -1;
+    }
+    return 0;
+}
+
+int cvd_streams_watch(gracht_server_t* server, gracht_conn_t client, const char* containerID, unsigned int pID, struct containerv_process_streams* streams)
+{
+    struct __stream_process* proc;
+    VLOG_DEBUG("cvd", "cvd_streams_watch(client=%i, id=%s, pid=%u)\n", client, containerID, pID);
+
+    proc = calloc(1, sizeof(struct __stream_process));
+    if (proc == NULL) {
+        goto error;
+    }
+
+    proc->container_id = strdup(containerID);
+    if (proc->container_id == NULL) {
+        free(proc);
+        goto error;
+    }
+
+    proc->client = client;
+    proc->connected = 1;
+    proc->pid = pID;
+    proc->fds[__STREAM_STDOUT] = streams->stdout_fd;
+    proc->fds[__STREAM_STDERR] = streams->stderr_fd;
+    proc->fds[__STREAM_EXIT] = streams->exit_fd;
+    for (int i = 0; i < __STREAM_COUNT; i++) {
+        proc->poll_index[i] = -1;
+        (void)fcntl(proc->fds[i], F_SETFL, fcntl(proc->fds[i], F_GETFL) | O_NONBLOCK);
+    }
+
+    mtx_lock(&g_streams.lock);
+    g_streams.server = server;
+    list_add(&g_streams.processes, &proc->item_header);
+
+    // the pump is started with the first streamed process, the
+    // build clients that never stream should not pay for it
+    if (!g_streams.thread_started) {
+        if (thrd_create(&g_streams.thread, __streams_pump_main, NULL) != thrd_success) {
+            VLOG_ERROR("cvd", "cvd_streams_watch: failed to start the stream pump\n");
+            list_remove(&g_streams.processes, &proc->item_header);
+            mtx_unlock(&g_streams.lock);
+            __stream_process_delete(proc);
+            return -1;
+        }
+        g_streams.thread_started = 1;
+    }
+    mtx_unlock(&g_streams.lock);
+
+    __wakeup_pump();
+    return 0;
+
+error:
+    VLOG_ERROR("cvd", "cvd_streams_watch: failed to allocate memory for process %u\n", pID);
+    close(streams->stdout_fd);
+    close(streams->stderr_fd);
+    close(streams->exit_fd);
+    return -1;
+}
+
+void cvd_streams_client_disconnected(gracht_conn_t client)
+{
+    struct list_item* i;
+
+    // the processes keep running, so their pipes must still be drained
+    mtx_lock(&g_streams.lock);
+    list_foreach(&g_streams.processes, i) {
+        struct __stream_process* proc = (struct __stream_process*)i;
+        if (proc->client == client) {
+            proc->connected = 0;
+        }
+    }
+    mtx_unlock(&g_streams.lock);
+}
+
+void cvd_streams_cleanup(void)
+{
+    struct list_item* i;
+
+    mtx_lock(&g_streams.lock);
+    g_streams.should_stop = 1;
+    mtx_unlock(&g_streams.lock);
+    __wakeup_pump();
+
+    if (g_streams.thread_started) {
+        thrd_join(g_streams.thread, NULL);
+        g_streams.thread_started = 0;
+    }
+
+    for (i = g_streams.processes.head; i != NULL;) {
+        struct __stream_process* proc = (struct __stream_process*)i;
+        i = i->next;
+        __stream_process_delete(proc);
+    }
+    list_init(&g_streams.processes);
+
+    close(g_streams.wakeup[0]);
+    close(g_streams.wakeup[1]);
+    mtx_destroy(&g_streams.lock);
+}
+
+#else
+
+int cvd_streams_initialize(void)
+{
+    return 0;
+}
+
+int cvd_streams_watch(gracht_server_t* server, gracht_conn_t client, const char* containerID, unsigned int pID, struct containerv_process_streams* streams)
+{
+    (void)server;
+    (void)client;
+    (void)containerID;
+    (void)pID;
+    (void)streams;
+    errno = ENOTSUP;
+    return -1;
+}
+
+void cvd_streams_client_disconnected(gracht_conn_t client)
+{
+    (void)client;
+}
+
+void cvd_streams_cleanup(void)
+{
+}
+
+#endif
@@ -17,15 +17,18 @@
  */
 
 #include <chef/platform.h>
+#include <errno.h>
 #include <gracht/server.h>
 #include <runner.h>
 #include <state.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <vlog.h>
 
 #include <transaction/transaction.h>
 #include <transaction/logging.h>
+#include <transaction/states/load.h>
 #include <state.h>
 
 // server protocol
@@ -90,6 +93,76 @@ void chef_served_install_invocation(struct gracht_message* message, const struct
     chef_served_install_response(message, transactionId);
 }
 
+// __batch_new creates a batch transaction for the packages. Everything is created
+// under one state lock, so the batch is committed to the database at once.
+static unsigned int __batch_new(const char* name, const char* description, struct state_transaction* packages, int count)
+{
+    unsigned int transactionId;
+
+    served_state_lock();
+    transactionId = served_state_transaction_new(&(struct served_transaction_options){
+        .name = name,
+        .description = description,
+        .type = SERVED_TRANSACTION_TYPE_BATCH,
+    });
+    if (transactionId == 0) {
+        served_state_unlock();
+        return 0;
+    }
+
+    for (int i = 0; i < count; i++) {
+        int duplicate = packages[i].name == NULL;
+
+        // packages that are listed more than once are only installed once
+        for (int j = 0; j < i && !duplicate; j++) {
+            if (packages[j].name != NULL && strcmp(packages[i].name, packages[j].name) == 0) {
+                duplicate = 1;
+                break;
+            }
+        }
+        if (!duplicate) {
+            served_state_transaction_state_new(transactionId, &packages[i]);
+        }
+    }
+    served_state_unlock();
+    return transactionId;
+}
+
+void chef_served_install_batch_invocation(struct gracht_message* message, const struct chef_served_install_batch_options* options)
+{
+    struct state_transaction* packages;
+    unsigned int              transactionId = 0;
+    char                      nameBuffer[256];
+    char                      descriptionBuffer[512];
+    VLOG_DEBUG("api", "chef_served_install_batch_invocation(count=%u)\n", options->packages_count);
+
+    if (options->packages_count == 0) {
+        VLOG_WARNING("api", "chef_served_install_batch_invocation: no packages specified\n");
+        chef_served_install_batch_response(message, 0);
+        return;
+    }
+
+    packages = calloc(options->packages_count, sizeof(struct state_transaction));
+    if (packages == NULL) {
+        VLOG_WARNING("api", "failed to allocate memory!\n");
+        chef_served_install_batch_response(message, 0);
+        return;
+    }
+
+    for (uint32_t i = 0; i < options->packages_count; i++) {
+        packages[i].name = options->packages[i].package;
+        packages[i].channel = options->packages[i].channel;
+        packages[i].revision = options->packages[i].revision;
+    }
+
+    snprintf(nameBuffer, sizeof(nameBuffer), "Install via API (%u packages)", options->packages_count);
+    snprintf(descriptionBuffer, sizeof(descriptionBuffer), "Installation of %u packages requested via served API", options->packages_count);
+
+    transactionId = __batch_new(&nameBuffer[0], &descriptionBuffer[0], packages, (int)options->packages_count);
+    free(packages);
+    chef_served_install_batch_response(message, transactionId);
+}
+
 void chef_served_remove_invocation(struct gracht_message* message, const char* packageName)
 {
     unsigned int transactionId;
@@ -123,12 +196,35 @@ void chef_served_update_invocation(struct gracht_message* message, const struct
     char         nameBuffer[256];
     char         descriptionBuffer[512];
     
-    // Update options now contains an array of packages to update
-    // For now, we'll handle the first package if any are provided
+    // Update options contain an array of packages to update, several packages
+    // are updated together as a batch
     if (options->packages_count == 0) {
         VLOG_WARNING("api", "chef_served_update_invocation: no packages specified\n");
         return;
     }
+
+    if (options->packages_count > 1) {
+        struct state_transaction* packages;
+
+        packages = calloc(options->packages_count, sizeof(struct state_transaction));
+        if (packages == NULL) {
+            VLOG_WARNING("api", "failed to allocate memory!\n");
+            chef_served_update_response(message, 0);
+            return;
+        }
+
+        for (uint32_t i = 0; i < options->packages_count; i++) {
+            packages[i].name = options->packages[i].name;
+        }
+
+        snprintf(nameBuffer, sizeof(nameBuffer), "Update via API (%u packages)", options->packages_count);
+        snprintf(descriptionBuffer, sizeof(descriptionBuffer), "Update of %u packages requested via served API", options->packages_count);
+
+        transactionId = __batch_new(&nameBuffer[0], &descriptionBuffer[0], packages, (int)options->packages_count);
+        free(packages);
+        chef_served_update_response(message, transactionId);
+        return;
+    }
     
     VLOG_DEBUG("api", "chef_served_update_invocation(package=%s)\n", options->packages[0].name);
 
@@ -254,6 +350,19 @@ void chef_served_list_invocation(struct gracht_message* message)
     free(infos);
 }
 
+void chef_served_load_invocation(struct gracht_message* message, const char* packageName)
+{
+    int status;
+    VLOG_DEBUG("api", "chef_served_load_invocation(package=%s)\n", packageName);
+
+    status = served_application_load(packageName);
+    if (status) {
+        VLOG_ERROR("api", "failed to load package %s: %s\n", packageName, strerror(errno));
+        status = errno != 0 ? errno : EIO;
+    }
+    chef_served_load_response(message, status);
+}
+
 void chef_served_logs_invocation(struct gracht_message* message, unsigned int transaction_id)
 {
     struct state_transaction_log*      logs = NULL;
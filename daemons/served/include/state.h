@@ -52,8 +52,9 @@ struct state_transaction {
     int         revision;   /**< Package revision number */
     
     // Transaction logs
-    struct state_transaction_log* logs;       /**< Array of log entries */
-    int                           logs_count; /**< Number of log entries */
+    struct state_transaction_log* logs;          /**< Array of log entries */
+    int                           logs_count;    /**< Number of log entries */
+    int                           logs_capacity; /**< Allocated number of log entries */
 };
 
 /**
@@ -119,6 +120,10 @@ extern int served_state_load(void);
  * State locks can be nested, but each lock must have a corresponding unlock.
  * All state modifications are deferred until the final unlock to provide
  * transactional semantics.
+ *
+ * Transactions are executed concurrently, so the lock must only be held for
+ * short in-memory reads and modifications. Copy what is needed and unlock
+ * before doing any I/O. Pointers into the state are not valid after unlocking.
  */
 extern void served_state_lock(void);
 
@@ -128,12 +133,14 @@ extern void served_state_lock(void);
  * 
  * When the lock count reaches zero, all deferred database operations are
  * executed atomically within a SQLite transaction. This ensures consistency
- * and batches writes for better performance.
+ * and batches writes for better performance. Commits are appended to the
+ * write-ahead log, which is checkpointed periodically and by served_state_flush().
  */
 extern void served_state_unlock(void);
 
 /**
- * @brief Saves the current state to disk.
+ * @brief Saves the current state to disk. This checkpoints the write-ahead log
+ * into the database file and syncs it.
  * 
  * @return int 0 on success, -1 on failure.
  */
@@ -190,6 +197,62 @@ extern int served_state_remove_application(struct state_application* application
  */
 extern int served_state_get_applications(struct state_application** applicationsOut, int* applicationsCount);
 
+/**
+ * @brief Creates a detached copy of an application that remains valid after the
+ * state is unlocked. This allows transaction handlers to talk to the container
+ * service or the filesystem without holding the state lock. The copy contains
+ * the commands and the container id, but not the revisions.
+ *
+ * @param name The application name to copy
+ * @return struct state_application* The copy, or NULL with errno set on failure.
+ *         Must be freed with served_state_application_copy_free.
+ */
+extern struct state_application* served_state_application_copy(const char* name);
+
+/**
+ * @brief Frees an application that is not part of the state, like the copies
+ * returned by served_state_application_copy.
+ *
+ * @param application The application to free, may be NULL
+ */
+extern void served_state_application_copy_free(struct state_application* application);
+
+/**
+ * @brief Retrieves a snapshot of the names of all applications.
+ *
+ * @return char** A NULL terminated array of names that must be freed with
+ *         strsplit_free, or NULL on failure.
+ */
+extern char** served_state_application_names(void);
+
+/**
+ * @brief Retrieves a snapshot of the packages a transaction operates on. Batch
+ * transactions have an entry for each package, other transactions have one.
+ *
+ * @param id The transaction ID to look up
+ * @param countOut A pointer to receive the number of packages (must not be NULL)
+ * @return struct state_transaction* The packages in the order they were added, or NULL
+ *         with errno set on failure. Must be freed with served_state_transaction_packages_free.
+ */
+extern struct state_transaction* served_state_transaction_packages(unsigned int id, int* countOut);
+
+/**
+ * @brief Frees the packages returned by served_state_transaction_packages.
+ *
+ * @param packages The packages to free, may be NULL
+ * @param count The number of packages
+ */
+extern void served_state_transaction_packages_free(struct state_transaction* packages, int count);
+
+/**
+ * @brief Retrieves a snapshot of the names of the packages a transaction operates on.
+ *
+ * @param id The transaction ID to look up
+ * @return char** A NULL terminated array of names that must be freed with
+ *         strsplit_free, or NULL on failure.
+ */
+extern char** served_state_transaction_package_names(unsigned int id);
+
 /**
  * @brief Creates a new transaction with the provided options.
  * 
@@ -265,6 +328,8 @@ extern int served_state_get_transactions(struct served_transaction** transaction
  * @brief Creates a new transaction state entry for a specific transaction.
  * 
  * Transaction states track individual package operations within a transaction.
+ * Batch transactions have a state entry for each of their packages. The strings
+ * of the entry are copied.
  * The operation is deferred until served_state_unlock() is called, but the
  * state is immediately available in memory.
  * 
@@ -78,6 +78,25 @@ static const struct served_sm_state* g_stateSetUpdate[] = {
     &g_stateCompleted, &g_stateError, &g_stateCancelled
 };
 
+// Batches install or update a set of packages as one transaction. Packages are
+// downloaded and verified concurrently, their applications are added to the state
+// at once and loaded together.
+static const struct served_sm_state* g_stateSetBatch[] = {
+    &g_statePreCheck,
+    &g_stateDownloadBatch,
+    &g_stateVerifyBatch,
+    &g_stateDependenciesBatch,
+    &g_stateRemoveWrappersBatch,
+    &g_stateStopServicesBatch,
+    &g_stateUnloadBatch,
+    &g_stateInstallBatch,
+    &g_stateLoadBatch,
+    &g_stateStartServicesBatch,
+    &g_stateGenerateWrappersBatch,
+
+    &g_stateCompleted, &g_stateError, &g_stateCancelled
+};
+
 // Ephemeral transactions for startup and shutdown
 static const struct served_sm_state* g_stateSetStartup[] = {
     &g_stateLoadAll,
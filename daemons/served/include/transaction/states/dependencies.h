@@ -24,6 +24,7 @@
 
 extern enum sm_action_result served_handle_state_dependencies(void* context);
 extern enum sm_action_result served_handle_state_dependencies_wait(void* context);
+extern enum sm_action_result served_handle_state_dependencies_batch(void* context);
 
 static const struct served_sm_state g_stateDependencies = {
     .state = SERVED_TX_STATE_DEPENDENCIES,
@@ -50,4 +51,16 @@ static const struct served_sm_state g_stateDependenciesWait = {
     }
 };
 
+static const struct served_sm_state g_stateDependenciesBatch = {
+    .state = SERVED_TX_STATE_DEPENDENCIES,
+    .action = served_handle_state_dependencies_batch,
+    .transition_count = 4,
+    .transitions = {
+        { SERVED_TX_EVENT_OK,     SERVED_TX_STATE_REMOVE_WRAPPERS },
+        { SERVED_TX_EVENT_RETRY,  SERVED_TX_STATE_DOWNLOAD },
+        { SERVED_TX_EVENT_FAILED, SERVED_TX_STATE_ERROR },
+        { SERVED_TX_EVENT_CANCEL, SERVED_TX_STATE_CANCELLED }
+    }
+};
+
 #endif //!__SERVED_TRANSACTION_STATE_DEPENDENCIES_H__
@@ -24,6 +24,7 @@
 
 extern enum sm_action_result served_handle_state_download(void* context);
 extern enum sm_action_result served_handle_state_download_retry(void* context);
+extern enum sm_action_result served_handle_state_download_batch(void* context);
 
 static const struct served_sm_state g_stateDownload = {
     .state = SERVED_TX_STATE_DOWNLOAD,
@@ -47,4 +48,15 @@ static const struct served_sm_state g_stateDownloadRetry = {
     }
 };
 
+static const struct served_sm_state g_stateDownloadBatch = {
+    .state = SERVED_TX_STATE_DOWNLOAD,
+    .action = served_handle_state_download_batch,
+    .transition_count = 3,
+    .transitions = {
+        { SERVED_TX_EVENT_OK,     SERVED_TX_STATE_VERIFY },
+        { SERVED_TX_EVENT_FAILED, SERVED_TX_STATE_ERROR },
+        { SERVED_TX_EVENT_CANCEL, SERVED_TX_STATE_CANCELLED }
+    }
+};
+
 #endif //!__SERVED_TRANSACTION_STATE_PRECHECK_H__
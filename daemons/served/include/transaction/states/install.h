@@ -23,6 +23,7 @@
 #include "types.h"
 
 extern enum sm_action_result served_handle_state_install(void* context);
+extern enum sm_action_result served_handle_state_install_batch(void* context);
 
 static const struct served_sm_state g_stateInstall = {
     .state = SERVED_TX_STATE_INSTALL,
@@ -35,4 +36,15 @@ static const struct served_sm_state g_stateInstall = {
     }
 };
 
+static const struct served_sm_state g_stateInstallBatch = {
+    .state = SERVED_TX_STATE_INSTALL,
+    .action = served_handle_state_install_batch,
+    .transition_count = 3,
+    .transitions = {
+        { SERVED_TX_EVENT_OK,     SERVED_TX_STATE_LOAD },
+        { SERVED_TX_EVENT_FAILED, SERVED_TX_STATE_ERROR },
+        { SERVED_TX_EVENT_CANCEL, SERVED_TX_STATE_CANCELLED }
+    }
+};
+
 #endif //!__SERVED_TRANSACTION_STATE_INSTALL_H__
@@ -24,6 +24,24 @@
 
 extern enum sm_action_result served_handle_state_load(void* context);
 extern enum sm_action_result served_handle_state_load_all(void* context);
+extern enum sm_action_result served_handle_state_load_batch(void* context);
+
+/**
+ * @brief Enables deferred loading during startup. When enabled, only applications
+ * that provide services are loaded when served starts, the rest are loaded the
+ * first time one of their commands is executed.
+ *
+ * @param enabled Non-zero to defer loading of applications without services
+ */
+extern void served_load_set_deferred(int enabled);
+
+/**
+ * @brief Loads the container of an application if it is not already loaded.
+ *
+ * @param name The name of the application in the form publisher/package
+ * @return int 0 if the application is loaded, -1 with errno set on failure
+ */
+extern int served_application_load(const char* name);
 
 static const struct served_sm_state g_stateLoad = {
     .state = SERVED_TX_STATE_LOAD,
@@ -47,4 +65,15 @@ static const struct served_sm_state g_stateLoadAll = {
     }
 };
 
+static const struct served_sm_state g_stateLoadBatch = {
+    .state = SERVED_TX_STATE_LOAD,
+    .action = served_handle_state_load_batch,
+    .transition_count = 3,
+    .transitions = {
+        { SERVED_TX_EVENT_OK,     SERVED_TX_STATE_START_SERVICES },
+        { SERVED_TX_EVENT_FAILED, SERVED_TX_STATE_ERROR },
+        { SERVED_TX_EVENT_CANCEL, SERVED_TX_STATE_CANCELLED }
+    }
+};
+
 #endif //!__SERVED_TRANSACTION_STATE_LOAD_H__
@@ -24,6 +24,7 @@
 
 extern enum sm_action_result served_handle_state_remove_wrappers(void* context);
 extern enum sm_action_result served_handle_state_remove_wrappers_all(void* context);
+extern enum sm_action_result served_handle_state_remove_wrappers_batch(void* context);
 
 static const struct served_sm_state g_stateRemoveWrappers = {
     .state = SERVED_TX_STATE_REMOVE_WRAPPERS,
@@ -47,4 +48,15 @@ static const struct served_sm_state g_stateRemoveWrappersAll = {
     }
 };
 
+static const struct served_sm_state g_stateRemoveWrappersBatch = {
+    .state = SERVED_TX_STATE_REMOVE_WRAPPERS,
+    .action = served_handle_state_remove_wrappers_batch,
+    .transition_count = 3,
+    .transitions = {
+        { SERVED_TX_EVENT_OK,     SERVED_TX_STATE_STOP_SERVICES },
+        { SERVED_TX_EVENT_FAILED, SERVED_TX_STATE_ERROR },
+        { SERVED_TX_EVENT_CANCEL, SERVED_TX_STATE_CANCELLED }
+    }
+};
+
 #endif //!__SERVED_TRANSACTION_STATE_REMOVE_WRAPPERS_H__
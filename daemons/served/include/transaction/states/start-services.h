@@ -24,6 +24,7 @@
 
 extern enum sm_action_result served_handle_state_start_services(void* context);
 extern enum sm_action_result served_handle_state_start_services_all(void* context);
+extern enum sm_action_result served_handle_state_start_services_batch(void* context);
 
 static const struct served_sm_state g_stateStartServices = {
     .state = SERVED_TX_STATE_START_SERVICES,
@@ -47,4 +48,15 @@ static const struct served_sm_state g_stateStartServicesAll = {
     }
 };
 
+static const struct served_sm_state g_stateStartServicesBatch = {
+    .state = SERVED_TX_STATE_START_SERVICES,
+    .action = served_handle_state_start_services_batch,
+    .transition_count = 3,
+    .transitions = {
+        { SERVED_TX_EVENT_OK,     SERVED_TX_STATE_GENERATE_WRAPPERS },
+        { SERVED_TX_EVENT_FAILED, SERVED_TX_STATE_ERROR },
+        { SERVED_TX_EVENT_CANCEL, SERVED_TX_STATE_CANCELLED }
+    }
+};
+
 #endif //!__SERVED_TRANSACTION_STATE_START_SERVICES_H__
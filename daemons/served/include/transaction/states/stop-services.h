@@ -24,6 +24,7 @@
 
 extern enum sm_action_result served_handle_state_stop_services(void* context);
 extern enum sm_action_result served_handle_state_stop_services_all(void* context);
+extern enum sm_action_result served_handle_state_stop_services_batch(void* context);
 
 static const struct served_sm_state g_stateStopServices = {
     .state = SERVED_TX_STATE_STOP_SERVICES,
@@ -47,4 +48,15 @@ static const struct served_sm_state g_stateStopServicesAll = {
     }
 };
 
+static const struct served_sm_state g_stateStopServicesBatch = {
+    .state = SERVED_TX_STATE_STOP_SERVICES,
+    .action = served_handle_state_stop_services_batch,
+    .transition_count = 3,
+    .transitions = {
+        { SERVED_TX_EVENT_OK,     SERVED_TX_STATE_UNLOAD },
+        { SERVED_TX_EVENT_FAILED, SERVED_TX_STATE_ERROR },
+        { SERVED_TX_EVENT_CANCEL, SERVED_TX_STATE_CANCELLED }
+    }
+};
+
 #endif //!__SERVED_TRANSACTION_STATE_STOP_SERVICES_H__
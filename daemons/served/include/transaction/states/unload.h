@@ -24,6 +24,7 @@
 
 extern enum sm_action_result served_handle_state_unload(void* context);
 extern enum sm_action_result served_handle_state_unload_all(void* context);
+extern enum sm_action_result served_handle_state_unload_batch(void* context);
 
 static const struct served_sm_state g_stateUnload = {
     .state = SERVED_TX_STATE_UNLOAD,
@@ -49,4 +50,15 @@ static const struct served_sm_state g_stateUnloadAll = {
     }
 };
 
+static const struct served_sm_state g_stateUnloadBatch = {
+    .state = SERVED_TX_STATE_UNLOAD,
+    .action = served_handle_state_unload_batch,
+    .transition_count = 3,
+    .transitions = {
+        { SERVED_TX_EVENT_OK,     SERVED_TX_STATE_INSTALL },
+        { SERVED_TX_EVENT_FAILED, SERVED_TX_STATE_ERROR },
+        { SERVED_TX_EVENT_CANCEL, SERVED_TX_STATE_CANCELLED }
+    }
+};
+
 #endif //!__SERVED_TRANSACTION_STATE_UNLOAD_H__
@@ -23,6 +23,7 @@
 #include "types.h"
 
 extern enum sm_action_result served_handle_state_verify(void* context);
+extern enum sm_action_result served_handle_state_verify_batch(void* context);
 
 static const struct served_sm_state g_stateVerify = {
     .state = SERVED_TX_STATE_VERIFY,
@@ -35,4 +36,15 @@ static const struct served_sm_state g_stateVerify = {
     }
 };
 
+static const struct served_sm_state g_stateVerifyBatch = {
+    .state = SERVED_TX_STATE_VERIFY,
+    .action = served_handle_state_verify_batch,
+    .transition_count = 3,
+    .transitions = {
+        { SERVED_TX_EVENT_OK,     SERVED_TX_STATE_DEPENDENCIES },
+        { SERVED_TX_EVENT_FAILED, SERVED_TX_STATE_ERROR },
+        { SERVED_TX_EVENT_CANCEL, SERVED_TX_STATE_CANCELLED }
+    }
+};
+
 #endif //!__SERVED_TRANSACTION_STATE_VERIFY_H__
@@ -29,7 +29,9 @@ enum served_transaction_type {
     SERVED_TRANSACTION_TYPE_UNINSTALL,
     SERVED_TRANSACTION_TYPE_UPDATE,
     SERVED_TRANSACTION_TYPE_ROLLBACK,
-    SERVED_TRANSACTION_TYPE_CONFIGURE
+    SERVED_TRANSACTION_TYPE_CONFIGURE,
+    // Installs or updates a set of packages as one transaction
+    SERVED_TRANSACTION_TYPE_BATCH
 };
 
 enum served_transaction_wait_type {
@@ -62,6 +64,17 @@ struct served_transaction {
         unsigned long long bytes_total;
         unsigned int       last_reported_percentage;
     } io_progress;
+
+    // Digest of the package computed while it was reconstructed from a delta,
+    // lets the verify state skip reading the package again. Not persisted.
+    unsigned char                  package_digest[64];
+    unsigned int                   package_digest_length;
+
+    // Runner bookkeeping, not persisted. The application is the package the
+    // transaction operates on, transactions without one run exclusively.
+    const char*                    application;
+    int                            started;
+    int                            executing;
 };
 
 struct served_transaction_options {
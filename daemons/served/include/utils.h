@@ -19,6 +19,8 @@
 #ifndef __SERVED_UTILS_H__
 #define __SERVED_UTILS_H__
 
+#include <stddef.h>
+
 typedef struct gracht_server gracht_server_t;
 struct chef_config_address;
 
@@ -38,6 +40,24 @@ extern int utils_verify_publisher(const char* publisher);
  */
 extern int utils_verify_package(const char* publisher, const char* package, int revision);
 
+/**
+ * @brief Verifies the package and it's publisher against the database of proofs, using
+ * a digest of the package computed by utils_package_digest_* instead of reading the package.
+ */
+extern int utils_verify_package_digest(const char* publisher, const char* package, int revision,
+    const unsigned char* digest, unsigned int digestLength);
+
+/**
+ * @brief Incremental digest of a package as used for verification. utils_package_digest_update
+ * matches the stream callback of store_delta_options, so the package can be digested while it
+ * is written. utils_package_digest_finish fails if nothing was digested.
+ */
+struct utils_package_digest;
+extern struct utils_package_digest* utils_package_digest_new(void);
+extern void utils_package_digest_update(const void* data, size_t length, void* context);
+extern int  utils_package_digest_finish(struct utils_package_digest* digest, unsigned char* out, unsigned int* lengthOut);
+extern void utils_package_digest_delete(struct utils_package_digest* digest);
+
 /**
  * @brief Splits a package name in the format of <publisher>/<package> into their subparts
  * The array must be freed with strsplit_free from chef/platform.h
@@ -57,6 +77,14 @@ extern char* utils_base_to_store_id(const char* base);
  */
 extern char* served_paths_path(const char* path);
 
+/**
+ * @brief Invokes <work> once for each index in [0, count) from up to <workers> threads,
+ * the calling thread included, and returns when all invocations have completed. The
+ * work function must synchronize access to anything it shares through <context>.
+ */
+#define UTILS_PARALLEL_WORKERS_MAX 16
+extern void utils_parallel_foreach(int count, int workers, void (*work)(int index, void* context), void* context);
+
 // The following functions return paths already adjusted by served_paths_path
 extern void  utils_path_set_root(const char* root);
 extern char* utils_path_pack(const char* publisher, const char* package);
@@ -25,6 +25,7 @@
 #include <utils.h>
 #include <signal.h>
 #include <stdio.h>
+#include <transaction/states/load.h>
 #include <vlog.h>
 
 // server protocol
@@ -114,6 +115,9 @@ int main(int argc, char** argv)
         if (strcmp(argv[i], "--root") == 0 && i + 1 < argc) {
             utils_path_set_root(argv[i + 1]);
             i++; // skip next argument as it's the root path
+        } else if (strcmp(argv[i], "--defer-load") == 0) {
+            // only load applications with services during startup
+            served_load_set_deferred(1);
         }
     }
 
@@ -127,6 +131,9 @@ int main(int argc, char** argv)
     // must register this first as we want it called last!
     atexit(vlog_cleanup);
 
+    // the daemon logs from multiple threads, keep them off the log I/O
+    vlog_set_async(1);
+
     status = chef_dirs_initialize(CHEF_DIR_SCOPE_DAEMON);
     if (status) {
         VLOG_ERROR("served", "failed to initialize directory code\n", status);
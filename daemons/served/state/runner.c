@@ -21,6 +21,7 @@
 #include <stdlib.h>
 #include <state.h>
 #include <stdio.h>
+#include <string.h>
 #include <threads.h>
 #include <time.h>
 #include <utils.h>
@@ -40,15 +41,54 @@ static cnd_t  g_runner_cond;
 static int    g_runner_should_stop = 0;
 static int    g_runner_is_running = 0;
 
-// Transaction queues
-static mtx_t       g_queue_lock;
-static struct list g_active_transactions = { 0 };
-static struct list g_waiting_transactions = { 0 };
-
-// Runner tick rate (milliseconds between execute cycles)
+// Transaction queues, the queue condition is signalled whenever a transaction
+// may have become runnable
+static mtx_t        g_queue_lock;
+static cnd_t        g_queue_cond;
+static struct list  g_active_transactions = { 0 };
+static struct list  g_waiting_transactions = { 0 };
+static unsigned int g_adopted_id = 0;
+static int          g_workers_should_stop = 0;
+
+// Worker threads executing transactions. Transactions on different applications
+// run concurrently, transactions on the same application run in order.
+#define RUNNER_WORKER_COUNT 4
+static thrd_t g_runner_workers[RUNNER_WORKER_COUNT];
+static int    g_runner_workers_count = 0;
+
+// Runner tick rate (milliseconds between scheduling cycles)
 #define RUNNER_TICK_S  0
 #define RUNNER_TICK_MS 500
 
+// The queues can be used before the runner is started, the startup transaction
+// is queued while the system is initializing
+static once_flag g_runner_once = ONCE_FLAG_INIT;
+static int       g_runner_initialized = 0;
+
+static void __runner_initialize(void)
+{
+    if (mtx_init(&g_runner_lock, mtx_plain) != thrd_success) {
+        VLOG_ERROR("served", "served_runner_start: failed to initialize mutex\n");
+        return;
+    }
+    
+    if (cnd_init(&g_runner_cond) != thrd_success) {
+        VLOG_ERROR("served", "served_runner_start: failed to initialize condition variable\n");
+        return;
+    }
+    
+    if (mtx_init(&g_queue_lock, mtx_plain) != thrd_success) {
+        VLOG_ERROR("served", "served_runner_start: failed to initialize queue mutex\n");
+        return;
+    }
+
+    if (cnd_init(&g_queue_cond) != thrd_success) {
+        VLOG_ERROR("served", "served_runner_start: failed to initialize queue condition variable\n");
+        return;
+    }
+    g_runner_initialized = 1;
+}
+
 // Map internal sm_state_t to protocol transaction_state enum
 enum chef_transaction_state served_transaction_map_state(sm_state_t state)
 {
@@ -163,6 +203,10 @@ static void __state_set_from_type(struct served_sm_state_set* set, enum served_t
         set->states = g_stateSetUpdate;
         set->states_count = 18;
         break;
+    case SERVED_TRANSACTION_TYPE_BATCH:
+        set->states = g_stateSetBatch;
+        set->states_count = 14;
+        break;
     default:
         VLOG_ERROR("served", "__state_set_from_type: unsupported transaction type: %d\n", type);
         set->states = NULL;
@@ -181,6 +225,11 @@ static int __is_wait_satisfied(struct served_transaction* txn)
         case SERVED_TRANSACTION_WAIT_TYPE_TRANSACTION: {
             // Check if the transaction we're waiting for still exists
             struct list_item* i;
+
+            // Transactions that have not been picked up by the runner yet
+            if (txn->wait.data.transaction_id > g_adopted_id) {
+                return 0;
+            }
             
             // Check active transactions
             list_foreach(&g_active_transactions, i) {
@@ -212,13 +261,13 @@ static int __is_wait_satisfied(struct served_transaction* txn)
     }
 }
 
-// Check waiting transactions and resume those whose conditions are met
+// Check waiting transactions and resume those whose conditions are met, expects
+// the queue lock to be held
 static void __process_waiting_transactions(void)
 {
     struct list_item* i;
     struct list_item* next;
     
-    mtx_lock(&g_queue_lock);
     list_foreach_safe(&g_waiting_transactions, i, next) {
         struct served_transaction* txn = (struct served_transaction*)i;
         
@@ -235,35 +284,50 @@ static void __process_waiting_transactions(void)
             // Will be persisted in next update
         }
     }
-    mtx_unlock(&g_queue_lock);
 }
 
-static int __reconstruct_transactions_from_db(void)
+// __adopt_transactions picks up persisted transactions that the runner does not
+// know of yet. On startup these are the transactions that were interrupted, while
+// running these are the transactions that have been queued through the API. The
+// state lock and the queue lock are never held at the same time.
+static int __adopt_transactions(void)
 {
     struct served_transaction* transactions;
     int                        transactionsCount;
-    struct served_transaction* runtimes;
+    struct list                adopted = { 0 };
+    unsigned int               adoptedId;
+    struct list_item*          i;
+    struct list_item*          next;
     int                        status;
 
+    served_state_lock();
     status = served_state_get_transactions(&transactions, &transactionsCount);
     if (status) {
-        VLOG_ERROR("served", "__reconstruct_transactions_from_db: failed to get transactions: %d\n", status);
+        served_state_unlock();
+        VLOG_ERROR("served", "__adopt_transactions: failed to get transactions: %d\n", status);
         return -1;
     }
 
-    runtimes = calloc(transactionsCount, sizeof(struct served_transaction));
-    if (runtimes == NULL) {
-        VLOG_ERROR("served", "__reconstruct_transactions_from_db: failed to allocate runtime transactions\n");
-        return -1;
-    }
+    adoptedId = g_adopted_id;
+    for (int j = 0; j < transactionsCount; j++) {
+        struct served_transaction* persisted = &transactions[j];
+        struct served_transaction* runtime;
+        struct state_transaction*  state;
+
+        if (persisted->id <= g_adopted_id) {
+            continue;
+        }
+
+        if (persisted->id > adoptedId) {
+            adoptedId = persisted->id;
+        }
+
+        if (persisted->completed_at != 0) {
+            continue;
+        }
 
-    mtx_lock(&g_queue_lock);
-    for (int i = 0; i < transactionsCount; i++) {
-        struct served_transaction* persisted = &transactions[i];
-        struct served_transaction* runtime = &runtimes[i];
-        
         // Construct transaction from persisted data
-        served_transaction_construct(runtime, &(struct served_transaction_options) {
+        runtime = served_transaction_new(&(struct served_transaction_options) {
             .id = persisted->id,
             .name = persisted->name,
             .description = persisted->description,
@@ -271,19 +335,44 @@ static int __reconstruct_transactions_from_db(void)
             .initialState = served_sm_current_state(&persisted->sm),
             .wait = persisted->wait
         });
-        
+        if (runtime == NULL) {
+            VLOG_ERROR("served", "__adopt_transactions: failed to allocate runtime transaction %u\n", persisted->id);
+            continue;
+        }
+
+        // The package the transaction operates on determines which transactions
+        // it can run alongside with, batches operate on several packages and run
+        // exclusively
+        state = served_state_transaction(persisted->id);
+        if (persisted->type != SERVED_TRANSACTION_TYPE_BATCH && state != NULL && state->name != NULL) {
+            runtime->application = platform_strdup(state->name);
+        }
+
+        // Interrupted transactions already own their application
+        runtime->started = runtime->wait.type != SERVED_TRANSACTION_WAIT_TYPE_NONE ||
+            served_sm_current_state(&runtime->sm) != 0;
+        list_add(&adopted, &runtime->list_header);
+    }
+    served_state_unlock();
+
+    mtx_lock(&g_queue_lock);
+    g_adopted_id = adoptedId;
+    list_foreach_safe(&adopted, i, next) {
+        struct served_transaction* runtime = (struct served_transaction*)i;
+
+        list_remove(&adopted, i);
+
         // Add to appropriate queue based on wait state
         if (runtime->wait.type == SERVED_TRANSACTION_WAIT_TYPE_NONE) {
             list_add(&g_active_transactions, &runtime->list_header);
-            VLOG_DEBUG("served", "__reconstruct_transactions_from_db: reconstructed active transaction %u (type=%d, state=%d)\n",
+            VLOG_DEBUG("served", "__adopt_transactions: adopted active transaction %u (type=%d, state=%d)\n",
                        runtime->id, runtime->type, served_sm_current_state(&runtime->sm));
         } else {
             list_add(&g_waiting_transactions, &runtime->list_header);
-            VLOG_DEBUG("served", "__reconstruct_transactions_from_db: reconstructed waiting transaction %u (type=%d, state=%d, wait=%d)\n",
+            VLOG_DEBUG("served", "__adopt_transactions: adopted waiting transaction %u (type=%d, state=%d, wait=%d)\n",
                        runtime->id, runtime->type, served_sm_current_state(&runtime->sm), runtime->wait.type);
         }
     }
-    
     mtx_unlock(&g_queue_lock);
     return 0;
 }
@@ -344,16 +433,13 @@ static void __handle_transaction_done(struct served_transaction* txn, enum sm_ac
         );
     }
     
-    // Mark transaction as completed and perform cleanup
+    // Mark transaction as completed, the runtime transaction is cleaned up by the
+    // worker once the queue lock has been retaken
     if (txn->type != SERVED_TRANSACTION_TYPE_EPHEMERAL) {
         served_state_lock();
         served_state_transaction_complete(txn->id);
         served_state_unlock();
     }
-    
-    // Remove from active queue
-    list_remove(&g_active_transactions, &txn->list_header);
-    served_transaction_delete(txn);
 }
 
 static void __handle_on_transition(struct served_transaction* txn, sm_state_t newState)
@@ -363,9 +449,11 @@ static void __handle_on_transition(struct served_transaction* txn, sm_state_t ne
     unsigned int                step          = __calculate_step(txn);
     unsigned int                totalSteps    = (unsigned int)txn->sm.states.states_count;
     
+    served_state_lock();
     if (served_state_transaction_update(txn) != 0) {
         VLOG_ERROR("served", "served_runner_execute: failed to update transaction %u state\n", txn->id);
     }
+    served_state_unlock();
 
     chef_served_event_transaction_state_changed_all(
         served_gracht_server(),
@@ -384,42 +472,113 @@ static void __handle_on_transition(struct served_transaction* txn, sm_state_t ne
     );
 }
 
-void served_runner_execute(void)
+static int __is_exclusive(struct served_transaction* txn)
+{
+    // System transactions touch all applications, and so do transactions that we
+    // could not resolve an application for
+    return txn->type == SERVED_TRANSACTION_TYPE_EPHEMERAL || txn->application == NULL;
+}
+
+static int __conflicts_in(struct list* list, struct served_transaction* txn)
 {
     struct list_item* i;
-    struct list_item* next;
-    
-    __process_waiting_transactions();
 
-    VLOG_DEBUG("served", "served_runner_execute: processing %d active, %d waiting transactions\n",
-               g_active_transactions.count, g_waiting_transactions.count);
-    
-    // Use safe iteration since we may move transactions to waiting queue
-    mtx_lock(&g_queue_lock);
-    list_foreach_safe(&g_active_transactions, i, next) {
-        struct served_transaction* txn = (struct served_transaction*)i;
-        sm_state_t                 oldState = served_sm_current_state(&txn->sm);
-        sm_state_t                 newState;
-        enum sm_action_result      result;
+    list_foreach(list, i) {
+        struct served_transaction* other = (struct served_transaction*)i;
+        // A transaction owns its application from the moment it executes its first
+        // step until it is done, including while it is waiting on other transactions
+        if (other == txn || !other->started) {
+            continue;
+        }
 
-        VLOG_DEBUG("served", "served_runner_execute: processing transaction %u (state=%d)\n", txn->id, oldState);
+        if (__is_exclusive(txn) || __is_exclusive(other) ||
+            strcmp(txn->application, other->application) == 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
 
-        // Is this the first event?
-        if (oldState == 0) {
-            __handle_on_start(txn);
+// __claim_transaction finds the first transaction that has pending events and
+// does not conflict with any started transaction. Expects the queue lock held.
+static struct served_transaction* __claim_transaction(void)
+{
+    struct list_item* i;
+
+    list_foreach(&g_active_transactions, i) {
+        struct served_transaction* txn = (struct served_transaction*)i;
+        if (txn->executing || txn->sm.event_queue.count == 0) {
+            continue;
+        }
+
+        if (!txn->started && (
+            __conflicts_in(&g_active_transactions, txn) ||
+            __conflicts_in(&g_waiting_transactions, txn))) {
+            continue;
         }
 
-        // Execute the current state's action (only runs on state entry)
-        result = served_sm_execute(&txn->sm);
+        txn->executing = 1;
+        return txn;
+    }
+    return NULL;
+}
 
-        // Emit state change event if state transitioned, but we only do so for
-        // transactions that are not ephemeral. Ephemeral transactions are
-        // not created by users, and thus we don't need to notify about their state changes.
-        newState = served_sm_current_state(&txn->sm);
-        if (newState != oldState && txn->type != SERVED_TRANSACTION_TYPE_EPHEMERAL) {
-            __handle_on_transition(txn, newState);
+// __execute_step runs a single step of the transaction state machine. This is
+// called without the queue lock held, the transaction is owned by the calling
+// worker while it executes.
+static enum sm_action_result __execute_step(struct served_transaction* txn, int first)
+{
+    sm_state_t            oldState = served_sm_current_state(&txn->sm);
+    sm_state_t            newState;
+    enum sm_action_result result;
+
+    VLOG_DEBUG("served", "served_runner_execute: processing transaction %u (state=%d)\n", txn->id, oldState);
+
+    // Is this the first event?
+    if (first) {
+        __handle_on_start(txn);
+    }
+
+    // Execute the current state's action (only runs on state entry)
+    result = served_sm_execute(&txn->sm);
+
+    // Emit state change event if state transitioned, but we only do so for
+    // transactions that are not ephemeral. Ephemeral transactions are
+    // not created by users, and thus we don't need to notify about their state changes.
+    newState = served_sm_current_state(&txn->sm);
+    if (newState != oldState && txn->type != SERVED_TRANSACTION_TYPE_EPHEMERAL) {
+        __handle_on_transition(txn, newState);
+    }
+
+    if (result == SM_ACTION_DONE || result == SM_ACTION_ABORT) {
+        __handle_transaction_done(txn, result);
+    }
+    return result;
+}
+
+static int __runner_worker_main(void* arg)
+{
+    (void)arg;
+
+    mtx_lock(&g_queue_lock);
+    while (!g_workers_should_stop) {
+        struct served_transaction* txn;
+        enum sm_action_result      result;
+        int                        first;
+
+        txn = __claim_transaction();
+        if (txn == NULL) {
+            cnd_wait(&g_queue_cond, &g_queue_lock);
+            continue;
         }
+        first = !txn->started;
+        txn->started = 1;
+        mtx_unlock(&g_queue_lock);
+
+        result = __execute_step(txn, first);
 
+        mtx_lock(&g_queue_lock);
+        txn->executing = 0;
         if (result == SM_ACTION_WAIT) {
             VLOG_DEBUG("served", "Transaction %u entering wait state (type=%d)\n", 
                        txn->id, txn->wait.type);
@@ -427,21 +586,34 @@ void served_runner_execute(void)
             // Move to waiting queue
             list_remove(&g_active_transactions, &txn->list_header);
             list_add(&g_waiting_transactions, &txn->list_header);
-            continue;
         } else if (result == SM_ACTION_DONE || result == SM_ACTION_ABORT) {
-            __handle_transaction_done(txn, result);
-            continue;
+            list_remove(&g_active_transactions, &txn->list_header);
+            served_transaction_delete(txn);
+
+            // waiting transactions may depend on this one
+            __process_waiting_transactions();
         }
+
+        // the transaction may have more steps to run, or its application has
+        // been released for others
+        cnd_broadcast(&g_queue_cond);
     }
     mtx_unlock(&g_queue_lock);
+    return 0;
 }
 
 unsigned int served_transaction_create(struct served_transaction_options* options)
 {
     struct served_transaction* txn;
     unsigned int               transaction_id = 0;
+
+    call_once(&g_runner_once, __runner_initialize);
+    if (!g_runner_initialized) {
+        return 0;
+    }
     
-    // For persistent transactions, create in state first
+    // Persistent transactions are created in the state, and picked up by the
+    // runner on the next scheduling cycle
     if (options->type != SERVED_TRANSACTION_TYPE_EPHEMERAL) {
         served_state_lock();
         transaction_id = served_state_transaction_new(options);
@@ -451,6 +623,12 @@ unsigned int served_transaction_create(struct served_transaction_options* option
             return 0;
         }
         served_state_unlock();  // Commits transaction to database here
+
+        mtx_lock(&g_runner_lock);
+        cnd_signal(&g_runner_cond);
+        mtx_unlock(&g_runner_lock);
+        VLOG_DEBUG("served", "served_transaction_create: created transaction %u\n", transaction_id);
+        return transaction_id;
     }
     
     // Now create the runtime transaction wrapper
@@ -460,11 +638,10 @@ unsigned int served_transaction_create(struct served_transaction_options* option
         return 0;
     }
     
-    txn->id = transaction_id;
-    
     // Add to active queue (new transactions always start active)
     mtx_lock(&g_queue_lock);
     list_add(&g_active_transactions, &txn->list_header);
+    cnd_broadcast(&g_queue_cond);
     mtx_unlock(&g_queue_lock);
     
     VLOG_DEBUG("served", "served_transaction_create: created transaction %u\n", transaction_id);
@@ -481,6 +658,9 @@ void served_transaction_construct(struct served_transaction* transaction, struct
     transaction->description = options->description ? platform_strdup(options->description) : NULL;
     transaction->type = options->type;
     transaction->wait = options->wait;
+    transaction->application = NULL;
+    transaction->executing = 0;
+    transaction->started = 0;
 
     if (options->type == SERVED_TRANSACTION_TYPE_EPHEMERAL) {
         stateSetPtr = options->stateSet;
@@ -516,6 +696,7 @@ void served_transaction_delete(struct served_transaction* transaction)
     
     free((void*)transaction->name);
     free((void*)transaction->description);
+    free((void*)transaction->application);
     free(transaction);
 }
 
@@ -540,10 +721,11 @@ sm_event_t served_transaction_wait(struct served_transaction* transaction, enum
     return SERVED_TX_EVENT_WAIT;
 }
 
-// Runner thread main loop
+// Runner thread main loop, the runner thread schedules transactions while the
+// workers execute them
 static int __runner_thread_main(void* arg)
 {
-    struct timespec sleep_time;
+    struct timespec wakeup_time;
     int             status;
     (void)arg;
     
@@ -551,54 +733,81 @@ static int __runner_thread_main(void* arg)
 
     served_state_lock();
     status = served_state_transaction_cleanup();
+    served_state_unlock();
     if (status) {
         VLOG_ERROR("served", "__runner_thread_main: failed to cleanup old transactions\n");
-        served_state_unlock();
         return -1;
     }
 
-    status = __reconstruct_transactions_from_db();
+    status = __adopt_transactions();
     if (status) {
         VLOG_ERROR("served", "__runner_thread_main: failed to reconstruct transactions from database\n");
-        served_state_unlock();
         return -1;
     }
-    served_state_unlock();
 
     mtx_lock(&g_runner_lock);
     g_runner_is_running = 1;
     
     // Signal that we're ready
-    cnd_signal(&g_runner_cond);
+    cnd_broadcast(&g_runner_cond);
     mtx_unlock(&g_runner_lock);
     
     while (1) {
-        // Check for stop request
+        // Pick up new transactions and resume waiting transactions
+        (void)__adopt_transactions();
+
+        mtx_lock(&g_queue_lock);
+        __process_waiting_transactions();
+        VLOG_DEBUG("served", "__runner_thread_main: %d active, %d waiting transactions\n",
+                   g_active_transactions.count, g_waiting_transactions.count);
+        cnd_broadcast(&g_queue_cond);
+        mtx_unlock(&g_queue_lock);
+
+        // Sleep for tick interval, or until new transactions are created
+        timespec_get(&wakeup_time, TIME_UTC);
+        wakeup_time.tv_sec += RUNNER_TICK_S;
+        wakeup_time.tv_nsec += RUNNER_TICK_MS * 1000000L; // Convert ms to ns
+        if (wakeup_time.tv_nsec >= 1000000000L) {
+            wakeup_time.tv_sec++;
+            wakeup_time.tv_nsec -= 1000000000L;
+        }
+
         mtx_lock(&g_runner_lock);
+        if (!g_runner_should_stop) {
+            cnd_timedwait(&g_runner_cond, &g_runner_lock, &wakeup_time);
+        }
         if (g_runner_should_stop) {
             mtx_unlock(&g_runner_lock);
             break;
         }
         mtx_unlock(&g_runner_lock);
-        
-        // Execute transaction runner cycle
-        served_runner_execute();
-        
-        // Sleep for tick interval
-        sleep_time.tv_sec = RUNNER_TICK_S;
-        sleep_time.tv_nsec = RUNNER_TICK_MS * 1000000; // Convert ms to ns
-        thrd_sleep(&sleep_time, NULL);
     }
     
     mtx_lock(&g_runner_lock);
     g_runner_is_running = 0;
-    cnd_signal(&g_runner_cond);
+    cnd_broadcast(&g_runner_cond);
     mtx_unlock(&g_runner_lock);
     
     VLOG_DEBUG("served", "__runner_thread_main: runner thread stopped\n");
     return 0;
 }
 
+static void __runner_stop_workers(void)
+{
+    mtx_lock(&g_queue_lock);
+    g_workers_should_stop = 1;
+    cnd_broadcast(&g_queue_cond);
+    mtx_unlock(&g_queue_lock);
+
+    // Workers finish the step they are executing before exiting
+    for (int i = 0; i < g_runner_workers_count; i++) {
+        if (thrd_join(g_runner_workers[i], NULL) != thrd_success) {
+            VLOG_ERROR("served", "served_runner_stop: failed to join worker thread %i\n", i);
+        }
+    }
+    g_runner_workers_count = 0;
+}
+
 int served_runner_start(void)
 {
     int status;
@@ -606,35 +815,31 @@ int served_runner_start(void)
     VLOG_TRACE("served", "served_runner_start()\n");
     
     // Initialize synchronization primitives
-    if (mtx_init(&g_runner_lock, mtx_plain) != thrd_success) {
-        VLOG_ERROR("served", "served_runner_start: failed to initialize mutex\n");
-        return -1;
-    }
-    
-    if (cnd_init(&g_runner_cond) != thrd_success) {
-        VLOG_ERROR("served", "served_runner_start: failed to initialize condition variable\n");
-        mtx_destroy(&g_runner_lock);
-        return -1;
-    }
-    
-    if (mtx_init(&g_queue_lock, mtx_plain) != thrd_success) {
-        VLOG_ERROR("served", "served_runner_start: failed to initialize queue mutex\n");
-        cnd_destroy(&g_runner_cond);
-        mtx_destroy(&g_runner_lock);
+    call_once(&g_runner_once, __runner_initialize);
+    if (!g_runner_initialized) {
         return -1;
     }
     
     // Reset stop flag
     g_runner_should_stop = 0;
     g_runner_is_running = 0;
+    g_workers_should_stop = 0;
+
+    for (int i = 0; i < RUNNER_WORKER_COUNT; i++) {
+        status = thrd_create(&g_runner_workers[i], __runner_worker_main, NULL);
+        if (status != thrd_success) {
+            VLOG_ERROR("served", "served_runner_start: failed to create worker thread %i\n", i);
+            __runner_stop_workers();
+            return -1;
+        }
+        g_runner_workers_count++;
+    }
     
     // Create the runner thread
     status = thrd_create(&g_runner_thread, __runner_thread_main, NULL);
     if (status != thrd_success) {
         VLOG_ERROR("served", "served_runner_start: failed to create runner thread\n");
-        mtx_destroy(&g_queue_lock);
-        cnd_destroy(&g_runner_cond);
-        mtx_destroy(&g_runner_lock);
+        __runner_stop_workers();
         return -1;
     }
     
@@ -645,7 +850,7 @@ int served_runner_start(void)
     }
     mtx_unlock(&g_runner_lock);
     
-    VLOG_DEBUG("served", "served_runner_start: runner thread is now active\n");
+    VLOG_DEBUG("served", "served_runner_start: runner thread is now active with %i workers\n", g_runner_workers_count);
     return 0;
 }
 
@@ -665,6 +870,7 @@ int served_runner_stop(void)
     
     // Request stop
     g_runner_should_stop = 1;
+    cnd_broadcast(&g_runner_cond);
     mtx_unlock(&g_runner_lock);
     
     VLOG_DEBUG("served", "served_runner_stop: waiting for runner thread to stop...\n");
@@ -681,11 +887,8 @@ int served_runner_stop(void)
         cnd_wait(&g_runner_cond, &g_runner_lock);
     }
     mtx_unlock(&g_runner_lock);
-    
-    // Cleanup synchronization primitives
-    mtx_destroy(&g_queue_lock);
-    cnd_destroy(&g_runner_cond);
-    mtx_destroy(&g_runner_lock);
+
+    __runner_stop_workers();
     
     VLOG_DEBUG("served", "served_runner_stop: runner thread stopped successfully\n");
     return 0;
@@ -695,6 +898,7 @@ int served_runner_is_running(void)
 {
     int running;
     
+    call_once(&g_runner_once, __runner_initialize);
     mtx_lock(&g_runner_lock);
     running = g_runner_is_running;
     mtx_unlock(&g_runner_lock);
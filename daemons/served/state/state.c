@@ -168,23 +168,23 @@ struct deferred_operation {
     enum deferred_operation_type type;
     union {
         struct {
-            struct state_application* application;
+            char* application_name;
         } add_app;
         struct {
             char* application_name;
         } remove_app;
         struct {
-            struct served_transaction* transaction;
+            unsigned int transaction_id;
         } add_tx;
         struct {
-            struct served_transaction* transaction;
+            unsigned int transaction_id;
         } update_tx;
         struct {
-            unsigned int              transaction_id;
-            struct state_transaction* transaction;
+            unsigned int transaction_id;
+            int          position;
         } add_tx_state;
         struct {
-            struct state_transaction* transaction;
+            unsigned int transaction_id;
         } update_tx_state;
         struct {
             unsigned int transaction_id;
@@ -200,6 +200,72 @@ struct deferred_operation {
     struct deferred_operation* next;
 };
 
+// Prepared statements that are used for deferred operations and loading. These are prepared
+// once on first use and then reset between uses, instead of being compiled for each operation.
+enum __state_statement {
+    STATE_STMT_SELECT_COMMANDS,
+    STATE_STMT_SELECT_REVISIONS,
+    STATE_STMT_INSERT_APPLICATION,
+    STATE_STMT_INSERT_REVISION,
+    STATE_STMT_INSERT_COMMAND,
+    STATE_STMT_DELETE_APPLICATION,
+    STATE_STMT_INSERT_TRANSACTION,
+    STATE_STMT_UPDATE_TRANSACTION,
+    STATE_STMT_INSERT_TRANSACTION_STATE,
+    STATE_STMT_UPDATE_TRANSACTION_STATE,
+    STATE_STMT_COMPLETE_TRANSACTION,
+    STATE_STMT_INSERT_TRANSACTION_LOG,
+
+    STATE_STMT_COUNT
+};
+
+static const char* g_statementSQL[STATE_STMT_COUNT] = {
+    [STATE_STMT_SELECT_COMMANDS] =
+        "SELECT c.name, c.path, c.arguments, c.type "
+        "FROM applications a "
+        "JOIN commands c ON a.id = c.application_id "
+        "WHERE a.name = ? "
+        "ORDER BY c.id",
+    [STATE_STMT_SELECT_REVISIONS] =
+        "SELECT r.channel, r.major, r.minor, r.patch, r.revision, r.tag, r.size, r.created "
+        "FROM applications a "
+        "JOIN revisions r ON a.id = r.application_id "
+        "WHERE a.name = ? "
+        "ORDER BY r.id",
+    [STATE_STMT_INSERT_APPLICATION] =
+        "INSERT INTO applications (name) "
+        "VALUES (?)",
+    [STATE_STMT_INSERT_REVISION] =
+        "INSERT INTO revisions (application_id, channel, major, minor, patch, revision, tag, size, created) "
+        "VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?)",
+    [STATE_STMT_INSERT_COMMAND] =
+        "INSERT INTO commands (application_id, name, path, arguments, type) "
+        "VALUES (?, ?, ?, ?, ?)",
+    [STATE_STMT_DELETE_APPLICATION] =
+        "DELETE FROM applications WHERE name = ?",
+    [STATE_STMT_INSERT_TRANSACTION] =
+        "INSERT INTO transactions (id, type, state, flags, name, description, wait_type, wait_data) "
+        "VALUES (?, ?, ?, ?, ?, ?, ?, ?)",
+    [STATE_STMT_UPDATE_TRANSACTION] =
+        "UPDATE transactions SET type = ?, state = ?, flags = ?, name = ?, description = ?, "
+        "wait_type = ?, wait_data = ? WHERE id = ?",
+    [STATE_STMT_INSERT_TRANSACTION_STATE] =
+        "INSERT INTO transactions_state (transaction_id, name, channel, revision) "
+        "VALUES (?, ?, ?, ?)",
+    [STATE_STMT_UPDATE_TRANSACTION_STATE] =
+        "UPDATE transactions_state SET name = ?, channel = ?, revision = ? "
+        "WHERE transaction_id = ?",
+    [STATE_STMT_COMPLETE_TRANSACTION] =
+        "UPDATE transactions SET completed_at = strftime('%s', 'now') WHERE id = ?",
+    [STATE_STMT_INSERT_TRANSACTION_LOG] =
+        "INSERT INTO transaction_logs (transaction_id, level, timestamp, state, message) "
+        "VALUES (?, ?, ?, ?, ?)"
+};
+
+// Number of commits between each passive WAL checkpoint. Commits in between are only
+// appended to the WAL, which lets a burst of state changes share the cost of syncing.
+#define STATE_CHECKPOINT_INTERVAL 32
+
 static struct deferred_operation* __deferred_operation_new(enum deferred_operation_type type)
 {
     struct deferred_operation* op = malloc(sizeof(struct deferred_operation));
@@ -211,17 +277,41 @@ static struct deferred_operation* __deferred_operation_new(enum deferred_operati
     return op;
 }
 
+// Open addressed hash index that maps a key to a position in one of the
+// state arrays. The hash is kept in the slot so the index can be grown without
+// having to access the keys again.
+struct __state_index_slot {
+    unsigned int hash;
+    int          position; // position + 1, 0 marks an empty slot
+};
+
+struct __state_index {
+    struct __state_index_slot* slots;
+    int                        capacity;
+    int                        count;
+};
+
 struct __state {
     struct served_transaction* transactions;
     int                        transactions_count;
+    int                        transactions_capacity;
     struct state_transaction*  transaction_states;
     int                        transaction_state_count;
+    int                        transaction_state_capacity;
     struct state_application*  applications_states;
     int                        applications_states_count;
-
-    sqlite3* database;
-    mtx_t    lock;
-    int      lock_count;
+    int                        applications_states_capacity;
+
+    // Indices into the arrays above
+    struct __state_index transactions_index;
+    struct __state_index transaction_states_index;
+    struct __state_index applications_index;
+
+    sqlite3*      database;
+    sqlite3_stmt* statements[STATE_STMT_COUNT];
+    int           commits_since_checkpoint;
+    mtx_t         lock;
+    int           lock_count;
     
     // Transaction ID management
     unsigned int next_transaction_id;
@@ -243,7 +333,8 @@ static struct __state* __state_new(void)
     }
     memset(state, 0, sizeof(struct __state));
 
-    if (mtx_init(&state->lock, mtx_plain) != thrd_success) {
+    // the lock is recursive as handlers may log to the transaction while holding it
+    if (mtx_init(&state->lock, mtx_plain | mtx_recursive) != thrd_success) {
         VLOG_ERROR("served", "__state_new: failed to initialize mutex\n");
         free((void*)state);
         return NULL;
@@ -251,6 +342,262 @@ static struct __state* __state_new(void)
     return state;
 }
 
+static unsigned int __hash_id(unsigned int id)
+{
+    // integer finalizer from murmurhash3
+    id ^= id >> 16;
+    id *= 0x85ebca6bU;
+    id ^= id >> 13;
+    id *= 0xc2b2ae35U;
+    id ^= id >> 16;
+    return id;
+}
+
+static unsigned int __hash_string(const char* string)
+{
+    // FNV-1a
+    unsigned int hash = 2166136261U;
+    while (*string) {
+        hash ^= (unsigned char)*string++;
+        hash *= 16777619U;
+    }
+    return hash;
+}
+
+static void __index_clear(struct __state_index* index)
+{
+    if (index->slots != NULL) {
+        memset(index->slots, 0, sizeof(struct __state_index_slot) * index->capacity);
+    }
+    index->count = 0;
+}
+
+static void __index_destroy(struct __state_index* index)
+{
+    free(index->slots);
+    index->slots = NULL;
+    index->capacity = 0;
+    index->count = 0;
+}
+
+static void __index_place(struct __state_index_slot* slots, int capacity, unsigned int hash, int position)
+{
+    int i = (int)(hash & (unsigned int)(capacity - 1));
+    while (slots[i].position != 0) {
+        i = (i + 1) & (capacity - 1);
+    }
+    slots[i].hash = hash;
+    slots[i].position = position + 1;
+}
+
+static int __index_insert(struct __state_index* index, unsigned int hash, int position)
+{
+    // keep the load factor below 1/2 to keep probe sequences short
+    if ((index->count + 1) * 2 > index->capacity) {
+        int                        capacity = index->capacity ? index->capacity * 2 : 64;
+        struct __state_index_slot* slots;
+
+        slots = calloc(capacity, sizeof(struct __state_index_slot));
+        if (slots == NULL) {
+            return -1;
+        }
+
+        for (int i = 0; i < index->capacity; i++) {
+            if (index->slots[i].position != 0) {
+                __index_place(slots, capacity, index->slots[i].hash, index->slots[i].position - 1);
+            }
+        }
+        free(index->slots);
+        index->slots = slots;
+        index->capacity = capacity;
+    }
+
+    __index_place(index->slots, index->capacity, hash, position);
+    index->count++;
+    return 0;
+}
+
+// Returns the first position in the probe sequence for <hash> that <match> accepts,
+// or -1 if none was found.
+static int __index_find(
+    struct __state_index* index,
+    unsigned int          hash,
+    int                 (*match)(struct __state* state, int position, const void* key),
+    struct __state*       state,
+    const void*           key)
+{
+    int i;
+
+    if (index->capacity == 0) {
+        return -1;
+    }
+
+    i = (int)(hash & (unsigned int)(index->capacity - 1));
+    while (index->slots[i].position != 0) {
+        if (index->slots[i].hash == hash && match(state, index->slots[i].position - 1, key)) {
+            return index->slots[i].position - 1;
+        }
+        i = (i + 1) & (index->capacity - 1);
+    }
+    return -1;
+}
+
+static int __match_transaction(struct __state* state, int position, const void* key)
+{
+    return state->transactions[position].id == *(const unsigned int*)key;
+}
+
+static int __match_transaction_state(struct __state* state, int position, const void* key)
+{
+    return state->transaction_states[position].id == *(const unsigned int*)key;
+}
+
+static int __match_application(struct __state* state, int position, const void* key)
+{
+    return state->applications_states[position].name != NULL &&
+        strcmp(state->applications_states[position].name, (const char*)key) == 0;
+}
+
+static struct served_transaction* __find_transaction(struct __state* state, unsigned int id)
+{
+    int position = __index_find(&state->transactions_index, __hash_id(id), __match_transaction, state, &id);
+    return position < 0 ? NULL : &state->transactions[position];
+}
+
+static struct state_transaction* __find_transaction_state(struct __state* state, unsigned int id)
+{
+    int position = __index_find(&state->transaction_states_index, __hash_id(id), __match_transaction_state, state, &id);
+    return position < 0 ? NULL : &state->transaction_states[position];
+}
+
+static int __find_application_position(struct __state* state, const char* name)
+{
+    return __index_find(&state->applications_index, __hash_string(name), __match_application, state, name);
+}
+
+static int __rebuild_application_index(struct __state* state)
+{
+    __index_clear(&state->applications_index);
+    for (int i = 0; i < state->applications_states_count; i++) {
+        if (state->applications_states[i].name == NULL) {
+            continue;
+        }
+        if (__index_insert(&state->applications_index, __hash_string(state->applications_states[i].name), i)) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static int __rebuild_transaction_indices(struct __state* state)
+{
+    __index_clear(&state->transactions_index);
+    for (int i = 0; i < state->transactions_count; i++) {
+        if (__index_insert(&state->transactions_index, __hash_id(state->transactions[i].id), i)) {
+            return -1;
+        }
+    }
+
+    __index_clear(&state->transaction_states_index);
+    for (int i = 0; i < state->transaction_state_count; i++) {
+        if (__index_insert(&state->transaction_states_index, __hash_id(state->transaction_states[i].id), i)) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// Grows <array> geometrically so it can hold at least <required> elements.
+static int __ensure_capacity(void** array, int* capacity, int required, size_t elementSize)
+{
+    void* newArray;
+    int   newCapacity;
+
+    if (required <= *capacity) {
+        return 0;
+    }
+
+    newCapacity = *capacity ? *capacity : 8;
+    while (newCapacity < required) {
+        newCapacity *= 2;
+    }
+
+    newArray = realloc(*array, elementSize * newCapacity);
+    if (newArray == NULL) {
+        return -1;
+    }
+    *array = newArray;
+    *capacity = newCapacity;
+    return 0;
+}
+
+// Returns a reset, ready-to-bind instance of the requested statement. The statement
+// is owned by the state and must be given back with __statement_release.
+static sqlite3_stmt* __statement(struct __state* state, enum __state_statement which)
+{
+    if (state->statements[which] == NULL) {
+        int status = sqlite3_prepare_v3(
+            state->database, g_statementSQL[which], -1,
+            SQLITE_PREPARE_PERSISTENT, &state->statements[which], NULL
+        );
+        if (status != SQLITE_OK) {
+            VLOG_ERROR("served", "__statement: failed to prepare statement: %s\n", sqlite3_errmsg(state->database));
+            state->statements[which] = NULL;
+            return NULL;
+        }
+    }
+    return state->statements[which];
+}
+
+static void __statement_release(sqlite3_stmt* stmt)
+{
+    sqlite3_reset(stmt);
+    sqlite3_clear_bindings(stmt);
+}
+
+static void __state_close_database(struct __state* state)
+{
+    for (int i = 0; i < STATE_STMT_COUNT; i++) {
+        if (state->statements[i] != NULL) {
+            sqlite3_finalize(state->statements[i]);
+            state->statements[i] = NULL;
+        }
+    }
+
+    if (state->database != NULL) {
+        sqlite3_close(state->database);
+        state->database = NULL;
+    }
+}
+
+static int __configure_database(sqlite3* db)
+{
+    char* errMsg = NULL;
+    int   status;
+
+    // WAL lets commits append to the log instead of rewriting pages through a
+    // rollback journal, and with synchronous=NORMAL the log is only synced at
+    // checkpoints. A crash can lose the most recent commits, but never corrupts
+    // the database.
+    status = sqlite3_exec(db, "PRAGMA journal_mode = WAL", NULL, NULL, &errMsg);
+    if (status != SQLITE_OK) {
+        VLOG_ERROR("served", "__configure_database: failed to enable WAL: %s\n", errMsg);
+        sqlite3_free(errMsg);
+        return status;
+    }
+
+    status = sqlite3_exec(db, "PRAGMA synchronous = NORMAL", NULL, NULL, &errMsg);
+    if (status != SQLITE_OK) {
+        VLOG_ERROR("served", "__configure_database: failed to set synchronous mode: %s\n", errMsg);
+        sqlite3_free(errMsg);
+        return status;
+    }
+
+    // We checkpoint ourselves after a number of commits, see served_state_unlock
+    sqlite3_wal_autocheckpoint(db, 0);
+    return 0;
+}
+
 // Deferred operation queue management
 static void __deferred_operation_free(struct deferred_operation* op)
 {
@@ -259,6 +606,9 @@ static void __deferred_operation_free(struct deferred_operation* op)
     }
 
     switch (op->type) {
+        case DEFERRED_OP_ADD_APPLICATION:
+            free(op->data.add_app.application_name);
+            break;
         case DEFERRED_OP_REMOVE_APPLICATION:
             free(op->data.remove_app.application_name);
             break;
@@ -272,6 +622,7 @@ static void __deferred_operation_free(struct deferred_operation* op)
 static void __clear_deferred_operations(struct __state* state)
 {
     list_destroy(&state->deferred_ops, (void (*)(void*))__deferred_operation_free);
+    list_init(&state->deferred_ops);
 }
 
 static void __enqueue_deferred_operation(struct __state* state, struct deferred_operation* op)
@@ -313,6 +664,7 @@ static void __state_transaction_delete(struct state_transaction* transaction)
 
     free((void*)transaction->name);
     free((void*)transaction->channel);
+    free((void*)transaction->logs);
 }
 
 static void __served_transaction_delete(struct served_transaction* transaction)
@@ -346,6 +698,10 @@ static void __state_destroy(struct __state* state)
     }
     free((void*)state->transaction_states);
 
+    __index_destroy(&state->transactions_index);
+    __index_destroy(&state->transaction_states_index);
+    __index_destroy(&state->applications_index);
+
     __clear_deferred_operations(state);
     mtx_destroy(&state->lock);
     free((void*)state);
@@ -440,17 +796,8 @@ static int __application_from_stmt(sqlite3_stmt* stmt, struct state_application*
 
 static int __load_commands_for_application(struct __state* state, const char* app_name, struct state_application* application)
 {
-    const char* query = 
-        "SELECT c.name, c.path, c.arguments, c.type "
-        "FROM applications a "
-        "JOIN commands c ON a.id = c.application_id "
-        "WHERE a.name = ? "
-        "ORDER BY c.id";
-
-    sqlite3_stmt* stmt;
-    int status = sqlite3_prepare_v2(state->database, query, -1, &stmt, NULL);
-    if (status != SQLITE_OK) {
-        VLOG_ERROR("served", "__load_commands_for_application: failed to prepare statement: %s\n", sqlite3_errmsg(state->database));
+    sqlite3_stmt* stmt = __statement(state, STATE_STMT_SELECT_COMMANDS);
+    if (stmt == NULL) {
         return -1;
     }
 
@@ -463,7 +810,7 @@ static int __load_commands_for_application(struct __state* state, const char* ap
     }
 
     if (command_count == 0) {
-        sqlite3_finalize(stmt);
+        __statement_release(stmt);
         application->commands = NULL;
         application->commands_count = 0;
         return 0; // No commands, which is OK
@@ -473,7 +820,7 @@ static int __load_commands_for_application(struct __state* state, const char* ap
     application->commands = calloc(command_count, sizeof(struct state_application_command));
     if (!application->commands) {
         VLOG_ERROR("served", "__load_commands_for_application: failed to allocate commands array\n");
-        sqlite3_finalize(stmt);
+        __statement_release(stmt);
         return -1;
     }
     application->commands_count = command_count;
@@ -494,7 +841,7 @@ static int __load_commands_for_application(struct __state* state, const char* ap
             application->commands[i].name = platform_strdup(cmd_name);
             if (!application->commands[i].name) {
                 VLOG_ERROR("served", "__load_commands_for_application: failed to allocate command name\n");
-                sqlite3_finalize(stmt);
+                __statement_release(stmt);
                 return -1;
             }
         }
@@ -502,7 +849,7 @@ static int __load_commands_for_application(struct __state* state, const char* ap
             application->commands[i].path = platform_strdup(cmd_path);
             if (!application->commands[i].path) {
                 VLOG_ERROR("served", "__load_commands_for_application: failed to allocate command path\n");
-                sqlite3_finalize(stmt);
+                __statement_release(stmt);
                 return -1;
             }
         }
@@ -510,7 +857,7 @@ static int __load_commands_for_application(struct __state* state, const char* ap
             application->commands[i].arguments = platform_strdup(cmd_args);
             if (!application->commands[i].arguments) {
                 VLOG_ERROR("served", "__load_commands_for_application: failed to allocate command arguments\n");
-                sqlite3_finalize(stmt);
+                __statement_release(stmt);
                 return -1;
             }
         }
@@ -520,24 +867,15 @@ static int __load_commands_for_application(struct __state* state, const char* ap
         i++;
     }
 
-    sqlite3_finalize(stmt);
+    __statement_release(stmt);
     VLOG_DEBUG("served", "__load_commands_for_application: loaded %d commands for application '%s'\n", command_count, app_name);
     return 0;
 }
 
 static int __load_revisions_for_application(struct __state* state, const char* app_name, struct state_application* application)
 {
-    const char* query = 
-        "SELECT r.channel, r.major, r.minor, r.patch, r.revision, r.tag, r.size, r.created "
-        "FROM applications a "
-        "JOIN revisions r ON a.id = r.application_id "
-        "WHERE a.name = ? "
-        "ORDER BY r.id";
-
-    sqlite3_stmt* stmt;
-    int status = sqlite3_prepare_v2(state->database, query, -1, &stmt, NULL);
-    if (status != SQLITE_OK) {
-        VLOG_ERROR("served", "__load_revisions_for_application: failed to prepare statement: %s\n", sqlite3_errmsg(state->database));
+    sqlite3_stmt* stmt = __statement(state, STATE_STMT_SELECT_REVISIONS);
+    if (stmt == NULL) {
         return -1;
     }
 
@@ -550,7 +888,7 @@ static int __load_revisions_for_application(struct __state* state, const char* a
     }
 
     if (revision_count == 0) {
-        sqlite3_finalize(stmt);
+        __statement_release(stmt);
         application->revisions = NULL;
         application->revisions_count = 0;
         return 0; // No revisions, which is OK
@@ -560,7 +898,7 @@ static int __load_revisions_for_application(struct __state* state, const char* a
     application->revisions = malloc(sizeof(struct state_application_revision) * revision_count);
     if (!application->revisions) {
         VLOG_ERROR("served", "__load_revisions_for_application: failed to allocate revisions array\n");
-        sqlite3_finalize(stmt);
+        __statement_release(stmt);
         return -1;
     }
     application->revisions_count = revision_count;
@@ -606,7 +944,7 @@ static int __load_revisions_for_application(struct __state* state, const char* a
         i++;
     }
 
-    sqlite3_finalize(stmt);
+    __statement_release(stmt);
     VLOG_DEBUG("served", "__load_revisions_for_application: loaded %d revisions for application '%s'\n", revision_count, app_name);
     return 0;
 }
@@ -639,6 +977,7 @@ static int __load_applications_from_db(struct __state* state)
         VLOG_ERROR("served", "__load_applications_from_db: failed to allocate applications array\n");
         return -1;
     }
+    state->applications_states_capacity = count;
     state->applications_states_count = 0;
 
     status = sqlite3_prepare_v2(state->database, query, -1, &stmt, NULL);
@@ -736,6 +1075,7 @@ static int __load_transaction_states_from_db(struct __state* state)
         return -1;
     }
     state->transaction_state_count = transaction_count;
+    state->transaction_state_capacity = transaction_count;
 
     // Reset and re-execute to populate transactions
     sqlite3_reset(stmt);
@@ -798,6 +1138,7 @@ static int __load_transactions_from_db(struct __state* state)
         return -1;
     }
     state->transactions_count = transaction_count;
+    state->transactions_capacity = transaction_count;
 
     // Reset and re-execute to populate transactions
     sqlite3_reset(stmt);
@@ -860,42 +1201,26 @@ static int __load_transaction_logs_from_db(struct __state* state)
         const char* message = (const char*)sqlite3_column_text(stmt, 4);
 
         // Find the transaction this log belongs to
-        struct served_transaction* tx = NULL;
-        for (int i = 0; i < state->transactions_count; i++) {
-            if (state->transactions[i].id == transaction_id) {
-                tx = &state->transactions[i];
-                break;
-            }
-        }
-
+        struct served_transaction* tx = __find_transaction(state, transaction_id);
         if (tx == NULL) {
             VLOG_WARNING("served", "__load_transaction_logs_from_db: log for unknown transaction %u\n", transaction_id);
             continue;
         }
 
         // Find the state_transaction for this runtime transaction
-        struct state_transaction* state_tx = NULL;
-        for (int i = 0; i < state->transaction_state_count; i++) {
-            if (state->transaction_states[i].id == transaction_id) {
-                state_tx = &state->transaction_states[i];
-                break;
-            }
-        }
-
+        struct state_transaction* state_tx = __find_transaction_state(state, transaction_id);
         if (state_tx == NULL) {
             VLOG_WARNING("served", "__load_transaction_logs_from_db: no state for transaction %u\n", transaction_id);
             continue;
         }
 
         // Add log entry to state_transaction
-        struct state_transaction_log* new_logs = realloc(state_tx->logs, 
-            sizeof(struct state_transaction_log) * (state_tx->logs_count + 1));
-        if (new_logs == NULL) {
+        if (__ensure_capacity((void**)&state_tx->logs, &state_tx->logs_capacity,
+                state_tx->logs_count + 1, sizeof(struct state_transaction_log))) {
             VLOG_ERROR("served", "__load_transaction_logs_from_db: failed to allocate log entry\n");
             continue;
         }
 
-        state_tx->logs = new_logs;
         struct state_transaction_log* log = &state_tx->logs[state_tx->logs_count++];
         log->level = level;
         log->timestamp = timestamp;
@@ -955,25 +1280,31 @@ int served_state_load(void)
     status = sqlite3_open(path, &g_state->database);
     if (status != SQLITE_OK) {
         VLOG_ERROR("served", "served_state_load: failed to open database: %s\n", sqlite3_errmsg(g_state->database));
+        __state_close_database(g_state);
         __state_destroy(g_state);
         g_state = NULL;
         return -1;
     }
 
     // Create database schema if it doesn't exist
-    if (__create_database_schema(g_state->database) != 0) {
-        sqlite3_close(g_state->database);
+    if (__configure_database(g_state->database) != 0 ||
+        __create_database_schema(g_state->database) != 0) {
+        __state_close_database(g_state);
         __state_destroy(g_state);
         g_state = NULL;
         return -1;
     }
 
+    // The transaction indices must be built before the logs are loaded, as
+    // logs are attached to their transaction through them.
     if (__load_applications_from_db(g_state) != 0 ||
+        __rebuild_application_index(g_state) != 0 ||
         __load_transactions_from_db(g_state) != 0 ||
         __load_transaction_states_from_db(g_state) != 0 ||
+        __rebuild_transaction_indices(g_state) != 0 ||
         __load_transaction_logs_from_db(g_state) != 0 ||
         __initialize_transaction_id_counter(g_state) != 0) {
-        sqlite3_close(g_state->database);
+        __state_close_database(g_state);
         __state_destroy(g_state);
         g_state = NULL;
         return -1;
@@ -988,50 +1319,48 @@ void served_state_close(void)
         return;
     }
 
-    if (g_state->database) {
-        sqlite3_close(g_state->database);
-    }
-    
+    __state_close_database(g_state);
     __state_destroy(g_state);
     g_state = NULL;
 }
 
 // Execute a single deferred operation directly on the database
-static int __execute_add_application_op(struct __state* state, struct state_application* application)
+static int __execute_add_application_op(struct __state* state, const char* application_name)
 {
-    // This is the actual database insertion logic
-    const char* insert_app_query = 
-        "INSERT INTO applications (name) "
-        "VALUES (?)";
+    struct state_application* application;
+    sqlite3_stmt*             stmt;
+    int                       position;
+    int                       status;
+
+    // The application is resolved at execution time, as the in-memory array may
+    // have been reallocated or shifted since the operation was queued.
+    position = __find_application_position(state, application_name);
+    if (position < 0) {
+        VLOG_DEBUG("served", "__execute_add_application_op: application '%s' was removed before commit\n", application_name);
+        return 0;
+    }
+    application = &state->applications_states[position];
 
-    sqlite3_stmt* stmt;
-    int status = sqlite3_prepare_v2(state->database, insert_app_query, -1, &stmt, NULL);
-    if (status != SQLITE_OK) {
-        VLOG_ERROR("served", "__execute_add_application_op: failed to prepare statement: %s\n", sqlite3_errmsg(state->database));
+    stmt = __statement(state, STATE_STMT_INSERT_APPLICATION);
+    if (stmt == NULL) {
         return -1;
     }
 
     sqlite3_bind_text(stmt, 1, application->name, -1, SQLITE_STATIC);
 
     status = sqlite3_step(stmt);
+    __statement_release(stmt);
     if (status != SQLITE_DONE) {
         VLOG_ERROR("served", "__execute_add_application_op: failed to insert application: %s\n", sqlite3_errmsg(state->database));
-        sqlite3_finalize(stmt);
         return -1;
     }
 
     int app_id = (int)sqlite3_last_insert_rowid(state->database);
-    sqlite3_finalize(stmt);
 
     // Insert revision entry for the application (if revisions exist)
     if (application->revisions_count > 0 && application->revisions != NULL) {
-        const char* insert_rev_query = 
-            "INSERT INTO revisions (application_id, channel, major, minor, patch, revision, tag, size, created) "
-            "VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?)";
-            
-        status = sqlite3_prepare_v2(state->database, insert_rev_query, -1, &stmt, NULL);
-        if (status != SQLITE_OK) {
-            VLOG_ERROR("served", "__execute_add_application_op: failed to prepare revision statement: %s\n", sqlite3_errmsg(state->database));
+        stmt = __statement(state, STATE_STMT_INSERT_REVISION);
+        if (stmt == NULL) {
             return -1;
         }
 
@@ -1057,7 +1386,7 @@ static int __execute_add_application_op(struct __state* state, struct state_appl
         }
 
         status = sqlite3_step(stmt);
-        sqlite3_finalize(stmt);
+        __statement_release(stmt);
         
         if (status != SQLITE_DONE) {
             VLOG_ERROR("served", "__execute_add_application_op: failed to insert revision: %s\n", sqlite3_errmsg(state->database));
@@ -1067,13 +1396,8 @@ static int __execute_add_application_op(struct __state* state, struct state_appl
 
     // Insert commands if any
     for (int i = 0; i < application->commands_count; i++) {
-        const char* insert_cmd_query = 
-            "INSERT INTO commands (application_id, name, path, arguments, type) "
-            "VALUES (?, ?, ?, ?, ?)";
-
-        status = sqlite3_prepare_v2(state->database, insert_cmd_query, -1, &stmt, NULL);
-        if (status != SQLITE_OK) {
-            VLOG_ERROR("served", "__execute_add_application_op: failed to prepare command statement: %s\n", sqlite3_errmsg(state->database));
+        stmt = __statement(state, STATE_STMT_INSERT_COMMAND);
+        if (stmt == NULL) {
             return -1;
         }
 
@@ -1084,7 +1408,7 @@ static int __execute_add_application_op(struct __state* state, struct state_appl
         sqlite3_bind_int(stmt, 5, application->commands[i].type);
 
         status = sqlite3_step(stmt);
-        sqlite3_finalize(stmt);
+        __statement_release(stmt);
         
         if (status != SQLITE_DONE) {
             VLOG_ERROR("served", "__execute_add_application_op: failed to insert command: %s\n", sqlite3_errmsg(state->database));
@@ -1097,17 +1421,17 @@ static int __execute_add_application_op(struct __state* state, struct state_appl
 
 static int __execute_remove_application_op(struct __state* state, const char* application_name)
 {
-    const char* delete_query = "DELETE FROM applications WHERE name = ?";
     sqlite3_stmt* stmt;
-    int status = sqlite3_prepare_v2(state->database, delete_query, -1, &stmt, NULL);
-    if (status != SQLITE_OK) {
-        VLOG_ERROR("served", "__execute_remove_application_op: failed to prepare statement: %s\n", sqlite3_errmsg(state->database));
+    int           status;
+
+    stmt = __statement(state, STATE_STMT_DELETE_APPLICATION);
+    if (stmt == NULL) {
         return -1;
     }
 
     sqlite3_bind_text(stmt, 1, application_name, -1, SQLITE_STATIC);
     status = sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
+    __statement_release(stmt);
 
     if (status != SQLITE_DONE) {
         VLOG_ERROR("served", "__execute_remove_application_op: failed to delete application: %s\n", sqlite3_errmsg(state->database));
@@ -1117,16 +1441,20 @@ static int __execute_remove_application_op(struct __state* state, const char* ap
     return 0;
 }
 
-static int __execute_add_transaction_op(struct __state* state, struct served_transaction* transaction)
+static int __execute_add_transaction_op(struct __state* state, unsigned int transactionID)
 {
-    const char* insert_tx_query = 
-        "INSERT INTO transactions (id, type, state, flags, name, description, wait_type, wait_data) "
-        "VALUES (?, ?, ?, ?, ?, ?, ?, ?)";
+    struct served_transaction* transaction;
+    sqlite3_stmt*              stmt;
+    int                        status;
 
-    sqlite3_stmt* stmt;
-    int status = sqlite3_prepare_v2(state->database, insert_tx_query, -1, &stmt, NULL);
-    if (status != SQLITE_OK) {
-        VLOG_ERROR("served", "__execute_add_transaction_op: failed to prepare statement: %s\n", sqlite3_errmsg(state->database));
+    transaction = __find_transaction(state, transactionID);
+    if (transaction == NULL) {
+        VLOG_ERROR("served", "__execute_add_transaction_op: transaction %u not found\n", transactionID);
+        return -1;
+    }
+
+    stmt = __statement(state, STATE_STMT_INSERT_TRANSACTION);
+    if (stmt == NULL) {
         return -1;
     }
 
@@ -1140,26 +1468,30 @@ static int __execute_add_transaction_op(struct __state* state, struct served_tra
     sqlite3_bind_int(stmt, 8, transaction->wait.data.transaction_id);
 
     status = sqlite3_step(stmt);
+    __statement_release(stmt);
     if (status != SQLITE_DONE) {
         VLOG_ERROR("served", "__execute_add_transaction_op: failed to insert transaction: %s\n", sqlite3_errmsg(state->database));
-        sqlite3_finalize(stmt);
         return -1;
     }
-
-    sqlite3_finalize(stmt);
     return 0;
 }
 
-static int __execute_update_transaction_op(struct __state* state, struct served_transaction* transaction)
+static int __execute_update_transaction_op(struct __state* state, unsigned int transactionID)
 {
-    const char* update_tx_query = 
-        "UPDATE transactions SET type = ?, state = ?, flags = ?, name = ?, description = ?, "
-        "wait_type = ?, wait_data = ? WHERE id = ?";
+    struct served_transaction* transaction;
+    sqlite3_stmt*              stmt;
+    int                        status;
 
-    sqlite3_stmt* stmt;
-    int status = sqlite3_prepare_v2(state->database, update_tx_query, -1, &stmt, NULL);
-    if (status != SQLITE_OK) {
-        VLOG_ERROR("served", "__execute_update_transaction_op: failed to prepare statement: %s\n", sqlite3_errmsg(state->database));
+    // resolved at execution time, the in-memory array may have been
+    // reallocated since the operation was queued
+    transaction = __find_transaction(state, transactionID);
+    if (transaction == NULL) {
+        VLOG_ERROR("served", "__execute_update_transaction_op: transaction %u not found\n", transactionID);
+        return -1;
+    }
+
+    stmt = __statement(state, STATE_STMT_UPDATE_TRANSACTION);
+    if (stmt == NULL) {
         return -1;
     }
 
@@ -1173,26 +1505,28 @@ static int __execute_update_transaction_op(struct __state* state, struct served_
     sqlite3_bind_int(stmt, 8, transaction->id);
 
     status = sqlite3_step(stmt);
+    __statement_release(stmt);
     if (status != SQLITE_DONE) {
         VLOG_ERROR("served", "__execute_update_transaction_op: failed to update transaction: %s\n", sqlite3_errmsg(state->database));
-        sqlite3_finalize(stmt);
         return -1;
     }
-
-    sqlite3_finalize(stmt);
     return 0;
 }
 
-static int __execute_update_tx_state_op(struct __state* state, struct state_transaction* transaction)
+static int __execute_update_tx_state_op(struct __state* state, unsigned int transactionID)
 {
-    const char* update_tx_state_query = 
-        "UPDATE transactions_state SET name = ?, channel = ?, revision = ? "
-        "WHERE transaction_id = ?";
+    struct state_transaction* transaction;
+    sqlite3_stmt*             stmt;
+    int                       status;
 
-    sqlite3_stmt* stmt;
-    int status = sqlite3_prepare_v2(state->database, update_tx_state_query, -1, &stmt, NULL);
-    if (status != SQLITE_OK) {
-        VLOG_ERROR("served", "__execute_update_tx_state_op: failed to prepare statement: %s\n", sqlite3_errmsg(state->database));
+    transaction = __find_transaction_state(state, transactionID);
+    if (transaction == NULL) {
+        VLOG_ERROR("served", "__execute_update_tx_state_op: transaction state %u not found\n", transactionID);
+        return -1;
+    }
+
+    stmt = __statement(state, STATE_STMT_UPDATE_TRANSACTION_STATE);
+    if (stmt == NULL) {
         return -1;
     }
 
@@ -1202,29 +1536,27 @@ static int __execute_update_tx_state_op(struct __state* state, struct state_tran
     sqlite3_bind_int(stmt, 4, transaction->id);
 
     status = sqlite3_step(stmt);
+    __statement_release(stmt);
     if (status != SQLITE_DONE) {
         VLOG_ERROR("served", "__execute_update_tx_state_op: failed to update transaction state: %s\n", sqlite3_errmsg(state->database));
-        sqlite3_finalize(stmt);
         return -1;
     }
-
-    sqlite3_finalize(stmt);
     return 0;
 }
 
 static int __execute_complete_tx_op(struct __state* state, unsigned int transaction_id)
 {
-    const char* complete_tx_query = "UPDATE transactions SET completed_at = strftime('%s', 'now') WHERE id = ?";
     sqlite3_stmt* stmt;
-    int status = sqlite3_prepare_v2(state->database, complete_tx_query, -1, &stmt, NULL);
-    if (status != SQLITE_OK) {
-        VLOG_ERROR("served", "__execute_complete_tx_op: failed to prepare statement: %s\n", sqlite3_errmsg(state->database));
+    int           status;
+
+    stmt = __statement(state, STATE_STMT_COMPLETE_TRANSACTION);
+    if (stmt == NULL) {
         return -1;
     }
 
     sqlite3_bind_int(stmt, 1, transaction_id);
     status = sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
+    __statement_release(stmt);
 
     if (status != SQLITE_DONE) {
         VLOG_ERROR("served", "__execute_complete_tx_op: failed to mark transaction complete: %s\n", sqlite3_errmsg(state->database));
@@ -1244,15 +1576,11 @@ static int __execute_add_transaction_log_op(struct __state* state, void* log_dat
         sm_state_t                        txstate;
         char*                             message;
     }* data = log_data;
-
-    const char* insert_log_query = 
-        "INSERT INTO transaction_logs (transaction_id, level, timestamp, state, message) "
-        "VALUES (?, ?, ?, ?, ?)";
-
     sqlite3_stmt* stmt;
-    int status = sqlite3_prepare_v2(state->database, insert_log_query, -1, &stmt, NULL);
-    if (status != SQLITE_OK) {
-        VLOG_ERROR("served", "__execute_add_transaction_log_op: failed to prepare statement: %s\n", sqlite3_errmsg(state->database));
+    int           status;
+
+    stmt = __statement(state, STATE_STMT_INSERT_TRANSACTION_LOG);
+    if (stmt == NULL) {
         return -1;
     }
 
@@ -1263,28 +1591,30 @@ static int __execute_add_transaction_log_op(struct __state* state, void* log_dat
     sqlite3_bind_text(stmt, 5, data->message, -1, SQLITE_STATIC);
 
     status = sqlite3_step(stmt);
+    __statement_release(stmt);
     if (status != SQLITE_DONE) {
         VLOG_ERROR("served", "__execute_add_transaction_log_op: failed to insert log: %s\n", sqlite3_errmsg(state->database));
-        sqlite3_finalize(stmt);
         return -1;
     }
-
-    sqlite3_finalize(stmt);
     return 0;
 }
 
-static int __execute_add_tx_state_op(struct __state* state, unsigned int transactionID, struct state_transaction* transaction)
+static int __execute_add_tx_state_op(struct __state* state, unsigned int transactionID, int position)
 {
-    const char* insertTxStateSQL = 
-        "INSERT INTO transactions_state (transaction_id, name, channel, revision) "
-        "VALUES (?, ?, ?, ?)";
+    struct state_transaction* transaction;
+    sqlite3_stmt*             stmt;
+    int                       status;
 
-    sqlite3_stmt* stmt;
-    int           status;
+    // Batch transactions have an entry for each package, so the entry is
+    // referred to by its position rather than by the transaction id
+    transaction = position < state->transaction_state_count ? &state->transaction_states[position] : NULL;
+    if (transaction == NULL || transaction->id != transactionID) {
+        VLOG_ERROR("served", "__execute_add_tx_state_op: state for transaction %u not found\n", transactionID);
+        return -1;
+    }
 
-    status = sqlite3_prepare_v2(state->database, insertTxStateSQL, -1, &stmt, NULL);
-    if (status != SQLITE_OK) {
-        VLOG_ERROR("served", "__execute_add_tx_state_op: failed to prepare state statement: %s\n", sqlite3_errmsg(state->database));
+    stmt = __statement(state, STATE_STMT_INSERT_TRANSACTION_STATE);
+    if (stmt == NULL) {
         return -1;
     }
 
@@ -1294,7 +1624,7 @@ static int __execute_add_tx_state_op(struct __state* state, unsigned int transac
     sqlite3_bind_int(stmt, 4, transaction->revision);
 
     status = sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
+    __statement_release(stmt);
 
     if (status != SQLITE_DONE) {
         VLOG_ERROR("served", "__execute_add_tx_state_op: failed to insert transaction state: %s\n", sqlite3_errmsg(state->database));
@@ -1328,7 +1658,7 @@ static int __execute_deferred_operations(struct __state* state)
         
         switch (op->type) {
             case DEFERRED_OP_ADD_APPLICATION:
-                result = __execute_add_application_op(state, op->data.add_app.application);
+                result = __execute_add_application_op(state, op->data.add_app.application_name);
                 break;
                 
             case DEFERRED_OP_REMOVE_APPLICATION:
@@ -1336,23 +1666,20 @@ static int __execute_deferred_operations(struct __state* state)
                 break;
                 
             case DEFERRED_OP_ADD_TRANSACTION:
-                result = __execute_add_transaction_op(state, op->data.add_tx.transaction);
+                result = __execute_add_transaction_op(state, op->data.add_tx.transaction_id);
                 break;
                 
             case DEFERRED_OP_UPDATE_TRANSACTION:
-                result = __execute_update_transaction_op(state, op->data.update_tx.transaction);
+                result = __execute_update_transaction_op(state, op->data.update_tx.transaction_id);
                 break;
                 
             case DEFERRED_OP_ADD_TRANSACTION_STATE:
-                result = __execute_add_tx_state_op(
-                    state,
-                    op->data.add_tx_state.transaction_id,
-                    op->data.add_tx_state.transaction
-                );
+                result = __execute_add_tx_state_op(state, op->data.add_tx_state.transaction_id,
+                    op->data.add_tx_state.position);
                 break;
 
             case DEFERRED_OP_UPDATE_TRANSACTION_STATE:
-                result = __execute_update_tx_state_op(state, op->data.update_tx_state.transaction);
+                result = __execute_update_tx_state_op(state, op->data.update_tx_state.transaction_id);
                 break;
 
             case DEFERRED_OP_COMPLETE_TRANSACTION:
@@ -1399,11 +1726,15 @@ void served_state_unlock(void)
             VLOG_ERROR("served", "served_state_unlock: failed to execute deferred operations\n");
             // Note: in-memory state may be inconsistent with database now
             // You may want to reload state from database here
-        }
-        
-        // Save state to database here if needed
-        if (served_state_flush() != 0) {
-            VLOG_ERROR("served", "served_state_unlock: failed to flush dirty state\n");
+        } else if (++g_state->commits_since_checkpoint >= STATE_CHECKPOINT_INTERVAL) {
+            // Move the accumulated commits from the WAL into the database. A passive
+            // checkpoint never blocks, if readers are active it will resume on the next
+            // interval.
+            int status = sqlite3_wal_checkpoint_v2(g_state->database, NULL, SQLITE_CHECKPOINT_PASSIVE, NULL, NULL);
+            if (status != SQLITE_OK) {
+                VLOG_WARNING("served", "served_state_unlock: checkpoint failed: %s\n", sqlite3_errmsg(g_state->database));
+            }
+            g_state->commits_since_checkpoint = 0;
         }
     }
 
@@ -1418,16 +1749,15 @@ int served_state_flush(void)
         return -1;
     }
 
-    // In our SQLite-based implementation, data is already persisted to the database
-    // when applications/transactions are added/modified. This function ensures 
-    // any pending changes are committed and synced.
-    
-    // Flush any pending database operations
-    int status = sqlite3_exec(g_state->database, "PRAGMA synchronous = FULL", NULL, NULL, NULL);
+    // In our SQLite-based implementation, data is already committed to the WAL
+    // when the state is unlocked. This function ensures that the WAL is synced and
+    // fully written back into the database file, so the state survives power loss.
+    int status = sqlite3_wal_checkpoint_v2(g_state->database, NULL, SQLITE_CHECKPOINT_TRUNCATE, NULL, NULL);
     if (status != SQLITE_OK) {
         VLOG_ERROR("served", "served_state_flush: failed to sync database: %s\n", sqlite3_errmsg(g_state->database));
         return -1;
     }
+    g_state->commits_since_checkpoint = 0;
 
     VLOG_DEBUG("served", "served_state_flush: state saved successfully\n");
     return 0;
@@ -1445,13 +1775,7 @@ struct state_transaction* served_state_transaction(unsigned int id)
         return NULL;
     }
 
-    for (int i = 0; i < g_state->transaction_state_count; i++) {
-        if (g_state->transaction_states[i].id == id) {
-            return &g_state->transaction_states[i];
-        }
-    }
-
-    return NULL;
+    return __find_transaction_state(g_state, id);
 }
 
 // This must be called with the state lock held
@@ -1466,22 +1790,15 @@ struct state_application* served_state_application(const char* name)
         return NULL;
     }
 
-    for (int i = 0; i < g_state->applications_states_count; i++) {
-        if (g_state->applications_states[i].name && 
-            strcmp(g_state->applications_states[i].name, name) == 0) {
-            return &g_state->applications_states[i];
-        }
-    }
-
-    return NULL;
+    int position = __find_application_position(g_state, name);
+    return position < 0 ? NULL : &g_state->applications_states[position];
 }
 
 // This must be called with the state lock held
 int served_state_add_application(struct state_application* application)
 {
     struct deferred_operation* op;
-    struct state_application*  newApps;
-    
+
     if (g_state == NULL || application == NULL || application->name == NULL) {
         return -1;
     }
@@ -1497,29 +1814,31 @@ int served_state_add_application(struct state_application* application)
         return -1;
     }
 
+    op = __deferred_operation_new(DEFERRED_OP_ADD_APPLICATION);
+    if (op == NULL) {
+        VLOG_ERROR("served", "served_state_add_application: failed to allocate deferred operation\n");
+        return -1;
+    }
+
+    op->data.add_app.application_name = platform_strdup(application->name);
+    if (op->data.add_app.application_name == NULL) {
+        free(op);
+        return -1;
+    }
+
     // Add to in-memory state immediately for read consistency
-    newApps = realloc(g_state->applications_states,
-        sizeof(struct state_application) * (g_state->applications_states_count + 1));
-    if (!newApps) {
+    if (__ensure_capacity((void**)&g_state->applications_states, &g_state->applications_states_capacity,
+            g_state->applications_states_count + 1, sizeof(struct state_application)) ||
+        __index_insert(&g_state->applications_index, __hash_string(application->name),
+            g_state->applications_states_count)) {
         VLOG_ERROR("served", "served_state_add_application: failed to allocate memory\n");
+        __deferred_operation_free(op);
         return -1;
     }
-    
-    g_state->applications_states = newApps;
+
     g_state->applications_states[g_state->applications_states_count] = *application;
     g_state->applications_states_count++;
 
-    op = malloc(sizeof(struct deferred_operation));
-    if (!op) {
-        VLOG_ERROR("served", "served_state_add_application: failed to allocate deferred operation\n");
-        // Roll back in-memory change
-        g_state->applications_states_count--;
-        return -1;
-    }
-    
-    op->type = DEFERRED_OP_ADD_APPLICATION;
-    op->data.add_app.application = &g_state->applications_states[g_state->applications_states_count - 1];
-    
     __enqueue_deferred_operation(g_state, op);
     
     VLOG_DEBUG("served", "served_state_add_application: operation deferred for '%s'\n", application->name);
@@ -1542,28 +1861,14 @@ int served_state_remove_application(struct state_application* application)
     }
 
     // Find and remove from in-memory state first
-    for (int i = 0; i < g_state->applications_states_count; i++) {
-        if (g_state->applications_states[i].name && 
-            strcmp(g_state->applications_states[i].name, application->name) == 0) {
-            found = i;
-            break;
-        }
-    }
-
+    found = __find_application_position(g_state, application->name);
     if (found == -1) {
         VLOG_ERROR("served", "served_state_remove_application: application '%s' not found\n", application->name);
         return -1;
     }
 
-    // Remove from in-memory state
-    __state_application_delete(&g_state->applications_states[found]);
-    
-    // Shift remaining applications
-    for (int j = found; j < g_state->applications_states_count - 1; j++) {
-        g_state->applications_states[j] = g_state->applications_states[j + 1];
-    }
-    g_state->applications_states_count--;
-
+    // Take a copy of the name before the entry is freed, <application> may
+    // point into the array itself.
     op = __deferred_operation_new(DEFERRED_OP_REMOVE_APPLICATION);
     if (op == NULL) {
         VLOG_ERROR("served", "served_state_remove_application: failed to allocate deferred operation\n");
@@ -1575,10 +1880,25 @@ int served_state_remove_application(struct state_application* application)
         free(op);
         return -1;
     }
+
+    // Remove from in-memory state
+    __state_application_delete(&g_state->applications_states[found]);
     
+    // Shift remaining applications
+    for (int j = found; j < g_state->applications_states_count - 1; j++) {
+        g_state->applications_states[j] = g_state->applications_states[j + 1];
+    }
+    g_state->applications_states_count--;
+
+    // Positions have shifted, so the index must be rebuilt. Removals are rare
+    // compared to lookups, so this is cheaper than tracking tombstones.
+    if (__rebuild_application_index(g_state)) {
+        VLOG_ERROR("served", "served_state_remove_application: failed to rebuild index\n");
+    }
+
     __enqueue_deferred_operation(g_state, op);
     
-    VLOG_DEBUG("served", "served_state_remove_application: operation deferred for '%s'\n", application->name);
+    VLOG_DEBUG("served", "served_state_remove_application: operation deferred for '%s'\n", op->data.remove_app.application_name);
     return 0;
 }
 
@@ -1587,7 +1907,6 @@ unsigned int served_state_transaction_new(struct served_transaction_options* opt
 {
     struct deferred_operation* op;
     struct served_transaction* tx;
-    struct served_transaction* newTxs;
     unsigned int               transactionID;
     
     if (g_state == NULL || options == NULL) {
@@ -1603,36 +1922,37 @@ unsigned int served_state_transaction_new(struct served_transaction_options* opt
     transactionID = g_state->next_transaction_id++;
 
     // Add to in-memory state immediately for read consistency
-    newTxs = realloc(g_state->transactions,
-        sizeof(struct served_transaction) * (g_state->transactions_count + 1));
-    if (newTxs == NULL) {
+    if (__ensure_capacity((void**)&g_state->transactions, &g_state->transactions_capacity,
+            g_state->transactions_count + 1, sizeof(struct served_transaction))) {
         VLOG_ERROR("served", "served_state_transaction_new: failed to allocate memory\n");
         // Roll back ID counter
         g_state->next_transaction_id--;
         return 0;
     }
-    
-    g_state->transactions = newTxs;
-    
-    // Initialize the new transaction with the real ID
-    tx = &g_state->transactions[g_state->transactions_count];
-    struct served_transaction_options opts = *options;
-    opts.id = transactionID;  // Set the generated ID
-    served_transaction_construct(tx, &opts);
-    g_state->transactions_count++;
 
     // Defer the database operation
     op = __deferred_operation_new(DEFERRED_OP_ADD_TRANSACTION);
     if (op == NULL) {
         VLOG_ERROR("served", "served_state_transaction_new: failed to allocate deferred operation\n");
-        // Roll back in-memory change and clean up allocated memory
-        g_state->transactions_count--;
-        __served_transaction_delete(tx);
         g_state->next_transaction_id--;
         return 0;
     }
-    
-    op->data.add_tx.transaction = tx;
+
+    if (__index_insert(&g_state->transactions_index, __hash_id(transactionID), g_state->transactions_count)) {
+        VLOG_ERROR("served", "served_state_transaction_new: failed to index transaction\n");
+        __deferred_operation_free(op);
+        g_state->next_transaction_id--;
+        return 0;
+    }
+
+    // Initialize the new transaction with the real ID
+    tx = &g_state->transactions[g_state->transactions_count];
+    struct served_transaction_options opts = *options;
+    opts.id = transactionID;  // Set the generated ID
+    served_transaction_construct(tx, &opts);
+    g_state->transactions_count++;
+
+    op->data.add_tx.transaction_id = transactionID;
     
     __enqueue_deferred_operation(g_state, op);
     
@@ -1662,7 +1982,7 @@ int served_state_transaction_update(struct served_transaction* transaction)
         return -1;
     }
 
-    op->data.update_tx.transaction = transaction;
+    op->data.update_tx.transaction_id = transaction->id;
     
     __enqueue_deferred_operation(g_state, op);
     return 0;
@@ -1688,27 +2008,19 @@ int served_state_transaction_log_add(
     }
 
     // Find the state_transaction for this transaction_id
-    for (int i = 0; i < g_state->transaction_state_count; i++) {
-        if (g_state->transaction_states[i].id == transaction_id) {
-            state_tx = &g_state->transaction_states[i];
-            break;
-        }
-    }
-
+    state_tx = __find_transaction_state(g_state, transaction_id);
     if (state_tx == NULL) {
         VLOG_WARNING("served", "served_state_transaction_log_add: no state for transaction %u\n", transaction_id);
         return -1;
     }
 
     // Add to in-memory state immediately
-    struct state_transaction_log* new_logs = realloc(state_tx->logs, 
-        sizeof(struct state_transaction_log) * (state_tx->logs_count + 1));
-    if (new_logs == NULL) {
+    if (__ensure_capacity((void**)&state_tx->logs, &state_tx->logs_capacity,
+            state_tx->logs_count + 1, sizeof(struct state_transaction_log))) {
         VLOG_ERROR("served", "served_state_transaction_log_add: failed to allocate log entry\n");
         return -1;
     }
 
-    state_tx->logs = new_logs;
     struct state_transaction_log* log = &state_tx->logs[state_tx->logs_count++];
     log->level = level;
     log->timestamp = timestamp;
@@ -1750,12 +2062,11 @@ int served_state_transaction_logs(
     }
 
     // Find the state_transaction for this transaction_id
-    for (int i = 0; i < g_state->transaction_state_count; i++) {
-        if (g_state->transaction_states[i].id == transaction_id) {
-            *logs_out = g_state->transaction_states[i].logs;
-            *count_out = g_state->transaction_states[i].logs_count;
-            return 0;
-        }
+    struct state_transaction* state_tx = __find_transaction_state(g_state, transaction_id);
+    if (state_tx != NULL) {
+        *logs_out = state_tx->logs;
+        *count_out = state_tx->logs_count;
+        return 0;
     }
 
     *logs_out = NULL;
@@ -1763,11 +2074,15 @@ int served_state_transaction_logs(
     return -1;
 }
 
+static char* __strdup_safe(const char* str)
+{
+    return str != NULL ? platform_strdup(str) : NULL;
+}
+
 // This must be called with the state lock held
 int served_state_transaction_state_new(unsigned int id, struct state_transaction* state)
 {
     struct deferred_operation* op;
-    struct state_transaction*  newStates;
 
     if (g_state == NULL || state == NULL) {
         return -1;
@@ -1778,32 +2093,35 @@ int served_state_transaction_state_new(unsigned int id, struct state_transaction
         return -1;
     }
 
+    // Defer the database operation
+    op = __deferred_operation_new(DEFERRED_OP_ADD_TRANSACTION_STATE);
+    if (op == NULL) {
+        VLOG_ERROR("served", "served_state_transaction_state_new: failed to allocate deferred operation\n");
+        return -1;
+    }
+
     // Add to in-memory state immediately for read consistency
-    newStates = realloc(g_state->transaction_states, 
-        sizeof(struct state_transaction) * (g_state->transaction_state_count + 1));
-    if (!newStates) {
+    if (__ensure_capacity((void**)&g_state->transaction_states, &g_state->transaction_state_capacity,
+            g_state->transaction_state_count + 1, sizeof(struct state_transaction)) ||
+        __index_insert(&g_state->transaction_states_index, __hash_id(id), g_state->transaction_state_count)) {
         VLOG_ERROR("served", "served_state_transaction_state_new: failed to allocate memory\n");
+        __deferred_operation_free(op);
         return -1;
     }
-    
-    g_state->transaction_states = newStates;
+
+    // The state owns the strings of the entry, callers usually pass strings
+    // that only live for the duration of a protocol message
     g_state->transaction_states[g_state->transaction_state_count] = *state;
     g_state->transaction_states[g_state->transaction_state_count].id = id;
+    g_state->transaction_states[g_state->transaction_state_count].name = __strdup_safe(state->name);
+    g_state->transaction_states[g_state->transaction_state_count].channel = __strdup_safe(state->channel);
     g_state->transaction_states[g_state->transaction_state_count].logs = NULL;
     g_state->transaction_states[g_state->transaction_state_count].logs_count = 0;
+    g_state->transaction_states[g_state->transaction_state_count].logs_capacity = 0;
     g_state->transaction_state_count++;
 
-    // Defer the database operation
-    op = __deferred_operation_new(DEFERRED_OP_ADD_TRANSACTION_STATE);
-    if (op == NULL) {
-        VLOG_ERROR("served", "served_state_transaction_state_new: failed to allocate deferred operation\n");
-        // Roll back in-memory change
-        g_state->transaction_state_count--;
-        return -1;
-    }
-
     op->data.add_tx_state.transaction_id = id;
-    op->data.add_tx_state.transaction = &g_state->transaction_states[g_state->transaction_state_count - 1];
+    op->data.add_tx_state.position = g_state->transaction_state_count - 1;
 
     __enqueue_deferred_operation(g_state, op);
     return 0;
@@ -1831,12 +2149,192 @@ int served_state_transaction_state_update(struct state_transaction* state)
         return -1;
     }
 
-    op->data.update_tx_state.transaction = state;
+    op->data.update_tx_state.transaction_id = state->id;
     
     __enqueue_deferred_operation(g_state, op);
     return 0;
 }
 
+struct state_application* served_state_application_copy(const char* name)
+{
+    struct state_application* application;
+    struct state_application* copy;
+
+    if (g_state == NULL || name == NULL) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    copy = calloc(1, sizeof(struct state_application));
+    if (copy == NULL) {
+        return NULL;
+    }
+
+    served_state_lock();
+    application = served_state_application(name);
+    if (application == NULL) {
+        served_state_unlock();
+        free(copy);
+        errno = ENOENT;
+        return NULL;
+    }
+
+    copy->name = platform_strdup(application->name);
+    copy->base = __strdup_safe(application->base);
+    copy->container_id = __strdup_safe(application->container_id);
+    if (application->commands_count) {
+        copy->commands = calloc(application->commands_count, sizeof(struct state_application_command));
+        if (copy->commands == NULL) {
+            served_state_unlock();
+            served_state_application_copy_free(copy);
+            return NULL;
+        }
+
+        for (int i = 0; i < application->commands_count; i++) {
+            copy->commands[i].name = __strdup_safe(application->commands[i].name);
+            copy->commands[i].type = application->commands[i].type;
+            copy->commands[i].path = __strdup_safe(application->commands[i].path);
+            copy->commands[i].arguments = __strdup_safe(application->commands[i].arguments);
+            copy->commands[i].pid = application->commands[i].pid;
+        }
+        copy->commands_count = application->commands_count;
+    }
+    served_state_unlock();
+    return copy;
+}
+
+void served_state_application_copy_free(struct state_application* application)
+{
+    if (application == NULL) {
+        return;
+    }
+
+    __state_application_delete(application);
+    free((void*)application->base);
+    free((void*)application->container_id);
+    free(application);
+}
+
+char** served_state_application_names(void)
+{
+    char** names;
+
+    if (g_state == NULL) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    served_state_lock();
+    names = calloc(g_state->applications_states_count + 1, sizeof(char*));
+    if (names == NULL) {
+        served_state_unlock();
+        return NULL;
+    }
+
+    for (int i = 0; i < g_state->applications_states_count; i++) {
+        names[i] = platform_strdup(g_state->applications_states[i].name);
+        if (names[i] == NULL) {
+            served_state_unlock();
+            strsplit_free(names);
+            return NULL;
+        }
+    }
+    served_state_unlock();
+    return names;
+}
+
+struct state_transaction* served_state_transaction_packages(unsigned int id, int* countOut)
+{
+    struct state_transaction* packages;
+    int                       count = 0;
+
+    if (g_state == NULL || countOut == NULL) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    served_state_lock();
+    for (int i = 0; i < g_state->transaction_state_count; i++) {
+        if (g_state->transaction_states[i].id == id) {
+            count++;
+        }
+    }
+
+    if (count == 0) {
+        served_state_unlock();
+        errno = ENOENT;
+        return NULL;
+    }
+
+    packages = calloc(count, sizeof(struct state_transaction));
+    if (packages == NULL) {
+        served_state_unlock();
+        return NULL;
+    }
+
+    // Entries are appended, so this preserves the order the packages were added in
+    for (int i = 0, j = 0; i < g_state->transaction_state_count && j < count; i++) {
+        struct state_transaction* entry = &g_state->transaction_states[i];
+        if (entry->id != id) {
+            continue;
+        }
+
+        packages[j].id = entry->id;
+        packages[j].name = __strdup_safe(entry->name);
+        packages[j].channel = __strdup_safe(entry->channel);
+        packages[j].revision = entry->revision;
+        if (entry->name != NULL && packages[j].name == NULL) {
+            served_state_unlock();
+            served_state_transaction_packages_free(packages, count);
+            return NULL;
+        }
+        j++;
+    }
+    served_state_unlock();
+
+    *countOut = count;
+    return packages;
+}
+
+void served_state_transaction_packages_free(struct state_transaction* packages, int count)
+{
+    if (packages == NULL) {
+        return;
+    }
+
+    for (int i = 0; i < count; i++) {
+        free((void*)packages[i].name);
+        free((void*)packages[i].channel);
+    }
+    free(packages);
+}
+
+char** served_state_transaction_package_names(unsigned int id)
+{
+    struct state_transaction* packages;
+    char**                    names;
+    int                       count;
+
+    packages = served_state_transaction_packages(id, &count);
+    if (packages == NULL) {
+        return NULL;
+    }
+
+    names = calloc(count + 1, sizeof(char*));
+    if (names == NULL) {
+        served_state_transaction_packages_free(packages, count);
+        return NULL;
+    }
+
+    // hand over the names instead of copying them again
+    for (int i = 0; i < count; i++) {
+        names[i] = (char*)packages[i].name;
+        packages[i].name = NULL;
+    }
+    served_state_transaction_packages_free(packages, count);
+    return names;
+}
+
 // This must be called with the state lock held
 int served_state_get_applications(struct state_application** applicationsOut, int* applicationsCount)
 {
@@ -23,6 +23,7 @@
 
 #include <chef/package.h>
 #include <chef/platform.h>
+#include <chef/store.h>
 #include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -86,6 +87,7 @@ enum sm_action_result served_handle_state_dependencies(void* context)
 {
     struct served_transaction* transaction = context;
     struct state_transaction*  state;
+    char*                      name = NULL;
     char**                     names = NULL;
     char*                      path = NULL;
     char*                      base = NULL;
@@ -100,9 +102,10 @@ enum sm_action_result served_handle_state_dependencies(void* context)
         goto cleanup;
     }
 
-    names = utils_split_package_name(state->name);
+    name = platform_strdup(state->name);
     served_state_unlock();
 
+    names = name != NULL ? utils_split_package_name(name) : NULL;
     if (names == NULL) {
         TXLOG_ERROR(transaction, "Failed to split package name identifiers");
         goto cleanup;
@@ -140,7 +143,7 @@ enum sm_action_result served_handle_state_dependencies(void* context)
             goto cleanup;
         }
 
-        event = __ensure_base(transaction, state->name, base);
+        event = __ensure_base(transaction, name, base);
     } else {
         // No base specified, nothing to do
         TXLOG_INFO(transaction, "No package dependencies detected");
@@ -150,6 +153,7 @@ enum sm_action_result served_handle_state_dependencies(void* context)
 cleanup:
     chef_package_free(package);
     strsplit_free(names);
+    free(name);
     free(base);
     free(path);
     served_sm_post_event(&transaction->sm, event);
@@ -164,3 +168,119 @@ enum sm_action_result served_handle_state_dependencies_wait(void* context)
     served_sm_post_event(&transaction->sm, SERVED_TX_EVENT_OK);
     return SM_ACTION_CONTINUE;
 }
+
+// __package_base resolves the store id of the base that a downloaded package
+// requires, <baseOut> is set to NULL if the package does not require a base
+static int __package_base(struct state_transaction* state, char** baseOut)
+{
+    struct chef_package* package;
+    const char*          path;
+    int                  status;
+
+    *baseOut = NULL;
+    status = store_package_path(&(struct store_package) {
+        .name = state->name,
+        .platform = CHEF_PLATFORM_STR,
+        .arch = CHEF_ARCHITECTURE_STR,
+        .channel = NULL,
+        .revision = state->revision
+    }, &path);
+    if (status) {
+        return status;
+    }
+
+    status = chef_package_load(path, &package, NULL, NULL, NULL);
+    free((void*)path);
+    if (status) {
+        return status;
+    }
+
+    if (package->base != NULL && strlen(package->base) > 0) {
+        *baseOut = utils_base_to_store_id(package->base);
+        if (*baseOut == NULL) {
+            status = -1;
+        }
+    }
+    chef_package_free(package);
+    return status;
+}
+
+static int __in_list(char** names, const char* name)
+{
+    for (int i = 0; names[i] != NULL; i++) {
+        if (strcmp(names[i], name) == 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+enum sm_action_result served_handle_state_dependencies_batch(void* context)
+{
+    struct served_transaction* transaction = context;
+    struct state_transaction*  packages;
+    char**                     names = NULL;
+    char**                     added = NULL;
+    int                        addedCount = 0;
+    int                        count = 0;
+    sm_event_t                 event = SERVED_TX_EVENT_FAILED;
+
+    packages = served_state_transaction_packages(transaction->id, &count);
+    names = served_state_transaction_package_names(transaction->id);
+    added = calloc(count + 1, sizeof(char*));
+    if (packages == NULL || names == NULL || added == NULL) {
+        TXLOG_ERROR(transaction, "Failed to load transaction state while resolving dependencies");
+        goto cleanup;
+    }
+
+    // Bases that are neither installed nor part of the batch are added to the batch,
+    // scheduling separate transactions for them would wait on the batch itself
+    for (int i = 0; i < count; i++) {
+        char* base;
+
+        if (__package_base(&packages[i], &base)) {
+            TXLOG_ERROR(transaction, "Failed to load package %s: %s", packages[i].name, strerror(errno));
+            goto cleanup;
+        }
+
+        if (base == NULL || __in_list(names, base) || __in_list(added, base)) {
+            free(base);
+            continue;
+        }
+
+        served_state_lock();
+        if (served_state_application(base) != NULL) {
+            served_state_unlock();
+            free(base);
+            continue;
+        }
+
+        if (served_state_transaction_state_new(transaction->id, &(struct state_transaction) {
+                .name = base,
+                .channel = "stable"
+            })) {
+            served_state_unlock();
+            TXLOG_ERROR(transaction, "Failed to add base %s required by %s", base, packages[i].name);
+            free(base);
+            goto cleanup;
+        }
+        served_state_unlock();
+
+        TXLOG_INFO(transaction, "Base %s required by %s added to the batch", base, packages[i].name);
+        added[addedCount++] = base;
+    }
+
+    // Packages that were already downloaded are not downloaded again, so only
+    // the bases are fetched on the next round
+    event = addedCount != 0 ? SERVED_TX_EVENT_RETRY : SERVED_TX_EVENT_OK;
+    if (addedCount == 0) {
+        TXLOG_INFO(transaction, "Package dependencies resolved for %i packages", count);
+    }
+
+cleanup:
+    served_state_transaction_packages_free(packages, count);
+    strsplit_free(names);
+    strsplit_free(added);
+    served_sm_post_event(&transaction->sm, event);
+    return SM_ACTION_CONTINUE;
+}
@@ -27,6 +27,9 @@
 
 #include <chef/store.h>
 #include <chef/platform.h>
+#include <stdlib.h>
+#include <string.h>
+#include <threads.h>
 #include <vlog.h>
 
 // Protocol headers for event emission
@@ -35,6 +38,9 @@
 // Progress reporting threshold (only report every 5% change)
 #define PROGRESS_REPORT_THRESHOLD 5
 
+// Number of packages of a batch that are downloaded concurrently
+#define DOWNLOAD_WORKER_COUNT 4
+
 static void __emit_io_progress(
     unsigned long long bytes_current,
     unsigned long long bytes_total,
@@ -74,16 +80,79 @@ static void __emit_io_progress(
                bytes_current, bytes_total, percentage);
 }
 
+// __installed_revision returns the newest revision of the application that is
+// installed, or 0 if the application is not installed. Expects the state lock held.
+static int __installed_revision(const char* name)
+{
+    struct state_application* application;
+    int                        revision = 0;
+
+    application = served_state_application(name);
+    if (application == NULL) {
+        return 0;
+    }
+
+    for (int i = 0; i < application->revisions_count; i++) {
+        struct chef_version* version = application->revisions[i].version;
+        if (version != NULL && version->revision > revision) {
+            revision = version->revision;
+        }
+    }
+    return revision;
+}
+
+// __download_delta reconstructs the new revision from the installed revision and
+// a delta, and digests the package while it is written so it can be verified
+// without reading it again.
+static int __download_delta(struct served_transaction* transaction, struct store_package* package, int baseRevision)
+{
+    struct utils_package_digest* digest;
+    int                          status;
+
+    digest = utils_package_digest_new();
+    if (digest == NULL) {
+        return -1;
+    }
+
+    status = store_ensure_package_delta(
+        package,
+        &(struct store_delta_options) {
+            .base_revision = baseRevision,
+            .stream = utils_package_digest_update,
+            .stream_context = digest
+        },
+        &(struct chef_observer){
+            .report = __emit_io_progress,
+            .userData = transaction
+        }
+    );
+    // the stream is not invoked if the package was already present, in which
+    // case the verify state digests the package itself
+    if (status == 0 && utils_package_digest_finish(digest, &transaction->package_digest[0], &transaction->package_digest_length)) {
+        transaction->package_digest_length = 0;
+    }
+    utils_package_digest_delete(digest);
+    return status;
+}
+
+static void __package_free(struct store_package* package)
+{
+    free((void*)package->name);
+    free((void*)package->channel);
+}
+
 enum sm_action_result served_handle_state_download(void* context)
 {
     struct served_transaction* transaction = context;
     struct state_transaction*  state;
     struct store_package       package = { NULL };
+    int                        baseRevision;
     int                        status;
 
     transaction->io_progress.bytes_current = 0;
     transaction->io_progress.bytes_total = 0;
     transaction->io_progress.last_reported_percentage = 0;
+    transaction->package_digest_length = 0;
 
     served_state_lock();
     state = served_state_transaction(transaction->id);
@@ -93,14 +162,37 @@ enum sm_action_result served_handle_state_download(void* context)
         return SM_ACTION_CONTINUE;
     }
 
-    package.name = state->name;
+    // The download runs without the state lock, so copy the package identity
+    package.name = platform_strdup(state->name);
     package.platform = CHEF_PLATFORM_STR; // always host
     package.arch = CHEF_ARCHITECTURE_STR; // always host
-    package.channel = state->channel;
+    package.channel = state->channel ? platform_strdup(state->channel) : NULL;
     package.revision = state->revision;
+    baseRevision = __installed_revision(state->name);
     
     served_state_unlock();
 
+    // When updating, try to reconstruct the new revision from the installed one
+    // before falling back to downloading the full package
+    if (baseRevision != 0 && baseRevision != package.revision) {
+        status = __download_delta(transaction, &package, baseRevision);
+        if (status == 0) {
+            TXLOG_INFO(transaction, "Package updated from revision %i using delta", baseRevision);
+            __package_free(&package);
+            served_sm_post_event(&transaction->sm, SERVED_TX_EVENT_OK);
+            return SM_ACTION_CONTINUE;
+        }
+
+        if (errno != ENOENT && errno != ENOTSUP) {
+            TXLOG_WARNING(transaction, "Delta update failed (%s), downloading full package", strerror(errno));
+        }
+        transaction->io_progress.bytes_current = 0;
+        transaction->io_progress.bytes_total = 0;
+        transaction->io_progress.last_reported_percentage = 0;
+        transaction->package_digest_length = 0;
+        errno = 0;
+    }
+
     status = store_ensure_package(
         &package,
         &(struct chef_observer){
@@ -122,11 +214,13 @@ enum sm_action_result served_handle_state_download(void* context)
             TXLOG_ERROR(transaction, "Failed to download package (unknown error)");
         }
         
+        __package_free(&package);
         served_sm_post_event(&transaction->sm, SERVED_TX_EVENT_FAILED);
         return SM_ACTION_CONTINUE;
     }
 
     TXLOG_INFO(transaction, "Package downloaded successfully");
+    __package_free(&package);
     served_sm_post_event(&transaction->sm, SERVED_TX_EVENT_OK);
     return SM_ACTION_CONTINUE;
 }
@@ -140,3 +234,155 @@ enum sm_action_result served_handle_state_download_retry(void* context)
     served_sm_post_event(&transaction->sm, SERVED_TX_EVENT_OK);
     return SM_ACTION_CONTINUE;
 }
+
+struct __batch_download;
+
+struct __batch_download_package {
+    struct __batch_download* batch;
+    unsigned long long       bytes_current;
+    unsigned long long       bytes_total;
+    int                      done;
+};
+
+struct __batch_download {
+    struct served_transaction*       transaction;
+    struct state_transaction*        packages;
+    struct __batch_download_package* progress;
+    int                              count;
+    int                              failed;
+    mtx_t                            lock;
+};
+
+// __emit_batch_progress reports the progress of all the downloads of a batch as
+// one stream. The percentage is the average of the packages, so packages whose
+// size is not known yet do not make the progress jump backwards.
+static void __emit_batch_progress(
+    unsigned long long bytes_current,
+    unsigned long long bytes_total,
+    void*              context)
+{
+    struct __batch_download_package* package = context;
+    struct __batch_download*         batch = package->batch;
+    struct served_transaction*       transaction = batch->transaction;
+    unsigned long long               current = 0;
+    unsigned long long               total = 0;
+    unsigned int                     percentage = 0;
+
+    mtx_lock(&batch->lock);
+    package->bytes_current = bytes_current;
+    package->bytes_total = bytes_total;
+    for (int i = 0; i < batch->count; i++) {
+        struct __batch_download_package* entry = &batch->progress[i];
+
+        current += entry->bytes_current;
+        total += entry->bytes_total;
+        if (entry->done) {
+            percentage += 100;
+        } else if (entry->bytes_total != 0) {
+            percentage += (unsigned int)((entry->bytes_current * 100) / entry->bytes_total);
+        }
+    }
+    percentage /= (unsigned int)batch->count;
+
+    if (percentage < transaction->io_progress.last_reported_percentage + PROGRESS_REPORT_THRESHOLD &&
+        (percentage < 100 || transaction->io_progress.last_reported_percentage == 100)) {
+        mtx_unlock(&batch->lock);
+        return;
+    }
+
+    transaction->io_progress.bytes_current = current;
+    transaction->io_progress.bytes_total = total;
+    transaction->io_progress.last_reported_percentage = percentage;
+
+    // emitted while holding the lock to keep the events in order
+    chef_served_event_transaction_io_progress_all(
+        served_gracht_server(),
+        &(struct chef_transaction_io_progress) {
+            .id = transaction->id,
+            .state = CHEF_TRANSACTION_STATE_DOWNLOADING,
+            .bytes_current = current,
+            .bytes_total = total,
+            .percentage = percentage
+        }
+    );
+    mtx_unlock(&batch->lock);
+}
+
+static void __download_batch_package(int index, void* context)
+{
+    struct __batch_download*         batch = context;
+    struct __batch_download_package* progress = &batch->progress[index];
+    struct state_transaction*        state = &batch->packages[index];
+    int                              status;
+
+    status = store_ensure_package(
+        &(struct store_package) {
+            .name = state->name,
+            .platform = CHEF_PLATFORM_STR, // always host
+            .arch = CHEF_ARCHITECTURE_STR, // always host
+            .channel = state->channel,
+            .revision = state->revision
+        },
+        &(struct chef_observer){
+            .report = __emit_batch_progress,
+            .userData = progress
+        }
+    );
+    if (status) {
+        TXLOG_ERROR(batch->transaction, "Failed to download %s: %s", state->name,
+            errno != 0 ? strerror(errno) : "unknown error");
+        mtx_lock(&batch->lock);
+        batch->failed++;
+        mtx_unlock(&batch->lock);
+        return;
+    }
+
+    mtx_lock(&batch->lock);
+    progress->done = 1;
+    mtx_unlock(&batch->lock);
+    __emit_batch_progress(progress->bytes_total, progress->bytes_total, progress);
+}
+
+enum sm_action_result served_handle_state_download_batch(void* context)
+{
+    struct served_transaction* transaction = context;
+    struct __batch_download    batch = { .transaction = transaction };
+    sm_event_t                 event = SERVED_TX_EVENT_FAILED;
+
+    transaction->io_progress.bytes_current = 0;
+    transaction->io_progress.bytes_total = 0;
+    transaction->io_progress.last_reported_percentage = 0;
+
+    batch.packages = served_state_transaction_packages(transaction->id, &batch.count);
+    if (batch.packages == NULL) {
+        goto cleanup;
+    }
+
+    batch.progress = calloc(batch.count, sizeof(struct __batch_download_package));
+    if (batch.progress == NULL || mtx_init(&batch.lock, mtx_plain) != thrd_success) {
+        goto cleanup;
+    }
+
+    for (int i = 0; i < batch.count; i++) {
+        batch.progress[i].batch = &batch;
+    }
+
+    utils_parallel_foreach(batch.count, DOWNLOAD_WORKER_COUNT, __download_batch_package, &batch);
+    mtx_destroy(&batch.lock);
+
+    // The batch is installed as a whole, so nothing is installed if any of
+    // the packages could not be downloaded
+    if (batch.failed) {
+        TXLOG_ERROR(transaction, "%i of %i packages could not be downloaded", batch.failed, batch.count);
+        goto cleanup;
+    }
+
+    TXLOG_INFO(transaction, "%i packages downloaded successfully", batch.count);
+    event = SERVED_TX_EVENT_OK;
+
+cleanup:
+    served_state_transaction_packages_free(batch.packages, batch.count);
+    free(batch.progress);
+    served_sm_post_event(&transaction->sm, event);
+    return SM_ACTION_CONTINUE;
+}
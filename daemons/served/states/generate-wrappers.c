@@ -177,7 +177,7 @@ static void __format_container_name(const char* name, char* buffer)
 
 static int __generate_wrappers(const char* appName)
 {
-    struct state_application* application;
+    struct state_application* application = NULL;
     char*                     sexecPath = __serve_exec_path();
     char                      name[CHEF_PACKAGE_ID_LENGTH_MAX];
 
@@ -186,7 +186,9 @@ static int __generate_wrappers(const char* appName)
         return -1;
     }
 
-    application = served_state_application(appName);
+    // Wrappers are written to disk, so work on a copy of the application instead
+    // of holding the state lock
+    application = served_state_application_copy(appName);
     if (application == NULL) {
         goto cleanup;
     }
@@ -256,6 +258,7 @@ static int __generate_wrappers(const char* appName)
     }
 
 cleanup:
+    served_state_application_copy_free(application);
     free(sexecPath);
     return 0;
 }
@@ -264,19 +267,22 @@ enum sm_action_result served_handle_state_generate_wrappers(void* context)
 {
     struct served_transaction* transaction = context;
     struct state_transaction*  state;
+    char*                      name;
 
     served_state_lock();
     state = served_state_transaction(transaction->id);
-    if (state == NULL) {
+    name = state != NULL ? platform_strdup(state->name) : NULL;
+    served_state_unlock();
+    if (name == NULL) {
         goto cleanup;
     }
 
-    if (__generate_wrappers(state->name)) {
+    if (__generate_wrappers(name)) {
         goto cleanup;
     }
 
 cleanup:
-    served_state_unlock();
+    free(name);
     served_sm_post_event(&transaction->sm, SERVED_TX_EVENT_OK);
     return SM_ACTION_CONTINUE;
 }
@@ -284,20 +290,16 @@ cleanup:
 enum sm_action_result served_handle_state_generate_wrappers_all(void* context)
 {
     struct served_transaction* transaction = context;
-    struct state_application*  applications;
-    int                        count;
-    int                        status;
+    char**                     names;
     sm_event_t                 event = SERVED_TX_EVENT_FAILED;
     
-    served_state_lock();
-    status = served_state_get_applications(&applications, &count);
-    if (status) {
+    names = served_state_application_names();
+    if (names == NULL) {
         goto cleanup;
     }
 
-    for (int i = 0; i < count; i++) {
-        struct state_application* app = &applications[i];
-        if (__generate_wrappers(app->name)) {
+    for (int i = 0; names[i] != NULL; i++) {
+        if (__generate_wrappers(names[i])) {
             goto cleanup;
         }
     }
@@ -305,7 +307,32 @@ enum sm_action_result served_handle_state_generate_wrappers_all(void* context)
     event = SERVED_TX_EVENT_OK;
 
 cleanup:
-    served_state_unlock();
+    strsplit_free(names);
+    served_sm_post_event(&transaction->sm, event);
+    return SM_ACTION_CONTINUE;
+}
+
+enum sm_action_result served_handle_state_generate_wrappers_batch(void* context)
+{
+    struct served_transaction* transaction = context;
+    char**                     names;
+    sm_event_t                 event = SERVED_TX_EVENT_FAILED;
+
+    names = served_state_transaction_package_names(transaction->id);
+    if (names == NULL) {
+        goto cleanup;
+    }
+
+    for (int i = 0; names[i] != NULL; i++) {
+        if (__generate_wrappers(names[i])) {
+            goto cleanup;
+        }
+    }
+
+    event = SERVED_TX_EVENT_OK;
+
+cleanup:
+    strsplit_free(names);
     served_sm_post_event(&transaction->sm, event);
     return SM_ACTION_CONTINUE;
 }
@@ -25,7 +25,9 @@
 #include <chef/platform.h>
 #include <chef/store.h>
 #include <vlog.h>
+#include <errno.h>
 #include <stdlib.h>
+#include <string.h>
 
 static struct state_application* __application_new(const char* name)
 {
@@ -36,18 +38,25 @@ static struct state_application* __application_new(const char* name)
         return NULL;
     }
 
-    application->name = name;
+    application->name = platform_strdup(name);
+    if (application->name == NULL) {
+        free(application);
+        return NULL;
+    }
     return application;
 }
 
 static int __application_add_revision(struct state_application* application, const char* channel, struct chef_version* version)
 {
-    application->revisions = realloc(application->revisions, application->revisions_count + 1);
-    if (application->revisions == NULL) {
+    struct state_application_revision* revisions;
+
+    revisions = realloc(application->revisions, sizeof(struct state_application_revision) * (application->revisions_count + 1));
+    if (revisions == NULL) {
         return -1;
     }
+    application->revisions = revisions;
 
-    application->revisions[application->revisions_count].tracking_channel = channel;
+    application->revisions[application->revisions_count].tracking_channel = channel ? platform_strdup(channel) : NULL;
     application->revisions[application->revisions_count].version = version;
     application->revisions_count++;
     return 0;
@@ -112,13 +121,16 @@ enum sm_action_result served_handle_state_install(void* context)
 {
     struct served_transaction* transaction = context;
     struct state_transaction*  state;
-    struct state_application*  application;
+    struct state_transaction   package = { 0 };
+    struct state_application*  application = NULL;
     sm_event_t                 event = SERVED_TX_EVENT_FAILED;
     char*                      storagePath = NULL;
     const char*                path;
     char**                     names = NULL;
     int                        status;
 
+    // Copy what we need from the transaction, the package is copied and loaded
+    // without holding the state lock
     served_state_lock();
     state = served_state_transaction(transaction->id);
     if (state == NULL) {
@@ -126,22 +138,29 @@ enum sm_action_result served_handle_state_install(void* context)
         served_sm_post_event(&transaction->sm, SERVED_TX_EVENT_FAILED);
         return SM_ACTION_CONTINUE;
     }
+    package.name = platform_strdup(state->name);
+    package.channel = state->channel ? platform_strdup(state->channel) : NULL;
+    package.revision = state->revision;
     served_state_unlock();
 
-    names = utils_split_package_name(state->name);
+    if (package.name == NULL) {
+        goto cleanup;
+    }
+
+    names = utils_split_package_name(package.name);
     if (names == NULL) {
         goto cleanup;
     }
 
     status = store_package_path(&(struct store_package) {
-        .name = state->name,
+        .name = package.name,
         .platform = CHEF_PLATFORM_STR,
         .arch = CHEF_ARCHITECTURE_STR,
         .channel = NULL,
-        .revision = state->revision
+        .revision = package.revision
     }, &path);
     if (status) {
-        VLOG_ERROR("served", "could not find the revision %i for %s\n", state->revision, state->name);
+        VLOG_ERROR("served", "could not find the revision %i for %s\n", package.revision, package.name);
         goto cleanup;
     }
 
@@ -155,25 +174,142 @@ enum sm_action_result served_handle_state_install(void* context)
         goto cleanup;
     }
 
-    served_state_lock();
-    status = __load_application_package(state, path, &application);
+    status = __load_application_package(&package, path, &application);
     if (status) {
-        served_state_unlock();
         goto cleanup;
     }
 
+    served_state_lock();
     status = served_state_add_application(application);
+    served_state_unlock();
     if (status) {
-        served_state_unlock();
         goto cleanup;
     }
-    served_state_unlock();
-    
+
+    // the state owns the application members now
+    free(application);
+    application = NULL;
     event = SERVED_TX_EVENT_OK;
 
 cleanup:
+    served_state_application_copy_free(application);
+    free((void*)package.name);
+    free((void*)package.channel);
     strsplit_free(names);
     free((void*)storagePath);
     served_sm_post_event(&transaction->sm, event);
     return SM_ACTION_CONTINUE;
 }
+
+// __stage_package copies the package of a batch into place and prepares its
+// application, without touching the state
+static int __stage_package(struct state_transaction* package, struct state_application** applicationOut)
+{
+    const char* path = NULL;
+    char*       storagePath = NULL;
+    char**      names;
+    int         status = -1;
+
+    names = utils_split_package_name(package->name);
+    if (names == NULL) {
+        return -1;
+    }
+
+    status = store_package_path(&(struct store_package) {
+        .name = package->name,
+        .platform = CHEF_PLATFORM_STR,
+        .arch = CHEF_ARCHITECTURE_STR,
+        .channel = NULL,
+        .revision = package->revision
+    }, &path);
+    if (status) {
+        goto cleanup;
+    }
+
+    storagePath = utils_path_pack(names[0], names[1]);
+    if (storagePath == NULL) {
+        status = -1;
+        goto cleanup;
+    }
+
+    status = platform_copyfile(path, storagePath);
+    if (status) {
+        goto cleanup;
+    }
+
+    status = __load_application_package(package, path, applicationOut);
+
+cleanup:
+    strsplit_free(names);
+    free((void*)path);
+    free(storagePath);
+    return status;
+}
+
+enum sm_action_result served_handle_state_install_batch(void* context)
+{
+    struct served_transaction*  transaction = context;
+    struct state_transaction*   packages;
+    struct state_application**  applications = NULL;
+    sm_event_t                  event = SERVED_TX_EVENT_FAILED;
+    int                         count = 0;
+    int                         status = 0;
+
+    packages = served_state_transaction_packages(transaction->id, &count);
+    if (packages == NULL) {
+        goto cleanup;
+    }
+
+    applications = calloc(count, sizeof(struct state_application*));
+    if (applications == NULL) {
+        goto cleanup;
+    }
+
+    // Copying and parsing the packages is done without the state lock
+    for (int i = 0; i < count; i++) {
+        if (__stage_package(&packages[i], &applications[i])) {
+            TXLOG_ERROR(transaction, "Failed to install %s: %s", packages[i].name, strerror(errno));
+            goto cleanup;
+        }
+    }
+
+    // All applications are added under one lock, so the batch is committed to
+    // the database at once. Applications that are updated replace the
+    // installed ones.
+    served_state_lock();
+    for (int i = 0; i < count; i++) {
+        struct state_application* installed = served_state_application(applications[i]->name);
+        if (installed != NULL) {
+            status = served_state_remove_application(installed);
+        }
+        if (status == 0) {
+            status = served_state_add_application(applications[i]);
+        }
+        if (status) {
+            TXLOG_ERROR(transaction, "Failed to add %s to the state", applications[i]->name);
+            break;
+        }
+
+        // the state owns the application members now
+        free(applications[i]);
+        applications[i] = NULL;
+    }
+    served_state_unlock();
+    if (status) {
+        goto cleanup;
+    }
+
+    TXLOG_INFO(transaction, "%i packages installed successfully", count);
+    event = SERVED_TX_EVENT_OK;
+
+cleanup:
+    if (applications != NULL) {
+        for (int i = 0; i < count; i++) {
+            served_state_application_copy_free(applications[i]);
+        }
+        free(applications);
+    }
+    served_state_transaction_packages_free(packages, count);
+    served_sm_post_event(&transaction->sm, event);
+    return SM_ACTION_CONTINUE;
+}
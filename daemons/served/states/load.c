@@ -18,6 +18,7 @@
 
 #include <transaction/states/load.h>
 #include <transaction/transaction.h>
+#include <transaction/logging.h>
 #include <state.h>
 #include <utils.h>
 
@@ -25,6 +26,25 @@
 #include <errno.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+#include <threads.h>
+#include <vlog.h>
+
+// Number of applications whose containers are created concurrently
+#define LOAD_WORKER_COUNT 4
+
+// When set, applications without services are not loaded during startup, but
+// when they are first used
+static int g_deferLoading = 0;
+
+struct __load_context {
+    mtx_t  lock;
+    char** names;
+    int    deferrable;
+    int    loaded;
+    int    deferred;
+    int    failed;
+};
 
 static int __load_application(const char* name)
 {
@@ -47,7 +67,9 @@ static int __load_application(const char* name)
     snprintf(&containerId[0], sizeof(containerId), "%s.%s", names[0], names[1]);
     strsplit_free(names);
 
-    application = served_state_application(name);
+    // Creating the container can take a while, so work on a copy of the
+    // application instead of holding the state lock
+    application = served_state_application_copy(name);
     if (application == NULL) {
         free(package);
         return -1;
@@ -59,12 +81,21 @@ static int __load_application(const char* name)
         .rootfs = application->base,
         .package = package,
     });
+    served_state_application_copy_free(application);
     free(package);
     if (status && errno != EEXIST) {
         return -1;
     }
 
+    served_state_lock();
+    application = served_state_application(name);
+    if (application == NULL) {
+        served_state_unlock();
+        return -1;
+    }
+    free((void*)application->container_id);
     application->container_id = platform_strdup(&containerId[0]);
+    served_state_unlock();
     return 0;
 }
 
@@ -72,51 +103,172 @@ enum sm_action_result served_handle_state_load(void* context)
 {
     struct served_transaction* transaction = context;
     struct state_transaction*  state;
+    char*                      name;
     sm_event_t                 event = SERVED_TX_EVENT_FAILED;
 
     served_state_lock();
     state = served_state_transaction(transaction->id);
-    if (state == NULL) {
+    name = state != NULL ? platform_strdup(state->name) : NULL;
+    served_state_unlock();
+    if (name == NULL) {
         goto cleanup;
     }
 
-    if (__load_application(state->name)) {
+    if (__load_application(name)) {
         goto cleanup;
     }
 
     event = SERVED_TX_EVENT_OK;
 
 cleanup:
-    served_state_unlock();
+    free(name);
     served_sm_post_event(&transaction->sm, event);
     return SM_ACTION_CONTINUE;
 }
 
+// __is_eager returns whether an application must be loaded during startup. This
+// is the case for applications that provide services, as they are started right
+// after loading.
+static int __is_eager(const char* name)
+{
+    struct state_application* application;
+    int                       eager = 0;
+
+    application = served_state_application_copy(name);
+    if (application == NULL) {
+        return 1;
+    }
+
+    for (int i = 0; i < application->commands_count; i++) {
+        if (application->commands[i].type == CHEF_COMMAND_TYPE_DAEMON) {
+            eager = 1;
+            break;
+        }
+    }
+    served_state_application_copy_free(application);
+    return eager;
+}
+
+static void __load_worker(int index, void* arg)
+{
+    struct __load_context* context = arg;
+    const char*            name = context->names[index];
+    int                    status;
+
+    if (context->deferrable && g_deferLoading && !__is_eager(name)) {
+        VLOG_DEBUG("served", "deferring load of application %s until first use\n", name);
+        mtx_lock(&context->lock);
+        context->deferred++;
+        mtx_unlock(&context->lock);
+        return;
+    }
+
+    // A broken application must not prevent the rest from being loaded
+    status = __load_application(name);
+    if (status) {
+        VLOG_ERROR("served", "failed to load application %s: %s\n", name, strerror(errno));
+    }
+
+    mtx_lock(&context->lock);
+    if (status) {
+        context->failed++;
+    } else {
+        context->loaded++;
+    }
+    mtx_unlock(&context->lock);
+}
+
+// __load_applications creates the containers of the applications concurrently,
+// returns the number of applications that could not be loaded
+static int __load_applications(struct __load_context* context)
+{
+    int count = 0;
+
+    if (mtx_init(&context->lock, mtx_plain) != thrd_success) {
+        return -1;
+    }
+
+    while (context->names[count] != NULL) {
+        count++;
+    }
+
+    utils_parallel_foreach(count, LOAD_WORKER_COUNT, __load_worker, context);
+    mtx_destroy(&context->lock);
+
+    VLOG_DEBUG("served", "loaded %i of %i applications (%i deferred, %i failed)\n",
+        context->loaded, count, context->deferred, context->failed);
+    return context->failed;
+}
+
 enum sm_action_result served_handle_state_load_all(void* context)
 {
     struct served_transaction* transaction = context;
-    struct state_application*  applications;
-    int                        count;
-    int                        status;
+    struct __load_context      loadContext = { .deferrable = 1 };
     sm_event_t                 event = SERVED_TX_EVENT_FAILED;
     
-    served_state_lock();
-    status = served_state_get_applications(&applications, &count);
-    if (status) {
+    loadContext.names = served_state_application_names();
+    if (loadContext.names == NULL) {
         goto cleanup;
     }
 
-    for (int i = 0; i < count; i++) {
-        struct state_application* app = &applications[i];
-        if (__load_application(app->name)) {
-            goto cleanup;
-        }
+    // Failed applications are logged and skipped, startup continues with
+    // the applications that could be loaded
+    if (__load_applications(&loadContext) < 0) {
+        goto cleanup;
+    }
+    event = SERVED_TX_EVENT_OK;
+
+cleanup:
+    strsplit_free(loadContext.names);
+    served_sm_post_event(&transaction->sm, event);
+    return SM_ACTION_CONTINUE;
+}
+
+enum sm_action_result served_handle_state_load_batch(void* context)
+{
+    struct served_transaction* transaction = context;
+    struct __load_context      loadContext = { .deferrable = 0 };
+    sm_event_t                 event = SERVED_TX_EVENT_FAILED;
+
+    loadContext.names = served_state_transaction_package_names(transaction->id);
+    if (loadContext.names == NULL) {
+        goto cleanup;
     }
 
+    if (__load_applications(&loadContext)) {
+        TXLOG_ERROR(transaction, "Failed to load %i of the installed packages", loadContext.failed);
+        goto cleanup;
+    }
     event = SERVED_TX_EVENT_OK;
 
 cleanup:
-    served_state_unlock();
+    strsplit_free(loadContext.names);
     served_sm_post_event(&transaction->sm, event);
     return SM_ACTION_CONTINUE;
 }
+
+void served_load_set_deferred(int enabled)
+{
+    g_deferLoading = enabled;
+}
+
+int served_application_load(const char* name)
+{
+    struct state_application* application;
+    int                       loaded;
+
+    served_state_lock();
+    application = served_state_application(name);
+    if (application == NULL) {
+        served_state_unlock();
+        errno = ENOENT;
+        return -1;
+    }
+    loaded = application->container_id != NULL;
+    served_state_unlock();
+
+    if (loaded) {
+        return 0;
+    }
+    return __load_application(name);
+}
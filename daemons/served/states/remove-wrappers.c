@@ -29,7 +29,7 @@ static int __remove_wrappers(const char* name)
 {
     struct state_application*  application;
 
-    application = served_state_application(name);
+    application = served_state_application_copy(name);
     if (application == NULL) {
         return -1;
     }
@@ -55,6 +55,7 @@ static int __remove_wrappers(const char* name)
         }
         free(wrapperPath);
     }
+    served_state_application_copy_free(application);
     return 0;
 }
 
@@ -62,17 +63,20 @@ enum sm_action_result served_handle_state_remove_wrappers(void* context)
 {
     struct served_transaction* transaction = context;
     struct state_transaction*  state;
+    char*                      name;
 
     served_state_lock();
     state = served_state_transaction(transaction->id);
-    if (state == NULL) {
+    name = state != NULL ? platform_strdup(state->name) : NULL;
+    served_state_unlock();
+    if (name == NULL) {
         goto cleanup;
     }
 
-    __remove_wrappers(state->name);
+    __remove_wrappers(name);
 
 cleanup:
-    served_state_unlock();
+    free(name);
     served_sm_post_event(&transaction->sm, SERVED_TX_EVENT_OK);
     return SM_ACTION_CONTINUE;
 }
@@ -80,20 +84,16 @@ cleanup:
 enum sm_action_result served_handle_state_remove_wrappers_all(void* context)
 {
     struct served_transaction* transaction = context;
-    struct state_application*  applications;
-    int                        count;
-    int                        status;
+    char**                     names;
     sm_event_t                 event = SERVED_TX_EVENT_FAILED;
     
-    served_state_lock();
-    status = served_state_get_applications(&applications, &count);
-    if (status) {
+    names = served_state_application_names();
+    if (names == NULL) {
         goto cleanup;
     }
 
-    for (int i = 0; i < count; i++) {
-        struct state_application* app = &applications[i];
-        if (__remove_wrappers(app->name)) {
+    for (int i = 0; names[i] != NULL; i++) {
+        if (__remove_wrappers(names[i])) {
             goto cleanup;
         }
     }
@@ -101,7 +101,31 @@ enum sm_action_result served_handle_state_remove_wrappers_all(void* context)
     event = SERVED_TX_EVENT_OK;
 
 cleanup:
-    served_state_unlock();
+    strsplit_free(names);
+    served_sm_post_event(&transaction->sm, event);
+    return SM_ACTION_CONTINUE;
+}
+
+enum sm_action_result served_handle_state_remove_wrappers_batch(void* context)
+{
+    struct served_transaction* transaction = context;
+    char**                     names;
+    sm_event_t                 event = SERVED_TX_EVENT_FAILED;
+
+    names = served_state_transaction_package_names(transaction->id);
+    if (names == NULL) {
+        goto cleanup;
+    }
+
+    // Packages that are not installed yet have no wrappers to remove
+    for (int i = 0; names[i] != NULL; i++) {
+        (void)__remove_wrappers(names[i]);
+    }
+
+    event = SERVED_TX_EVENT_OK;
+
+cleanup:
+    strsplit_free(names);
     served_sm_post_event(&transaction->sm, event);
     return SM_ACTION_CONTINUE;
 }
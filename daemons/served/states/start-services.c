@@ -18,19 +18,50 @@
 
 #include <transaction/states/start-services.h>
 #include <transaction/transaction.h>
+#include <transaction/logging.h>
 #include <state.h>
 #include <utils.h>
 
+#include <chef/platform.h>
+#include <stdlib.h>
+#include <vlog.h>
+
+// __store_pids updates the process ids of the application daemons in the state
+// once they have been spawned.
+static void __store_pids(struct state_application* copy)
+{
+    struct state_application* application;
+
+    served_state_lock();
+    application = served_state_application(copy->name);
+    if (application != NULL && application->commands_count == copy->commands_count) {
+        for (int i = 0; i < copy->commands_count; i++) {
+            application->commands[i].pid = copy->commands[i].pid;
+        }
+    }
+    served_state_unlock();
+}
+
 static int __start_application_services(const char* name)
 {
     struct state_application* application;
-    int                       status = -1;
+    int                       status = 0;
 
-    application = served_state_application(name);
+    // Spawning goes through the container service, so work on a copy of the
+    // application instead of holding the state lock
+    application = served_state_application_copy(name);
     if (application == NULL) {
         return -1;
     }
 
+    // Applications that failed to load, or whose loading was deferred, have
+    // no container to start services in
+    if (application->container_id == NULL) {
+        VLOG_WARNING("served", "application %s is not loaded, skipping its services\n", name);
+        served_state_application_copy_free(application);
+        return 0;
+    }
+
     for (int i = 0; i < application->commands_count; i++) {
         if (application->commands[i].type != CHEF_COMMAND_TYPE_DAEMON) {
             continue;
@@ -44,30 +75,35 @@ static int __start_application_services(const char* name)
         );
         if (status) {
             // log
-            return status;
+            break;
         }
     }
 
-    return 0;
+    __store_pids(application);
+    served_state_application_copy_free(application);
+    return status;
 }
 
 enum sm_action_result served_handle_state_start_services(void* context)
 {
     struct served_transaction* transaction = context;
     struct state_transaction*  state;
+    char*                      name;
 
     served_state_lock();
     state = served_state_transaction(transaction->id);
-    if (state == NULL) {
+    name = state != NULL ? platform_strdup(state->name) : NULL;
+    served_state_unlock();
+    if (name == NULL) {
         goto cleanup;
     }
 
-    if (__start_application_services(state->name)) {
+    if (__start_application_services(name)) {
         goto cleanup;
     }
 
 cleanup:
-    served_state_unlock();
+    free(name);
     served_sm_post_event(&transaction->sm, SERVED_TX_EVENT_OK);
     return SM_ACTION_CONTINUE;
 }
@@ -75,20 +111,16 @@ cleanup:
 enum sm_action_result served_handle_state_start_services_all(void* context)
 {
     struct served_transaction* transaction = context;
-    struct state_application*  applications;
-    int                        count;
-    int                        status;
+    char**                     names;
     sm_event_t                 event = SERVED_TX_EVENT_FAILED;
     
-    served_state_lock();
-    status = served_state_get_applications(&applications, &count);
-    if (status) {
+    names = served_state_application_names();
+    if (names == NULL) {
         goto cleanup;
     }
 
-    for (int i = 0; i < count; i++) {
-        struct state_application* app = &applications[i];
-        if (__start_application_services(app->name)) {
+    for (int i = 0; names[i] != NULL; i++) {
+        if (__start_application_services(names[i])) {
             goto cleanup;
         }
     }
@@ -96,7 +128,33 @@ enum sm_action_result served_handle_state_start_services_all(void* context)
     event = SERVED_TX_EVENT_OK;
 
 cleanup:
-    served_state_unlock();
+    strsplit_free(names);
+    served_sm_post_event(&transaction->sm, event);
+    return SM_ACTION_CONTINUE;
+}
+
+enum sm_action_result served_handle_state_start_services_batch(void* context)
+{
+    struct served_transaction* transaction = context;
+    char**                     names;
+    sm_event_t                 event = SERVED_TX_EVENT_FAILED;
+
+    names = served_state_transaction_package_names(transaction->id);
+    if (names == NULL) {
+        goto cleanup;
+    }
+
+    for (int i = 0; names[i] != NULL; i++) {
+        if (__start_application_services(names[i])) {
+            TXLOG_ERROR(transaction, "Failed to start the services of %s", names[i]);
+            goto cleanup;
+        }
+    }
+
+    event = SERVED_TX_EVENT_OK;
+
+cleanup:
+    strsplit_free(names);
     served_sm_post_event(&transaction->sm, event);
     return SM_ACTION_CONTINUE;
 }
@@ -21,15 +21,24 @@
 #include <state.h>
 #include <utils.h>
 
+#include <chef/platform.h>
+#include <stdlib.h>
+
 static int __stop_application_services(const char* name)
 {
-    struct state_application*  application;
+    struct state_application* application;
 
-    application = served_state_application(name);
+    application = served_state_application_copy(name);
     if (application == NULL) {
         return -1;
     }
 
+    // Services only run in loaded applications
+    if (application->container_id == NULL) {
+        served_state_application_copy_free(application);
+        return 0;
+    }
+
     for (int i = 0; i < application->commands_count; i++) {
         int status;
 
@@ -45,6 +54,7 @@ static int __stop_application_services(const char* name)
             // log
         }
     }
+    served_state_application_copy_free(application);
     return 0;
 }
 
@@ -52,17 +62,20 @@ enum sm_action_result served_handle_state_stop_services(void* context)
 {
     struct served_transaction* transaction = context;
     struct state_transaction*  state;
+    char*                      name;
 
     served_state_lock();
     state = served_state_transaction(transaction->id);
-    if (state == NULL) {
+    name = state != NULL ? platform_strdup(state->name) : NULL;
+    served_state_unlock();
+    if (name == NULL) {
         goto cleanup;
     }
 
-    __stop_application_services(state->name);
+    __stop_application_services(name);
     
 cleanup:
-    served_state_unlock();
+    free(name);
     served_sm_post_event(&transaction->sm, SERVED_TX_EVENT_OK);
     return SM_ACTION_CONTINUE;
 }
@@ -70,20 +83,16 @@ cleanup:
 enum sm_action_result served_handle_state_stop_services_all(void* context)
 {
     struct served_transaction* transaction = context;
-    struct state_application*  applications;
-    int                        count;
-    int                        status;
+    char**                     names;
     sm_event_t                 event = SERVED_TX_EVENT_FAILED;
     
-    served_state_lock();
-    status = served_state_get_applications(&applications, &count);
-    if (status) {
+    names = served_state_application_names();
+    if (names == NULL) {
         goto cleanup;
     }
 
-    for (int i = 0; i < count; i++) {
-        struct state_application* app = &applications[i];
-        if (__stop_application_services(app->name)) {
+    for (int i = 0; names[i] != NULL; i++) {
+        if (__stop_application_services(names[i])) {
             goto cleanup;
         }
     }
@@ -91,7 +100,31 @@ enum sm_action_result served_handle_state_stop_services_all(void* context)
     event = SERVED_TX_EVENT_OK;
 
 cleanup:
-    served_state_unlock();
+    strsplit_free(names);
+    served_sm_post_event(&transaction->sm, event);
+    return SM_ACTION_CONTINUE;
+}
+
+enum sm_action_result served_handle_state_stop_services_batch(void* context)
+{
+    struct served_transaction* transaction = context;
+    char**                     names;
+    sm_event_t                 event = SERVED_TX_EVENT_FAILED;
+
+    names = served_state_transaction_package_names(transaction->id);
+    if (names == NULL) {
+        goto cleanup;
+    }
+
+    // Packages that are not installed yet have no services to stop
+    for (int i = 0; names[i] != NULL; i++) {
+        (void)__stop_application_services(names[i]);
+    }
+
+    event = SERVED_TX_EVENT_OK;
+
+cleanup:
+    strsplit_free(names);
     served_sm_post_event(&transaction->sm, event);
     return SM_ACTION_CONTINUE;
 }
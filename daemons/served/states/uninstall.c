@@ -31,6 +31,7 @@ enum sm_action_result served_handle_state_uninstall(void* context)
     struct state_transaction*  state;
     struct state_application*  application;
     sm_event_t                 event = SERVED_TX_EVENT_FAILED;
+    char*                      name = NULL;
     char*                      storagePath = NULL;
     char**                     names = NULL;
     int                        status;
@@ -42,35 +43,40 @@ enum sm_action_result served_handle_state_uninstall(void* context)
         served_sm_post_event(&transaction->sm, SERVED_TX_EVENT_FAILED);
         return SM_ACTION_CONTINUE;
     }
-    
-    // Get the application to uninstall
-    application = served_state_application(state->name);
-    if (application == NULL) {
-        VLOG_ERROR("served", "Application %s not found in state\n", state->name);
-        served_state_unlock();
-        served_sm_post_event(&transaction->sm, SERVED_TX_EVENT_FAILED);
-        return SM_ACTION_CONTINUE;
-    }
+    name = platform_strdup(state->name);
     served_state_unlock();
 
+    if (name == NULL) {
+        goto cleanup;
+    }
+
     // Split package name to get publisher/package components
-    names = utils_split_package_name(state->name);
+    names = utils_split_package_name(name);
     if (names == NULL) {
-        VLOG_ERROR("served", "Failed to split package name %s\n", state->name);
+        VLOG_ERROR("served", "Failed to split package name %s\n", name);
         goto cleanup;
     }
 
     // Build the storage path for the package file
     storagePath = utils_path_pack(names[0], names[1]);
     if (storagePath == NULL) {
-        VLOG_ERROR("served", "Failed to build storage path for %s\n", state->name);
+        VLOG_ERROR("served", "Failed to build storage path for %s\n", name);
         goto cleanup;
     }
 
+    // Look up the application again, pointers into the state are only valid
+    // while it is locked
     served_state_lock();
+    application = served_state_application(name);
+    if (application == NULL) {
+        VLOG_ERROR("served", "Application %s not found in state\n", name);
+        served_state_unlock();
+        goto cleanup;
+    }
+
     status = served_state_remove_application(application);
     if (status) {
-        VLOG_ERROR("served", "Failed to remove application %s from state: %d\n", state->name, status);
+        VLOG_ERROR("served", "Failed to remove application %s from state: %d\n", name, status);
         served_state_unlock();
         goto cleanup;
     }
@@ -79,14 +85,14 @@ enum sm_action_result served_handle_state_uninstall(void* context)
     status = platform_unlink(storagePath);
     if (status) {
         VLOG_ERROR("served", "Failed to remove package file %s: %d\n", storagePath, status);
-        served_state_unlock();
         goto cleanup;
     }
     
-    VLOG_DEBUG("served", "Successfully uninstalled package %s\n", state->name);
+    VLOG_DEBUG("served", "Successfully uninstalled package %s\n", name);
     event = SERVED_TX_EVENT_OK;
 
 cleanup:
+    free(name);
     strsplit_free(names);
     free((void*)storagePath);
     served_sm_post_event(&transaction->sm, event);
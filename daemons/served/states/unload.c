@@ -18,6 +18,7 @@
 
 #include <transaction/states/unload.h>
 #include <transaction/transaction.h>
+#include <transaction/logging.h>
 #include <state.h>
 #include <utils.h>
 
@@ -47,6 +48,19 @@ static int __unload_application(const char* name)
     return status;
 }
 
+// __is_loaded returns whether a container has been created for the application
+static int __is_loaded(const char* name)
+{
+    struct state_application* application;
+    int                       loaded;
+
+    served_state_lock();
+    application = served_state_application(name);
+    loaded = application != NULL && application->container_id != NULL;
+    served_state_unlock();
+    return loaded;
+}
+
 enum sm_action_result served_handle_state_unload(void* context)
 {
     struct served_transaction* transaction = context;
@@ -71,22 +85,19 @@ enum sm_action_result served_handle_state_unload(void* context)
 enum sm_action_result served_handle_state_unload_all(void* context)
 {
     struct served_transaction* transaction = context;
-    struct state_application*  applications;
-    int                        count;
+    char**                     names;
     int                        status;
     sm_event_t                 event = SERVED_TX_EVENT_FAILED;
     
-    served_state_lock();
-    status = served_state_get_applications(&applications, &count);
-    if (status) {
+    names = served_state_application_names();
+    if (names == NULL) {
         goto cleanup;
     }
 
-    for (int i = 0; i < count; i++) {
-        struct state_application* app = &applications[i];
-        status = __unload_application(app->name);
+    for (int i = 0; names[i] != NULL; i++) {
+        status = __unload_application(names[i]);
         if (status) {
-            VLOG_ERROR("served", "Failed to unload application %s: %d\n", app->name, status);
+            VLOG_ERROR("served", "Failed to unload application %s: %d\n", names[i], status);
             // continue
         }
     }
@@ -94,7 +105,39 @@ enum sm_action_result served_handle_state_unload_all(void* context)
     event = SERVED_TX_EVENT_OK;
 
 cleanup:
-    served_state_unlock();
+    strsplit_free(names);
+    served_sm_post_event(&transaction->sm, event);
+    return SM_ACTION_CONTINUE;
+}
+
+enum sm_action_result served_handle_state_unload_batch(void* context)
+{
+    struct served_transaction* transaction = context;
+    char**                     names;
+    sm_event_t                 event = SERVED_TX_EVENT_FAILED;
+
+    names = served_state_transaction_package_names(transaction->id);
+    if (names == NULL) {
+        goto cleanup;
+    }
+
+    // Only applications that are being updated have a container, and they are
+    // loaded again once the new revisions are installed
+    for (int i = 0; names[i] != NULL; i++) {
+        if (!__is_loaded(names[i])) {
+            continue;
+        }
+
+        if (__unload_application(names[i])) {
+            TXLOG_ERROR(transaction, "Failed to unload %s before updating it", names[i]);
+            goto cleanup;
+        }
+    }
+
+    event = SERVED_TX_EVENT_OK;
+
+cleanup:
+    strsplit_free(names);
     served_sm_post_event(&transaction->sm, event);
     return SM_ACTION_CONTINUE;
 }
@@ -19,6 +19,9 @@
 #include <chef/platform.h>
 #include <errno.h>
 #include <gracht/server.h>
+#include <stdlib.h>
+#include <string.h>
+#include <threads.h>
 #include <transaction/states/verify.h>
 #include <transaction/states/types.h>
 #include <transaction/transaction.h>
@@ -30,6 +33,9 @@
 // Protocol headers for event emission
 #include "chef_served_service_server.h"
 
+// Number of packages of a batch that are verified concurrently
+#define VERIFY_WORKER_COUNT 4
+
 static void __emit_verify_progress(
     struct served_transaction* transaction,
     unsigned long long bytes_current,
@@ -71,8 +77,8 @@ enum sm_action_result served_handle_state_verify(void* context)
     int                        status;
     char**                     names;
 
-    const char* name;
-    int revision;
+    char* name;
+    int   revision;
 
     // Reset progress tracking
     transaction->io_progress.bytes_current = 0;
@@ -87,11 +93,12 @@ enum sm_action_result served_handle_state_verify(void* context)
         return SM_ACTION_CONTINUE;
     }
 
-    name = state->name;
+    name = platform_strdup(state->name);
     revision = state->revision;
     served_state_unlock();
     
-    names = utils_split_package_name(name);
+    names = name != NULL ? utils_split_package_name(name) : NULL;
+    free(name);
     if (names == NULL) {
         TXLOG_ERROR(transaction,
             "Invalid package name format (must be 'publisher/package')");
@@ -102,7 +109,14 @@ enum sm_action_result served_handle_state_verify(void* context)
     // Emit progress events (start and end for now)
     __emit_verify_progress(transaction, 0, 100);
     
-    status = utils_verify_package(names[0], names[1], revision);
+    // If the package was digested while it was reconstructed, only the signature
+    // needs to be checked
+    if (transaction->package_digest_length != 0) {
+        status = utils_verify_package_digest(names[0], names[1], revision,
+            &transaction->package_digest[0], transaction->package_digest_length);
+    } else {
+        status = utils_verify_package(names[0], names[1], revision);
+    }
     
     if (status == 0) {
         __emit_verify_progress(transaction, 100, 100);
@@ -126,3 +140,78 @@ enum sm_action_result served_handle_state_verify(void* context)
     served_sm_post_event(&transaction->sm, SERVED_TX_EVENT_OK);
     return SM_ACTION_CONTINUE;
 }
+
+struct __batch_verify {
+    struct served_transaction* transaction;
+    struct state_transaction*  packages;
+    int                        count;
+    int                        verified;
+    int                        failed;
+    mtx_t                      lock;
+};
+
+static void __verify_batch_package(int index, void* context)
+{
+    struct __batch_verify*    batch = context;
+    struct state_transaction* state = &batch->packages[index];
+    char**                    names;
+    int                       status = -1;
+
+    names = utils_split_package_name(state->name);
+    if (names != NULL) {
+        status = utils_verify_package(names[0], names[1], state->revision);
+        strsplit_free(names);
+    }
+
+    if (status) {
+        TXLOG_ERROR(batch->transaction, "Verification of %s failed: %s", state->name,
+            errno != 0 ? strerror(errno) : "invalid signature or checksum");
+    }
+
+    // For batches the progress is reported in packages rather than bytes
+    mtx_lock(&batch->lock);
+    if (status) {
+        batch->failed++;
+    } else {
+        batch->verified++;
+    }
+    __emit_verify_progress(batch->transaction, batch->verified + batch->failed, batch->count);
+    mtx_unlock(&batch->lock);
+}
+
+enum sm_action_result served_handle_state_verify_batch(void* context)
+{
+    struct served_transaction* transaction = context;
+    struct __batch_verify      batch = { .transaction = transaction };
+    sm_event_t                 event = SERVED_TX_EVENT_FAILED;
+
+    transaction->io_progress.bytes_current = 0;
+    transaction->io_progress.bytes_total = 0;
+    transaction->io_progress.last_reported_percentage = 0;
+
+    batch.packages = served_state_transaction_packages(transaction->id, &batch.count);
+    if (batch.packages == NULL) {
+        goto cleanup;
+    }
+
+    if (mtx_init(&batch.lock, mtx_plain) != thrd_success) {
+        goto cleanup;
+    }
+
+    __emit_verify_progress(transaction, 0, batch.count);
+    utils_parallel_foreach(batch.count, VERIFY_WORKER_COUNT, __verify_batch_package, &batch);
+    mtx_destroy(&batch.lock);
+
+    if (batch.failed) {
+        TXLOG_ERROR(transaction, "%i of %i packages failed verification", batch.failed, batch.count);
+        goto cleanup;
+    }
+
+    TXLOG_INFO(transaction, "%i packages verified successfully", batch.count);
+    event = SERVED_TX_EVENT_OK;
+
+cleanup:
+    served_state_transaction_packages_free(batch.packages, batch.count);
+    served_sm_post_event(&transaction->sm, event);
+    return SM_ACTION_CONTINUE;
+}
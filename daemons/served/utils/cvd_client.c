@@ -615,3 +615,24 @@ int container_client_destroy_container(const char* id)
         id
     ));
 }
+
+void chef_cvd_event_container_stats_invocation(gracht_client_t* client, const struct chef_container_stats* stats)
+{
+    // stats are not subscribed to by this client, but the protocol requires the handler
+    (void)client;
+    (void)stats;
+}
+
+void chef_cvd_event_process_output_invocation(gracht_client_t* client, const struct chef_process_output* output)
+{
+    // processes are not spawned with STREAM by this client, but the protocol requires the handler
+    (void)client;
+    (void)output;
+}
+
+void chef_cvd_event_process_exit_invocation(gracht_client_t* client, const struct chef_process_exit* info)
+{
+    // processes are not spawned with STREAM by this client, but the protocol requires the handler
+    (void)client;
+    (void)info;
+}
@@ -19,6 +19,7 @@
 #include <chef/platform.h>
 #include <chef/package.h>
 #include <string.h>
+#include <threads.h>
 #include <utils.h>
 #include <vlog.h>
 
@@ -59,3 +60,64 @@ char* utils_base_to_store_id(const char* base)
     }
     return platform_strdup(&storeID[0]);
 }
+
+struct __parallel_context {
+    mtx_t lock;
+    int   next;
+    int   count;
+    void  (*work)(int index, void* context);
+    void* context;
+};
+
+static int __parallel_worker(void* arg)
+{
+    struct __parallel_context* parallel = arg;
+
+    while (1) {
+        int index;
+
+        mtx_lock(&parallel->lock);
+        index = parallel->next < parallel->count ? parallel->next++ : -1;
+        mtx_unlock(&parallel->lock);
+        if (index < 0) {
+            break;
+        }
+        parallel->work(index, parallel->context);
+    }
+    return 0;
+}
+
+void utils_parallel_foreach(int count, int workers, void (*work)(int index, void* context), void* context)
+{
+    struct __parallel_context parallel = {
+        .next = 0,
+        .count = count,
+        .work = work,
+        .context = context
+    };
+    thrd_t threads[UTILS_PARALLEL_WORKERS_MAX];
+    int    threadCount = 0;
+
+    if (mtx_init(&parallel.lock, mtx_plain) != thrd_success) {
+        // run everything on the calling thread instead
+        for (int i = 0; i < count; i++) {
+            work(i, context);
+        }
+        return;
+    }
+
+    // the calling thread takes part in the work as well
+    for (int i = 1; i < workers && i < count && i < UTILS_PARALLEL_WORKERS_MAX; i++) {
+        if (thrd_create(&threads[threadCount], __parallel_worker, &parallel) != thrd_success) {
+            VLOG_WARNING("served", "utils_parallel_foreach: failed to create worker, continuing with %i workers\n", threadCount + 1);
+            break;
+        }
+        threadCount++;
+    }
+
+    __parallel_worker(&parallel);
+    for (int i = 0; i < threadCount; i++) {
+        thrd_join(threads[i], NULL);
+    }
+    mtx_destroy(&parallel.lock);
+}
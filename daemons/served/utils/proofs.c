@@ -23,6 +23,7 @@
 #include <openssl/err.h>
 #include <openssl/x509.h>
 #include <openssl/pem.h>
+#include <utils.h>
 #include <vlog.h>
 
 const char* g_certAuthority = "MIIF1TCCA72gAwIBAgIUBrKWdEkac/ETLHLvzNjz4e6mElgwDQYJKoZIhvcNAQENBQAwejELMAkGA1UEBhMCREsxEzARBgNVBAgMCkNvcGVuaGFnZW4xEzARBgNVBAcMCkNvcGVuaGFnZW4xDTALBgNVBAoMBENoZWYxDjAMBgNVBAsMBVN0b3JlMSIwIAYDVQQDDBlDaGVmIFN0b3JlIFJvb3QgQXV0aG9yaXR5MB4XDTI1MTAyNzA4NTIyNVoXDTM1MTAyNTA4NTIyNVowejELMAkGA1UEBhMCREsxEzARBgNVBAgMCkNvcGVuaGFnZW4xEzARBgNVBAcMCkNvcGVuaGFnZW4xDTALBgNVBAoMBENoZWYxDjAMBgNVBAsMBVN0b3JlMSIwIAYDVQQDDBlDaGVmIFN0b3JlIFJvb3QgQXV0aG9yaXR5MIICIjANBgkqhkiG9w0BAQEFAAOCAg8AMIICCgKCAgEAwGnBxbYyRxTQX8+ENMDQMFK8XuMVlCoE1/wcHxseBGLOAEV6FqKdmw8daIf7dqkpK9dVyRm5MYAe1DaDvSWXPOZtzpklWUzLTkYIX+K81QTDgF58W4OkCz9qQnhVJ9snPgjy6UL/9mNJ4g4OUWtQiqkpZsua9J75p3aUQjeM1dOtAUsIps8dGyOJ75Z1h9yTGomNt9xK95I56x1vru5ifKvUsZ5iKpA9uXQ+VZIxlfDwCjl+p3wH0H1ZgvjIk1etdzWOls0E2KNycjGwyQ+H/bJtQZ4oEaZNETRu5QuXJ4zUxdjt7HnUZWD04ySIIT4CyiaH8Lgo6oXIJkal9cJQYgf5kZk2OWhelu1DcqZhOc7GDPU1PYFh8riy2LKxhl6GCVaUgOPeQzB3TLP/Doa6ME9xczOCOlJKrR0aQRgcJSKQss6N8Zrxy3xjnKkAV8YxUu317onv4JTxLyyzJdn3HjoGaQLM9CHh0IbfUJPRIPERJn3L2FGnWlA+lFD2uj1qTfAdOxElRrdLWTFzYHEM+RgBkzOU7hLUNpFsK+IY1zCu+7xtQXwdWqcLM0ppDQZwayMDB/9HfIY7+yOcYQg3nO0Yyi5Yik9mhTah4e2svjYzwEGSIu/SyASipXULf1RY+0FRlDhHcnjGu6oZURjEim6BZcU4LsVpmOlyOAFcl+MCAwEAAaNTMFEwHQYDVR0OBBYEFIRJLeleZKj9FAGU3ojpbCi/X+f8MB8GA1UdIwQYMBaAFIRJLeleZKj9FAGU3ojpbCi/X+f8MA8GA1UdEwEB/wQFMAMBAf8wDQYJKoZIhvcNAQENBQADggIBAA+RIVZ0+O7WGqMuzu5QdiTNAa3pTSh9YUSWj0K8VwgxNkOC+2xovVujkBSTSrcXpFElNUbhsPcoMWFSoy/4IjhyGsNeNDXESzPgND+AWsZIQQH3zhOimBN4ulDBqkjgY/t37M3e1g9g6/p1/n47h/KlOMpi3qiAj3DmsmIfsVb0BtkC4XFP3+z4BpqTGOnS6a741MvPLyYAYij26rmbt56jm8Wn1wGSfmtZ7UatIxDgopO65ZLKrWeQiw6elB/Rvw2IY/izqy4XPRYlgfGjrWvf0BX2IJ+l3PfmKYwELlMFIeLCwJj0v3NAUGuJRNue65lmeMWJhkNIRSNHs0KdlUpnuO65ytOFP0Z/3zj2dDevcwXwfQUVtJ2css06S5Rr7wbVouZptXGFoH4dFz6EDE8GvJvmdmv0EJgYKKYLcy+7PSl7bqZIt8loboHFvBF45KtpChxHk+/0pmPcBVApo12F6JQ7dsL9RD+BHvDQygx3S1ovQMeLKeYboZ6pN4TbItMR3gaLDAnEZ6/pDqK1mNdxmU62KEcVQ46fy7b087Q8I4yh2u7b/xMeyx80dXR85rcbHsWywWO5dFTB0kqZIzKyXrHEDGGlyltu57YlZ7iRChqu6MAHztHZDs0SisZwMbFz5HZeTDAKtmGrMJdN3VQd/Or2tEFdcjCeU4fR8ygM";
@@ -199,7 +200,10 @@ static int __calculate_file_sha512(const char* path, unsigned char** hash, unsig
     status = EVP_DigestFinal_ex(mdctx, *hash, hashLength);
     if (status != 1) {
         __print_crypt_errors("failed to finalize SHA512 data");
+        OPENSSL_free(*hash);
         status = -1;
+    } else {
+        status = 0;
     }
 
 cleanup:
@@ -235,10 +239,69 @@ static int __parse_public_key(const unsigned char* key, size_t keyLength, EVP_PK
     return 0;
 }
 
-static int __verify_package(struct store_proof_publisher* publisherProof, const char* packagePath, const char* publisher, const char* package, int revision)
+struct utils_package_digest {
+    EVP_MD_CTX* mdctx;
+    size_t      length;
+    int         failed;
+};
+
+struct utils_package_digest* utils_package_digest_new(void)
+{
+    struct utils_package_digest* digest;
+
+    digest = calloc(1, sizeof(struct utils_package_digest));
+    if (digest == NULL) {
+        return NULL;
+    }
+
+    digest->mdctx = EVP_MD_CTX_new();
+    if (digest->mdctx == NULL || EVP_DigestInit_ex(digest->mdctx, EVP_sha512(), NULL) != 1) {
+        __print_crypt_errors("failed to initialize SHA512");
+        utils_package_digest_delete(digest);
+        return NULL;
+    }
+    return digest;
+}
+
+void utils_package_digest_update(const void* data, size_t length, void* context)
+{
+    struct utils_package_digest* digest = context;
+    if (digest->failed) {
+        return;
+    }
+
+    if (EVP_DigestUpdate(digest->mdctx, data, length) != 1) {
+        __print_crypt_errors("failed to process SHA512 data");
+        digest->failed = 1;
+    }
+    digest->length += length;
+}
+
+int utils_package_digest_finish(struct utils_package_digest* digest, unsigned char* out, unsigned int* lengthOut)
+{
+    if (digest->failed || digest->length == 0) {
+        errno = ENODATA;
+        return -1;
+    }
+
+    if (EVP_DigestFinal_ex(digest->mdctx, out, lengthOut) != 1) {
+        __print_crypt_errors("failed to finalize SHA512 data");
+        return -1;
+    }
+    return 0;
+}
+
+void utils_package_digest_delete(struct utils_package_digest* digest)
+{
+    if (digest == NULL) {
+        return;
+    }
+    EVP_MD_CTX_free(digest->mdctx);
+    free(digest);
+}
+
+static int __verify_package_hash(struct store_proof_publisher* publisherProof, const unsigned char* hash, unsigned int hashLength, const char* publisher, const char* package, int revision)
 {
-    unsigned char*              hash;
-    unsigned int                hashLength;
     int                         status;
     char                        key[128];
     struct store_proof_package proof;
@@ -252,12 +315,6 @@ static int __verify_package(struct store_proof_publisher* publisherProof, const
         return status;
     }
 
-    status = __calculate_file_sha512(packagePath, &hash, &hashLength);
-    if (status) {
-        VLOG_ERROR("served", "__verify_publisher_key: failed to calculate SHA512 checksum of package path %s\n", packagePath);
-        return status;
-    }
-
     status = __parse_public_key(&publisherProof->public_key[0], strlen(&publisherProof->public_key[0]), &pkey);
     if (status) {
         VLOG_ERROR("served", "__verify_publisher_key: failed to parse public key from data %s\n", &publisherProof->public_key[0]);
@@ -271,6 +328,23 @@ static int __verify_package(struct store_proof_publisher* publisherProof, const
     return status;
 }
 
+static int __verify_package(struct store_proof_publisher* publisherProof, const char* packagePath, const char* publisher, const char* package, int revision)
+{
+    unsigned char* hash;
+    unsigned int   hashLength;
+    int            status;
+
+    status = __calculate_file_sha512(packagePath, &hash, &hashLength);
+    if (status) {
+        VLOG_ERROR("served", "__verify_publisher_key: failed to calculate SHA512 checksum of package path %s\n", packagePath);
+        return status;
+    }
+
+    status = __verify_package_hash(publisherProof, hash, hashLength, publisher, package, revision);
+    OPENSSL_free(hash);
+    return status;
+}
+
 int utils_verify_publisher(const char* publisher)
 {
     int                          status;
@@ -320,3 +394,23 @@ int utils_verify_package(const char* publisher, const char* package, int revisio
 
     return 0;
 }
+
+int utils_verify_package_digest(const char* publisher, const char* package, int revision,
+    const unsigned char* digest, unsigned int digestLength)
+{
+    int                          status;
+    struct store_proof_publisher publisherProof;
+
+    status = __verify_and_get_publisher_key(publisher, &publisherProof);
+    if (status) {
+        VLOG_ERROR("served", "could not verify the authenticity of the publisher %s\n", publisher);
+        return status;
+    }
+
+    status = __verify_package_hash(&publisherProof, digest, digestLength, publisher, package, revision);
+    if (status) {
+        VLOG_ERROR("served", "could not verify the authenticity of the package %s of publisher %s\n", package, publisher);
+        return status;
+    }
+    return 0;
+}
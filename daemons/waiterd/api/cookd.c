@@ -60,21 +60,11 @@ void chef_waiterd_cook_status_invocation(struct gracht_message* message, const s
 
 void chef_waiterd_cook_artifact_invocation(struct gracht_message* message, const struct chef_cook_artifact_event* evt)
 {
-    struct waiterd_request* wreq;
-    VLOG_DEBUG("api", "cook::artifact(id=%s, type=%u)\n", evt->id, evt->type);
-
-    wreq = waiterd_server_request_find(evt->id);
-    if (wreq == NULL) {
-        VLOG_ERROR("api", "invalid request id %s\n", evt->id);
-        return;
-    }
+    VLOG_DEBUG("api", "cook::artifact(id=%s, type=%u, size=%llu)\n", evt->id, evt->type, (unsigned long long)evt->size);
+    waiterd_artifacts_offer(message, evt);
+}
 
-    switch (evt->type) {
-        case CHEF_ARTIFACT_TYPE_LOG:
-            wreq->artifacts.log = platform_strdup(evt->uri);
-            break;
-        case CHEF_ARTIFACT_TYPE_PACKAGE:
-            wreq->artifacts.package = platform_strdup(evt->uri);
-            break;
-    }
+void chef_waiterd_cook_artifact_chunk_invocation(struct gracht_message* message, const struct chef_cook_artifact_chunk* chunk)
+{
+    waiterd_artifacts_chunk(message, chunk);
 }
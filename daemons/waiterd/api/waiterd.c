@@ -79,24 +79,38 @@ void chef_waiterd_status_invocation(struct gracht_message* message, const char*
 
 void chef_waiterd_artifact_invocation(struct gracht_message* message, const char* id, const enum chef_artifact_type type)
 {
-    struct waiterd_request* wreq;
-    VLOG_DEBUG("api", "waiter::artifact(id=%u, type=%u)\n", id, type);
+    struct waiterd_request*  wreq;
+    struct waiterd_artifact* artifact = NULL;
+    VLOG_DEBUG("api", "waiter::artifact(id=%s, type=%u)\n", id, type);
 
     wreq = waiterd_server_request_find(id);
     if (wreq == NULL) {
         VLOG_WARNING("api", "invalid request id %s\n", id);
-        chef_waiterd_artifact_response(message, "");
+        chef_waiterd_artifact_response(message, "", "");
         return;
     }
 
+    // artifacts that have not been stored yet have no link
     switch (type)  {
         case CHEF_ARTIFACT_TYPE_LOG:
-            chef_waiterd_artifact_response(message, wreq->artifacts.log);
+            artifact = &wreq->artifacts.log;
             break;
         case CHEF_ARTIFACT_TYPE_PACKAGE:
-            chef_waiterd_artifact_response(message, wreq->artifacts.package);
+            artifact = &wreq->artifacts.package;
             break;
     }
+
+    if (artifact == NULL || artifact->link == NULL) {
+        chef_waiterd_artifact_response(message, "", "");
+        return;
+    }
+    chef_waiterd_artifact_response(message, artifact->link, artifact->digest);
+}
+
+void chef_waiterd_artifact_read_invocation(struct gracht_message* message, const char* digest, const uint64_t offset, const unsigned int length)
+{
+    VLOG_DEBUG("api", "waiter::artifact_read(digest=%s, offset=%llu, length=%u)\n", digest, (unsigned long long)offset, length);
+    waiterd_artifacts_read(message, digest, offset, length);
 }
 
 void chef_waiterd_list_agents_invocation(struct gracht_message* message, enum chef_build_architecture arch_filter)
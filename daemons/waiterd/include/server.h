@@ -24,6 +24,8 @@
 
 // Forward declarations for protocol types
 struct chef_waiter_agent_info;
+struct chef_cook_artifact_event;
+struct chef_cook_artifact_chunk;
 
 enum waiterd_architecture {
     WAITERD_ARCHITECTURE_X86 = 0x1,
@@ -50,6 +52,13 @@ struct waiterd_cook {
     enum waiterd_architecture architectures;
 };
 
+// A stored artifact, the link is only usable on the machine running waiterd,
+// remote clients read the content by its digest instead
+struct waiterd_artifact {
+    char* link;
+    char* digest;
+};
+
 struct waiterd_request {
     struct list_item       list_header;
     struct gracht_message* source;
@@ -60,8 +69,8 @@ struct waiterd_request {
     enum waiterd_build_status status;
 
     struct {
-        char* package;
-        char* log;
+        struct waiterd_artifact package;
+        struct waiterd_artifact log;
     } artifacts;
 };
 
@@ -132,4 +141,42 @@ extern int waiterd_server_agents_list(enum waiterd_architecture arch_filter, str
  */
 extern int waiterd_server_agent_info(const char* name, struct chef_waiter_agent_info* info);
 
+/**
+ * @brief Initializes the artifact store. Artifacts are stored by the digest of
+ * their content, and requests refer to them through file:// links and their digest.
+ *
+ * @param root The directory that holds the artifacts
+ * @return 0 on success, -1 on error with errno set
+ */
+extern int waiterd_artifacts_initialize(const char* root);
+
+/**
+ * @brief Cleans up any uploads in progress and releases the artifact store
+ */
+extern void waiterd_artifacts_cleanup(void);
+
+/**
+ * @brief Handles an artifact offered by a cook. Content that is already stored is
+ * attached to the request right away, otherwise the cook is asked to upload it.
+ * The cook is told about the outcome through the artifact_status event.
+ */
+extern void waiterd_artifacts_offer(struct gracht_message* message, const struct chef_cook_artifact_event* evt);
+
+/**
+ * @brief Appends a chunk to an upload, and stores the artifact once all of its
+ * content was received and its digest verified
+ */
+extern void waiterd_artifacts_chunk(struct gracht_message* message, const struct chef_cook_artifact_chunk* chunk);
+
+/**
+ * @brief Replies with up to <length> bytes of the stored content of the digest,
+ * starting at <offset>
+ */
+extern void waiterd_artifacts_read(struct gracht_message* message, const char* digest, uint64_t offset, unsigned int length);
+
+/**
+ * @brief Aborts any uploads in progress from the cook
+ */
+extern void waiterd_artifacts_cook_disconnect(gracht_conn_t client);
+
 #endif //!__WAITERD_PRIVATE_H__
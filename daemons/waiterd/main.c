@@ -50,6 +50,7 @@ int main(int argc, char** argv)
     int                                logLevel = VLOG_LEVEL_TRACE;
     FILE*                              debuglog;
     char*                              debuglogPath;
+    char*                              artifactsPath;
 
     // parse options
     if (argc > 1) {
@@ -87,6 +88,16 @@ int main(int argc, char** argv)
         return -1;
     }
 
+    // initialize the artifact store
+    artifactsPath = strpathcombine(chef_dirs_root(), "artifacts");
+    if (artifactsPath == NULL || waiterd_artifacts_initialize(artifactsPath)) {
+        fprintf(stderr, "waiterd: failed to initialize the artifact store\n");
+        free(artifactsPath);
+        return -1;
+    }
+    free(artifactsPath);
+    atexit(waiterd_artifacts_cleanup);
+
     // add log file to vlog
     debuglog = chef_dirs_open_temp_file("waiterd", "log", &debuglogPath);
     if (debuglog == NULL) {
@@ -96,6 +107,9 @@ int main(int argc, char** argv)
     vlog_add_output(debuglog, 1);
     vlog_set_output_level(debuglog, VLOG_LEVEL_DEBUG);
 
+    // the daemon logs from multiple threads, keep them off the log I/O
+    vlog_set_async(1);
+
     printf("log opened at %s\n", debuglogPath);
     free(debuglogPath);
 
@@ -0,0 +1,622 @@
+/**
+ * Copyright, Philip Meulengracht
+ *
+ * This program is free software : you can redistribute it and / or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation ? , either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ * 
+ */
+
+#include <chef/platform.h>
+#include <ctype.h>
+#include <errno.h>
+#include <limits.h>
+#include <openssl/evp.h>
+#include <server.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vlog.h>
+
+#include "chef_waiterd_service_server.h"
+#include "chef_waiterd_cook_service_server.h"
+
+// Artifacts are stored as <root>/<digest>/<name>, so content that was uploaded
+// once is never uploaded again, regardless of which build produced it. Uploads
+// in progress are written to <root>/.uploads/<digest> and moved into place once
+// their digest has been verified.
+#define __UPLOADS_DIRECTORY ".uploads"
+#define __DIGEST_LENGTH     64
+#define __NAME_LENGTH_MAX   255
+
+// Reads must fit in a single gracht message, like the chunks uploaded by the cooks
+#define __READ_SIZE_MAX     (3 * 1024)
+
+struct __artifact_waiter {
+    struct list_item        list_header;
+    gracht_conn_t           cook;
+    char*                   id;
+    enum chef_artifact_type type;
+};
+
+struct __artifact_upload {
+    struct list_item list_header;
+    gracht_server_t* server;
+    gracht_conn_t    cook;
+    char             digest[__DIGEST_LENGTH + 1];
+    char*            name;
+    char*            path;
+    FILE*            file;
+    EVP_MD_CTX*      hash;
+    uint64_t         size;
+    uint64_t         received;
+    struct list      waiters; // list<__artifact_waiter>
+};
+
+static struct {
+    char*       root;
+    struct list uploads; // list<__artifact_upload>
+} g_artifacts = { 0 };
+
+static int __valid_digest(const char* digest)
+{
+    if (digest == NULL || strlen(digest) != __DIGEST_LENGTH) {
+        return 0;
+    }
+    for (int i = 0; i < __DIGEST_LENGTH; i++) {
+        if (!isxdigit((unsigned char)digest[i])) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static int __valid_name(const char* name)
+{
+    size_t length;
+
+    if (name == NULL) {
+        return 0;
+    }
+
+    length = strlen(name);
+    if (length == 0 || length > __NAME_LENGTH_MAX) {
+        return 0;
+    }
+    if (strchr(name, '/') != NULL || strchr(name, '\\') != NULL) {
+        return 0;
+    }
+    return strcmp(name, ".") != 0 && strcmp(name, "..") != 0;
+}
+
+static void __normalize_digest(const char* digest, char out[__DIGEST_LENGTH + 1])
+{
+    for (int i = 0; i < __DIGEST_LENGTH; i++) {
+        out[i] = (char)tolower((unsigned char)digest[i]);
+    }
+    out[__DIGEST_LENGTH] = '\0';
+}
+
+static char* __link_new(const char* path)
+{
+    char*  link;
+    size_t length = strlen(path) + 8;
+
+    link = malloc(length);
+    if (link == NULL) {
+        return NULL;
+    }
+    snprintf(link, length, "file://%s", path);
+    return link;
+}
+
+// Returns the path of the stored content for the digest. The artifact is found under
+// the name it was first uploaded with, which may differ from the requested name, and
+// <name> may be NULL when any name will do.
+static char* __stored_path(const char* digest, const char* name)
+{
+    struct platform_stat stats;
+    struct list          files = { 0 };
+    struct list_item*    i;
+    char*                directory;
+    char*                path = NULL;
+
+    directory = strpathcombine(g_artifacts.root, digest);
+    if (directory == NULL) {
+        return NULL;
+    }
+
+    if (name != NULL) {
+        path = strpathcombine(directory, name);
+        if (path != NULL && platform_stat(path, &stats) == 0 && stats.type == PLATFORM_FILETYPE_FILE) {
+            goto cleanup;
+        }
+        free(path);
+        path = NULL;
+    }
+
+    if (platform_getfiles(directory, 0, &files)) {
+        goto cleanup;
+    }
+
+    list_foreach(&files, i) {
+        struct platform_file_entry* entry = (struct platform_file_entry*)i;
+        if (entry->type == PLATFORM_FILETYPE_FILE) {
+            path = platform_strdup(entry->path);
+            break;
+        }
+    }
+    platform_getfiles_destroy(&files);
+
+cleanup:
+    free(directory);
+    return path;
+}
+
+static char* __stored_link(const char* digest, const char* name)
+{
+    char* path = __stored_path(digest, name);
+    char* link;
+
+    if (path == NULL) {
+        return NULL;
+    }
+    link = __link_new(path);
+    free(path);
+    return link;
+}
+
+static void __notify(gracht_server_t* server, gracht_conn_t cook, const char* id, enum chef_artifact_type type, enum chef_artifact_upload_status status)
+{
+    chef_waiterd_cook_event_artifact_status_single(server, cook, &(struct chef_cook_artifact_status) {
+        .id = (char*)id,
+        .type = type,
+        .status = status
+    });
+}
+
+static int __attach(const char* id, enum chef_artifact_type type, const char* link, const char* digest)
+{
+    struct waiterd_request*  wreq;
+    struct waiterd_artifact* artifact;
+    char*                    linkCopy;
+    char*                    digestCopy;
+
+    wreq = waiterd_server_request_find(id);
+    if (wreq == NULL) {
+        VLOG_WARNING("artifacts", "request %s went away before its artifact was stored\n", id);
+        return -1;
+    }
+
+    switch (type) {
+        case CHEF_ARTIFACT_TYPE_LOG:
+            artifact = &wreq->artifacts.log;
+            break;
+        case CHEF_ARTIFACT_TYPE_PACKAGE:
+            artifact = &wreq->artifacts.package;
+            break;
+        default:
+            errno = EINVAL;
+            return -1;
+    }
+
+    linkCopy = platform_strdup(link);
+    digestCopy = platform_strdup(digest);
+    if (linkCopy == NULL || digestCopy == NULL) {
+        free(linkCopy);
+        free(digestCopy);
+        return -1;
+    }
+
+    free(artifact->link);
+    free(artifact->digest);
+    artifact->link = linkCopy;
+    artifact->digest = digestCopy;
+    return 0;
+}
+
+static struct __artifact_upload* __upload_find(const char* digest)
+{
+    struct list_item* i;
+
+    list_foreach(&g_artifacts.uploads, i) {
+        struct __artifact_upload* upload = (struct __artifact_upload*)i;
+        if (strcmp(&upload->digest[0], digest) == 0) {
+            return upload;
+        }
+    }
+    return NULL;
+}
+
+static int __upload_add_waiter(struct __artifact_upload* upload, gracht_conn_t cook, const char* id, enum chef_artifact_type type)
+{
+    struct __artifact_waiter* waiter;
+
+    waiter = calloc(1, sizeof(struct __artifact_waiter));
+    if (waiter == NULL) {
+        return -1;
+    }
+
+    waiter->id = platform_strdup(id);
+    if (waiter->id == NULL) {
+        free(waiter);
+        return -1;
+    }
+    waiter->cook = cook;
+    waiter->type = type;
+    list_add(&upload->waiters, &waiter->list_header);
+    return 0;
+}
+
+static void __upload_delete(struct __artifact_upload* upload)
+{
+    struct list_item* i;
+    struct list_item* tmp;
+
+    list_foreach_safe(&upload->waiters, i, tmp) {
+        struct __artifact_waiter* waiter = (struct __artifact_waiter*)i;
+        free(waiter->id);
+        free(waiter);
+    }
+
+    if (upload->file != NULL) {
+        fclose(upload->file);
+        platform_unlink(upload->path);
+    }
+    EVP_MD_CTX_free(upload->hash);
+    free(upload->path);
+    free(upload->name);
+    free(upload);
+}
+
+static struct __artifact_upload* __upload_new(gracht_server_t* server, gracht_conn_t cook, const char* digest, const char* name, uint64_t size)
+{
+    struct __artifact_upload* upload;
+    char*                     uploads;
+
+    upload = calloc(1, sizeof(struct __artifact_upload));
+    if (upload == NULL) {
+        return NULL;
+    }
+    upload->server = server;
+    upload->cook = cook;
+    upload->size = size;
+    strcpy(&upload->digest[0], digest);
+
+    upload->name = platform_strdup(name);
+    uploads = strpathcombine(g_artifacts.root, __UPLOADS_DIRECTORY);
+    if (upload->name == NULL || uploads == NULL) {
+        free(uploads);
+        __upload_delete(upload);
+        return NULL;
+    }
+
+    upload->path = strpathcombine(uploads, digest);
+    free(uploads);
+    if (upload->path == NULL) {
+        __upload_delete(upload);
+        return NULL;
+    }
+
+    upload->hash = EVP_MD_CTX_new();
+    if (upload->hash == NULL || EVP_DigestInit_ex(upload->hash, EVP_sha256(), NULL) != 1) {
+        __upload_delete(upload);
+        return NULL;
+    }
+
+    upload->file = fopen(upload->path, "wb");
+    if (upload->file == NULL) {
+        VLOG_ERROR("artifacts", "failed to create %s: %s\n", upload->path, strerror(errno));
+        __upload_delete(upload);
+        return NULL;
+    }
+    return upload;
+}
+
+static int __upload_store(struct __artifact_upload* upload, char** linkOut)
+{
+    unsigned char digest[EVP_MAX_MD_SIZE];
+    unsigned int  digestLength;
+    char          hex[__DIGEST_LENGTH + 1];
+    char*         directory;
+    char*         path;
+    int           status;
+
+    if (EVP_DigestFinal_ex(upload->hash, &digest[0], &digestLength) != 1 ||
+        digestLength * 2 != __DIGEST_LENGTH) {
+        return -1;
+    }
+    for (unsigned int i = 0; i < digestLength; i++) {
+        snprintf(&hex[i * 2], 3, "%02x", digest[i]);
+    }
+
+    if (strcmp(&hex[0], &upload->digest[0]) != 0) {
+        VLOG_ERROR("artifacts", "upload of %s has digest %s\n", &upload->digest[0], &hex[0]);
+        errno = EBADMSG;
+        return -1;
+    }
+
+    status = fclose(upload->file);
+    upload->file = NULL;
+    if (status) {
+        platform_unlink(upload->path);
+        return -1;
+    }
+
+    directory = strpathcombine(g_artifacts.root, &upload->digest[0]);
+    if (directory == NULL) {
+        platform_unlink(upload->path);
+        return -1;
+    }
+
+    path = strpathcombine(directory, upload->name);
+    if (path == NULL || platform_mkdir(directory)) {
+        free(path);
+        free(directory);
+        platform_unlink(upload->path);
+        return -1;
+    }
+    free(directory);
+
+    if (rename(upload->path, path)) {
+        VLOG_ERROR("artifacts", "failed to store %s: %s\n", path, strerror(errno));
+        platform_unlink(upload->path);
+        free(path);
+        return -1;
+    }
+
+    *linkOut = __link_new(path);
+    free(path);
+    return *linkOut == NULL ? -1 : 0;
+}
+
+// Completes the upload, attaches the stored artifact to every request waiting
+// for it and tells their cooks about the outcome.
+static void __upload_complete(struct __artifact_upload* upload)
+{
+    struct list_item* i;
+    char*             link = NULL;
+    int               status;
+
+    status = __upload_store(upload, &link);
+    if (status) {
+        VLOG_ERROR("artifacts", "failed to store artifact %s (%s)\n", &upload->digest[0], upload->name);
+    } else {
+        VLOG_DEBUG("artifacts", "stored %s as %s\n", &upload->digest[0], link);
+    }
+
+    list_foreach(&upload->waiters, i) {
+        struct __artifact_waiter* waiter = (struct __artifact_waiter*)i;
+        enum chef_artifact_upload_status result = CHEF_ARTIFACT_UPLOAD_STATUS_FAILED;
+
+        if (status == 0 && __attach(waiter->id, waiter->type, link, &upload->digest[0]) == 0) {
+            result = CHEF_ARTIFACT_UPLOAD_STATUS_STORED;
+        }
+        __notify(upload->server, waiter->cook, waiter->id, waiter->type, result);
+    }
+
+    list_remove(&g_artifacts.uploads, &upload->list_header);
+    __upload_delete(upload);
+    free(link);
+}
+
+// Aborts the upload and fails every request waiting for it. The uploading cook
+// is not told when the upload was aborted because it disconnected.
+static void __upload_abort(struct __artifact_upload* upload, int disconnected)
+{
+    struct list_item* i;
+
+    list_foreach(&upload->waiters, i) {
+        struct __artifact_waiter* waiter = (struct __artifact_waiter*)i;
+        if (!disconnected || waiter->cook != upload->cook) {
+            __notify(upload->server, waiter->cook, waiter->id, waiter->type, CHEF_ARTIFACT_UPLOAD_STATUS_FAILED);
+        }
+    }
+
+    list_remove(&g_artifacts.uploads, &upload->list_header);
+    __upload_delete(upload);
+}
+
+int waiterd_artifacts_initialize(const char* root)
+{
+    struct platform_stat stats;
+    char*                uploads;
+    int                  status;
+
+    g_artifacts.root = platform_strdup(root);
+    if (g_artifacts.root == NULL) {
+        return -1;
+    }
+
+    uploads = strpathcombine(root, __UPLOADS_DIRECTORY);
+    if (uploads == NULL) {
+        return -1;
+    }
+
+    // uploads that were in progress when waiterd went down cannot be resumed
+    if (platform_stat(uploads, &stats) == 0 && platform_rmdir(uploads)) {
+        VLOG_WARNING("artifacts", "failed to remove stale uploads in %s\n", uploads);
+    }
+
+    status = platform_mkdir(uploads);
+    if (status) {
+        VLOG_ERROR("artifacts", "failed to create %s: %s\n", uploads, strerror(errno));
+    }
+    free(uploads);
+    return status;
+}
+
+void waiterd_artifacts_cleanup(void)
+{
+    struct list_item* i;
+    struct list_item* tmp;
+
+    list_foreach_safe(&g_artifacts.uploads, i, tmp) {
+        __upload_delete((struct __artifact_upload*)i);
+    }
+    list_init(&g_artifacts.uploads);
+
+    free(g_artifacts.root);
+    g_artifacts.root = NULL;
+}
+
+void waiterd_artifacts_offer(struct gracht_message* message, const struct chef_cook_artifact_event* evt)
+{
+    struct __artifact_upload* upload;
+    char                      digest[__DIGEST_LENGTH + 1];
+    char*                     link;
+
+    if (!__valid_digest(evt->digest) || !__valid_name(evt->name) ||
+        waiterd_server_request_find(evt->id) == NULL) {
+        VLOG_ERROR("artifacts", "rejected artifact %s for request %s\n", evt->name, evt->id);
+        __notify(message->server, message->client, evt->id, evt->type, CHEF_ARTIFACT_UPLOAD_STATUS_FAILED);
+        return;
+    }
+    __normalize_digest(evt->digest, digest);
+
+    // the content is already stored, no need to transfer it again
+    link = __stored_link(&digest[0], evt->name);
+    if (link != NULL) {
+        VLOG_DEBUG("artifacts", "%s is already stored as %s\n", &digest[0], link);
+        __notify(message->server, message->client, evt->id, evt->type,
+            __attach(evt->id, evt->type, link, &digest[0]) == 0 ? CHEF_ARTIFACT_UPLOAD_STATUS_STORED : CHEF_ARTIFACT_UPLOAD_STATUS_FAILED);
+        free(link);
+        return;
+    }
+
+    // the content is being uploaded already, wait for that upload instead
+    upload = __upload_find(&digest[0]);
+    if (upload != NULL) {
+        if (__upload_add_waiter(upload, message->client, evt->id, evt->type)) {
+            __notify(message->server, message->client, evt->id, evt->type, CHEF_ARTIFACT_UPLOAD_STATUS_FAILED);
+        }
+        return;
+    }
+
+    upload = __upload_new(message->server, message->client, &digest[0], evt->name, evt->size);
+    if (upload == NULL || __upload_add_waiter(upload, message->client, evt->id, evt->type)) {
+        VLOG_ERROR("artifacts", "failed to start upload of %s\n", &digest[0]);
+        if (upload != NULL) {
+            __upload_delete(upload);
+        }
+        __notify(message->server, message->client, evt->id, evt->type, CHEF_ARTIFACT_UPLOAD_STATUS_FAILED);
+        return;
+    }
+    list_add(&g_artifacts.uploads, &upload->list_header);
+
+    // empty artifacts have no chunks, so they complete right away
+    if (upload->size == 0) {
+        __upload_complete(upload);
+        return;
+    }
+    __notify(message->server, message->client, evt->id, evt->type, CHEF_ARTIFACT_UPLOAD_STATUS_UPLOAD);
+}
+
+void waiterd_artifacts_chunk(struct gracht_message* message, const struct chef_cook_artifact_chunk* chunk)
+{
+    struct __artifact_upload* upload;
+    char                      digest[__DIGEST_LENGTH + 1];
+
+    if (!__valid_digest(chunk->digest)) {
+        return;
+    }
+    __normalize_digest(chunk->digest, digest);
+
+    upload = __upload_find(&digest[0]);
+    if (upload == NULL || upload->cook != message->client) {
+        VLOG_WARNING("artifacts", "chunk for unknown upload %s\n", &digest[0]);
+        return;
+    }
+
+    // chunks arrive in order on the connection, anything else means the
+    // cook and waiterd disagree about the upload
+    if (chunk->offset != upload->received ||
+        chunk->data_count > upload->size - upload->received) {
+        VLOG_ERROR("artifacts", "invalid chunk at offset %llu for %s\n",
+            (unsigned long long)chunk->offset, &digest[0]);
+        __upload_abort(upload, 0);
+        return;
+    }
+
+    if (fwrite(chunk->data, 1, chunk->data_count, upload->file) != chunk->data_count ||
+        EVP_DigestUpdate(upload->hash, chunk->data, chunk->data_count) != 1) {
+        VLOG_ERROR("artifacts", "failed to write chunk for %s: %s\n", &digest[0], strerror(errno));
+        __upload_abort(upload, 0);
+        return;
+    }
+
+    upload->received += chunk->data_count;
+    if (upload->received == upload->size) {
+        __upload_complete(upload);
+    }
+}
+
+void waiterd_artifacts_read(struct gracht_message* message, const char* digest, uint64_t offset, unsigned int length)
+{
+    char   normalized[__DIGEST_LENGTH + 1];
+    char   buffer[__READ_SIZE_MAX];
+    char*  path;
+    FILE*  file;
+    size_t bytesRead;
+
+    if (!__valid_digest(digest) || offset > LONG_MAX) {
+        chef_waiterd_artifact_read_response(message, -1, 0, NULL, 0);
+        return;
+    }
+    __normalize_digest(digest, normalized);
+
+    path = __stored_path(&normalized[0], NULL);
+    if (path == NULL) {
+        VLOG_WARNING("artifacts", "read of unknown artifact %s\n", &normalized[0]);
+        chef_waiterd_artifact_read_response(message, -1, 0, NULL, 0);
+        return;
+    }
+
+    file = fopen(path, "rb");
+    free(path);
+    if (file == NULL || fseek(file, (long)offset, SEEK_SET)) {
+        VLOG_ERROR("artifacts", "failed to read artifact %s: %s\n", &normalized[0], strerror(errno));
+        if (file != NULL) {
+            fclose(file);
+        }
+        chef_waiterd_artifact_read_response(message, -1, 0, NULL, 0);
+        return;
+    }
+
+    if (length > __READ_SIZE_MAX) {
+        length = __READ_SIZE_MAX;
+    }
+
+    bytesRead = fread(&buffer[0], 1, length, file);
+    if (ferror(file)) {
+        VLOG_ERROR("artifacts", "failed to read artifact %s\n", &normalized[0]);
+        fclose(file);
+        chef_waiterd_artifact_read_response(message, -1, 0, NULL, 0);
+        return;
+    }
+    fclose(file);
+
+    chef_waiterd_artifact_read_response(message, 0, (unsigned int)bytesRead, (uint8_t*)&buffer[0], (uint32_t)bytesRead);
+}
+
+void waiterd_artifacts_cook_disconnect(gracht_conn_t client)
+{
+    struct list_item* i;
+    struct list_item* tmp;
+
+    list_foreach_safe(&g_artifacts.uploads, i, tmp) {
+        struct __artifact_upload* upload = (struct __artifact_upload*)i;
+        if (upload->cook == client) {
+            __upload_abort(upload, 1);
+        }
+    }
+}
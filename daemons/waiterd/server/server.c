@@ -56,8 +56,10 @@ static void __waiterd_request_delete(struct waiterd_request* request)
         return;
     }
 
-    free(request->artifacts.log);
-    free(request->artifacts.package);
+    free(request->artifacts.log.link);
+    free(request->artifacts.log.digest);
+    free(request->artifacts.package.link);
+    free(request->artifacts.package.digest);
     free(request->source);
     free(request);
 }
@@ -121,6 +123,9 @@ void waiterd_server_cook_disconnect(gracht_conn_t client)
     // remove cook immediately
     list_remove(&g_server.cooks, &cook->list_header);
 
+    // uploads from the cook can never complete now
+    waiterd_artifacts_cook_disconnect(client);
+
     // abort any request in flight for waiters
     list_foreach(&g_server.requests, i) {
         struct waiterd_request* request = (struct waiterd_request*)i;
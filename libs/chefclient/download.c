@@ -34,6 +34,7 @@ struct download_context {
     const char*           publisher;
     const char*           package;
     int                   revision;
+    int                   base_revision;
     struct chef_observer* observer;
 };
 
@@ -69,6 +70,24 @@ static int __get_download_url(struct download_context* context, char* urlBuffer,
     return written < (bufferSize - 1) ? 0 : -1;
 }
 
+static int __get_delta_download_url(struct download_context* context, char* urlBuffer, size_t bufferSize)
+{
+    int written = snprintf(urlBuffer, bufferSize - 1, 
+        "%s/package/download/delta?publisher=%s&name=%s&from=%i&revision=%i",
+        chefclient_api_base_url(),
+        context->publisher, context->package, context->base_revision, context->revision
+    );
+    return written < (bufferSize - 1) ? 0 : -1;
+}
+
+static int __get_file_url(struct download_context* context, char* urlBuffer, size_t bufferSize)
+{
+    if (context->base_revision != 0) {
+        return __get_delta_download_url(context, urlBuffer, bufferSize);
+    }
+    return __get_download_url(context, urlBuffer, bufferSize);
+}
+
 static int __parse_revision_response(const char* response, int* latestRevision)
 {
     json_error_t error;
@@ -163,7 +182,7 @@ static int __download_file(const char* filePath, struct download_context* contex
         goto cleanup;
     }
 
-    if (__get_download_url(context, buffer, sizeof(buffer)) != 0) {
+    if (__get_file_url(context, buffer, sizeof(buffer)) != 0) {
         VLOG_ERROR("chef-client", "__resolve_revision: buffer too small for package download link\n");
         goto cleanup;
     }
@@ -219,8 +238,16 @@ static int __download_file(const char* filePath, struct download_context* contex
     
     curl_easy_getinfo(request->curl, CURLINFO_RESPONSE_CODE, &httpCode);
     if (httpCode < 200 || httpCode >= 300) {
-        VLOG_ERROR("chef-client", "__download_file: http error %ld\n", httpCode);
-        status = -1;
+        // deltas are only available between some revisions, let the caller
+        // fall back to a full download
+        if (httpCode == 404 && context->base_revision != 0) {
+            VLOG_DEBUG("chef-client", "__download_file: no delta available\n");
+            errno = ENOENT;
+        } else {
+            VLOG_ERROR("chef-client", "__download_file: http error %ld\n", httpCode);
+            errno = EIO;
+        }
+        goto cleanup;
     }
 
     status = 0;
@@ -269,3 +296,46 @@ int chefclient_pack_download(struct chef_download_params* params, const char* pa
     params->revision = revision;
     return status;
 }
+
+int chefclient_pack_download_delta(struct chef_download_params* params, int baseRevision, const char* path)
+{
+    struct download_context downloadContext = { 0 };
+    int                     revision;
+    int                     status;
+    VLOG_TRACE("chef-client", "download_delta(name=%s/%s, base=%i, revision=%i)\n",
+        params->publisher, params->package, baseRevision, params->revision);
+
+    if (baseRevision <= 0) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (params->revision == 0) {
+        status = __resolve_revision(params, &revision);
+        if (status != 0) {
+            VLOG_ERROR("chef-client", "chefclient_pack_download_delta: failed to resolve revision [%s]\n", strerror(errno));
+            return status;
+        }
+    } else {
+        revision = params->revision;
+    }
+
+    if (revision == baseRevision) {
+        errno = EALREADY;
+        return -1;
+    }
+
+    downloadContext.publisher     = params->publisher;
+    downloadContext.package       = params->package;
+    downloadContext.revision      = revision;
+    downloadContext.base_revision = baseRevision;
+    downloadContext.observer      = params->observer;
+
+    status = __download_file(path, &downloadContext);
+    if (status != 0) {
+        return status;
+    }
+
+    params->revision = revision;
+    return status;
+}
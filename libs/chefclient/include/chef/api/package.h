@@ -50,6 +50,8 @@ struct chef_publish_params {
     const char*           channel;      /**< The release channel (e.g., "stable", "dev") */
     struct chef_version*  version;      /**< The version information for this package */
     struct chef_observer* observer;     /**< Observer for upload progress reporting */
+    size_t                part_size;    /**< Size of each upload part. If 0, the package is uploaded in a single request */
+    int                   connections;  /**< Number of parts uploaded concurrently when uploading in parts, defaults to 4 if 0 */
 };
 
 /**
@@ -101,6 +103,20 @@ struct chef_find_result {
  */
 extern int chefclient_pack_download(struct chef_download_params* params, const char* path);
 
+/**
+ * @brief Downloads the delta that reconstructs a package revision from an older revision.
+ * 
+ * The delta is only available for some revision pairs, in which case the full package
+ * must be downloaded instead. If the revision is set to 0, the latest available revision
+ * is resolved and the revision field in the params structure is updated.
+ * 
+ * @param[In]  params       A pointer to the download parameters specifying which package to download
+ * @param[In]  baseRevision The revision already present locally that the delta applies to
+ * @param[In]  path         The local file path where the downloaded delta should be saved
+ * @return int              Returns 0 on success, -1 on error. Errno is set to ENOENT if no delta is available.
+ */
+extern int chefclient_pack_download_delta(struct chef_download_params* params, int baseRevision, const char* path);
+
 /**
  * @brief Retrieves cryptographic proof/verification data for a package revision.
  * 
@@ -157,6 +173,9 @@ extern void chefclient_pack_find_free(struct chef_find_result** results, int cou
  * This function uploads and publishes a package to the repository. Authentication
  * is required - chefclient_login must be called before using this function.
  * The package file at the specified path will be uploaded along with its metadata.
+ * When part_size is set, the package is split into parts that are uploaded concurrently
+ * and verified individually. Progress is recorded in a journal in ~/.chef/publish, so an
+ * interrupted publish of the same package only uploads the missing parts when retried.
  * 
  * @param[In] params A pointer to the publish parameters containing package metadata
  * @param[In] path   The local file path to the package file to be published
@@ -19,6 +19,8 @@
 #ifndef __CHEF_CLIENT_STORAGE_H__
 #define __CHEF_CLIENT_STORAGE_H__
 
+#include <stddef.h>
+
 /**
  * @brief Downloads a file from a URL to a local path.
  * 
@@ -31,4 +33,28 @@
  */
 extern int chef_client_gen_download(const char* url, const char* path);
 
+/**
+ * @brief Callback invoked for each chunk of downloaded content.
+ * 
+ * @param[In] data    The chunk of content received.
+ * @param[In] length  The number of bytes in the chunk.
+ * @param[In] context The context provided to chef_client_gen_download_stream.
+ * @return int        Returns 0 to continue the download, or -1 to abort it.
+ */
+typedef int (*chef_client_download_write_fn)(const void* data, size_t length, void* context);
+
+/**
+ * @brief Downloads content from a URL, handing it to a callback as it arrives.
+ * 
+ * This allows the content to be consumed (hashed, decompressed, extracted) while
+ * it is being downloaded, without storing it to disk first. Any URL scheme supported
+ * by libcurl may be used, including file://.
+ * 
+ * @param[In] url     The URL to download from
+ * @param[In] write   The callback that receives the downloaded content
+ * @param[In] context The context passed to the callback
+ * @return int        Returns 0 on success, -1 on error. Errno will be set accordingly.
+ */
+extern int chef_client_gen_download_stream(const char* url, chef_client_download_write_fn write, void* context);
+
 #endif //!__CHEF_CLIENT_STORAGE_H__
@@ -22,12 +22,21 @@
 #include <chef/api/package.h>
 #include <curl/curl.h>
 #include <jansson.h>
+#include <openssl/evp.h>
 #include "../private.h"
 #include "base64/base64.h"
 #include <stdio.h>
 #include <string.h>
+#include <threads.h>
 #include <vlog.h>
 
+// defaults for chunked uploads, parts are retried a few times before
+// the upload is failed, the journal then allows for resuming later
+#define __PUBLISH_DEFAULT_CONNECTIONS 4
+#define __PUBLISH_MAX_CONNECTIONS     16
+#define __PUBLISH_PART_RETRIES        3
+#define __PUBLISH_DIGEST_SIZE         32
+
 extern const char* chefclient_api_base_url(void);
 
 struct __initiate_response {
@@ -366,7 +375,703 @@ cleanup:
     return status;
 }
 
-int chefclient_pack_publish(struct chef_publish_params* params, const char* path)
+static int __get_publish_part_url(const char* key, unsigned int index, char* urlBuffer, size_t bufferSize)
+{
+    int written = snprintf(urlBuffer, bufferSize - 1, 
+        "%s/package/publish/upload/part?key=%s&index=%u",
+        chefclient_api_base_url(),
+        key, index
+    );
+    return written < (bufferSize - 1) ? 0 : -1;
+}
+
+static void __digest_to_hex(const unsigned char* digest, char* hex)
+{
+    for (int i = 0; i < __PUBLISH_DIGEST_SIZE; i++) {
+        sprintf(&hex[i * 2], "%02x", digest[i]);
+    }
+    hex[__PUBLISH_DIGEST_SIZE * 2] = '\0';
+}
+
+static int __seek_file(FILE* file, uint64_t offset)
+{
+#if defined(WIN32) || defined(_WIN32) || defined(__WIN32__) || defined(__NT__)
+    return _fseeki64(file, (long long)offset, SEEK_SET);
+#else
+    return fseeko(file, (off_t)offset, SEEK_SET);
+#endif
+}
+
+struct __upload_part {
+    uint64_t offset;
+    size_t   length;
+    char     digest[__PUBLISH_DIGEST_SIZE * 2 + 1];
+    int      done;
+};
+
+struct __upload_plan {
+    struct __upload_part* parts;
+    unsigned int          part_count;
+    size_t                part_size;
+    uint64_t              length;
+    char                  digest[__PUBLISH_DIGEST_SIZE * 2 + 1];
+};
+
+// __plan_upload reads the pack once, and digests each part as well as the
+// entire pack. The pack digest identifies the upload in the journal.
+static int __plan_upload(const char* path, size_t partSize, struct __upload_plan* plan)
+{
+    EVP_MD_CTX*   packCtx = NULL;
+    EVP_MD_CTX*   partCtx = NULL;
+    FILE*         file;
+    void*         buffer = NULL;
+    unsigned char digest[__PUBLISH_DIGEST_SIZE];
+    uint64_t      offset = 0;
+    int           status = -1;
+
+    memset(plan, 0, sizeof(struct __upload_plan));
+    plan->part_size = partSize;
+
+    file = fopen(path, "rb");
+    if (file == NULL) {
+        VLOG_ERROR("chef-client", "__plan_upload: failed to open %s\n", path);
+        return -1;
+    }
+
+    buffer  = malloc(partSize);
+    packCtx = EVP_MD_CTX_new();
+    partCtx = EVP_MD_CTX_new();
+    if (buffer == NULL || packCtx == NULL || partCtx == NULL) {
+        errno = ENOMEM;
+        goto cleanup;
+    }
+
+    if (EVP_DigestInit_ex(packCtx, EVP_sha256(), NULL) != 1) {
+        goto cleanup;
+    }
+
+    while (1) {
+        struct __upload_part* parts;
+        size_t                read = fread(buffer, 1, partSize, file);
+        if (read == 0) {
+            break;
+        }
+
+        parts = realloc(plan->parts, sizeof(struct __upload_part) * (plan->part_count + 1));
+        if (parts == NULL) {
+            errno = ENOMEM;
+            goto cleanup;
+        }
+        plan->parts = parts;
+
+        if (EVP_DigestInit_ex(partCtx, EVP_sha256(), NULL) != 1 ||
+            EVP_DigestUpdate(partCtx, buffer, read) != 1 ||
+            EVP_DigestFinal_ex(partCtx, &digest[0], NULL) != 1 ||
+            EVP_DigestUpdate(packCtx, buffer, read) != 1) {
+            goto cleanup;
+        }
+
+        parts[plan->part_count].offset = offset;
+        parts[plan->part_count].length = read;
+        parts[plan->part_count].done   = 0;
+        __digest_to_hex(&digest[0], &parts[plan->part_count].digest[0]);
+        plan->part_count++;
+        offset += read;
+
+        if (read < partSize) {
+            break;
+        }
+    }
+
+    if (ferror(file) || plan->part_count == 0) {
+        VLOG_ERROR("chef-client", "__plan_upload: failed to read %s\n", path);
+        errno = EIO;
+        goto cleanup;
+    }
+
+    if (EVP_DigestFinal_ex(packCtx, &digest[0], NULL) != 1) {
+        goto cleanup;
+    }
+    __digest_to_hex(&digest[0], &plan->digest[0]);
+    plan->length = offset;
+    status = 0;
+
+cleanup:
+    EVP_MD_CTX_free(partCtx);
+    EVP_MD_CTX_free(packCtx);
+    free(buffer);
+    fclose(file);
+    if (status) {
+        free(plan->parts);
+        plan->parts = NULL;
+    }
+    return status;
+}
+
+// The journal is a small json document stored in ~/.chef/publish, named after
+// the pack digest. It records the upload session and the parts that have been
+// accepted by the server, so an interrupted publish can be resumed.
+struct __publish_journal {
+    char*   path;
+    json_t* root;
+};
+
+static int __journal_open(struct chef_publish_params* params, struct __upload_plan* plan, struct __publish_journal* journal)
+{
+    char         buff[PATH_MAX];
+    json_error_t error;
+    int          status;
+
+    journal->path = NULL;
+    journal->root = NULL;
+
+    status = platform_getuserdir(&buff[0], sizeof(buff));
+    if (status) {
+        return status;
+    }
+
+    strcat(&buff[0], CHEF_PATH_SEPARATOR_S ".chef" CHEF_PATH_SEPARATOR_S "publish");
+    if (platform_mkdir(&buff[0])) {
+        VLOG_ERROR("chef-client", "__journal_open: failed to create %s\n", &buff[0]);
+        return -1;
+    }
+
+    journal->path = strpathcombine(&buff[0], &plan->digest[0]);
+    if (journal->path == NULL) {
+        return -1;
+    }
+
+    journal->root = json_load_file(journal->path, 0, &error);
+    if (journal->root != NULL) {
+        // only resume when the journal describes the same upload, otherwise
+        // start over with a fresh session
+        json_t* partSize = json_object_get(journal->root, "part-size");
+        json_t* package  = json_object_get(journal->root, "package");
+        json_t* channel  = json_object_get(journal->root, "channel");
+        if ((size_t)json_integer_value(partSize) == plan->part_size &&
+            json_string_value(package) != NULL && strcmp(json_string_value(package), params->package) == 0 &&
+            json_string_value(channel) != NULL && strcmp(json_string_value(channel), params->channel) == 0) {
+            return 0;
+        }
+        json_decref(journal->root);
+    }
+
+    journal->root = json_object();
+    if (journal->root == NULL) {
+        return -1;
+    }
+    json_object_set_new(journal->root, "package", json_string(params->package));
+    json_object_set_new(journal->root, "channel", json_string(params->channel));
+    json_object_set_new(journal->root, "part-size", json_integer((json_int_t)plan->part_size));
+    json_object_set_new(journal->root, "parts", json_array());
+    return 0;
+}
+
+static int __journal_save(struct __publish_journal* journal)
+{
+    char tmp[PATH_MAX];
+    int  status;
+
+    snprintf(&tmp[0], sizeof(tmp), "%s.tmp", journal->path);
+    status = json_dump_file(journal->root, &tmp[0], 0);
+    if (status) {
+        VLOG_ERROR("chef-client", "__journal_save: failed to write %s\n", &tmp[0]);
+        return status;
+    }
+    return rename(&tmp[0], journal->path);
+}
+
+static int __journal_session(struct __publish_journal* journal, struct __initiate_response* context)
+{
+    const char* token = json_string_value(json_object_get(journal->root, "upload-token"));
+    if (token == NULL) {
+        return -1;
+    }
+
+    context->upload_token = platform_strdup(token);
+    context->revision     = (int)json_integer_value(json_object_get(journal->root, "revision"));
+    return 0;
+}
+
+static void __journal_mark_parts(struct __publish_journal* journal, struct __upload_plan* plan)
+{
+    json_t* parts = json_object_get(journal->root, "parts");
+    size_t  index;
+    json_t* value;
+
+    json_array_foreach(parts, index, value) {
+        unsigned int part = (unsigned int)json_integer_value(value);
+        if (part < plan->part_count) {
+            plan->parts[part].done = 1;
+        }
+    }
+}
+
+static void __journal_reset(struct __publish_journal* journal)
+{
+    json_object_del(journal->root, "upload-token");
+    json_object_del(journal->root, "revision");
+    json_object_set_new(journal->root, "parts", json_array());
+}
+
+static void __journal_close(struct __publish_journal* journal, int discard)
+{
+    if (discard && journal->path != NULL) {
+        platform_unlink(journal->path);
+    }
+    json_decref(journal->root);
+    free(journal->path);
+}
+
+struct __upload_queue {
+    const char*               path;
+    const char*               upload_token;
+    struct __upload_plan*     plan;
+    struct __publish_journal* journal;
+    struct chef_observer*     observer;
+
+    mtx_t                     lock;
+    unsigned int              next;
+    uint64_t                  uploaded;
+    int                       status;
+    int                       error;
+};
+
+struct __part_context {
+    struct __upload_queue* queue;
+    const char*            data;
+    size_t                 length;
+    size_t                 sent;
+};
+
+static void __queue_report(struct __upload_queue* queue)
+{
+    if (queue->observer != NULL) {
+        queue->observer->report(queue->uploaded, queue->plan->length, queue->observer->userData);
+    } else {
+        struct file_upload_context progress = {
+            .length = (size_t)queue->plan->length,
+            .uploaded = (size_t)queue->uploaded
+        };
+        __update_progress(&progress);
+    }
+}
+
+static size_t __part_read(char* buffer, size_t size, size_t nitems, void* arg)
+{
+    struct __part_context* context = (struct __part_context*)arg;
+    size_t                 count   = size * nitems;
+
+    if (count > context->length - context->sent) {
+        count = context->length - context->sent;
+    }
+
+    memcpy(buffer, context->data + context->sent, count);
+    context->sent += count;
+
+    mtx_lock(&context->queue->lock);
+    context->queue->uploaded += count;
+    __queue_report(context->queue);
+    mtx_unlock(&context->queue->lock);
+    return count;
+}
+
+static int __part_seek(void* arg, curl_off_t offset, int origin)
+{
+    struct __part_context* context = (struct __part_context*)arg;
+    if (origin != SEEK_SET || offset < 0 || (size_t)offset > context->length) {
+        return CURL_SEEKFUNC_CANTSEEK;
+    }
+
+    // curl rewinds when it needs to resend the body, so account for that
+    mtx_lock(&context->queue->lock);
+    context->queue->uploaded -= context->sent - (size_t)offset;
+    mtx_unlock(&context->queue->lock);
+    context->sent = (size_t)offset;
+    return CURL_SEEKFUNC_OK;
+}
+
+static int __verify_part_response(const char* response, const char* digest)
+{
+    json_error_t error;
+    json_t*      root;
+    const char*  accepted;
+    int          status = 0;
+
+    // the server echoes the digest it computed for the part, older servers
+    // may return an empty body which then only relies on the status code
+    root = json_loads(response, 0, &error);
+    if (root == NULL) {
+        return 0;
+    }
+
+    accepted = json_string_value(json_object_get(root, "digest"));
+    if (accepted != NULL && strcmp(accepted, digest) != 0) {
+        status = -1;
+    }
+    json_decref(root);
+    return status;
+}
+
+static int __upload_part(struct __upload_queue* queue, unsigned int index, const char* data)
+{
+    struct __upload_part* part = &queue->plan->parts[index];
+    struct __part_context context = { queue, data, part->length, 0 };
+    struct chef_request*  request;
+    CURLcode              code;
+    int                   status = -1;
+    int                   error = EIO;
+    char                  buffer[1024];
+    long                  httpCode = 0;
+
+    request = chef_request_new(CHEF_CLIENT_API_SECURE, 1);
+    if (!request) {
+        VLOG_ERROR("chef-client", "__upload_part: failed to create request\n");
+        return -1;
+    }
+
+    if (__get_publish_part_url(queue->upload_token, index, buffer, sizeof(buffer)) != 0) {
+        VLOG_ERROR("chef-client", "__upload_part: buffer too small for publish link\n");
+        goto cleanup;
+    }
+
+    code = curl_easy_setopt(request->curl, CURLOPT_URL, &buffer[0]);
+    if (code != CURLE_OK) {
+        VLOG_ERROR("chef-client", "__upload_part: failed to set url [%s]\n", request->error);
+        goto cleanup;
+    }
+
+    snprintf(&buffer[0], sizeof(buffer), "Chef-Part-Digest: sha256=%s", &part->digest[0]);
+    request->headers = curl_slist_append(request->headers, &buffer[0]);
+    request->headers = curl_slist_append(request->headers, "Content-Type: application/octet-stream");
+    request->headers = curl_slist_append(request->headers, "Expect:");
+
+    curl_easy_setopt(request->curl, CURLOPT_UPLOAD, 1L);
+    curl_easy_setopt(request->curl, CURLOPT_READFUNCTION, __part_read);
+    curl_easy_setopt(request->curl, CURLOPT_READDATA, &context);
+    curl_easy_setopt(request->curl, CURLOPT_SEEKFUNCTION, __part_seek);
+    curl_easy_setopt(request->curl, CURLOPT_SEEKDATA, &context);
+    curl_easy_setopt(request->curl, CURLOPT_INFILESIZE_LARGE, (curl_off_t)part->length);
+
+    code = chef_request_execute(request);
+    if (code != CURLE_OK) {
+        VLOG_ERROR("chef-client", "__upload_part: chef_request_execute() failed: %s\n", curl_easy_strerror(code));
+    }
+
+    curl_easy_getinfo(request->curl, CURLINFO_RESPONSE_CODE, &httpCode);
+    if (httpCode != 200) {
+        if (httpCode == 401) {
+            error = EACCES;
+        } else if (httpCode == 404 || httpCode == 410) {
+            // the upload session is no longer known by the server
+            error = ENOENT;
+        } else if (httpCode == 405 || httpCode == 501) {
+            // the server does not support uploading in parts
+            VLOG_ERROR("chef-client", "__upload_part: server does not support part uploads, use --part-size 0\n");
+            error = ENOTSUP;
+        } else {
+            VLOG_ERROR("chef-client", "__upload_part: http error %ld [%s]\n", httpCode, request->response);
+        }
+        goto cleanup;
+    }
+
+    if (__verify_part_response(request->response, &part->digest[0])) {
+        VLOG_ERROR("chef-client", "__upload_part: digest mismatch for part %u\n", index);
+        goto cleanup;
+    }
+    status = 0;
+
+cleanup:
+    if (status) {
+        // discard the progress made by this attempt
+        mtx_lock(&queue->lock);
+        queue->uploaded -= context.sent;
+        mtx_unlock(&queue->lock);
+    }
+    chef_request_delete(request);
+    if (status) {
+        errno = error;
+    }
+    return status;
+}
+
+static int __read_part(FILE* file, struct __upload_part* part, void* buffer)
+{
+    unsigned char digest[__PUBLISH_DIGEST_SIZE];
+    char          hex[__PUBLISH_DIGEST_SIZE * 2 + 1];
+    unsigned int  length = 0;
+
+    if (__seek_file(file, part->offset) || fread(buffer, 1, part->length, file) != part->length) {
+        errno = EIO;
+        return -1;
+    }
+
+    // guard against the pack changing after the upload was planned
+    if (EVP_Digest(buffer, part->length, &digest[0], &length, EVP_sha256(), NULL) != 1) {
+        return -1;
+    }
+    __digest_to_hex(&digest[0], &hex[0]);
+    if (strcmp(&hex[0], &part->digest[0]) != 0) {
+        VLOG_ERROR("chef-client", "__read_part: pack was modified during upload\n");
+        errno = EIO;
+        return -1;
+    }
+    return 0;
+}
+
+static int __upload_worker(void* arg)
+{
+    struct __upload_queue* queue = (struct __upload_queue*)arg;
+    FILE*                  file;
+    void*                  buffer;
+
+    file   = fopen(queue->path, "rb");
+    buffer = malloc(queue->plan->part_size);
+    if (file == NULL || buffer == NULL) {
+        int error = errno;
+        mtx_lock(&queue->lock);
+        if (queue->status == 0) {
+            queue->status = -1;
+            queue->error  = error;
+        }
+        mtx_unlock(&queue->lock);
+        goto cleanup;
+    }
+
+    while (1) {
+        unsigned int index;
+        int          status;
+        int          error = 0;
+
+        mtx_lock(&queue->lock);
+        while (queue->next < queue->plan->part_count && queue->plan->parts[queue->next].done) {
+            queue->next++;
+        }
+        if (queue->status != 0 || queue->next == queue->plan->part_count) {
+            mtx_unlock(&queue->lock);
+            break;
+        }
+        index = queue->next++;
+        mtx_unlock(&queue->lock);
+
+        status = __read_part(file, &queue->plan->parts[index], buffer);
+        if (status) {
+            error = errno;
+        }
+        for (int i = 0; status == 0 && i < __PUBLISH_PART_RETRIES; i++) {
+            status = __upload_part(queue, index, buffer);
+            if (status == 0) {
+                break;
+            }
+            error = errno;
+            if (error == EACCES || error == ENOENT || error == ENOTSUP) {
+                break;
+            }
+            VLOG_DEBUG("chef-client", "__upload_worker: retrying part %u\n", index);
+        }
+
+        mtx_lock(&queue->lock);
+        if (status) {
+            if (queue->status == 0) {
+                queue->status = -1;
+                queue->error  = error;
+            }
+        } else {
+            queue->plan->parts[index].done = 1;
+            json_array_append_new(json_object_get(queue->journal->root, "parts"), json_integer(index));
+            __journal_save(queue->journal);
+        }
+        mtx_unlock(&queue->lock);
+    }
+
+cleanup:
+    free(buffer);
+    if (file != NULL) {
+        fclose(file);
+    }
+    return 0;
+}
+
+static int __upload_parts(struct chef_publish_params* params, const char* path, struct __upload_plan* plan,
+                          struct __publish_journal* journal, struct __initiate_response* context)
+{
+    struct __upload_queue queue = {
+        .path         = path,
+        .upload_token = context->upload_token,
+        .plan         = plan,
+        .journal      = journal,
+        .observer     = params->observer,
+        .next         = 0,
+        .uploaded     = 0,
+        .status       = 0,
+        .error        = 0
+    };
+    thrd_t       threads[__PUBLISH_MAX_CONNECTIONS];
+    int          connections = params->connections;
+    int          started = 0;
+    unsigned int remaining = 0;
+
+    for (unsigned int i = 0; i < plan->part_count; i++) {
+        if (plan->parts[i].done) {
+            queue.uploaded += plan->parts[i].length;
+        } else {
+            remaining++;
+        }
+    }
+
+    if (connections <= 0) {
+        connections = __PUBLISH_DEFAULT_CONNECTIONS;
+    }
+    if (connections > __PUBLISH_MAX_CONNECTIONS) {
+        connections = __PUBLISH_MAX_CONNECTIONS;
+    }
+    if ((unsigned int)connections > remaining) {
+        connections = (int)remaining;
+    }
+
+    VLOG_TRACE("chef-client", "uploading %u of %u parts over %i connections\n",
+        remaining, plan->part_count, connections);
+    if (remaining == 0) {
+        return 0;
+    }
+
+    if (mtx_init(&queue.lock, mtx_plain) != thrd_success) {
+        return -1;
+    }
+
+    __queue_report(&queue);
+    for (int i = 0; i < connections; i++) {
+        if (thrd_create(&threads[started], __upload_worker, &queue) != thrd_success) {
+            VLOG_ERROR("chef-client", "__upload_parts: failed to start upload worker\n");
+            break;
+        }
+        started++;
+    }
+
+    // fall back to uploading on this thread if no workers could be started
+    if (started == 0) {
+        __upload_worker(&queue);
+    }
+
+    for (int i = 0; i < started; i++) {
+        thrd_join(threads[i], NULL);
+    }
+    mtx_destroy(&queue.lock);
+    if (params->observer == NULL) {
+        // terminate the progress bar line
+        printf("\n");
+    }
+
+    for (unsigned int i = 0; queue.status == 0 && i < plan->part_count; i++) {
+        if (!plan->parts[i].done) {
+            queue.status = -1;
+            queue.error  = EIO;
+        }
+    }
+    if (queue.status) {
+        errno = queue.error;
+    }
+    return queue.status;
+}
+
+static int __publish_initiate_chunked(struct chef_publish_params* params, struct __upload_plan* plan,
+                                      struct __publish_journal* journal, struct __initiate_response* context)
+{
+    json_t* request;
+    int     status;
+
+    request = __create_publish_request(params);
+    if (!request) {
+        VLOG_ERROR("chef-client", "__publish_initiate_chunked: failed to create publish request\n");
+        return -1;
+    }
+
+    json_object_set_new(request, "PartSize", json_integer((json_int_t)plan->part_size));
+    json_object_set_new(request, "PartCount", json_integer(plan->part_count));
+    json_object_set_new(request, "Digest", json_string(&plan->digest[0]));
+
+    status = __publish_request(request, context);
+    json_decref(request);
+    if (status) {
+        return status;
+    }
+
+    json_object_set_new(journal->root, "upload-token", json_string(context->upload_token));
+    json_object_set_new(journal->root, "revision", json_integer(context->revision));
+    return __journal_save(journal);
+}
+
+static int __publish_chunked(struct chef_publish_params* params, const char* path)
+{
+    struct __initiate_response context = { NULL, 0 };
+    struct __publish_journal   journal = { NULL, NULL };
+    struct __upload_plan       plan;
+    int                        status;
+
+    status = __plan_upload(path, params->part_size, &plan);
+    if (status) {
+        VLOG_ERROR("chef-client", "__publish_chunked: failed to read package %s\n", path);
+        return status;
+    }
+
+    status = __journal_open(params, &plan, &journal);
+    if (status) {
+        VLOG_ERROR("chef-client", "__publish_chunked: failed to open publish journal\n");
+        goto cleanup;
+    }
+
+    for (int attempt = 0; attempt < 2; attempt++) {
+        if (__journal_session(&journal, &context) == 0) {
+            __journal_mark_parts(&journal, &plan);
+            VLOG_TRACE("chef-client", "resuming upload of revision %i\n", context.revision);
+        } else {
+            status = __publish_initiate_chunked(params, &plan, &journal, &context);
+            if (status) {
+                VLOG_ERROR("chef-client", "__publish_chunked: failed to initiate publish process\n");
+                goto cleanup;
+            }
+            VLOG_TRACE("chef-client", "created revision %i, uploading...\n", context.revision);
+        }
+
+        status = __upload_parts(params, path, &plan, &journal, &context);
+        if (status == 0 || errno != ENOENT) {
+            break;
+        }
+
+        // the server has expired the session we were resuming, start over
+        VLOG_TRACE("chef-client", "upload session expired, restarting upload\n");
+        __journal_reset(&journal);
+        for (unsigned int i = 0; i < plan.part_count; i++) {
+            plan.parts[i].done = 0;
+        }
+        free((void*)context.upload_token);
+        context.upload_token = NULL;
+    }
+
+    if (status) {
+        VLOG_ERROR("chef-client", "__publish_chunked: failed to upload the package, run publish again to resume\n");
+        goto cleanup;
+    }
+
+    VLOG_TRACE("chef-client", "upload complete, publishing revision %i to %s...\n", context.revision, params->channel);
+
+    status = __publish_complete(params->channel, &context);
+    if (status) {
+        VLOG_ERROR("chef-client", "__publish_chunked: failed to complete publish process\n");
+        goto cleanup;
+    }
+    __journal_close(&journal, 1);
+    journal.root = NULL;
+    journal.path = NULL;
+
+cleanup:
+    __journal_close(&journal, 0);
+    free((void*)context.upload_token);
+    free(plan.parts);
+    return status;
+}
+
+static int __publish_single(struct chef_publish_params* params, const char* path)
 {
     struct __initiate_response context = { NULL, 0 };
     json_t*                    request;
@@ -374,7 +1079,7 @@ int chefclient_pack_publish(struct chef_publish_params* params, const char* path
 
     request = __create_publish_request(params);
     if (!request) {
-        VLOG_ERROR("chef-client", "chefclient_pack_publish: failed to create publish request\n");
+        VLOG_ERROR("chef-client", "__publish_single: failed to create publish request\n");
         status = -1;
         goto cleanup;
     }
@@ -382,7 +1087,7 @@ int chefclient_pack_publish(struct chef_publish_params* params, const char* path
     status = __publish_request(request, &context);
     json_decref(request);
     if (status) {
-        VLOG_ERROR("chef-client", "chefclient_pack_publish: failed to initiate publish process\n");
+        VLOG_ERROR("chef-client", "__publish_single: failed to initiate publish process\n");
         goto cleanup;
     }
 
@@ -390,7 +1095,7 @@ int chefclient_pack_publish(struct chef_publish_params* params, const char* path
 
     status = __upload_package(path, &context);
     if (status) {
-        VLOG_ERROR("chef-client", "chefclient_pack_publish: failed to upload the package for publishing\n");
+        VLOG_ERROR("chef-client", "__publish_single: failed to upload the package for publishing\n");
         goto cleanup;
     }
 
@@ -398,10 +1103,18 @@ int chefclient_pack_publish(struct chef_publish_params* params, const char* path
 
     status = __publish_complete(params->channel, &context);
     if (status) {
-        VLOG_ERROR("chef-client", "chefclient_pack_publish: failed to complete publish process\n");
+        VLOG_ERROR("chef-client", "__publish_single: failed to complete publish process\n");
     }
 
 cleanup:
     free((void*)context.upload_token);
     return status;
 }
+
+int chefclient_pack_publish(struct chef_publish_params* params, const char* path)
+{
+    if (params->part_size == 0) {
+        return __publish_single(params, path);
+    }
+    return __publish_chunked(params, path);
+}
@@ -32,6 +32,12 @@ struct download_context {
     size_t bytes_total;
 };
 
+struct download_stream_context {
+    chef_client_download_write_fn write;
+    void*                         context;
+    int                           aborted;
+};
+
 static void __format_quantity(long long size, char* buffer, size_t bufferSize)
 {
 	char*  suffix[]       = { "B", "KB", "MB", "GB", "TB" };
@@ -190,3 +196,130 @@ int chef_client_gen_download(const char* url, const char* path)
 
     return 0;
 }
+
+static size_t __download_stream_write(char* data, size_t size, size_t count, void* userdata)
+{
+    struct download_stream_context* streamContext = userdata;
+    size_t                          length = size * count;
+
+    if (streamContext->write(data, length, streamContext->context)) {
+        // returning a short count makes curl abort the transfer
+        streamContext->aborted = 1;
+        return 0;
+    }
+    return length;
+}
+
+static int __download_stream(const char* url, struct download_stream_context* streamContext, struct download_context* dlContext)
+{
+    struct chef_request* request;
+    int                  status = -1;
+    CURLcode             code;
+    long                 httpCode;
+
+    request = chef_request_new(1, 0);
+    if (!request) {
+        VLOG_ERROR("chef-client", "__download_stream: failed to create request\n");
+        return -1;
+    }
+
+    code = curl_easy_setopt(request->curl, CURLOPT_WRITEFUNCTION, __download_stream_write);
+    if (code != CURLE_OK) {
+        VLOG_ERROR("chef-client", "__download_stream: failed to set write function [%s]\n", request->error);
+        goto cleanup;
+    }
+
+    code = curl_easy_setopt(request->curl, CURLOPT_WRITEDATA, streamContext);
+    if (code != CURLE_OK) {
+        VLOG_ERROR("chef-client", "__download_stream: failed to set write data [%s]\n", request->error);
+        goto cleanup;
+    }
+
+    code = curl_easy_setopt(request->curl, CURLOPT_HTTPHEADER, request->headers);
+    if (code != CURLE_OK) {
+        VLOG_ERROR("chef-client", "__download_stream: failed to set http headers [%s]\n", request->error);
+        goto cleanup;
+    }
+
+    code = curl_easy_setopt(request->curl, CURLOPT_FOLLOWLOCATION, 1L);
+    if (code != CURLE_OK) {
+        VLOG_ERROR("chef-client", "__download_stream: failed to enable redirects [%s]\n", request->error);
+        goto cleanup;
+    }
+
+    code = curl_easy_setopt(request->curl, CURLOPT_NOPROGRESS, 0);
+    if (code != CURLE_OK) {
+        VLOG_ERROR("chef-client", "__download_stream: failed to enable download progress [%s]\n", request->error);
+        goto cleanup;
+    }
+
+    code = curl_easy_setopt(request->curl, CURLOPT_XFERINFOFUNCTION, __download_progress_callback);
+    if (code != CURLE_OK) {
+        VLOG_ERROR("chef-client", "__download_stream: failed to set download progress callback [%s]\n", request->error);
+        goto cleanup;
+    }
+
+    code = curl_easy_setopt(request->curl, CURLOPT_XFERINFODATA, dlContext);
+    if (code != CURLE_OK) {
+        VLOG_ERROR("chef-client", "__download_stream: failed to set download progress callback data [%s]\n", request->error);
+        goto cleanup;
+    }
+
+    code = curl_easy_setopt(request->curl, CURLOPT_URL, url);
+    if (code != CURLE_OK) {
+        VLOG_ERROR("chef-client", "__download_stream: failed to set url [%s]\n", request->error);
+        goto cleanup;
+    }
+
+    code = chef_request_execute(request);
+    if (code != CURLE_OK) {
+        if (streamContext->aborted) {
+            VLOG_ERROR("chef-client", "__download_stream: download of %s was aborted\n", url);
+            errno = ECANCELED;
+        } else {
+            VLOG_ERROR("chef-client", "__download_stream: chef_request_execute() failed: %s\n", request->error);
+            errno = EIO;
+        }
+        goto cleanup;
+    }
+    
+    // non-http transfers like file:// do not have a response code
+    curl_easy_getinfo(request->curl, CURLINFO_RESPONSE_CODE, &httpCode);
+    if (httpCode != 0 && (httpCode < 200 || httpCode >= 300)) {
+        VLOG_ERROR("chef-client", "__download_stream: http error %ld\n", httpCode);
+        errno = EIO;
+        status = -1;
+    } else {
+        status = 0;
+    }
+
+cleanup:
+    chef_request_delete(request);
+    return status;
+}
+
+int chef_client_gen_download_stream(const char* url, chef_client_download_write_fn write, void* context)
+{
+    struct download_context        dlContext = { 0 };
+    struct download_stream_context streamContext = {
+        .write = write,
+        .context = context,
+        .aborted = 0
+    };
+    int                            status;
+
+    if (url == NULL || write == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    vlog_set_output_options(stdout, VLOG_OUTPUT_OPTION_PROGRESS);
+    status = __download_stream(url, &streamContext, &dlContext);
+    vlog_clear_output_options(stdout, VLOG_OUTPUT_OPTION_PROGRESS);
+    if (status != 0) {
+        VLOG_ERROR("chef-client", "chef_client_gen_download_stream: failed to download %s [%s]\n", url, strerror(errno));
+        return status;
+    }
+
+    return 0;
+}
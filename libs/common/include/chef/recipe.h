@@ -45,6 +45,10 @@ struct recipe_part_source_git {
 
 struct recipe_part_source_url {
     const char* url;
+
+    // optional hex encoded sha256 of the downloaded content, which
+    // is verified and also used as the key into the source cache
+    const char* sha256;
 };
 
 struct recipe_part_source {
@@ -186,8 +190,19 @@ struct recipe {
     struct recipe_environment environment;
     struct list               parts;       // list<recipe_part>
     struct list               packs;       // list<recipe_pack>
+
+    // set when the recipe was loaded from a compiled recipe, in which case
+    // the recipe and everything it references lives in this single block
+    void*  compiled;
+    size_t compiled_size;
 };
 
+/**
+ * @brief The directory name, relative to the project, where compiled recipes
+ * are stored by default.
+ */
+#define RECIPE_CACHE_DIRECTORY ".vchrecipes"
+
 /**
  * @brief Parses a recipe from a yaml file buffer.
  * 
@@ -198,6 +213,21 @@ struct recipe {
  */
 extern int recipe_parse(void* buffer, size_t length, struct recipe** recipeOut);
 
+/**
+ * @brief Loads a recipe from a yaml file buffer, using a compiled version of the
+ * recipe from the cache directory if one exists for the exact same yaml content.
+ * Otherwise the yaml is parsed, and the compiled recipe is stored for the next load.
+ * The recipe must be freed with recipe_destroy in either case.
+ * 
+ * @param[In]  cacheDirectory The directory compiled recipes are stored in. If NULL
+ *                            this behaves exactly like recipe_parse.
+ * @param[In]  buffer 
+ * @param[In]  length 
+ * @param[Out] recipeOut
+ * @return int 
+ */
+extern int recipe_load(const char* cacheDirectory, void* buffer, size_t length, struct recipe** recipeOut);
+
 /**
  * @brief Cleans up any resources allocated during recipe_parse, and frees the recipe.
  * 
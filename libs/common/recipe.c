@@ -77,6 +77,7 @@ enum state {
     STATE_RECIPE_SOURCE_SCRIPT,
     STATE_RECIPE_SOURCE_PATH,
     STATE_RECIPE_SOURCE_URL,
+    STATE_RECIPE_SOURCE_URL_SHA256,
     STATE_RECIPE_SOURCE_GIT_REPO,
     STATE_RECIPE_SOURCE_GIT_BRANCH,
     STATE_RECIPE_SOURCE_GIT_COMMIT,
@@ -244,6 +245,19 @@ static int __is_valid_name(const char* name)
     return 0;
 }
 
+static int __is_valid_sha256(const char* digest)
+{
+    size_t length = 0;
+
+    while (digest[length] != '\0') {
+        if (!isxdigit((unsigned char)digest[length])) {
+            return -1;
+        }
+        length++;
+    }
+    return length == 64 ? 0 : -1;
+}
+
 static void __finalize_project(struct parser_state* state)
 {
     // verify required project members
@@ -341,6 +355,10 @@ static void __finalize_part(struct parser_state* state)
                 fprintf(stderr, "parse error: recipe %s: url is required\n", state->part.name);
                 exit(EXIT_FAILURE);
             }
+            if (state->part.source.url.sha256 != NULL && __is_valid_sha256(state->part.source.url.sha256)) {
+                fprintf(stderr, "parse error: recipe %s: sha256 must be 64 hexadecimal characters\n", state->part.name);
+                exit(EXIT_FAILURE);
+            }
             break;
         case RECIPE_PART_SOURCE_TYPE_GIT:
             if (state->part.source.git.url == NULL) {
@@ -1068,6 +1086,8 @@ static int __consume_event(struct parser_state* s, yaml_event_t* event)
                         __parser_push_state(s, STATE_RECIPE_SOURCE_TYPE);
                     } else if (strcmp(value, "url") == 0) {
                         __parser_push_state(s, STATE_RECIPE_SOURCE_URL);
+                    } else if (strcmp(value, "sha256") == 0) {
+                        __parser_push_state(s, STATE_RECIPE_SOURCE_URL_SHA256);
                     } else if (strcmp(value, "path") == 0) {
                         __parser_push_state(s, STATE_RECIPE_SOURCE_PATH);
                     } else if (strcmp(value, "git-url") == 0) {
@@ -1092,6 +1112,7 @@ static int __consume_event(struct parser_state* s, yaml_event_t* event)
         __consume_scalar_fn(STATE_RECIPE_SOURCE_SCRIPT, part.source.script, __parse_string)
         __consume_scalar_fn(STATE_RECIPE_SOURCE_PATH, part.source.path.path, __parse_string)
         __consume_scalar_fn(STATE_RECIPE_SOURCE_URL, part.source.url.url, __parse_string)
+        __consume_scalar_fn(STATE_RECIPE_SOURCE_URL_SHA256, part.source.url.sha256, __parse_string)
         __consume_scalar_fn(STATE_RECIPE_SOURCE_GIT_REPO, part.source.git.url, __parse_string)
         __consume_scalar_fn(STATE_RECIPE_SOURCE_GIT_BRANCH, part.source.git.branch, __parse_string)
         __consume_scalar_fn(STATE_RECIPE_SOURCE_GIT_COMMIT, part.source.git.commit, __parse_string)
@@ -1433,92 +1454,104 @@ int recipe_parse(void* buffer, size_t length, struct recipe** recipeOut)
     return 0;
 }
 
+// Compiled recipes are loaded as a single block, so only memory that was
+// added to the recipe after loading it must be freed individually.
+static void __release(struct recipe* recipe, void* memory)
+{
+    if (recipe->compiled != NULL && (char*)memory >= (char*)recipe->compiled &&
+        (char*)memory < (char*)recipe->compiled + recipe->compiled_size) {
+        return;
+    }
+    free(memory);
+}
+
 #define __destroy_list(fn, list, type) \
     do { \
         struct list_item* item; \
         while ((item = (list))) { \
             (list) = item->next; \
-            __destroy_##fn((type*)item); \
+            __destroy_##fn(recipe, (type*)item); \
         } \
     } while (0)
 
-static void __destroy_string(struct list_item_string* value)
+static void __destroy_string(struct recipe* recipe, struct list_item_string* value)
 {
-    free((void*)value->value);
-    free(value);
+    __release(recipe, (void*)value->value);
+    __release(recipe, value);
 }
 
-static void __destroy_keypair(struct chef_keypair_item* keypair)
+static void __destroy_keypair(struct recipe* recipe, struct chef_keypair_item* keypair)
 {
-    free((void*)keypair->key);
-    free((void*)keypair->value);
-    free(keypair);
+    __release(recipe, (void*)keypair->key);
+    __release(recipe, (void*)keypair->value);
+    __release(recipe, keypair);
 }
 
-static void __destroy_platform(struct recipe_platform* platform)
+static void __destroy_platform(struct recipe* recipe, struct recipe_platform* platform)
 {
-    free((void*)platform->name);
-    free((void*)platform->base);
-    free((void*)platform->toolchain);
+    __release(recipe, (void*)platform->name);
+    __release(recipe, (void*)platform->base);
+    __release(recipe, (void*)platform->toolchain);
     __destroy_list(string, platform->archs.head, struct list_item_string);
-    free(platform);
+    __release(recipe, platform);
 }
 
-static void __destroy_project(struct recipe_project* project)
+static void __destroy_project(struct recipe* recipe, struct recipe_project* project)
 {
-    free((void*)project->name);
-    free((void*)project->version);
-    free((void*)project->url);
-    free((void*)project->license);
-    free((void*)project->author);
-    free((void*)project->email);
+    __release(recipe, (void*)project->name);
+    __release(recipe, (void*)project->version);
+    __release(recipe, (void*)project->url);
+    __release(recipe, (void*)project->license);
+    __release(recipe, (void*)project->author);
+    __release(recipe, (void*)project->email);
     // do not free project itself, part of recipe
 }
 
-static void __destroy_ingredient(struct recipe_ingredient* ingredient)
+static void __destroy_ingredient(struct recipe* recipe, struct recipe_ingredient* ingredient)
 {
-    free((void*)ingredient->name);
-    free((void*)ingredient->channel);
-    free(ingredient);
+    __release(recipe, (void*)ingredient->name);
+    __release(recipe, (void*)ingredient->channel);
+    __release(recipe, ingredient);
 }
 
-static void __destroy_step(struct recipe_step* step)
+static void __destroy_step(struct recipe* recipe, struct recipe_step* step)
 {
     __destroy_list(string, step->depends.head, struct list_item_string);
     __destroy_list(string, step->arguments.head, struct list_item_string);
     __destroy_list(keypair, step->env_keypairs.head, struct chef_keypair_item);
-    free((void*)step->system);
-    free(step);
+    __release(recipe, (void*)step->system);
+    __release(recipe, step);
 }
 
-static void __destroy_part(struct recipe_part* part)
+static void __destroy_part(struct recipe* recipe, struct recipe_part* part)
 {
     __destroy_list(step, part->steps.head, struct recipe_step);
 
     if (part->source.type == RECIPE_PART_SOURCE_TYPE_PATH) {
-        free((void*)part->source.path.path);
+        __release(recipe, (void*)part->source.path.path);
     } else if (part->source.type == RECIPE_PART_SOURCE_TYPE_URL) {
-        free((void*)part->source.url.url);
+        __release(recipe, (void*)part->source.url.url);
+        __release(recipe, (void*)part->source.url.sha256);
     } else if (part->source.type == RECIPE_PART_SOURCE_TYPE_GIT) {
-        free((void*)part->source.git.url);
-        free((void*)part->source.git.branch);
-        free((void*)part->source.git.commit);
+        __release(recipe, (void*)part->source.git.url);
+        __release(recipe, (void*)part->source.git.branch);
+        __release(recipe, (void*)part->source.git.commit);
     }
 
-    free((void*)part->name);
-    free(part);
+    __release(recipe, (void*)part->name);
+    __release(recipe, part);
 }
 
-static void __destroy_command(struct recipe_pack_command* command)
+static void __destroy_command(struct recipe* recipe, struct recipe_pack_command* command)
 {
     __destroy_list(string, command->arguments.head, struct list_item_string);
-    free((void*)command->name);
-    free((void*)command->description);
-    free((void*)command->path);
-    free(command);
+    __release(recipe, (void*)command->name);
+    __release(recipe, (void*)command->description);
+    __release(recipe, (void*)command->path);
+    __release(recipe, command);
 }
 
-static void __destroy_pack_ingredient_options(struct recipe_pack_ingredient_options* options)
+static void __destroy_pack_ingredient_options(struct recipe* recipe, struct recipe_pack_ingredient_options* options)
 {
     __destroy_list(string, options->bin_dirs.head, struct list_item_string);
     __destroy_list(string, options->inc_dirs.head, struct list_item_string);
@@ -1527,20 +1560,20 @@ static void __destroy_pack_ingredient_options(struct recipe_pack_ingredient_opti
     __destroy_list(string, options->linker_flags.head, struct list_item_string);
 }
 
-static void __destroy_pack(struct recipe_pack* pack)
+static void __destroy_pack(struct recipe* recipe, struct recipe_pack* pack)
 {
-    __destroy_pack_ingredient_options(&pack->options);
+    __destroy_pack_ingredient_options(recipe, &pack->options);
     __destroy_list(command, pack->commands.head, struct recipe_pack_command);
     __destroy_list(string, pack->filters.head, struct list_item_string);
 
-    free((void*)pack->app_options.gateway);
-    free((void*)pack->app_options.dns);
+    __release(recipe, (void*)pack->app_options.gateway);
+    __release(recipe, (void*)pack->app_options.dns);
 
-    free((void*)pack->name);
-    free((void*)pack->summary);
-    free((void*)pack->description);
-    free((void*)pack->icon);
-    free(pack);
+    __release(recipe, (void*)pack->name);
+    __release(recipe, (void*)pack->summary);
+    __release(recipe, (void*)pack->description);
+    __release(recipe, (void*)pack->icon);
+    __release(recipe, pack);
 }
 
 void recipe_destroy(struct recipe* recipe)
@@ -1549,12 +1582,16 @@ void recipe_destroy(struct recipe* recipe)
         return;
     }
 
-    __destroy_project(&recipe->project);
+    __destroy_project(recipe, &recipe->project);
     __destroy_list(ingredient, recipe->environment.host.ingredients.head, struct recipe_ingredient);
     __destroy_list(ingredient, recipe->environment.build.ingredients.head, struct recipe_ingredient);
     __destroy_list(ingredient, recipe->environment.runtime.ingredients.head, struct recipe_ingredient);
     __destroy_list(part, recipe->parts.head, struct recipe_part);
     __destroy_list(pack, recipe->packs.head, struct recipe_pack);
     __destroy_list(platform, recipe->platforms.head, struct recipe_platform);
+    if (recipe->compiled != NULL) {
+        free(recipe->compiled);
+        return;
+    }
     free(recipe);
 }
@@ -0,0 +1,578 @@
+/**
+ * Copyright, Philip Meulengracht
+ *
+ * This program is free software : you can redistribute it and / or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation ? , either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ * 
+ */
+
+#include <errno.h>
+#include <chef/platform.h>
+#include <chef/recipe.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// A compiled recipe is the in-memory representation of a parsed recipe written
+// out as a single block, with all pointers stored as offsets into the block. The
+// offsets of all pointers are listed after the block, so loading it is a single
+// read followed by adding the address of the block to each of them.
+//
+// Bump the version whenever the recipe structures change in a way that is not
+// caught by their sizes.
+#define __COMPILED_MAGIC   "CHEFRCP"
+#define __COMPILED_VERSION 1
+#define __COMPILED_ALIGN   16
+
+struct __compiled_header {
+    char     magic[8];
+    uint32_t version;
+    uint32_t reserved;
+    uint64_t layout;
+    uint64_t yaml_hash;
+    uint64_t yaml_length;
+    uint64_t data_size;
+    uint64_t reloc_count;
+    uint64_t checksum;
+};
+
+struct __writer {
+    uint8_t*  data;
+    size_t    size;
+    size_t    capacity;
+    uint64_t* relocs;
+    size_t    reloc_count;
+    size_t    reloc_capacity;
+    int       failed;
+};
+
+typedef size_t (*__write_item_fn)(struct __writer* writer, const struct list_item* item);
+
+static uint64_t __fnv1a64(uint64_t hash, const void* data, size_t length)
+{
+    const uint8_t* bytes = data;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+#define __FNV_OFFSET_BASIS 0xcbf29ce484222325ULL
+
+static uint64_t __layout_fingerprint(void)
+{
+    const uint64_t sizes[] = {
+        sizeof(void*),
+        sizeof(struct list),
+        sizeof(struct recipe),
+        sizeof(struct recipe_platform),
+        sizeof(struct recipe_ingredient),
+        sizeof(struct recipe_part),
+        sizeof(struct recipe_step),
+        sizeof(struct recipe_pack),
+        sizeof(struct recipe_pack_command),
+        sizeof(struct list_item_string),
+        sizeof(struct chef_keypair_item),
+        sizeof(struct meson_wrap_item)
+    };
+    return __fnv1a64(__FNV_OFFSET_BASIS, &sizes[0], sizeof(sizes));
+}
+
+static size_t __alloc(struct __writer* writer, size_t size)
+{
+    size_t offset = (writer->size + (__COMPILED_ALIGN - 1)) & ~(size_t)(__COMPILED_ALIGN - 1);
+
+    if (writer->failed) {
+        return 0;
+    }
+
+    if (offset + size > writer->capacity) {
+        size_t   capacity = writer->capacity != 0 ? writer->capacity : 4096;
+        uint8_t* data;
+
+        while (capacity < offset + size) {
+            capacity *= 2;
+        }
+
+        data = realloc(writer->data, capacity);
+        if (data == NULL) {
+            writer->failed = 1;
+            return 0;
+        }
+        memset(data + writer->capacity, 0, capacity - writer->capacity);
+        writer->data = data;
+        writer->capacity = capacity;
+    }
+
+    writer->size = offset + size;
+    return offset;
+}
+
+static size_t __alloc_copy(struct __writer* writer, const void* value, size_t size)
+{
+    size_t offset = __alloc(writer, size);
+    if (!writer->failed) {
+        memcpy(writer->data + offset, value, size);
+    }
+    return offset;
+}
+
+static void __clear(struct __writer* writer, size_t field)
+{
+    if (!writer->failed) {
+        memset(writer->data + field, 0, sizeof(void*));
+    }
+}
+
+static void __pointer(struct __writer* writer, size_t field, size_t target)
+{
+    uintptr_t value = (uintptr_t)target;
+
+    if (writer->failed) {
+        return;
+    }
+
+    if (writer->reloc_count == writer->reloc_capacity) {
+        size_t    capacity = writer->reloc_capacity != 0 ? writer->reloc_capacity * 2 : 256;
+        uint64_t* relocs = realloc(writer->relocs, capacity * sizeof(uint64_t));
+        if (relocs == NULL) {
+            writer->failed = 1;
+            return;
+        }
+        writer->relocs = relocs;
+        writer->reloc_capacity = capacity;
+    }
+
+    memcpy(writer->data + field, &value, sizeof(uintptr_t));
+    writer->relocs[writer->reloc_count++] = (uint64_t)field;
+}
+
+static void __string(struct __writer* writer, size_t field, const char* value)
+{
+    size_t offset;
+
+    if (value == NULL) {
+        __clear(writer, field);
+        return;
+    }
+
+    offset = __alloc_copy(writer, value, strlen(value) + 1);
+    __pointer(writer, field, offset);
+}
+
+// Writes the items of the list, and links them up just like list_add would.
+// The list header must be the first member of every item.
+static void __list(struct __writer* writer, size_t field, const struct list* list, __write_item_fn write)
+{
+    struct list_item* i;
+    size_t            previous = 0;
+    int               first = 1;
+
+    __clear(writer, field + offsetof(struct list, head));
+    __clear(writer, field + offsetof(struct list, tail));
+
+    list_foreach(list, i) {
+        size_t node = write(writer, i);
+        if (writer->failed) {
+            return;
+        }
+
+        __clear(writer, node + offsetof(struct list_item, next));
+        if (first) {
+            __clear(writer, node + offsetof(struct list_item, prev));
+            __pointer(writer, field + offsetof(struct list, head), node);
+            first = 0;
+        } else {
+            __pointer(writer, previous + offsetof(struct list_item, next), node);
+            __pointer(writer, node + offsetof(struct list_item, prev), previous);
+        }
+        previous = node;
+    }
+
+    if (!first) {
+        __pointer(writer, field + offsetof(struct list, tail), previous);
+    }
+}
+
+static size_t __write_string_item(struct __writer* writer, const struct list_item* item)
+{
+    const struct list_item_string* value = (const struct list_item_string*)item;
+    size_t                         node = __alloc_copy(writer, value, sizeof(struct list_item_string));
+
+    __string(writer, node + offsetof(struct list_item_string, value), value->value);
+    return node;
+}
+
+static size_t __write_keypair(struct __writer* writer, const struct list_item* item)
+{
+    const struct chef_keypair_item* keypair = (const struct chef_keypair_item*)item;
+    size_t                          node = __alloc_copy(writer, keypair, sizeof(struct chef_keypair_item));
+
+    __string(writer, node + offsetof(struct chef_keypair_item, key), keypair->key);
+    __string(writer, node + offsetof(struct chef_keypair_item, value), keypair->value);
+    return node;
+}
+
+static size_t __write_meson_wrap(struct __writer* writer, const struct list_item* item)
+{
+    const struct meson_wrap_item* wrap = (const struct meson_wrap_item*)item;
+    size_t                        node = __alloc_copy(writer, wrap, sizeof(struct meson_wrap_item));
+
+    __string(writer, node + offsetof(struct meson_wrap_item, name), wrap->name);
+    __string(writer, node + offsetof(struct meson_wrap_item, ingredient), wrap->ingredient);
+    return node;
+}
+
+static size_t __write_platform(struct __writer* writer, const struct list_item* item)
+{
+    const struct recipe_platform* platform = (const struct recipe_platform*)item;
+    size_t                        node = __alloc_copy(writer, platform, sizeof(struct recipe_platform));
+
+    __string(writer, node + offsetof(struct recipe_platform, name), platform->name);
+    __string(writer, node + offsetof(struct recipe_platform, base), platform->base);
+    __string(writer, node + offsetof(struct recipe_platform, toolchain), platform->toolchain);
+    __list(writer, node + offsetof(struct recipe_platform, archs), &platform->archs, __write_string_item);
+    return node;
+}
+
+static size_t __write_ingredient(struct __writer* writer, const struct list_item* item)
+{
+    const struct recipe_ingredient* ingredient = (const struct recipe_ingredient*)item;
+    size_t                          node = __alloc_copy(writer, ingredient, sizeof(struct recipe_ingredient));
+
+    __string(writer, node + offsetof(struct recipe_ingredient, name), ingredient->name);
+    __string(writer, node + offsetof(struct recipe_ingredient, channel), ingredient->channel);
+    __list(writer, node + offsetof(struct recipe_ingredient, filters), &ingredient->filters, __write_string_item);
+    return node;
+}
+
+static size_t __write_step(struct __writer* writer, const struct list_item* item)
+{
+    const struct recipe_step* step = (const struct recipe_step*)item;
+    size_t                    node = __alloc_copy(writer, step, sizeof(struct recipe_step));
+    size_t                    options = node + offsetof(struct recipe_step, options);
+
+    __string(writer, node + offsetof(struct recipe_step, name), step->name);
+    __string(writer, node + offsetof(struct recipe_step, system), step->system);
+    __string(writer, node + offsetof(struct recipe_step, script), step->script);
+    __list(writer, node + offsetof(struct recipe_step, depends), &step->depends, __write_string_item);
+    __list(writer, node + offsetof(struct recipe_step, arguments), &step->arguments, __write_string_item);
+    __list(writer, node + offsetof(struct recipe_step, env_keypairs), &step->env_keypairs, __write_keypair);
+
+    // the options are only ever set for the system they belong to
+    if (step->system != NULL && strcmp(step->system, "meson") == 0) {
+        __string(writer, options + offsetof(struct chef_backend_meson_options, cross_file), step->options.meson.cross_file);
+        __list(writer, options + offsetof(struct chef_backend_meson_options, wraps), &step->options.meson.wraps, __write_meson_wrap);
+    }
+    return node;
+}
+
+static size_t __write_part(struct __writer* writer, const struct list_item* item)
+{
+    const struct recipe_part* part = (const struct recipe_part*)item;
+    size_t                    node = __alloc_copy(writer, part, sizeof(struct recipe_part));
+    size_t                    source = node + offsetof(struct recipe_part, source);
+
+    __string(writer, node + offsetof(struct recipe_part, name), part->name);
+    __string(writer, node + offsetof(struct recipe_part, toolchain), part->toolchain);
+    __string(writer, source + offsetof(struct recipe_part_source, script), part->source.script);
+    switch (part->source.type) {
+        case RECIPE_PART_SOURCE_TYPE_PATH:
+            __string(writer, source + offsetof(struct recipe_part_source, path.path), part->source.path.path);
+            break;
+        case RECIPE_PART_SOURCE_TYPE_URL:
+            __string(writer, source + offsetof(struct recipe_part_source, url.url), part->source.url.url);
+            __string(writer, source + offsetof(struct recipe_part_source, url.sha256), part->source.url.sha256);
+            break;
+        case RECIPE_PART_SOURCE_TYPE_GIT:
+            __string(writer, source + offsetof(struct recipe_part_source, git.url), part->source.git.url);
+            __string(writer, source + offsetof(struct recipe_part_source, git.branch), part->source.git.branch);
+            __string(writer, source + offsetof(struct recipe_part_source, git.commit), part->source.git.commit);
+            break;
+    }
+    __list(writer, node + offsetof(struct recipe_part, steps), &part->steps, __write_step);
+    return node;
+}
+
+static size_t __write_command(struct __writer* writer, const struct list_item* item)
+{
+    const struct recipe_pack_command* command = (const struct recipe_pack_command*)item;
+    size_t                            node = __alloc_copy(writer, command, sizeof(struct recipe_pack_command));
+
+    __string(writer, node + offsetof(struct recipe_pack_command, name), command->name);
+    __string(writer, node + offsetof(struct recipe_pack_command, description), command->description);
+    __string(writer, node + offsetof(struct recipe_pack_command, icon), command->icon);
+    __string(writer, node + offsetof(struct recipe_pack_command, path), command->path);
+    __list(writer, node + offsetof(struct recipe_pack_command, arguments), &command->arguments, __write_string_item);
+    return node;
+}
+
+static size_t __write_pack(struct __writer* writer, const struct list_item* item)
+{
+    const struct recipe_pack* pack = (const struct recipe_pack*)item;
+    size_t                    node = __alloc_copy(writer, pack, sizeof(struct recipe_pack));
+    size_t                    options = node + offsetof(struct recipe_pack, options);
+
+    __string(writer, node + offsetof(struct recipe_pack, name), pack->name);
+    __string(writer, node + offsetof(struct recipe_pack, summary), pack->summary);
+    __string(writer, node + offsetof(struct recipe_pack, description), pack->description);
+    __string(writer, node + offsetof(struct recipe_pack, icon), pack->icon);
+    __string(writer, node + offsetof(struct recipe_pack, app_options.gateway), pack->app_options.gateway);
+    __string(writer, node + offsetof(struct recipe_pack, app_options.dns), pack->app_options.dns);
+    __list(writer, options + offsetof(struct recipe_pack_ingredient_options, bin_dirs), &pack->options.bin_dirs, __write_string_item);
+    __list(writer, options + offsetof(struct recipe_pack_ingredient_options, inc_dirs), &pack->options.inc_dirs, __write_string_item);
+    __list(writer, options + offsetof(struct recipe_pack_ingredient_options, lib_dirs), &pack->options.lib_dirs, __write_string_item);
+    __list(writer, options + offsetof(struct recipe_pack_ingredient_options, compiler_flags), &pack->options.compiler_flags, __write_string_item);
+    __list(writer, options + offsetof(struct recipe_pack_ingredient_options, linker_flags), &pack->options.linker_flags, __write_string_item);
+    __list(writer, node + offsetof(struct recipe_pack, filters), &pack->filters, __write_string_item);
+    __list(writer, node + offsetof(struct recipe_pack, commands), &pack->commands, __write_command);
+    return node;
+}
+
+static void __write_recipe(struct __writer* writer, const struct recipe* recipe)
+{
+    size_t root = __alloc_copy(writer, recipe, sizeof(struct recipe));
+    size_t project = root + offsetof(struct recipe, project);
+    size_t environment = root + offsetof(struct recipe, environment);
+
+    __string(writer, project + offsetof(struct recipe_project, name), recipe->project.name);
+    __string(writer, project + offsetof(struct recipe_project, version), recipe->project.version);
+    __string(writer, project + offsetof(struct recipe_project, license), recipe->project.license);
+    __string(writer, project + offsetof(struct recipe_project, eula), recipe->project.eula);
+    __string(writer, project + offsetof(struct recipe_project, author), recipe->project.author);
+    __string(writer, project + offsetof(struct recipe_project, email), recipe->project.email);
+    __string(writer, project + offsetof(struct recipe_project, url), recipe->project.url);
+    __list(writer, root + offsetof(struct recipe, platforms), &recipe->platforms, __write_platform);
+    __list(writer, environment + offsetof(struct recipe_environment, host.ingredients), &recipe->environment.host.ingredients, __write_ingredient);
+    __list(writer, environment + offsetof(struct recipe_environment, host.packages), &recipe->environment.host.packages, __write_string_item);
+    __list(writer, environment + offsetof(struct recipe_environment, build.ingredients), &recipe->environment.build.ingredients, __write_ingredient);
+    __list(writer, environment + offsetof(struct recipe_environment, runtime.ingredients), &recipe->environment.runtime.ingredients, __write_ingredient);
+    __string(writer, environment + offsetof(struct recipe_environment, hooks.setup), recipe->environment.hooks.setup);
+    __list(writer, root + offsetof(struct recipe, parts), &recipe->parts, __write_part);
+    __list(writer, root + offsetof(struct recipe, packs), &recipe->packs, __write_pack);
+    __clear(writer, root + offsetof(struct recipe, compiled));
+    if (!writer->failed) {
+        memset(writer->data + root + offsetof(struct recipe, compiled_size), 0, sizeof(size_t));
+    }
+}
+
+static char* __compiled_path(const char* cacheDirectory, uint64_t hash)
+{
+    char name[32];
+    snprintf(&name[0], sizeof(name), "%016llx.recipe", (unsigned long long)hash);
+    return strpathcombine(cacheDirectory, &name[0]);
+}
+
+static int __store_compiled(const char* cacheDirectory, const char* path, uint64_t hash, size_t length, const struct recipe* recipe)
+{
+    struct __compiled_header header = { 0 };
+    struct __writer          writer = { 0 };
+    char                     guid[40];
+    char*                    tmpPath = NULL;
+    FILE*                    file = NULL;
+    int                      status = -1;
+
+    __write_recipe(&writer, recipe);
+
+    // keep the relocations that follow the data aligned
+    __alloc(&writer, 0);
+    if (writer.failed) {
+        errno = ENOMEM;
+        goto cleanup;
+    }
+
+    memcpy(&header.magic[0], __COMPILED_MAGIC, sizeof(header.magic));
+    header.version = __COMPILED_VERSION;
+    header.layout = __layout_fingerprint();
+    header.yaml_hash = hash;
+    header.yaml_length = (uint64_t)length;
+    header.data_size = (uint64_t)writer.size;
+    header.reloc_count = (uint64_t)writer.reloc_count;
+    header.checksum = __fnv1a64(
+        __fnv1a64(__FNV_OFFSET_BASIS, writer.data, writer.size),
+        writer.relocs, writer.reloc_count * sizeof(uint64_t)
+    );
+
+    if (platform_mkdir(cacheDirectory)) {
+        goto cleanup;
+    }
+
+    // write to a unique file and move it in place, so concurrent loads never
+    // see a partially written recipe
+    platform_guid_new_string(&guid[0]);
+    tmpPath = malloc(strlen(path) + sizeof(guid) + 2);
+    if (tmpPath == NULL) {
+        goto cleanup;
+    }
+    sprintf(tmpPath, "%s.%s", path, &guid[0]);
+
+    file = fopen(tmpPath, "wb");
+    if (file == NULL) {
+        goto cleanup;
+    }
+
+    if (fwrite(&header, sizeof(header), 1, file) != 1 ||
+        fwrite(writer.data, 1, writer.size, file) != writer.size ||
+        fwrite(writer.relocs, sizeof(uint64_t), writer.reloc_count, file) != writer.reloc_count) {
+        goto cleanup;
+    }
+
+    status = fclose(file);
+    file = NULL;
+    if (status == 0) {
+        status = rename(tmpPath, path);
+    }
+
+cleanup:
+    if (file != NULL) {
+        fclose(file);
+    }
+    if (status && tmpPath != NULL) {
+        remove(tmpPath);
+    }
+    free(tmpPath);
+    free(writer.data);
+    free(writer.relocs);
+    return status;
+}
+
+static int __read_compiled(const char* path, void** bufferOut, size_t* sizeOut)
+{
+    FILE* file;
+    void* buffer = NULL;
+    long  size;
+    int   status = -1;
+
+    file = fopen(path, "rb");
+    if (file == NULL) {
+        return -1;
+    }
+
+    if (fseek(file, 0, SEEK_END) || (size = ftell(file)) < (long)sizeof(struct __compiled_header) ||
+        fseek(file, 0, SEEK_SET)) {
+        errno = EINVAL;
+        goto cleanup;
+    }
+
+    buffer = malloc((size_t)size);
+    if (buffer == NULL) {
+        goto cleanup;
+    }
+
+    if (fread(buffer, 1, (size_t)size, file) != (size_t)size) {
+        errno = EIO;
+        goto cleanup;
+    }
+
+    *bufferOut = buffer;
+    *sizeOut = (size_t)size;
+    buffer = NULL;
+    status = 0;
+
+cleanup:
+    free(buffer);
+    fclose(file);
+    return status;
+}
+
+static int __load_compiled(const char* path, uint64_t hash, size_t length, struct recipe** recipeOut)
+{
+    struct __compiled_header* header;
+    struct recipe*            recipe;
+    uint8_t*                  data;
+    uint64_t*                 relocs;
+    void*                     buffer;
+    size_t                    size;
+
+    if (__read_compiled(path, &buffer, &size)) {
+        return -1;
+    }
+
+    // anything that does not match exactly is stale, and the yaml is parsed instead
+    header = buffer;
+    if (memcmp(&header->magic[0], __COMPILED_MAGIC, sizeof(header->magic)) != 0 ||
+        header->version != __COMPILED_VERSION ||
+        header->layout != __layout_fingerprint() ||
+        header->yaml_hash != hash ||
+        header->yaml_length != (uint64_t)length ||
+        header->data_size < sizeof(struct recipe) ||
+        header->data_size % __COMPILED_ALIGN != 0 ||
+        header->reloc_count > (size - sizeof(struct __compiled_header)) / sizeof(uint64_t) ||
+        sizeof(struct __compiled_header) + header->data_size + header->reloc_count * sizeof(uint64_t) != size) {
+        goto stale;
+    }
+
+    data = (uint8_t*)buffer + sizeof(struct __compiled_header);
+    relocs = (uint64_t*)(data + header->data_size);
+    if (header->checksum != __fnv1a64(
+            __fnv1a64(__FNV_OFFSET_BASIS, data, (size_t)header->data_size),
+            relocs, (size_t)header->reloc_count * sizeof(uint64_t))) {
+        goto stale;
+    }
+
+    for (uint64_t i = 0; i < header->reloc_count; i++) {
+        uintptr_t value;
+
+        if (relocs[i] % sizeof(void*) != 0 || relocs[i] > header->data_size - sizeof(uintptr_t)) {
+            goto stale;
+        }
+
+        memcpy(&value, data + relocs[i], sizeof(uintptr_t));
+        if (value >= header->data_size) {
+            goto stale;
+        }
+        value += (uintptr_t)data;
+        memcpy(data + relocs[i], &value, sizeof(uintptr_t));
+    }
+
+    recipe = (struct recipe*)data;
+    recipe->compiled = buffer;
+    recipe->compiled_size = size;
+    *recipeOut = recipe;
+    return 0;
+
+stale:
+    free(buffer);
+    errno = ESTALE;
+    return -1;
+}
+
+int recipe_load(const char* cacheDirectory, void* buffer, size_t length, struct recipe** recipeOut)
+{
+    uint64_t hash;
+    char*    path;
+    int      status;
+
+    if (cacheDirectory == NULL) {
+        return recipe_parse(buffer, length, recipeOut);
+    }
+
+    hash = __fnv1a64(__FNV_OFFSET_BASIS, buffer, length);
+    path = __compiled_path(cacheDirectory, hash);
+    if (path != NULL && __load_compiled(path, hash, length, recipeOut) == 0) {
+        free(path);
+        return 0;
+    }
+
+    status = recipe_parse(buffer, length, recipeOut);
+    if (status == 0 && path != NULL) {
+        // failing to store the compiled recipe only means the yaml
+        // is parsed again the next time
+        (void)__store_compiled(cacheDirectory, path, hash, length, *recipeOut);
+    }
+    free(path);
+    return status;
+}
@@ -286,14 +286,29 @@ extern int containerv_create(
 );
 
 enum container_spawn_flags {
-    CV_SPAWN_WAIT = 0x1
+    CV_SPAWN_WAIT   = 0x1,
+    CV_SPAWN_STREAM = 0x2  // capture output and exit status, see containerv_process_streams
+};
+
+/**
+ * @brief Descriptors returned for a process spawned with CV_SPAWN_STREAM. stdout_fd and
+ * stderr_fd carry the output of the process. exit_fd becomes readable once the process
+ * has been collected and yields a single int with its exit code (128 + signal if it was
+ * killed), or EOF if the container went away first. The caller owns all three descriptors.
+ * CV_SPAWN_STREAM cannot be combined with CV_SPAWN_WAIT, and is only supported on Linux.
+ */
+struct containerv_process_streams {
+    int stdout_fd;
+    int stderr_fd;
+    int exit_fd;
 };
 
 struct containerv_spawn_options {
-    const char*                arguments;
-    const char* const*         environment;
-    struct containerv_user*    as_user;
-    enum container_spawn_flags flags;
+    const char*                        arguments;
+    const char* const*                 environment;
+    struct containerv_user*            as_user;
+    enum container_spawn_flags         flags;
+    struct containerv_process_streams* streams; // required for CV_SPAWN_STREAM
 };
 
 extern int containerv_spawn(
@@ -340,6 +355,35 @@ extern int containerv_guest_is_windows(struct containerv_container* container);
  */
 extern int containerv_get_stats(struct containerv_container* container, struct containerv_stats* stats);
 
+/**
+ * @brief Query resource usage snapshots for multiple containers in a single pass.
+ * All samples in the batch share the same timestamp. On Linux the underlying
+ * cgroup and network statistic files are kept open per container, so repeated
+ * sampling does not re-open them.
+ *
+ * @param containers Array of containers to query, NULL entries yield zeroed stats.
+ * @param count Number of entries in containers and stats.
+ * @param stats Output array of stats, one per container.
+ * @return 0 on success, -1 on error.
+ */
+extern int containerv_get_stats_batch(struct containerv_container** containers, int count, struct containerv_stats* stats);
+
+/**
+ * @brief Keep a pool of pre-created veth pairs for networked containers. Creating a
+ * networked container then claims a pair from the pool, and the remaining link and
+ * address setup is done in a single rtnetlink transaction. The pool is refilled in the
+ * background. Without a pool, pairs are created on demand. Not used on Windows.
+ *
+ * @param size Number of veth pairs to keep ready, 0 disables the pool.
+ * @return 0 on success, -1 on error.
+ */
+extern int containerv_network_pool_initialize(int size);
+
+/**
+ * @brief Stop refilling the veth pool and remove the pairs that were not claimed.
+ */
+extern void containerv_network_pool_cleanup(void);
+
 /**
  * @brief Get list of processes running in container
  * @param container Container to get processes for
@@ -373,7 +417,8 @@ struct containerv_join_options {
  * @param containerId The unique identifier of the container to join.
  * @param commandPath Absolute or container-relative path to the executable.
  * @param options Optional join options (may be NULL for defaults).
- * @return 0 on success, -1 on error. Errno will be set accordingly.
+ * @return 0 on success, -1 on error. Errno will be set accordingly, ENOENT or
+ *         ECONNREFUSED if the container is not running.
  */
 extern int containerv_join(
     const char*                     containerId,
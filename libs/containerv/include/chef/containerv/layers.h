@@ -49,7 +49,9 @@ struct containerv_layer {
      */
     char* source;
     
-    /** Target mount point (for HOST_DIRECTORY type) */
+    /** Target mount point (for HOST_DIRECTORY type). For VAFS_PACKAGE
+     *  layers this may name a directory other than "/", the package is
+     *  then stacked onto that directory instead of the root. */
     char* target;
     
     /** Read-only flag */
@@ -92,6 +92,7 @@ static const struct __std_mount_spec* __find_standard_mount_spec(const char* whe
 struct containerv_container_process {
     struct list_item list_header;
     pid_t            pid;
+    int              exit_fd; // write end of the exit status pipe for streamed processes
 };
 
 static struct containerv_container_process* containerv_container_process_new(pid_t processId)
@@ -101,11 +102,13 @@ static struct containerv_container_process* containerv_container_process_new(pid
         return NULL;
     }
     ptr->pid = processId;
+    ptr->exit_fd = -1;
     return ptr;
 }
 
 static void containerv_container_process_delete(struct containerv_container_process* ptr)
 {
+    __close_safe(&ptr->exit_fd);
     free(ptr);
 }
 
@@ -177,6 +180,9 @@ static struct containerv_container* __container_new(const char* containerId)
     for (int i = 0; i < CV_NS_COUNT; i++) {
         container->ns_fds[i] = -1;
     }
+    for (int i = 0; i < CV_STATS_FILE_COUNT; i++) {
+        container->stats_fds[i] = -1;
+    }
 
     return container;
 }
@@ -196,6 +202,10 @@ static void __container_delete(struct containerv_container* container)
         __close_safe(&container->ns_fds[i]);
     }
 
+    for (int i = 0; i < CV_STATS_FILE_COUNT; i++) {
+        __close_safe(&container->stats_fds[i]);
+    }
+
     __close_safe(&container->host[0]);
     __close_safe(&container->host[1]);
     __close_safe(&container->child[0]);
@@ -324,6 +334,34 @@ static int __wait_and_read_stds(void* context)
     return 0;
 }
 
+// Invoked by the PID1 service for every process it collects. Streamed processes get
+// their exit code written to the exit pipe, which also signals EOF to the reader.
+static void __container_process_exited(pid_t processId, int exitCode, void* context)
+{
+    struct containerv_container* container = context;
+    struct list_item*            i;
+
+    list_foreach (&container->processes, i) {
+        struct containerv_container_process* proc = (struct containerv_container_process*)i;
+        if (proc->pid == processId) {
+            if (proc->exit_fd >= 0 && write(proc->exit_fd, &exitCode, sizeof(int)) != sizeof(int)) {
+                VLOG_WARNING("containerv[child]", "__container_process_exited: failed to report exit of %i\n", processId);
+            }
+            list_remove(&container->processes, i);
+            containerv_container_process_delete(proc);
+            return;
+        }
+    }
+}
+
+static void __close_pipes(int (*pipes)[2], int count)
+{
+    for (int i = 0; i < count; i++) {
+        __close_safe(&pipes[i][0]);
+        __close_safe(&pipes[i][1]);
+    }
+}
+
 int __containerv_spawn(struct containerv_container* container, struct __containerv_spawn_options* options, pid_t* pidOut)
 {
     struct containerv_container_process* proc;
@@ -332,8 +370,26 @@ int __containerv_spawn(struct containerv_container* container, struct __containe
     const char*                          argv_fallback[] = { NULL, NULL };
     const char* const*                   argv;
     pid1_process_options_t               pid1_opts;
+    int                                  streams[3][2] = { { -1, -1 }, { -1, -1 }, { -1, -1 } };
     VLOG_DEBUG("containerv[child]", "__containerv_spawn(path=%s)\n", options->path);
 
+    if (options->flags & CV_SPAWN_STREAM) {
+        if ((options->flags & CV_SPAWN_WAIT) || options->streams == NULL) {
+            errno = EINVAL;
+            return -1;
+        }
+
+        // stdout, stderr and the exit status. Everything is close-on-exec so later
+        // processes do not keep these open, pid1 dups the output ends in the child.
+        for (int i = 0; i < 3; i++) {
+            if (pipe2(streams[i], O_CLOEXEC)) {
+                VLOG_ERROR("containerv[child]", "__containerv_spawn: failed to create stream pipes\n");
+                __close_pipes(streams, 3);
+                return -1;
+            }
+        }
+    }
+
     argv = options->argv;
     if (argv == NULL || argv[0] == NULL) {
         argv_fallback[0] = options->path;
@@ -346,6 +402,8 @@ int __containerv_spawn(struct containerv_container* container, struct __containe
     pid1_opts.environment = options->envv;
     pid1_opts.working_directory = NULL;
     pid1_opts.log_path = NULL;
+    pid1_opts.stdout_fd = (streams[0][__FD_WRITE] >= 0) ? streams[0][__FD_WRITE] : 0;
+    pid1_opts.stderr_fd = (streams[1][__FD_WRITE] >= 0) ? streams[1][__FD_WRITE] : 0;
     pid1_opts.memory_limit_bytes = 0;
     pid1_opts.cpu_percent = 0;
     pid1_opts.process_limit = 0;
@@ -357,24 +415,39 @@ int __containerv_spawn(struct containerv_container* container, struct __containe
     status = pid1_spawn_process(&pid1_opts, &processId);
     if (status != 0) {
         VLOG_ERROR("containerv[child]", "__containerv_spawn: failed to spawn %s\n", options->path);
+        __close_pipes(streams, 3);
         return -1;
     }
 
+    // the output ends now only live in the new process
+    __close_safe(&streams[0][__FD_WRITE]);
+    __close_safe(&streams[1][__FD_WRITE]);
+
     proc = containerv_container_process_new(processId);
     if (proc) {
+        proc->exit_fd = streams[2][__FD_WRITE];
         list_add(&container->processes, &proc->list_header);
+    } else if (options->flags & CV_SPAWN_STREAM) {
+        // without tracking the exit status can never be delivered
+        (void)pid1_kill_process(processId);
+        __close_pipes(streams, 3);
+        errno = ENOMEM;
+        return -1;
+    }
+
+    if (options->flags & CV_SPAWN_STREAM) {
+        options->streams[0] = streams[0][__FD_READ];
+        options->streams[1] = streams[1][__FD_READ];
+        options->streams[2] = streams[2][__FD_READ];
     }
 
+    // the exit callback untracks the process once it has been collected
     if (options->flags & CV_SPAWN_WAIT) {
         int exit_code = 0;
         if (pid1_wait_process(processId, &exit_code) != 0) {
             VLOG_ERROR("containerv[child]", "__containerv_spawn: failed to wait for pid %u\n", processId);
             return -1;
         }
-        if (proc) {
-            list_remove(&container->processes, &proc->list_header);
-            containerv_container_process_delete(proc);
-        }
     }
 
     *pidOut = processId;
@@ -388,10 +461,9 @@ int __containerv_kill(struct containerv_container* container, pid_t processId)
     list_foreach (&container->processes, i) {
         struct containerv_container_process* proc = (struct containerv_container_process*)i;
         if (proc->pid == processId) {
-            (void)pid1_kill_process(processId);
-            list_remove(&container->processes, i);
-            containerv_container_process_delete(proc);
-            return 0;
+            // the process stays tracked until it has been collected, so
+            // streamed processes still get their exit status delivered
+            return pid1_kill_process(processId);
         }
     }
     return -1;
@@ -430,6 +502,8 @@ static int __container_spawn_log(int fd, int error)
 static int __container_idle_loop(struct containerv_container* container)
 {
     int           status;
+    sigset_t      blocked;
+    sigset_t      waitmask;
     struct pollfd fds[1] = {
         {
             .fd = container->socket_fd,
@@ -438,8 +512,18 @@ static int __container_idle_loop(struct containerv_container* container)
     };
     VLOG_DEBUG("containerv[child]", "__container_idle_loop()\n");
 
+    // SIGCHLD is only let through while waiting, so exits that happen while a
+    // command is handled still interrupt the next wait and are reaped promptly
+    sigemptyset(&blocked);
+    sigaddset(&blocked, SIGCHLD);
+    if (sigprocmask(SIG_BLOCK, &blocked, &waitmask)) {
+        VLOG_ERROR("containerv[child]", "__container_idle_loop: failed to block SIGCHLD\n");
+        return -1;
+    }
+    sigdelset(&waitmask, SIGCHLD);
+
     for (;;) {
-        status = poll(fds, 1, -1);
+        status = ppoll(fds, 1, NULL, &waitmask);
         if (status <= 0) {
             if (status < 0 && errno == EINTR) {
                 (void)pid1_reap_zombies();
@@ -907,18 +991,11 @@ static int __container_run(
 
         snprintf(container_veth, sizeof(container_veth), "veth%sc", &container->id[__CONTAINER_VETH_CONT_OFFSET]);
         
+        // Address and bring up the container interface and the loopback together
         VLOG_DEBUG("containerv[child]", "__container_run: bringing up container network interface %s\n", container_veth);
-        status = if_up(container_veth, (char*)options->network.container_ip, (char*)options->network.container_netmask);
-        if (status) {
-            VLOG_ERROR("containerv[child]", "__container_run: failed to bring up container veth interface\n");
-            return status;
-        }
-        
-        // Bring up loopback interface
-        VLOG_DEBUG("containerv[child]", "__container_run: bringing up loopback interface\n");
-        status = if_up("lo", "127.0.0.1", "255.0.0.0");
+        status = if_configure(container_veth, options->network.container_ip, options->network.container_netmask);
         if (status) {
-            VLOG_ERROR("containerv[child]", "__container_run: failed to bring up loopback interface\n");
+            VLOG_ERROR("containerv[child]", "__container_run: failed to bring up container network interfaces\n");
             return status;
         }
     }
@@ -969,12 +1046,13 @@ static int __container_run(
         VLOG_ERROR("containerv[child]", "__container_run: failed to initialize PID1 service\n");
         return status;
     }
+    pid1_set_exit_callback(__container_process_exited, container);
 
     // Apply seccomp-bpf for syscall filtering.
     // This must happen after capability dropping and other prctl-based setup,
     // otherwise the filter can block those operations and break container bring-up.
     if (options->policy != NULL) {
-        status = policy_seccomp_apply(options->policy);
+        status = policy_seccomp_apply(options->policy, container->seccomp_program);
         if (status) {
             VLOG_ERROR("containerv[child]", "__container_run: failed to apply seccomp policy\n");
             return status;
@@ -986,6 +1064,97 @@ static int __container_run(
     return __container_idle_loop(container);
 }
 
+// Attaches a veth pair to the container. The pair is claimed from the network pool if
+// possible, otherwise created. Everything else (naming, moving the peer into the container
+// namespace, addressing and bringing up the host end) is done in one rtnetlink transaction.
+static int __setup_container_network(struct containerv_container* container, struct containerv_options* options)
+{
+    struct nl_batch* batch;
+    char             hostVeth[16];
+    char             containerVeth[16];
+    int              hostIndex;
+    int              peerIndex;
+    int              pooled = 1;
+    int              sockFd;
+    int              netnsFd;
+    int              status = -1;
+
+    // Create unique veth pair names from container ID
+    snprintf(hostVeth, sizeof(hostVeth), "veth%s", &container->id[__CONTAINER_VETH_HOST_OFFSET]);
+    snprintf(containerVeth, sizeof(containerVeth), "veth%sc", &container->id[__CONTAINER_VETH_CONT_OFFSET]);
+
+    sockFd = create_socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_ROUTE);
+    if (sockFd < 0) {
+        VLOG_ERROR("containerv[host]", "__setup_container_network: failed to create netlink socket\n");
+        return -1;
+    }
+
+    if (containerv_network_pool_acquire(&hostIndex, &peerIndex)) {
+        pooled = 0;
+        if (create_veth(sockFd, hostVeth, containerVeth)) {
+            VLOG_ERROR("containerv[host]", "__setup_container_network: failed to create veth pair\n");
+            close(sockFd);
+            return -1;
+        }
+        hostIndex = if_index(hostVeth);
+        peerIndex = if_index(containerVeth);
+        if (hostIndex < 0 || peerIndex < 0) {
+            goto cleanup;
+        }
+    }
+
+    netnsFd = get_netns_fd(container->pid);
+    if (netnsFd < 0) {
+        VLOG_ERROR("containerv[host]", "__setup_container_network: failed to get netns fd\n");
+        goto cleanup;
+    }
+
+    batch = malloc(sizeof(struct nl_batch));
+    if (batch == NULL) {
+        close(netnsFd);
+        goto cleanup;
+    }
+
+    // Pooled pairs are renamed while still down, the container and the statistics
+    // expect the names derived from the container id
+    nl_batch_init(batch);
+    status = 0;
+    if (pooled) {
+        status = nl_batch_link_rename(batch, peerIndex, containerVeth);
+        if (!status) {
+            status = nl_batch_link_rename(batch, hostIndex, hostVeth);
+        }
+    }
+    if (!status) {
+        status = nl_batch_link_netns(batch, peerIndex, netnsFd);
+    }
+    if (!status && options->network.host_ip) {
+        status = nl_batch_addr_add(batch, hostIndex, options->network.host_ip, options->network.container_netmask);
+        if (!status) {
+            status = nl_batch_link_up(batch, hostIndex);
+        }
+    }
+    if (!status) {
+        status = nl_batch_send(sockFd, batch);
+    }
+    free(batch);
+    close(netnsFd);
+
+cleanup:
+    if (status && hostIndex >= 0) {
+        struct nl_batch* cleanup = malloc(sizeof(struct nl_batch));
+        if (cleanup != NULL) {
+            // deleting the host end removes the peer as well, wherever it is
+            nl_batch_init(cleanup);
+            nl_batch_link_delete(cleanup, hostIndex);
+            (void)nl_batch_send(sockFd, cleanup);
+            free(cleanup);
+        }
+    }
+    close(sockFd);
+    return status;
+}
+
 static uid_t __real_user(void)
 {
     uid_t euid, suid, ruid;
@@ -1038,6 +1207,13 @@ int containerv_create(
     }
     
     container->layers = options->layers;
+
+    // Compile the seccomp filter before forking, identical policies share the
+    // compiled program so only the first container pays for the compilation
+    if (options->policy != NULL) {
+        container->seccomp_program = policy_seccomp_compile(options->policy);
+    }
+
     container->pid = fork();
     if (container->pid == (pid_t)-1) {
         VLOG_ERROR("containerv[host]", "containerv_create: failed to fork container process\n");
@@ -1095,61 +1271,10 @@ int containerv_create(
                     break;
 
                 case CV_CONTAINER_WAITING_FOR_NETWORK_SETUP: {
-                    char host_veth[16];
-                    char container_veth[16];
-                    int netns_fd;
-                    int sock_fd;
-                    
-                    // Create unique veth pair names from container ID
-                    // Host side uses full ID, container side uses partial ID for brevity
-                    snprintf(host_veth, sizeof(host_veth), "veth%s", &container->id[__CONTAINER_VETH_HOST_OFFSET]);
-                    snprintf(container_veth, sizeof(container_veth), "veth%sc", &container->id[__CONTAINER_VETH_CONT_OFFSET]);
-                    
                     VLOG_DEBUG("containerv[host]", "setting up network for %s\n", container->hostname);
-                    
-                    // Create netlink socket
-                    sock_fd = create_socket(AF_NETLINK, SOCK_RAW, NETLINK_ROUTE);
-                    if (sock_fd < 0) {
-                        VLOG_ERROR("containerv[host]", "containerv_create: failed to create netlink socket\n");
-                        status = -1;
-                    }
-                    
-                    // Create veth pair
-                    if (!status) {
-                        status = create_veth(sock_fd, host_veth, container_veth);
-                        if (status) {
-                            VLOG_ERROR("containerv[host]", "containerv_create: failed to create veth pair\n");
-                        }
-                    }
-                    
-                    // Get container's network namespace
-                    if (!status) {
-                        netns_fd = get_netns_fd(container->pid);
-                        if (netns_fd < 0) {
-                            VLOG_ERROR("containerv[host]", "containerv_create: failed to get netns fd\n");
-                            status = -1;
-                        }
-                    }
-                    
-                    // Move container veth to container namespace
-                    if (!status) {
-                        status = move_if_to_pid_netns(sock_fd, container_veth, netns_fd);
-                        if (status) {
-                            VLOG_ERROR("containerv[host]", "containerv_create: failed to move veth to container namespace\n");
-                        }
-                        close(netns_fd);
-                    }
-                    
-                    // Bring up host side veth interface
-                    if (!status && options->network.host_ip) {
-                        status = if_up(host_veth, (char*)options->network.host_ip, (char*)options->network.container_netmask);
-                        if (status) {
-                            VLOG_ERROR("containerv[host]", "containerv_create: failed to bring up host veth interface\n");
-                        }
-                    }
-                    
-                    if (sock_fd >= 0) {
-                        close(sock_fd);
+                    status = __setup_container_network(container, options);
+                    if (status) {
+                        VLOG_ERROR("containerv[host]", "containerv_create: failed to setup network\n");
                     }
                     
                     __send_container_event(container->host, CV_CONTAINER_WAITING_FOR_NETWORK_SETUP, status);
@@ -1186,6 +1311,10 @@ int containerv_create(
                 } break;
             }
         }
+
+        // the stats files are opened here, while the container is not yet visible
+        // to other threads, so sampling never has to open them concurrently
+        containerv_open_stats(container);
         *containerOut = container;
         return 0;
     }
@@ -20,6 +20,7 @@
 #include <chef/environment.h>
 #include <chef/containerv-user-linux.h>
 #include "private.h"
+#include <errno.h>
 #include <libgen.h> // dirname
 #include <fcntl.h> // O_*
 #include <stdio.h>
@@ -245,7 +246,7 @@ static int __receive_command_maybe_fds(int socket, struct sockaddr_un* from, int
     return 0;
 }
 
-static int __spawn(struct containerv_container* container, struct __socket_command* command, void* payload, pid_t* pidOut)
+static int __spawn(struct containerv_container* container, struct __socket_command* command, void* payload, int* streams, pid_t* pidOut)
 {
     char*  data = payload;
     char*  path;
@@ -283,7 +284,8 @@ static int __spawn(struct containerv_container* container, struct __socket_comma
             .envv = (const char* const*)envv,
             .uid = command->data.spawn.asUid,
             .gid = command->data.spawn.asGid,
-            .flags = command->data.spawn.flags
+            .flags = command->data.spawn.flags,
+            .streams = streams
         },
         pidOut
     );
@@ -301,8 +303,10 @@ static void __handle_spawn_command(struct containerv_container* container, struc
         .data.spawn = { 0 }
     };
 
-    char*  payload;
+    char*  payload = NULL;
     size_t payloadLength;
+    int    streams[3] = { -1, -1, -1 };
+    int    streamCount = 0;
     int    status;
     VLOG_DEBUG("containerv[child]", "__handle_spawn_command()\n");
 
@@ -327,11 +331,21 @@ static void __handle_spawn_command(struct containerv_container* container, struc
         goto respond;
     }
 
-    response.data.spawn.status = __spawn(container, command, payload, &response.data.spawn.process_id);
+    response.data.spawn.status = __spawn(container, command, payload, &streams[0], &response.data.spawn.process_id);
+    if (response.data.spawn.status == 0 && (command->data.spawn.flags & CV_SPAWN_STREAM)) {
+        streamCount = 3;
+    }
+
 respond:
-    if (__send_command_maybe_fds(container->socket_fd, from, NULL, 0, &response, sizeof(struct __socket_response))) {
+    if (__send_command_maybe_fds(container->socket_fd, from, &streams[0], streamCount, &response, sizeof(struct __socket_response))) {
         VLOG_ERROR("containerv[child]", "__handle_spawn_command: failed to send response\n");
     }
+
+    // the host has its own copies of the stream descriptors now, if sending failed
+    // the process gets EPIPE on output and the exit status goes nowhere
+    for (int i = 0; i < streamCount; i++) {
+        close(streams[i]);
+    }
     free(payload);
 }
 
@@ -635,8 +649,11 @@ struct containerv_socket_client* containerv_socket_client_open(const char* conta
     snprintf(&namesock.sun_path[0], sizeof(namesock.sun_path), __CONTAINER_SOCKET_RUNTIME_BASE "/%s/control", containerId);
     status = connect(client->socket_fd, (struct sockaddr*)&namesock, sizeof(struct sockaddr_un));
     if (status) {
+        // keep the reason, ENOENT tells the caller the container is not running
+        int error = errno;
         VLOG_ERROR("containerv", "__open_unix_socket: failed to connect to %s\n", &namesock.sun_path[0]);
         containerv_socket_client_close(client);
+        errno = error;
         return NULL;
     }
     return client;
@@ -675,9 +692,15 @@ int containerv_socket_client_spawn(
     char*  flatEnvironment = NULL;
     char*  data;
     int    dataIndex = 0;
+    int    streams[__CONTAINER_MAX_FD_COUNT];
     int    status;
     VLOG_DEBUG("containerv", "containerv_socket_client_spawn(path=%s, args=%s)\n", path, options->arguments);
 
+    if ((options->flags & CV_SPAWN_STREAM) && (options->streams == NULL || (options->flags & CV_SPAWN_WAIT))) {
+        errno = EINVAL;
+        return -1;
+    }
+
     // consider length of args and env
     dataLength += strlen(path) + 1;
     dataLength += (options->arguments != NULL) ? (strlen(options->arguments) + 1) : 0;
@@ -733,12 +756,28 @@ int containerv_socket_client_spawn(
     }
     free(data);
 
-    status = __receive_command_maybe_fds(client->socket_fd, NULL, NULL, &rsp, sizeof(struct __socket_response));
+    status = __receive_command_maybe_fds(client->socket_fd, NULL, &streams[0], &rsp, sizeof(struct __socket_response));
     if (status < 0) {
         VLOG_ERROR("containerv", "containerv_spawn: failed to receive spawn response\n");
         return status;
     }
 
+    if (options->flags & CV_SPAWN_STREAM) {
+        if (rsp.data.spawn.status == 0 && status != 3) {
+            VLOG_ERROR("containerv", "containerv_spawn: expected 3 stream descriptors, got %i\n", status);
+            rsp.data.spawn.status = -1;
+            errno = EPROTO;
+        } else if (rsp.data.spawn.status == 0) {
+            options->streams->stdout_fd = streams[0];
+            options->streams->stderr_fd = streams[1];
+            options->streams->exit_fd = streams[2];
+            status = 0;
+        }
+    }
+    for (int i = 0; i < status; i++) {
+        close(streams[i]);
+    }
+
     if (pidOut != NULL) {
         *pidOut = rsp.data.spawn.process_id;
     }
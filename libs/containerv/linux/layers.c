@@ -35,6 +35,14 @@
 #include <vafs/directory.h>
 #include <vafs/stat.h>
 #include <vlog.h>
+#include <zstd.h>
+
+struct VaFsFeatureFilter {
+    struct VaFsFeatureHeader Header;
+};
+
+static struct VaFsGuid g_filterGuid    = VA_FS_FEATURE_FILTER;
+static struct VaFsGuid g_filterOpsGuid = VA_FS_FEATURE_FILTER_OPS;
 
 /**
  * @brief VaFS FUSE mount handle
@@ -55,6 +63,8 @@ struct __mounted_layer {
     char*                      source_path;   // Original source
     int                        readonly;      // For HOST_DIRECTORY layers
     void*                      handle;        // Mount handle (e.g., __vafs_mount*)
+    char*                      target;        // For VAFS_PACKAGE layers not mounted at the root
+    char*                      overlay_path;  // Sub-directory overlay owned by this layer
 };
 
 /**
@@ -82,7 +92,9 @@ static int __vafs_getattr(const char* path, struct stat* stbuf, struct fuse_file
     struct vafs_stat     vstat;
     int                  status;
     
-    status = vafs_path_stat(mount->vafs, path, 1, &vstat);
+    // Don't follow symlinks, they must be reported as links so FUSE
+    // resolves them through __vafs_readlink
+    status = vafs_path_stat(mount->vafs, path, 0, &vstat);
     if (status) {
         return status;
     }
@@ -97,6 +109,43 @@ static int __vafs_getattr(const char* path, struct stat* stbuf, struct fuse_file
     return 0;
 }
 
+static int __vafs_readlink(const char* path, char* buf, size_t size)
+{
+    struct fuse_context*        context = fuse_get_context();
+    struct __vafs_mount*        mount   = (struct __vafs_mount*)context->private_data;
+    struct VaFsDirectoryHandle* handle;
+    const char*                 target;
+    char                        parent[PATH_MAX];
+    char*                       name;
+    int                         status;
+
+    if (size == 0) {
+        return -EINVAL;
+    }
+
+    snprintf(&parent[0], sizeof(parent), "%s", path);
+    name = strrchr(&parent[0], '/');
+    if (name == NULL) {
+        return -ENOENT;
+    }
+    *name++ = '\0';
+
+    status = vafs_directory_open(mount->vafs, parent[0] == '\0' ? "/" : &parent[0], &handle);
+    if (status) {
+        return -ENOENT;
+    }
+
+    status = vafs_directory_read_symlink(handle, name, &target);
+    if (status) {
+        vafs_directory_close(handle);
+        return -EINVAL;
+    }
+
+    snprintf(buf, size, "%s", target);
+    vafs_directory_close(handle);
+    return 0;
+}
+
 static int __vafs_open(const char* path, struct fuse_file_info* fi)
 {
     struct fuse_context*   context = fuse_get_context();
@@ -188,6 +237,7 @@ static int __vafs_releasedir(const char* path, struct fuse_file_info* fi)
 
 static const struct fuse_operations g_vafs_operations = {
     .getattr    = __vafs_getattr,
+    .readlink   = __vafs_readlink,
     .open       = __vafs_open,
     .read       = __vafs_read,
     .release    = __vafs_release,
@@ -202,6 +252,44 @@ static int __fuse_loop_wrapper(void* arg)
     return fuse_loop(fuse);
 }
 
+static int __zstd_decode(void* Input, uint32_t InputLength, void* Output, uint32_t* OutputLength)
+{
+    size_t             decompressedSize;
+    unsigned long long contentSize = ZSTD_getFrameContentSize(Input, InputLength);
+    if (contentSize == ZSTD_CONTENTSIZE_ERROR || contentSize == ZSTD_CONTENTSIZE_UNKNOWN) {
+        VLOG_ERROR("containerv", "__zstd_decode: failed to get frame content size\n");
+        return -1;
+    }
+
+    decompressedSize = ZSTD_decompress(Output, *OutputLength, Input, InputLength);
+    if (ZSTD_isError(decompressedSize)) {
+        return -1;
+    }
+    *OutputLength = (uint32_t)decompressedSize;
+    return 0;
+}
+
+// Packages are usually built with compression enabled, and those can
+// only be read when the decode filter has been installed.
+static int __vafs_handle_filter(struct VaFs* vafs)
+{
+    struct VaFsFeatureFilter*   filter;
+    struct VaFsFeatureFilterOps filterOps;
+    int                         status;
+
+    status = vafs_feature_query(vafs, &g_filterGuid, (struct VaFsFeatureHeader**)&filter);
+    if (status) {
+        // no filter present
+        return 0;
+    }
+
+    memcpy(&filterOps.Header.Guid, &g_filterOpsGuid, sizeof(struct VaFsGuid));
+    filterOps.Header.Length = sizeof(struct VaFsFeatureFilterOps);
+    filterOps.Encode = NULL;
+    filterOps.Decode = __zstd_decode;
+    return vafs_feature_add(vafs, &filterOps.Header);
+}
+
 static int __vafs_mount(const char* pack_path, const char* mount_point, struct __vafs_mount** mount_out)
 {
     struct __vafs_mount* mount;
@@ -228,6 +316,15 @@ static int __vafs_mount(const char* pack_path, const char* mount_point, struct _
         free(mount);
         return -1;
     }
+
+    status = __vafs_handle_filter(mount->vafs);
+    if (status != 0) {
+        VLOG_ERROR("containerv", "__vafs_mount: failed to install VaFS filter\n");
+        vafs_close(mount->vafs);
+        free(mount->mount_point);
+        free(mount);
+        return -1;
+    }
     
     mount->fuse = fuse_new(&args, &g_vafs_operations, sizeof(g_vafs_operations), mount);
     if (mount->fuse == NULL) {
@@ -305,6 +402,8 @@ static void __containerv_layer_context_delete(struct containerv_layer_context* c
         struct __mounted_layer* layer = &context->layers[i];
         free(layer->mount_point);
         free(layer->source_path);
+        free(layer->target);
+        free(layer->overlay_path);
     }
     
     free(context->layers);
@@ -403,6 +502,9 @@ static int __setup_base_rootfs(
     return 0;
 }
 
+// Overlayfs treats the first lowerdir as the topmost layer, so the list is built
+// in reverse to let layers that are provided later take precedence over the earlier
+// ones (i.e. a package layer on top of the base rootfs).
 static char* __build_overlay_layer_list(
     struct containerv_layer_context* context,
     enum containerv_layer_type       skipType1,
@@ -411,13 +513,18 @@ static char* __build_overlay_layer_list(
     char*  dirs = NULL;
     size_t dirsLength = 0;
 
-    for (int i = 0; i < context->layer_count; i++) {
+    for (int i = context->layer_count - 1; i >= 0; i--) {
         const char* layerPath;
         size_t      pathLength;
 
         if (context->layers[i].type == skipType1 || context->layers[i].type == skipType2) {
             continue;
         }
+
+        // layers targeting a sub-directory are composed separately
+        if (context->layers[i].target != NULL) {
+            continue;
+        }
         
         layerPath = context->layers[i].mount_point;
         pathLength = strlen(layerPath);
@@ -504,6 +611,157 @@ cleanup:
     return status;
 }
 
+// Creates a stable directory name for a container path, so the writable
+// contents of a sub-directory overlay survive between runs even if the
+// layers providing it are reordered.
+static char* __create_subdir_layer_dir(const char* container_id, const char* target, const char* subdir)
+{
+    char   name[PATH_MAX];
+    char   tmp[PATH_MAX];
+    size_t length = 0;
+
+    // i.e /chef/build/linux/amd64 => chef-build-linux-amd64
+    for (const char* p = target; *p != '\0' && length < sizeof(name) - 1; p++) {
+        if (*p != '/') {
+            name[length++] = *p;
+        } else if (length > 0 && name[length - 1] != '-') {
+            name[length++] = '-';
+        }
+    }
+    name[length] = '\0';
+
+    snprintf(tmp, sizeof(tmp), "subdirs/%s/%s", &name[0], subdir);
+    return __create_layer_dir(container_id, tmp);
+}
+
+// Builds the lowerdir list for all VAFS layers mounted at the same target. The
+// existing contents of the target are kept as the bottom-most layer.
+static char* __build_subdir_layer_list(
+    struct containerv_layer_context* context,
+    const char*                      target,
+    const char*                      destination)
+{
+    char*  dirs;
+    size_t dirsLength = strlen(destination) + 1;
+
+    for (int i = 0; i < context->layer_count; i++) {
+        struct __mounted_layer* ml = &context->layers[i];
+        if (ml->target != NULL && strcmp(ml->target, target) == 0) {
+            dirsLength += strlen(ml->mount_point) + 1;
+        }
+    }
+
+    dirs = calloc(dirsLength, 1);
+    if (dirs == NULL) {
+        return NULL;
+    }
+
+    for (int i = context->layer_count - 1; i >= 0; i--) {
+        struct __mounted_layer* ml = &context->layers[i];
+        if (ml->target != NULL && strcmp(ml->target, target) == 0) {
+            strcat(dirs, ml->mount_point);
+            strcat(dirs, ":");
+        }
+    }
+    strcat(dirs, destination);
+    return dirs;
+}
+
+static int __create_subdir_overlay(struct containerv_layer_context* context, struct __mounted_layer* owner)
+{
+    char*  destination;
+    char*  lowerDirs = NULL;
+    char*  upperDir = NULL;
+    char*  workDir = NULL;
+    char*  options = NULL;
+    size_t optSize;
+    int    status = -1;
+
+    destination = strpathcombine(context->composed_rootfs, owner->target);
+    if (destination == NULL) {
+        return -1;
+    }
+
+    if (platform_mkdir(destination) != 0 && errno != EEXIST) {
+        VLOG_ERROR("containerv", "__create_subdir_overlay: failed to create %s\n", destination);
+        goto cleanup;
+    }
+
+    lowerDirs = __build_subdir_layer_list(context, owner->target, destination);
+    if (lowerDirs == NULL) {
+        goto cleanup;
+    }
+
+    if (context->readonly == 0) {
+        upperDir = __create_subdir_layer_dir(context->container_id, owner->target, "contents");
+        workDir = __create_subdir_layer_dir(context->container_id, owner->target, "workspace");
+        if (upperDir == NULL || workDir == NULL) {
+            goto cleanup;
+        }
+
+        optSize = strlen("lowerdir=") + strlen(lowerDirs) + 
+                  strlen(",upperdir=") + strlen(upperDir) +
+                  strlen(",workdir=") + strlen(workDir) + 1;
+        options = malloc(optSize);
+        if (options == NULL) {
+            goto cleanup;
+        }
+        snprintf(options, optSize, "lowerdir=%s,upperdir=%s,workdir=%s", lowerDirs, upperDir, workDir);
+    } else {
+        optSize = strlen("lowerdir=") + strlen(lowerDirs) + 1;
+        options = malloc(optSize);
+        if (options == NULL) {
+            goto cleanup;
+        }
+        snprintf(options, optSize, "lowerdir=%s", lowerDirs);
+    }
+
+    VLOG_DEBUG("containerv", "__create_subdir_overlay: target=%s, options=%s\n", destination, options);
+    status = mount("overlay", destination, "overlay", 0, options);
+    if (status) {
+        VLOG_ERROR("containerv", "__create_subdir_overlay: mount failed for %s: %s\n", destination, strerror(errno));
+        goto cleanup;
+    }
+
+    owner->overlay_path = destination;
+    destination = NULL;
+
+cleanup:
+    free(options);
+    free(workDir);
+    free(upperDir);
+    free(lowerDirs);
+    free(destination);
+    return status;
+}
+
+// VAFS layers with a target are stacked onto that directory of the composed
+// rootfs instead of the root. All layers sharing a target are combined into
+// a single overlay, which is owned by the first of them.
+static int __create_subdir_overlays(struct containerv_layer_context* context)
+{
+    for (int i = 0; i < context->layer_count; i++) {
+        struct __mounted_layer* ml = &context->layers[i];
+        int                     owner = 1;
+
+        if (ml->target == NULL) {
+            continue;
+        }
+
+        for (int j = 0; j < i; j++) {
+            if (context->layers[j].target != NULL && strcmp(context->layers[j].target, ml->target) == 0) {
+                owner = 0;
+                break;
+            }
+        }
+
+        if (owner && __create_subdir_overlay(context, ml)) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
 // ============================================================================
 // Public API
 // ============================================================================
@@ -551,6 +809,14 @@ int containerv_layers_mount_in_namespace(struct containerv_layer_context* contex
         }
     }
 
+    // 2b) Stack VAFS layers that target a sub-directory on top of the
+    //     composed rootfs
+    status = __create_subdir_overlays(context);
+    if (status != 0) {
+        VLOG_ERROR("containerv", "containerv_layers_mount_in_namespace: sub-directory overlay mount failed\n");
+        return -1;
+    }
+
     // 3) Bind-mount any HOST_DIRECTORY layers into the composed rootfs.
     //    At this point, either:
     //      - composed_rootfs is the overlay mountpoint (multi-layer), or
@@ -622,13 +888,20 @@ static int __process_context_layers(struct containerv_layer_context* context, st
                 break;
 
             case CONTAINERV_LAYER_VAFS_PACKAGE:
-                // Plan the VaFS mount point, but don't call __vafs_mount yet.
+                // Plan the VaFS mount point, but don't call __vafs_mount yet. Packages
+                // with a target other than the root are stacked onto that directory.
                 mounted_layer->type = layers[i].type;
                 mounted_layer->source_path = layers[i].source ? strdup(layers[i].source) : NULL;
                 mounted_layer->mount_point = __create_vafs_mount_point(context->container_id, i);
                 if (mounted_layer->mount_point == NULL) {
                     status = -1;
                 }
+                if (layers[i].target != NULL && strcmp(layers[i].target, "/") != 0) {
+                    mounted_layer->target = strdup(layers[i].target);
+                    if (mounted_layer->target == NULL) {
+                        status = -1;
+                    }
+                }
                 break;
 
             case CONTAINERV_LAYER_HOST_DIRECTORY:
@@ -783,6 +1056,14 @@ void containerv_layers_destroy(struct containerv_layer_context* context)
     VLOG_DEBUG("containerv", "containerv_layers_destroy: cleaning up %d layers\n", 
                context->layer_count);
 
+    // Unmount sub-directory overlays before the overlay they are stacked on
+    for (int i = 0; i < context->layer_count; i++) {
+        struct __mounted_layer* layer = &context->layers[i];
+        if (layer->overlay_path != NULL) {
+            umount2(layer->overlay_path, MNT_DETACH);
+        }
+    }
+
     // Unmount overlay if it exists
     if (context->overlay_mounted && context->composed_rootfs != NULL) {
         umount2(context->composed_rootfs, MNT_DETACH);
@@ -19,6 +19,7 @@
 #include "private.h"
 
 #include <errno.h>
+#include <fcntl.h>
 #include <linux/limits.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -40,30 +41,28 @@ static uint64_t __now_realtime_ns(void)
     return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
 }
 
-static int __read_file_to_string(const char* path, char* buffer, size_t buffer_len)
+static int __read_fd_to_string(int fd, char* buffer, size_t buffer_len)
 {
-    FILE* f;
-    size_t n;
+    ssize_t n;
 
-    if (!path || !buffer || buffer_len == 0) {
+    if (fd < 0 || !buffer || buffer_len == 0) {
         errno = EINVAL;
         return -1;
     }
 
-    f = fopen(path, "rb");
-    if (!f) {
+    // cgroupfs and sysfs regenerate the contents on every read from offset 0,
+    // so the descriptor can be kept open and re-read without seeking
+    n = __INTSAFE_CALL(pread(fd, buffer, buffer_len - 1, 0));
+    if (n < 0) {
         return -1;
     }
-
-    n = fread(buffer, 1, buffer_len - 1, f);
     buffer[n] = '\0';
-    fclose(f);
     return 0;
 }
 
-static int __read_file_u64(const char* path, uint64_t* value_out)
+static int __read_fd_u64(int fd, uint64_t* value_out)
 {
-    char buf[256];
+    char buf[64];
     char* endptr;
 
     if (!value_out) {
@@ -71,7 +70,7 @@ static int __read_file_u64(const char* path, uint64_t* value_out)
         return -1;
     }
 
-    if (__read_file_to_string(path, buf, sizeof(buf)) != 0) {
+    if (__read_fd_to_string(fd, buf, sizeof(buf)) != 0) {
         return -1;
     }
 
@@ -84,33 +83,43 @@ static int __read_file_u64(const char* path, uint64_t* value_out)
     return 0;
 }
 
-static void __read_network_stats(const char* container_id,
-                                 uint64_t* rx_bytes, uint64_t* tx_bytes,
-                                 uint64_t* rx_packets, uint64_t* tx_packets)
+static void __open_stats_file(int* fd, const char* base, const char* name)
 {
-    char host_veth[16];
     char path[PATH_MAX];
 
-    *rx_bytes = *tx_bytes = *rx_packets = *tx_packets = 0;
-
-    if (!container_id || strlen(container_id) < 5) {
-        return;
+    snprintf(path, sizeof(path), "%s/%s", base, name);
+    *fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (*fd < 0) {
+        VLOG_DEBUG("containerv[linux]", "__open_stats_file: %s is not available\n", path);
     }
+}
 
-    // Match naming in linux/container.c (host side stays in host netns)
-    snprintf(host_veth, sizeof(host_veth), "veth%s", &container_id[__CONTAINER_VETH_HOST_OFFSET]);
-
-    snprintf(path, sizeof(path), "/sys/class/net/%s/statistics/rx_bytes", host_veth);
-    (void)__read_file_u64(path, rx_bytes);
+void containerv_open_stats(struct containerv_container* container)
+{
+    char base[PATH_MAX];
 
-    snprintf(path, sizeof(path), "/sys/class/net/%s/statistics/tx_bytes", host_veth);
-    (void)__read_file_u64(path, tx_bytes);
+    // Files that fail to open stay at -1 and are reported as zero, this matches
+    // the best-effort behaviour of the stats, and avoids retrying every sample
 
-    snprintf(path, sizeof(path), "/sys/class/net/%s/statistics/rx_packets", host_veth);
-    (void)__read_file_u64(path, rx_packets);
+    // cgroup v2 base directory is created by cgroups_init as /sys/fs/cgroup/<hostname>
+    if (container->hostname && container->hostname[0]) {
+        snprintf(base, sizeof(base), "/sys/fs/cgroup/%s", container->hostname);
+        __open_stats_file(&container->stats_fds[CV_STATS_CPU], base, "cpu.stat");
+        __open_stats_file(&container->stats_fds[CV_STATS_MEMORY_CURRENT], base, "memory.current");
+        __open_stats_file(&container->stats_fds[CV_STATS_MEMORY_PEAK], base, "memory.peak");
+        __open_stats_file(&container->stats_fds[CV_STATS_IO], base, "io.stat");
+        __open_stats_file(&container->stats_fds[CV_STATS_PIDS], base, "pids.current");
+    }
 
-    snprintf(path, sizeof(path), "/sys/class/net/%s/statistics/tx_packets", host_veth);
-    (void)__read_file_u64(path, tx_packets);
+    // Match naming in linux/container.c (host side stays in host netns)
+    if (container->id && strlen(container->id) >= 5) {
+        snprintf(base, sizeof(base), "/sys/class/net/veth%s/statistics",
+                 &container->id[__CONTAINER_VETH_HOST_OFFSET]);
+        __open_stats_file(&container->stats_fds[CV_STATS_NET_RX_BYTES], base, "rx_bytes");
+        __open_stats_file(&container->stats_fds[CV_STATS_NET_TX_BYTES], base, "tx_bytes");
+        __open_stats_file(&container->stats_fds[CV_STATS_NET_RX_PACKETS], base, "rx_packets");
+        __open_stats_file(&container->stats_fds[CV_STATS_NET_TX_PACKETS], base, "tx_packets");
+    }
 }
 
 static void __parse_cpu_stat(const char* cpu_stat_contents, uint64_t* cpu_time_ns_out)
@@ -205,69 +214,46 @@ static void __parse_io_stat(const char* io_stat_contents,
     }
 }
 
-int containerv_get_stats(struct containerv_container* container, struct containerv_stats* stats)
+static void __sample_container(struct containerv_container* container, uint64_t timestamp, struct containerv_stats* stats)
 {
-    char cgroup_base[PATH_MAX];
-    char path[PATH_MAX];
-
-    if (!container || !stats) {
-        errno = EINVAL;
-        return -1;
-    }
+    char buffer[4096];
 
     memset(stats, 0, sizeof(*stats));
+    stats->timestamp = timestamp;
 
-    stats->timestamp = __now_realtime_ns();
-
-    // cgroup v2 base directory is created by cgroups_init as /sys/fs/cgroup/<hostname>
-    if (container->hostname && container->hostname[0]) {
-        snprintf(cgroup_base, sizeof(cgroup_base), "/sys/fs/cgroup/%s", container->hostname);
-
-        // CPU
-        {
-            char cpu_buf[1024];
-            snprintf(path, sizeof(path), "%s/cpu.stat", cgroup_base);
-            if (__read_file_to_string(path, cpu_buf, sizeof(cpu_buf)) == 0) {
-                __parse_cpu_stat(cpu_buf, &stats->cpu_time_ns);
-            }
-        }
-
-        // Memory
-        snprintf(path, sizeof(path), "%s/memory.current", cgroup_base);
-        (void)__read_file_u64(path, &stats->memory_usage);
+    // CPU
+    if (__read_fd_to_string(container->stats_fds[CV_STATS_CPU], buffer, sizeof(buffer)) == 0) {
+        __parse_cpu_stat(buffer, &stats->cpu_time_ns);
+    }
 
-        snprintf(path, sizeof(path), "%s/memory.peak", cgroup_base);
-        (void)__read_file_u64(path, &stats->memory_peak);
+    // Memory
+    (void)__read_fd_u64(container->stats_fds[CV_STATS_MEMORY_CURRENT], &stats->memory_usage);
+    (void)__read_fd_u64(container->stats_fds[CV_STATS_MEMORY_PEAK], &stats->memory_peak);
 
-        // I/O
-        {
-            char io_buf[4096];
-            snprintf(path, sizeof(path), "%s/io.stat", cgroup_base);
-            if (__read_file_to_string(path, io_buf, sizeof(io_buf)) == 0) {
-                __parse_io_stat(io_buf, &stats->read_bytes, &stats->write_bytes, &stats->read_ops, &stats->write_ops);
-            }
-        }
+    // I/O
+    if (__read_fd_to_string(container->stats_fds[CV_STATS_IO], buffer, sizeof(buffer)) == 0) {
+        __parse_io_stat(buffer, &stats->read_bytes, &stats->write_bytes, &stats->read_ops, &stats->write_ops);
+    }
 
-        // PIDs
-        {
-            uint64_t pids_current = 0;
-            snprintf(path, sizeof(path), "%s/pids.current", cgroup_base);
-            if (__read_file_u64(path, &pids_current) == 0) {
-                if (pids_current > UINT32_MAX) {
-                    pids_current = UINT32_MAX;
-                }
-                stats->active_processes = (uint32_t)pids_current;
+    // PIDs
+    {
+        uint64_t pids_current = 0;
+        if (__read_fd_u64(container->stats_fds[CV_STATS_PIDS], &pids_current) == 0) {
+            if (pids_current > UINT32_MAX) {
+                pids_current = UINT32_MAX;
             }
+            stats->active_processes = (uint32_t)pids_current;
         }
-
-        // Total processes created is not available directly via cgroup v2.
-        stats->total_processes = 0;
     }
 
+    // Total processes created is not available directly via cgroup v2.
+    stats->total_processes = 0;
+
     // Network (host-side veth interface stats)
-    __read_network_stats(container->id,
-                         &stats->network_rx_bytes, &stats->network_tx_bytes,
-                         &stats->network_rx_packets, &stats->network_tx_packets);
+    (void)__read_fd_u64(container->stats_fds[CV_STATS_NET_RX_BYTES], &stats->network_rx_bytes);
+    (void)__read_fd_u64(container->stats_fds[CV_STATS_NET_TX_BYTES], &stats->network_tx_bytes);
+    (void)__read_fd_u64(container->stats_fds[CV_STATS_NET_RX_PACKETS], &stats->network_rx_packets);
+    (void)__read_fd_u64(container->stats_fds[CV_STATS_NET_TX_PACKETS], &stats->network_tx_packets);
 
     // CPU percentage based on per-container deltas
     if (container->last_stats_timestamp_ns > 0 && stats->timestamp > container->last_stats_timestamp_ns) {
@@ -281,6 +267,16 @@ int containerv_get_stats(struct containerv_container* container, struct containe
 
     container->last_stats_cpu_time_ns = stats->cpu_time_ns;
     container->last_stats_timestamp_ns = stats->timestamp;
+}
+
+int containerv_get_stats(struct containerv_container* container, struct containerv_stats* stats)
+{
+    if (!container || !stats) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    __sample_container(container, __now_realtime_ns(), stats);
 
     VLOG_DEBUG("containerv[linux]", "stats: mem=%llu cpu_ns=%llu pids=%u cpu_pct=%.1f%%\n",
               (unsigned long long)stats->memory_usage,
@@ -291,6 +287,30 @@ int containerv_get_stats(struct containerv_container* container, struct containe
     return 0;
 }
 
+int containerv_get_stats_batch(struct containerv_container** containers, int count, struct containerv_stats* stats)
+{
+    uint64_t timestamp;
+
+    if (!containers || !stats || count < 0) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    // All containers in the batch share one timestamp, which keeps the samples
+    // comparable with each other and saves a clock read per container
+    timestamp = __now_realtime_ns();
+    for (int i = 0; i < count; i++) {
+        if (containers[i] == NULL) {
+            memset(&stats[i], 0, sizeof(struct containerv_stats));
+            continue;
+        }
+        __sample_container(containers[i], timestamp, &stats[i]);
+    }
+
+    VLOG_DEBUG("containerv[linux]", "stats: sampled %i containers\n", count);
+    return 0;
+}
+
 int containerv_get_processes(
     struct containerv_container*    container,
     struct containerv_process_info* processes,
@@ -0,0 +1,300 @@
+/**
+ * Copyright, Philip Meulengracht
+ *
+ * This program is free software : you can redistribute it and / or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation ? , either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ * 
+ */
+
+#include <errno.h>
+#include <chef/containerv.h>
+#include <chef/list.h>
+#include <net/if.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <threads.h>
+#include <unistd.h>
+#include <vlog.h>
+
+#include "network.h"
+#include "private.h"
+
+// Pool interfaces are recognized by their prefix, so pairs left behind by a
+// previous instance can be removed again
+#define __POOL_PREFIX "cvp"
+
+struct __pooled_pair {
+    struct list_item list_header;
+    int              host_index;
+    int              peer_index;
+};
+
+struct __network_pool {
+    struct list  pairs;
+    int          size;
+    int          running;
+    unsigned int next_id;
+    mtx_t        lock;
+    cnd_t        signal;
+    thrd_t       thread;
+};
+
+static struct __network_pool* g_pool = NULL;
+
+static int __delete_links(int sockFd, const int* indices, int count)
+{
+    struct nl_batch* batch;
+    int              status = 0;
+
+    batch = malloc(sizeof(struct nl_batch));
+    if (batch == NULL) {
+        return -1;
+    }
+
+    for (int i = 0; i < count;) {
+        nl_batch_init(batch);
+        for (; i < count && nl_batch_link_delete(batch, indices[i]) == 0; i++);
+        if (nl_batch_send(sockFd, batch)) {
+            status = -1;
+        }
+    }
+    free(batch);
+    return status;
+}
+
+static void __remove_stale_pairs(int sockFd)
+{
+    struct if_nameindex* interfaces;
+    int*                 indices;
+    int                  count = 0;
+
+    interfaces = if_nameindex();
+    if (interfaces == NULL) {
+        return;
+    }
+
+    for (struct if_nameindex* i = interfaces; i->if_index != 0; i++) {
+        count++;
+    }
+
+    indices = calloc(count + 1, sizeof(int));
+    if (indices != NULL) {
+        count = 0;
+        for (struct if_nameindex* i = interfaces; i->if_index != 0; i++) {
+            size_t length = strlen(i->if_name);
+
+            // only the host ends, the peer goes with it
+            if (strncmp(i->if_name, __POOL_PREFIX, strlen(__POOL_PREFIX)) == 0 && i->if_name[length - 1] == 'h') {
+                indices[count++] = (int)i->if_index;
+            }
+        }
+
+        if (count > 0) {
+            VLOG_DEBUG("containerv", "network-pool: removing %d stale veth pairs\n", count);
+            __delete_links(sockFd, indices, count);
+        }
+        free(indices);
+    }
+    if_freenameindex(interfaces);
+}
+
+static struct __pooled_pair* __create_pair(struct __network_pool* pool, int sockFd)
+{
+    struct __pooled_pair* pair;
+    char                  hostName[IF_NAMESIZE];
+    char                  peerName[IF_NAMESIZE];
+    unsigned int          id;
+
+    mtx_lock(&pool->lock);
+    id = pool->next_id++;
+    mtx_unlock(&pool->lock);
+
+    snprintf(&hostName[0], sizeof(hostName), __POOL_PREFIX "%05x%04xh", (unsigned int)getpid() & 0xFFFFF, id & 0xFFFF);
+    snprintf(&peerName[0], sizeof(peerName), __POOL_PREFIX "%05x%04xc", (unsigned int)getpid() & 0xFFFFF, id & 0xFFFF);
+
+    pair = calloc(1, sizeof(struct __pooled_pair));
+    if (pair == NULL) {
+        return NULL;
+    }
+
+    if (create_veth(sockFd, &hostName[0], &peerName[0])) {
+        VLOG_ERROR("containerv", "network-pool: failed to create veth pair %s\n", &hostName[0]);
+        free(pair);
+        return NULL;
+    }
+
+    pair->host_index = if_index(&hostName[0]);
+    pair->peer_index = if_index(&peerName[0]);
+    if (pair->host_index < 0 || pair->peer_index < 0) {
+        if (pair->host_index >= 0) {
+            __delete_links(sockFd, &pair->host_index, 1);
+        }
+        free(pair);
+        return NULL;
+    }
+    return pair;
+}
+
+static int __pool_worker(void* context)
+{
+    struct __network_pool* pool = context;
+    int                    sockFd;
+
+    sockFd = create_socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_ROUTE);
+    if (sockFd < 0) {
+        VLOG_ERROR("containerv", "network-pool: failed to create netlink socket, pool is disabled\n");
+        return -1;
+    }
+
+    __remove_stale_pairs(sockFd);
+
+    mtx_lock(&pool->lock);
+    while (pool->running) {
+        struct __pooled_pair* pair;
+
+        if (pool->pairs.count >= pool->size) {
+            cnd_wait(&pool->signal, &pool->lock);
+            continue;
+        }
+
+        // create the pair without holding the lock, so containers
+        // can claim pairs meanwhile
+        mtx_unlock(&pool->lock);
+        pair = __create_pair(pool, sockFd);
+        mtx_lock(&pool->lock);
+        if (pair == NULL) {
+            // don't spin on a persistent failure, creation falls back
+            // to creating pairs on demand
+            struct timespec retry;
+            timespec_get(&retry, TIME_UTC);
+            retry.tv_sec += 5;
+            cnd_timedwait(&pool->signal, &pool->lock, &retry);
+            continue;
+        }
+        list_add(&pool->pairs, &pair->list_header);
+    }
+    mtx_unlock(&pool->lock);
+
+    close(sockFd);
+    return 0;
+}
+
+int containerv_network_pool_initialize(int size)
+{
+    struct __network_pool* pool;
+
+    if (size < 0) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (size == 0 || g_pool != NULL) {
+        return 0;
+    }
+
+    pool = calloc(1, sizeof(struct __network_pool));
+    if (pool == NULL) {
+        return -1;
+    }
+
+    list_init(&pool->pairs);
+    pool->size = size;
+    pool->running = 1;
+    mtx_init(&pool->lock, mtx_plain);
+    cnd_init(&pool->signal);
+
+    if (thrd_create(&pool->thread, __pool_worker, pool) != thrd_success) {
+        VLOG_ERROR("containerv", "containerv_network_pool_initialize: failed to start pool worker\n");
+        mtx_destroy(&pool->lock);
+        cnd_destroy(&pool->signal);
+        free(pool);
+        return -1;
+    }
+
+    VLOG_DEBUG("containerv", "containerv_network_pool_initialize: keeping %d veth pairs ready\n", size);
+    g_pool = pool;
+    return 0;
+}
+
+void containerv_network_pool_cleanup(void)
+{
+    struct __network_pool* pool = g_pool;
+    struct list_item*      i;
+    int*                   indices;
+    int                    count = 0;
+    int                    sockFd;
+
+    if (pool == NULL) {
+        return;
+    }
+    g_pool = NULL;
+
+    mtx_lock(&pool->lock);
+    pool->running = 0;
+    cnd_signal(&pool->signal);
+    mtx_unlock(&pool->lock);
+    thrd_join(pool->thread, NULL);
+
+    // remove the pairs that were never claimed
+    indices = calloc(pool->pairs.count + 1, sizeof(int));
+    if (indices != NULL) {
+        list_foreach(&pool->pairs, i) {
+            indices[count++] = ((struct __pooled_pair*)i)->host_index;
+        }
+
+        sockFd = create_socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_ROUTE);
+        if (sockFd >= 0) {
+            __delete_links(sockFd, indices, count);
+            close(sockFd);
+        }
+        free(indices);
+    }
+
+    list_destroy(&pool->pairs, free);
+    mtx_destroy(&pool->lock);
+    cnd_destroy(&pool->signal);
+    free(pool);
+}
+
+int containerv_network_pool_acquire(int* hostIndexOut, int* peerIndexOut)
+{
+    struct __network_pool* pool = g_pool;
+    struct __pooled_pair*  pair = NULL;
+
+    if (pool == NULL) {
+        errno = ENOENT;
+        return -1;
+    }
+
+    mtx_lock(&pool->lock);
+    if (pool->pairs.head != NULL) {
+        pair = (struct __pooled_pair*)pool->pairs.head;
+        list_remove(&pool->pairs, &pair->list_header);
+        
+        // wake up the worker to replace it
+        cnd_signal(&pool->signal);
+    }
+    mtx_unlock(&pool->lock);
+
+    if (pair == NULL) {
+        VLOG_DEBUG("containerv", "containerv_network_pool_acquire: pool is empty\n");
+        errno = ENOENT;
+        return -1;
+    }
+
+    *hostIndexOut = pair->host_index;
+    *peerIndexOut = pair->peer_index;
+    free(pair);
+    return 0;
+}
@@ -303,3 +303,295 @@ int move_if_to_pid_netns(int sock_fd, char *ifname, int netns)
     }
     return send_nlmsg(sock_fd, &req.n);
 }
+
+int if_index(const char *ifname)
+{
+    unsigned int index = if_nametoindex(ifname);
+    if (index == 0) {
+        VLOG_ERROR("containerv", "network: cannot find interface %s: %s\n", ifname, strerror(errno));
+        return -1;
+    }
+    return (int)index;
+}
+
+static int netmask_to_prefix(const char *netmask)
+{
+    struct in_addr mask;
+    char *endptr;
+    long prefix;
+    int bits = 0;
+
+    // accept both prefix lengths ("24") and dotted masks ("255.255.255.0")
+    prefix = strtol(netmask, &endptr, 10);
+    if (*endptr == '\0') {
+        return (prefix >= 0 && prefix <= 32) ? (int)prefix : -1;
+    }
+
+    if (inet_pton(AF_INET, netmask, &mask) != 1) {
+        return -1;
+    }
+    for (uint32_t value = ntohl(mask.s_addr); value & 0x80000000U; value <<= 1) {
+        bits++;
+    }
+    return bits;
+}
+
+void nl_batch_init(struct nl_batch *b)
+{
+    memset(b, 0, sizeof(*b));
+}
+
+static struct nlmsghdr *nl_batch_begin(
+        struct nl_batch *b, __u16 type, __u16 flags, int payload_len)
+{
+    struct nlmsghdr *n;
+    int offset = NLMSG_ALIGN(b->len);
+
+    if (offset + NLMSG_LENGTH(payload_len) > (int)sizeof(b->buf)) {
+        VLOG_ERROR("containerv", "network: netlink batch is full\n");
+        errno = ENOSPC;
+        return NULL;
+    }
+
+    n = (struct nlmsghdr *)&b->buf[offset];
+    memset(n, 0, NLMSG_LENGTH(payload_len));
+    n->nlmsg_len = NLMSG_LENGTH(payload_len);
+    n->nlmsg_type = type;
+    n->nlmsg_flags = NLM_F_REQUEST | NLM_F_ACK | flags;
+    n->nlmsg_seq = ++b->seq;
+    return n;
+}
+
+static void nl_batch_commit(struct nl_batch *b, struct nlmsghdr *n)
+{
+    b->len = NLMSG_ALIGN(b->len) + n->nlmsg_len;
+    b->count++;
+}
+
+static int nl_batch_space(struct nl_batch *b)
+{
+    return (int)sizeof(b->buf) - NLMSG_ALIGN(b->len);
+}
+
+static struct nlmsghdr *nl_batch_link(struct nl_batch *b, __u16 type, int ifindex)
+{
+    struct nlmsghdr *n = nl_batch_begin(b, type, 0, sizeof(struct ifinfomsg));
+    if (n != NULL) {
+        struct ifinfomsg *ifi = NLMSG_DATA(n);
+        ifi->ifi_family = AF_UNSPEC;
+        ifi->ifi_index = ifindex;
+    }
+    return n;
+}
+
+int nl_batch_link_rename(struct nl_batch *b, int ifindex, const char *name)
+{
+    // ip link set dev <ifindex> name <name>
+    struct nlmsghdr *n = nl_batch_link(b, RTM_NEWLINK, ifindex);
+    if (n == NULL) {
+        return -1;
+    }
+    if (addattr_l(n, nl_batch_space(b), IFLA_IFNAME, name, strlen(name) + 1) != 0) {
+        return -1;
+    }
+    nl_batch_commit(b, n);
+    return 0;
+}
+
+int nl_batch_link_netns(struct nl_batch *b, int ifindex, int netns)
+{
+    // ip link set dev <ifindex> netns <fd>
+    struct nlmsghdr *n = nl_batch_link(b, RTM_NEWLINK, ifindex);
+    if (n == NULL) {
+        return -1;
+    }
+    if (addattr_l(n, nl_batch_space(b), IFLA_NET_NS_FD, &netns, 4) != 0) {
+        return -1;
+    }
+    nl_batch_commit(b, n);
+    return 0;
+}
+
+int nl_batch_link_up(struct nl_batch *b, int ifindex)
+{
+    // ip link set dev <ifindex> up
+    struct nlmsghdr *n = nl_batch_link(b, RTM_NEWLINK, ifindex);
+    struct ifinfomsg *ifi;
+    if (n == NULL) {
+        return -1;
+    }
+    ifi = NLMSG_DATA(n);
+    ifi->ifi_flags = IFF_UP;
+    ifi->ifi_change = IFF_UP;
+    nl_batch_commit(b, n);
+    return 0;
+}
+
+int nl_batch_link_delete(struct nl_batch *b, int ifindex)
+{
+    // ip link del dev <ifindex>
+    struct nlmsghdr *n = nl_batch_link(b, RTM_DELLINK, ifindex);
+    if (n == NULL) {
+        return -1;
+    }
+    nl_batch_commit(b, n);
+    return 0;
+}
+
+int nl_batch_addr_add(struct nl_batch *b, int ifindex, const char *ip, const char *netmask)
+{
+    // ip addr add <ip>/<prefix> brd + dev <ifindex>
+    struct nlmsghdr *n;
+    struct ifaddrmsg *ifa;
+    struct in_addr addr;
+    struct in_addr brd;
+    int prefix;
+
+    if (inet_pton(AF_INET, ip, &addr) != 1) {
+        VLOG_ERROR("containerv", "network: invalid ip address %s\n", ip);
+        errno = EINVAL;
+        return -1;
+    }
+
+    prefix = netmask_to_prefix(netmask);
+    if (prefix < 0) {
+        VLOG_ERROR("containerv", "network: invalid netmask %s\n", netmask);
+        errno = EINVAL;
+        return -1;
+    }
+
+    n = nl_batch_begin(b, RTM_NEWADDR, NLM_F_CREATE | NLM_F_EXCL, sizeof(struct ifaddrmsg));
+    if (n == NULL) {
+        return -1;
+    }
+
+    ifa = NLMSG_DATA(n);
+    ifa->ifa_family = AF_INET;
+    ifa->ifa_prefixlen = (unsigned char)prefix;
+    ifa->ifa_scope = RT_SCOPE_UNIVERSE;
+    ifa->ifa_index = ifindex;
+
+    brd.s_addr = addr.s_addr;
+    if (prefix < 32) {
+        brd.s_addr |= htonl(0xFFFFFFFFU >> prefix);
+    }
+
+    if (addattr_l(n, nl_batch_space(b), IFA_LOCAL, &addr, 4) != 0 ||
+        addattr_l(n, nl_batch_space(b), IFA_ADDRESS, &addr, 4) != 0 ||
+        addattr_l(n, nl_batch_space(b), IFA_BROADCAST, &brd, 4) != 0) {
+        return -1;
+    }
+    nl_batch_commit(b, n);
+    return 0;
+}
+
+int nl_batch_send(int sock_fd, struct nl_batch *b)
+{
+    struct iovec iov = {
+            .iov_base = b->buf,
+            .iov_len = b->len
+    };
+    struct msghdr msg = {
+            .msg_name = NULL,
+            .msg_namelen = 0,
+            .msg_iov = &iov,
+            .msg_iovlen = 1
+    };
+    int pending = b->count;
+    int error = 0;
+    char *resp;
+
+    if (pending == 0) {
+        return 0;
+    }
+
+    // The kernel processes every message in the buffer, even if an earlier
+    // one failed, and acknowledges each of them
+    if (sendmsg(sock_fd, &msg, 0) < 0) {
+        VLOG_ERROR("containerv", "network: cannot talk to rtnetlink: %s\n", strerror(errno));
+        return -1;
+    }
+
+    resp = malloc(MAX_PAYLOAD * 8);
+    if (!resp) {
+        VLOG_ERROR("containerv", "network: failed to allocate response buffer\n");
+        return -1;
+    }
+
+    while (pending > 0) {
+        ssize_t resp_len = recv(sock_fd, resp, MAX_PAYLOAD * 8, 0);
+        if (resp_len <= 0) {
+            if (resp_len < 0 && errno == EINTR) {
+                continue;
+            }
+            VLOG_ERROR("containerv", "network: netlink receive error: %s\n",
+                resp_len < 0 ? strerror(errno) : "EOF");
+            free(resp);
+            return -1;
+        }
+
+        for (struct nlmsghdr *hdr = (struct nlmsghdr *)resp;
+             NLMSG_OK(hdr, resp_len);
+             hdr = NLMSG_NEXT(hdr, resp_len)) {
+            struct nlmsgerr *err;
+
+            if (hdr->nlmsg_type != NLMSG_ERROR) {
+                continue;
+            }
+
+            pending--;
+            err = (struct nlmsgerr *)NLMSG_DATA(hdr);
+            if (err->error && error == 0) {
+                error = -err->error;
+                VLOG_ERROR("containerv", "network: RTNETLINK (message %u of %d): %s\n",
+                    hdr->nlmsg_seq, b->count, strerror(error));
+            }
+        }
+    }
+
+    free(resp);
+    if (error) {
+        errno = error;
+        return -1;
+    }
+    return 0;
+}
+
+int if_configure(const char *ifname, const char *ip, const char *netmask)
+{
+    struct nl_batch *b;
+    int sock_fd;
+    int ifindex;
+    int loindex;
+    int status = -1;
+
+    ifindex = if_index(ifname);
+    loindex = if_index("lo");
+    if (ifindex < 0 || loindex < 0) {
+        return -1;
+    }
+
+    b = malloc(sizeof(struct nl_batch));
+    if (b == NULL) {
+        return -1;
+    }
+
+    sock_fd = create_socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_ROUTE);
+    if (sock_fd < 0) {
+        free(b);
+        return -1;
+    }
+
+    // address and bring up both the interface and the loopback in one transaction
+    nl_batch_init(b);
+    if (nl_batch_addr_add(b, ifindex, ip, netmask) == 0 &&
+        nl_batch_link_up(b, ifindex) == 0 &&
+        nl_batch_addr_add(b, loindex, "127.0.0.1", "8") == 0 &&
+        nl_batch_link_up(b, loindex) == 0) {
+        status = nl_batch_send(sock_fd, b);
+    }
+
+    close(sock_fd);
+    free(b);
+    return status;
+}
@@ -25,6 +25,17 @@ struct nl_req {
     char buf[MAX_PAYLOAD];
 };
 
+// Several rtnetlink requests sent in a single transaction, the kernel
+// acknowledges each of them individually
+#define NL_BATCH_SIZE 4096
+
+struct nl_batch {
+    char  buf[NL_BATCH_SIZE] __attribute__((aligned(NLMSG_ALIGNTO)));
+    int   len;
+    int   count;
+    __u32 seq;
+};
+
 #define NLMSG_TAIL(nmsg) \
 	((struct rtattr *) (((void *) (nmsg)) + NLMSG_ALIGN((nmsg)->nlmsg_len)))
 
@@ -58,4 +69,38 @@ int move_if_to_pid_netns(int sock_fd, char *ifname, int netns);
  */
 int get_netns_fd(int pid);
 
+/**
+ * @brief Get the index of a network interface
+ * @return interface index on success, -1 on failure
+ */
+int if_index(const char *ifname);
+
+/**
+ * @brief Address and bring up a network interface and the loopback interface
+ * in a single rtnetlink transaction
+ * @return 0 on success, -1 on failure
+ */
+int if_configure(const char *ifname, const char *ip, const char *netmask);
+
+/**
+ * @brief Reset a batch before queueing requests in it
+ */
+void nl_batch_init(struct nl_batch *b);
+
+/**
+ * @brief Queue requests in the batch, interfaces are referenced by index
+ * @return 0 on success, -1 if the batch is full or the arguments are invalid
+ */
+int nl_batch_link_rename(struct nl_batch *b, int ifindex, const char *name);
+int nl_batch_link_netns(struct nl_batch *b, int ifindex, int netns);
+int nl_batch_link_up(struct nl_batch *b, int ifindex);
+int nl_batch_link_delete(struct nl_batch *b, int ifindex);
+int nl_batch_addr_add(struct nl_batch *b, int ifindex, const char *ip, const char *netmask);
+
+/**
+ * @brief Send all queued requests in one message and wait for all of them to be acknowledged
+ * @return 0 if all requests succeeded, -1 with errno set to the first failure otherwise
+ */
+int nl_batch_send(int sock_fd, struct nl_batch *b);
+
 #endif //ISOLATE_NETNS_H
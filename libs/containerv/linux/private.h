@@ -75,6 +75,20 @@ struct containerv_options {
     struct containerv_options_cgroup       cgroup;
 };
 
+enum containerv_stats_file {
+    CV_STATS_CPU,
+    CV_STATS_MEMORY_CURRENT,
+    CV_STATS_MEMORY_PEAK,
+    CV_STATS_IO,
+    CV_STATS_PIDS,
+    CV_STATS_NET_RX_BYTES,
+    CV_STATS_NET_TX_BYTES,
+    CV_STATS_NET_RX_PACKETS,
+    CV_STATS_NET_TX_PACKETS,
+
+    CV_STATS_FILE_COUNT
+};
+
 struct containerv_container {
     // host
     pid_t        pid;
@@ -85,6 +99,7 @@ struct containerv_container {
     // stats (host)
     uint64_t last_stats_timestamp_ns;
     uint64_t last_stats_cpu_time_ns;
+    int      stats_fds[CV_STATS_FILE_COUNT]; // opened once the container is up, read with pread
 
     // child
     char*       rootfs;
@@ -94,13 +109,14 @@ struct containerv_container {
     void*       ebpf_context;
 
     // shared
-    const char*                      id;
-    struct containerv_layer_context* layers;
-    int                              host[2];
-    int                              child[2];
-    int                              stdout[2];
-    int                              stderr[2];
-    char*                            runtime_dir;
+    const char*                          id;
+    struct containerv_layer_context*     layers;
+    const struct policy_seccomp_program* seccomp_program; // compiled on host, installed by child
+    int                                  host[2];
+    int                                  child[2];
+    int                                  stdout[2];
+    int                                  stderr[2];
+    char*                                runtime_dir;
 };
 
 #define __INTSAFE_CALL(__expr) \
@@ -187,13 +203,50 @@ struct __containerv_spawn_options {
     uid_t                      uid;
     gid_t                      gid;
     enum container_spawn_flags flags;
+    int*                       streams; // receives stdout, stderr and exit descriptors for CV_SPAWN_STREAM
 };
 
 extern int __containerv_spawn(struct containerv_container* container, struct __containerv_spawn_options* options, pid_t* pidOut);
 extern int __containerv_kill(struct containerv_container* container, pid_t processId);
 extern void __containerv_destroy(struct containerv_container* container);
 
-extern int policy_seccomp_apply(struct containerv_policy* policy);
+/**
+ * @brief Opens the cgroup and network statistics files of the container. Must be called
+ * on the host once the cgroups and network are set up, before the container is shared
+ * with other threads. Files that are not available are reported as zero.
+ */
+extern void containerv_open_stats(struct containerv_container* container);
+
+/**
+ * @brief Claims a veth pair from the network pool. The pair is down and named after the
+ * pool, it must be renamed before use.
+ * @return 0 on success, -1 with errno set to ENOENT if the pool is disabled or empty.
+ */
+extern int containerv_network_pool_acquire(int* hostIndexOut, int* peerIndexOut);
+
+// A seccomp filter compiled to raw BPF, ready to be installed
+struct policy_seccomp_program {
+    struct policy_seccomp_program* next;
+    uint64_t                       hash;
+    void*                          key;        // serialized policy, compared in full on a hash hit
+    size_t                         key_length;
+    unsigned short                 length;
+    struct sock_filter*            filter;
+};
+
+/**
+ * @brief Compiles the seccomp part of the policy into a BPF program, or returns the
+ * already compiled program for an identical policy. Must be called on the host before
+ * the container is forked, the returned program is owned by the cache.
+ * @return The program, or NULL if the policy must be compiled inside the container.
+ */
+extern const struct policy_seccomp_program* policy_seccomp_compile(struct containerv_policy* policy);
+
+/**
+ * @brief Installs the seccomp filter for the calling process. If a precompiled program
+ * is provided it is installed as is, otherwise the policy is compiled first.
+ */
+extern int policy_seccomp_apply(struct containerv_policy* policy, const struct policy_seccomp_program* program);
 
 // imported from ebpf/private.h
 struct bpf_policy_context;
@@ -23,12 +23,21 @@
 #include <chef/platform.h>
 #include <chef/containerv-user-linux.h>
 #include <errno.h>
+#include <linux/filter.h>
+#include <linux/seccomp.h>
 #include <seccomp.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
 #include <sys/prctl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <threads.h>
+#include <unistd.h>
 #include <vlog.h>
 
+#include "private.h"
+
 // import the policy structure details
 #include "../policies/private.h"
 
@@ -338,43 +347,312 @@ cleanup:
 	return status;
 }
 
-int policy_seccomp_apply(struct containerv_policy* policy)
+// The policy can be compiled on the host as long as the user and group references
+// resolve to the same ids inside the container, which is only guaranteed for root.
+static int __policy_is_host_resolvable(struct containerv_policy* policy)
 {
-    scmp_filter_ctx allowContext;
-    int             status = -1;
-    
-    if (policy == NULL) {
-        errno = EINVAL;
-        return -1;
+    for (int i = 0; i < policy->syscall_count; i++) {
+        const char* args = policy->syscalls[i].args;
+        const char* ref;
+
+        if (args == NULL) {
+            continue;
+        }
+
+        for (ref = args; (ref = strstr(ref, ":")) != NULL; ref++) {
+            if (ref == args || (ref[-1] != 'u' && ref[-1] != 'g')) {
+                continue;
+            }
+            if (strncmp(&ref[1], "root", 4) != 0 || (ref[5] != '\0' && ref[5] != ' ')) {
+                return 0;
+            }
+        }
     }
-    
-    VLOG_TRACE("containerv", "policy_seccomp: applying policy with %d allowed syscalls\n",
-              policy->syscall_count);
-    
+    return 1;
+}
+
+static uint64_t __fnv1a64(uint64_t hash, const void* data, size_t length)
+{
+    const unsigned char* bytes = data;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= (uint64_t)bytes[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+// Called with a NULL key to measure the key before it is written
+static void __key_append(void* key, size_t* offset, const void* data, size_t length)
+{
+    if (key != NULL) {
+        memcpy((char*)key + *offset, data, length);
+    }
+    *offset += length;
+}
+
+static size_t __policy_key_write(struct containerv_policy* policy, uint32_t defaultAction, void* key)
+{
+    size_t   offset = 0;
+    uint32_t arch = seccomp_arch_native();
+
+    __key_append(key, &offset, &arch, sizeof(arch));
+    __key_append(key, &offset, &defaultAction, sizeof(defaultAction));
+    for (int i = 0; i < policy->syscall_count; i++) {
+        struct containerv_syscall_entry* entry = &policy->syscalls[i];
+        const char*                      args = entry->args != NULL ? entry->args : "";
+
+        // include the terminators so entries can't run into each other
+        __key_append(key, &offset, entry->name, strlen(entry->name) + 1);
+        __key_append(key, &offset, args, strlen(args) + 1);
+        __key_append(key, &offset, &entry->flags, sizeof(entry->flags));
+    }
+    return offset;
+}
+
+// Serializes everything the compiled program depends on, the hash is only used to
+// speed up the lookup, a cached program is reused only when the keys are identical.
+static void* __policy_key(struct containerv_policy* policy, uint32_t defaultAction, size_t* lengthOut)
+{
+    size_t length = __policy_key_write(policy, defaultAction, NULL);
+    void*  key;
+
+    key = malloc(length);
+    if (key == NULL) {
+        return NULL;
+    }
+    __policy_key_write(policy, defaultAction, key);
+    *lengthOut = length;
+    return key;
+}
+
+static scmp_filter_ctx __build_filter(struct containerv_policy* policy, uint32_t defaultAction)
+{
+    scmp_filter_ctx context;
+    int             status;
+
     // Create a seccomp filter with default deny action
-    allowContext = seccomp_init(__determine_default_action());
-    if (allowContext == NULL) {
+    context = seccomp_init(defaultAction);
+    if (context == NULL) {
         VLOG_ERROR("containerv", "policy_seccomp: failed to initialize seccomp context\n");
-        return -1;
+        return NULL;
     }
-    
+
+#if SCMP_VER_MAJOR > 2 || (SCMP_VER_MAJOR == 2 && SCMP_VER_MINOR >= 5)
+    // With a few hundred syscalls the default linear list of comparisons
+    // is slow to evaluate, let libseccomp generate a binary tree instead
+    if (seccomp_attr_set(context, SCMP_FLTATR_CTL_OPTIMIZE, 2) != 0) {
+        VLOG_DEBUG("containerv", "policy_seccomp: binary tree optimization is not supported\n");
+    }
+#endif
+
     // Add all allowed syscalls from the policy
     for (int i = 0; i < policy->syscall_count; i++) {
-        status = __parse_entry(allowContext, allowContext, &policy->syscalls[i]);
+        status = __parse_entry(context, context, &policy->syscalls[i]);
         if (status) {
             VLOG_ERROR(
                 "containerv",
                 "policy_seccomp: failed to parse syscall entry for '%s'\n", 
                 policy->syscalls[i].name
             );
-            goto cleanup;
+            seccomp_release(context);
+            return NULL;
+        }
+    }
+    return context;
+}
+
+static struct policy_seccomp_program* __export_filter(scmp_filter_ctx context)
+{
+    struct policy_seccomp_program* program;
+    struct stat                    stats;
+    ssize_t                        bytesRead;
+    int                            fd;
+
+    fd = memfd_create("containerv-seccomp", MFD_CLOEXEC);
+    if (fd < 0) {
+        VLOG_ERROR("containerv", "policy_seccomp: failed to create memfd: %s\n", strerror(errno));
+        return NULL;
+    }
+
+    if (seccomp_export_bpf(context, fd) != 0 || fstat(fd, &stats) != 0) {
+        VLOG_ERROR("containerv", "policy_seccomp: failed to export seccomp filter\n");
+        close(fd);
+        return NULL;
+    }
+
+    if (stats.st_size == 0 || (stats.st_size % sizeof(struct sock_filter)) != 0 ||
+        (stats.st_size / sizeof(struct sock_filter)) > BPF_MAXINSNS) {
+        VLOG_ERROR("containerv", "policy_seccomp: exported filter has an invalid size %lld\n", (long long)stats.st_size);
+        close(fd);
+        errno = EINVAL;
+        return NULL;
+    }
+
+    program = calloc(1, sizeof(struct policy_seccomp_program));
+    if (program == NULL) {
+        close(fd);
+        return NULL;
+    }
+
+    program->filter = malloc(stats.st_size);
+    if (program->filter == NULL) {
+        free(program);
+        close(fd);
+        return NULL;
+    }
+
+    bytesRead = pread(fd, program->filter, stats.st_size, 0);
+    close(fd);
+    if (bytesRead != stats.st_size) {
+        VLOG_ERROR("containerv", "policy_seccomp: failed to read exported filter\n");
+        free(program->filter);
+        free(program);
+        return NULL;
+    }
+
+    program->length = (unsigned short)(stats.st_size / sizeof(struct sock_filter));
+    return program;
+}
+
+// Compiled programs are kept for the lifetime of the process, there are only
+// a handful of distinct policies in use by a host.
+static struct policy_seccomp_program* g_programs = NULL;
+static mtx_t                          g_programsLock;
+static once_flag                      g_programsOnce = ONCE_FLAG_INIT;
+
+static void __programs_init(void)
+{
+    mtx_init(&g_programsLock, mtx_plain);
+}
+
+const struct policy_seccomp_program* policy_seccomp_compile(struct containerv_policy* policy)
+{
+    struct policy_seccomp_program* program;
+    scmp_filter_ctx                context;
+    uint32_t                       defaultAction;
+    uint64_t                       hash;
+    void*                          key;
+    size_t                         keyLength;
+
+    if (policy == NULL) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    if (!__policy_is_host_resolvable(policy)) {
+        VLOG_DEBUG("containerv", "policy_seccomp: policy references container users, compiling in container\n");
+        errno = ENOTSUP;
+        return NULL;
+    }
+
+    defaultAction = __determine_default_action();
+    key = __policy_key(policy, defaultAction, &keyLength);
+    if (key == NULL) {
+        return NULL;
+    }
+    hash = __fnv1a64(1469598103934665603ULL, key, keyLength);
+
+    call_once(&g_programsOnce, __programs_init);
+    mtx_lock(&g_programsLock);
+    for (program = g_programs; program != NULL; program = program->next) {
+        if (program->hash == hash && program->key_length == keyLength &&
+            memcmp(program->key, key, keyLength) == 0) {
+            VLOG_DEBUG("containerv", "policy_seccomp: using cached program %016llx\n", (unsigned long long)hash);
+            mtx_unlock(&g_programsLock);
+            free(key);
+            return program;
         }
     }
 
+    VLOG_TRACE("containerv", "policy_seccomp: compiling policy with %d syscalls\n", policy->syscall_count);
+    context = __build_filter(policy, defaultAction);
+    if (context == NULL) {
+        mtx_unlock(&g_programsLock);
+        free(key);
+        return NULL;
+    }
+
+    program = __export_filter(context);
+    seccomp_release(context);
+    if (program == NULL) {
+        free(key);
+    } else {
+        program->hash = hash;
+        program->key = key;
+        program->key_length = keyLength;
+        VLOG_DEBUG("containerv", "policy_seccomp: compiled program %016llx with %u instructions\n",
+            (unsigned long long)hash, program->length);
+        program->next = g_programs;
+        g_programs = program;
+    }
+    mtx_unlock(&g_programsLock);
+    return program;
+}
+
+static int __set_no_new_privs(void)
+{
     // Enable no_new_privs so we can load seccomp without CAP_SYS_ADMIN.
     // This also prevents future privilege escalation after the filter is active.
     if (prctl(PR_SET_NO_NEW_PRIVS, 1, 0, 0, 0) != 0) {
         VLOG_ERROR("containerv", "policy_seccomp: failed to set no_new_privs: %s\n", strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+static int __install_program(const struct policy_seccomp_program* program)
+{
+    struct sock_fprog fprog = {
+        .len = program->length,
+        .filter = program->filter
+    };
+
+    if (__set_no_new_privs()) {
+        return -1;
+    }
+
+    if (syscall(SYS_seccomp, SECCOMP_SET_MODE_FILTER, 0, &fprog) != 0) {
+        if (errno != ENOSYS) {
+            VLOG_ERROR("containerv", "policy_seccomp: failed to install seccomp filter: %s\n", strerror(errno));
+            return -1;
+        }
+
+        // kernels older than 3.17 only provide the prctl interface
+        if (prctl(PR_SET_SECCOMP, SECCOMP_MODE_FILTER, &fprog, 0, 0) != 0) {
+            VLOG_ERROR("containerv", "policy_seccomp: failed to install seccomp filter: %s\n", strerror(errno));
+            return -1;
+        }
+    }
+
+    VLOG_TRACE("containerv", "policy_seccomp: installed program %016llx\n", (unsigned long long)program->hash);
+    return 0;
+}
+
+int policy_seccomp_apply(struct containerv_policy* policy, const struct policy_seccomp_program* program)
+{
+    scmp_filter_ctx allowContext;
+    int             status = -1;
+    
+    if (policy == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    // The host compiled the policy before the container was forked, then
+    // all that is left is handing the program to the kernel
+    if (program != NULL) {
+        return __install_program(program);
+    }
+    
+    VLOG_TRACE("containerv", "policy_seccomp: applying policy with %d allowed syscalls\n",
+              policy->syscall_count);
+    
+    allowContext = __build_filter(policy, __determine_default_action());
+    if (allowContext == NULL) {
+        return -1;
+    }
+
+    if (__set_no_new_privs()) {
         goto cleanup;
     }
 
@@ -395,9 +673,6 @@ int policy_seccomp_apply(struct containerv_policy* policy)
     status = 0;
     
 cleanup:
-    if (allowContext != NULL) {
-        seccomp_release(allowContext);
-    }
-    
+    seccomp_release(allowContext);
     return status;
 }
@@ -44,6 +44,7 @@ extern int pid1_common_init(void);
 extern int pid1_common_cleanup(void);
 extern int pid1_validate_spawn(const pid1_process_options_t* options);
 extern int pid1_is_initialized(void);
+extern void pid1_notify_exit(pid1_process_handle_t handle, int exit_code);
 
 /**
  * @brief Signal handler for SIGCHLD
@@ -102,6 +103,21 @@ static void __remove_process(pid_t pid)
     }
 }
 
+/**
+ * @brief Convert a wait status into the exit code reported to callers
+ */
+static int __exit_code_from_status(pid_t pid, int status)
+{
+    if (WIFEXITED(status)) {
+        PID1_INFO("Process %d exited with code %d", pid, WEXITSTATUS(status));
+        return WEXITSTATUS(status);
+    } else if (WIFSIGNALED(status)) {
+        PID1_INFO("Process %d terminated by signal %d", pid, WTERMSIG(status));
+        return 128 + WTERMSIG(status);
+    }
+    return -1;
+}
+
 int pid1_linux_init(void)
 {
     struct sigaction sa_chld;
@@ -161,7 +177,22 @@ int pid1_linux_spawn(const pid1_process_options_t* options, pid_t* pid_out)
 
     if (pid == 0) {
         // Child process
-        
+        sigset_t empty;
+
+        // The service may run with SIGCHLD blocked, don't leak that into the child
+        sigemptyset(&empty);
+        sigprocmask(SIG_SETMASK, &empty, NULL);
+
+        // Redirect output if requested
+        if (options->stdout_fd > 0 && dup2(options->stdout_fd, STDOUT_FILENO) < 0) {
+            PID1_ERROR("dup2(stdout) failed: %s", strerror(errno));
+            _exit(1);
+        }
+        if (options->stderr_fd > 0 && dup2(options->stderr_fd, STDERR_FILENO) < 0) {
+            PID1_ERROR("dup2(stderr) failed: %s", strerror(errno));
+            _exit(1);
+        }
+
         // Change working directory if specified
         if (options->working_directory != NULL) {
             if (chdir(options->working_directory) != 0) {
@@ -214,6 +245,7 @@ int pid1_linux_spawn(const pid1_process_options_t* options, pid_t* pid_out)
 int pid1_linux_wait(pid_t pid, int* exit_code_out)
 {
     int status;
+    int exit_code;
     pid_t result;
 
     if (!pid1_is_initialized()) {
@@ -233,18 +265,12 @@ int pid1_linux_wait(pid_t pid, int* exit_code_out)
     __remove_process(pid);
 
     // Extract exit code
+    exit_code = __exit_code_from_status(pid, status);
     if (exit_code_out != NULL) {
-        if (WIFEXITED(status)) {
-            *exit_code_out = WEXITSTATUS(status);
-            PID1_INFO("Process %d exited with code %d", pid, *exit_code_out);
-        } else if (WIFSIGNALED(status)) {
-            *exit_code_out = 128 + WTERMSIG(status);
-            PID1_INFO("Process %d terminated by signal %d", pid, WTERMSIG(status));
-        } else {
-            *exit_code_out = -1;
-        }
+        *exit_code_out = exit_code;
     }
 
+    pid1_notify_exit(pid, exit_code);
     return 0;
 }
 
@@ -276,11 +302,7 @@ int pid1_linux_reap_zombies(void)
         __remove_process(pid);
         reaped++;
 
-        if (WIFEXITED(status)) {
-            PID1_DEBUG("Reaped process %d (exit code: %d)", pid, WEXITSTATUS(status));
-        } else if (WIFSIGNALED(status)) {
-            PID1_DEBUG("Reaped process %d (signal: %d)", pid, WTERMSIG(status));
-        }
+        pid1_notify_exit(pid, __exit_code_from_status(pid, status));
     }
 
     if (pid < 0 && errno != ECHILD) {
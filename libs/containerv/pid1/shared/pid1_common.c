@@ -24,7 +24,9 @@
 // Platform-specific initialization is handled by platform-specific modules
 // This file provides validation and common utilities
 
-static int g_pid1_initialized = 0;
+static int                  g_pid1_initialized = 0;
+static pid1_exit_callback_t g_exit_callback = NULL;
+static void*                g_exit_context = NULL;
 
 /**
  * @brief Validate process options
@@ -106,6 +108,28 @@ int pid1_common_cleanup(void)
     return 0;
 }
 
+void pid1_set_exit_callback(pid1_exit_callback_t callback, void* context)
+{
+    g_exit_callback = callback;
+    g_exit_context = context;
+}
+
+/**
+ * @brief Report a collected process to the installed exit callback
+ * 
+ * This is called by platform-specific implementations once the exit
+ * code of a tracked process has been retrieved.
+ * 
+ * @param handle Handle of the process that exited
+ * @param exit_code Exit code of the process
+ */
+void pid1_notify_exit(pid1_process_handle_t handle, int exit_code)
+{
+    if (g_exit_callback != NULL) {
+        g_exit_callback(handle, exit_code, g_exit_context);
+    }
+}
+
 /**
  * @brief Check if PID 1 service is initialized
  * 
@@ -34,6 +34,11 @@ typedef struct pid1_process_options {
     const char* const* environment;       // Null-terminated environment variable array
     const char*        working_directory; // Working directory (NULL for default)
     const char*        log_path;          // Path for logging output (NULL for no logging)
+
+    // Output redirection (Unix), the descriptors are duplicated onto stdout/stderr
+    // of the new process. 0 inherits the output of the PID 1 service.
+    int                stdout_fd;
+    int                stderr_fd;
     
     // Resource limits (platform-specific interpretation)
     uint64_t           memory_limit_bytes; // Memory limit (0 for no limit)
@@ -66,6 +71,15 @@ typedef HANDLE pid1_process_handle_t;
 typedef pid_t pid1_process_handle_t;
 #endif
 
+/**
+ * @brief Callback invoked when a tracked process has been collected
+ *
+ * @param handle The handle of the process that exited
+ * @param exit_code The exit code, or 128 + signal number if it was terminated by a signal
+ * @param context The context pointer provided to pid1_set_exit_callback
+ */
+typedef void (*pid1_exit_callback_t)(pid1_process_handle_t handle, int exit_code, void* context);
+
 /**
  * @brief Initialize the PID 1 service
  * 
@@ -131,6 +145,19 @@ extern int pid1_cleanup(void);
  */
 extern int pid1_reap_zombies(void);
 
+/**
+ * @brief Install a callback that is invoked for every process collected by
+ * pid1_wait_process or pid1_reap_zombies
+ *
+ * The callback is invoked from the thread that collects the process, never
+ * from a signal handler. Only one callback can be installed, passing NULL
+ * removes it.
+ *
+ * @param callback The callback to invoke, or NULL
+ * @param context Context pointer passed to the callback
+ */
+extern void pid1_set_exit_callback(pid1_exit_callback_t callback, void* context);
+
 /**
  * @brief Get the number of active child processes
  * 
@@ -42,6 +42,7 @@ extern int pid1_common_init(void);
 extern int pid1_common_cleanup(void);
 extern int pid1_validate_spawn(const pid1_process_options_t* options);
 extern int pid1_is_initialized(void);
+extern void pid1_notify_exit(pid1_process_handle_t handle, int exit_code);
 
 /**
  * @brief Console control handler for CTRL+C, CTRL+BREAK, etc.
@@ -429,6 +430,7 @@ int pid1_windows_wait(HANDLE handle, int* exit_code_out)
 
     PID1_INFO("Process (handle %p) exited with code %lu", handle, exit_code);
 
+    pid1_notify_exit(handle, (int)exit_code);
     return 0;
 }
 
@@ -2309,6 +2309,12 @@ int containerv_spawn(
     if (!container || !path) {
         return -1;
     }
+
+    // output and exit status streaming relies on the linux control socket
+    if (options && (options->flags & CV_SPAWN_STREAM)) {
+        errno = ENOTSUP;
+        return -1;
+    }
     
     // Validate and copy path
     size_t pathLen = strlen(path);
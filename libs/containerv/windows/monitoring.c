@@ -229,6 +229,30 @@ int containerv_get_stats(
     return 0;
 }
 
+/**
+ * @brief Get statistics for a batch of containers
+ * @param containers Containers to monitor
+ * @param count Number of containers
+ * @param stats Output statistics, one per container
+ * @return 0 on success, -1 on failure
+ */
+int containerv_get_stats_batch(
+    struct containerv_container** containers,
+    int                           count,
+    struct containerv_stats*      stats)
+{
+    if (!containers || !stats || count < 0) {
+        return -1;
+    }
+
+    for (int i = 0; i < count; i++) {
+        if (containers[i] == NULL || containerv_get_stats(containers[i], &stats[i])) {
+            memset(&stats[i], 0, sizeof(struct containerv_stats));
+        }
+    }
+    return 0;
+}
+
 int containerv_get_processes(
     struct containerv_container*    container,
     struct containerv_process_info* processes,
@@ -929,3 +929,14 @@ int __windows_configure_hcs_container_network(
     container->network_configured = 1;
     return 0;
 }
+
+int containerv_network_pool_initialize(int size)
+{
+    // HNS endpoints are created per container, there is nothing to pre-create
+    (void)size;
+    return 0;
+}
+
+void containerv_network_pool_cleanup(void)
+{
+}
@@ -20,7 +20,9 @@
 #include <chef/cvd.h>
 #include <chef/containerv/disk/ubuntu.h>
 #include <chef/dirs.h>
+#include <chef/ingredient.h>
 #include <chef/platform.h>
+#include <chef/store.h>
 #include <gracht/link/socket.h>
 #include <gracht/client.h>
 #include <stdio.h>
@@ -224,12 +226,174 @@ static enum chef_status __chef_status_from_errno(void) {
     }
 }
 
-static void __initialize_overlays(struct chef_create_parameters* params, const char* rootfs, struct __bake_build_context* bctx)
+struct __ingredient_layer {
+    struct list_item list_header;
+    char*            source;
+    char*            target;
+};
+
+static void __ingredient_layer_delete(void* item)
+{
+    struct __ingredient_layer* layer = item;
+    free(layer->source);
+    free(layer->target);
+    free(layer);
+}
+
+static int __add_ingredient_layer(struct list* layers, const char* source, const char* target)
+{
+    struct __ingredient_layer* layer;
+
+    layer = calloc(1, sizeof(struct __ingredient_layer));
+    if (layer == NULL) {
+        return -1;
+    }
+
+    layer->source = platform_strdup(source);
+    layer->target = platform_strdup(target);
+    if (layer->source == NULL || layer->target == NULL) {
+        __ingredient_layer_delete(layer);
+        return -1;
+    }
+    list_add(layers, &layer->list_header);
+    return 0;
+}
+
+// Resolves the ingredient packs of a recipe environment into layers. This mirrors
+// what bakectl init does when it unpacks the ingredients, ingredients are stacked onto
+// the target directory and toolchains (only for host ingredients) are stacked onto their
+// own directory under /chef/toolchains.
+static int __resolve_ingredient_layers(
+    struct list* ingredients,
+    const char*  platform,
+    const char*  arch,
+    const char*  target,
+    int          toolchains,
+    struct list* layers)
+{
+    struct list_item* i;
+    char              buff[512];
+    int               status;
+
+    list_foreach(ingredients, i) {
+        struct recipe_ingredient* ri = (struct recipe_ingredient*)i;
+        struct ingredient*        ig;
+        const char*               path;
+        enum chef_package_type    type;
+
+        status = store_package_path(&(struct store_package) {
+            .name = ri->name,
+            .channel = ri->channel,
+            .arch = arch,
+            .platform = platform
+        }, &path);
+        if (status) {
+            VLOG_ERROR("cvd", "__resolve_ingredient_layers: failed to find ingredient in store %s\n", ri->name);
+            return -1;
+        }
+
+        status = ingredient_open(path, &ig);
+        if (status) {
+            VLOG_ERROR("cvd", "__resolve_ingredient_layers: failed to open %s\n", ri->name);
+            free((void*)path);
+            return -1;
+        }
+        type = ig->package->type;
+        ingredient_close(ig);
+
+        if (type == CHEF_PACKAGE_TYPE_INGREDIENT) {
+            status = __add_ingredient_layer(layers, path, target);
+        } else if (type == CHEF_PACKAGE_TYPE_TOOLCHAIN && toolchains) {
+            // toolchains are always resolved for the host
+            free((void*)path);
+            status = store_package_path(&(struct store_package) {
+                .name = ri->name,
+                .channel = ri->channel,
+                .arch = CHEF_ARCHITECTURE_STR,
+                .platform = CHEF_PLATFORM_STR
+            }, &path);
+            if (status) {
+                VLOG_ERROR("cvd", "__resolve_ingredient_layers: failed to find toolchain in store %s\n", ri->name);
+                return -1;
+            }
+            snprintf(&buff[0], sizeof(buff), "/chef/toolchains/%s", ri->name);
+            status = __add_ingredient_layer(layers, path, &buff[0]);
+        }
+        free((void*)path);
+        if (status) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// Runtime ingredients are not mounted. They must end up in the install directory,
+// which the host reads directly from the upper directory of the root overlay when
+// packing, so bakectl still unpacks them.
+static int __resolve_ingredients(struct __bake_build_context* bctx, struct list* layers)
+{
+    char buildPath[256];
+    int  status;
+
+    snprintf(&buildPath[0], sizeof(buildPath), "/chef/build/%s/%s",
+        bctx->target_platform, bctx->target_architecture);
+
+    status = __resolve_ingredient_layers(
+        &bctx->recipe->environment.host.ingredients,
+        bctx->target_platform, bctx->target_architecture,
+        "/", 1, layers
+    );
+    if (status) {
+        return status;
+    }
+
+    return __resolve_ingredient_layers(
+        &bctx->recipe->environment.build.ingredients,
+        bctx->target_platform, bctx->target_architecture,
+        &buildPath[0], 0, layers
+    );
+}
+
+static int __initialize_overlays(struct chef_create_parameters* params, const char* rootfs, struct __bake_build_context* bctx)
 {
     struct chef_layer_descriptor* layer;
+    struct list                   ingredients;
+    struct list_item*             i;
+    char*                         gitCache;
+    char*                         sourceCache;
+    int                           index = 5;
     VLOG_DEBUG("cvd", "__initialize_overlays(rootfs=%s)\n", rootfs);
 
-    chef_create_parameters_layers_add(params, 4);
+    // the git cache is shared between all builds on this host
+    gitCache = strpathjoin(chef_dirs_cache(), "git", NULL);
+    if (gitCache == NULL || platform_mkdir(gitCache)) {
+        VLOG_ERROR("cvd", "__initialize_overlays: failed to create the git cache\n");
+        free(gitCache);
+        return -1;
+    }
+
+    // downloaded and extracted url sources are shared the same way
+    sourceCache = strpathjoin(chef_dirs_cache(), "sources", NULL);
+    if (sourceCache == NULL || platform_mkdir(sourceCache)) {
+        VLOG_ERROR("cvd", "__initialize_overlays: failed to create the source cache\n");
+        free(sourceCache);
+        free(gitCache);
+        return -1;
+    }
+
+    // When ingredient layers are requested, the ingredient packs are mounted
+    // read-only into the container instead of being unpacked by bakectl
+    list_init(&ingredients);
+    if (bctx->ingredient_layers) {
+        if (__resolve_ingredients(bctx, &ingredients)) {
+            list_destroy(&ingredients, __ingredient_layer_delete);
+            free(sourceCache);
+            free(gitCache);
+            return -1;
+        }
+    }
+
+    chef_create_parameters_layers_add(params, 6 + ingredients.count);
 
     // setup the base rootfs
     layer = chef_create_parameters_layers_get(params, 0);
@@ -252,10 +416,39 @@ static void __initialize_overlays(struct chef_create_parameters* params, const c
     layer->target = platform_strdup("/chef/store");
     layer->options = CHEF_MOUNT_OPTIONS_READONLY;
 
+    // setup the git cache mount, this must be writable as
+    // the mirrors are updated from inside the container
+    layer = chef_create_parameters_layers_get(params, 3);
+    layer->type = CHEF_LAYER_TYPE_HOST_DIRECTORY;
+    layer->source = gitCache;
+    layer->target = platform_strdup("/chef/cache/git");
+    layer->options = 0;
+
+    // setup the source cache mount, writable for the same reason
+    layer = chef_create_parameters_layers_get(params, 4);
+    layer->type = CHEF_LAYER_TYPE_HOST_DIRECTORY;
+    layer->source = sourceCache;
+    layer->target = platform_strdup("/chef/cache/sources");
+    layer->options = 0;
+
+    // setup the ingredient layers, these are stacked on top of the base
+    // rootfs in the order of the recipe
+    list_foreach(&ingredients, i) {
+        struct __ingredient_layer* ingredient = (struct __ingredient_layer*)i;
+
+        layer = chef_create_parameters_layers_get(params, index++);
+        layer->type = CHEF_LAYER_TYPE_VAFS_PACKAGE;
+        layer->source = platform_strdup(ingredient->source);
+        layer->target = platform_strdup(ingredient->target);
+        layer->options = CHEF_MOUNT_OPTIONS_READONLY;
+    }
+    list_destroy(&ingredients, __ingredient_layer_delete);
+
     // initialize the overlay layer, this is an writable layer
     // to capture all the changes
-    layer = chef_create_parameters_layers_get(params, 3);
+    layer = chef_create_parameters_layers_get(params, index);
     layer->type = CHEF_LAYER_TYPE_OVERLAY;
+    return 0;
 }
 
 // Initialize the base rootfs for the build container if, and only if, it's not already
@@ -361,7 +554,12 @@ enum chef_status bake_client_create_container(struct __bake_build_context* bctx)
         }
     }
 
-    __initialize_overlays(&params, rootfs, bctx);
+    if (__initialize_overlays(&params, rootfs, bctx)) {
+        chef_create_parameters_destroy(&params);
+        free(rootfs);
+        VLOG_ERROR("bake", "bake_client_create_container: failed to resolve ingredient layers\n");
+        return CHEF_STATUS_FAILED_ROOTFS_SETUP;
+    }
     
     status = chef_cvd_create(bctx->cvd_client, &context, &params);
     
@@ -450,6 +648,32 @@ enum chef_status bake_client_upload(struct __bake_build_context* bctx, const cha
     return chstatus;
 }
 
+enum chef_status bake_client_download(struct __bake_build_context* bctx, const char* containerPath, const char* hostPath)
+{
+    struct gracht_message_context context;
+    int                           status;
+    enum chef_status              chstatus;
+    VLOG_DEBUG("bake", "bake_client_download(child=%s, host=%s)\n", containerPath, hostPath);
+
+    status = chef_cvd_download(
+        bctx->cvd_client,
+        &context,
+        &(struct chef_file_parameters) {
+            .container_id = bctx->cvd_id,
+            .source_path = (char*)containerPath,
+            .destination_path = (char*)hostPath,
+            .user.username = ""
+        }
+    );
+    if (status != 0) {
+        VLOG_ERROR("bake", "bake_client_download: failed to download %s\n", containerPath);
+        return status;
+    }
+    gracht_client_wait_message(bctx->cvd_client, &context, GRACHT_MESSAGE_BLOCK);
+    chef_cvd_download_result(bctx->cvd_client, &context, &chstatus);
+    return chstatus;
+}
+
 enum chef_status bake_client_destroy_container(struct __bake_build_context* bctx)
 {
     struct gracht_message_context context;
@@ -477,3 +701,24 @@ enum chef_status bake_client_destroy_container(struct __bake_build_context* bctx
     }
     return chstatus;
 }
+
+void chef_cvd_event_container_stats_invocation(gracht_client_t* client, const struct chef_container_stats* stats)
+{
+    // stats are not subscribed to by this client, but the protocol requires the handler
+    (void)client;
+    (void)stats;
+}
+
+void chef_cvd_event_process_output_invocation(gracht_client_t* client, const struct chef_process_output* output)
+{
+    // processes are not spawned with STREAM by this client, but the protocol requires the handler
+    (void)client;
+    (void)output;
+}
+
+void chef_cvd_event_process_exit_invocation(gracht_client_t* client, const struct chef_process_exit* info)
+{
+    // processes are not spawned with STREAM by this client, but the protocol requires the handler
+    (void)client;
+    (void)info;
+}
@@ -20,9 +20,12 @@
 #include <chef/dirs.h>
 #include <chef/list.h>
 #include <chef/platform.h>
+#include <chef/trace.h>
 #include <stdlib.h>
 #include <vlog.h>
 
+#include "private.h"
+
 #ifdef CHEF_ON_LINUX
 #include <unistd.h>
 static char* __get_username(void) {
@@ -90,7 +93,7 @@ static char** __initialize_env(struct __bake_build_options* options)
         return NULL;
     }
 
-    env = calloc(8, sizeof(char*));
+    env = calloc(9, sizeof(char*));
     if (env == NULL) {
         VLOG_FATAL("kitchen", "failed to allocate memory for environment\n");
         free(username);
@@ -104,7 +107,10 @@ static char** __initialize_env(struct __bake_build_options* options)
     env[4] = __fmt_env_option("LD_LIBRARY_PATH", "/usr/local/lib");
     env[5] = __fmt_env_option("CHEF_TARGET_ARCH", options->target_architecture);
     env[6] = __fmt_env_option("CHEF_TARGET_PLATFORM", options->target_platform);
-    // env[7] = NULL
+    if (options->trace) {
+        env[7] = __fmt_env_option(CHEF_TRACE_ENVIRONMENT, BAKE_TRACE_CONTAINER_PATH);
+    }
+    // env[8] = NULL
 
     free(username);
     return env;
@@ -126,6 +132,9 @@ struct __bake_build_context* build_context_create(struct __bake_build_options* o
     bctx->recipe_path = platform_strdup(options->recipe_path);
     bctx->target_platform = platform_strdup(options->target_platform);
     bctx->target_architecture = platform_strdup(options->target_architecture);
+    bctx->trace = options->trace;
+    bctx->incremental = options->incremental;
+    bctx->ingredient_layers = options->ingredient_layers;
 
     if (options->cvd_address != NULL) {
         memcpy(&bctx->cvd_address, options->cvd_address, sizeof(struct chef_config_address));
@@ -42,6 +42,16 @@ struct __bake_build_options {
     const char*                 recipe_path;
     struct build_cache*         build_cache;
     struct chef_config_address* cvd_address;
+    // trace enables span recording for bakectl inside the build
+    // container, the spans can be collected with build_trace_write.
+    int                         trace;
+    // incremental skips generate (configure) steps that the build cache
+    // has recorded as complete, the caller is responsible for marking
+    // them incomplete again when the configuration inputs change.
+    int                         incremental;
+    // ingredient_layers mounts the ingredient packs read-only as layers of
+    // the build container, instead of unpacking them during bakectl init.
+    int                         ingredient_layers;
 };
 
 struct __bake_build_context {
@@ -60,6 +70,9 @@ struct __bake_build_context {
     struct chef_config_address cvd_address;
     gracht_client_t*           cvd_client;
     char*                      cvd_id;
+    int                        trace;
+    int                        incremental;
+    int                        ingredient_layers;
 };
 
 extern struct __bake_build_context* build_context_create(struct __bake_build_options* options);
@@ -76,6 +89,17 @@ extern int build_step_pack(struct __bake_build_context* bctx);
 
 extern int bake_step_clean(struct __bake_build_context* bctx, struct __build_clean_options* options);
 
+/**
+ * @brief Writes the spans recorded in this process to a Chrome trace-event file, merged with
+ * the spans recorded by bakectl inside the build container. Must be invoked before the build
+ * context is destroyed, and requires tracing to be enabled with chef_trace_enable.
+ * 
+ * @param[In] bctx The build context, must have been created with the trace option.
+ * @param[In] path The path of the trace file on the host.
+ * @return int 0 on success, -1 on failure with errno set.
+ */
+extern int build_trace_write(struct __bake_build_context* bctx, const char* path);
+
 extern int bake_purge_kitchens(void);
 
 extern int bake_client_initialize(struct __bake_build_context* bctx);
@@ -86,6 +110,8 @@ extern enum chef_status bake_client_spawn(struct __bake_build_context* bctx, con
 
 extern enum chef_status bake_client_upload(struct __bake_build_context* bctx, const char* hostPath, const char* containerPath);
 
+extern enum chef_status bake_client_download(struct __bake_build_context* bctx, const char* containerPath, const char* hostPath);
+
 extern enum chef_status bake_client_destroy_container(struct __bake_build_context* bctx);
 
 
@@ -19,4 +19,7 @@
 #ifndef __LIBCVD_PRIVATE_H__
 #define __LIBCVD_PRIVATE_H__
 
+// Where bakectl appends its spans inside the build container when tracing
+#define BAKE_TRACE_CONTAINER_PATH "/chef/bakectl.trace"
+
 #endif //!__LIBCVD_PRIVATE_H__
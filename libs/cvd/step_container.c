@@ -20,10 +20,13 @@
 #include <chef/list.h>
 #include <chef/dirs.h>
 #include <chef/platform.h>
+#include <chef/trace.h>
 #include <errno.h>
 #include <stdlib.h>
 #include <vlog.h>
 
+#include "private.h"
+
 #if defined(WIN32) || defined(_WIN32) || defined(__WIN32__) || defined(__NT__)
 static int __find_bakectl(char** resolvedOut)
 {
@@ -128,10 +131,11 @@ static int __find_bakectl(char** resolvedOut)
 
 int bake_build_setup(struct __bake_build_context* bctx)
 {
-    int          status;
-    char*        bakectlPath;
-    unsigned int pid;
-    char         buffer[1024];
+    int                    status;
+    char*                  bakectlPath;
+    unsigned int           pid;
+    char                   buffer[1024];
+    struct chef_trace_span span;
     VLOG_DEBUG("bake", "bake_build_setup()\n");
 
     if (bctx->cvd_client == NULL) {
@@ -139,7 +143,9 @@ int bake_build_setup(struct __bake_build_context* bctx)
         return -1;
     }
 
+    chef_trace_begin(&span);
     status = bake_client_create_container(bctx);
+    chef_trace_end(&span, "bake", "create container");
     if (status) {
         VLOG_ERROR("bake", "bake_build_setup: failed to create build container: %u\n", status);
         return status;
@@ -152,7 +158,9 @@ int bake_build_setup(struct __bake_build_context* bctx)
         return status;
     }
     
+    chef_trace_begin(&span);
     status = bake_client_upload(bctx, bakectlPath, bctx->bakectl_path);
+    chef_trace_end(&span, "bake", "upload bakectl");
     if (status) {
         VLOG_ERROR("bake", "bake_build_setup: failed to write bakectl in container\n");
         bake_client_destroy_container(bctx);
@@ -160,19 +168,55 @@ int bake_build_setup(struct __bake_build_context* bctx)
     }
     free(bakectlPath);
 
+    // The container, and with it the trace file, is kept between builds of the
+    // project. Remove the spans of earlier builds so they are not merged into this one.
+    if (bctx->trace) {
+        snprintf(&buffer[0], sizeof(buffer), "/bin/rm -f %s", BAKE_TRACE_CONTAINER_PATH);
+        status = bake_client_spawn(bctx, &buffer[0], CHEF_SPAWN_OPTIONS_WAIT, &pid);
+        if (status) {
+            VLOG_WARNING("bake", "bake_build_setup: failed to reset the trace file in the container\n");
+        }
+    }
+
     snprintf(&buffer[0], sizeof(buffer),
-        "%s init --recipe %s",
-        bctx->bakectl_path, bctx->recipe_path
+        "%s init --recipe %s%s",
+        bctx->bakectl_path, bctx->recipe_path,
+        bctx->ingredient_layers ? " --ingredient-layers" : ""
     );
 
+    chef_trace_begin(&span);
     status = bake_client_spawn(
         bctx,
         &buffer[0],
         CHEF_SPAWN_OPTIONS_WAIT,
         &pid
     );
+    chef_trace_end(&span, "bake", "init");
     if (status) {
         VLOG_ERROR("bake", "failed to setup project inside the container\n");
+        return status;
+    }
+
+    // Start the bakectl agent, which keeps the recipe and build context loaded
+    // for the lifetime of the container. Subsequent bakectl invocations for steps
+    // are forwarded to it. The agent detaches once it's ready to accept requests,
+    // so waiting here guarantees that the first step will be able to reach it.
+    snprintf(&buffer[0], sizeof(buffer),
+        "%s serve --recipe %s",
+        bctx->bakectl_path, bctx->recipe_path
+    );
+
+    chef_trace_begin(&span);
+    status = bake_client_spawn(
+        bctx,
+        &buffer[0],
+        CHEF_SPAWN_OPTIONS_WAIT,
+        &pid
+    );
+    chef_trace_end(&span, "bake", "start agent");
+    if (status) {
+        // not fatal, the steps will then execute without the agent
+        VLOG_WARNING("bake", "failed to start the bakectl agent inside the container\n");
     }
-    return status;
+    return 0;
 }
@@ -20,6 +20,7 @@
 #include <chef/list.h>
 #include <chef/recipe.h>
 #include <chef/platform.h>
+#include <chef/trace.h>
 #include <errno.h>
 #include <stdlib.h>
 #include <vlog.h>
@@ -33,7 +34,16 @@ static int __make_recipe_steps(struct __bake_build_context* bctx, const char* pa
     VLOG_DEBUG("kitchen", "__make_recipe_steps(part=%s)\n", part);
 
     list_foreach(steps, item) {
-        struct recipe_step* step = (struct recipe_step*)item;
+        struct recipe_step*    step = (struct recipe_step*)item;
+        struct chef_trace_span span;
+
+        // the configuration of an incremental build is kept in the build
+        // directory, so it only needs to run again when the cache says so
+        if (bctx->incremental && step->type == RECIPE_STEP_TYPE_GENERATE &&
+            build_cache_is_step_complete(bctx->build_cache, part, step->name)) {
+            VLOG_TRACE("kitchen", "skipping step '%s/%s', already configured\n", part, step->name);
+            continue;
+        }
 
         snprintf(&buffer[0], sizeof(buffer),
             "%s build --recipe %s --step %s/%s",
@@ -41,16 +51,24 @@ static int __make_recipe_steps(struct __bake_build_context* bctx, const char* pa
         );
 
         VLOG_TRACE("kitchen", "executing step '%s/%s'\n", part, step->name);
+        chef_trace_begin(&span);
         status = bake_client_spawn(
             bctx,
             &buffer[0],
             CHEF_SPAWN_OPTIONS_WAIT,
             &pid
         );
+        chef_trace_end(&span, "bake", "make %s/%s", part, step->name);
         if (status) {
             VLOG_ERROR("kitchen", "failed to execute step '%s/%s'\n", part, step->name);
             return status;
         }
+
+        if (bctx->incremental) {
+            build_cache_transaction_begin(bctx->build_cache);
+            build_cache_mark_step_complete(bctx->build_cache, part, step->name);
+            build_cache_transaction_commit(bctx->build_cache);
+        }
     }
     
     return 0;
@@ -21,6 +21,7 @@
 #include <chef/pack.h>
 #include <chef/platform.h>
 #include <chef/recipe.h>
+#include <chef/trace.h>
 #include <errno.h>
 #include <stdlib.h>
 #include <vlog.h>
@@ -88,29 +89,43 @@ static int __stage_ingredients(struct __bake_build_context* bctx)
 
 int build_step_pack(struct __bake_build_context* bctx)
 {
-    struct list_item* item;
-    int               status;
+    struct __pack_options* packOptions;
+    struct list_item*      item;
+    int                    count = 0;
+    int                    status;
+    struct chef_trace_span span;
     VLOG_DEBUG("bake", "kitchen_recipe_pack()\n");
 
     // stage before we pack
+    chef_trace_begin(&span);
     status = __stage_ingredients(bctx);
+    chef_trace_end(&span, "bake", "stage");
     if (status) {
         VLOG_ERROR("bake", "failed to perform stage step of '%s'\n", bctx->recipe->project.name);
         return status;
     }
 
-    list_foreach(&bctx->recipe->packs, item) {
-        struct recipe_pack*   pack = (struct recipe_pack*)item;
-        struct __pack_options packOptions;
+    if (bctx->recipe->packs.count == 0) {
+        return 0;
+    }
+
+    packOptions = calloc(bctx->recipe->packs.count, sizeof(struct __pack_options));
+    if (packOptions == NULL) {
+        return -1;
+    }
 
-        __initialize_pack_options(bctx, &packOptions, pack);
-        status = bake_pack(&packOptions);
-        if (status) {
-            VLOG_ERROR("bake", "kitchen_recipe_pack: failed to construct pack %s\n", pack->name);
-            goto cleanup;
-        }
+    list_foreach(&bctx->recipe->packs, item) {
+        __initialize_pack_options(bctx, &packOptions[count++], (struct recipe_pack*)item);
     }
 
-cleanup:
+    // all packs are made from the same install tree, so let them share
+    // the scan of it and build them in parallel
+    chef_trace_begin(&span);
+    status = bake_pack_multiple(packOptions, count);
+    chef_trace_end(&span, "bake", "pack %s", bctx->recipe->project.name);
+    if (status) {
+        VLOG_ERROR("bake", "kitchen_recipe_pack: failed to construct packs for %s\n", bctx->recipe->project.name);
+    }
+    free(packOptions);
     return status;
 }
@@ -20,6 +20,7 @@
 #include <chef/list.h>
 #include <chef/platform.h>
 #include <chef/recipe.h>
+#include <chef/trace.h>
 #include <errno.h>
 #include <stdlib.h>
 #include <vlog.h>
@@ -38,7 +39,8 @@ int build_step_source(struct __bake_build_context* bctx)
     }
 
     list_foreach(&bctx->recipe->parts, item) {
-        struct recipe_part* part = (struct recipe_part*)item;
+        struct recipe_part*    part = (struct recipe_part*)item;
+        struct chef_trace_span span;
         
         snprintf(&buffer[0], sizeof(buffer),
             "%s source --recipe %s --step %s",
@@ -46,12 +48,14 @@ int build_step_source(struct __bake_build_context* bctx)
         );
 
         VLOG_TRACE("bake", "sourcing part '%s'\n", part->name);
+        chef_trace_begin(&span);
         status = bake_client_spawn(
             bctx,
             &buffer[0],
             CHEF_SPAWN_OPTIONS_WAIT,
             &pid
         );
+        chef_trace_end(&span, "bake", "source %s", part->name);
         if (status) {
             VLOG_ERROR("bake", "failed to source part '%s'\n", part->name);
             break;
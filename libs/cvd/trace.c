@@ -0,0 +1,60 @@
+/**
+ * Copyright, Philip Meulengracht
+ *
+ * This program is free software : you can redistribute it and / or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation ? , either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ * 
+ */
+
+#include <chef/cvd.h>
+#include <chef/platform.h>
+#include <chef/trace.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vlog.h>
+
+#include "private.h"
+
+int build_trace_write(struct __bake_build_context* bctx, const char* path)
+{
+    char  importPath[PATH_MAX];
+    char* import = NULL;
+    int   status;
+    VLOG_DEBUG("bake", "build_trace_write(path=%s)\n", path);
+
+    if (bctx == NULL || path == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    // the spans of bakectl are fetched next to the trace and merged in, a
+    // missing file just means that nothing ran in the container
+    if (bctx->trace && bctx->cvd_client != NULL && bctx->cvd_id != NULL) {
+        snprintf(&importPath[0], sizeof(importPath), "%s.container", path);
+        if (bake_client_download(bctx, BAKE_TRACE_CONTAINER_PATH, &importPath[0]) == CHEF_STATUS_SUCCESS) {
+            import = &importPath[0];
+        } else {
+            VLOG_WARNING("bake", "build_trace_write: no spans were collected from the build container\n");
+        }
+    }
+
+    status = chef_trace_write(path, import);
+    if (import != NULL) {
+        platform_unlink(import);
+    }
+    if (status) {
+        VLOG_ERROR("bake", "build_trace_write: failed to write %s\n", path);
+    }
+    return status;
+}
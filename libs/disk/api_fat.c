@@ -24,6 +24,39 @@
 #include "private.h"
 #include "filesystems/fat/fat_filelib.h"
 
+// Sector I/O from the FAT library never goes straight to the stream. Small
+// requests are served by a set-associative write-back cache of fixed size
+// blocks, requests of a block or more bypass it, and once formatted the FAT
+// itself is kept in memory and written back exactly once at finish.
+#define __CACHE_BLOCK_SECTORS 64
+#define __CACHE_WAYS          8
+#define __CACHE_DEFAULT_SIZE  (16 * 1024 * 1024)
+
+struct __fat_cache_block {
+    uint64_t block;
+    uint64_t used;
+    int      valid;
+    int      dirty;
+    uint8_t* data;
+};
+
+struct __fat_cache {
+    struct __fat_cache_block* blocks;
+    uint8_t*                  memory;
+    size_t                    sets;
+    size_t                    block_size;
+    uint64_t                  tick;
+};
+
+struct __fat_table {
+    uint8_t* data;
+    uint32_t start;
+    uint32_t sectors;
+    uint32_t dirty_first;
+    uint32_t dirty_last;
+    int      dirty;
+};
+
 struct __fat_filesystem {
     struct chef_disk_filesystem        base;
     struct chef_filesystem_fat_options options;
@@ -33,6 +66,8 @@ struct __fat_filesystem {
     uint64_t                           sector_count;
     uint16_t                           bytes_per_sector;
     FILE*                              stream;
+    struct __fat_cache                 cache;
+    struct __fat_table                 table;
 };
 
 static int __update_mbr(struct __fat_filesystem* cfs, uint8* sector)
@@ -81,12 +116,382 @@ static int __update_mbr(struct __fat_filesystem* cfs, uint8* sector)
     return 0;
 }
 
-static int __write_reserved_image(struct __fat_filesystem* cfs)
+static int __stream_read(struct __fat_filesystem* cfs, uint64_t offset, void* buffer, size_t length)
+{
+    uint64_t partitionSize = cfs->sector_count * cfs->bytes_per_sector;
+    size_t   count = 0;
+
+    if (offset < partitionSize) {
+        if (fseek(cfs->stream, (long)offset, SEEK_SET)) {
+            return -1;
+        }
+        count = fread(buffer, 1, length, cfs->stream);
+        if (count < length && ferror(cfs->stream)) {
+            return -1;
+        }
+    }
+
+    // anything past the end of the stream reads as zeroes
+    if (count < length) {
+        memset((uint8_t*)buffer + count, 0, length - count);
+    }
+    return 0;
+}
+
+static int __stream_write(struct __fat_filesystem* cfs, uint64_t offset, const void* buffer, size_t length)
+{
+    uint64_t partitionSize = cfs->sector_count * cfs->bytes_per_sector;
+
+    // never grow the stream beyond the partition
+    if (offset >= partitionSize) {
+        return 0;
+    }
+    if (length > partitionSize - offset) {
+        length = (size_t)(partitionSize - offset);
+    }
+
+    if (fseek(cfs->stream, (long)offset, SEEK_SET)) {
+        return -1;
+    }
+    if (fwrite(buffer, 1, length, cfs->stream) != length) {
+        return -1;
+    }
+    return 0;
+}
+
+static int __cache_init(struct __fat_cache* cache, size_t size, size_t blockSize)
+{
+    size_t count, i;
+
+    if (size == 0) {
+        size = __CACHE_DEFAULT_SIZE;
+    }
+
+    cache->block_size = blockSize;
+    cache->sets = (size / blockSize) / __CACHE_WAYS;
+    if (cache->sets == 0) {
+        cache->sets = 1;
+    }
+    count = cache->sets * __CACHE_WAYS;
+
+    cache->blocks = calloc(count, sizeof(struct __fat_cache_block));
+    cache->memory = malloc(count * blockSize);
+    if (cache->blocks == NULL || cache->memory == NULL) {
+        free(cache->blocks);
+        free(cache->memory);
+        return -1;
+    }
+
+    for (i = 0; i < count; i++) {
+        cache->blocks[i].data = cache->memory + (i * blockSize);
+    }
+    return 0;
+}
+
+static void __cache_destroy(struct __fat_cache* cache)
+{
+    free(cache->blocks);
+    free(cache->memory);
+}
+
+static struct __fat_cache_block* __cache_find(struct __fat_cache* cache, uint64_t block)
+{
+    struct __fat_cache_block* set = &cache->blocks[(block % cache->sets) * __CACHE_WAYS];
+    int                       i;
+
+    for (i = 0; i < __CACHE_WAYS; i++) {
+        if (set[i].valid && set[i].block == block) {
+            return &set[i];
+        }
+    }
+    return NULL;
+}
+
+static int __cache_writeback(struct __fat_filesystem* cfs, struct __fat_cache_block* entry)
+{
+    if (!entry->dirty) {
+        return 0;
+    }
+    if (__stream_write(cfs, entry->block * cfs->cache.block_size, entry->data, cfs->cache.block_size)) {
+        VLOG_ERROR("fat", "__cache_writeback: failed to write block %llu\n", (unsigned long long)entry->block);
+        return -1;
+    }
+    entry->dirty = 0;
+    return 0;
+}
+
+static struct __fat_cache_block* __cache_get(struct __fat_filesystem* cfs, uint64_t block)
+{
+    struct __fat_cache*       cache = &cfs->cache;
+    struct __fat_cache_block* set;
+    struct __fat_cache_block* victim;
+    int                       i;
+
+    victim = __cache_find(cache, block);
+    if (victim != NULL) {
+        victim->used = ++cache->tick;
+        return victim;
+    }
+
+    // pick an unused way, or the least recently used one
+    set = &cache->blocks[(block % cache->sets) * __CACHE_WAYS];
+    victim = &set[0];
+    for (i = 0; i < __CACHE_WAYS; i++) {
+        if (!set[i].valid) {
+            victim = &set[i];
+            break;
+        }
+        if (set[i].used < victim->used) {
+            victim = &set[i];
+        }
+    }
+
+    if (victim->valid && __cache_writeback(cfs, victim)) {
+        return NULL;
+    }
+
+    victim->valid = 0;
+    if (__stream_read(cfs, block * cache->block_size, victim->data, cache->block_size)) {
+        VLOG_ERROR("fat", "__cache_get: failed to read block %llu\n", (unsigned long long)block);
+        return NULL;
+    }
+
+    victim->block = block;
+    victim->valid = 1;
+    victim->dirty = 0;
+    victim->used = ++cache->tick;
+    return victim;
+}
+
+// copies between <buffer> and the cached blocks overlapping it, used to keep
+// the cache coherent with requests that bypass it
+static void __cache_overlap(struct __fat_cache* cache, uint64_t offset, uint8_t* buffer, size_t length, int toCache)
+{
+    uint64_t block = offset / cache->block_size;
+    uint64_t last = (offset + length - 1) / cache->block_size;
+
+    for (; block <= last; block++) {
+        struct __fat_cache_block* entry = __cache_find(cache, block);
+        uint64_t                  start, end;
+
+        if (entry == NULL) {
+            continue;
+        }
+
+        start = block * cache->block_size;
+        end = start + cache->block_size;
+        if (start < offset) {
+            start = offset;
+        }
+        if (end > offset + length) {
+            end = offset + length;
+        }
+
+        if (toCache) {
+            memcpy(entry->data + (start - (block * cache->block_size)), buffer + (start - offset), (size_t)(end - start));
+        } else {
+            memcpy(buffer + (start - offset), entry->data + (start - (block * cache->block_size)), (size_t)(end - start));
+        }
+    }
+}
+
+static int __cache_io(struct __fat_filesystem* cfs, uint64_t sector, uint8_t* buffer, uint32_t sectorCount, int write)
+{
+    struct __fat_cache* cache = &cfs->cache;
+    uint64_t            offset = sector * cfs->bytes_per_sector;
+    size_t              length = (size_t)sectorCount * cfs->bytes_per_sector;
+
+    if (length >= cache->block_size) {
+        if (write) {
+            if (__stream_write(cfs, offset, buffer, length)) {
+                return -1;
+            }
+            __cache_overlap(cache, offset, buffer, length, 1);
+        } else {
+            if (__stream_read(cfs, offset, buffer, length)) {
+                return -1;
+            }
+            __cache_overlap(cache, offset, buffer, length, 0);
+        }
+        return 0;
+    }
+
+    while (length) {
+        struct __fat_cache_block* entry;
+        size_t                    within = (size_t)(offset % cache->block_size);
+        size_t                    count = cache->block_size - within;
+
+        if (count > length) {
+            count = length;
+        }
+
+        entry = __cache_get(cfs, offset / cache->block_size);
+        if (entry == NULL) {
+            return -1;
+        }
+
+        if (write) {
+            memcpy(entry->data + within, buffer, count);
+            entry->dirty = 1;
+        } else {
+            memcpy(buffer, entry->data + within, count);
+        }
+
+        offset += count;
+        buffer += count;
+        length -= count;
+    }
+    return 0;
+}
+
+static int __cache_compare_blocks(const void* a, const void* b)
+{
+    const struct __fat_cache_block* lh = *(const struct __fat_cache_block* const*)a;
+    const struct __fat_cache_block* rh = *(const struct __fat_cache_block* const*)b;
+    return (lh->block > rh->block) - (lh->block < rh->block);
+}
+
+static int __cache_flush(struct __fat_filesystem* cfs)
+{
+    struct __fat_cache*        cache = &cfs->cache;
+    struct __fat_cache_block** dirty;
+    size_t                     count = cache->sets * __CACHE_WAYS;
+    size_t                     dirtyCount = 0;
+    size_t                     i;
+    int                        status = 0;
+
+    dirty = malloc(count * sizeof(struct __fat_cache_block*));
+    if (dirty == NULL) {
+        return -1;
+    }
+
+    for (i = 0; i < count; i++) {
+        if (cache->blocks[i].valid && cache->blocks[i].dirty) {
+            dirty[dirtyCount++] = &cache->blocks[i];
+        }
+    }
+
+    // write back in disk order
+    qsort(dirty, dirtyCount, sizeof(struct __fat_cache_block*), __cache_compare_blocks);
+    for (i = 0; i < dirtyCount && status == 0; i++) {
+        status = __cache_writeback(cfs, dirty[i]);
+    }
+
+    free(dirty);
+    return status;
+}
+
+static void __cache_invalidate(struct __fat_cache* cache)
+{
+    size_t count = cache->sets * __CACHE_WAYS;
+    size_t i;
+
+    for (i = 0; i < count; i++) {
+        cache->blocks[i].valid = 0;
+        cache->blocks[i].dirty = 0;
+    }
+}
+
+static int __table_load(struct __fat_filesystem* cfs)
+{
+    struct __fat_table* table = &cfs->table;
+
+    // the FAT was just written through the cache by format, make sure the
+    // stream is up to date and that no cached copy outlives the mirror
+    if (__cache_flush(cfs)) {
+        return -1;
+    }
+    __cache_invalidate(&cfs->cache);
+
+    table->start = cfs->fs->fat_begin_lba;
+    table->sectors = cfs->fs->fat_sectors;
+    table->data = malloc((size_t)table->sectors * cfs->bytes_per_sector);
+    if (table->data == NULL) {
+        VLOG_ERROR("fat", "__table_load: failed to allocate memory for the FAT\n");
+        return -1;
+    }
+
+    if (__stream_read(cfs, (uint64_t)table->start * cfs->bytes_per_sector, table->data,
+                      (size_t)table->sectors * cfs->bytes_per_sector)) {
+        VLOG_ERROR("fat", "__table_load: failed to read the FAT\n");
+        free(table->data);
+        table->data = NULL;
+        return -1;
+    }
+    table->dirty = 0;
+    return 0;
+}
+
+static int __table_flush(struct __fat_filesystem* cfs)
+{
+    struct __fat_table* table = &cfs->table;
+
+    if (table->data == NULL || !table->dirty) {
+        return 0;
+    }
+
+    if (__stream_write(
+            cfs,
+            (uint64_t)(table->start + table->dirty_first) * cfs->bytes_per_sector,
+            table->data + ((size_t)table->dirty_first * cfs->bytes_per_sector),
+            (size_t)(table->dirty_last - table->dirty_first + 1) * cfs->bytes_per_sector)) {
+        VLOG_ERROR("fat", "__table_flush: failed to write the FAT\n");
+        return -1;
+    }
+    table->dirty = 0;
+    return 0;
+}
+
+// routes a sector request to the FAT mirror or the cache
+static int __media_io(struct __fat_filesystem* cfs, uint32_t sector, uint8_t* buffer, uint32_t sectorCount, int write)
+{
+    struct __fat_table* table = &cfs->table;
+
+    while (sectorCount) {
+        uint32_t count = sectorCount;
+
+        if (table->data != NULL && sector >= table->start && (sector - table->start) < table->sectors) {
+            uint32_t index = sector - table->start;
+            uint8_t* data = table->data + ((size_t)index * cfs->bytes_per_sector);
+
+            if (count > table->sectors - index) {
+                count = table->sectors - index;
+            }
+
+            if (write) {
+                memcpy(data, buffer, (size_t)count * cfs->bytes_per_sector);
+                if (!table->dirty || index < table->dirty_first) {
+                    table->dirty_first = index;
+                }
+                if (!table->dirty || (index + count - 1) > table->dirty_last) {
+                    table->dirty_last = index + count - 1;
+                }
+                table->dirty = 1;
+            } else {
+                memcpy(buffer, data, (size_t)count * cfs->bytes_per_sector);
+            }
+        } else {
+            if (table->data != NULL && sector < table->start && (table->start - sector) < count) {
+                count = table->start - sector;
+            }
+            if (__cache_io(cfs, sector, buffer, count, write)) {
+                return -1;
+            }
+        }
+
+        sector += count;
+        buffer += (size_t)count * cfs->bytes_per_sector;
+        sectorCount -= count;
+    }
+    return 0;
+}
+
+static int __write_reserved_image(struct __fat_filesystem* cfs, uint64_t offset)
 {
     struct platform_stat stats;
     char                 tmp[PATH_MAX];
     void*                buffer;
-    size_t               size, written;
+    size_t               size;
     int                  status;
 
     if (cfs->content == NULL && cfs->options.reserved_image == NULL) {
@@ -113,8 +518,8 @@ static int __write_reserved_image(struct __fat_filesystem* cfs)
         return status;
     }
 
-    written = fwrite(buffer, size, 1, cfs->stream);
-    if (written != size) {
+    status = __stream_write(cfs, offset, buffer, size);
+    if (status) {
         VLOG_ERROR("fat", "__write_reserved_image: failed to write reserved sectors\n");
         free(buffer);
         return -1;
@@ -128,31 +533,30 @@ static int __write_reserved_image(struct __fat_filesystem* cfs)
 static int __partition_read(uint32 sector, uint8 *buffer, uint32 sector_count, void* ctx)
 {
     struct __fat_filesystem* cfs = ctx;
-    uint64_t                 offset;
-    int                      status;
-
-    // make sure we get the stream position
-    offset = sector * cfs->bytes_per_sector;
-    status = fseek(cfs->stream, (long)offset, SEEK_SET);
-
-    fread(buffer, cfs->bytes_per_sector, sector_count, cfs->stream);
-    return 1;
+    return __media_io(cfs, sector, buffer, sector_count, 0) == 0 ? 1 : 0;
 }
 
 // return 0 for error, 1 for ok
 static int __partition_write(uint32 sector, uint8 *buffer, uint32 sector_count, void* ctx)
 {
     struct __fat_filesystem* cfs = ctx;
-    uint64_t                 offset;
     int                      status;
 
-    // make sure we get the stream position
-    offset = sector * cfs->bytes_per_sector;
-    status = fseek(cfs->stream, (long)offset, SEEK_SET);
+    if (sector != 0) {
+        return __media_io(cfs, sector, buffer, sector_count, 1) == 0 ? 1 : 0;
+    }
+
+    // the boot sector is written through together with the reserved image,
+    // which lands on top of whatever was written before it, so get pending
+    // writes out first and drop the cached view of the sectors it replaces
+    if (__cache_flush(cfs)) {
+        return 0;
+    }
+    __cache_invalidate(&cfs->cache);
 
     // if the sector is 0, then let us modify the boot sector with the
     // MBR provided by content
-    if (sector == 0 && cfs->content != NULL) {
+    if (cfs->content != NULL) {
         status = __update_mbr(cfs, buffer);
         if (status) {
             VLOG_ERROR("fat", "failed to update mbr sector\n");
@@ -160,16 +564,18 @@ static int __partition_write(uint32 sector, uint8 *buffer, uint32 sector_count,
         }
     }
 
-    fwrite(buffer, cfs->bytes_per_sector, sector_count, cfs->stream);
+    status = __stream_write(cfs, 0, buffer, (size_t)sector_count * cfs->bytes_per_sector);
+    if (status) {
+        VLOG_ERROR("fat", "failed to write boot sector\n");
+        return 0;
+    }
 
     // let us write the reserved image contents
     // at the same time
-    if (sector == 0) {
-        status = __write_reserved_image(cfs);
-        if (status) {
-            VLOG_ERROR("fat", "failed to write reserved image\n");
-            return 0;
-        }
+    status = __write_reserved_image(cfs, (uint64_t)sector_count * cfs->bytes_per_sector);
+    if (status) {
+        VLOG_ERROR("fat", "failed to write reserved image\n");
+        return 0;
     }
     return 1;
 }
@@ -202,7 +608,10 @@ static int __fs_format(struct chef_disk_filesystem* fs)
     }
     // fat library will always return 1 for success, 0 for failure
     // we need to invert that to match api expectations
-    return fl_format(cfs->fs, (uint32_t)cfs->sector_count, cfs->label) == 1 ? 0 : -1;
+    if (fl_format(cfs->fs, (uint32_t)cfs->sector_count, cfs->label) != 1) {
+        return -1;
+    }
+    return __table_load(cfs);
 }
 
 static int __fs_create_directory(struct chef_disk_filesystem* fs, struct chef_disk_fs_create_directory_params* params)
@@ -217,7 +626,9 @@ static int __fs_create_file(struct chef_disk_filesystem* fs, struct chef_disk_fs
     FL_FILE*                 stream;
     int                      written;
 
-    stream = fl_fopen(cfs->fs, params->path, "w");
+    // the size is known up front, which lets the allocator reserve
+    // one contiguous run of clusters for the whole file
+    stream = fl_fcreate(cfs->fs, params->path, (uint32_t)params->size);
     if (stream == NULL) {
         return -1;
     }
@@ -273,9 +684,23 @@ static int __fs_write_raw(struct chef_disk_filesystem* fs, struct chef_disk_fs_w
 static int __fs_finish(struct chef_disk_filesystem* fs)
 {
     struct __fat_filesystem* cfs = (struct __fat_filesystem*)fs;
+    int                      status;
+
+    // deleting the instance purges the FAT buffers into the mirror, after
+    // which the cache is written back before the FAT that describes it
     fl_delete(cfs->fs);
+    status = __cache_flush(cfs);
+    if (status == 0) {
+        status = __table_flush(cfs);
+    }
+    if (status) {
+        VLOG_ERROR("fat", "__fs_finish: failed to write back pending sectors\n");
+    }
+
+    __cache_destroy(&cfs->cache);
+    free(cfs->table.data);
     free(cfs);
-    return 0;
+    return status;
 }
 
 struct chef_disk_filesystem* chef_filesystem_fat32_new(struct chef_disk_partition* partition, struct chef_disk_filesystem_params* params)
@@ -304,6 +729,14 @@ struct chef_disk_filesystem* chef_filesystem_fat32_new(struct chef_disk_partitio
 
     // copy options
     cfs->options.reserved_image = params->options.fat.reserved_image;
+    cfs->options.cache_size = params->options.fat.cache_size;
+
+    if (__cache_init(&cfs->cache, cfs->options.cache_size, (size_t)__CACHE_BLOCK_SECTORS * cfs->bytes_per_sector)) {
+        VLOG_ERROR("fat", "chef_filesystem_fat32_new: failed to allocate the sector cache\n");
+        fl_delete(cfs->fs);
+        free(cfs);
+        return NULL;
+    }
 
     // install operations
     cfs->base.set_content = __fs_set_content;
@@ -87,7 +87,7 @@ static int __write_reserved_image(struct __mfs_filesystem* cfs)
     struct platform_stat stats;
     char                 tmp[PATH_MAX];
     void*                buffer;
-    size_t               size, written;
+    size_t               size;
     int                  status;
 
     // must have content set
@@ -111,8 +111,7 @@ static int __write_reserved_image(struct __mfs_filesystem* cfs)
         return status;
     }
 
-    written = fwrite(buffer, size, 1, cfs->stream);
-    if (written != size) {
+    if (fwrite(buffer, 1, size, cfs->stream) != size) {
         VLOG_ERROR("mfs", "__update_mbr: failed to write reserved sectors\n");
         free(buffer);
         return -1;
@@ -250,9 +249,17 @@ static int __fs_write_raw(struct chef_disk_filesystem* fs, struct chef_disk_fs_w
 static int __fs_finish(struct chef_disk_filesystem* fs)
 {
     struct __mfs_filesystem* cfs = (struct __mfs_filesystem*)fs;
+    int                      status;
+
+    // the bucket map is only kept in memory until now
+    status = mfs_flush(cfs->fs);
+    if (status) {
+        VLOG_ERROR("mfs", "__fs_finish: failed to flush filesystem\n");
+    }
+
     mfs_delete(cfs->fs);
     free(cfs);
-    return 0;
+    return status;
 }
 
 struct chef_disk_filesystem* chef_filesystem_mfs_new(struct chef_disk_partition* partition, struct chef_disk_filesystem_params* params)
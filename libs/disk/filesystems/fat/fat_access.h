@@ -72,6 +72,7 @@ struct fatfs
     uint32                  lba_begin;
     uint32                  fat_sectors;
     uint32                  next_free_cluster;
+    uint32                  free_cluster_hint;
     uint16                  root_entry_count;
     uint16                  reserved_sectors;
     uint8                   num_of_fats;
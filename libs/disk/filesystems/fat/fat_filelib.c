@@ -375,10 +375,10 @@ static FL_FILE* _open_file(struct fatfs* fs, const char *path)
     return NULL;
 }
 //-----------------------------------------------------------------------------
-// _create_file: Create a new file
+// _create_file: Create a new file, reserving space for 'size' bytes up front
 //-----------------------------------------------------------------------------
 #if FATFS_INC_WRITE_SUPPORT
-static FL_FILE* _create_file(struct fatfs* fs, const char *filename)
+static FL_FILE* _create_file(struct fatfs* fs, const char *filename, uint32 size)
 {
     FL_FILE* file;
     struct fat_dir_entry sfEntry;
@@ -435,7 +435,7 @@ static FL_FILE* _create_file(struct fatfs* fs, const char *filename)
     file->startcluster = 0;
 
     // Create the file space for the file (at least one clusters worth!)
-    if (!fatfs_allocate_free_space(fs, 1, &file->startcluster, 1))
+    if (!fatfs_allocate_free_space(fs, 1, &file->startcluster, size ? size : 1))
     {
         _free_file(fs, file);
         return NULL;
@@ -775,7 +775,7 @@ void* fl_fopen(struct fatfs* fs, const char *path, const char *mode)
     // Create New
 #if FATFS_INC_WRITE_SUPPORT
     if (!file && (flags & FILE_CREATE))
-        file = _create_file(fs, path);
+        file = _create_file(fs, path, 0);
 #endif
 
     // Write Existing (and not open due to read or create)
@@ -791,6 +791,68 @@ void* fl_fopen(struct fatfs* fs, const char *path, const char *mode)
     return file;
 }
 //-----------------------------------------------------------------------------
+// fl_fcreate: Create a file for writing whose final size is known, the
+// clusters for all of it are reserved (contiguously when possible) up front.
+// Behaves like fl_fopen(path, "w") if the file already exists.
+//-----------------------------------------------------------------------------
+#if FATFS_INC_WRITE_SUPPORT
+void* fl_fcreate(struct fatfs* fs, const char *path, uint32 size)
+{
+    FL_FILE* file;
+    uint8 flags = FILE_WRITE | FILE_ERASE | FILE_CREATE;
+
+    if (!fs->valid || !path)
+        return NULL;
+
+    if (!fs->disk_io.write_media)
+        return NULL;
+
+    FL_LOCK(fs);
+
+    file = _create_file(fs, path, size);
+    if (!file)
+        file = _open_file(fs, path);
+
+    if (file)
+        file->flags = flags;
+
+    FL_UNLOCK(fs);
+    return file;
+}
+#endif
+//-----------------------------------------------------------------------------
+// _trim_file: Release the clusters past the end of the file, these are left
+// over when fewer bytes were written than fl_fcreate reserved space for
+//-----------------------------------------------------------------------------
+#if FATFS_INC_WRITE_SUPPORT
+static void _trim_file(struct fatfs* fs, FL_FILE* file)
+{
+    uint32 clusterSize = fs->sectors_per_cluster * FAT_SECTOR_SIZE;
+    uint32 clusters = (file->filelength / clusterSize) + ((file->filelength % clusterSize) ? 1 : 0);
+    uint32 cluster = file->startcluster;
+    uint32 nextCluster;
+    uint32 i;
+
+    // A file always keeps its first cluster
+    if (clusters == 0)
+        clusters = 1;
+
+    for (i = 1; i < clusters; i++)
+    {
+        cluster = fatfs_find_next_cluster(fs, cluster);
+        if (cluster == FAT32_LAST_CLUSTER)
+            return;
+    }
+
+    nextCluster = fatfs_find_next_cluster(fs, cluster);
+    if (nextCluster == FAT32_LAST_CLUSTER)
+        return;
+
+    fatfs_fat_set_cluster(fs, cluster, FAT32_LAST_CLUSTER);
+    fatfs_free_cluster_chain(fs, nextCluster);
+}
+#endif
+//-----------------------------------------------------------------------------
 // _write_sectors: Write sector(s) to disk
 //-----------------------------------------------------------------------------
 #if FATFS_INC_WRITE_SUPPORT
@@ -803,6 +865,7 @@ static uint32 _write_sectors(struct fatfs* fs, FL_FILE* file, uint32 offset, uin
     uint32 i;
     uint32 lba;
     uint32 TotalWriteCount = count;
+    uint32 LastClusterIdx = 0;
 
     // Find values for Cluster index & sector within cluster
     ClusterIdx = offset / fs->sectors_per_cluster;
@@ -848,6 +911,7 @@ static uint32 _write_sectors(struct fatfs* fs, FL_FILE* file, uint32 offset, uin
             }
 
             LastCluster = Cluster;
+            LastClusterIdx = i;
             Cluster = nextCluster;
 
             // Dont keep following a dead end
@@ -863,6 +927,9 @@ static uint32 _write_sectors(struct fatfs* fs, FL_FILE* file, uint32 offset, uin
                 return 0;
 
             Cluster = LastCluster;
+
+            // The cached link of the old tail still says end of chain
+            fatfs_cache_set_next_cluster(fs, file, LastClusterIdx, Cluster);
         }
 
         // Record current cluster lookup details
@@ -873,6 +940,33 @@ static uint32 _write_sectors(struct fatfs* fs, FL_FILE* file, uint32 offset, uin
     // Calculate write address
     lba = fatfs_lba_of_cluster(fs, Cluster) + SectorNumber;
 
+    // Extend the write over clusters that follow on disk, which is the
+    // common case for files whose space was reserved by fl_fcreate
+    while ((count < TotalWriteCount) && (((SectorNumber + count) % fs->sectors_per_cluster) == 0))
+    {
+        uint32 nextCluster;
+
+        if (!fatfs_cache_get_next_cluster(fs, file, ClusterIdx, &nextCluster))
+        {
+            nextCluster = fatfs_find_next_cluster(fs, Cluster);
+            fatfs_cache_set_next_cluster(fs, file, ClusterIdx, nextCluster);
+        }
+
+        if (nextCluster != (Cluster + 1))
+            break;
+
+        Cluster = nextCluster;
+        ClusterIdx++;
+
+        if ((TotalWriteCount - count) > fs->sectors_per_cluster)
+            count += fs->sectors_per_cluster;
+        else
+            count = TotalWriteCount;
+
+        file->last_fat_lookup.CurrentCluster = Cluster;
+        file->last_fat_lookup.ClusterIdx = ClusterIdx;
+    }
+
     if (fatfs_sector_write(fs, lba, buf, count))
         return count;
     else
@@ -918,6 +1012,12 @@ void fl_fclose(struct fatfs* fs, void *f)
         // Flush un-written data to file
         fl_fflush(fs, f);
 
+#if FATFS_INC_WRITE_SUPPORT
+        // Give back any reserved space that was not written
+        if ((file->flags & FILE_WRITE) && file->startcluster != 0)
+            _trim_file(fs, file);
+#endif
+
         // File size changed?
         if (file->filelength_changed)
         {
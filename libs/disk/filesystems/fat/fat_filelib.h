@@ -83,6 +83,7 @@ void                fl_delete(struct fatfs* fs);
 
 // Standard API
 void*               fl_fopen(struct fatfs* fs, const char *path, const char *modifiers);
+void*               fl_fcreate(struct fatfs* fs, const char *path, uint32 size);
 void                fl_fclose(struct fatfs* fs, void *file);
 int                 fl_fflush(struct fatfs* fs, void *file);
 int                 fl_fgetc(struct fatfs* fs, void *file);
@@ -26,19 +26,21 @@
 
 // Number of sectors per FAT_BUFFER (min 1)
 #ifndef FAT_BUFFER_SECTORS
-    #define FAT_BUFFER_SECTORS              1
+    #define FAT_BUFFER_SECTORS              8
 #endif
 
 // Max FAT sectors to buffer (min 1)
 // (mem used is FAT_BUFFERS * FAT_BUFFER_SECTORS * FAT_SECTOR_SIZE)
 #ifndef FAT_BUFFERS
-    #define FAT_BUFFERS                     1
+    #define FAT_BUFFERS                     8
 #endif
 
 // Size of cluster chain cache (can be undefined)
 // Mem used = FAT_CLUSTER_CACHE_ENTRIES * 4 * 2
 // Improves access speed considerably
-//#define FAT_CLUSTER_CACHE_ENTRIES         128
+#ifndef FAT_CLUSTER_CACHE_ENTRIES
+    #define FAT_CLUSTER_CACHE_ENTRIES       128
+#endif
 
 // Include support for writing files (1 / 0)?
 #ifndef FATFS_INC_WRITE_SUPPORT
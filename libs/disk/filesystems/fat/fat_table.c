@@ -64,6 +64,9 @@ void fatfs_fat_init(struct fatfs *fs)
     // FAT buffer chain head
     fs->fat_buffer_head = NULL;
 
+    // No clusters are known to be in use yet
+    fs->free_cluster_hint = 0;
+
     for (i=0;i<FAT_BUFFERS;i++)
     {
         // Initialise buffers to invalid
@@ -159,8 +162,11 @@ static struct fat_buffer *fatfs_fat_read_sector(struct fatfs *fs, uint32 sector)
         if (!fatfs_fat_writeback(fs, pcur))
             return 0;
 
-    // Address is now new sector
+    // Address is now new sector, FAT sectors are buffered at aligned
+    // offsets so that two buffers never hold the same sector
     pcur->address = sector;
+    if (sector >= fs->fat_begin_lba)
+        pcur->address -= (sector - fs->fat_begin_lba) % FAT_BUFFER_SECTORS;
 
     // Read next sector
     if (!fs->disk_io.read_media(pcur->address, pcur->sector, FAT_BUFFER_SECTORS, fs->disk_io.user_ctx))
@@ -170,7 +176,7 @@ static struct fat_buffer *fatfs_fat_read_sector(struct fatfs *fs, uint32 sector)
         return NULL;
     }
 
-    pcur->ptr = pcur->sector;
+    pcur->ptr = (uint8 *)(pcur->sector + ((sector - pcur->address) * FAT_SECTOR_SIZE));
     return pcur;
 }
 //-----------------------------------------------------------------------------
@@ -292,6 +298,10 @@ int fatfs_find_blank_cluster(struct fatfs *fs, uint32 start_cluster, uint32 *fre
     uint32 current_cluster = start_cluster;
     struct fat_buffer *pbuf;
 
+    // Everything below the hint is known to be in use
+    if (current_cluster < fs->free_cluster_hint)
+        current_cluster = fs->free_cluster_hint;
+
     do
     {
         // Find which sector of FAT table to read
@@ -338,10 +348,88 @@ int fatfs_find_blank_cluster(struct fatfs *fs, uint32 start_cluster, uint32 *fre
 
     // Found blank entry
     *free_cluster = current_cluster;
+    fs->free_cluster_hint = current_cluster;
     return 1;
 }
 #endif
 //-----------------------------------------------------------------------------
+// fatfs_find_blank_run: Find 'count' consecutive free cluster entries by
+// reading the FAT. Used to lay out files of known size contiguously.
+//-----------------------------------------------------------------------------
+#if FATFS_INC_WRITE_SUPPORT
+int fatfs_find_blank_run(struct fatfs *fs, uint32 start_cluster, uint32 count, uint32 *free_cluster)
+{
+    uint32 fat_sector_offset, position;
+    uint32 nextcluster;
+    uint32 current_cluster = start_cluster;
+    uint32 run_start = 0;
+    uint32 run_length = 0;
+    uint32 first_free = 0;
+    struct fat_buffer *pbuf;
+
+    if (count == 0)
+        return 0;
+
+    // Everything below the hint is known to be in use
+    if (current_cluster < fs->free_cluster_hint)
+        current_cluster = fs->free_cluster_hint;
+
+    for (;;)
+    {
+        // Find which sector of FAT table to read
+        if (fs->fat_type == FAT_TYPE_16)
+            fat_sector_offset = current_cluster / 256;
+        else
+            fat_sector_offset = current_cluster / 128;
+
+        // Run out of FAT sectors to check...
+        if (fat_sector_offset >= fs->fat_sectors)
+            break;
+
+        // Read FAT sector into buffer
+        pbuf = fatfs_fat_read_sector(fs, fs->fat_begin_lba+fat_sector_offset);
+        if (!pbuf)
+            return 0;
+
+        if (fs->fat_type == FAT_TYPE_16)
+        {
+            position = (current_cluster - (fat_sector_offset * 256)) * 2;
+            nextcluster = FAT16_GET_16BIT_WORD(pbuf, (uint16)position);
+        }
+        else
+        {
+            position = (current_cluster - (fat_sector_offset * 128)) * 4;
+            nextcluster = FAT32_GET_32BIT_WORD(pbuf, (uint16)position) & 0x0FFFFFFF;
+        }
+
+        if (nextcluster == 0)
+        {
+            if (!first_free)
+                first_free = current_cluster;
+
+            if (!run_length)
+                run_start = current_cluster;
+
+            if (++run_length == count)
+            {
+                *free_cluster = run_start;
+                fs->free_cluster_hint = first_free;
+                return 1;
+            }
+        }
+        else
+            run_length = 0;
+
+        current_cluster++;
+    }
+
+    // No run large enough, but the scan still tells us where the free space starts
+    if (first_free)
+        fs->free_cluster_hint = first_free;
+    return 0;
+}
+#endif
+//-----------------------------------------------------------------------------
 // fatfs_fat_set_cluster: Set a cluster link in the chain. NOTE: Immediate
 // write (slow).
 //-----------------------------------------------------------------------------
@@ -362,6 +450,10 @@ int fatfs_fat_set_cluster(struct fatfs *fs, uint32 cluster, uint32 next_cluster)
     if (!pbuf)
         return 0;
 
+    // Keep the free cluster hint below any cluster being released
+    if (next_cluster == 0 && cluster < fs->free_cluster_hint)
+        fs->free_cluster_hint = cluster;
+
     if (fs->fat_type == FAT_TYPE_16)
     {
         // Find 16 bit entry of current sector relating to cluster number
@@ -103,16 +103,31 @@ int fatfs_allocate_free_space(struct fatfs *fs, int newFile, uint32 *startCluste
     // Allocated first link in the chain if a new file
     if (newFile)
     {
+        uint32 i;
+
+        // Prefer laying the whole file out in one contiguous run
+        if (clusterCount > 1 && fatfs_find_blank_run(fs, fs->rootdir_first_cluster, clusterCount, &nextcluster))
+        {
+            for (i = 0; i < (clusterCount - 1); i++)
+                fatfs_fat_set_cluster(fs, nextcluster + i, nextcluster + i + 1);
+            fatfs_fat_set_cluster(fs, nextcluster + i, FAT32_LAST_CLUSTER);
+
+            *startCluster = nextcluster;
+            return 1;
+        }
+
         if (!fatfs_find_blank_cluster(fs, fs->rootdir_first_cluster, &nextcluster))
             return 0;
 
+        fatfs_fat_set_cluster(fs, nextcluster, FAT32_LAST_CLUSTER);
+        *startCluster = nextcluster;
+
         // If this is all that is needed then all done
         if (clusterCount==1)
-        {
-            fatfs_fat_set_cluster(fs, nextcluster, FAT32_LAST_CLUSTER);
-            *startCluster = nextcluster;
             return 1;
-        }
+
+        // The first link is in place, the rest is added to its tail
+        clusterCount--;
     }
     // Allocate from end of current chain (startCluster is end of chain)
     else
@@ -44,6 +44,7 @@ extern void mfs_delete(struct mfs* mfs);
 
 extern void mfs_set_reserved_sectors(struct mfs* mfs, uint16_t count);
 extern int  mfs_format(struct mfs* mfs);
+extern int  mfs_flush(struct mfs* mfs);
 
 enum mfs_record_flags
 {
@@ -30,9 +30,17 @@ struct mfs_bucket_map {
     uint16_t                       sectors_per_bucket;
     uint64_t                       map_sector;
     uint32_t                       next_free_bucket;
+
+    // The map is kept in memory while the image is built, the sectors that
+    // were touched are written back in one go by mfs_bucket_map_flush.
+    uint32_t*                      entries;
+    uint32_t                       map_sector_count;
+    uint32_t                       dirty_first;
+    uint32_t                       dirty_last;
+    int                            dirty;
 };
 
-struct mfs_bucket_map* mfs_bucket_new(struct mfs_storage_operations* ops, uint64_t sector, uint32_t sectorCount, uint16_t sectorsPerBucket)
+struct mfs_bucket_map* mfs_bucket_new(struct mfs_storage_operations* ops, uint64_t sector, uint32_t sectorCount, uint16_t sectorsPerBucket, uint16_t bytesPerSector)
 {
     struct mfs_bucket_map* map;
 
@@ -42,6 +50,7 @@ struct mfs_bucket_map* mfs_bucket_new(struct mfs_storage_operations* ops, uint64
     }
 
     map->ops = ops;
+    map->bytes_per_sector = bytesPerSector;
     map->sector = sector;
     map->sector_count = sectorCount;
     map->sectors_per_bucket = sectorsPerBucket;
@@ -53,6 +62,7 @@ void mfs_bucket_delete(struct mfs_bucket_map* map)
     if (map == NULL) {
         return;
     }
+    free(map->entries);
     free(map);
 }
 
@@ -71,11 +81,36 @@ uint64_t mfs_bucket_map_size(struct mfs_bucket_map* map)
     return (map->sector_count / map->sectors_per_bucket) * (uint64_t)MAPENTRY_SIZE;
 }
 
+static void __allocate_entries(struct mfs_bucket_map* map)
+{
+    uint64_t maxMapSize = mfs_bucket_map_size(map);
+
+    map->map_sector_count = (uint32_t)((maxMapSize + (map->bytes_per_sector - 1)) / map->bytes_per_sector);
+    map->entries = calloc(map->map_sector_count, map->bytes_per_sector);
+    if (map->entries == NULL) {
+        VLOG_FATAL("mfs-bucket-map", "__allocate_entries: no memory for the bucket map\n");
+    }
+}
+
+static void __mark_dirty(struct mfs_bucket_map* map, uint32_t bucket)
+{
+    uint32_t sector = (uint32_t)(((uint64_t)bucket * MAPENTRY_SIZE) / map->bytes_per_sector);
+
+    if (!map->dirty || sector < map->dirty_first) {
+        map->dirty_first = sector;
+    }
+    if (!map->dirty || sector > map->dirty_last) {
+        map->dirty_last = sector;
+    }
+    map->dirty = 1;
+}
+
 // length is upper dword, link is lower dword
-static void __write_entry_to_buffer(uint32_t* buffer, uint32_t index, uint32_t length, uint32_t nextBucket)
+static void __write_entry(struct mfs_bucket_map* map, uint32_t bucket, uint32_t length, uint32_t nextBucket)
 {
-    buffer[index*2] = nextBucket;
-    buffer[(index*2)+1] = length;
+    map->entries[bucket*2] = nextBucket;
+    map->entries[(bucket*2)+1] = length;
+    __mark_dirty(map, bucket);
 }
 
 void mfs_bucket_initialize(struct mfs_bucket_map* map)
@@ -100,38 +135,42 @@ void mfs_bucket_initialize(struct mfs_bucket_map* map)
     // To get the length of the link, you must lookup it's length by accessing Map[Link]
     // Length of bucket 0 is HIDWORD(Map[0]), Link of bucket 0 is LODWORD(Map[0])
     // If the link equals 0xFFFFFFFF there is no link
-    uint8_t* sector = calloc(1, map->bytes_per_sector);
-    if (sector == NULL) {
-        VLOG_FATAL("mfs-bucket-map", "mfs_bucket_initialize: no memory for sector buffer\n");
-    }
-    __write_entry_to_buffer((uint32_t*)sector, 0, mapBucketCount, MFS_ENDOFCHAIN);
-    if (map->ops->write(map->map_sector, sector, 1, map->ops->op_context)) {
-        VLOG_FATAL("mfs-bucket-map", "mfs_bucket_initialize: failed to write map sector\n");
-    }
-    free(sector);
+    __allocate_entries(map);
+    __write_entry(map, 0, mapBucketCount, MFS_ENDOFCHAIN);
+    map->next_free_bucket = 0;
 }
 
 void mfs_bucket_open(struct mfs_bucket_map* map, uint64_t mapSector, uint32_t nextFreeBucket)
 {
     map->map_sector = mapSector;
     map->next_free_bucket = nextFreeBucket;
+
+    __allocate_entries(map);
+    if (map->ops->read(map->map_sector, (uint8_t*)map->entries, map->map_sector_count, map->ops->op_context)) {
+        VLOG_FATAL("mfs-bucket-map", "mfs_bucket_open: failed to read the bucket map\n");
+    }
 }
 
-static uint32_t* __read_sector(struct mfs_bucket_map* map, uint64_t sector, uint32_t count)
+int mfs_bucket_map_flush(struct mfs_bucket_map* map)
 {
-    uint32_t* buffer;
-    int       status;
+    int status;
 
-    buffer = malloc(count * map->bytes_per_sector);
-    if (buffer == NULL) {
-        VLOG_FATAL("mfs-bucket-map", "__read_sector: failed to allocate memory for buffer\n");
+    if (!map->dirty) {
+        return 0;
     }
 
-    status = map->ops->read(map->map_sector + sector, (uint8_t*)buffer, count, map->ops->op_context);
+    status = map->ops->write(
+        map->map_sector + map->dirty_first,
+        (uint8_t*)map->entries + ((size_t)map->dirty_first * map->bytes_per_sector),
+        (map->dirty_last - map->dirty_first) + 1,
+        map->ops->op_context
+    );
     if (status) {
-        VLOG_FATAL("mfs-bucket-map", "__read_sector: failed to read sector\n");
+        VLOG_ERROR("mfs-bucket-map", "mfs_bucket_map_flush: failed to write map sectors\n");
+        return status;
     }
-    return buffer;
+    map->dirty = 0;
+    return 0;
 }
 
 uint32_t mfs_bucket_map_allocate(struct mfs_bucket_map* map, uint32_t bucketCount, uint32_t* sizeOfFirstBucket)
@@ -141,7 +180,6 @@ uint32_t mfs_bucket_map_allocate(struct mfs_bucket_map* map, uint32_t bucketCoun
         return MFS_ENDOFCHAIN;
     }
 
-    uint32_t mapEntriesPerSector = map->bytes_per_sector / 8;
     uint32_t allocation = map->next_free_bucket;
 
     uint32_t bucketsLeft = bucketCount;
@@ -150,14 +188,11 @@ uint32_t mfs_bucket_map_allocate(struct mfs_bucket_map* map, uint32_t bucketCoun
     uint32_t firstFreeSize = 0;
 
     while (bucketsLeft > 0) {
-        uint32_t  sizeOfBucket = 0;
-        uint32_t  sectorOffset = bucketLink / mapEntriesPerSector; // entry offset (sector)
-        uint32_t  sectorIndex = bucketLink % mapEntriesPerSector;  // entry offset (in-sector)
-        uint32_t* sectorBuffer = __read_sector(map, sectorOffset, 1);
+        uint32_t sizeOfBucket = 0;
 
         bucketLinkPrevious = bucketLink;
-        bucketLink = sectorBuffer[sectorIndex * 2]; // link is lower DWORD
-        sizeOfBucket = sectorBuffer[(sectorIndex * 2) + 1]; // length of bucket is upper DWORD
+        bucketLink = map->entries[bucketLinkPrevious * 2]; // link is lower DWORD
+        sizeOfBucket = map->entries[(bucketLinkPrevious * 2) + 1]; // length of bucket is upper DWORD
 
         // Did this block have enough for us?
         if (sizeOfBucket > bucketsLeft) {
@@ -172,31 +207,15 @@ uint32_t mfs_bucket_map_allocate(struct mfs_bucket_map* map, uint32_t bucketCoun
             // We have to adjust now, since we are taking only a chunk
             // of the available length.
             // bucketsLeft = size we allocate.
-            __write_entry_to_buffer(sectorBuffer, sectorIndex, bucketsLeft, MFS_ENDOFCHAIN);
-            if (map->ops->write(map->map_sector + sectorOffset, (uint8_t*)sectorBuffer, 1, map->ops->op_context)) {
-                VLOG_FATAL("mfs-bucket-map", "mfs_bucket_map_allocate: failed to write map sector\n");
-            }
+            __write_entry(map, bucketLinkPrevious, bucketsLeft, MFS_ENDOFCHAIN);
 
-            // Create new block at the next link. Recalculate position
-            sectorOffset = nextFreeBucket / mapEntriesPerSector;
-            sectorIndex = nextFreeBucket % mapEntriesPerSector;
-
-            // Update the map entry
-            if (map->ops->read(map->map_sector + sectorOffset, (uint8_t*)sectorBuffer, 1, map->ops->op_context)) {
-                VLOG_FATAL("mfs-bucket-map", "mfs_bucket_map_allocate: failed to read map sector\n");
-            }
-            __write_entry_to_buffer(sectorBuffer, sectorIndex, nextFreeCount, bucketLink);
-            if (map->ops->write(map->map_sector + sectorOffset, (uint8_t*)sectorBuffer, 1, map->ops->op_context)) {
-                VLOG_FATAL("mfs-bucket-map", "mfs_bucket_map_allocate: failed to write map sector\n");
-            }
-            free(sectorBuffer);
+            // Create new block at the next link
+            __write_entry(map, nextFreeBucket, nextFreeCount, bucketLink);
 
             map->next_free_bucket = nextFreeBucket;
             *sizeOfFirstBucket = firstFreeSize;
             return allocation;
         } else {
-            free(sectorBuffer);
-
             // We can just take the whole cake no need to modify it's length 
             if (firstFreeSize == 0)  {
                 firstFreeSize = sizeOfBucket;
@@ -212,16 +231,8 @@ uint32_t mfs_bucket_map_allocate(struct mfs_bucket_map* map, uint32_t bucketCoun
 
     // Update BucketPrevPtr to MFS_ENDOFCHAIN
     if (bucketLinkPrevious != MFS_ENDOFCHAIN) {
-        uint32_t  __sectorOffset = bucketLinkPrevious / mapEntriesPerSector;
-        uint32_t  __sectorIndex = bucketLinkPrevious % mapEntriesPerSector;
-        uint32_t* __sectorBuffer = __read_sector(map, __sectorOffset, 1);
-
-        // Modify link
-        __sectorBuffer[__sectorIndex * 2] = MFS_ENDOFCHAIN;
-        if (map->ops->write(map->map_sector + __sectorOffset, (uint8_t*)__sectorBuffer, 1, map->ops->op_context)) {
-            VLOG_FATAL("mfs-bucket-map", "mfs_bucket_map_allocate: failed to write map sector\n");
-        }
-        free(__sectorBuffer);
+        map->entries[bucketLinkPrevious * 2] = MFS_ENDOFCHAIN;
+        __mark_dirty(map, bucketLinkPrevious);
     }
 
     map->next_free_bucket = bucketLink;
@@ -231,38 +242,13 @@ uint32_t mfs_bucket_map_allocate(struct mfs_bucket_map* map, uint32_t bucketCoun
 
 uint32_t mfs_bucket_map_bucket_info(struct mfs_bucket_map* map, uint32_t bucket, uint32_t* length)
 {
-    // Calculate index into bucket map
-    uint32_t mapEntriesPerSector = map->bytes_per_sector / 8;
-    uint32_t sectorOffset = bucket / mapEntriesPerSector;
-    uint32_t sectorIndex = bucket % mapEntriesPerSector;
-    uint32_t link;
-
-    // Read the calculated sector
-    uint32_t* sector = __read_sector(map, sectorOffset, 1);
-
     // Update length and return link
-    link = sector[sectorIndex*2];
-    *length = sector[(sectorIndex*2) + 1];
-    free(sector);
-    return link;
+    *length = map->entries[(bucket*2) + 1];
+    return map->entries[bucket*2];
 }
 
 void mfs_bucket_map_set_bucket_link(struct mfs_bucket_map* map, uint32_t bucket, uint32_t nextBucket)
 {
-    // Calculate index into bucket map
-    uint32_t mapEntriesPerSector = map->bytes_per_sector / 8;
-    uint32_t sectorOffset = bucket / mapEntriesPerSector;
-    uint32_t sectorIndex = bucket % mapEntriesPerSector;
-
-    // Read the calculated sector
-    uint32_t* sectorBuffer = __read_sector(map, sectorOffset, 1);
-
-    // Update link
-    sectorBuffer[sectorIndex * 2] = nextBucket;
-
-    // Flush buffer to disk
-    if (map->ops->write(map->map_sector + sectorOffset, (uint8_t*)sectorBuffer, 1, map->ops->op_context)) {
-        VLOG_FATAL("mfs-bucket-map", "mfs_bucket_map_set_bucket_link: failed to write map sector\n");
-    }
-    free(sectorBuffer);
+    map->entries[bucket * 2] = nextBucket;
+    __mark_dirty(map, bucket);
 }
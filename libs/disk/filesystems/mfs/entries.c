@@ -89,37 +89,6 @@ static uint8_t* __read_sector(struct mfs* mfs, uint64_t sector, uint32_t count)
     return buffer;
 }
 
-static int __save_next_available_bucket(struct mfs* mfs)
-{
-    uint8_t* masterRecord;
-    uint32_t nextFree;
-    int      status;
-    
-    // Update the master-record to reflect the new index
-    masterRecord = __read_sector(mfs, mfs->master_record_sector, 1);
-    nextFree = mfs_bucket_map_next_free(mfs->map);
-    masterRecord[76] = (uint8_t)(nextFree & 0xFF);
-    masterRecord[77] = (uint8_t)((nextFree >> 8) & 0xFF);
-    masterRecord[78] = (uint8_t)((nextFree >> 16) & 0xFF);
-    masterRecord[79] = (uint8_t)((nextFree >> 24) & 0xFF);
-
-    status = mfs->ops.write(mfs->master_record_sector, masterRecord, 1, mfs->ops.op_context);
-    if (status) {
-        VLOG_ERROR("mfs", "__save_next_available_bucket: failed to write primary record\n");
-        free(masterRecord);
-        return status;
-    }
-
-    status = mfs->ops.write(mfs->backup_master_record_sector, masterRecord, 1, mfs->ops.op_context);
-    if (status) {
-        VLOG_ERROR("mfs", "__save_next_available_bucket: failed to write secondary record\n");
-        free(masterRecord);
-        return status;
-    }
-    free(masterRecord);
-    return 0;
-}
-
 static uint32_t __get_last_bucket(struct mfs* mfs, uint32_t start)
 {
     uint32_t bucketPtr = start;
@@ -182,24 +151,9 @@ static char* __safe_path(const char* path)
     return strreplace((char*)path, "\\", "/");
 }
 
-static int __is_record_used(struct mfs_record* record)
-{
-    return record->flags & MFS_RECORD_FLAG_INUSE;
-}
-
-static int __record_name_length(const uint8_t* buffer, int offset)
-{
-    int length = 0;
-    while (buffer[offset + 68 + length] != 0) {
-        length++;
-    }
-    return length;
-}
-
-static char* __record_name(const uint8_t* buffer, int offset)
+static char* __record_name(const uint8_t* buffer, uint32_t offset)
 {
-    int length = __record_name_length(buffer, offset);
-    return platform_strdup(&buffer[offset + 64]);
+    return platform_strdup((const char*)&buffer[offset + 68]);
 }
 
 static struct mfs_record* __parse_record(const uint8_t* buffer, uint32_t offset, uint32_t directoryBucket, uint32_t directoryBucketLength)
@@ -236,49 +190,315 @@ static void __write_record(uint8_t* buffer, uint32_t offset, struct mfs_record*
     *((uint64_t*)&buffer[offset + 56]) = record->allocated_size;
 }
 
-static struct mfs_record* __find_record(struct mfs* mfs, uint32_t directoryBucket, const char* name)
+static void __delete_record(struct mfs_record* record)
 {
-    uint32_t bucketLength  = 0;
-    uint32_t currentBucket = directoryBucket;
-    for (;;) {
-        uint32_t bucketLink   = mfs_bucket_map_bucket_info(mfs->map, currentBucket, &bucketLength);
-        uint8_t* bucketBuffer = __read_sector(mfs, __BUCKET_SECTOR(currentBucket), mfs->bucket_size * bucketLength);
-        
-        uint32_t bytesToIterate = mfs->bucket_size * mfs->bytes_per_sector * bucketLength;
-        for (uint32_t i = 0; i < bytesToIterate; i += MFS_RECORDSIZE) {
-            struct mfs_record* record = __parse_record(bucketBuffer, i, currentBucket, bucketLength);
-            if (!__is_record_used(record)) {
-                continue;
+    if (record == NULL) {
+        return;
+    }
+
+    free((void*)record->name);
+    free(record);
+}
+
+// The index keeps every record that has been seen in memory, keyed by the
+// first bucket of its directory and its name. A directory is read from
+// disk once, on first access, which also records where its free record
+// slots are. Records returned by the lookups below are owned by the index.
+struct __index_record {
+    uint32_t           parent;
+    uint32_t           hash;
+    struct mfs_record* record;
+};
+
+struct __record_slot {
+    uint32_t bucket;
+    uint32_t length;
+    uint32_t index;
+};
+
+struct __index_directory {
+    uint32_t              bucket;
+    uint32_t              last_bucket;
+    struct __record_slot* free_slots;
+    size_t                free_count;
+    size_t                free_capacity;
+    size_t                free_next;
+};
+
+struct mfs_index {
+    struct __index_record*     records;
+    size_t                     records_capacity;
+    size_t                     records_count;
+    struct __index_directory** directories;
+    size_t                     directories_capacity;
+    size_t                     directories_count;
+};
+
+static uint32_t __hash_name(uint32_t parent, const char* name)
+{
+    uint32_t hash = 2166136261u ^ parent;
+    while (*name) {
+        hash ^= (uint8_t)*name++;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static uint32_t __hash_bucket(uint32_t bucket)
+{
+    return bucket * 2654435761u;
+}
+
+static struct mfs_index* __index(struct mfs* mfs)
+{
+    if (mfs->index == NULL) {
+        mfs->index = calloc(1, sizeof(struct mfs_index));
+        if (mfs->index == NULL) {
+            VLOG_FATAL("mfs", "__index: could not allocate memory for the directory index\n");
+        }
+    }
+    return mfs->index;
+}
+
+static void __index_place_record(struct mfs_index* index, struct __index_record* entry)
+{
+    size_t mask = index->records_capacity - 1;
+    size_t i = entry->hash & mask;
+
+    while (index->records[i].record != NULL) {
+        i = (i + 1) & mask;
+    }
+    index->records[i] = *entry;
+}
+
+static void __index_add_record(struct mfs_index* index, uint32_t parent, struct mfs_record* record)
+{
+    struct __index_record entry = { parent, __hash_name(parent, record->name), record };
+
+    if ((index->records_count + 1) * 4 > index->records_capacity * 3) {
+        struct __index_record* previous = index->records;
+        size_t                 previousCapacity = index->records_capacity;
+        size_t                 i;
+
+        index->records_capacity = previousCapacity ? previousCapacity * 2 : 256;
+        index->records = calloc(index->records_capacity, sizeof(struct __index_record));
+        if (index->records == NULL) {
+            VLOG_FATAL("mfs", "__index_add_record: could not allocate memory for the directory index\n");
+        }
+        for (i = 0; i < previousCapacity; i++) {
+            if (previous[i].record != NULL) {
+                __index_place_record(index, &previous[i]);
             }
-            if (strcmp(record->name, name) == 0) {
-                free(bucketBuffer);
-                return record;
+        }
+        free(previous);
+    }
+
+    __index_place_record(index, &entry);
+    index->records_count++;
+}
+
+static struct mfs_record* __index_find_record(struct mfs_index* index, uint32_t parent, const char* name)
+{
+    uint32_t hash;
+    size_t   mask, i;
+
+    if (index->records_capacity == 0) {
+        return NULL;
+    }
+
+    hash = __hash_name(parent, name);
+    mask = index->records_capacity - 1;
+    for (i = hash & mask; index->records[i].record != NULL; i = (i + 1) & mask) {
+        struct __index_record* entry = &index->records[i];
+        if (entry->hash == hash && entry->parent == parent && strcmp(entry->record->name, name) == 0) {
+            return entry->record;
+        }
+    }
+    return NULL;
+}
+
+static void __index_place_directory(struct mfs_index* index, struct __index_directory* directory)
+{
+    size_t mask = index->directories_capacity - 1;
+    size_t i = __hash_bucket(directory->bucket) & mask;
+
+    while (index->directories[i] != NULL) {
+        i = (i + 1) & mask;
+    }
+    index->directories[i] = directory;
+}
+
+static void __index_add_directory(struct mfs_index* index, struct __index_directory* directory)
+{
+    if ((index->directories_count + 1) * 4 > index->directories_capacity * 3) {
+        struct __index_directory** previous = index->directories;
+        size_t                     previousCapacity = index->directories_capacity;
+        size_t                     i;
+
+        index->directories_capacity = previousCapacity ? previousCapacity * 2 : 64;
+        index->directories = calloc(index->directories_capacity, sizeof(struct __index_directory*));
+        if (index->directories == NULL) {
+            VLOG_FATAL("mfs", "__index_add_directory: could not allocate memory for the directory index\n");
+        }
+        for (i = 0; i < previousCapacity; i++) {
+            if (previous[i] != NULL) {
+                __index_place_directory(index, previous[i]);
             }
         }
-        free(bucketBuffer);
+        free(previous);
+    }
 
-        if (bucketLink == MFS_ENDOFCHAIN) {
-            break;
+    __index_place_directory(index, directory);
+    index->directories_count++;
+}
+
+static struct __index_directory* __index_find_directory(struct mfs_index* index, uint32_t bucket)
+{
+    size_t mask, i;
+
+    if (index->directories_capacity == 0) {
+        return NULL;
+    }
+
+    mask = index->directories_capacity - 1;
+    for (i = __hash_bucket(bucket) & mask; index->directories[i] != NULL; i = (i + 1) & mask) {
+        if (index->directories[i]->bucket == bucket) {
+            return index->directories[i];
         }
-        currentBucket = bucketLink;
     }
     return NULL;
 }
 
+void mfs_index_delete(struct mfs_index* index)
+{
+    size_t i;
+
+    if (index == NULL) {
+        return;
+    }
+
+    for (i = 0; i < index->records_capacity; i++) {
+        __delete_record(index->records[i].record);
+    }
+    for (i = 0; i < index->directories_capacity; i++) {
+        if (index->directories[i] != NULL) {
+            free(index->directories[i]->free_slots);
+            free(index->directories[i]);
+        }
+    }
+    free(index->records);
+    free(index->directories);
+    free(index);
+}
+
+static void __directory_add_slots(struct mfs* mfs, struct __index_directory* directory, uint32_t bucket, uint32_t bucketLength, const uint8_t* buffer)
+{
+    uint32_t recordCount = (mfs->bucket_size * bucketLength * mfs->bytes_per_sector) / MFS_RECORDSIZE;
+
+    for (uint32_t i = 0; i < recordCount; i++) {
+        struct mfs_record* record;
+
+        // records in use go into the index, the rest are free slots
+        if (buffer != NULL && (*((uint32_t*)&buffer[i * MFS_RECORDSIZE]) & MFS_RECORD_FLAG_INUSE)) {
+            record = __parse_record(buffer, i * MFS_RECORDSIZE, bucket, bucketLength);
+            if (record == NULL) {
+                VLOG_FATAL("mfs", "__directory_add_slots: could not allocate memory for record\n");
+            }
+            __index_add_record(mfs->index, directory->bucket, record);
+            continue;
+        }
+
+        if (directory->free_count == directory->free_capacity) {
+            directory->free_capacity = directory->free_capacity ? directory->free_capacity * 2 : 64;
+            directory->free_slots = realloc(directory->free_slots, directory->free_capacity * sizeof(struct __record_slot));
+            if (directory->free_slots == NULL) {
+                VLOG_FATAL("mfs", "__directory_add_slots: could not allocate memory for record slots\n");
+            }
+        }
+        directory->free_slots[directory->free_count++] = (struct __record_slot) { bucket, bucketLength, i };
+    }
+}
+
+// Adds the chain starting at <bucket> to the directory. When <wipe> is set the
+// chain was just allocated, its buckets are zeroed and all of its slots are free,
+// otherwise the existing records are read in.
+static int __directory_add_chain(struct mfs* mfs, struct __index_directory* directory, uint32_t bucket, int wipe)
+{
+    while (bucket != MFS_ENDOFCHAIN) {
+        uint32_t bucketLength = 0;
+        uint32_t bucketLink = mfs_bucket_map_bucket_info(mfs->map, bucket, &bucketLength);
+        uint8_t* buffer;
+        int      status;
+
+        if (wipe) {
+            buffer = __new_buffer(mfs, mfs->bucket_size * bucketLength);
+            status = mfs->ops.write(__BUCKET_SECTOR(bucket), buffer, mfs->bucket_size * bucketLength, mfs->ops.op_context);
+            free(buffer);
+            if (status) {
+                VLOG_ERROR("mfs", "__directory_add_chain: failed to wipe directory bucket\n");
+                return status;
+            }
+            __directory_add_slots(mfs, directory, bucket, bucketLength, NULL);
+        } else {
+            buffer = __read_sector(mfs, __BUCKET_SECTOR(bucket), mfs->bucket_size * bucketLength);
+            __directory_add_slots(mfs, directory, bucket, bucketLength, buffer);
+            free(buffer);
+        }
+
+        directory->last_bucket = bucket;
+        bucket = bucketLink;
+    }
+    return 0;
+}
+
+static struct __index_directory* __new_directory(struct mfs* mfs, uint32_t bucket, int wipe)
+{
+    struct __index_directory* directory;
+
+    directory = calloc(1, sizeof(struct __index_directory));
+    if (directory == NULL) {
+        VLOG_FATAL("mfs", "__new_directory: could not allocate memory for directory\n");
+    }
+    directory->bucket = bucket;
+    directory->last_bucket = MFS_ENDOFCHAIN;
+
+    // only index the directory once its chain is in place, otherwise a failed
+    // wipe leaves a half-built directory behind that later lookups would find
+    if (__directory_add_chain(mfs, directory, bucket, wipe)) {
+        free(directory->free_slots);
+        free(directory);
+        return NULL;
+    }
+    __index_add_directory(__index(mfs), directory);
+    return directory;
+}
+
+static struct __index_directory* __get_directory(struct mfs* mfs, uint32_t bucket)
+{
+    struct __index_directory* directory = __index_find_directory(__index(mfs), bucket);
+    if (directory != NULL) {
+        return directory;
+    }
+    return __new_directory(mfs, bucket, 0);
+}
+
+static struct mfs_record* __find_record(struct mfs* mfs, uint32_t directoryBucket, const char* name)
+{
+    if (__get_directory(mfs, directoryBucket) == NULL) {
+        return NULL;
+    }
+    return __index_find_record(mfs->index, directoryBucket, name);
+}
+
 static int __initiate_directory_record(struct mfs* mfs, struct mfs_record* record)
 {
     uint32_t initialBucketSize = 0;
     uint32_t bucket = mfs_bucket_map_allocate(mfs->map, MFS_EXPANDSIZE, &initialBucketSize);
-    uint8_t* buffer;
-    int      status;
 
-    // Wipe the new bucket to zeros
-    buffer = __new_buffer(mfs, mfs->bucket_size * initialBucketSize);
-    status = mfs->ops.write(__BUCKET_SECTOR(bucket), buffer, mfs->bucket_size * initialBucketSize, mfs->ops.op_context);
-    free(buffer);
-    if (status) {
+    // the new directory is empty, so register it without reading it back
+    if (__new_directory(mfs, bucket, 1) == NULL) {
         VLOG_ERROR("mfs", "__initiate_directory_record: failed to write directory bucket\n");
-        return status;
+        return -1;
     }
 
     record->bucket = bucket;
@@ -286,37 +506,28 @@ static int __initiate_directory_record(struct mfs* mfs, struct mfs_record* recor
     return 0;
 }
 
-static uint32_t __expand_directory(struct mfs* mfs, uint32_t lastBucket)
+static int __expand_directory(struct mfs* mfs, struct __index_directory* directory)
 {
     uint32_t initialBucketSize = 0;
     uint32_t bucket = mfs_bucket_map_allocate(mfs->map, MFS_EXPANDSIZE, &initialBucketSize);
-    uint8_t* buffer;
-    int      status;
-
-    mfs_bucket_map_set_bucket_link(mfs->map, lastBucket, bucket);
 
-    // Wipe the new bucket to zeros
-    buffer = __new_buffer(mfs, mfs->bucket_size * initialBucketSize);
-    status = mfs->ops.write(__BUCKET_SECTOR(bucket), buffer, mfs->bucket_size * initialBucketSize, mfs->ops.op_context);
-    free(buffer);
-    if (status) {
-        VLOG_FATAL("mfs", "__expand_directory: failed to expand directory bucket\n");
-    }
-    return bucket;
+    mfs_bucket_map_set_bucket_link(mfs->map, directory->last_bucket, bucket);
+    return __directory_add_chain(mfs, directory, bucket, 1);
 }
 
 static void __update_record(struct mfs* mfs, struct mfs_record* record)
 {
-    VLOG_DEBUG("mfs", "__update_record(record=%s)\n", record->name);
-    VLOG_DEBUG("mfs", "__update_record reading sector %llu, length %u\n",
-        __BUCKET_SECTOR(record->directory_bucket),
-        mfs->bucket_size * record->directory_length
-    );
-    uint8_t* buffer = __read_sector(mfs, __BUCKET_SECTOR(record->directory_bucket), mfs->bucket_size * record->directory_length);
+    // only the sectors holding the record are rewritten
     uint32_t offset = record->directory_index * (uint32_t)MFS_RECORDSIZE;
-    VLOG_DEBUG("mfs", "__update_record: record offset at %u\n", offset);
-    __write_record(buffer, offset, record);
-    if (mfs->ops.write(__BUCKET_SECTOR(record->directory_bucket), buffer, mfs->bucket_size * record->directory_length, mfs->ops.op_context)) {
+    uint64_t sector = __BUCKET_SECTOR(record->directory_bucket) + (offset / mfs->bytes_per_sector);
+    uint32_t count = (MFS_RECORDSIZE + (mfs->bytes_per_sector - 1)) / mfs->bytes_per_sector;
+    uint8_t* buffer;
+
+    VLOG_DEBUG("mfs", "__update_record(record=%s)\n", record->name);
+    VLOG_DEBUG("mfs", "__update_record: record at sector %llu, offset %u\n", sector, offset % mfs->bytes_per_sector);
+    buffer = __read_sector(mfs, sector, count);
+    __write_record(buffer, offset % mfs->bytes_per_sector, record);
+    if (mfs->ops.write(sector, buffer, count, mfs->ops.op_context)) {
         VLOG_FATAL("mfs", "__update_record: failed to update record bucket\n");
     }
     free(buffer);
@@ -324,62 +535,52 @@ static void __update_record(struct mfs* mfs, struct mfs_record* record)
 
 static struct mfs_record* __create_record(struct mfs* mfs, uint32_t directoryBucket, const char* recordName, enum mfs_record_flags flags)
 {
-    uint32_t bucketLength = 0;
-    uint32_t currentBucket = directoryBucket;
-    int      status;
+    struct __index_directory* directory;
+    struct __record_slot*     slot;
+    struct mfs_record*        record;
+    int                       status;
     VLOG_DEBUG("mfs", "__create_record(%u, %s)\n", directoryBucket, recordName);
-    
-    for (;;) {
-        VLOG_DEBUG("mfs", "__create_record: retrieving link and length of bucket %u", currentBucket);
-        uint32_t bucketLink = mfs_bucket_map_bucket_info(mfs->map, currentBucket, &bucketLength);
-        VLOG_DEBUG("mfs", "__create_record: reading sector %llu, count %u", __BUCKET_SECTOR(currentBucket), mfs->bucket_size * bucketLength);
-        uint8_t* bucketBuffer = __read_sector(mfs, __BUCKET_SECTOR(currentBucket), mfs->bucket_size * bucketLength);
-
-        uint32_t bytesToIterate = mfs->bucket_size * bucketLength * mfs->bytes_per_sector;
-        for (uint32_t i = 0; i < bytesToIterate; i += MFS_RECORDSIZE) {
-            struct mfs_record* record;
-            VLOG_DEBUG("mfs", "__create_record: parsing record %u\n", i);
-            
-            record = __parse_record(bucketBuffer, i, currentBucket, bucketLength);
-            if (__is_record_used(record)) {
-                continue;
-            }
 
-            VLOG_DEBUG("mfs", "__create_record: record %u was available\n", i);
-            record->name = recordName;
-            record->flags = flags | MFS_RECORD_FLAG_INUSE;
-            record->bucket = MFS_ENDOFCHAIN;
-            record->bucket_length = 0;
-            record->allocated_size = 0;
-            record->size = 0;
-            if (flags & MFS_RECORD_FLAG_DIRECTORY) {
-                status = __initiate_directory_record(mfs, record);
-                if (status) {
-                    VLOG_ERROR("mfs", "__create_record: failed to initiate directory %s\n", recordName);
-                    return NULL;
-                }
-            }
-            __update_record(mfs, record);
-            return record;
-        }
+    directory = __get_directory(mfs, directoryBucket);
+    if (directory == NULL) {
+        return NULL;
+    }
 
-        if (bucketLink == MFS_ENDOFCHAIN) {
-            currentBucket = __expand_directory(mfs, currentBucket);
-        } else {
-            currentBucket = bucketLink;
+    // records fill the directory in order, so the first free slot is the next one
+    if (directory->free_next == directory->free_count) {
+        status = __expand_directory(mfs, directory);
+        if (status) {
+            VLOG_ERROR("mfs", "__create_record: failed to expand directory %u\n", directoryBucket);
+            return NULL;
         }
     }
-    return NULL;
-}
+    slot = &directory->free_slots[directory->free_next++];
 
-static void __delete_record(struct mfs_record* record)
-{
+    record = calloc(1, sizeof(struct mfs_record));
     if (record == NULL) {
-        return;
+        return NULL;
     }
 
-    free((void*)record->name);
-    free(record);
+    record->name = platform_strdup(recordName);
+    record->flags = flags | MFS_RECORD_FLAG_INUSE;
+    record->bucket = MFS_ENDOFCHAIN;
+    record->bucket_length = 0;
+    record->allocated_size = 0;
+    record->size = 0;
+    record->directory_bucket = slot->bucket;
+    record->directory_length = slot->length;
+    record->directory_index = slot->index;
+    if (flags & MFS_RECORD_FLAG_DIRECTORY) {
+        status = __initiate_directory_record(mfs, record);
+        if (status) {
+            VLOG_ERROR("mfs", "__create_record: failed to initiate directory %s\n", recordName);
+            __delete_record(record);
+            return NULL;
+        }
+    }
+    __update_record(mfs, record);
+    __index_add_record(mfs->index, directoryBucket, record);
+    return record;
 }
 
 static struct mfs_record* __create_path(struct mfs* mfs, uint32_t directoryBucket, const char* path, enum mfs_record_flags fileFlags)
@@ -417,7 +618,6 @@ static struct mfs_record* __create_path(struct mfs* mfs, uint32_t directoryBucke
         // created it tho
         if (!isLast && !(record->flags & MFS_RECORD_FLAG_DIRECTORY)) {
             VLOG_ERROR("mfs", "__create_path: record %s in path %s is not a directory\n", token, safePath);
-            __delete_record(record);
             break;
         }
 
@@ -428,16 +628,21 @@ static struct mfs_record* __create_path(struct mfs* mfs, uint32_t directoryBucke
         }
 
         startBucket = record->bucket;
-        __delete_record(record);
     }
     strsplit_free(tokens);
     return NULL;
 }
 
-static struct mfs_record* __create_root_record(void)
+static struct mfs_record* __root_record(struct mfs* mfs)
 {
     struct mfs_record* record;
 
+    // the fake root record lives in the index like any other
+    record = __index_find_record(__index(mfs), MFS_ENDOFCHAIN, "<root>");
+    if (record != NULL) {
+        return record;
+    }
+
     record = calloc(1, sizeof(struct mfs_record));
     if (record == NULL) {
         return NULL;
@@ -445,6 +650,7 @@ static struct mfs_record* __create_root_record(void)
 
     record->name = platform_strdup("<root>");
     record->flags = MFS_RECORD_FLAG_DIRECTORY | MFS_RECORD_FLAG_SYSTEM;
+    __index_add_record(mfs->index, MFS_ENDOFCHAIN, record);
     return record;
 }
 
@@ -459,7 +665,7 @@ static struct mfs_record* __find_path(struct mfs* mfs, uint32_t directoryBucket,
     // If the root path was specified (/ or empty), then we must fake the root
     // record for MFS
     if (safePath == NULL || strlen(safePath) == 0) {
-        return __create_root_record();
+        return __root_record(mfs);
     }
 
     // split path into tokens
@@ -473,11 +679,6 @@ static struct mfs_record* __find_path(struct mfs* mfs, uint32_t directoryBucket,
             continue;
         }
 
-        // cleanup any previous record
-        if (record != NULL) {
-            __delete_record(record);
-        }
-
         // find the token in the bucket
         record = __find_record(mfs, startBucket, token);
         if (record == NULL) {
@@ -488,7 +689,6 @@ static struct mfs_record* __find_path(struct mfs* mfs, uint32_t directoryBucket,
         // created it tho
         if (!(record->flags & MFS_RECORD_FLAG_DIRECTORY)) {
             VLOG_ERROR("mfs", "__find_path: record %s in path %s is not a directory\n", token, safePath);
-            __delete_record(record);
             record = NULL;
             break;
         }
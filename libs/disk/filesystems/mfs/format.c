@@ -16,6 +16,7 @@
  * 
  */
 
+#include <chef/platform.h>
 #include <stdlib.h>
 #include <string.h>
 #include <vlog.h>
@@ -36,13 +37,18 @@ struct mfs* mfs_new(struct mfs_new_params* params)
     }
 
     memcpy(&mfs->ops, &params->ops, sizeof(struct mfs_storage_operations));
-    mfs->label = params->label;
-    mfs->guid = params->guid;
+    // owned by the instance, they are freed by mfs_delete
+    mfs->label = platform_strdup(params->label);
+    mfs->guid = params->guid != NULL ? platform_strdup(params->guid) : NULL;
     mfs->sector_count = params->sector_count;
     mfs->bytes_per_sector = params->bytes_per_sector;
     mfs->sectors_per_track = params->sectors_per_track;
     mfs->heads_per_cylinder = params->heads_per_cylinder;
 
+    if (mfs->guid == NULL) {
+        return mfs;
+    }
+
     if (strcmp(params->guid, "C4483A10-E3A0-4D3F-B7CC-C04A6E16612B") == 0) {
         mfs->flags |= MFS_PARTITION_FLAG_SYSTEMDRIVE;
     } else if (strcmp(params->guid, "80C6C62A-B0D6-4FF4-A69D-558AB6FD8B53") == 0) {
@@ -61,6 +67,7 @@ void mfs_delete(struct mfs* mfs)
         return;
     }
 
+    mfs_index_delete(mfs->index);
     mfs_bucket_delete(mfs->map);
     free((void*)mfs->label);
     free((void*)mfs->guid);
@@ -211,6 +218,48 @@ static int __build_master_record(
     return status;
 }
 
+static int __update_master_records(struct mfs* mfs)
+{
+    uint8_t* masterRecord;
+    uint32_t freeBucket;
+    uint32_t checksum;
+    int      status;
+
+    masterRecord = __new_buffer(mfs, 1);
+    status = mfs->ops.read(mfs->master_record_sector, masterRecord, 1, mfs->ops.op_context);
+    if (status) {
+        VLOG_ERROR("mfs", "__update_master_records: failed to read primary record\n");
+        free(masterRecord);
+        return status;
+    }
+
+    // Update the free pointer, which has moved since format
+    freeBucket = mfs_bucket_map_next_free(mfs->map);
+    masterRecord[76] = (uint8_t)(freeBucket & 0xFF);
+    masterRecord[77] = (uint8_t)((freeBucket >> 8) & 0xFF);
+    masterRecord[78] = (uint8_t)((freeBucket >> 16) & 0xFF);
+    masterRecord[79] = (uint8_t)((freeBucket >> 24) & 0xFF);
+
+    checksum = __checksum(masterRecord, 512, 8, 4);
+    masterRecord[8] = (uint8_t)(checksum & 0xFF);
+    masterRecord[9] = (uint8_t)((checksum >> 8) & 0xFF);
+    masterRecord[10] = (uint8_t)((checksum >> 16) & 0xFF);
+    masterRecord[11] = (uint8_t)((checksum >> 24) & 0xFF);
+
+    status = mfs->ops.write(mfs->master_record_sector, masterRecord, 1, mfs->ops.op_context);
+    if (status) {
+        VLOG_ERROR("mfs", "__update_master_records: failed to write primary record\n");
+        free(masterRecord);
+        return status;
+    }
+    status = mfs->ops.write(mfs->backup_master_record_sector, masterRecord, 1, mfs->ops.op_context);
+    if (status) {
+        VLOG_ERROR("mfs", "__update_master_records: failed to write secondary record\n");
+    }
+    free(masterRecord);
+    return status;
+}
+
 static int __build_vbr(struct mfs* mfs)
 {
     // Initialize the MBR
@@ -333,7 +382,8 @@ int mfs_format(struct mfs* mfs)
         &mfs->ops,
         mfs->reserved_sector_count,
         (uint32_t)(mfs->sector_count - mfs->reserved_sector_count),
-        mfs->bucket_size
+        mfs->bucket_size,
+        mfs->bytes_per_sector
     );
     if (mfs->map == NULL) {
         return -1;
@@ -405,3 +455,25 @@ int mfs_format(struct mfs* mfs)
     }
     return 0;
 }
+
+int mfs_flush(struct mfs* mfs)
+{
+    int status;
+
+    // nothing was formatted, so there is nothing to write back
+    if (mfs->map == NULL) {
+        return 0;
+    }
+
+    status = mfs_bucket_map_flush(mfs->map);
+    if (status) {
+        VLOG_ERROR("mfs", "mfs_flush: failed to write the bucket map\n");
+        return status;
+    }
+
+    status = __update_master_records(mfs);
+    if (status) {
+        VLOG_ERROR("mfs", "mfs_flush: failed to update the master records\n");
+    }
+    return status;
+}
@@ -76,9 +76,12 @@ struct mfs_record {
     uint32_t              directory_index;
 };
 
+struct mfs_index;
+
 struct mfs {
     struct mfs_storage_operations ops;
     struct mfs_bucket_map*        map;
+    struct mfs_index*             index;
 
     const char* label;
     const char* guid;
@@ -97,7 +100,7 @@ struct mfs {
 
 struct mfs_bucket_map;
 
-extern struct mfs_bucket_map* mfs_bucket_new(struct mfs_storage_operations* ops, uint64_t sector, uint32_t sectorCount, uint16_t sectorsPerBucket);
+extern struct mfs_bucket_map* mfs_bucket_new(struct mfs_storage_operations* ops, uint64_t sector, uint32_t sectorCount, uint16_t sectorsPerBucket, uint16_t bytesPerSector);
 extern void mfs_bucket_delete(struct mfs_bucket_map* map);
 
 extern uint32_t mfs_bucket_map_next_free(struct mfs_bucket_map* map);
@@ -107,6 +110,11 @@ extern uint64_t mfs_bucket_map_size(struct mfs_bucket_map* map);
 extern void mfs_bucket_initialize(struct mfs_bucket_map* map);
 extern void mfs_bucket_open(struct mfs_bucket_map* map, uint64_t mapSector, uint32_t nextFreeBucket);
 
+/**
+ * @brief Writes the sectors of the in-memory map that changed since the last flush
+ */
+extern int mfs_bucket_map_flush(struct mfs_bucket_map* map);
+
 /**
  * @brief Link of <bucket> is returned as result, length of <bucket> is provided in <length>
  */
@@ -122,4 +130,9 @@ extern void mfs_bucket_map_set_bucket_link(struct mfs_bucket_map* map, uint32_t
  */
 extern uint32_t mfs_bucket_map_allocate(struct mfs_bucket_map* map, uint32_t bucketCount, uint32_t* sizeOfFirstBucket);
 
+/**
+ * @brief Releases the directory index built up by the record lookups
+ */
+extern void mfs_index_delete(struct mfs_index* index);
+
 #endif //!__PRIVATE_H__
@@ -115,6 +115,8 @@ struct chef_disk_filesystem {
 
 struct chef_filesystem_fat_options {
     const char* reserved_image;
+    // size in bytes of the write-back sector cache, 0 selects the default
+    size_t      cache_size;
 };
 
 union chef_filesystem_options {
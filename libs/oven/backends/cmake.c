@@ -352,12 +352,13 @@ static char* __replace_or_add_cmake_prefixes(const char* platform, const char* a
     return newArguments;
 }
 
-static void __cmake_output_handler(const char* line, enum platform_spawn_output_type type) 
+static void __cmake_output_handler(const char* line, size_t length, enum platform_spawn_output_type type, void* context) 
 {
+    (void)context;
     if (type == PLATFORM_SPAWN_OUTPUT_TYPE_STDOUT) {
-        VLOG_DEBUG("cmake", line);
+        VLOG_DEBUG("cmake", "%.*s", (int)length, line);
     } else {
-        VLOG_ERROR("cmake", line);
+        VLOG_ERROR("cmake", "%.*s", (int)length, line);
     }
 }
 
@@ -443,7 +444,7 @@ int cmake_main(struct oven_backend_data* data, union chef_backend_options* optio
         (const char* const*)environment,
         &(struct platform_spawn_options) {
             .cwd = data->paths.build,
-            .output_handler = __cmake_output_handler
+            .line_handler = __cmake_output_handler
         }
     );
 
@@ -28,12 +28,13 @@
 
 #define __INTERNAL_MAX(a,b) (((a) > (b)) ? (a) : (b))
 
-static void __make_output_handler(const char* line, enum platform_spawn_output_type type) 
+static void __make_output_handler(const char* line, size_t length, enum platform_spawn_output_type type, void* context) 
 {
+    (void)context;
     if (type == PLATFORM_SPAWN_OUTPUT_TYPE_STDOUT) {
-        VLOG_DEBUG("make", line);
+        VLOG_DEBUG("make", "%.*s", (int)length, line);
     } else {
-        VLOG_ERROR("make", line);
+        VLOG_ERROR("make", "%.*s", (int)length, line);
     }
 }
 
@@ -86,7 +87,7 @@ int make_build_main(struct oven_backend_data* data, union chef_backend_options*
         (const char* const*)environment, 
         &(struct platform_spawn_options) {
             .cwd = cwd,
-            .output_handler = __make_output_handler
+            .line_handler = __make_output_handler
         }
     );
     vlog_clear_output_options(stdout, VLOG_OUTPUT_OPTION_NODECO);
@@ -104,7 +105,7 @@ int make_build_main(struct oven_backend_data* data, union chef_backend_options*
         (const char* const*)environment, 
         &(struct platform_spawn_options) {
             .cwd = cwd,
-            .output_handler = __make_output_handler
+            .line_handler = __make_output_handler
         }
     );
     vlog_clear_output_options(stdout, VLOG_OUTPUT_OPTION_NODECO);
@@ -144,7 +145,7 @@ int make_clean_main(struct oven_backend_data* data, union chef_backend_options*
         (const char* const*)environment, 
         &(struct platform_spawn_options) {
             .cwd = cwd,
-            .output_handler = __make_output_handler
+            .line_handler = __make_output_handler
         }
     );
     vlog_clear_output_options(stdout, VLOG_OUTPUT_OPTION_NODECO);
@@ -160,12 +160,13 @@ static char* __compute_arguments(struct oven_backend_data* data, union chef_back
     return args;
 }
 
-static void __meson_output_handler(const char* line, enum platform_spawn_output_type type) 
+static void __meson_output_handler(const char* line, size_t length, enum platform_spawn_output_type type, void* context) 
 {
+    (void)context;
     if (type == PLATFORM_SPAWN_OUTPUT_TYPE_STDOUT) {
-        VLOG_DEBUG("meson", line);
+        VLOG_DEBUG("meson", "%.*s", (int)length, line);
     } else {
-        VLOG_ERROR("meson", line);
+        VLOG_ERROR("meson", "%.*s", (int)length, line);
     }
 }
 
@@ -211,7 +212,7 @@ int meson_config_main(struct oven_backend_data* data, union chef_backend_options
         (const char* const*)environment,
         &(struct platform_spawn_options) {
             .cwd = data->paths.project,
-            .output_handler = __meson_output_handler
+            .line_handler = __meson_output_handler
         }
     );
 
@@ -297,7 +298,7 @@ int meson_clean_main(struct oven_backend_data* data, union chef_backend_options*
         (const char* const*)environment,
         &(struct platform_spawn_options) {
             .cwd = data->paths.project,
-            .output_handler = __meson_output_handler
+            .line_handler = __meson_output_handler
         }
     );
 
@@ -28,12 +28,13 @@
 
 #define __INTERNAL_MAX(a,b) (((a) > (b)) ? (a) : (b))
 
-static void __ninja_output_handler(const char* line, enum platform_spawn_output_type type) 
+static void __ninja_output_handler(const char* line, size_t length, enum platform_spawn_output_type type, void* context) 
 {
+    (void)context;
     if (type == PLATFORM_SPAWN_OUTPUT_TYPE_STDOUT) {
-        VLOG_DEBUG("ninja", line);
+        VLOG_DEBUG("ninja", "%.*s", (int)length, line);
     } else {
-        VLOG_ERROR("ninja", line);
+        VLOG_ERROR("ninja", "%.*s", (int)length, line);
     }
 }
 
@@ -56,7 +57,7 @@ int ninja_build_main(struct oven_backend_data* data, union chef_backend_options*
         (const char* const*)environment, 
         &(struct platform_spawn_options) {
             .cwd = data->paths.build,
-            .output_handler = __ninja_output_handler
+            .line_handler = __ninja_output_handler
         }
     );
     vlog_clear_output_options(stdout, VLOG_OUTPUT_OPTION_NODECO);
@@ -74,7 +75,7 @@ int ninja_build_main(struct oven_backend_data* data, union chef_backend_options*
         (const char* const*)environment, 
         &(struct platform_spawn_options) {
             .cwd = data->paths.build,
-            .output_handler = __ninja_output_handler
+            .line_handler = __ninja_output_handler
         }
     );
     vlog_clear_output_options(stdout, VLOG_OUTPUT_OPTION_NODECO);
@@ -106,7 +107,7 @@ int ninja_clean_main(struct oven_backend_data* data, union chef_backend_options*
         (const char* const*)environment, 
         &(struct platform_spawn_options) {
             .cwd = data->paths.build,
-            .output_handler = __ninja_output_handler
+            .line_handler = __ninja_output_handler
         }
     );
     vlog_clear_output_options(stdout, VLOG_OUTPUT_OPTION_NODECO);
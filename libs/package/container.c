@@ -24,19 +24,13 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <threads.h>
 #include <vafs/vafs.h>
 #include <vafs/file.h>
 #include <vafs/directory.h>
 #include <vlog.h>
 #include <zstd.h>
 
-// include dirent.h for directory operations
-#if defined(_WIN32) || defined(_WIN64)
-#include <dirent_win32.h>
-#else
-#include <dirent.h>
-#endif
-
 struct progress_context {
     int disabled;
 
@@ -67,9 +61,23 @@ static struct VaFsGuid g_networkGuid   = CHEF_PACKAGE_NETWORK_GUID;
  */
 #define __CHEF_ZSTD_COMPRESSION_LEVEL 15
 
-// static context, should be part of something, luckily we don't
-// expect parallel packing operations (even though good idea)
-static ZSTD_CCtx* g_compressContext = NULL;
+// the filter callbacks from VaFS carry no context, so the compression context
+// is per thread to allow packs to be written in parallel
+static thread_local ZSTD_CCtx* g_compressContext = NULL;
+
+// A filter from the recipe, with the literal leading part of the pattern
+// extracted so most paths can be rejected without running the glob matcher.
+struct __pack_filter {
+    const char* pattern;
+    size_t      literal_length;
+    int         literal;
+    int         negated;
+};
+
+struct __pack_filter_set {
+    struct __pack_filter* filters;
+    int                   count;
+};
 
 static const char* __get_filename(
     const char* path)
@@ -83,40 +91,89 @@ static const char* __get_filename(
     return filename;
 }
 
-static int __matches_filters(const char* path, struct list* filters)
+static int __compile_filters(struct list* filters, struct __pack_filter_set* set)
 {
     struct list_item* item;
-    int               status = -1;
 
+    set->count   = 0;
+    set->filters = NULL;
+    if (filters == NULL || filters->count == 0) {
+        return 0;
+    }
+
+    set->filters = calloc(filters->count, sizeof(struct __pack_filter));
+    if (set->filters == NULL) {
+        return -1;
+    }
+
+    list_foreach(filters, item) {
+        struct list_item_string* value  = (struct list_item_string*)item;
+        struct __pack_filter*    filter = &set->filters[set->count++];
+        const char*              pattern = value->value;
+
+        if (*pattern == '!') {
+            filter->negated = 1;
+            pattern++;
+        }
+
+        filter->pattern        = pattern;
+        filter->literal_length = strcspn(pattern, "*?[\\");
+        filter->literal        = pattern[filter->literal_length] == '\0';
+    }
+    return 0;
+}
+
+// Behaves exactly like strfilter, which treats the filter as a prefix
+// match when the path runs out first (that is how directories match).
+static int __filter_matches(struct __pack_filter* filter, const char* path)
+{
+    size_t length = strlen(path);
+    size_t compare = length < filter->literal_length ? length : filter->literal_length;
+    int    match;
+
+    if (strncmp(filter->pattern, path, compare) != 0) {
+        match = 0;
+    } else if (filter->literal || length <= filter->literal_length) {
+        match = 1;
+    } else {
+        match = strfilter(filter->pattern + compare, path + compare, 0) == 0;
+    }
+    return filter->negated ? !match : match;
+}
+
+static int __matches_filters(const char* path, struct __pack_filter_set* filters)
+{
     if (filters->count == 0) {
         return 0; // YES! no filters means everything matches
     }
 
-    list_foreach(filters, item) {
-        struct list_item_string* filter = (struct list_item_string*)item;
-        if (strfilter(filter->value, path, 0) == 0) {
-            status = 0;
-            break;
+    for (int i = 0; i < filters->count; i++) {
+        if (__filter_matches(&filters->filters[i], path)) {
+            return 0;
         }
     }
-    return status;
+    return -1;
 }
 
-int __get_install_stats(
-    struct list* files,
-    struct list* filters,
-    int*         fileCountOut,
-    int*         SymlinkCountOut)
+static int __get_install_stats(
+    struct platform_scandir*  scan,
+    struct __pack_filter_set* filters,
+    int*                     fileCountOut,
+    int*                     SymlinkCountOut)
 {
-    struct list_item* item;
+    size_t i;
 
-    if (files == NULL || fileCountOut == NULL || SymlinkCountOut == NULL) {
+    if (scan == NULL || fileCountOut == NULL || SymlinkCountOut == NULL) {
         errno = EINVAL;
         return -1;
     }
 
-    list_foreach(files, item) {
-        struct platform_file_entry* entry = (struct platform_file_entry*)item;
+    for (i = 0; i < scan->count; i++) {
+        struct platform_scandir_entry* entry = &scan->entries[i];
+        if (entry->type == PLATFORM_FILETYPE_DIRECTORY) {
+            continue;
+        }
+
         if (__matches_filters(entry->sub_path, filters)) {
             continue;
         }
@@ -137,10 +194,9 @@ int __get_install_stats(
 
 static void __write_progress(const char* prefix, struct progress_context* context)
 {
-    static int last = 0;
-    int        current;
-    int        total;
-    int        percent;
+    int current;
+    int total;
+    int percent;
 
     if (context->disabled) {
         return;
@@ -216,111 +272,153 @@ static int __write_file(
     return 0;
 }
 
+static int __path_depth(const char* subPath)
+{
+    int depth = 0;
+    while (*subPath) {
+        if (*subPath++ == CHEF_PATH_SEPARATOR) {
+            depth++;
+        }
+    }
+    return depth;
+}
+
+// Returns the index of the first entry after <index> that is not part of
+// the subtree of <index>, entries are sorted so subtrees are contiguous.
+static size_t __skip_entry(struct platform_scandir* scan, size_t index)
+{
+    struct platform_scandir_entry* entry = &scan->entries[index];
+    size_t                         length = strlen(entry->sub_path);
+    size_t                         i = index + 1;
+
+    if (entry->type != PLATFORM_FILETYPE_DIRECTORY) {
+        return i;
+    }
+
+    while (i < scan->count
+        && strncmp(scan->entries[i].sub_path, entry->sub_path, length) == 0
+        && scan->entries[i].sub_path[length] == CHEF_PATH_SEPARATOR) {
+        i++;
+    }
+    return i;
+}
+
+static int __push_directory(struct VaFsDirectoryHandle*** stack, int* count, int* capacity, struct VaFsDirectoryHandle* handle)
+{
+    if (*count == *capacity) {
+        int                          newCapacity = *capacity ? *capacity * 2 : 16;
+        struct VaFsDirectoryHandle** handles;
+
+        handles = realloc(*stack, newCapacity * sizeof(struct VaFsDirectoryHandle*));
+        if (handles == NULL) {
+            return -1;
+        }
+        *stack    = handles;
+        *capacity = newCapacity;
+    }
+    (*stack)[(*count)++] = handle;
+    return 0;
+}
+
 static int __write_directory(
     struct progress_context*    progress,
-    struct list*                filters,
+    struct __pack_filter_set*   filters,
     struct VaFsDirectoryHandle* directoryHandle,
-    const char*                 path,
-    const char*                 subPath)
+    struct platform_scandir*    scan)
 {
-    struct dirent* dp;
-    DIR*           dfd;
-    int            status = 0;
+    struct VaFsDirectoryHandle** stack = NULL;
+    int                          stackCount = 0;
+    int                          stackCapacity = 0;
+    size_t                       i = 0;
+    int                          status;
 
-    if ((dfd = opendir(path)) == NULL) {
-        VLOG_ERROR("bake", "can't open initrd folder\n");
+    status = __push_directory(&stack, &stackCount, &stackCapacity, directoryHandle);
+    if (status) {
         return -1;
     }
 
-    while ((dp = readdir(dfd)) != NULL) {
-        struct platform_stat stats;
-        const char*          combinedPath;
-        const char*          combinedSubPath;
+    // The scan is ordered such that every directory is followed by its contents,
+    // so we keep a stack of open directory handles, one for each level.
+    while (i < scan->count) {
+        struct platform_scandir_entry* entry = &scan->entries[i];
+        struct VaFsDirectoryHandle*    parent;
+        int                            depth = __path_depth(entry->sub_path);
 
-        if (strcmp(dp->d_name, ".") == 0 || strcmp(dp->d_name, "..") == 0) {
-            continue;
+        // close any directories we are done with
+        while (stackCount > depth + 1) {
+            status = vafs_directory_close(stack[--stackCount]);
+            if (status) {
+                VLOG_ERROR("bake", "failed to close directory\n");
+                break;
+            }
         }
-
-        combinedPath    = strpathcombine(path, dp->d_name);
-        combinedSubPath = strpathcombine(subPath, dp->d_name);
-        if (!combinedPath || !combinedSubPath) {
-            free((void*)combinedPath);
+        if (status) {
             break;
         }
+        parent = stack[stackCount - 1];
 
-        // does this match filters?
-        if (__matches_filters(combinedSubPath, filters)) {
-            free((void*)combinedPath);
-            free((void*)combinedSubPath);
-            continue;
-        }
-
-        status = platform_stat(combinedPath, &stats);
-        if (status) {
-            VLOG_ERROR("bake", "failed to get filetype for '%s'\n", combinedPath);
-            free((void*)combinedPath);
-            free((void*)combinedSubPath);
+        // does this match filters? otherwise skip it and anything below it
+        if (__matches_filters(entry->sub_path, filters)) {
+            i = __skip_entry(scan, i);
             continue;
         }
 
         // write progress before to update the file/folder in progress
-        __write_progress(dp->d_name, progress);
+        __write_progress(entry->name, progress);
 
-        // I under normal circumstances do absolutely revolt this type of christmas
-        // tree style code, however to avoid 7000 breaks and remembering to cleanup
-        // resources, we do it like this. It's not pretty, but it works.
-        if (stats.type == PLATFORM_FILETYPE_DIRECTORY) {
+        if (entry->type == PLATFORM_FILETYPE_DIRECTORY) {
             struct VaFsDirectoryHandle* subdirectoryHandle;
-            status = vafs_directory_create_directory(directoryHandle, dp->d_name, stats.permissions, &subdirectoryHandle);
+            status = vafs_directory_create_directory(parent, entry->name, entry->permissions, &subdirectoryHandle);
             if (status) {
-                VLOG_ERROR("bake", "failed to create directory '%s'\n", dp->d_name);
+                VLOG_ERROR("bake", "failed to create directory '%s'\n", entry->name);
             } else {
-                status = __write_directory(progress, filters, subdirectoryHandle, combinedPath, combinedSubPath);
+                status = __push_directory(&stack, &stackCount, &stackCapacity, subdirectoryHandle);
                 if (status) {
-                    VLOG_ERROR("bake", "unable to write directory %s\n", combinedPath);
-                } else {
-                    status = vafs_directory_close(subdirectoryHandle);
-                    if (status) {
-                        VLOG_ERROR("bake", "failed to close directory '%s'\n", combinedPath);
-                    }
+                    vafs_directory_close(subdirectoryHandle);
                 }
             }
-        } else if (stats.type == PLATFORM_FILETYPE_FILE) {
-            status = __write_file(directoryHandle, combinedPath, dp->d_name, stats.permissions);
+        } else if (entry->type == PLATFORM_FILETYPE_FILE) {
+            status = __write_file(parent, entry->path, entry->name, entry->permissions);
             if (status) {
-                VLOG_ERROR("bake", "unable to write file %s\n", dp->d_name);
+                VLOG_ERROR("bake", "unable to write file %s\n", entry->name);
             }
             progress->files++;
-        } else if (stats.type == PLATFORM_FILETYPE_SYMLINK) {
+        } else if (entry->type == PLATFORM_FILETYPE_SYMLINK) {
             char* linkpath;
-            status = platform_readlink(combinedPath, &linkpath);
+            status = platform_readlink(entry->path, &linkpath);
             if (status) {
-                VLOG_ERROR("bake", "failed to read link %s\n", combinedPath);
+                VLOG_ERROR("bake", "failed to read link %s\n", entry->path);
             } else {
-                status = vafs_directory_create_symlink(directoryHandle, dp->d_name, linkpath);
+                status = vafs_directory_create_symlink(parent, entry->name, linkpath);
                 free(linkpath);
                 if (status) {
-                    VLOG_ERROR("bake", "failed to create symlink %s\n", combinedPath);
+                    VLOG_ERROR("bake", "failed to create symlink %s\n", entry->path);
                 }
             }
             progress->symlinks++;
         } else {
             // ignore unsupported file types
-            VLOG_ERROR("bake", "unknown filetype for '%s'\n", combinedPath);
+            VLOG_ERROR("bake", "unknown filetype for '%s'\n", entry->path);
             status = 0;
         }
 
-        free((void*)combinedPath);
-        free((void*)combinedSubPath);
         if (status) {
             break;
         }
 
         // write progress after to update the file/folder in progress
-        __write_progress(dp->d_name, progress);
+        __write_progress(entry->name, progress);
+        i++;
     }
 
-    closedir(dfd);
+    // close remaining subdirectories, the root handle is owned by the caller
+    while (stackCount > 1) {
+        if (vafs_directory_close(stack[--stackCount]) && status == 0) {
+            VLOG_ERROR("bake", "failed to close directory\n");
+            status = -1;
+        }
+    }
+    free(stack);
     return status;
 }
 
@@ -980,40 +1078,44 @@ static int __is_cross_compiling(const char* target)
     return strcmp(CHEF_PLATFORM_STR, target) != 0 ? 1 : 0;
 }
 
-int bake_pack(struct __pack_options* options)
+static int __scan_input(const char* path, struct platform_scandir* scan)
+{
+    VLOG_DEBUG("bake", "enumerating files in %s\n", path);
+    return platform_scandir(
+        path,
+        PLATFORM_SCANDIR_RECURSIVE | PLATFORM_SCANDIR_DIRECTORIES | PLATFORM_SCANDIR_STAT,
+        0, scan
+    );
+}
+
+static int __pack_from_scan(struct __pack_options* options, struct platform_scandir* scan)
 {
     struct VaFsDirectoryHandle* directoryHandle;
     struct VaFsConfiguration    configuration;
     struct VaFs*                vafs     = NULL;
-    struct list                 files    = { 0 };
+    struct __pack_filter_set    filters  = { 0 };
     struct progress_context     progressContext = { 0 };
     int                         status;
     char*                       name;
     char*                       path;
     VLOG_DEBUG("bake", "bake_pack(name=%s, path=%s)\n", options->name, options->output_dir);
 
-    if (options == NULL) {
-        errno = EINVAL;
-        return -1;
-    }
-
-    VLOG_DEBUG("bake", "enumerating files in %s\n", options->input_dir);
-    status = platform_getfiles(options->input_dir, 1, &files);
+    status = __compile_filters(options->filters, &filters);
     if (status) {
-        VLOG_ERROR("bake", "failed to get files marked for install\n");
+        VLOG_ERROR("bake", "failed to prepare filters for %s\n", options->name);
         return -1;
     }
 
     status = __build_pack_names(options->name, options->output_dir, &name, &path);
     if (status) {
-        platform_getfiles_destroy(&files);
+        free(filters.filters);
         VLOG_ERROR("bake", "failed to get files marked for install\n");
         return -1;
     }
 
     __get_install_stats(
-        &files,
-        options->filters,
+        scan,
+        &filters,
         &progressContext.files_total,
         &progressContext.symlinks_total
     );
@@ -1056,7 +1158,7 @@ int bake_pack(struct __pack_options* options)
         goto cleanup;
     }
 
-    status = __write_directory(&progressContext, options->filters, directoryHandle, options->input_dir, NULL);
+    status = __write_directory(&progressContext, &filters, directoryHandle, scan);
     if (status != 0) {
         VLOG_ERROR("bake", "unable to write directory\n");
         goto cleanup;
@@ -1073,10 +1175,144 @@ cleanup:
     vafs_close(vafs);
     free(name);
     free(path);
-    platform_getfiles_destroy(&files);
+    free(filters.filters);
     if (g_compressContext != NULL) {
         ZSTD_freeCCtx(g_compressContext);
         g_compressContext = NULL;
     }
     return status;
 }
+
+int bake_pack(struct __pack_options* options)
+{
+    struct platform_scandir scan = { 0 };
+    int                     status;
+
+    if (options == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    status = __scan_input(options->input_dir, &scan);
+    if (status) {
+        VLOG_ERROR("bake", "failed to get files marked for install\n");
+        return -1;
+    }
+
+    status = __pack_from_scan(options, &scan);
+    platform_scandir_destroy(&scan);
+    return status;
+}
+
+struct __pack_queue {
+    mtx_t                    lock;
+    struct __pack_options*   options;
+    int                      count;
+    int                      next;
+    int                      status;
+    struct platform_scandir* scan;
+};
+
+static int __pack_worker(void* context)
+{
+    struct __pack_queue* queue = context;
+
+    for (;;) {
+        int index;
+        int status;
+
+        mtx_lock(&queue->lock);
+        if (queue->status || queue->next == queue->count) {
+            mtx_unlock(&queue->lock);
+            break;
+        }
+        index = queue->next++;
+        mtx_unlock(&queue->lock);
+
+        status = __pack_from_scan(&queue->options[index], queue->scan);
+        if (status) {
+            VLOG_ERROR("bake", "failed to construct pack %s\n", queue->options[index].name);
+            mtx_lock(&queue->lock);
+            queue->status = status;
+            mtx_unlock(&queue->lock);
+        }
+    }
+    return 0;
+}
+
+int bake_pack_multiple(struct __pack_options* options, int count)
+{
+    struct platform_scandir scan = { 0 };
+    struct __pack_queue     queue;
+    thrd_t*                 threads;
+    int                     threadCount;
+    int                     started = 0;
+    int                     status;
+
+    if (options == NULL || count < 0) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    // the tree is only shared if all packs are made from the same input
+    for (int i = 1; i < count; i++) {
+        if (strcmp(options[i].input_dir, options[0].input_dir) != 0) {
+            for (int j = 0; j < count; j++) {
+                status = bake_pack(&options[j]);
+                if (status) {
+                    return status;
+                }
+            }
+            return 0;
+        }
+    }
+
+    if (count == 0) {
+        return 0;
+    } else if (count == 1) {
+        return bake_pack(&options[0]);
+    }
+
+    status = __scan_input(options[0].input_dir, &scan);
+    if (status) {
+        VLOG_ERROR("bake", "failed to get files marked for install\n");
+        return -1;
+    }
+
+    queue.options = options;
+    queue.count   = count;
+    queue.next    = 0;
+    queue.status  = 0;
+    queue.scan    = &scan;
+    if (mtx_init(&queue.lock, mtx_plain) != thrd_success) {
+        platform_scandir_destroy(&scan);
+        return -1;
+    }
+
+    // every pack is compressed on its own thread, but never use more
+    // threads than we have cpus
+    threadCount = platform_cpucount();
+    if (threadCount > count) {
+        threadCount = count;
+    }
+
+    threads = calloc(threadCount > 0 ? threadCount : 1, sizeof(thrd_t));
+    if (threads != NULL) {
+        for (; started < threadCount - 1; started++) {
+            if (thrd_create(&threads[started], __pack_worker, &queue) != thrd_success) {
+                break;
+            }
+        }
+    }
+
+    // the calling thread participates as well
+    __pack_worker(&queue);
+    for (int i = 0; i < started; i++) {
+        thrd_join(threads[i], NULL);
+    }
+
+    free(threads);
+    mtx_destroy(&queue.lock);
+    platform_scandir_destroy(&scan);
+    return queue.status;
+}
@@ -74,4 +74,14 @@ struct __pack_options {
  */
 extern int bake_pack(struct __pack_options* options);
 
+/**
+ * @brief Builds multiple packs from the same input directory. The input is only
+ * scanned once, and the packs are written concurrently.
+ * 
+ * @param options An array of pack options, one for each pack
+ * @param count   The number of entries in the options array
+ * @return int Returns 0 on success, -1 on failure with errno set accordingly.
+ */
+extern int bake_pack_multiple(struct __pack_options* options, int count);
+
 #endif //!__PACK_H__
@@ -179,6 +179,27 @@ struct platform_file_entry {
     char*                  sub_path;
 };
 
+#define PLATFORM_SCANDIR_RECURSIVE   0x1
+#define PLATFORM_SCANDIR_DIRECTORIES 0x2
+#define PLATFORM_SCANDIR_STAT        0x4
+
+struct platform_scandir_entry {
+    const char*            name;
+    const char*            path;
+    const char*            sub_path;
+    enum platform_filetype type;
+    uint64_t               size;
+    uint32_t               permissions;
+};
+
+struct platform_scandir_arena;
+
+struct platform_scandir {
+    struct platform_scandir_entry* entries;
+    size_t                         count;
+    struct platform_scandir_arena* arena;
+};
+
 extern void   strbasename(const char* path, char* buffer, size_t bufferSize);
 extern char*  strpathjoin(const char* base, ...);
 extern char*  strpathcombine(const char* path1, const char* path2);
@@ -259,6 +280,23 @@ extern int platform_chdir(const char* path);
 extern int platform_chmod(const char* path, uint32_t permissions);
 extern int platform_getfiles(const char* path, int recursive, struct list* files);
 extern void platform_getfiles_destroy(struct list* files);
+
+/**
+ * @brief Scans a directory into a flat array of entries. All strings and the array
+ * itself are carved out of a single arena that is released by platform_scandir_destroy.
+ * Entries are sorted by sub-path in a way that every directory is immediately followed
+ * by its contents.
+ * 
+ * @param[In]  path    The directory to scan, a missing directory yields an empty result.
+ * @param[In]  flags   PLATFORM_SCANDIR_RECURSIVE to descend into subdirectories,
+ *                     PLATFORM_SCANDIR_DIRECTORIES to include directory entries when recursing,
+ *                     PLATFORM_SCANDIR_STAT to fill in size and permissions.
+ * @param[In]  threads The number of threads to scan with, 0 selects based on the cpu count.
+ * @param[Out] scanOut The result of the scan.
+ * @return int 0 on success, -1 on error with errno set.
+ */
+extern int platform_scandir(const char* path, unsigned int flags, int threads, struct platform_scandir* scanOut);
+extern void platform_scandir_destroy(struct platform_scandir* scan);
 extern int platform_cpucount(void);
 extern int platform_copyfile(const char* source, const char* destination);
 extern int platform_readfile(const char* path, void** bufferOut, size_t* lengthOut);
@@ -281,6 +319,7 @@ enum platform_spawn_output_type {
 };
 
 typedef void (*platform_spawn_output_handler)(const char* line, enum platform_spawn_output_type type);
+typedef void (*platform_spawn_line_handler)(const char* line, size_t length, enum platform_spawn_output_type type, void* context);
 
 struct platform_spawn_options {
     // cwd allows the possibility of spawning the process with
@@ -292,6 +331,14 @@ struct platform_spawn_options {
     // output_handler if provided will allow the spawner to handle
     // line output by the child process.
     platform_spawn_output_handler output_handler;
+    // line_handler if provided is invoked instead of output_handler with a view
+    // of each line, including the newline. The line is not zero terminated and
+    // is only valid for the duration of the call.
+    platform_spawn_line_handler line_handler;
+    void*                       line_context;
+    // tee_fd if set to a valid descriptor, receives a raw copy of everything
+    // the child writes to stdout and stderr. 0 disables this. Linux only.
+    int tee_fd;
 };
 
 /**
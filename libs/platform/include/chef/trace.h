@@ -0,0 +1,103 @@
+/**
+ * Copyright, Philip Meulengracht
+ *
+ * This program is free software : you can redistribute it and / or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation ? , either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ * 
+ */
+
+#ifndef __CHEF_TRACE_H__
+#define __CHEF_TRACE_H__
+
+#include <stdint.h>
+
+/**
+ * Span tracing for build pipelines. Completed spans are recorded into a fixed
+ * size ring buffer with their thread ids, and can be exported in the Chrome
+ * trace-event format (loadable by Perfetto and chrome://tracing). When tracing
+ * has not been enabled, beginning and ending a span only tests a flag.
+ */
+
+/**
+ * @brief Environment variable that tells child processes where to flush their
+ * spans. It is set by the parent that owns the trace.
+ */
+#define CHEF_TRACE_ENVIRONMENT "CHEF_TRACE_FILE"
+
+struct chef_trace_span {
+    uint64_t start;
+};
+
+extern volatile int g_chef_trace_enabled;
+
+extern uint64_t chef_trace_now(void);
+extern void     chef_trace_record(uint64_t start, const char* category, const char* format, ...);
+
+/**
+ * @brief Enables the recording of spans for this process.
+ * 
+ * @param[In] processName The name the process is shown as in the trace.
+ * @param[In] capacity    Number of spans the ring buffer can hold, 0 selects the default.
+ *                        Once full, the oldest spans are overwritten.
+ * @return int 0 on success, -1 on error with errno set.
+ */
+extern int chef_trace_enable(const char* processName, unsigned int capacity);
+
+/**
+ * @brief Enables tracing if CHEF_TRACE_ENVIRONMENT is set, in which case
+ * chef_trace_flush will append the spans to the file it names.
+ * 
+ * @return int 0 if tracing was enabled or not requested, -1 on error.
+ */
+extern int chef_trace_enable_from_environment(const char* processName);
+
+/**
+ * @brief Stops recording and releases the ring buffer.
+ */
+extern void chef_trace_disable(void);
+
+static inline void chef_trace_begin(struct chef_trace_span* span)
+{
+    span->start = g_chef_trace_enabled ? chef_trace_now() : 0;
+}
+
+/**
+ * @brief Completes a span started by chef_trace_begin, the name of the span
+ * is formatted from the format string. Spans that were started before tracing
+ * was enabled are ignored.
+ */
+#define chef_trace_end(span, category, ...) \
+    do { \
+        if (g_chef_trace_enabled && (span)->start != 0) { \
+            chef_trace_record((span)->start, category, __VA_ARGS__); \
+        } \
+    } while (0)
+
+/**
+ * @brief Appends all recorded spans as trace events, one per line, to the file
+ * configured by chef_trace_enable_from_environment, and clears the ring buffer.
+ * Does nothing if tracing is not enabled.
+ */
+extern int chef_trace_flush(void);
+
+/**
+ * @brief Writes all recorded spans to a Chrome trace-event JSON file.
+ * 
+ * @param[In] path       The path of the trace file to write.
+ * @param[In] importPath Optional path to a file produced by chef_trace_flush in
+ *                       another process, whose events are merged into the trace.
+ * @return int 0 on success, -1 on error with errno set.
+ */
+extern int chef_trace_write(const char* path, const char* importPath);
+
+#endif //!__CHEF_TRACE_H__
@@ -0,0 +1,581 @@
+/**
+ * Copyright, Philip Meulengracht
+ *
+ * This program is free software : you can redistribute it and / or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation ? , either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ * 
+ */
+
+#if defined(__linux__)
+#define _GNU_SOURCE // O_DIRECTORY, O_NOFOLLOW
+#endif
+
+#include <errno.h>
+#include <chef/platform.h>
+#include <stdlib.h>
+#include <string.h>
+#include <threads.h>
+
+// include dirent.h for directory operations
+#if defined(_WIN32) || defined(_WIN64)
+#include <dirent_win32.h>
+#else
+#include <dirent.h>
+#endif
+
+#if defined(__linux__)
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// Strings and entries are bump-allocated out of blocks of this size, larger
+// requests get a block of their own.
+#define __ARENA_BLOCK_SIZE (256 * 1024)
+
+// Size of the buffer handed to getdents64, this is large enough that most
+// directories are read in a single system call.
+#define __DIRENT_BUFFER_SIZE (32 * 1024)
+
+// The upper bound of workers used, directory scanning is mostly bound
+// by the filesystem so more than this does not help.
+#define __MAX_WORKERS 16
+
+struct __arena_block {
+    struct __arena_block* next;
+    size_t                size;
+    size_t                used;
+    char                  data[];
+};
+
+struct platform_scandir_arena {
+    struct __arena_block* blocks;
+};
+
+struct __scan_job {
+    struct __scan_job* next;
+    const char*        path;
+    size_t             path_length;
+};
+
+struct __scan_worker {
+    struct __scan_context*        context;
+    struct platform_scandir_arena arena;
+    struct platform_scandir_entry* entries;
+    size_t                         count;
+    size_t                         capacity;
+    thrd_t                         thread;
+    int                            started;
+};
+
+struct __scan_context {
+    unsigned int flags;
+    size_t       root_length;
+
+    mtx_t              lock;
+    cnd_t              signal;
+    struct __scan_job* queue;
+    int                pending;
+    int                status;
+    int                error;
+};
+
+static void* __arena_alloc(struct platform_scandir_arena* arena, size_t size)
+{
+    struct __arena_block* block = arena->blocks;
+    void*                 memory;
+
+    size = (size + 7) & ~(size_t)7;
+    if (block == NULL || (block->size - block->used) < size) {
+        size_t blockSize = size > __ARENA_BLOCK_SIZE ? size : __ARENA_BLOCK_SIZE;
+
+        block = malloc(sizeof(struct __arena_block) + blockSize);
+        if (block == NULL) {
+            return NULL;
+        }
+        block->size = blockSize;
+        block->used = 0;
+        block->next = arena->blocks;
+        arena->blocks = block;
+    }
+
+    memory = &block->data[block->used];
+    block->used += size;
+    return memory;
+}
+
+static void __arena_merge(struct platform_scandir_arena* arena, struct platform_scandir_arena* other)
+{
+    struct __arena_block* tail = other->blocks;
+
+    if (tail == NULL) {
+        return;
+    }
+
+    while (tail->next != NULL) {
+        tail = tail->next;
+    }
+    tail->next = arena->blocks;
+    arena->blocks = other->blocks;
+    other->blocks = NULL;
+}
+
+static void __arena_destroy(struct platform_scandir_arena* arena)
+{
+    struct __arena_block* block = arena->blocks;
+
+    while (block != NULL) {
+        struct __arena_block* next = block->next;
+        free(block);
+        block = next;
+    }
+    arena->blocks = NULL;
+}
+
+// Builds <parent>/<name> in the arena, the returned string is also the storage
+// for the entry name and sub-path which are both suffixes of it.
+static char* __combine_path(struct platform_scandir_arena* arena, const char* parent, size_t parentLength, const char* name, size_t nameLength, size_t* lengthOut)
+{
+    int   separator = parentLength > 0 && parent[parentLength - 1] != CHEF_PATH_SEPARATOR;
+    char* path;
+
+    path = __arena_alloc(arena, parentLength + separator + nameLength + 1);
+    if (path == NULL) {
+        return NULL;
+    }
+    *lengthOut = parentLength + separator + nameLength;
+
+    memcpy(path, parent, parentLength);
+    if (separator) {
+        path[parentLength] = CHEF_PATH_SEPARATOR;
+    }
+    memcpy(&path[parentLength + separator], name, nameLength + 1);
+    return path;
+}
+
+static void __fail(struct __scan_context* context, int error)
+{
+    mtx_lock(&context->lock);
+    if (context->status == 0) {
+        context->status = -1;
+        context->error  = error;
+    }
+    cnd_broadcast(&context->signal);
+    mtx_unlock(&context->lock);
+}
+
+static int __queue_directory(struct __scan_worker* worker, const char* path, size_t pathLength)
+{
+    struct __scan_context* context = worker->context;
+    struct __scan_job*     job;
+
+    job = __arena_alloc(&worker->arena, sizeof(struct __scan_job));
+    if (job == NULL) {
+        return -1;
+    }
+    job->path        = path;
+    job->path_length = pathLength;
+
+    mtx_lock(&context->lock);
+    job->next      = context->queue;
+    context->queue = job;
+    context->pending++;
+    cnd_signal(&context->signal);
+    mtx_unlock(&context->lock);
+    return 0;
+}
+
+static int __add_entry(
+    struct __scan_worker*  worker,
+    const char*            parent,
+    size_t                 parentLength,
+    const char*            name,
+    enum platform_filetype type,
+    struct platform_stat*  stats)
+{
+    struct __scan_context*         context = worker->context;
+    struct platform_scandir_entry* entry;
+    size_t                         nameLength = strlen(name);
+    size_t                         pathLength;
+    char*                          path;
+
+    path = __combine_path(&worker->arena, parent, parentLength, name, nameLength, &pathLength);
+    if (path == NULL) {
+        return -1;
+    }
+
+    if (type == PLATFORM_FILETYPE_DIRECTORY && (context->flags & PLATFORM_SCANDIR_RECURSIVE)) {
+        if (__queue_directory(worker, path, pathLength)) {
+            return -1;
+        }
+        if (!(context->flags & PLATFORM_SCANDIR_DIRECTORIES)) {
+            return 0;
+        }
+    }
+
+    if (worker->count == worker->capacity) {
+        size_t                         capacity = worker->capacity ? worker->capacity * 2 : 256;
+        struct platform_scandir_entry* entries;
+
+        entries = realloc(worker->entries, capacity * sizeof(struct platform_scandir_entry));
+        if (entries == NULL) {
+            return -1;
+        }
+        worker->entries  = entries;
+        worker->capacity = capacity;
+    }
+
+    entry = &worker->entries[worker->count++];
+    entry->path     = path;
+    entry->name     = path + pathLength - nameLength;
+    entry->sub_path = path + context->root_length;
+    if (*entry->sub_path == CHEF_PATH_SEPARATOR) {
+        entry->sub_path++;
+    }
+    entry->type        = stats != NULL ? stats->type : type;
+    entry->size        = stats != NULL ? stats->size : 0;
+    entry->permissions = stats != NULL ? stats->permissions : 0;
+    return 0;
+}
+
+#if defined(__linux__)
+
+struct __linux_dirent64 {
+    uint64_t       d_ino;
+    int64_t        d_off;
+    unsigned short d_reclen;
+    unsigned char  d_type;
+    char           d_name[];
+};
+
+static enum platform_filetype __filetype_from_mode(mode_t mode)
+{
+    switch (mode & S_IFMT) {
+        case S_IFREG: return PLATFORM_FILETYPE_FILE;
+        case S_IFDIR: return PLATFORM_FILETYPE_DIRECTORY;
+        case S_IFLNK: return PLATFORM_FILETYPE_SYMLINK;
+        default:      return PLATFORM_FILETYPE_UNKNOWN;
+    }
+}
+
+static enum platform_filetype __filetype_from_dtype(unsigned char type)
+{
+    switch (type) {
+        case DT_REG: return PLATFORM_FILETYPE_FILE;
+        case DT_DIR: return PLATFORM_FILETYPE_DIRECTORY;
+        case DT_LNK: return PLATFORM_FILETYPE_SYMLINK;
+        default:     return PLATFORM_FILETYPE_UNKNOWN;
+    }
+}
+
+static int __scan_directory(struct __scan_worker* worker, struct __scan_job* job, char* buffer)
+{
+    int fd;
+    int flags = O_RDONLY | O_DIRECTORY | O_CLOEXEC;
+    int status = 0;
+
+    // the root given by the caller may be a symlink, but symlinked entries
+    // found during the scan are never followed. Child paths are always
+    // longer than the root.
+    if (job->path_length > worker->context->root_length) {
+        flags |= O_NOFOLLOW;
+    }
+
+    fd = openat(AT_FDCWD, job->path, flags);
+    if (fd < 0) {
+        // the directory may have disappeared while we were scanning
+        return errno == ENOENT ? 0 : -1;
+    }
+
+    while (status == 0) {
+        long bytes = syscall(SYS_getdents64, fd, buffer, __DIRENT_BUFFER_SIZE);
+        long offset;
+        if (bytes <= 0) {
+            if (bytes < 0) {
+                status = -1;
+            }
+            break;
+        }
+
+        for (offset = 0; offset < bytes && status == 0;) {
+            struct __linux_dirent64* dp   = (struct __linux_dirent64*)(buffer + offset);
+            enum platform_filetype   type = __filetype_from_dtype(dp->d_type);
+            struct platform_stat     stats;
+            offset += dp->d_reclen;
+
+            if (dp->d_name[0] == '.' && (dp->d_name[1] == '\0' ||
+                (dp->d_name[1] == '.' && dp->d_name[2] == '\0'))) {
+                continue;
+            }
+
+            // stat relative to the directory descriptor to avoid resolving
+            // the full path again for every entry
+            if ((worker->context->flags & PLATFORM_SCANDIR_STAT) || dp->d_type == DT_UNKNOWN) {
+                struct stat st;
+                if (fstatat(fd, dp->d_name, &st, AT_SYMLINK_NOFOLLOW)) {
+                    if (errno == ENOENT) {
+                        continue;
+                    }
+                    status = -1;
+                    break;
+                }
+                stats.type        = __filetype_from_mode(st.st_mode);
+                stats.size        = st.st_size;
+                stats.permissions = st.st_mode & 0777;
+                type = stats.type;
+            }
+
+            status = __add_entry(worker, job->path, job->path_length, dp->d_name, type,
+                (worker->context->flags & PLATFORM_SCANDIR_STAT) ? &stats : NULL);
+        }
+    }
+    close(fd);
+    return status;
+}
+
+#else
+
+static int __scan_directory(struct __scan_worker* worker, struct __scan_job* job, char* buffer)
+{
+    struct dirent* dp;
+    DIR*           d;
+    int            status = 0;
+    (void)buffer;
+
+    if ((d = opendir(job->path)) == NULL) {
+        return errno == ENOENT ? 0 : -1;
+    }
+
+    while (status == 0 && (dp = readdir(d)) != NULL) {
+        struct platform_stat stats;
+        char*                path;
+
+        if (strcmp(dp->d_name, ".") == 0 || strcmp(dp->d_name, "..") == 0) {
+            continue;
+        }
+
+        path = strpathcombine(job->path, dp->d_name);
+        if (path == NULL) {
+            status = -1;
+            break;
+        }
+        status = platform_stat(path, &stats);
+        free(path);
+        if (status) {
+            break;
+        }
+
+        status = __add_entry(worker, job->path, job->path_length, dp->d_name, stats.type,
+            (worker->context->flags & PLATFORM_SCANDIR_STAT) ? &stats : NULL);
+    }
+    closedir(d);
+    return status;
+}
+
+#endif
+
+static int __scan_worker_main(void* argument)
+{
+    struct __scan_worker*  worker  = argument;
+    struct __scan_context* context = worker->context;
+    char*                  buffer;
+
+    buffer = malloc(__DIRENT_BUFFER_SIZE);
+    if (buffer == NULL) {
+        __fail(context, errno);
+        return -1;
+    }
+
+    mtx_lock(&context->lock);
+    while (context->status == 0) {
+        struct __scan_job* job = context->queue;
+        int                status;
+
+        if (job == NULL) {
+            if (context->pending == 0) {
+                break;
+            }
+            cnd_wait(&context->signal, &context->lock);
+            continue;
+        }
+        context->queue = job->next;
+        mtx_unlock(&context->lock);
+
+        status = __scan_directory(worker, job, buffer);
+        if (status) {
+            __fail(context, errno);
+        }
+
+        mtx_lock(&context->lock);
+        if (--context->pending == 0) {
+            cnd_broadcast(&context->signal);
+        }
+    }
+    mtx_unlock(&context->lock);
+    free(buffer);
+    return 0;
+}
+
+// Orders paths so that every directory is immediately followed by all of its
+// contents, which means the separator must sort before any other character.
+static int __compare_entries(const void* a, const void* b)
+{
+    const unsigned char* pathA = (const unsigned char*)((const struct platform_scandir_entry*)a)->sub_path;
+    const unsigned char* pathB = (const unsigned char*)((const struct platform_scandir_entry*)b)->sub_path;
+
+    while (*pathA && *pathA == *pathB) {
+        pathA++;
+        pathB++;
+    }
+
+    if (*pathA == *pathB) {
+        return 0;
+    }
+    if (*pathA == CHEF_PATH_SEPARATOR) {
+        return *pathB == '\0' ? 1 : -1;
+    }
+    if (*pathB == CHEF_PATH_SEPARATOR) {
+        return *pathA == '\0' ? -1 : 1;
+    }
+    return (int)*pathA - (int)*pathB;
+}
+
+static int __collect_entries(struct __scan_worker* workers, int workerCount, struct platform_scandir* scan)
+{
+    size_t total = 0;
+    int    i;
+
+    scan->arena = calloc(1, sizeof(struct platform_scandir_arena));
+    if (scan->arena == NULL) {
+        return -1;
+    }
+
+    for (i = 0; i < workerCount; i++) {
+        total += workers[i].count;
+        __arena_merge(scan->arena, &workers[i].arena);
+    }
+
+    if (total == 0) {
+        return 0;
+    }
+
+    scan->entries = __arena_alloc(scan->arena, total * sizeof(struct platform_scandir_entry));
+    if (scan->entries == NULL) {
+        return -1;
+    }
+
+    for (i = 0; i < workerCount; i++) {
+        if (workers[i].count) {
+            memcpy(&scan->entries[scan->count], workers[i].entries,
+                workers[i].count * sizeof(struct platform_scandir_entry));
+            scan->count += workers[i].count;
+        }
+    }
+    qsort(scan->entries, scan->count, sizeof(struct platform_scandir_entry), __compare_entries);
+    return 0;
+}
+
+int platform_scandir(const char* path, unsigned int flags, int threads, struct platform_scandir* scanOut)
+{
+    struct __scan_context context = { 0 };
+    struct __scan_worker* workers;
+    struct __scan_job     root;
+    int                   workerCount;
+    int                   status;
+    int                   i;
+
+    if (path == NULL || scanOut == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+    memset(scanOut, 0, sizeof(struct platform_scandir));
+
+    workerCount = threads > 0 ? threads : platform_cpucount();
+    if (!(flags & PLATFORM_SCANDIR_RECURSIVE) || workerCount < 1) {
+        workerCount = 1;
+    } else if (workerCount > __MAX_WORKERS) {
+        workerCount = __MAX_WORKERS;
+    }
+
+    workers = calloc(workerCount, sizeof(struct __scan_worker));
+    if (workers == NULL) {
+        return -1;
+    }
+
+    context.flags       = flags;
+    context.root_length = strlen(path);
+    if (mtx_init(&context.lock, mtx_plain) != thrd_success) {
+        free(workers);
+        return -1;
+    }
+    if (cnd_init(&context.signal) != thrd_success) {
+        mtx_destroy(&context.lock);
+        free(workers);
+        return -1;
+    }
+
+    root.next        = NULL;
+    root.path        = path;
+    root.path_length = context.root_length;
+    context.queue    = &root;
+    context.pending  = 1;
+
+    // the calling thread acts as the first worker, the rest are only
+    // spun up when recursing
+    for (i = 0; i < workerCount; i++) {
+        workers[i].context = &context;
+        if (i > 0 && thrd_create(&workers[i].thread, __scan_worker_main, &workers[i]) == thrd_success) {
+            workers[i].started = 1;
+        }
+    }
+    __scan_worker_main(&workers[0]);
+    for (i = 1; i < workerCount; i++) {
+        if (workers[i].started) {
+            thrd_join(workers[i].thread, NULL);
+        }
+    }
+
+    status = context.status;
+    if (status == 0) {
+        status = __collect_entries(workers, workerCount, scanOut);
+    } else {
+        errno = context.error;
+    }
+
+    for (i = 0; i < workerCount; i++) {
+        __arena_destroy(&workers[i].arena);
+        free(workers[i].entries);
+    }
+    free(workers);
+    cnd_destroy(&context.signal);
+    mtx_destroy(&context.lock);
+
+    if (status) {
+        platform_scandir_destroy(scanOut);
+    }
+    return status;
+}
+
+void platform_scandir_destroy(struct platform_scandir* scan)
+{
+    if (scan == NULL) {
+        return;
+    }
+
+    if (scan->arena != NULL) {
+        __arena_destroy(scan->arena);
+        free(scan->arena);
+    }
+    memset(scan, 0, sizeof(struct platform_scandir));
+}
@@ -21,65 +21,222 @@
 
 #include <errno.h>
 #include <chef/platform.h>
+#include <fcntl.h>
+#include <limits.h>
 #include <poll.h>
 #include <spawn.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <sys/wait.h>
 #include <string.h>
+#include <unistd.h>
 
-static void __report(char* line, enum platform_spawn_output_type type, struct platform_spawn_options* options)
+// Lines are accumulated in a per-stream buffer that starts out at this size
+// and grows as needed, up to the max line size after which a line is
+// reported in pieces.
+#define __SPAWN_BUFFER_INITIAL  (16 * 1024)
+#define __SPAWN_LINE_MAX        (1024 * 1024)
+
+struct __spawn_stream {
+    enum platform_spawn_output_type type;
+    char*                           buffer;
+    size_t                          length;
+    size_t                          capacity;
+};
+
+static void __dispatch_line(struct __spawn_stream* stream, char* line, size_t length, struct platform_spawn_options* options)
+{
+    char terminator;
+
+    if (options->line_handler) {
+        options->line_handler(line, length, stream->type, options->line_context);
+        return;
+    }
+
+    // the legacy handler expects a zero terminated string, the buffer always
+    // has room for one more byte, so terminate in place and restore it after
+    terminator = line[length];
+    line[length] = '\0';
+    options->output_handler(line, stream->type);
+    line[length] = terminator;
+}
+
+// Reports all complete lines in the buffer and moves any partial line
+// to the front. When <final> is set any remaining data is reported too.
+static void __split_lines(struct __spawn_stream* stream, struct platform_spawn_options* options, int final)
+{
+    char*  start = stream->buffer;
+    char*  end   = stream->buffer + stream->length;
+    char*  newline;
+
+    while (start < end && (newline = memchr(start, '\n', (size_t)(end - start))) != NULL) {
+        __dispatch_line(stream, start, (size_t)(newline - start) + 1, options);
+        start = newline + 1;
+    }
+
+    // report partial lines if we are done, or if the line has exceeded
+    // the maximum size we are willing to buffer
+    if (start < end && (final || (size_t)(end - start) >= __SPAWN_LINE_MAX)) {
+        __dispatch_line(stream, start, (size_t)(end - start), options);
+        start = end;
+    }
+
+    stream->length = (size_t)(end - start);
+    if (stream->length && start != stream->buffer) {
+        memmove(stream->buffer, start, stream->length);
+    }
+}
+
+static int __ensure_capacity(struct __spawn_stream* stream)
+{
+    size_t capacity;
+    char*  buffer;
+
+    // always keep a spare byte for zero termination, and a reasonable
+    // amount of room to read into
+    if (stream->buffer != NULL && (stream->capacity - stream->length) > 4096) {
+        return 0;
+    }
+
+    capacity = stream->capacity ? stream->capacity * 2 : __SPAWN_BUFFER_INITIAL;
+    buffer = realloc(stream->buffer, capacity);
+    if (buffer == NULL) {
+        return -1;
+    }
+    stream->buffer   = buffer;
+    stream->capacity = capacity;
+    return 0;
+}
+
+// Duplicates whatever is pending in the pipe into the tee pipe without consuming
+// it, and then moves it to the log descriptor, the data never enters userspace.
+// Returns the number of bytes that were duplicated.
+static ssize_t __tee_output(int fd, int teePipe[2], int teeFd)
 {
-    const char* s = line;
-    char*       p = line;
-    char        tmp[2048];
-
-    while (*p) {
-        if (*p == '\n') {
-            // include the \n
-            size_t count = (size_t)(p - s) + 1;
-            strncpy(&tmp[0], s, count);
-
-            // zero terminate the string and report
-            tmp[count] = '\0';
-            options->output_handler(&tmp[0], type);
-
-            // update new start
-            s = ++p;
-        } else {
-            p++;
+    ssize_t bytes = tee(fd, teePipe[1], INT_MAX, SPLICE_F_NONBLOCK);
+    ssize_t remaining = bytes;
+    if (bytes <= 0) {
+        return bytes == 0 || errno == EAGAIN ? 0 : -1;
+    }
+
+    while (remaining > 0) {
+        ssize_t moved = splice(teePipe[0], NULL, teeFd, NULL, (size_t)remaining, SPLICE_F_MOVE);
+        if (moved <= 0) {
+            if (moved < 0 && errno == EINTR) {
+                continue;
+            }
+            return -1;
         }
+        remaining -= moved;
     }
-    
-    // only do a final report if the line didn't end with a newline
-    if (s != p) {
-        options->output_handler(s, type);
+    return bytes;
+}
+
+// Reads at most <limit> bytes from the descriptor into the stream, and reports
+// any lines that were completed by it. If <copyFd> is set, the raw data is
+// written to it as well.
+static ssize_t __read_stream(int fd, struct __spawn_stream* stream, size_t limit, int copyFd, struct platform_spawn_options* options)
+{
+    ssize_t bytes;
+    size_t  space;
+
+    if (__ensure_capacity(stream)) {
+        return -1;
     }
+
+    space = stream->capacity - stream->length - 1;
+    do {
+        bytes = read(fd, stream->buffer + stream->length, limit < space ? limit : space);
+    } while (bytes < 0 && errno == EINTR);
+
+    if (bytes > 0) {
+        if (copyFd != -1 && write(copyFd, stream->buffer + stream->length, (size_t)bytes) < 0) {
+            // never fail the spawn because the log copy failed
+        }
+        stream->length += (size_t)bytes;
+        __split_lines(stream, options, 0);
+    }
+    return bytes;
 }
 
 // 0 => stdout
 // 1 => stderr
 static void __wait_and_read_stds(struct pollfd* fds, struct platform_spawn_options* options)
 {
-    char line[2048];
+    struct __spawn_stream streams[2] = {
+        { .type = PLATFORM_SPAWN_OUTPUT_TYPE_STDOUT },
+        { .type = PLATFORM_SPAWN_OUTPUT_TYPE_STDERR }
+    };
+    int teePipe[2] = { -1, -1 };
+    int teeFd      = options->tee_fd > 0 ? options->tee_fd : -1;
+    int open       = 2;
 
-    for (;;) {
+    if (teeFd != -1 && pipe2(teePipe, O_CLOEXEC)) {
+        teePipe[0] = teePipe[1] = -1;
+    }
+
+    while (open > 0) {
         int status = poll(fds, 2, -1);
-        if (status <= 0) {
-            return;
-        }
-        if (fds[0].revents & POLLIN) {
-            status = read(fds[0].fd, &line[0], sizeof(line));
-            line[status] = 0;
-            __report(&line[0], PLATFORM_SPAWN_OUTPUT_TYPE_STDOUT, options);
-        } else if (fds[1].revents & POLLIN) {
-            status = read(fds[1].fd, &line[0], sizeof(line));
-            line[status] = 0;
-            __report(&line[0], PLATFORM_SPAWN_OUTPUT_TYPE_STDERR, options);
-        } else {
+        if (status < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
             break;
         }
+
+        // service every descriptor that has something for us, otherwise a noisy
+        // stream can starve the other one
+        for (int i = 0; i < 2; i++) {
+            struct __spawn_stream* stream = &streams[i];
+            ssize_t                bytes;
+
+            if (fds[i].fd < 0 || !(fds[i].revents & (POLLIN | POLLHUP | POLLERR))) {
+                continue;
+            }
+
+            if (teeFd != -1 && teePipe[0] != -1) {
+                ssize_t teed = __tee_output(fds[i].fd, teePipe, teeFd);
+                if (teed > 0) {
+                    // consume exactly what was copied to the log, so nothing is
+                    // logged twice or skipped
+                    while (teed > 0) {
+                        bytes = __read_stream(fds[i].fd, stream, (size_t)teed, -1, options);
+                        if (bytes <= 0) {
+                            break;
+                        }
+                        teed -= bytes;
+                    }
+                    continue;
+                } else if (teed < 0) {
+                    // the log descriptor does not support splicing, write it
+                    // from the buffer instead
+                    close(teePipe[0]);
+                    close(teePipe[1]);
+                    teePipe[0] = teePipe[1] = -1;
+                }
+            }
+
+            // when splicing is not possible the log copy is written from the buffer
+            bytes = __read_stream(fds[i].fd, stream, SIZE_MAX, teePipe[0] == -1 ? teeFd : -1, options);
+            if (bytes < 0 && errno == EAGAIN) {
+                continue;
+            }
+
+            if (bytes <= 0) {
+                __split_lines(stream, options, 1);
+                fds[i].fd = -1;
+                open--;
+                continue;
+            }
+        }
+    }
+
+    if (teePipe[0] != -1) {
+        close(teePipe[0]);
+        close(teePipe[1]);
     }
+    free(streams[0].buffer);
+    free(streams[1].buffer);
 }
 
 int platform_spawn(const char* path, const char* arguments, const char* const* envp, struct platform_spawn_options* options)
@@ -114,7 +271,7 @@ int platform_spawn(const char* path, const char* arguments, const char* const* e
         posix_spawn_file_actions_addchdir_np(&actions, options->cwd);
     }
 
-    if (options && options->output_handler) {
+    if (options && (options->output_handler || options->line_handler)) {
         // let's redirect and poll for output
         if (pipe(outp) || pipe(errp)) {
             if (outp[0] > 0) {
@@ -135,7 +292,7 @@ int platform_spawn(const char* path, const char* arguments, const char* const* e
         goto cleanup;
     }
 
-    if (options && options->output_handler) {
+    if (options && (options->output_handler || options->line_handler)) {
         struct pollfd fds[2] = { 
             { 
                 .fd = outp[0],
@@ -152,6 +309,8 @@ int platform_spawn(const char* path, const char* arguments, const char* const* e
         close(errp[1]); 
 
         __wait_and_read_stds(&fds[0], options);
+        close(outp[0]);
+        close(errp[0]);
     }
 
     // wait for the process to complete
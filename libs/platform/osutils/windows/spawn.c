@@ -24,6 +24,15 @@
 
 #define OUTPUT_BUFFER_SIZE 2048
 
+static void __dispatch(const char* line, size_t length, enum platform_spawn_output_type type, struct platform_spawn_options* options)
+{
+    if (options->line_handler) {
+        options->line_handler(line, length, type, options->line_context);
+    } else {
+        options->output_handler(line, type);
+    }
+}
+
 static void __report(char* line, enum platform_spawn_output_type type, struct platform_spawn_options* options)
 {
     const char* s = line;
@@ -38,7 +47,7 @@ static void __report(char* line, enum platform_spawn_output_type type, struct pl
 
             // zero terminate the string and report
             tmp[count] = '\0';
-            options->output_handler(&tmp[0], type);
+            __dispatch(&tmp[0], count, type, options);
 
             // update new start
             s = ++p;
@@ -49,7 +58,7 @@ static void __report(char* line, enum platform_spawn_output_type type, struct pl
     
     // only do a final report if the line didn't end with a newline
     if (s != p) {
-        options->output_handler(s, type);
+        __dispatch(s, (size_t)(p - s), type, options);
     }
 }
 
@@ -86,7 +95,7 @@ int platform_spawn(const char* path, const char* arguments, const char* const* e
     sa.lpSecurityDescriptor = NULL;
 
     // Create pipes for stdout and stderr if output handler is provided
-    if (options && options->output_handler) {
+    if (options && (options->output_handler || options->line_handler)) {
         if (!CreatePipe(&hStdoutRead, &hStdoutWrite, &sa, 0) ||
             !CreatePipe(&hStderrRead, &hStderrWrite, &sa, 0)) {
             fprintf(stderr, "platform_spawn: failed to create pipes\n");
@@ -180,7 +189,7 @@ int platform_spawn(const char* path, const char* arguments, const char* const* e
     }
 
     // Read output if handler is provided
-    if (options && options->output_handler) {
+    if (options && (options->output_handler || options->line_handler)) {
         char buffer[OUTPUT_BUFFER_SIZE];
         BOOL processRunning = TRUE;
 
@@ -61,7 +61,7 @@ int strfilter(const char* filter, const char* text, int flags)
                 } else {
                     // wildcard match
                     // * does not match '/'
-                    while (*i != CHEF_PATH_SEPARATOR && FOLD(*i) != FOLD(*(fi + 1))) {
+                    while (*i && *i != CHEF_PATH_SEPARATOR && FOLD(*i) != FOLD(*(fi + 1))) {
                         i++;
                     }
                 }
@@ -0,0 +1,276 @@
+/**
+ * Copyright, Philip Meulengracht
+ *
+ * This program is free software : you can redistribute it and / or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation ? , either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ * 
+ */
+
+#include <chef/platform.h>
+#include <chef/trace.h>
+#include <errno.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(WIN32) || defined(_WIN32) || defined(__WIN32__) || defined(__NT__)
+#include <windows.h>
+#define __current_pid() ((uint32_t)GetCurrentProcessId())
+#define __current_tid() ((uint32_t)GetCurrentThreadId())
+#else
+#include <sys/syscall.h>
+#include <unistd.h>
+#define __current_pid() ((uint32_t)getpid())
+#define __current_tid() ((uint32_t)syscall(SYS_gettid))
+#endif
+
+#define __TRACE_DEFAULT_CAPACITY 16384
+#define __TRACE_NAME_LENGTH      96
+
+struct __trace_event {
+    uint64_t    start;
+    uint64_t    end;
+    uint32_t    tid;
+    const char* category;
+    char        name[__TRACE_NAME_LENGTH];
+};
+
+struct __trace_context {
+    struct __trace_event* events;
+    unsigned int          capacity;
+    atomic_size_t         head;
+    uint32_t              pid;
+    char                  process[64];
+    char*                 flush_path;
+};
+
+volatile int                  g_chef_trace_enabled = 0;
+static struct __trace_context g_trace = { 0 };
+
+uint64_t chef_trace_now(void)
+{
+    struct timespec ts;
+#if defined(CLOCK_MONOTONIC)
+    // the monotonic clock is shared with processes running inside containers,
+    // which keeps their spans on the same timeline
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+#else
+    timespec_get(&ts, TIME_UTC);
+#endif
+    return ((uint64_t)ts.tv_sec * 1000000000ULL) + (uint64_t)ts.tv_nsec;
+}
+
+int chef_trace_enable(const char* processName, unsigned int capacity)
+{
+    if (processName == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (g_trace.events != NULL) {
+        return 0;
+    }
+
+    if (capacity == 0) {
+        capacity = __TRACE_DEFAULT_CAPACITY;
+    }
+
+    g_trace.events = calloc(capacity, sizeof(struct __trace_event));
+    if (g_trace.events == NULL) {
+        return -1;
+    }
+    g_trace.capacity = capacity;
+    g_trace.pid = __current_pid();
+    atomic_store(&g_trace.head, 0);
+    snprintf(&g_trace.process[0], sizeof(g_trace.process), "%s", processName);
+    g_chef_trace_enabled = 1;
+    return 0;
+}
+
+int chef_trace_enable_from_environment(const char* processName)
+{
+    const char* path = getenv(CHEF_TRACE_ENVIRONMENT);
+    if (path == NULL || path[0] == '\0') {
+        return 0;
+    }
+
+    g_trace.flush_path = platform_strdup(path);
+    if (g_trace.flush_path == NULL) {
+        return -1;
+    }
+    return chef_trace_enable(processName, 0);
+}
+
+void chef_trace_disable(void)
+{
+    g_chef_trace_enabled = 0;
+    free(g_trace.events);
+    free(g_trace.flush_path);
+    g_trace.events = NULL;
+    g_trace.flush_path = NULL;
+    g_trace.capacity = 0;
+}
+
+void chef_trace_record(uint64_t start, const char* category, const char* format, ...)
+{
+    struct __trace_event* event;
+    size_t                index;
+    va_list               args;
+
+    if (g_trace.events == NULL) {
+        return;
+    }
+
+    index = atomic_fetch_add(&g_trace.head, 1);
+    event = &g_trace.events[index % g_trace.capacity];
+    event->start = start;
+    event->end = chef_trace_now();
+    event->tid = __current_tid();
+    event->category = category;
+
+    va_start(args, format);
+    vsnprintf(&event->name[0], sizeof(event->name), format, args);
+    va_end(args);
+}
+
+static void __write_string(FILE* stream, const char* string)
+{
+    fputc('"', stream);
+    for (const char* p = string; *p; p++) {
+        unsigned char c = (unsigned char)*p;
+        if (c == '"' || c == '\\') {
+            fputc('\\', stream);
+            fputc(c, stream);
+        } else if (c < 0x20) {
+            fprintf(stream, "\\u%04x", c);
+        } else {
+            fputc(c, stream);
+        }
+    }
+    fputc('"', stream);
+}
+
+static void __write_metadata(FILE* stream)
+{
+    fprintf(stream, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%u,\"tid\":0,\"args\":{\"name\":", g_trace.pid);
+    __write_string(stream, &g_trace.process[0]);
+    fprintf(stream, "}}");
+}
+
+static void __write_event(FILE* stream, struct __trace_event* event)
+{
+    // timestamps are in microseconds
+    fprintf(stream, "{\"name\":");
+    __write_string(stream, &event->name[0]);
+    fprintf(stream, ",\"cat\":");
+    __write_string(stream, event->category != NULL ? event->category : "");
+    fprintf(stream, ",\"ph\":\"X\",\"ts\":%llu.%03u,\"dur\":%llu.%03u,\"pid\":%u,\"tid\":%u}",
+        (unsigned long long)(event->start / 1000), (unsigned int)(event->start % 1000),
+        (unsigned long long)((event->end - event->start) / 1000), (unsigned int)((event->end - event->start) % 1000),
+        g_trace.pid, event->tid
+    );
+}
+
+// Writes the recorded events oldest first, each prefixed with the separator
+static void __write_events(FILE* stream, const char* separator)
+{
+    size_t head  = atomic_load(&g_trace.head);
+    size_t count = head < g_trace.capacity ? head : g_trace.capacity;
+
+    for (size_t i = head - count; i < head; i++) {
+        fputs(separator, stream);
+        __write_event(stream, &g_trace.events[i % g_trace.capacity]);
+    }
+}
+
+int chef_trace_flush(void)
+{
+    FILE* stream;
+
+    if (g_trace.events == NULL || g_trace.flush_path == NULL) {
+        return 0;
+    }
+
+    stream = fopen(g_trace.flush_path, "a");
+    if (stream == NULL) {
+        return -1;
+    }
+
+    // one event per line, so the lines can be merged into a trace as is
+    __write_metadata(stream);
+    __write_events(stream, "\n");
+    fputc('\n', stream);
+    fclose(stream);
+    atomic_store(&g_trace.head, 0);
+    return 0;
+}
+
+static void __import_events(FILE* stream, const char* importPath)
+{
+    char   line[1024];
+    FILE*  import;
+
+    import = fopen(importPath, "r");
+    if (import == NULL) {
+        return;
+    }
+
+    while (fgets(&line[0], sizeof(line), import) != NULL) {
+        size_t length = strlen(&line[0]);
+        while (length > 0 && (line[length - 1] == '\n' || line[length - 1] == '\r')) {
+            line[--length] = '\0';
+        }
+
+        // only complete events are merged, a truncated line means the writer
+        // did not get to finish
+        if (length == 0 || line[0] != '{' || line[length - 1] != '}') {
+            continue;
+        }
+        fputs(",\n", stream);
+        fputs(&line[0], stream);
+    }
+    fclose(import);
+}
+
+int chef_trace_write(const char* path, const char* importPath)
+{
+    FILE* stream;
+
+    if (path == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (g_trace.events == NULL) {
+        errno = ENOENT;
+        return -1;
+    }
+
+    stream = fopen(path, "w");
+    if (stream == NULL) {
+        return -1;
+    }
+
+    fprintf(stream, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    __write_metadata(stream);
+    __write_events(stream, ",\n");
+    if (importPath != NULL) {
+        __import_events(stream, importPath);
+    }
+    fprintf(stream, "\n]}\n");
+    fclose(stream);
+    return 0;
+}
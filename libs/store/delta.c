@@ -0,0 +1,591 @@
+/**
+ * Copyright, Philip Meulengracht
+ *
+ * This program is free software : you can redistribute it and / or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation ? , either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ * 
+ */
+
+#include <chef/platform.h>
+#include "delta.h"
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vlog.h>
+
+// The delta format describes the target package as a sequence of ranges
+// copied from the base package and literal data carried in the delta. Packs
+// are VaFS images whose data is stored as independently compressed blocks, so
+// unchanged files produce identical byte ranges, though usually at a different
+// offset. Those are found with a rolling checksum over fixed-size blocks of the
+// base package, like rsync does, so matches are found at any offset.
+//
+// All values are little endian.
+// header:  u32 magic, u16 version, u16 reserved, u32 block size,
+//          u64 base size, u64 target size
+// copy:    u8 1, u64 base offset, u32 length, u64 checksum of the range
+// data:    u8 2, u32 length, length bytes
+// end:     u8 0, u64 checksum of the target
+#define __DELTA_MAGIC      0x544C4443 // CDLT
+#define __DELTA_VERSION    1
+#define __DELTA_OP_END     0
+#define __DELTA_OP_COPY    1
+#define __DELTA_OP_DATA    2
+
+#define __DELTA_DEFAULT_BLOCK_SIZE (16 * 1024)
+#define __DELTA_MAX_RUN            (1024 * 1024 * 1024)
+#define __DELTA_IO_SIZE            (1024 * 1024)
+
+#define __FNV_OFFSET 0xcbf29ce484222325ULL
+#define __FNV_PRIME  0x100000001b3ULL
+
+static uint64_t __checksum(uint64_t hash, const uint8_t* data, size_t length)
+{
+    for (size_t i = 0; i < length; i++) {
+        hash ^= data[i];
+        hash *= __FNV_PRIME;
+    }
+    return hash;
+}
+
+static void __put_u16(uint8_t* buffer, uint16_t value)
+{
+    buffer[0] = (uint8_t)value;
+    buffer[1] = (uint8_t)(value >> 8);
+}
+
+static void __put_u32(uint8_t* buffer, uint32_t value)
+{
+    for (int i = 0; i < 4; i++) {
+        buffer[i] = (uint8_t)(value >> (i * 8));
+    }
+}
+
+static void __put_u64(uint8_t* buffer, uint64_t value)
+{
+    for (int i = 0; i < 8; i++) {
+        buffer[i] = (uint8_t)(value >> (i * 8));
+    }
+}
+
+static uint32_t __get_u32(const uint8_t* buffer)
+{
+    uint32_t value = 0;
+    for (int i = 0; i < 4; i++) {
+        value |= (uint32_t)buffer[i] << (i * 8);
+    }
+    return value;
+}
+
+static uint64_t __get_u64(const uint8_t* buffer)
+{
+    uint64_t value = 0;
+    for (int i = 0; i < 8; i++) {
+        value |= (uint64_t)buffer[i] << (i * 8);
+    }
+    return value;
+}
+
+static int __write_all(FILE* stream, const void* data, size_t length)
+{
+    if (length && fwrite(data, 1, length, stream) != length) {
+        errno = EIO;
+        return -1;
+    }
+    return 0;
+}
+
+static int __read_all(FILE* stream, void* data, size_t length)
+{
+    if (length && fread(data, 1, length, stream) != length) {
+        errno = EILSEQ;
+        return -1;
+    }
+    return 0;
+}
+
+static int __seek(FILE* stream, uint64_t offset)
+{
+#if defined(WIN32) || defined(_WIN32) || defined(__WIN32__) || defined(__NT__)
+    return _fseeki64(stream, (long long)offset, SEEK_SET);
+#else
+    return fseeko(stream, (off_t)offset, SEEK_SET);
+#endif
+}
+
+struct __delta_writer {
+    FILE*          stream;
+    const uint8_t* target;
+    uint64_t       copy_offset;
+    size_t         copy_start;
+    size_t         copy_length;
+};
+
+static int __emit_copy(struct __delta_writer* writer)
+{
+    while (writer->copy_length) {
+        uint8_t op[21];
+        size_t  length = writer->copy_length;
+        if (length > __DELTA_MAX_RUN) {
+            length = __DELTA_MAX_RUN;
+        }
+
+        op[0] = __DELTA_OP_COPY;
+        __put_u64(&op[1], writer->copy_offset);
+        __put_u32(&op[9], (uint32_t)length);
+        __put_u64(&op[13], __checksum(__FNV_OFFSET, writer->target + writer->copy_start, length));
+        if (__write_all(writer->stream, &op[0], sizeof(op))) {
+            return -1;
+        }
+
+        writer->copy_offset += length;
+        writer->copy_start  += length;
+        writer->copy_length -= length;
+    }
+    return 0;
+}
+
+static int __emit_data(struct __delta_writer* writer, size_t start, size_t length)
+{
+    while (length) {
+        uint8_t op[5];
+        size_t  count = length;
+        if (count > __DELTA_MAX_RUN) {
+            count = __DELTA_MAX_RUN;
+        }
+
+        op[0] = __DELTA_OP_DATA;
+        __put_u32(&op[1], (uint32_t)count);
+        if (__write_all(writer->stream, &op[0], sizeof(op)) ||
+            __write_all(writer->stream, writer->target + start, count)) {
+            return -1;
+        }
+        start  += count;
+        length -= count;
+    }
+    return 0;
+}
+
+// __add_copy extends the pending copy when the new range continues it, so
+// runs of unchanged blocks end up as a single operation
+static int __add_copy(struct __delta_writer* writer, uint64_t offset, size_t start, size_t length)
+{
+    if (writer->copy_length && writer->copy_offset + writer->copy_length == offset &&
+        writer->copy_start + writer->copy_length == start) {
+        writer->copy_length += length;
+        return 0;
+    }
+
+    if (__emit_copy(writer)) {
+        return -1;
+    }
+    writer->copy_offset = offset;
+    writer->copy_start  = start;
+    writer->copy_length = length;
+    return 0;
+}
+
+// rsync style weak checksum that can be rolled one byte at a time
+static uint32_t __weak_checksum(const uint8_t* data, size_t length, uint32_t* aOut, uint32_t* bOut)
+{
+    uint32_t a = 0, b = 0;
+    for (size_t i = 0; i < length; i++) {
+        a += data[i];
+        b += (uint32_t)(length - i) * data[i];
+    }
+    *aOut = a & 0xFFFF;
+    *bOut = b & 0xFFFF;
+    return (*bOut << 16) | *aOut;
+}
+
+struct __block_index {
+    uint32_t* heads;
+    uint32_t* next;
+    uint32_t* weak;
+    size_t    mask;
+};
+
+static int __block_index_build(struct __block_index* index, const uint8_t* base, size_t blockCount, size_t blockSize)
+{
+    size_t buckets = 1;
+    while (buckets < blockCount * 2) {
+        buckets <<= 1;
+    }
+
+    index->mask  = buckets - 1;
+    index->heads = malloc(sizeof(uint32_t) * buckets);
+    index->next  = malloc(sizeof(uint32_t) * (blockCount + 1));
+    index->weak  = malloc(sizeof(uint32_t) * (blockCount + 1));
+    if (index->heads == NULL || index->next == NULL || index->weak == NULL) {
+        errno = ENOMEM;
+        return -1;
+    }
+    memset(index->heads, 0xFF, sizeof(uint32_t) * buckets);
+
+    // insert in reverse so chains prefer the earliest block
+    for (size_t i = blockCount; i-- > 0;) {
+        uint32_t a, b;
+        uint32_t weak   = __weak_checksum(base + (i * blockSize), blockSize, &a, &b);
+        size_t   bucket = (weak ^ (weak >> 13)) & index->mask;
+        index->weak[i]      = weak;
+        index->next[i]      = index->heads[bucket];
+        index->heads[bucket] = (uint32_t)i;
+    }
+    return 0;
+}
+
+static void __block_index_destroy(struct __block_index* index)
+{
+    free(index->heads);
+    free(index->next);
+    free(index->weak);
+}
+
+static int __find_block(struct __block_index* index, uint32_t weak, const uint8_t* base,
+                        const uint8_t* data, size_t blockSize, size_t* blockOut)
+{
+    uint32_t i = index->heads[(weak ^ (weak >> 13)) & index->mask];
+    while (i != UINT32_MAX) {
+        if (index->weak[i] == weak && memcmp(base + ((size_t)i * blockSize), data, blockSize) == 0) {
+            *blockOut = i;
+            return 1;
+        }
+        i = index->next[i];
+    }
+    return 0;
+}
+
+static int __write_delta(FILE* stream, const uint8_t* base, size_t baseSize,
+                         const uint8_t* target, size_t targetSize, size_t blockSize)
+{
+    struct __delta_writer writer = { stream, target, 0, 0, 0 };
+    struct __block_index  index  = { NULL, NULL, NULL, 0 };
+    size_t                blockCount = baseSize / blockSize;
+    size_t                literal = 0;
+    size_t                i = 0;
+    uint32_t              a = 0, b = 0, weak = 0;
+    int                   rolled = 0;
+    int                   status = -1;
+    uint8_t               header[28];
+
+    __put_u32(&header[0], __DELTA_MAGIC);
+    __put_u16(&header[4], __DELTA_VERSION);
+    __put_u16(&header[6], 0);
+    __put_u32(&header[8], (uint32_t)blockSize);
+    __put_u64(&header[12], baseSize);
+    __put_u64(&header[20], targetSize);
+    if (__write_all(stream, &header[0], sizeof(header))) {
+        return -1;
+    }
+
+    if (blockCount && __block_index_build(&index, base, blockCount, blockSize)) {
+        goto cleanup;
+    }
+
+    while (blockCount && i + blockSize <= targetSize) {
+        size_t block;
+
+        if (!rolled) {
+            weak   = __weak_checksum(target + i, blockSize, &a, &b);
+            rolled = 1;
+        }
+
+        if (__find_block(&index, weak, base, target + i, blockSize, &block)) {
+            uint64_t offset = (uint64_t)block * blockSize;
+            size_t   length = blockSize;
+
+            // extend the match past the block as long as the bytes agree, which
+            // also covers a partial block at the end of the base package
+            while (i + length < targetSize && offset + length < baseSize &&
+                   target[i + length] == base[offset + length]) {
+                length++;
+            }
+
+            if (i > literal) {
+                if (__emit_copy(&writer) || __emit_data(&writer, literal, i - literal)) {
+                    goto cleanup;
+                }
+                writer.copy_length = 0;
+            }
+            if (__add_copy(&writer, offset, i, length)) {
+                goto cleanup;
+            }
+
+            i      += length;
+            literal = i;
+            rolled  = 0;
+            continue;
+        }
+
+        // roll the window one byte forward
+        if (i + blockSize < targetSize) {
+            uint8_t out = target[i];
+            uint8_t in  = target[i + blockSize];
+            a = (a - out + in) & 0xFFFF;
+            b = (b - (uint32_t)(blockSize * out) + a) & 0xFFFF;
+            weak = (b << 16) | a;
+        }
+        i++;
+    }
+
+    if (__emit_copy(&writer) || __emit_data(&writer, literal, targetSize - literal)) {
+        goto cleanup;
+    }
+
+    {
+        uint8_t op[9];
+        op[0] = __DELTA_OP_END;
+        __put_u64(&op[1], __checksum(__FNV_OFFSET, target, targetSize));
+        status = __write_all(stream, &op[0], sizeof(op));
+    }
+
+cleanup:
+    __block_index_destroy(&index);
+    return status;
+}
+
+int delta_create(const char* basePath, const char* targetPath, const char* deltaPath, unsigned int blockSize)
+{
+    void*  base = NULL;
+    void*  target = NULL;
+    size_t baseSize, targetSize;
+    FILE*  stream;
+    int    status;
+
+    if (basePath == NULL || targetPath == NULL || deltaPath == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (blockSize == 0) {
+        blockSize = __DELTA_DEFAULT_BLOCK_SIZE;
+    }
+
+    status = platform_readfile(basePath, &base, &baseSize);
+    if (status) {
+        VLOG_ERROR("store", "delta_create: failed to read %s\n", basePath);
+        return status;
+    }
+
+    status = platform_readfile(targetPath, &target, &targetSize);
+    if (status) {
+        VLOG_ERROR("store", "delta_create: failed to read %s\n", targetPath);
+        free(base);
+        return status;
+    }
+
+    stream = fopen(deltaPath, "wb");
+    if (stream == NULL) {
+        VLOG_ERROR("store", "delta_create: failed to create %s\n", deltaPath);
+        status = -1;
+        goto cleanup;
+    }
+
+    status = __write_delta(stream, base, baseSize, target, targetSize, blockSize);
+    if (fclose(stream) && status == 0) {
+        status = -1;
+    }
+    if (status) {
+        VLOG_ERROR("store", "delta_create: failed to write %s\n", deltaPath);
+        platform_unlink(deltaPath);
+    }
+
+cleanup:
+    free(base);
+    free(target);
+    return status;
+}
+
+struct __delta_output {
+    FILE*                       stream;
+    struct delta_apply_options* options;
+    uint64_t                    written;
+    uint64_t                    total;
+    uint64_t                    checksum;
+};
+
+static int __output(struct __delta_output* output, const uint8_t* data, size_t length)
+{
+    if (output->written + length > output->total) {
+        errno = EILSEQ;
+        return -1;
+    }
+
+    if (__write_all(output->stream, data, length)) {
+        return -1;
+    }
+
+    output->checksum = __checksum(output->checksum, data, length);
+    output->written += length;
+    if (output->options->stream != NULL) {
+        output->options->stream(data, length, output->options->stream_context);
+    }
+    if (output->options->observer != NULL) {
+        output->options->observer->report(output->written, output->total, output->options->observer->userData);
+    }
+    return 0;
+}
+
+static int __apply_copy(FILE* base, uint64_t baseSize, struct __delta_output* output, uint8_t* buffer, const uint8_t* op)
+{
+    uint64_t offset   = __get_u64(&op[0]);
+    size_t   length   = __get_u32(&op[8]);
+    uint64_t expected = __get_u64(&op[12]);
+    uint64_t checksum = __FNV_OFFSET;
+
+    if (offset > baseSize || length > baseSize - offset || __seek(base, offset)) {
+        errno = EILSEQ;
+        return -1;
+    }
+
+    while (length) {
+        size_t count = length < __DELTA_IO_SIZE ? length : __DELTA_IO_SIZE;
+        if (__read_all(base, buffer, count)) {
+            return -1;
+        }
+        checksum = __checksum(checksum, buffer, count);
+        if (__output(output, buffer, count)) {
+            return -1;
+        }
+        length -= count;
+    }
+
+    // the base package on disk is not the one the delta was created against
+    if (checksum != expected) {
+        errno = EILSEQ;
+        return -1;
+    }
+    return 0;
+}
+
+static int __apply_data(FILE* delta, struct __delta_output* output, uint8_t* buffer, const uint8_t* op)
+{
+    size_t length = __get_u32(&op[0]);
+
+    while (length) {
+        size_t count = length < __DELTA_IO_SIZE ? length : __DELTA_IO_SIZE;
+        if (__read_all(delta, buffer, count) || __output(output, buffer, count)) {
+            return -1;
+        }
+        length -= count;
+    }
+    return 0;
+}
+
+static int __apply(FILE* base, FILE* delta, struct __delta_output* output)
+{
+    struct platform_stat stats;
+    uint8_t              header[28];
+    uint8_t*             buffer;
+    int                  status = -1;
+
+    if (__read_all(delta, &header[0], sizeof(header))) {
+        return -1;
+    }
+
+    if (__get_u32(&header[0]) != __DELTA_MAGIC || (header[4] | (header[5] << 8)) != __DELTA_VERSION) {
+        VLOG_ERROR("store", "__apply: unsupported delta format\n");
+        errno = EILSEQ;
+        return -1;
+    }
+
+    if (platform_stat(output->options->base_path, &stats) || stats.size != __get_u64(&header[12])) {
+        VLOG_ERROR("store", "__apply: base package does not match the delta\n");
+        errno = EILSEQ;
+        return -1;
+    }
+    output->total = __get_u64(&header[20]);
+
+    buffer = malloc(__DELTA_IO_SIZE);
+    if (buffer == NULL) {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    while (1) {
+        uint8_t op[21];
+
+        if (__read_all(delta, &op[0], 1)) {
+            break;
+        }
+
+        if (op[0] == __DELTA_OP_COPY) {
+            if (__read_all(delta, &op[1], 20) || __apply_copy(base, stats.size, output, buffer, &op[1])) {
+                break;
+            }
+        } else if (op[0] == __DELTA_OP_DATA) {
+            if (__read_all(delta, &op[1], 4) || __apply_data(delta, output, buffer, &op[1])) {
+                break;
+            }
+        } else if (op[0] == __DELTA_OP_END) {
+            if (__read_all(delta, &op[1], 8)) {
+                break;
+            }
+            if (output->written != output->total || output->checksum != __get_u64(&op[1])) {
+                errno = EILSEQ;
+                break;
+            }
+            status = 0;
+            break;
+        } else {
+            errno = EILSEQ;
+            break;
+        }
+    }
+
+    free(buffer);
+    return status;
+}
+
+int delta_apply(struct delta_apply_options* options)
+{
+    struct __delta_output output = { NULL, options, 0, 0, __FNV_OFFSET };
+    FILE*                 base;
+    FILE*                 delta;
+    int                   status = -1;
+
+    if (options == NULL || options->base_path == NULL || options->delta_path == NULL || options->output_path == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    base  = fopen(options->base_path, "rb");
+    delta = fopen(options->delta_path, "rb");
+    output.stream = fopen(options->output_path, "wb");
+    if (base == NULL || delta == NULL || output.stream == NULL) {
+        VLOG_ERROR("store", "delta_apply: failed to open files for %s\n", options->output_path);
+        goto cleanup;
+    }
+
+    status = __apply(base, delta, &output);
+    if (status) {
+        VLOG_ERROR("store", "delta_apply: failed to reconstruct %s: %s\n", options->output_path, strerror(errno));
+    }
+
+cleanup:
+    if (output.stream != NULL && fclose(output.stream) && status == 0) {
+        status = -1;
+    }
+    if (delta != NULL) {
+        fclose(delta);
+    }
+    if (base != NULL) {
+        fclose(base);
+    }
+    if (status) {
+        platform_unlink(options->output_path);
+    }
+    return status;
+}
@@ -0,0 +1,63 @@
+/**
+ * Copyright, Philip Meulengracht
+ *
+ * This program is free software : you can redistribute it and / or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation ? , either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ * 
+ */
+
+#ifndef __CHEF_STORE_DELTA_H__
+#define __CHEF_STORE_DELTA_H__
+
+#include <chef/observer.h>
+#include <stddef.h>
+
+/**
+ * @brief Consumer of the reconstructed package stream. Invoked in order for each
+ * range of bytes written to the new package, which allows callers to digest the
+ * package while it is being written.
+ */
+typedef void (*delta_stream_fn)(const void* data, size_t length, void* context);
+
+struct delta_apply_options {
+    const char*           base_path;
+    const char*           delta_path;
+    const char*           output_path;
+    delta_stream_fn       stream;
+    void*                 stream_context;
+    struct chef_observer* observer;
+};
+
+/**
+ * @brief Reconstructs a package from a base package and a delta. Every range copied
+ * from the base package is checked against the checksum recorded in the delta, and
+ * the reconstructed package is checked against the checksum of the target.
+ * 
+ * @param[In] options The paths involved and the optional stream consumer.
+ * @return int 0 on success, otherwise -1 and errno will be set. EILSEQ indicates the
+ *             base package does not match the one the delta was created against.
+ */
+extern int delta_apply(struct delta_apply_options* options);
+
+/**
+ * @brief Creates a delta that transforms the base package into the target package.
+ * 
+ * @param[In] basePath   Path to the package the delta is computed against.
+ * @param[In] targetPath Path to the package the delta should produce.
+ * @param[In] deltaPath  Path where the delta should be written.
+ * @param[In] blockSize  Size of the blocks matched between the packages, 0 for default.
+ * @return int 0 on success, otherwise -1 and errno will be set
+ */
+extern int delta_create(const char* basePath, const char* targetPath, const char* deltaPath, unsigned int blockSize);
+
+#endif //!__CHEF_STORE_DELTA_H__
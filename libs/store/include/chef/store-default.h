@@ -81,6 +81,36 @@ static int store_default_resolve_package(struct store_package* package, const ch
     return status;
 }
 
+static int store_default_resolve_package_delta(struct store_package* package, int baseRevision, const char* path, struct chef_observer* observer, int* revisionDownloaded)
+{
+    struct chef_download_params downloadParams;
+    int                         status;
+    char**                      names;
+    VLOG_DEBUG("chef", "store_default_resolve_package_delta(base=%i)\n", baseRevision);
+
+    names = __split_name(package->name);
+    if (names == NULL) {
+        VLOG_ERROR("chef", "store_default_resolve_package_delta: invalid package name '%s'\n",
+            package->name);
+        return -1;
+    }
+
+    downloadParams.publisher = names[0];
+    downloadParams.package   = names[1];
+    downloadParams.platform  = package->platform;
+    downloadParams.arch      = package->arch;
+    downloadParams.channel   = package->channel;
+    downloadParams.revision  = package->revision;
+    downloadParams.observer  = observer;
+
+    status = chefclient_pack_download_delta(&downloadParams, baseRevision, path);
+    if (status == 0) {
+        *revisionDownloaded = downloadParams.revision;
+    }
+    strsplit_free(names);
+    return status;
+}
+
 static char** __split_package_key(const char* key)
 {
     // split the publisher/package/revision
@@ -191,6 +221,7 @@ static int store_default_resolve_proof(enum store_proof_type keyType, const char
 
 const static struct store_backend g_store_default_backend = {
     .resolve_package = store_default_resolve_package,
+    .resolve_package_delta = store_default_resolve_package_delta,
     .resolve_proof = store_default_resolve_proof
 };
 
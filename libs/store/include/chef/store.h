@@ -75,6 +75,9 @@ struct store_package {
 
 struct store_backend {
     int (*resolve_package)(struct store_package* package, const char* path, struct chef_observer* observer, int* revisionDownloaded);
+    // Optional, downloads a delta against baseRevision to path. Must fail with ENOENT if no
+    // delta is available between the revisions.
+    int (*resolve_package_delta)(struct store_package* package, int baseRevision, const char* path, struct chef_observer* observer, int* revisionDownloaded);
     int (*resolve_proof)(enum store_proof_type keyType, const char* key, struct chef_observer* observer, union store_proof* proof);
 };
 
@@ -105,6 +108,39 @@ extern void store_cleanup(void);
  */
 extern int store_ensure_package(struct store_package* package, struct chef_observer* observer);
 
+struct store_delta_options {
+    // The revision of the package already present in store
+    int   base_revision;
+    // Invoked in order with the contents of the package as it is being reconstructed,
+    // this allows the package to be digested without reading it again afterwards.
+    void  (*stream)(const void* data, size_t length, void* context);
+    void* stream_context;
+};
+
+/**
+ * @brief Stores the given package by downloading a delta against a revision already
+ * present in store, and reconstructing the package locally. If the package is already
+ * present, nothing is done and the stream callback is not invoked.
+ * 
+ * @param[In] package  Options describing the package that should be fetched from store.
+ * @param[In] options  The base revision and the optional stream consumer.
+ * @return int 0 on success, otherwise -1 and errno will be set. ENOENT indicates that no delta
+ *             is available, and ENOTSUP that the backend does not support deltas.
+ */
+extern int store_ensure_package_delta(struct store_package* package, struct store_delta_options* options, struct chef_observer* observer);
+
+/**
+ * @brief Computes a delta that reconstructs the target package from the base package. Deltas
+ * are computed over blocks of the packages, so blocks that are unchanged between revisions are
+ * copied from the base package instead of being downloaded.
+ * 
+ * @param[In] basePath   Path to the package revision the delta applies to.
+ * @param[In] targetPath Path to the package revision the delta produces.
+ * @param[In] deltaPath  Path where the delta should be written.
+ * @return int 0 on success, otherwise -1 and errno will be set
+ */
+extern int store_delta_create(const char* basePath, const char* targetPath, const char* deltaPath);
+
 /**
  * @brief Retrieves the path of an package based on it's parameters. It must be already
  * present in the local store.
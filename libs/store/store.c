@@ -21,9 +21,11 @@
 #include <chef/package.h>
 #include <chef/store.h>
 #include <errno.h>
+#include "delta.h"
 #include "inventory.h"
 #include <stdlib.h>
 #include <string.h>
+#include <threads.h>
 #include <vlog.h>
 
 struct progress_context {
@@ -35,11 +37,14 @@ struct progress_context {
     int symlinks;
 };
 
+// Packages can be ensured from several threads at once, the inventory lock
+// serializes access to the inventory while downloads run without it
 struct store_context {
     char*                   platform;
     char*                   arch;
     struct store_backend    backend;
     struct store_inventory* inventory;
+    mtx_t                   inventory_lock;
 };
 
 static struct store_context g_store = { 0 };
@@ -54,6 +59,11 @@ int store_initialize(struct store_parameters* parameters)
         return -1;
     }
 
+    if (mtx_init(&g_store.inventory_lock, mtx_plain) != thrd_success) {
+        VLOG_ERROR("store", "store_initialize: failed to initialize inventory lock\n");
+        return -1;
+    }
+
     memcpy(&g_store.backend, &parameters->backend, sizeof(struct store_backend));
     g_store.arch = platform_strdup(parameters->architecture);
     g_store.platform = platform_strdup(parameters->platform);
@@ -74,6 +84,7 @@ void store_cleanup(void)
     inventory_free(g_store.inventory);
     free(g_store.platform);
     free(g_store.arch);
+    mtx_destroy(&g_store.inventory_lock);
 
     // Reset data
     memset(&g_store, 0, sizeof(struct store_context));
@@ -112,6 +123,21 @@ static char* __format_package_path(
     return platform_strdup(&buffer[0]);
 }
 
+static char* __format_delta_path(
+    const char* publisher,
+    const char* package)
+{
+    char buffer[PATH_MAX];
+    snprintf(
+        &buffer[0], sizeof(buffer) - 1,
+        "%s" CHEF_PATH_SEPARATOR_S "%s-%s.delta",
+        chef_dirs_store(),
+        publisher,
+        package
+    );
+    return platform_strdup(&buffer[0]);
+}
+
 static char** __split_name(const char* name)
 {
     // split the publisher/package
@@ -156,26 +182,66 @@ static int __find_package_in_inventory(struct store_package* package, struct sto
     // check if we have the requested package in store already, otherwise
     // download the package
     VLOG_DEBUG("store", "looking up path in inventory\n");
+    mtx_lock(&g_store.inventory_lock);
     status = inventory_get_pack(
         g_store.inventory,
         names[0], names[1],
         __get_package_platform(package),
         __get_package_arch(package),
-        package->channel,
+        package->revision != 0 ? NULL : package->channel,
         package->revision,
         &pack
     );
+    mtx_unlock(&g_store.inventory_lock);
 
     strsplit_free(names);
     return status;
 }
 
+// __add_package moves a package downloaded to the temporary path into place
+// and registers it in the inventory
+static int __add_package(struct store_package* package, char** names, const char* pathTmp, int revision)
+{
+    struct store_inventory_pack* pack;
+    char*                        path;
+    int                          status;
+
+    path = __format_package_path(names[0], names[1], revision);
+    if (path == NULL) {
+        return -1;
+    }
+
+    status = rename(pathTmp, path);
+    if (status) {
+        goto cleanup;
+    }
+
+    mtx_lock(&g_store.inventory_lock);
+    status = inventory_add(
+        g_store.inventory,
+        path,
+        names[0], names[1],
+        __get_package_platform(package),
+        __get_package_arch(package),
+        package->channel,
+        revision,
+        &pack
+    );
+    if (status == 0) {
+        status = inventory_save(g_store.inventory);
+    }
+    mtx_unlock(&g_store.inventory_lock);
+
+cleanup:
+    free(path);
+    return status;
+}
+
 int store_ensure_package(struct store_package* package, struct chef_observer* observer)
 {
     struct store_inventory_pack* pack = NULL;
     int                          revision = 0;
     char**                       names = NULL;
-    char*                        path = NULL;
     char*                        pathTmp = NULL;
     int                          status;
     VLOG_DEBUG("store", "store_ensure_package(name=%s)\n", package->name);
@@ -210,39 +276,99 @@ int store_ensure_package(struct store_package* package, struct chef_observer* ob
         goto cleanup;
     }
 
-    path = __format_package_path(names[0], names[1], revision);
-    if (path == NULL) {
+    status = __add_package(package, names, pathTmp, revision);
+
+cleanup:
+    strsplit_free(names);
+    free(pathTmp);
+    return status;
+}
+
+int store_ensure_package_delta(struct store_package* package, struct store_delta_options* options, struct chef_observer* observer)
+{
+    struct store_inventory_pack* pack = NULL;
+    int                          revision = 0;
+    char**                       names = NULL;
+    char*                        basePath = NULL;
+    char*                        deltaPath = NULL;
+    char*                        pathTmp = NULL;
+    int                          status;
+    VLOG_DEBUG("store", "store_ensure_package_delta(name=%s, base=%i)\n", package->name, options->base_revision);
+
+    if (g_store.backend.resolve_package_delta == NULL) {
+        errno = ENOTSUP;
+        return -1;
+    }
+
+    names = __split_name(package->name);
+    if (names == NULL) {
+        VLOG_ERROR("store", "store_ensure_package_delta: invalid package naming '%s' (must be publisher/package)\n", package->name);
+        return -1;
+    }
+
+    status = __find_package_in_inventory(package, &pack);
+    if (status == 0) {
+        VLOG_DEBUG("store", "package %s has already been downloaded\n", package->name);
         goto cleanup;
     }
 
-    status = rename(pathTmp, path);
+    // the delta can only be applied if we still have the base revision
+    status = __find_package_in_inventory(&(struct store_package) {
+        .name = package->name,
+        .platform = package->platform,
+        .arch = package->arch,
+        .channel = NULL,
+        .revision = options->base_revision
+    }, &pack);
     if (status) {
+        VLOG_DEBUG("store", "base revision %i of %s is not present\n", options->base_revision, package->name);
+        errno = ENOENT;
         goto cleanup;
     }
 
-    status = inventory_add(
-        g_store.inventory,
-        path,
-        names[0], names[1],
-        __get_package_platform(package),
-        __get_package_arch(package),
-        package->channel,
-        revision,
-        &pack
-    );
+    basePath  = __format_package_path(names[0], names[1], options->base_revision);
+    deltaPath = __format_delta_path(names[0], names[1]);
+    pathTmp   = __format_package_path(names[0], names[1], 0);
+    if (basePath == NULL || deltaPath == NULL || pathTmp == NULL) {
+        status = -1;
+        goto cleanup;
+    }
+
+    status = g_store.backend.resolve_package_delta(package, options->base_revision, deltaPath, observer, &revision);
+    if (status) {
+        goto cleanup;
+    }
+
+    status = delta_apply(&(struct delta_apply_options) {
+        .base_path = basePath,
+        .delta_path = deltaPath,
+        .output_path = pathTmp,
+        .stream = options->stream,
+        .stream_context = options->stream_context
+    });
     if (status) {
+        VLOG_ERROR("store", "store_ensure_package_delta: failed to apply delta for %s\n", package->name);
         goto cleanup;
     }
 
-    status = inventory_save(g_store.inventory);
+    status = __add_package(package, names, pathTmp, revision);
 
 cleanup:
+    if (deltaPath != NULL) {
+        platform_unlink(deltaPath);
+    }
     strsplit_free(names);
+    free(basePath);
+    free(deltaPath);
     free(pathTmp);
-    free(path);
     return status;
 }
 
+int store_delta_create(const char* basePath, const char* targetPath, const char* deltaPath)
+{
+    return delta_create(basePath, targetPath, deltaPath, 0);
+}
+
 int store_package_path(struct store_package* package, const char** pathOut)
 {
     struct store_inventory_pack* pack = NULL;
@@ -297,12 +423,12 @@ int store_proof_ensure(enum store_proof_type keyType, const char* key, struct ch
         goto cleanup;
     }
 
+    mtx_lock(&g_store.inventory_lock);
     status = inventory_add_proof(g_store.inventory, &proof);
-    if (status) {
-        goto cleanup;
+    if (status == 0) {
+        status = inventory_save(g_store.inventory);
     }
-
-    status = inventory_save(g_store.inventory);
+    mtx_unlock(&g_store.inventory_lock);
 
 cleanup:
     return status;
@@ -310,6 +436,11 @@ cleanup:
 
 int store_proof_lookup(enum store_proof_type keyType, const char* key, void* proof)
 {
+    int status;
     VLOG_DEBUG("store", "store_proof_lookup(key=%s)\n", key);
-    return inventory_get_proof(g_store.inventory, keyType, key, proof);
+
+    mtx_lock(&g_store.inventory_lock);
+    status = inventory_get_proof(g_store.inventory, keyType, key, proof);
+    mtx_unlock(&g_store.inventory_lock);
+    return status;
 }
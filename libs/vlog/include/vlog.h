@@ -47,6 +47,13 @@ enum vlog_level {
  */
 #define VLOG_OUTPUT_OPTION_LONGDECO 0x8
 
+/**
+ * @brief Writes each message as a single JSON object per line, with the fields
+ * time (UTC), level, tag, errno (errors only) and message. Intended for outputs
+ * that are ingested by other tools.
+ */
+#define VLOG_OUTPUT_OPTION_JSON 0x10
+
 /**
  * @brief Initializes vlog system. This should be invoked before any calls done to
  * to the vlog_* namespace.
@@ -117,6 +124,17 @@ extern void vlog_output(enum vlog_level level, const char* tag, const char* form
  */
 extern void vlog_flush(void);
 
+/**
+ * @brief Enables or disables asynchronous logging. When enabled, messages are queued
+ * in a per-thread buffer and written by a background thread in batches, which keeps
+ * logging threads from blocking on I/O. Messages may reach outputs with a small delay,
+ * use vlog_flush to force them out. Not supported on all platforms.
+ *
+ * @param enabled Non-zero to enable the background writer, zero to stop it
+ * @return 0 on success, -1 on failure with errno set
+ */
+extern int vlog_set_async(int enabled);
+
 
 enum vlog_content_status_type {
     VLOG_CONTENT_STATUS_NONE,
@@ -19,6 +19,7 @@
 #include <errno.h>
 #include <locale.h>
 #include <stdarg.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -43,11 +44,73 @@
 
 #define VLOG_MAX_OUTPUTS 4
 
+// Messages are formatted into a stack buffer of this size, longer
+// messages fall back to a heap allocation.
+#define VLOG_LINE_SIZE 1024
+
+// The asynchronous writer relies on C11 atomics, which are not available
+// with all the compilers we support.
+#if !defined(WIN32) && !defined(_WIN32) && !defined(__WIN32__) && !defined(__NT__) && !defined(__STDC_NO_ATOMICS__)
+#define VLOG_ASYNC_SUPPORTED 1
+#include <stdatomic.h>
+#include <pthread.h>
+
+// Each logging thread gets a ring of this size (must be a power of two),
+// and a single record may use at most a quarter of it.
+#define VLOG_RING_SIZE        (64 * 1024)
+#define VLOG_RING_RECORD_MAX  (VLOG_RING_SIZE / 4)
+#define VLOG_RING_TAG_MAX     64
+#define VLOG_RING_ENTRY_WRAP  0x1
+
+// How often the writer wakes up on its own to drain the rings, this is
+// also the maximum delay before a message reaches its outputs.
+#define VLOG_WRITER_INTERVAL_MS 50
+
+struct vlog_ring_entry {
+    uint32_t        size;
+    uint32_t        flags;
+    uint64_t        sequence;
+    struct timespec time;
+    int32_t         level;
+    int32_t         error;
+    uint32_t        tag_length;
+    uint32_t        text_length;
+};
+
+// Single producer (the owning thread), single consumer (whoever holds the
+// output lock). Positions increase monotonically and are masked on access.
+struct vlog_ring {
+    struct vlog_ring* next;
+    atomic_size_t     head;
+    atomic_size_t     tail;
+    atomic_int        abandoned;
+    _Alignas(8) char  buffer[VLOG_RING_SIZE];
+};
+#endif
+
+struct vlog_record {
+    uint64_t        sequence;
+    struct timespec time;
+    enum vlog_level level;
+    int             error;
+    const char*     tag;
+    size_t          tag_length;
+    const char*     text;
+    size_t          length;
+};
+
+struct vlog_time_cache {
+    time_t second;
+    char   text[32];
+};
+
 struct vlog_output {
     FILE*           handle;
     enum vlog_level level;
     unsigned int    options;
     int             columns;
+    int             tty;
+    int             dirty;
 };
 
 struct vlog_content_line {
@@ -74,6 +137,28 @@ struct vlog_context {
     int         content_line_count;
     int         content_line_index;
     struct vlog_content_line* lines;
+
+    // output synchronization, any writes to the outputs must be done while
+    // holding the output lock, this also serializes draining the rings.
+    int                    initialized;
+    mtx_t                  output_lock;
+    volatile int           max_level;
+    struct vlog_time_cache local_time;
+    struct vlog_time_cache utc_time;
+
+#ifdef VLOG_ASYNC_SUPPORTED
+    // asynchronous writer
+    atomic_int         async;
+    atomic_ullong      sequence;
+    atomic_ullong      dropped;
+    mtx_t              rings_lock;
+    struct vlog_ring*  rings;
+    tss_t              ring_key;
+    thrd_t             writer_tid;
+    mtx_t              writer_lock;
+    cnd_t              writer_cond;
+    int                writer_running;
+#endif
 };
 
 static struct vlog_context g_vlog = { { NULL, 0 } };
@@ -172,10 +257,308 @@ static int __animator_loop(void* context)
     return 0;
 }
 
+static void __emit_record(struct vlog_record* record);
+static void __flush_outputs(void);
+
+#ifdef VLOG_ASYNC_SUPPORTED
+static void __ring_abandon(void* context)
+{
+    struct vlog_ring* ring = context;
+    atomic_store(&ring->abandoned, 1);
+}
+
+static struct vlog_ring* __get_ring(void)
+{
+    struct vlog_ring* ring = tss_get(g_vlog.ring_key);
+    if (ring != NULL) {
+        return ring;
+    }
+
+    ring = calloc(1, sizeof(struct vlog_ring));
+    if (ring == NULL) {
+        return NULL;
+    }
+
+    if (tss_set(g_vlog.ring_key, ring) != thrd_success) {
+        free(ring);
+        return NULL;
+    }
+
+    mtx_lock(&g_vlog.rings_lock);
+    ring->next = g_vlog.rings;
+    g_vlog.rings = ring;
+    mtx_unlock(&g_vlog.rings_lock);
+    return ring;
+}
+
+static void __wake_writer(void)
+{
+    mtx_lock(&g_vlog.writer_lock);
+    cnd_signal(&g_vlog.writer_cond);
+    mtx_unlock(&g_vlog.writer_lock);
+}
+
+static void __ring_push(struct vlog_ring* ring, struct vlog_record* record)
+{
+    struct vlog_ring_entry* entry;
+    size_t                  tagLength  = record->tag_length;
+    size_t                  textLength = record->length;
+    size_t                  head, offset, size, padding, used;
+
+    if (tagLength > VLOG_RING_TAG_MAX) {
+        tagLength = VLOG_RING_TAG_MAX;
+    }
+    if (sizeof(struct vlog_ring_entry) + tagLength + textLength > VLOG_RING_RECORD_MAX) {
+        textLength = VLOG_RING_RECORD_MAX - sizeof(struct vlog_ring_entry) - tagLength;
+    }
+
+    size    = (sizeof(struct vlog_ring_entry) + tagLength + textLength + 7) & ~(size_t)7;
+    head    = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    offset  = head & (VLOG_RING_SIZE - 1);
+    padding = (VLOG_RING_SIZE - offset) < size ? (VLOG_RING_SIZE - offset) : 0;
+
+    // never wait for the writer to make room, logging must not block on a
+    // slow output. The record is dropped instead, and the writer reports how
+    // many records were lost.
+    if (VLOG_RING_SIZE - (head - atomic_load_explicit(&ring->tail, memory_order_acquire)) < size + padding) {
+        atomic_fetch_add_explicit(&g_vlog.dropped, 1, memory_order_relaxed);
+        __wake_writer();
+        return;
+    }
+
+    // records are never split, so skip the remainder of the ring when
+    // the record does not fit at the end
+    if (padding) {
+        entry = (struct vlog_ring_entry*)&ring->buffer[offset];
+        entry->size  = (uint32_t)padding;
+        entry->flags = VLOG_RING_ENTRY_WRAP;
+        head  += padding;
+        offset = 0;
+    }
+
+    entry = (struct vlog_ring_entry*)&ring->buffer[offset];
+    entry->size        = (uint32_t)size;
+    entry->flags       = 0;
+    entry->sequence    = record->sequence;
+    entry->time        = record->time;
+    entry->level       = (int32_t)record->level;
+    entry->error       = record->error;
+    entry->tag_length  = (uint32_t)tagLength;
+    entry->text_length = (uint32_t)textLength;
+    memcpy((char*)(entry + 1), record->tag, tagLength);
+    memcpy((char*)(entry + 1) + tagLength, record->text, textLength);
+    atomic_store_explicit(&ring->head, head + size, memory_order_release);
+
+    // errors are pushed out right away, otherwise only wake the writer
+    // early when the ring is filling up
+    used = head + size - atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    if (record->level == VLOG_LEVEL_ERROR || used > (VLOG_RING_SIZE / 2)) {
+        __wake_writer();
+    }
+}
+
+static struct vlog_ring_entry* __ring_peek(struct vlog_ring* ring)
+{
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    size_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+
+    while (tail != head) {
+        struct vlog_ring_entry* entry = (struct vlog_ring_entry*)&ring->buffer[tail & (VLOG_RING_SIZE - 1)];
+        if (!(entry->flags & VLOG_RING_ENTRY_WRAP)) {
+            return entry;
+        }
+        tail += entry->size;
+        atomic_store_explicit(&ring->tail, tail, memory_order_release);
+    }
+    return NULL;
+}
+
+static void __ring_pop(struct vlog_ring* ring, struct vlog_ring_entry* entry)
+{
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    atomic_store_explicit(&ring->tail, tail + entry->size, memory_order_release);
+}
+
+static void __reap_rings(void)
+{
+    struct vlog_ring** link;
+
+    mtx_lock(&g_vlog.rings_lock);
+    link = &g_vlog.rings;
+    while (*link != NULL) {
+        struct vlog_ring* ring = *link;
+        if (atomic_load(&ring->abandoned) && __ring_peek(ring) == NULL) {
+            *link = ring->next;
+            free(ring);
+            continue;
+        }
+        link = &ring->next;
+    }
+    mtx_unlock(&g_vlog.rings_lock);
+}
+
+// Must be called with the output lock held.
+static void __report_dropped(void)
+{
+    struct vlog_record record;
+    char               buffer[64];
+    unsigned long long dropped;
+
+    dropped = atomic_exchange_explicit(&g_vlog.dropped, 0, memory_order_relaxed);
+    if (dropped == 0) {
+        return;
+    }
+
+    record.sequence   = atomic_fetch_add(&g_vlog.sequence, 1);
+    record.level      = VLOG_LEVEL_WARNING;
+    record.error      = 0;
+    record.tag        = "vlog";
+    record.tag_length = 4;
+    record.text       = &buffer[0];
+    record.length     = (size_t)snprintf(&buffer[0], sizeof(buffer),
+        "%llu messages dropped, the log outputs could not keep up\n", dropped);
+    timespec_get(&record.time, TIME_UTC);
+    __emit_record(&record);
+}
+
+// Must be called with the output lock held. Records are merged across the
+// per-thread rings by their sequence number to keep the global order.
+static void __drain_rings(void)
+{
+    struct vlog_ring* rings;
+
+    mtx_lock(&g_vlog.rings_lock);
+    rings = g_vlog.rings;
+    mtx_unlock(&g_vlog.rings_lock);
+
+    for (;;) {
+        struct vlog_ring*       oldest      = NULL;
+        struct vlog_ring_entry* oldestEntry = NULL;
+        struct vlog_record      record;
+
+        for (struct vlog_ring* ring = rings; ring != NULL; ring = ring->next) {
+            struct vlog_ring_entry* entry = __ring_peek(ring);
+            if (entry != NULL && (oldestEntry == NULL || entry->sequence < oldestEntry->sequence)) {
+                oldest      = ring;
+                oldestEntry = entry;
+            }
+        }
+
+        if (oldest == NULL) {
+            break;
+        }
+
+        record.sequence   = oldestEntry->sequence;
+        record.time       = oldestEntry->time;
+        record.level      = (enum vlog_level)oldestEntry->level;
+        record.error      = oldestEntry->error;
+        record.tag        = (const char*)(oldestEntry + 1);
+        record.tag_length = oldestEntry->tag_length;
+        record.text       = record.tag + record.tag_length;
+        record.length     = oldestEntry->text_length;
+        __emit_record(&record);
+        __ring_pop(oldest, oldestEntry);
+    }
+    __report_dropped();
+    __reap_rings();
+}
+
+static int __writer_loop(void* context)
+{
+    (void)context;
+
+    mtx_lock(&g_vlog.writer_lock);
+    while (g_vlog.writer_running) {
+        struct timespec deadline;
+
+        timespec_get(&deadline, TIME_UTC);
+        deadline.tv_nsec += VLOG_WRITER_INTERVAL_MS * 1000000L;
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+        cnd_timedwait(&g_vlog.writer_cond, &g_vlog.writer_lock, &deadline);
+        mtx_unlock(&g_vlog.writer_lock);
+
+        // write everything that has been queued, and flush once per batch
+        mtx_lock(&g_vlog.output_lock);
+        __drain_rings();
+        __flush_outputs();
+        mtx_unlock(&g_vlog.output_lock);
+
+        mtx_lock(&g_vlog.writer_lock);
+    }
+    mtx_unlock(&g_vlog.writer_lock);
+    return 0;
+}
+
+static void __stop_writer(void)
+{
+    if (!atomic_exchange(&g_vlog.async, 0)) {
+        return;
+    }
+
+    mtx_lock(&g_vlog.writer_lock);
+    g_vlog.writer_running = 0;
+    cnd_signal(&g_vlog.writer_cond);
+    mtx_unlock(&g_vlog.writer_lock);
+    thrd_join(g_vlog.writer_tid, NULL);
+}
+
+// Make sure no other thread is in the middle of writing when forking, so
+// the locks are in a known state in the child.
+static void __atfork_prepare(void)
+{
+    mtx_lock(&g_vlog.output_lock);
+    mtx_lock(&g_vlog.rings_lock);
+}
+
+static void __atfork_parent(void)
+{
+    mtx_unlock(&g_vlog.rings_lock);
+    mtx_unlock(&g_vlog.output_lock);
+}
+
+// The writer thread does not survive a fork, so children go back to
+// writing synchronously. Anything still queued belongs to the parent.
+static void __atfork_child(void)
+{
+    atomic_store(&g_vlog.async, 0);
+    atomic_store(&g_vlog.dropped, 0);
+    g_vlog.writer_running = 0;
+    for (struct vlog_ring* ring = g_vlog.rings; ring != NULL; ring = ring->next) {
+        atomic_store(&ring->tail, atomic_load(&ring->head));
+    }
+    mtx_unlock(&g_vlog.rings_lock);
+    mtx_unlock(&g_vlog.output_lock);
+}
+
+static void __atexit_flush(void)
+{
+    vlog_flush();
+}
+#endif
+
 void vlog_initialize(enum vlog_level level)
 {
+#ifdef VLOG_ASYNC_SUPPORTED
+    static int registered = 0;
+    if (!registered) {
+        pthread_atfork(__atfork_prepare, __atfork_parent, __atfork_child);
+        registered = 1;
+    }
+#endif
+
     memset(&g_vlog, 0, sizeof(struct vlog_context));
     mtx_init(&g_vlog.lock, mtx_plain);
+    mtx_init(&g_vlog.output_lock, mtx_plain);
+#ifdef VLOG_ASYNC_SUPPORTED
+    mtx_init(&g_vlog.rings_lock, mtx_plain);
+    mtx_init(&g_vlog.writer_lock, mtx_plain);
+    cnd_init(&g_vlog.writer_cond);
+    tss_create(&g_vlog.ring_key, __ring_abandon);
+#endif
+    g_vlog.initialized = 1;
 
     // start by initializing locale
     setlocale(LC_ALL, "");
@@ -193,18 +576,74 @@ void vlog_initialize(enum vlog_level level)
 #endif
 }
 
+int vlog_set_async(int enabled)
+{
+#ifdef VLOG_ASYNC_SUPPORTED
+    static int registered = 0;
+
+    if (!g_vlog.initialized) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (!enabled) {
+        __stop_writer();
+        vlog_flush();
+        return 0;
+    }
+
+    if (atomic_load(&g_vlog.async)) {
+        return 0;
+    }
+
+    if (!registered) {
+        atexit(__atexit_flush);
+        registered = 1;
+    }
+
+    g_vlog.writer_running = 1;
+    if (thrd_create(&g_vlog.writer_tid, __writer_loop, NULL) != thrd_success) {
+        g_vlog.writer_running = 0;
+        return -1;
+    }
+    atomic_store(&g_vlog.async, 1);
+    return 0;
+#else
+    (void)enabled;
+    errno = ENOTSUP;
+    return -1;
+#endif
+}
+
 static struct vlog_output* __get_output(FILE* handle)
 {
-    for (int i = 0; i < g_vlog.outputs_count; i++) {
-        if (g_vlog.outputs[i].handle == handle) {
+    for (int i = 0; i < VLOG_MAX_OUTPUTS; i++) {
+        if (g_vlog.outputs[i].handle != NULL && g_vlog.outputs[i].handle == handle) {
             return &g_vlog.outputs[i];
         }
     }
     return NULL;
 }
 
+// Must be called with the output lock held.
+static void __update_max_level(void)
+{
+    int level = VLOG_LEVEL_DISABLED;
+
+    for (int i = 0; i < VLOG_MAX_OUTPUTS; i++) {
+        if (g_vlog.outputs[i].handle != NULL && (int)g_vlog.outputs[i].level > level) {
+            level = (int)g_vlog.outputs[i].level;
+        }
+    }
+    g_vlog.max_level = level;
+}
+
 void vlog_cleanup(void)
 {
+    if (!g_vlog.initialized) {
+        return;
+    }
+
     if (g_vlog.animator_running) {
         // do not wait more than 2s, otherwise just shutdown
         size_t maxWaiting = 2000;
@@ -215,109 +654,185 @@ void vlog_cleanup(void)
         }
     }
 
-    for (int i = 0; i < g_vlog.outputs_count; i++) {
-        if (g_vlog.outputs[i].options & VLOG_OUTPUT_OPTION_CLOSE) {
+#ifdef VLOG_ASYNC_SUPPORTED
+    __stop_writer();
+#endif
+    vlog_flush();
+
+    for (int i = 0; i < VLOG_MAX_OUTPUTS; i++) {
+        if (g_vlog.outputs[i].handle != NULL && (g_vlog.outputs[i].options & VLOG_OUTPUT_OPTION_CLOSE)) {
             fclose(g_vlog.outputs[i].handle);
         }
     }
+
+#ifdef VLOG_ASYNC_SUPPORTED
+    while (g_vlog.rings != NULL) {
+        struct vlog_ring* ring = g_vlog.rings;
+        g_vlog.rings = ring->next;
+        free(ring);
+    }
+    tss_delete(g_vlog.ring_key);
+    cnd_destroy(&g_vlog.writer_cond);
+    mtx_destroy(&g_vlog.writer_lock);
+    mtx_destroy(&g_vlog.rings_lock);
+#endif
+    mtx_destroy(&g_vlog.output_lock);
     memset(&g_vlog, 0, sizeof(struct vlog_context));
 }
 
 void vlog_set_level(enum vlog_level level)
 {
-    for (int i = 0; i < g_vlog.outputs_count; i++) {
-        g_vlog.outputs[i].level = level;
+    mtx_lock(&g_vlog.output_lock);
+    for (int i = 0; i < VLOG_MAX_OUTPUTS; i++) {
+        if (g_vlog.outputs[i].handle != NULL) {
+            g_vlog.outputs[i].level = level;
+        }
     }
     g_vlog.default_level = level;
+    __update_max_level();
+    mtx_unlock(&g_vlog.output_lock);
 }
 
 int vlog_add_output(FILE* output, int close)
 {
-    if (g_vlog.outputs_count == 4) {
+    struct vlog_output* slot = NULL;
+
+    mtx_lock(&g_vlog.output_lock);
+    for (int i = 0; i < VLOG_MAX_OUTPUTS; i++) {
+        if (g_vlog.outputs[i].handle == NULL) {
+            slot = &g_vlog.outputs[i];
+            break;
+        }
+    }
+
+    if (slot == NULL) {
+        mtx_unlock(&g_vlog.output_lock);
         errno = ENOSPC;
         return -1;
     }
 
-    g_vlog.outputs[g_vlog.outputs_count].handle       = output;
-    g_vlog.outputs[g_vlog.outputs_count].level        = g_vlog.default_level;
-    g_vlog.outputs[g_vlog.outputs_count].options      = 0;
+    slot->handle  = output;
+    slot->level   = g_vlog.default_level;
+    slot->options = 0;
+    slot->tty     = isatty(fileno(output));
+    slot->dirty   = 0;
     if (output == stdout) {
-        g_vlog.outputs[g_vlog.outputs_count].columns = __get_column_count();
+        slot->columns = __get_column_count();
     } else {
-        g_vlog.outputs[g_vlog.outputs_count].columns = 0;
+        slot->columns = 0;
     }
 
     if (close) {
-        g_vlog.outputs[g_vlog.outputs_count].options |= VLOG_OUTPUT_OPTION_CLOSE;
+        slot->options |= VLOG_OUTPUT_OPTION_CLOSE;
     }
 
     g_vlog.outputs_count++;
+    __update_max_level();
+    mtx_unlock(&g_vlog.output_lock);
     return 0;
 }
 
 int vlog_remove_output(FILE* output)
 {
-    for (int i = 0; i < g_vlog.outputs_count; i++) {
-        if (g_vlog.outputs[i].handle == output) {
-            g_vlog.outputs[i].handle = NULL;
-            g_vlog.outputs_count--;
-            return 0;
-        }
+    struct vlog_output* slot;
+
+    mtx_lock(&g_vlog.output_lock);
+    slot = __get_output(output);
+    if (slot == NULL) {
+        mtx_unlock(&g_vlog.output_lock);
+        errno = ENOENT;
+        return -1;
     }
-    errno = ENOENT;
-    return -1;
+
+#ifdef VLOG_ASYNC_SUPPORTED
+    // make sure everything queued for this output reaches it before the
+    // caller gets a chance to close it
+    __drain_rings();
+#endif
+    fflush(slot->handle);
+    memset(slot, 0, sizeof(struct vlog_output));
+    g_vlog.outputs_count--;
+    __update_max_level();
+    mtx_unlock(&g_vlog.output_lock);
+    return 0;
 }
 
 void vlog_set_output_options(FILE* output, unsigned int flags)
 {
-    for (int i = 0; i < g_vlog.outputs_count; i++) {
-        if (g_vlog.outputs[i].handle == output) {
-            g_vlog.outputs[i].options |= flags;
-            break;
-        }
+    struct vlog_output* slot;
+
+    mtx_lock(&g_vlog.output_lock);
+    slot = __get_output(output);
+    if (slot != NULL) {
+        slot->options |= flags;
     }
+    mtx_unlock(&g_vlog.output_lock);
 }
 
 void vlog_clear_output_options(FILE* output, unsigned int flags)
 {
-    for (int i = 0; i < g_vlog.outputs_count; i++) {
-        if (g_vlog.outputs[i].handle == output) {
-            g_vlog.outputs[i].options &= ~(flags);
-            break;
-        }
+    struct vlog_output* slot;
+
+    mtx_lock(&g_vlog.output_lock);
+    slot = __get_output(output);
+    if (slot != NULL) {
+        slot->options &= ~(flags);
     }
+    mtx_unlock(&g_vlog.output_lock);
 }
 
 void vlog_set_output_level(FILE* output, enum vlog_level level)
 {
-    for (int i = 0; i < g_vlog.outputs_count; i++) {
-        if (g_vlog.outputs[i].handle == output) {
-            g_vlog.outputs[i].level = level;
-            break;
-        }
+    struct vlog_output* slot;
+
+    mtx_lock(&g_vlog.output_lock);
+    slot = __get_output(output);
+    if (slot != NULL) {
+        slot->level = level;
+        __update_max_level();
     }
+    mtx_unlock(&g_vlog.output_lock);
 }
 
 void vlog_set_output_width(FILE* output, int columns)
 {
+    struct vlog_output* slot = __get_output(output);
+
     // must be a terminal
-    if (!isatty(fileno(output))) {
+    if (slot == NULL || !slot->tty) {
         return;
     }
+    slot->columns = columns;
+}
 
-    for (int i = 0; i < g_vlog.outputs_count; i++) {
-        if (g_vlog.outputs[i].handle == output) {
-            g_vlog.outputs[i].columns = columns;
-            break;
+// Must be called with the output lock held.
+static void __flush_outputs(void)
+{
+    for (int i = 0; i < VLOG_MAX_OUTPUTS; i++) {
+        if (g_vlog.outputs[i].handle != NULL && g_vlog.outputs[i].dirty) {
+            fflush(g_vlog.outputs[i].handle);
+            g_vlog.outputs[i].dirty = 0;
         }
     }
 }
 
 void vlog_flush(void)
 {
-    for (int i = 0; i < g_vlog.outputs_count; i++) {
-        fflush(g_vlog.outputs[i].handle);
+    if (!g_vlog.initialized) {
+        return;
+    }
+
+    mtx_lock(&g_vlog.output_lock);
+#ifdef VLOG_ASYNC_SUPPORTED
+    __drain_rings();
+#endif
+    for (int i = 0; i < VLOG_MAX_OUTPUTS; i++) {
+        if (g_vlog.outputs[i].handle != NULL) {
+            fflush(g_vlog.outputs[i].handle);
+            g_vlog.outputs[i].dirty = 0;
+        }
     }
+    mtx_unlock(&g_vlog.output_lock);
 }
 
 static void __render_line_with_text(struct vlog_output* output, const char* embed, int lcorner, int middle, int rcorner)
@@ -395,7 +910,7 @@ void vlog_start(FILE* handle, const char* header, const char* footer, int conten
     struct vlog_output* output = __get_output(handle);
 
     // must be a terminal
-    if (output == NULL || !isatty(fileno(handle))) {
+    if (output == NULL || !output->tty) {
         return;
     }
 
@@ -470,79 +985,220 @@ void vlog_refresh(FILE* handle)
     __refresh_view(output, 1);
 }
 
-void vlog_output(enum vlog_level level, const char* tag, const char* format, ...)
+// Formatting the time is comparatively expensive, and many lines share
+// the same second, so the last result is cached. Output lock must be held.
+static const char* __format_time(const struct timespec* time, int utc)
 {
-    va_list    args;
-    char       dateTime[32];
-    time_t     now;
-    struct tm* timeInfo;
+    struct vlog_time_cache* cache = utc ? &g_vlog.utc_time : &g_vlog.local_time;
+    struct tm               timeInfo;
+
+    if (cache->text[0] != '\0' && cache->second == time->tv_sec) {
+        return &cache->text[0];
+    }
+
+#if defined(WIN32) || defined(_WIN32) || defined(__WIN32__) || defined(__NT__)
+    if (utc) {
+        gmtime_s(&timeInfo, &time->tv_sec);
+    } else {
+        localtime_s(&timeInfo, &time->tv_sec);
+    }
+#else
+    if (utc) {
+        gmtime_r(&time->tv_sec, &timeInfo);
+    } else {
+        localtime_r(&time->tv_sec, &timeInfo);
+    }
+#endif
+    strftime(&cache->text[0], sizeof(cache->text) - 1, utc ? "%FT%T" : "%F %T", &timeInfo);
+    cache->second = time->tv_sec;
+    return &cache->text[0];
+}
 
-    if (!g_vlog.outputs_count) {
+static void __write_json_string(FILE* handle, const char* text, size_t length)
+{
+    fputc('"', handle);
+    for (size_t i = 0; i < length; i++) {
+        unsigned char c = (unsigned char)text[i];
+        switch (c) {
+            case '"':  fputs("\\\"", handle); break;
+            case '\\': fputs("\\\\", handle); break;
+            case '\n': fputs("\\n", handle); break;
+            case '\r': fputs("\\r", handle); break;
+            case '\t': fputs("\\t", handle); break;
+            default:
+                if (c < 0x20) {
+                    fprintf(handle, "\\u%04x", c);
+                } else {
+                    fputc(c, handle);
+                }
+                break;
+        }
+    }
+    fputc('"', handle);
+}
+
+static void __write_json(struct vlog_output* output, struct vlog_record* record)
+{
+    size_t length = record->length;
+
+    // the trailing newline is part of the message format, not the message
+    while (length > 0 && record->text[length - 1] == '\n') {
+        length--;
+    }
+
+    fprintf(output->handle, "{\"time\":\"%s.%03ldZ\",\"level\":\"%s\",\"tag\":",
+        __format_time(&record->time, 1), record->time.tv_nsec / 1000000L,
+        g_levelNamesLong[record->level]
+    );
+    __write_json_string(output->handle, record->tag, record->tag_length);
+    if (record->level == VLOG_LEVEL_ERROR) {
+        fprintf(output->handle, ",\"errno\":%i", record->error);
+    }
+    fputs(",\"message\":", output->handle);
+    __write_json_string(output->handle, record->text, length);
+    fputs("}\n", output->handle);
+}
+
+static void __write_view(struct vlog_output* output, struct vlog_record* record)
+{
+    char*  line   = &g_vlog.lines[g_vlog.content_line_index].buffer[0];
+    size_t length = record->length;
+
+#if defined(WIN32) || defined(_WIN32) || defined(__WIN32__) || defined(__NT__)
+    // update column count on output to stdout if on windows, we can
+    // only poll
+    output->columns = __get_column_count();
+#endif
+    if (length >= sizeof(g_vlog.lines[0].buffer)) {
+        length = sizeof(g_vlog.lines[0].buffer) - 1;
+    }
+
+    // strip the newlines
+    for (size_t j = 0; j < length; j++) {
+        line[j] = record->text[j] == '\n' ? ' ' : record->text[j];
+    }
+    line[length] = '\0';
+    __refresh_view(output, 1);
+}
+
+static void __write_record(struct vlog_output* output, struct vlog_record* record)
+{
+    if (output->options & VLOG_OUTPUT_OPTION_JSON) {
+        __write_json(output, record);
         return;
     }
 
-    time(&now);
-    timeInfo = localtime(&now);
+    if (output->options & VLOG_OUTPUT_OPTION_PROGRESS) {
+        fputs(__VLOG_CLEAR_LINE __VLOG_RESET_CURSOR, output->handle);
+    }
+
+    if (!(output->options & VLOG_OUTPUT_OPTION_NODECO)) {
+        if (output->options & VLOG_OUTPUT_OPTION_LONGDECO) {
+            fprintf(output->handle, "[%s] %s | %.*s | ", __format_time(&record->time, 0),
+                g_levelNamesLong[record->level], (int)record->tag_length, record->tag);
+            if (record->level == VLOG_LEVEL_ERROR) {
+                fprintf(output->handle, "[e%i, %s] | ", record->error, strerror(record->error));
+            }
+        } else {
+            if (record->level == VLOG_LEVEL_ERROR) {
+                fprintf(output->handle, "%.*s[%s%i, %s] ", (int)record->tag_length, record->tag,
+                    g_levelNamesShort[record->level], record->error, strerror(record->error));
+            } else {
+                fprintf(output->handle, "%.*s[%s] ", (int)record->tag_length, record->tag,
+                    g_levelNamesShort[record->level]);
+            }
+        }
+    }
+    fwrite(record->text, 1, record->length, output->handle);
+}
 
-    strftime(&dateTime[0], sizeof(dateTime) - 1, "%F %T", timeInfo);
+// Must be called with the output lock held.
+static void __emit_record(struct vlog_record* record)
+{
     for (int i = 0; i < VLOG_MAX_OUTPUTS; i++) {
-        struct vlog_output* output      = &g_vlog.outputs[i];
-        int                 colsWritten = 0;
+        struct vlog_output* output = &g_vlog.outputs[i];
 
         // ensure level is appropriate for output
-        if (output->handle == NULL || level > output->level) {
+        if (output->handle == NULL || record->level > output->level) {
             continue;
         }
 
         // if the output is a tty we handle it differently, unless vlog_start
         // was not configured
-        if (g_vlog.view_enabled && isatty(fileno(output->handle))) {
-#if defined(WIN32) || defined(_WIN32) || defined(__WIN32__) || defined(__NT__)
-            // update column count on output to stdout if on windows, we can
-            // only poll
-            output->columns = __get_column_count();
-#endif
+        if (g_vlog.view_enabled && output->tty) {
+            __write_view(output, record);
+            continue;
+        }
+
+        __write_record(output, record);
+        output->dirty = 1;
+    }
+}
+
+void vlog_output(enum vlog_level level, const char* tag, const char* format, ...)
+{
+    struct vlog_record record;
+    char               buffer[VLOG_LINE_SIZE];
+    va_list            args;
+    int                length;
+
+    // check the level before doing any work at all
+    if (!g_vlog.outputs_count || (int)level > g_vlog.max_level) {
+        return;
+    }
+
+    record.error      = errno;
+    record.level      = level;
+    record.tag        = tag;
+    record.tag_length = strlen(tag);
+    record.text       = &buffer[0];
+    timespec_get(&record.time, TIME_UTC);
+
+    va_start(args, format);
+    length = vsnprintf(&buffer[0], sizeof(buffer), format, args);
+    va_end(args);
+    if (length < 0) {
+        return;
+    }
+
+    record.length = (size_t)length;
+    if (record.length >= sizeof(buffer)) {
+        char* text = malloc(record.length + 1);
+        if (text != NULL) {
             va_start(args, format);
-            vsprintf(
-                &g_vlog.lines[g_vlog.content_line_index].buffer[0],
-                format, args
-            );
+            vsnprintf(text, record.length + 1, format, args);
             va_end(args);
-            
-            // strip the newlines
-            for (int j = 0; g_vlog.lines[g_vlog.content_line_index].buffer[j]; j++) {
-                if (g_vlog.lines[g_vlog.content_line_index].buffer[j] == '\n') {
-                    g_vlog.lines[g_vlog.content_line_index].buffer[j] = ' ';
-                }
-            }
-            __refresh_view(output, 1);
-            continue;
+            record.text = text;
         } else {
-            if (output->options & VLOG_OUTPUT_OPTION_PROGRESS) {
-                fprintf(output->handle, __VLOG_CLEAR_LINE __VLOG_RESET_CURSOR);
-            }
+            record.length = sizeof(buffer) - 1;
         }
-        
-        if (!(output->options & VLOG_OUTPUT_OPTION_NODECO)) {
-            if (output->options & VLOG_OUTPUT_OPTION_LONGDECO) {
-                fprintf(output->handle, "[%s] %s | %s | ", &dateTime[0], g_levelNamesLong[level], tag);
-                if (level == VLOG_LEVEL_ERROR) {
-                    fprintf(output->handle, "[e%i, %s] | ", errno, strerror(errno));
-                }
-            } else {
-                if (level == VLOG_LEVEL_ERROR) {
-                    fprintf(output->handle, "%s[%s%i, %s] ", tag, g_levelNamesShort[level], errno, strerror(errno));
-                } else {
-                    fprintf(output->handle, "%s[%s] ", tag, g_levelNamesShort[level]);
-                }
-            }
+    }
+
+#ifdef VLOG_ASYNC_SUPPORTED
+    // queue the record for the writer, the interactive view is always
+    // written synchronously
+    if (atomic_load_explicit(&g_vlog.async, memory_order_relaxed) && !g_vlog.view_enabled) {
+        struct vlog_ring* ring = __get_ring();
+        if (ring != NULL) {
+            record.sequence = atomic_fetch_add(&g_vlog.sequence, 1);
+            __ring_push(ring, &record);
+            goto cleanup;
         }
+    }
+#endif
 
-        va_start(args, format);
-        vfprintf(output->handle, format, args);
-        va_end(args);
-        fflush(output->handle);
+    mtx_lock(&g_vlog.output_lock);
+    __emit_record(&record);
+    __flush_outputs();
+    mtx_unlock(&g_vlog.output_lock);
+
+#ifdef VLOG_ASYNC_SUPPORTED
+cleanup:
+#endif
+    if (record.text != &buffer[0]) {
+        free((void*)record.text);
     }
+    errno = record.error;
 }
 
 void vlog_step_init(struct vlog_step* step, int index, const char* prefix)
@@ -29,6 +29,7 @@
 #include <chef/platform.h>
 #include <chef/recipe.h>
 #include <chef/store-default.h>
+#include <chef/trace.h>
 #include <ctype.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -49,6 +50,12 @@ static void __print_help(void)
     printf("      Cross-compile for another platform or/and architecture. This switch\n");
     printf("      can be used with two different formats, either just like\n");
     printf("      --cross-compile=arch or --cross-compile=platform/arch\n");
+    printf("      --trace <file>\n");
+    printf("      Records the time spent in each phase of the build, including inside\n");
+    printf("      the build container, to a Chrome trace-event file (i.e for Perfetto)\n");
+    printf("      --ingredient-layers\n");
+    printf("      Mounts the host and build ingredients read-only into the build container instead of\n");
+    printf("      unpacking them, which makes setting up a new build environment faster\n");
     printf("  -h,  --help\n");
     printf("      Shows this help message\n");
 }
@@ -224,6 +231,8 @@ int run_main(int argc, char** argv, char** envp, struct bake_command_options* op
     struct vlog_step           step_source;
     struct vlog_step           step_build;
     struct vlog_step           step_pack;
+    struct chef_trace_span     span_build;
+    struct chef_trace_span     span;
 
     // catch CTRL-C
     signal(SIGINT, __cleanup_systems);
@@ -249,6 +258,15 @@ int run_main(int argc, char** argv, char** envp, struct bake_command_options* op
         return -1;
     }
 
+    if (options->trace_path != NULL) {
+        status = chef_trace_enable("bake", 0);
+        if (status) {
+            fprintf(stderr, "bake: failed to enable tracing: %s\n", strerror(errno));
+            return -1;
+        }
+    }
+    chef_trace_begin(&span_build);
+
     config = chef_config_load(chef_dirs_config());
     if (config == NULL) {
         VLOG_ERROR("remote", "remote_client_create: failed to load configuration\n");
@@ -328,21 +346,27 @@ int run_main(int argc, char** argv, char** envp, struct bake_command_options* op
         .build_cache = cache,
         .target_platform = options->platform,
         .target_architecture = arch,
-        .cvd_address = &cvdAddress
+        .cvd_address = &cvdAddress,
+        .trace = options->trace_path != NULL,
+        .ingredient_layers = options->ingredient_layers
     });
     if (g_context == NULL) {
         VLOG_ERROR("bake", "failed to initialize build context: %s\n", strerror(errno));
         return -1;
     }
 
+    chef_trace_begin(&span);
     status = __ensure_ingredients(options->recipe, options->platform, arch);
+    chef_trace_end(&span, "bake", "fetch ingredients");
     if (status) {
         VLOG_ERROR("bake", "failed to fetch ingredients: %s\n", strerror(errno));
         vlog_step_fail(&step_prepare);
         goto cleanup;
     }
 
+    chef_trace_begin(&span);
     status = bake_build_setup(g_context);
+    chef_trace_end(&span, "bake", "setup");
     if (status) {
         VLOG_ERROR("bake", "failed to setup build environment: %s\n", strerror(errno));
         vlog_step_fail(&step_prepare);
@@ -374,6 +398,13 @@ int run_main(int argc, char** argv, char** envp, struct bake_command_options* op
 cleanup:
     vlog_refresh(stdout);
     vlog_end();
+    if (options->trace_path != NULL) {
+        chef_trace_end(&span_build, "bake", "build %s", options->recipe->project.name);
+        if (build_trace_write(g_context, options->trace_path) == 0) {
+            printf("bake: trace written to %s\n", options->trace_path);
+        }
+        chef_trace_disable();
+    }
     build_context_destroy(g_context);
     return status;
 }
@@ -29,6 +29,8 @@ struct bake_command_options {
     const char*    platform;
     struct list    architectures;
     const char*    cwd;
+    const char*    trace_path;
+    int            ingredient_layers;
 };
 
 #endif //!__BAKE_COMMANDS_H__
@@ -33,6 +33,10 @@
 
 #include "remote_shared.c"
 
+// Reads from waiterd must fit in a single message, the same limit cooks use
+// for their uploads
+#define __ARTIFACT_READ_SIZE (3 * 1024)
+
 static void __print_help(void)
 {
     printf("Usage: bake remote download {log, artifact} --ids=<list-of-ids> [options]\n");
@@ -64,6 +68,7 @@ static int __discover_artifacts(gracht_client_t* client, struct list* builds, en
     int                            status;
     int                            i;
     char                           linkBuffer[4096];
+    char                           digestBuffer[128];
 
     // iterate through each of the builds and setup
     i = 0;
@@ -101,9 +106,14 @@ static int __discover_artifacts(gracht_client_t* client, struct list* builds, en
         }
         
         memset(&linkBuffer[0], 0, sizeof(linkBuffer));
+        memset(&digestBuffer[0], 0, sizeof(digestBuffer));
 
         vlog_content_set_index(build->log_index);
-        status = chef_waiterd_artifact_result(client, &build->msg_storage, &linkBuffer[0], sizeof(linkBuffer));
+        status = chef_waiterd_artifact_result(
+            client, &build->msg_storage,
+            &linkBuffer[0], sizeof(linkBuffer),
+            &digestBuffer[0], sizeof(digestBuffer)
+        );
         if (status) {
             vlog_content_set_status(VLOG_CONTENT_STATUS_FAILED);
             return -1;
@@ -112,16 +122,105 @@ static int __discover_artifacts(gracht_client_t* client, struct list* builds, en
         switch (atype) {
             case CHEF_ARTIFACT_TYPE_LOG:
                 build->log_link = platform_strdup(&linkBuffer[0]);
+                build->log_digest = platform_strdup(&digestBuffer[0]);
                 break;
             case CHEF_ARTIFACT_TYPE_PACKAGE:
                 build->package_link = platform_strdup(&linkBuffer[0]);
+                build->package_digest = platform_strdup(&digestBuffer[0]);
                 break;
         }
     }
     return 0;
 }
 
-static int __download_artifacts(struct list* builds)
+// Reads the stored content of the digest from waiterd into <path>
+static int __read_artifact(gracht_client_t* client, const char* digest, const char* path)
+{
+    struct gracht_message_context context;
+    uint8_t                       buffer[__ARTIFACT_READ_SIZE];
+    uint64_t                      offset = 0;
+    unsigned int                  count;
+    int                           status;
+    FILE*                         file;
+
+    file = fopen(path, "wb");
+    if (file == NULL) {
+        VLOG_ERROR("remote", "__read_artifact: failed to create %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+
+    for (;;) {
+        status = chef_waiterd_artifact_read(client, &context, digest, offset, sizeof(buffer));
+        if (status) {
+            break;
+        }
+
+        status = gracht_client_wait_message(client, &context, GRACHT_MESSAGE_BLOCK);
+        if (status) {
+            VLOG_ERROR("remote", "__read_artifact: connection lost while reading %s\n", digest);
+            break;
+        }
+
+        count = 0;
+        chef_waiterd_artifact_read_result(client, &context, &status, &count, &buffer[0], sizeof(buffer));
+        if (status || count > sizeof(buffer)) {
+            VLOG_ERROR("remote", "__read_artifact: waiterd could not read %s\n", digest);
+            errno = ENOENT;
+            status = -1;
+            break;
+        }
+
+        if (count > 0 && fwrite(&buffer[0], 1, count, file) != count) {
+            VLOG_ERROR("remote", "__read_artifact: failed to write %s: %s\n", path, strerror(errno));
+            status = -1;
+            break;
+        }
+        offset += count;
+
+        // a short read marks the end of the artifact
+        if (count < sizeof(buffer)) {
+            break;
+        }
+    }
+
+    if (fclose(file) && status == 0) {
+        status = -1;
+    }
+    if (status) {
+        platform_unlink(path);
+    }
+    return status;
+}
+
+// waiterd links to artifacts in its own store with file:// links, which are
+// copied directly when bake runs on the same machine. Otherwise the content is
+// read from waiterd by its digest. Anything else is downloaded.
+static int __retrieve_artifact(gracht_client_t* client, const char* link, const char* digest)
+{
+    const char* name;
+
+    name = strrchr(link, '/');
+    name = name != NULL ? name + 1 : link;
+    if (name[0] == '\0') {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (strncmp(link, "file://", 7) == 0) {
+        if (platform_copyfile(link + 7, name) == 0) {
+            return 0;
+        }
+
+        if (digest == NULL || digest[0] == '\0') {
+            return -1;
+        }
+        VLOG_DEBUG("remote", "%s is not reachable from here, reading it from waiterd\n", link + 7);
+        return __read_artifact(client, digest, name);
+    }
+    return chef_client_gen_download(link, name);
+}
+
+static int __download_artifacts(gracht_client_t* client, struct list* builds)
 {
     struct list_item* li;
     int               status;
@@ -138,7 +237,7 @@ static int __download_artifacts(struct list* builds)
 
         if (build->package_link != NULL) {
             VLOG_TRACE("remote", "downloading package...\n");
-            status = chef_client_gen_download(&build->package_link[0], NULL);
+            status = __retrieve_artifact(client, &build->package_link[0], build->package_digest);
             if (status) {
                 VLOG_ERROR("remote", "failed to retrieve package\n");
                 vlog_content_set_status(VLOG_CONTENT_STATUS_FAILED);
@@ -148,7 +247,7 @@ static int __download_artifacts(struct list* builds)
 
         if (build->log_link != NULL) {
             VLOG_TRACE("remote", "downloading logs...\n");
-            status = chef_client_gen_download(&build->log_link[0], NULL);
+            status = __retrieve_artifact(client, &build->log_link[0], build->log_digest);
             if (status) {
                 VLOG_ERROR("remote", "failed to retrieve log\n");
                 vlog_content_set_status(VLOG_CONTENT_STATUS_FAILED);
@@ -261,7 +360,7 @@ int remote_download_main(int argc, char** argv, char** envp, struct bake_command
         goto cleanup;
     }
 
-    status = __download_artifacts(&builds);
+    status = __download_artifacts(client, &builds);
 
 cleanup:
     gracht_client_shutdown(client);
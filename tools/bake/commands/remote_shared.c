@@ -35,7 +35,9 @@ struct __build {
     enum chef_build_status        last_status;
 
     char*                         log_link;
+    char*                         log_digest;
     char*                         package_link;
+    char*                         package_digest;
 };
 
 static void __build_delete(struct __build* build)
@@ -46,6 +48,8 @@ static void __build_delete(struct __build* build)
     if (build->package_link != NULL) {
         free(build->package_link);
     }
+    free(build->log_digest);
+    free(build->package_digest);
     free(build);
 }
 
@@ -259,6 +259,10 @@ int main(int argc, char** argv, char** envp)
                     continue;
                 } else if (!__parse_stringv_switch(argv, argc, &i, "-a", 2, "--archs", 7, NULL, &options.architectures)) {
                     continue;
+                } else if (!__parse_string_switch(argv, argc, &i, "--trace", 7, "--trace", 7, NULL, (char**)&options.trace_path)) {
+                    continue;
+                } else if (!strcmp(argv[i], "--ingredient-layers")) {
+                    options.ingredient_layers = 1;
                 } else if (!strncmp(argv[i], "-v", 2)) {
                     int li = 1;
                     while (argv[i][li++] == 'v') {
@@ -286,7 +290,7 @@ int main(int argc, char** argv, char** envp)
     if (options.recipe_path != NULL) {
         status = platform_readfile(options.recipe_path, &buffer, &length);
         if (!status) {
-            status = recipe_parse(buffer, length, &options.recipe);
+            status = recipe_load(RECIPE_CACHE_DIRECTORY, buffer, length, &options.recipe);
             free(buffer);
             if (status) {
                 fprintf(stderr, "bake: failed to parse recipe\n");
@@ -0,0 +1,165 @@
+/**
+ * Copyright, Philip Meulengracht
+ *
+ * This program is free software : you can redistribute it and / or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation ? , either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ * 
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vlog.h>
+
+#include "agent.h"
+
+#if defined(__linux__)
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+static int __connect_agent(void)
+{
+    struct sockaddr_un address = { 0 };
+    int                fd;
+
+    fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        return -1;
+    }
+
+    address.sun_family = AF_UNIX;
+    strncpy(&address.sun_path[0], BAKECTL_AGENT_ADDRESS, sizeof(address.sun_path) - 1);
+
+    // a socket left behind by the agent of an earlier build refuses the
+    // connection, in which case the command runs locally
+    if (connect(fd, (struct sockaddr*)&address, sizeof(address))) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static int __send_request(int fd, char* payload, size_t length)
+{
+    struct bakectl_agent_header header = { BAKECTL_AGENT_MAGIC, (unsigned int)length };
+    struct iovec                iov = { &header, sizeof(header) };
+    union {
+        char           buffer[CMSG_SPACE(sizeof(int) * 3)];
+        struct cmsghdr align;
+    } control;
+    struct msghdr   msg = { 0 };
+    struct cmsghdr* cmsg;
+    int             fds[3] = { STDIN_FILENO, STDOUT_FILENO, STDERR_FILENO };
+
+    memset(&control, 0, sizeof(control));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buffer;
+    msg.msg_controllen = sizeof(control.buffer);
+
+    cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+    memcpy(CMSG_DATA(cmsg), &fds[0], sizeof(fds));
+
+    if (sendmsg(fd, &msg, MSG_NOSIGNAL) != sizeof(header)) {
+        return -1;
+    }
+
+    while (length) {
+        ssize_t written = send(fd, payload, length, MSG_NOSIGNAL);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        payload += written;
+        length -= (size_t)written;
+    }
+    return 0;
+}
+
+int bakectl_agent_forward(int argc, char** argv, int* statusOut)
+{
+    char*   payload;
+    size_t  length = 0;
+    size_t  offset = 0;
+    int     fd;
+    int     status;
+    ssize_t bytesRead;
+
+    fd = __connect_agent();
+    if (fd < 0) {
+        // no agent, run the command in this process
+        return -1;
+    }
+
+    for (int i = 0; i < argc; i++) {
+        length += strlen(argv[i]) + 1;
+    }
+
+    payload = malloc(length);
+    if (payload == NULL) {
+        close(fd);
+        return -1;
+    }
+
+    for (int i = 0; i < argc; i++) {
+        size_t argLength = strlen(argv[i]) + 1;
+        memcpy(&payload[offset], argv[i], argLength);
+        offset += argLength;
+    }
+
+    // make sure anything we've written ourselves appear before the output
+    // of the agent
+    fflush(stdout);
+    fflush(stderr);
+
+    status = __send_request(fd, payload, length);
+    free(payload);
+    if (status) {
+        close(fd);
+        return -1;
+    }
+
+    // From here on the agent owns the request, even if it fails we must not
+    // run the command again ourselves.
+    do {
+        bytesRead = recv(fd, &status, sizeof(status), MSG_WAITALL);
+    } while (bytesRead < 0 && errno == EINTR);
+    close(fd);
+
+    if (bytesRead != sizeof(status)) {
+        fprintf(stderr, "bakectl: lost connection to the bakectl agent\n");
+        status = -1;
+    }
+    *statusOut = status;
+    return 0;
+}
+
+#else
+
+int bakectl_agent_forward(int argc, char** argv, int* statusOut)
+{
+    (void)argc;
+    (void)argv;
+    (void)statusOut;
+    errno = ENOSYS;
+    return -1;
+}
+
+#endif
@@ -0,0 +1,48 @@
+/**
+ * Copyright, Philip Meulengracht
+ *
+ * This program is free software : you can redistribute it and / or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation ? , either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ * 
+ */
+
+#ifndef __BAKECTL_AGENT_H__
+#define __BAKECTL_AGENT_H__
+
+// The agent listens on a socket in the filesystem of the build container. Build
+// containers share the network namespace of the host, so an abstract socket
+// would be shared by every build running on it.
+#define BAKECTL_AGENT_ADDRESS "/chef/bakectl.sock"
+
+// Every request starts with this header, followed by <length> bytes of
+// NUL-separated arguments. The stdin/stdout/stderr of the requesting process
+// are passed along the header as SCM_RIGHTS.
+#define BAKECTL_AGENT_MAGIC 0x42414B45U
+
+struct bakectl_agent_header {
+    unsigned int magic;
+    unsigned int length;
+};
+
+/**
+ * @brief Forwards the command line to the bakectl agent running in this container,
+ * and waits for it to complete.
+ * @param argc The number of arguments, argv[0] must be the command name.
+ * @param argv The arguments.
+ * @param statusOut Receives the exit status of the command.
+ * @return 0 if the command was executed by the agent, -1 if no agent could be reached
+ * and the command should be executed locally.
+ */
+extern int bakectl_agent_forward(int argc, char** argv, int* statusOut);
+
+#endif //!__BAKECTL_AGENT_H__
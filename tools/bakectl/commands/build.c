@@ -20,6 +20,7 @@
 #include <liboven.h>
 #include <chef/list.h>
 #include <chef/platform.h>
+#include <chef/trace.h>
 #include <ctype.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -94,7 +95,8 @@ static int __build_step(const char* partName, struct list* steps, const char* st
     VLOG_DEBUG("bakectl", "__build_step(part=%s, step=%s)\n", partName, stepName);
     
     list_foreach(steps, item) {
-        struct recipe_step* step = (struct recipe_step*)item;
+        struct recipe_step*    step = (struct recipe_step*)item;
+        struct chef_trace_span span;
 
         // find the correct recipe step part
         if (strcmp(step->name, stepName)) {
@@ -102,6 +104,7 @@ static int __build_step(const char* partName, struct list* steps, const char* st
         }
 
         VLOG_DEBUG("bakectl", "executing step '%s/%s'\n", partName, step->name);
+        chef_trace_begin(&span);
         if (step->type == RECIPE_STEP_TYPE_GENERATE) {
             struct oven_generate_options genOptions;
             __initialize_generator_options(&genOptions, step);
@@ -132,6 +135,7 @@ static int __build_step(const char* partName, struct list* steps, const char* st
             VLOG_ERROR("bakectl", "unknown step type: %i\n", step->type);
             return -1;
         }
+        chef_trace_end(&span, "bakectl", "%s %s/%s", step->system != NULL ? step->system : "script", partName, step->name);
 
         // done if a specific step was provided
         if (stepName != NULL) {
@@ -0,0 +1,464 @@
+/**
+ * Copyright, Philip Meulengracht
+ *
+ * This program is free software : you can redistribute it and / or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation ? , either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ * 
+ */
+
+#include <errno.h>
+#include <chef/platform.h>
+#include <limits.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vlog.h>
+
+#include "gitcache.h"
+
+#if defined(__linux__)
+#include <fcntl.h>
+#include <sys/file.h>
+#include <unistd.h>
+
+// The mirrors are owned by the host user and not the user running the build, which
+// git refuses unless the directories are marked as safe. Submodules are cloned from
+// the local mirrors, which newer versions of git also refuses by default.
+#define __GIT_OPTIONS "-c safe.directory=* -c protocol.file.allow=always"
+
+struct __git_output {
+    char*  buffer;
+    size_t length;
+    size_t capacity;
+};
+
+static uint64_t __fnv1a64(const char* s)
+{
+    uint64_t h = 1469598103934665603ULL;
+    for (const unsigned char* p = (const unsigned char*)s; *p; p++) {
+        h ^= (uint64_t)(*p);
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+static void __git_output_line(const char* line, size_t length, enum platform_spawn_output_type type, void* context)
+{
+    struct __git_output* output = context;
+
+    // stderr is dropped, the exit code tells whether the command succeeded
+    if (type != PLATFORM_SPAWN_OUTPUT_TYPE_STDOUT) {
+        return;
+    }
+
+    if (output->length + length + 1 > output->capacity) {
+        size_t newCapacity = output->capacity ? output->capacity * 2 : 1024;
+        char*  newBuffer;
+        while (newCapacity < output->length + length + 1) {
+            newCapacity *= 2;
+        }
+
+        newBuffer = realloc(output->buffer, newCapacity);
+        if (newBuffer == NULL) {
+            return;
+        }
+        output->buffer = newBuffer;
+        output->capacity = newCapacity;
+    }
+
+    memcpy(&output->buffer[output->length], line, length);
+    output->length += length;
+    output->buffer[output->length] = '\0';
+}
+
+static int __git_spawn(const char* cwd, const char* const* envp, struct __git_output* output, const char* format, ...)
+{
+    char    arguments[2048];
+    int     written;
+    va_list args;
+
+    written = snprintf(&arguments[0], sizeof(arguments), "%s ", __GIT_OPTIONS);
+    va_start(args, format);
+    written += vsnprintf(&arguments[written], sizeof(arguments) - written, format, args);
+    va_end(args);
+    if (written >= (int)sizeof(arguments)) {
+        errno = E2BIG;
+        return -1;
+    }
+
+    VLOG_DEBUG("bakectl", "git %s (cwd=%s)\n", &arguments[0], cwd);
+    return platform_spawn(
+        "git", &arguments[0], envp,
+        &(struct platform_spawn_options) {
+            .cwd = cwd,
+            .line_handler = output != NULL ? __git_output_line : NULL,
+            .line_context = output
+        }
+    );
+}
+
+#define __git(cwd, envp, ...) __git_spawn(cwd, envp, NULL, __VA_ARGS__)
+
+// Runs git and returns the trimmed stdout, or NULL if the command failed.
+static char* __git_capture(const char* cwd, const char* const* envp, const char* format, const char* argument)
+{
+    struct __git_output output = { 0 };
+    int                 status;
+
+    status = __git_spawn(cwd, envp, &output, format, argument);
+    if (status) {
+        free(output.buffer);
+        return NULL;
+    }
+
+    if (output.buffer == NULL) {
+        return platform_strdup("");
+    }
+
+    while (output.length > 0 && 
+           (output.buffer[output.length - 1] == '\n' || output.buffer[output.length - 1] == '\r')) {
+        output.buffer[--output.length] = '\0';
+    }
+    return output.buffer;
+}
+
+static int __mirror_has_commit(const char* mirror, const char* commit, const char* const* envp)
+{
+    char* sha = __git_capture(mirror, envp, "rev-parse -q --verify %s^{commit}", commit);
+    int   exists = sha != NULL && sha[0] != '\0';
+    free(sha);
+    return exists;
+}
+
+static int __mirror_lock(const char* mirror)
+{
+    char path[PATH_MAX];
+    int  fd;
+
+    snprintf(&path[0], sizeof(path), "%s.lock", mirror);
+    fd = open(&path[0], O_CREAT | O_RDWR | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        VLOG_ERROR("bakectl", "__mirror_lock: failed to open %s: %s\n", &path[0], strerror(errno));
+        return -1;
+    }
+
+    if (flock(fd, LOCK_EX)) {
+        VLOG_ERROR("bakectl", "__mirror_lock: failed to lock %s: %s\n", &path[0], strerror(errno));
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static void __mirror_unlock(int fd)
+{
+    if (fd >= 0) {
+        flock(fd, LOCK_UN);
+        close(fd);
+    }
+}
+
+static int __mirror_create(const char* cacheRoot, const char* mirror, const char* url, const char* const* envp)
+{
+    char staging[PATH_MAX];
+    int  status;
+
+    // clone into a staging directory first, so an interrupted clone
+    // never leaves a partial mirror behind
+    snprintf(&staging[0], sizeof(staging), "%s.tmp", mirror);
+    if (platform_rmdir(&staging[0]) && errno != ENOENT) {
+        VLOG_ERROR("bakectl", "__mirror_create: failed to remove %s\n", &staging[0]);
+        return -1;
+    }
+
+    VLOG_TRACE("bakectl", "Mirroring %s\n", url);
+    status = __git(cacheRoot, envp, "clone -q --mirror %s %s", url, &staging[0]);
+    if (status) {
+        VLOG_ERROR("bakectl", "__mirror_create: failed to mirror %s\n", url);
+        return -1;
+    }
+
+    // checkouts borrow objects from the mirror, they must never be collected
+    status = __git(&staging[0], envp, "config gc.auto 0");
+    if (status) {
+        return -1;
+    }
+
+    if (rename(&staging[0], mirror)) {
+        VLOG_ERROR("bakectl", "__mirror_create: failed to move %s into place: %s\n", &staging[0], strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+static int __mirror_update(const char* mirror, const char* url, const char* branch, const char* commit, const char* const* envp)
+{
+    int status;
+
+    // A pinned commit is immutable, so nothing has to be fetched if the mirror already has it
+    if (branch == NULL && commit != NULL && __mirror_has_commit(mirror, commit, envp)) {
+        VLOG_DEBUG("bakectl", "__mirror_update: %s already present for %s\n", commit, url);
+        return 0;
+    }
+
+    VLOG_TRACE("bakectl", "Updating mirror of %s\n", url);
+    if (branch != NULL) {
+        status = __git(mirror, envp, "fetch -q origin +refs/heads/%s:refs/heads/%s", branch, branch);
+        if (status == 0) {
+            return 0;
+        }
+        // it may be a tag rather than a branch, fall back to updating everything
+    }
+
+    status = __git(mirror, envp, "fetch -q --prune origin");
+    if (status) {
+        VLOG_ERROR("bakectl", "__mirror_update: failed to update mirror of %s\n", url);
+        return -1;
+    }
+
+    // The commit may not be reachable from any ref, try to fetch it directly
+    if (branch == NULL && commit != NULL && !__mirror_has_commit(mirror, commit, envp)) {
+        status = __git(mirror, envp, "fetch -q origin %s", commit);
+        if (status) {
+            VLOG_ERROR("bakectl", "__mirror_update: commit %s was not found in %s\n", commit, url);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// Ensures the mirror of the url exists and contains the requested refs. On success the
+// mirror is locked until the returned lock is released, so the caller can clone from it
+// without it being updated by other builds meanwhile.
+static int __mirror_ensure(
+    const char*        cacheRoot,
+    const char*        url,
+    const char*        branch,
+    const char*        commit,
+    const char* const* envp,
+    char*              mirrorOut,
+    size_t             mirrorLength,
+    int*               lockOut)
+{
+    char head[PATH_MAX];
+    int  lock;
+    int  status;
+
+    snprintf(mirrorOut, mirrorLength, "%s/%016llx.git", cacheRoot, (unsigned long long)__fnv1a64(url));
+
+    lock = __mirror_lock(mirrorOut);
+    if (lock < 0) {
+        return -1;
+    }
+
+    snprintf(&head[0], sizeof(head), "%s/HEAD", mirrorOut);
+    if (access(&head[0], F_OK)) {
+        status = __mirror_create(cacheRoot, mirrorOut, url, envp);
+        if (status == 0 && branch == NULL && commit != NULL && !__mirror_has_commit(mirrorOut, commit, envp)) {
+            status = __git(mirrorOut, envp, "fetch -q origin %s", commit);
+        }
+    } else {
+        status = __mirror_update(mirrorOut, url, branch, commit, envp);
+    }
+
+    if (status) {
+        __mirror_unlock(lock);
+        return -1;
+    }
+    *lockOut = lock;
+    return 0;
+}
+
+static int __update_submodules(const char* cacheRoot, const char* path, const char* const* envp)
+{
+    char  gitmodules[PATH_MAX];
+    char* urls;
+    char* line;
+    char* next;
+    int   status;
+
+    snprintf(&gitmodules[0], sizeof(gitmodules), "%s/.gitmodules", path);
+    if (access(&gitmodules[0], F_OK)) {
+        return 0;
+    }
+
+    // init resolves relative submodule urls against the url of origin
+    status = __git(path, envp, "submodule --quiet init");
+    if (status) {
+        VLOG_ERROR("bakectl", "__update_submodules: failed to initialize submodules in %s\n", path);
+        return -1;
+    }
+
+    urls = __git_capture(path, envp, "config --get-regexp %s", "^submodule\\..*\\.url$");
+    if (urls == NULL) {
+        // no submodules registered
+        return 0;
+    }
+
+    for (line = urls; line != NULL && *line != '\0'; line = next) {
+        char  mirror[PATH_MAX];
+        char  subPath[PATH_MAX];
+        char* name;
+        char* url;
+        char* relative;
+        char* tree;
+        char* sha;
+        int   lock;
+
+        next = strchr(line, '\n');
+        if (next != NULL) {
+            *next++ = '\0';
+        }
+
+        // submodule.<name>.url <url>
+        url = strchr(line, ' ');
+        if (url == NULL || strncmp(line, "submodule.", 10) != 0 || (url - line) < 15) {
+            continue;
+        }
+        *url++ = '\0';
+        name = line + 10;
+        name[strlen(name) - 4] = '\0';
+
+        relative = __git_capture(path, envp, "config -f .gitmodules submodule.%s.path", name);
+        if (relative == NULL) {
+            continue;
+        }
+
+        // <mode> commit <sha>\t<path>, nothing is printed if the submodule is not in the tree
+        tree = __git_capture(path, envp, "ls-tree HEAD %s", relative);
+        sha = tree != NULL ? strstr(tree, " commit ") : NULL;
+        if (sha == NULL) {
+            free(tree);
+            free(relative);
+            continue;
+        }
+        sha += 8;
+        sha[strcspn(sha, "\t ")] = '\0';
+
+        status = __mirror_ensure(cacheRoot, url, NULL, sha, envp, &mirror[0], sizeof(mirror), &lock);
+        free(tree);
+        if (status) {
+            free(relative);
+            break;
+        }
+
+        // check out the submodule from the mirror, and restore the url afterwards so the
+        // checkout looks like it was cloned from the upstream repository
+        status = __git(path, envp, "config submodule.%s.url %s", name, &mirror[0]);
+        if (status == 0) {
+            status = __git(path, envp, "submodule --quiet update --reference %s -- %s", &mirror[0], relative);
+        }
+        if (status == 0) {
+            status = __git(path, envp, "config submodule.%s.url %s", name, url);
+        }
+
+        snprintf(&subPath[0], sizeof(subPath), "%s/%s", path, relative);
+        free(relative);
+        if (status == 0) {
+            status = __git(&subPath[0], envp, "remote set-url origin %s", url);
+        }
+        __mirror_unlock(lock);
+        if (status) {
+            VLOG_ERROR("bakectl", "__update_submodules: failed to check out submodule %s\n", name);
+            break;
+        }
+
+        status = __update_submodules(cacheRoot, &subPath[0], envp);
+        if (status) {
+            break;
+        }
+    }
+
+    free(urls);
+    return status;
+}
+
+int gitcache_checkout(
+    const char*        cacheRoot,
+    const char*        url,
+    const char*        branch,
+    const char*        commit,
+    const char*        path,
+    const char* const* envp)
+{
+    char mirror[PATH_MAX];
+    int  lock;
+    int  status;
+    VLOG_DEBUG("bakectl", "gitcache_checkout(url=%s)\n", url);
+
+    if (cacheRoot == NULL || url == NULL || path == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    status = platform_mkdir(cacheRoot);
+    if (status) {
+        VLOG_ERROR("bakectl", "gitcache_checkout: failed to create %s\n", cacheRoot);
+        return -1;
+    }
+
+    status = __mirror_ensure(cacheRoot, url, branch, commit, envp, &mirror[0], sizeof(mirror), &lock);
+    if (status) {
+        return -1;
+    }
+
+    // The checkout shares the objects of the mirror instead of copying them
+    VLOG_TRACE("bakectl", "Checking out %s from the git cache\n", url);
+    status = __git(path, envp, "clone -q --shared --no-checkout %s .", &mirror[0]);
+    __mirror_unlock(lock);
+    if (status) {
+        VLOG_ERROR("bakectl", "gitcache_checkout: failed to clone from the mirror of %s\n", url);
+        return -1;
+    }
+
+    status = __git(path, envp, "remote set-url origin %s", url);
+    if (status) {
+        return -1;
+    }
+
+    if (branch != NULL || commit != NULL) {
+        status = __git(path, envp, "checkout -q %s", branch != NULL ? branch : commit);
+    } else {
+        status = __git(path, envp, "checkout -q HEAD -- .");
+    }
+    if (status) {
+        VLOG_ERROR("bakectl", "gitcache_checkout: failed to check out %s\n", branch != NULL ? branch : (commit != NULL ? commit : "HEAD"));
+        return -1;
+    }
+
+    return __update_submodules(cacheRoot, path, envp);
+}
+
+#else
+
+int gitcache_checkout(
+    const char*        cacheRoot,
+    const char*        url,
+    const char*        branch,
+    const char*        commit,
+    const char*        path,
+    const char* const* envp)
+{
+    (void)cacheRoot;
+    (void)url;
+    (void)branch;
+    (void)commit;
+    (void)path;
+    (void)envp;
+    errno = ENOTSUP;
+    return -1;
+}
+
+#endif
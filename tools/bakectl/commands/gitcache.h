@@ -0,0 +1,48 @@
+/**
+ * Copyright, Philip Meulengracht
+ *
+ * This program is free software : you can redistribute it and / or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation ? , either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ * 
+ */
+
+#ifndef __BAKECTL_GITCACHE_H__
+#define __BAKECTL_GITCACHE_H__
+
+// The git cache is mapped in by the host, and is shared between all
+// build containers. It holds a bare mirror for each repository url.
+#define BAKECTL_GIT_CACHE_PATH "/chef/cache/git"
+
+/**
+ * @brief Materializes a checkout of the repository at the given path, using the
+ * mirrors in the git cache. The mirror is created on first use, otherwise only the
+ * missing refs or commits are fetched. The checkout borrows the objects of the mirror,
+ * and submodules are checked out the same way.
+ * @param cacheRoot The directory holding the mirrors.
+ * @param url The url of the repository.
+ * @param branch The branch to check out, may be NULL.
+ * @param commit The commit to check out if no branch is provided, may be NULL.
+ * @param path An empty directory that receives the checkout.
+ * @param envp The environment for the git invocations.
+ * @return 0 on success, -1 on failure with errno set.
+ */
+extern int gitcache_checkout(
+    const char*        cacheRoot,
+    const char*        url,
+    const char*        branch,
+    const char*        commit,
+    const char*        path,
+    const char* const* envp
+);
+
+#endif //!__BAKECTL_GITCACHE_H__
@@ -22,6 +22,7 @@
 #include <chef/store.h>
 #include <chef/ingredient.h>
 #include <chef/platform.h>
+#include <chef/trace.h>
 #include <chef/pkgmgr.h>
 #include <ctype.h>
 #include <stdio.h>
@@ -37,6 +38,9 @@ static void __print_help(void)
     printf("Usage: bakectl init [options]\n");
     printf("\n");
     printf("Options:\n");
+    printf("      --ingredient-layers\n");
+    printf("      The host and build ingredients are mounted as layers by the host, only register\n");
+    printf("      them with the package manager instead of unpacking them\n");
     printf("  -h,  --help\n");
     printf("      Shows this help message\n");
 }
@@ -223,7 +227,9 @@ static int __write_resources(struct __bakelib_context* context)
     return status;
 }
 
-static int __setup_ingredient(struct __bakelib_context* context, struct list* ingredients, const char* hostPath)
+// When the ingredients are mounted as layers by the host, they are already present
+// at hostPath, and only need to be registered with the package manager.
+static int __setup_ingredient(struct __bakelib_context* context, struct list* ingredients, const char* hostPath, int layered)
 {
     struct list_item* i;
     int               status;
@@ -237,6 +243,7 @@ static int __setup_ingredient(struct __bakelib_context* context, struct list* in
         struct recipe_ingredient* ri = (struct recipe_ingredient*)i;
         struct ingredient*        ig;
         const char*               path;
+        struct chef_trace_span    span;
         VLOG_DEBUG("bakectl", "__setup_ingredient: %s\n", ri->name);
 
         status = store_package_path(&(struct store_package) {
@@ -262,11 +269,15 @@ static int __setup_ingredient(struct __bakelib_context* context, struct list* in
             continue;
         }
 
-        status = ingredient_unpack(ig, hostPath, NULL, NULL);
-        if (status) {
-            ingredient_close(ig);
-            VLOG_ERROR("bakectl", "__setup_ingredients: failed to setup %s\n", ri->name);
-            return -1;
+        if (!layered) {
+            chef_trace_begin(&span);
+            status = ingredient_unpack(ig, hostPath, NULL, NULL);
+            chef_trace_end(&span, "bakectl", "unpack %s", ri->name);
+            if (status) {
+                ingredient_close(ig);
+                VLOG_ERROR("bakectl", "__setup_ingredients: failed to setup %s\n", ri->name);
+                return -1;
+            }
         }
         
         if (context->pkg_manager != NULL) {
@@ -296,6 +307,7 @@ static int __setup_toolchains(struct list* ingredients, const char* hostPath)
         struct recipe_ingredient* ri = (struct recipe_ingredient*)i;
         struct ingredient*        ig;
         const char*               path;
+        struct chef_trace_span    span;
 
         status = store_package_path(&(struct store_package) {
             .name = ri->name,
@@ -325,7 +337,9 @@ static int __setup_toolchains(struct list* ingredients, const char* hostPath)
             return -1;
         }
 
+        chef_trace_begin(&span);
         status = ingredient_unpack(ig, &buff[0], NULL, NULL);
+        chef_trace_end(&span, "bakectl", "unpack %s", ri->name);
         if (status) {
             ingredient_close(ig);
             VLOG_ERROR("bakectl", "__setup_toolchains: failed to setup %s\n", ri->name);
@@ -336,48 +350,79 @@ static int __setup_toolchains(struct list* ingredients, const char* hostPath)
     return 0;
 }
 
-static int __setup_ingredients(struct __bakelib_context* context)
+static int __setup_ingredients(struct __bakelib_context* context, int layered, int runtime)
 {
     int status;
-    VLOG_DEBUG("bakectl", "__setup_ingredients()\n");
+    VLOG_DEBUG("bakectl", "__setup_ingredients(layered=%i, runtime=%i)\n", layered, runtime);
 
     VLOG_DEBUG("bakectl", "__setup_ingredients: setting up host ingredients\n");
-    status = __setup_ingredient(context, &context->recipe->environment.host.ingredients, "/");
+    status = __setup_ingredient(context, &context->recipe->environment.host.ingredients, "/", layered);
     if (status) {
         return status;
     }
 
-    VLOG_DEBUG("bakectl", "__setup_ingredients: setting up host toolchains\n");
-    status = __setup_toolchains(&context->recipe->environment.host.ingredients, context->build_toolchains_directory);
-    if (status) {
-        return status;
+    // toolchains are not registered with the package manager, so there
+    // is nothing to do for them when they are mounted
+    if (!layered) {
+        VLOG_DEBUG("bakectl", "__setup_ingredients: setting up host toolchains\n");
+        status = __setup_toolchains(&context->recipe->environment.host.ingredients, context->build_toolchains_directory);
+        if (status) {
+            return status;
+        }
     }
 
     VLOG_DEBUG("bakectl", "__setup_ingredients: setting up build ingredients\n");
-    status = __setup_ingredient(context, &context->recipe->environment.build.ingredients, context->build_ingredients_directory);
+    status = __setup_ingredient(context, &context->recipe->environment.build.ingredients, context->build_ingredients_directory, layered);
     if (status) {
         return status;
     }
 
-    VLOG_DEBUG("bakectl", "__setup_ingredients: setting up runtime ingredients\n");
-    status = __setup_ingredient(context, &context->recipe->environment.runtime.ingredients, context->install_directory);
-    if (status) {
-        return status;
+    // runtime ingredients are never mounted, the install directory is read by
+    // the host when packing, so they are always unpacked into it
+    if (runtime) {
+        VLOG_DEBUG("bakectl", "__setup_ingredients: setting up runtime ingredients\n");
+        status = __setup_ingredient(context, &context->recipe->environment.runtime.ingredients, context->install_directory, 0);
+        if (status) {
+            return status;
+        }
     }
     return 0;
 }
 
-static int __update_ingredients(struct __bakelib_context* context)
+static int __update_ingredients(struct __bakelib_context* context, int layered)
 {
     int status;
-    VLOG_DEBUG("bakectl", "__update_ingredients()\n");
+    VLOG_DEBUG("bakectl", "__update_ingredients(layered=%i)\n", layered);
+
+    // Mounted ingredients only need to be registered, which is cheap enough to
+    // always do. The runtime ingredients are still unpacked once, but under their
+    // own key, so switching back to unpacking the ingredients will still install
+    // the rest of them.
+    if (layered) {
+        int runtime = !recipe_cache_key_bool(context->cache, "setup_ingredients") &&
+            !recipe_cache_key_bool(context->cache, "setup_runtime_ingredients");
+
+        status = __setup_ingredients(context, 1, runtime);
+        if (status || !runtime) {
+            return status;
+        }
+
+        recipe_cache_transaction_begin(context->cache);
+        status = recipe_cache_key_set_bool(context->cache, "setup_runtime_ingredients", 1);
+        if (status) {
+            VLOG_ERROR("bakectl", "__update_ingredients: failed to mark runtime ingredients as done\n");
+            return status;
+        }
+        recipe_cache_transaction_commit(context->cache);
+        return 0;
+    }
 
     if (recipe_cache_key_bool(context->cache, "setup_ingredients")) {
         return 0;
     }
 
     VLOG_TRACE("bakectl", "installing project ingredients\n");
-    status = __setup_ingredients(context);
+    status = __setup_ingredients(context, 0, 1);
     if (status) {
         VLOG_ERROR("bakectl", "__update_ingredients: failed to setup project ingredients\n");
         return status;
@@ -479,6 +524,7 @@ int init_main(int argc, char** argv, struct __bakelib_context* context, struct b
 {
     struct oven_initialize_options ovenOpts = { 0 };
     int                            status;
+    int                            layered = 0;
 
     // handle individual help command
     if (argc > 1) {
@@ -486,6 +532,8 @@ int init_main(int argc, char** argv, struct __bakelib_context* context, struct b
             if (!strcmp(argv[i], "-h") || !strcmp(argv[i], "--help")) {
                 __print_help();
                 return 0;
+            } else if (!strcmp(argv[i], "--ingredient-layers")) {
+                layered = 1;
             }
         }
     }
@@ -527,7 +575,7 @@ int init_main(int argc, char** argv, struct __bakelib_context* context, struct b
         goto cleanup;
     }
 
-    status = __update_ingredients(context);
+    status = __update_ingredients(context, layered);
     if (status) {
         VLOG_ERROR("bakectl", "failed to setup/refresh kitchen ingredients\n");
         goto cleanup;
@@ -0,0 +1,371 @@
+/**
+ * Copyright, Philip Meulengracht
+ *
+ * This program is free software : you can redistribute it and / or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation ? , either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ * 
+ */
+
+#define _GNU_SOURCE // accept4
+#include <errno.h>
+#include <chef/platform.h>
+#include <chef/recipe.h>
+#include <chef/trace.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vlog.h>
+
+#include "agent.h"
+#include "commands.h"
+
+extern int source_main(int argc, char** argv, struct __bakelib_context* context, struct bakectl_command_options* options);
+extern int build_main(int argc, char** argv, struct __bakelib_context* context, struct bakectl_command_options* options);
+extern int clean_main(int argc, char** argv, struct __bakelib_context* context, struct bakectl_command_options* options);
+
+static void __print_help(void)
+{
+    printf("Usage: bakectl serve [options]\n");
+    printf("\n");
+    printf("Starts a long-lived agent that keeps the parsed recipe and build context\n");
+    printf("in memory, and executes source, build and clean requests for steps. Once\n");
+    printf("the agent is running, those commands are forwarded to it.\n");
+    printf("\n");
+    printf("Options:\n");
+    printf("  -f,  --foreground\n");
+    printf("      Do not detach from the calling process\n");
+    printf("  -h,  --help\n");
+    printf("      Shows this help message\n");
+}
+
+#if defined(__linux__)
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+struct __agent_command {
+    const char* name;
+    int (*handler)(int argc, char** argv, struct __bakelib_context* context, struct bakectl_command_options* options);
+};
+
+static struct __agent_command g_agentCommands[] = {
+    { "source", source_main },
+    { "build",  build_main },
+    { "clean",  clean_main },
+};
+
+#define __MAX_ARGUMENTS 64
+
+static int __listen_agent(void)
+{
+    struct sockaddr_un address = { 0 };
+    int                fd;
+
+    fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        VLOG_ERROR("bakectl", "__listen_agent: failed to create socket: %s\n", strerror(errno));
+        return -1;
+    }
+
+    address.sun_family = AF_UNIX;
+    strncpy(&address.sun_path[0], BAKECTL_AGENT_ADDRESS, sizeof(address.sun_path) - 1);
+
+    // the container filesystem is kept between builds, so the socket of the
+    // agent from the previous build may still be there
+    if (unlink(BAKECTL_AGENT_ADDRESS) && errno != ENOENT) {
+        VLOG_ERROR("bakectl", "__listen_agent: failed to remove stale socket: %s\n", strerror(errno));
+        close(fd);
+        return -1;
+    }
+
+    if (bind(fd, (struct sockaddr*)&address, sizeof(address)) || listen(fd, 4)) {
+        VLOG_ERROR("bakectl", "__listen_agent: failed to bind agent socket: %s\n", strerror(errno));
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static int __receive_request(int fd, int fds[3], char** payloadOut, size_t* lengthOut)
+{
+    struct bakectl_agent_header header;
+    struct iovec                iov = { &header, sizeof(header) };
+    union {
+        char           buffer[CMSG_SPACE(sizeof(int) * 3)];
+        struct cmsghdr align;
+    } control;
+    struct msghdr   msg = { 0 };
+    struct cmsghdr* cmsg;
+    char*           payload;
+    ssize_t         bytesRead;
+
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buffer;
+    msg.msg_controllen = sizeof(control.buffer);
+
+    bytesRead = recvmsg(fd, &msg, MSG_WAITALL | MSG_CMSG_CLOEXEC);
+    if (bytesRead != sizeof(header) || header.magic != BAKECTL_AGENT_MAGIC) {
+        VLOG_ERROR("bakectl", "__receive_request: invalid request header\n");
+        return -1;
+    }
+
+    cmsg = CMSG_FIRSTHDR(&msg);
+    if (cmsg == NULL || cmsg->cmsg_type != SCM_RIGHTS || cmsg->cmsg_len != CMSG_LEN(sizeof(int) * 3)) {
+        VLOG_ERROR("bakectl", "__receive_request: request did not carry stdio descriptors\n");
+        return -1;
+    }
+    memcpy(&fds[0], CMSG_DATA(cmsg), sizeof(int) * 3);
+
+    // the payload must be NUL terminated as it is a sequence of strings
+    payload = malloc(header.length + 1);
+    if (payload == NULL) {
+        goto error;
+    }
+
+    bytesRead = recv(fd, payload, header.length, MSG_WAITALL);
+    if (bytesRead != (ssize_t)header.length) {
+        VLOG_ERROR("bakectl", "__receive_request: truncated request\n");
+        free(payload);
+        goto error;
+    }
+    payload[header.length] = '\0';
+
+    *payloadOut = payload;
+    *lengthOut = header.length;
+    return 0;
+
+error:
+    close(fds[0]);
+    close(fds[1]);
+    close(fds[2]);
+    return -1;
+}
+
+static int __split_arguments(char* payload, size_t length, char** argv)
+{
+    int    argc = 0;
+    size_t offset = 0;
+
+    while (offset < length && argc < __MAX_ARGUMENTS - 1) {
+        argv[argc++] = &payload[offset];
+        offset += strlen(&payload[offset]) + 1;
+    }
+    argv[argc] = NULL;
+    return argc;
+}
+
+// The agent only has a single recipe loaded, so requests for any other recipe
+// must not be executed against it.
+static int __matches_recipe(struct __bakelib_context* context, int argc, char** argv)
+{
+    for (int i = 1; i < argc; i++) {
+        if ((!strcmp(argv[i], "-r") || !strcmp(argv[i], "--recipe")) && (i + 1) < argc) {
+            return !strcmp(argv[i + 1], context->recipe_path);
+        }
+    }
+    return 0;
+}
+
+static int __parse_options(int argc, char** argv, struct bakectl_command_options* options)
+{
+    for (int i = 1; i < argc; i++) {
+        if ((!strcmp(argv[i], "-s") || !strcmp(argv[i], "--step")) && (i + 1) < argc) {
+            return recipe_parse_part_step(argv[i + 1], (char**)&options->part, (char**)&options->step);
+        }
+    }
+    return 0;
+}
+
+static int __execute_request(struct __bakelib_context* context, int argc, char** argv)
+{
+    struct bakectl_command_options options = { 0 };
+    struct chef_trace_span         span;
+    int                            status;
+
+    chef_trace_begin(&span);
+    if (!__matches_recipe(context, argc, argv)) {
+        fprintf(stderr, "bakectl: the agent serves recipe %s, which was not requested\n", context->recipe_path);
+        return -1;
+    }
+
+    if (__parse_options(argc, argv, &options)) {
+        fprintf(stderr, "bakectl: failed to parse step options\n");
+        return -1;
+    }
+
+    // restore the working directory in case a previous step changed it
+    if (platform_chdir("/chef/project")) {
+        VLOG_ERROR("bakectl", "__execute_request: failed to switch directory to /chef/project\n");
+        status = -1;
+        goto cleanup;
+    }
+
+    status = -1;
+    for (int i = 0; i < sizeof(g_agentCommands) / sizeof(struct __agent_command); i++) {
+        if (!strcmp(argv[0], g_agentCommands[i].name)) {
+            VLOG_DEBUG("bakectl", "__execute_request: %s %s/%s\n", argv[0],
+                options.part ? options.part : "", options.step ? options.step : "");
+            status = g_agentCommands[i].handler(argc, argv, context, &options);
+            goto cleanup;
+        }
+    }
+    fprintf(stderr, "bakectl: command %s is not supported by the agent\n", argv[0]);
+
+cleanup:
+    chef_trace_end(&span, "bakectl", "agent %s %s", argv[0], options.part ? options.part : "");
+    free((void*)options.part);
+    free((void*)options.step);
+    return status;
+}
+
+// Executes a request with the stdio of the requesting process, so the output is
+// captured by whoever spawned that process.
+static int __serve_request(struct __bakelib_context* context, int client)
+{
+    char*  payload;
+    size_t length;
+    char*  argv[__MAX_ARGUMENTS];
+    int    argc;
+    int    fds[3];
+    int    saved[3];
+    int    status;
+
+    if (__receive_request(client, fds, &payload, &length)) {
+        return -1;
+    }
+
+    argc = __split_arguments(payload, length, &argv[0]);
+
+    fflush(stdout);
+    fflush(stderr);
+    for (int i = 0; i < 3; i++) {
+        saved[i] = dup(i);
+        dup2(fds[i], i);
+    }
+
+    status = argc > 0 ? __execute_request(context, argc, &argv[0]) : -1;
+
+    // the agent lives for the entire build, so spans are handed over per request,
+    // and before the reply so they are in place once the requester continues
+    chef_trace_flush();
+
+    fflush(stdout);
+    fflush(stderr);
+    for (int i = 0; i < 3; i++) {
+        dup2(saved[i], i);
+        close(saved[i]);
+    }
+
+    for (int i = 0; i < 3; i++) {
+        close(fds[i]);
+    }
+    free(payload);
+
+    if (send(client, &status, sizeof(status), MSG_NOSIGNAL) != sizeof(status)) {
+        VLOG_WARNING("bakectl", "__serve_request: failed to reply to client\n");
+    }
+    return 0;
+}
+
+// Detaches the agent from the process that spawned it. The parent exits once the
+// agent is listening, so the spawner can wait for it to be ready.
+static int __detach(void)
+{
+    pid_t pid;
+    int   null;
+
+    pid = fork();
+    if (pid < 0) {
+        return -1;
+    } else if (pid > 0) {
+        _Exit(0);
+    }
+
+    setsid();
+    null = open("/dev/null", O_RDWR);
+    if (null >= 0) {
+        dup2(null, STDIN_FILENO);
+        dup2(null, STDOUT_FILENO);
+        dup2(null, STDERR_FILENO);
+        if (null > STDERR_FILENO) {
+            close(null);
+        }
+    }
+    return 0;
+}
+
+int serve_main(int argc, char** argv, struct __bakelib_context* context, struct bakectl_command_options* options)
+{
+    int foreground = 0;
+    int fd;
+    (void)options;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-h") || !strcmp(argv[i], "--help")) {
+            __print_help();
+            return 0;
+        } else if (!strcmp(argv[i], "-f") || !strcmp(argv[i], "--foreground")) {
+            foreground = 1;
+        }
+    }
+
+    // a broken client must not take the agent down with it
+    signal(SIGPIPE, SIG_IGN);
+
+    fd = __listen_agent();
+    if (fd < 0) {
+        return -1;
+    }
+
+    if (!foreground && __detach()) {
+        VLOG_ERROR("bakectl", "serve_main: failed to detach agent\n");
+        close(fd);
+        return -1;
+    }
+
+    VLOG_DEBUG("bakectl", "serve_main: agent ready\n");
+    for (;;) {
+        int client = accept4(fd, NULL, NULL, SOCK_CLOEXEC);
+        if (client < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            VLOG_ERROR("bakectl", "serve_main: failed to accept client: %s\n", strerror(errno));
+            break;
+        }
+
+        __serve_request(context, client);
+        close(client);
+    }
+
+    close(fd);
+    return 0;
+}
+
+#else
+
+int serve_main(int argc, char** argv, struct __bakelib_context* context, struct bakectl_command_options* options)
+{
+    (void)argc;
+    (void)argv;
+    (void)context;
+    (void)options;
+    fprintf(stderr, "bakectl: serve is not supported on this platform\n");
+    errno = ENOSYS;
+    return -1;
+}
+
+#endif
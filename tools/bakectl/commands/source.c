@@ -20,6 +20,7 @@
 #include <liboven.h>
 #include <chef/bake.h>
 #include <chef/platform.h>
+#include <chef/trace.h>
 #include <ctype.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -28,6 +29,8 @@
 #include <vlog.h>
 
 #include "commands.h"
+#include "gitcache.h"
+#include "urlcache.h"
 
 static void __print_help(void)
 {
@@ -88,11 +91,27 @@ static int __prepare_path(const char* root, const char* relativePath, struct __s
     return status;
 }
 
-static int __prepare_url(const char* root, const char* url)
+static int __prepare_url(const char* root, struct recipe_part_source_url* url, struct __source_options* options)
 {
-    VLOG_DEBUG("bakectl", "__prepare_url(url=%s)\n", url);
-    errno = ENOSYS;
-    return -1;
+    const char* cacheRoot = NULL;
+    int         status;
+    VLOG_DEBUG("bakectl", "__prepare_url(url=%s)\n", url->url);
+
+    // Prefer the source cache when the host has mapped it in, then the url
+    // is only downloaded and extracted the first time it is used
+    if (platform_isdir(BAKECTL_SOURCE_CACHE_PATH) == 0) {
+        cacheRoot = BAKECTL_SOURCE_CACHE_PATH;
+    }
+
+    VLOG_TRACE("bakectl", "Fetching source for %s\n", options->part);
+    status = urlcache_checkout(
+        cacheRoot, url->url, url->sha256,
+        root, (const char* const*)options->envp
+    );
+    if (status) {
+        VLOG_ERROR("bakectl", "__prepare_url: failed to fetch %s\n", url->url);
+    }
+    return status;
 }
 
 static int __prepare_git(const char* root, struct recipe_part_source_git* git, struct __source_options* options)
@@ -107,6 +126,21 @@ static int __prepare_git(const char* root, struct recipe_part_source_git* git, s
         return -1;
     }
 
+    // Prefer the git cache when the host has mapped it in, then only the
+    // missing objects are fetched and the checkout is done locally
+    if (platform_isdir(BAKECTL_GIT_CACHE_PATH) == 0) {
+        VLOG_TRACE("bakectl", "Checking out repository for %s\n", options->part);
+        status = gitcache_checkout(
+            BAKECTL_GIT_CACHE_PATH,
+            git->url, git->branch, git->commit,
+            root, (const char* const*)options->envp
+        );
+        if (status) {
+            VLOG_ERROR("bakectl", "__prepare_git: failed to checkout %s\n", git->url);
+        }
+        return status;
+    }
+
     snprintf(&buffer[0], sizeof(buffer),
         "clone -q %s .",
         git->url
@@ -245,7 +279,7 @@ static int __prepare_source(const char* part, struct recipe_part_source* source,
             status = __prepare_git(sourceRoot, &source->git, options);
         } break;
         case RECIPE_PART_SOURCE_TYPE_URL: {
-            status =__prepare_url(sourceRoot, source->url.url);
+            status = __prepare_url(sourceRoot, &source->url, options);
         } break;
         default:
             errno = ENOSYS;
@@ -273,7 +307,8 @@ static int __source_part(struct recipe* recipe, struct __source_options* options
     VLOG_DEBUG("bakectl", "__source_part(part=%s)\n", options->part);
 
     list_foreach(&recipe->parts, item) {
-        struct recipe_part* part = (struct recipe_part*)item;
+        struct recipe_part*    part = (struct recipe_part*)item;
+        struct chef_trace_span span;
 
         // find the correct recipe part
         if (options->part != NULL && strcmp(part->name, options->part)) {
@@ -287,7 +322,9 @@ static int __source_part(struct recipe* recipe, struct __source_options* options
             break;
         }
         
+        chef_trace_begin(&span);
         status = __prepare_source(part->name, &part->source, options);
+        chef_trace_end(&span, "bakectl", "source %s", part->name);
         oven_recipe_end();
         if (status) {
             VLOG_ERROR("bakectl", "__clean_part: failed to build recipe %s\n", part->name);
@@ -64,12 +64,14 @@ struct __pack_resolve_commands_options {
 };
 
 struct __resolve_options {
-    const char* sysroot;
-    const char* install_root;
-    const char* ingredients_root;
-    const char* platform;
-    const char* base;
-    int         cross_compiling;
+    const char*              sysroot;
+    const char*              install_root;
+    const char*              ingredients_root;
+    const char*              platform;
+    const char*              base;
+    int                      cross_compiling;
+    struct platform_scandir* install_files;
+    struct platform_scandir* ingredient_files;
 };
 
 static int __ascii_equals_ignore_case(const char* a, const char* b)
@@ -134,11 +136,24 @@ static int __verify_commands(struct list* commands, const char* root)
     return 0;
 }
 
+static int __find_dependency_file(struct platform_scandir* files, const char* platform, struct bake_resolve_dependency* dependency)
+{
+    size_t i;
+
+    for (i = 0; i < files->count; i++) {
+        struct platform_scandir_entry* file = &files->entries[i];
+        if (__dependency_name_equals(platform, file->name, dependency->name)) {
+            dependency->path = platform_strdup(file->path);
+            dependency->sub_path = platform_strdup(file->sub_path);
+            return 0;
+        }
+    }
+    return -1;
+}
+
 static int __resolve_dependency_path(struct bake_resolve* resolve, struct bake_resolve_dependency* dependency, struct __resolve_options* options)
 {
-    struct list       files = { 0 };
-    struct list_item* item;
-    int               status;
+    int status;
     VLOG_DEBUG("commands", "__resolve_dependency_path(dep=%s, platform=%s, base=%s, cross=%d)\n",
         dependency && dependency->name ? dependency->name : "(null)",
         options && options->platform ? options->platform : "(null)",
@@ -147,40 +162,16 @@ static int __resolve_dependency_path(struct bake_resolve* resolve, struct bake_r
     );
 
     // priority 1 - check in install path
-    status = platform_getfiles(options->install_root, 1, &files);
-    if (status) {
-        VLOG_ERROR("commands", "resolve: failed to get install file list\n");
-        return -1;
-    }
-
-    list_foreach(&files, item) {
-        struct platform_file_entry* file = (struct platform_file_entry*)item;
-        if (__dependency_name_equals(options->platform, file->name, dependency->name)) {
-            dependency->path = platform_strdup(file->path);
-            dependency->sub_path = platform_strdup(file->sub_path);
-            platform_getfiles_destroy(&files);
-            return 0;
-        }
+    status = __find_dependency_file(options->install_files, options->platform, dependency);
+    if (status == 0) {
+        return 0;
     }
-    platform_getfiles_destroy(&files);
 
     // priority 2 - maybe it comes from build ingredients
-    status = platform_getfiles(options->ingredients_root, 1, &files);
-    if (status) {
-        VLOG_ERROR("commands", "resolve: failed to get install file list\n");
-        return -1;
-    }
-
-    list_foreach(&files, item) {
-        struct platform_file_entry* file = (struct platform_file_entry*)item;
-        if (__dependency_name_equals(options->platform, file->name, dependency->name)) {
-            dependency->path = platform_strdup(file->path);
-            dependency->sub_path = platform_strdup(file->sub_path);
-            platform_getfiles_destroy(&files);
-            return 0;
-        }
+    status = __find_dependency_file(options->ingredient_files, options->platform, dependency);
+    if (status == 0) {
+        return 0;
     }
-    platform_getfiles_destroy(&files);
     
     // priority 3 - invoke platform resolver (if allowed)
     // we cannot do this if we are cross-compiling - we do not
@@ -287,7 +278,12 @@ static int __resolve_pe_dependencies(struct bake_resolve* resolve, struct __reso
     return 0;
 }
 
-static int __resolve_command(struct recipe_pack_command* command, struct list* resolves, struct __pack_resolve_commands_options* options)
+static int __resolve_command(
+    struct recipe_pack_command*             command,
+    struct list*                            resolves,
+    struct __pack_resolve_commands_options* options,
+    struct platform_scandir*                installFiles,
+    struct platform_scandir*                ingredientFiles)
 {
     struct bake_resolve* resolve;
     const char*          path;
@@ -318,7 +314,9 @@ static int __resolve_command(struct recipe_pack_command* command, struct list* r
                 .ingredients_root = options->ingredients_root,
                 .platform = options->platform,
                 .base = options->base,
-                .cross_compiling = options->cross_compiling
+                .cross_compiling = options->cross_compiling,
+                .install_files = installFiles,
+                .ingredient_files = ingredientFiles
             });
         }
     } else if (pe_is_valid(path, &resolve->arch) == 0) {
@@ -330,7 +328,9 @@ static int __resolve_command(struct recipe_pack_command* command, struct list* r
                 .ingredients_root = options->ingredients_root,
                 .platform = options->platform,
                 .base = options->base,
-                .cross_compiling = options->cross_compiling
+                .cross_compiling = options->cross_compiling,
+                .install_files = installFiles,
+                .ingredient_files = ingredientFiles
             });
         }
     } else {
@@ -349,8 +349,10 @@ static int __resolve_command(struct recipe_pack_command* command, struct list* r
 
 static int __resolve_commands(struct list* commands, struct list* resolves, struct __pack_resolve_commands_options* options)
 {
-    struct list_item* item;
-    int               status;
+    struct platform_scandir installFiles = { 0 };
+    struct platform_scandir ingredientFiles = { 0 };
+    struct list_item*       item;
+    int                     status = 0;
     VLOG_DEBUG("commands", "__resolve_commands(count=%d)\n", 
         commands ? (int)commands->count : -1
     );
@@ -359,15 +361,33 @@ static int __resolve_commands(struct list* commands, struct list* resolves, stru
         return 0;
     }
 
+    // Index the install and ingredient trees once, rather than once
+    // for every dependency we try to locate
+    status = platform_scandir(options->install_root, PLATFORM_SCANDIR_RECURSIVE, 0, &installFiles);
+    if (status) {
+        VLOG_ERROR("commands", "resolve: failed to get install file list\n");
+        return -1;
+    }
+
+    status = platform_scandir(options->ingredients_root, PLATFORM_SCANDIR_RECURSIVE, 0, &ingredientFiles);
+    if (status) {
+        VLOG_ERROR("commands", "resolve: failed to get ingredient file list\n");
+        platform_scandir_destroy(&installFiles);
+        return -1;
+    }
+
     // Iterate over all commands and resolve their dependencies
     list_foreach(commands, item) {
         struct recipe_pack_command* command = (struct recipe_pack_command*)item;
-        status = __resolve_command(command, resolves, options);
+        status = __resolve_command(command, resolves, options, &installFiles, &ingredientFiles);
         if (status) {
-            return status;
+            break;
         }
     }
-    return 0;
+
+    platform_scandir_destroy(&installFiles);
+    platform_scandir_destroy(&ingredientFiles);
+    return status;
 }
 
 int pack_resolve_commands(struct list* commands, struct list* resolves, struct __pack_resolve_commands_options* options)
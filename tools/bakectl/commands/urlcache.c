@@ -0,0 +1,511 @@
+/**
+ * Copyright, Philip Meulengracht
+ *
+ * This program is free software : you can redistribute it and / or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation ? , either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ * 
+ */
+
+#define _GNU_SOURCE
+
+#include <ctype.h>
+#include <errno.h>
+#include <chef/platform.h>
+#include <chef/storage/download.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vlog.h>
+
+#include "urlcache.h"
+
+#if defined(__linux__)
+#include <dirent.h>
+#include <fcntl.h>
+#include <openssl/evp.h>
+#include <signal.h>
+#include <spawn.h>
+#include <strings.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char** environ;
+
+#define __SHA256_HEX_LENGTH 65
+
+enum __url_format {
+    __URL_FORMAT_FILE,
+    __URL_FORMAT_ZIP,
+    __URL_FORMAT_TAR
+};
+
+struct __url_kind {
+    const char*       suffix;
+    enum __url_format format;
+    const char*       tar_filter;
+};
+
+// The tar formats are decompressed by tar itself while the download is piped
+// into it. Zip archives keep their index at the end, so they must be downloaded first.
+static const struct __url_kind g_urlKinds[] = {
+    { ".tar.gz",  __URL_FORMAT_TAR, "-z" },
+    { ".tgz",     __URL_FORMAT_TAR, "-z" },
+    { ".tar.xz",  __URL_FORMAT_TAR, "-J" },
+    { ".txz",     __URL_FORMAT_TAR, "-J" },
+    { ".tar.bz2", __URL_FORMAT_TAR, "-j" },
+    { ".tbz2",    __URL_FORMAT_TAR, "-j" },
+    { ".tar.zst", __URL_FORMAT_TAR, "--zstd" },
+    { ".tzst",    __URL_FORMAT_TAR, "--zstd" },
+    { ".tar",     __URL_FORMAT_TAR, NULL },
+    { ".zip",     __URL_FORMAT_ZIP, NULL },
+    { NULL,       __URL_FORMAT_FILE, NULL }
+};
+
+struct __download_stream {
+    EVP_MD_CTX* digest;
+    int         fd;
+};
+
+// Returns the length of the path component of the url, which excludes
+// any query or fragment.
+static size_t __url_path_length(const char* url)
+{
+    return strcspn(url, "?#");
+}
+
+static const struct __url_kind* __url_kind(const char* url)
+{
+    size_t length = __url_path_length(url);
+    int    i;
+
+    for (i = 0; g_urlKinds[i].suffix != NULL; i++) {
+        size_t suffixLength = strlen(g_urlKinds[i].suffix);
+        if (length > suffixLength && 
+            strncasecmp(&url[length - suffixLength], g_urlKinds[i].suffix, suffixLength) == 0) {
+            break;
+        }
+    }
+    return &g_urlKinds[i];
+}
+
+static char* __url_filename(const char* url)
+{
+    size_t length = __url_path_length(url);
+    size_t start = length;
+    char*  name;
+
+    while (start > 0 && url[start - 1] != '/') {
+        start--;
+    }
+
+    if (start == length) {
+        return platform_strdup("download");
+    }
+
+    name = malloc(length - start + 1);
+    if (name == NULL) {
+        return NULL;
+    }
+    memcpy(name, &url[start], length - start);
+    name[length - start] = '\0';
+    return name;
+}
+
+static void __digest_hex(const unsigned char* digest, unsigned int length, char* hex)
+{
+    static const char* characters = "0123456789abcdef";
+    for (unsigned int i = 0; i < length; i++) {
+        hex[i * 2] = characters[digest[i] >> 4];
+        hex[i * 2 + 1] = characters[digest[i] & 0xF];
+    }
+    hex[length * 2] = '\0';
+}
+
+static int __digest_finish(EVP_MD_CTX* ctx, char* hex)
+{
+    unsigned char digest[EVP_MAX_MD_SIZE];
+    unsigned int  digestLength;
+
+    if (EVP_DigestFinal_ex(ctx, &digest[0], &digestLength) != 1) {
+        errno = EIO;
+        return -1;
+    }
+    __digest_hex(&digest[0], digestLength, hex);
+    return 0;
+}
+
+// The cache key is the digest, so identical content is shared regardless of where
+// it was downloaded from
+static void __cache_key(const char* sha256, char* key, size_t keyLength)
+{
+    snprintf(key, keyLength, "sha256-%s", sha256);
+    for (char* c = key; *c; c++) {
+        *c = (char)tolower((unsigned char)*c);
+    }
+}
+
+static int __download_write(const void* data, size_t length, void* context)
+{
+    struct __download_stream* stream = context;
+    const char*               bytes = data;
+
+    if (EVP_DigestUpdate(stream->digest, data, length) != 1) {
+        return -1;
+    }
+
+    while (length > 0) {
+        ssize_t written = write(stream->fd, bytes, length);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            VLOG_ERROR("bakectl", "__download_write: failed to write content: %s\n", strerror(errno));
+            return -1;
+        }
+        bytes += written;
+        length -= (size_t)written;
+    }
+    return 0;
+}
+
+// Starts tar reading an archive from stdin, and returns the write end of the pipe
+static int __tar_start(const char* filter, const char* directory, const char* const* envp, pid_t* pidOut)
+{
+    posix_spawn_file_actions_t actions;
+    const char*                argv[10];
+    int                        argc = 0;
+    int                        fds[2];
+    int                        status;
+
+    argv[argc++] = "tar";
+    argv[argc++] = "-x";
+    if (filter != NULL) {
+        argv[argc++] = filter;
+    }
+    argv[argc++] = "--no-same-owner";
+    argv[argc++] = "-f";
+    argv[argc++] = "-";
+    argv[argc++] = "-C";
+    argv[argc++] = directory;
+    argv[argc] = NULL;
+
+    if (pipe2(&fds[0], O_CLOEXEC)) {
+        return -1;
+    }
+
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_adddup2(&actions, fds[0], STDIN_FILENO);
+    status = posix_spawnp(
+        pidOut, "tar", &actions, NULL,
+        (char* const*)argv,
+        envp != NULL ? (char* const*)envp : environ
+    );
+    posix_spawn_file_actions_destroy(&actions);
+    close(fds[0]);
+    if (status) {
+        VLOG_ERROR("bakectl", "__tar_start: failed to spawn tar: %s\n", strerror(status));
+        close(fds[1]);
+        errno = status;
+        return -1;
+    }
+    return fds[1];
+}
+
+static int __tar_wait(pid_t pid)
+{
+    int status;
+
+    while (waitpid(pid, &status, 0) < 0) {
+        if (errno != EINTR) {
+            return -1;
+        }
+    }
+
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        errno = EIO;
+        return -1;
+    }
+    return 0;
+}
+
+// Downloads the url into the directory, extracting it while it is being
+// received if it is a tar archive. The hex digest of the content is returned in digestOut.
+static int __download(const char* url, const struct __url_kind* kind, const char* directory, const char* const* envp, char* digestOut)
+{
+    struct __download_stream stream = { 0 };
+    struct sigaction         ignore = { 0 };
+    struct sigaction         previous;
+    char*                    filePath = NULL;
+    pid_t                    pid = -1;
+    int                      status;
+
+    stream.digest = EVP_MD_CTX_new();
+    if (stream.digest == NULL || EVP_DigestInit_ex(stream.digest, EVP_sha256(), NULL) != 1) {
+        EVP_MD_CTX_free(stream.digest);
+        errno = ENOMEM;
+        return -1;
+    }
+
+    if (kind->format == __URL_FORMAT_TAR) {
+        stream.fd = __tar_start(kind->tar_filter, directory, envp, &pid);
+    } else {
+        char* name = __url_filename(url);
+        if (name != NULL) {
+            filePath = strpathjoin(directory, name, NULL);
+            free(name);
+        }
+        stream.fd = filePath != NULL ? open(filePath, O_CREAT | O_TRUNC | O_WRONLY | O_CLOEXEC, 0644) : -1;
+    }
+    if (stream.fd < 0) {
+        VLOG_ERROR("bakectl", "__download: failed to prepare the download of %s\n", url);
+        EVP_MD_CTX_free(stream.digest);
+        free(filePath);
+        return -1;
+    }
+
+    // tar may exit early on a corrupt archive, which must fail the
+    // download instead of terminating us
+    ignore.sa_handler = SIG_IGN;
+    sigaction(SIGPIPE, &ignore, &previous);
+
+    VLOG_TRACE("bakectl", "Downloading %s\n", url);
+    status = chef_client_gen_download_stream(url, __download_write, &stream);
+    close(stream.fd);
+    if (pid > 0) {
+        if (__tar_wait(pid) && status == 0) {
+            VLOG_ERROR("bakectl", "__download: failed to extract %s\n", url);
+            status = -1;
+        }
+    }
+    sigaction(SIGPIPE, &previous, NULL);
+
+    if (status == 0) {
+        status = __digest_finish(stream.digest, digestOut);
+    }
+    EVP_MD_CTX_free(stream.digest);
+
+    if (status == 0 && kind->format == __URL_FORMAT_ZIP) {
+        char arguments[PATH_MAX * 2 + 16];
+        snprintf(&arguments[0], sizeof(arguments), "-q %s -d %s", filePath, directory);
+        status = platform_spawn("unzip", &arguments[0], envp, &(struct platform_spawn_options) { 0 });
+        if (status) {
+            VLOG_ERROR("bakectl", "__download: failed to extract %s\n", url);
+            errno = EIO;
+            status = -1;
+        } else {
+            status = platform_unlink(filePath);
+        }
+    }
+    free(filePath);
+    return status;
+}
+
+// Moves the extracted tree into place, unwrapping a single top-level
+// directory which most source archives are packaged with.
+static int __finalize_tree(const char* staging, const char* path)
+{
+    DIR*           dir;
+    struct dirent* entry;
+    char*          single = NULL;
+    int            count = 0;
+    int            status;
+
+    dir = opendir(staging);
+    if (dir == NULL) {
+        return -1;
+    }
+
+    while ((entry = readdir(dir)) != NULL) {
+        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) {
+            continue;
+        }
+        if (++count == 1) {
+            single = strpathjoin(staging, entry->d_name, NULL);
+        }
+    }
+    closedir(dir);
+
+    if (count == 1 && single != NULL) {
+        struct stat st;
+        if (lstat(single, &st) == 0 && S_ISDIR(st.st_mode)) {
+            status = rename(single, path);
+            free(single);
+            if (status == 0) {
+                status = rmdir(staging);
+            }
+            return status;
+        }
+    }
+    free(single);
+    return rename(staging, path);
+}
+
+static int __fetch(const char* url, const char* sha256, const char* staging, const char* path, const char* const* envp)
+{
+    const struct __url_kind* kind = __url_kind(url);
+    char                     digest[__SHA256_HEX_LENGTH];
+    int                      status;
+
+    if (platform_rmdir(staging) && errno != ENOENT) {
+        VLOG_ERROR("bakectl", "__fetch: failed to remove %s\n", staging);
+        return -1;
+    }
+
+    if (platform_mkdir(staging)) {
+        VLOG_ERROR("bakectl", "__fetch: failed to create %s\n", staging);
+        return -1;
+    }
+
+    status = __download(url, kind, staging, envp, &digest[0]);
+    if (status == 0) {
+        if (sha256 != NULL && strcasecmp(sha256, &digest[0]) != 0) {
+            VLOG_ERROR("bakectl", "__fetch: sha256 mismatch for %s, expected %s but got %s\n", url, sha256, &digest[0]);
+            errno = EBADMSG;
+            status = -1;
+        } else if (sha256 == NULL) {
+            VLOG_TRACE("bakectl", "%s has sha256 %s\n", url, &digest[0]);
+        }
+    }
+
+    if (status == 0) {
+        status = __finalize_tree(staging, path);
+        if (status) {
+            VLOG_ERROR("bakectl", "__fetch: failed to move %s into place: %s\n", staging, strerror(errno));
+        }
+    }
+
+    if (status) {
+        int error = errno;
+        platform_rmdir(staging);
+        errno = error;
+    }
+    return status;
+}
+
+static int __entry_lock(const char* entry)
+{
+    char path[PATH_MAX];
+    int  fd;
+
+    snprintf(&path[0], sizeof(path), "%s.lock", entry);
+    fd = open(&path[0], O_CREAT | O_RDWR | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        VLOG_ERROR("bakectl", "__entry_lock: failed to open %s: %s\n", &path[0], strerror(errno));
+        return -1;
+    }
+
+    if (flock(fd, LOCK_EX)) {
+        VLOG_ERROR("bakectl", "__entry_lock: failed to lock %s: %s\n", &path[0], strerror(errno));
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static void __entry_unlock(int fd)
+{
+    if (fd >= 0) {
+        flock(fd, LOCK_UN);
+        close(fd);
+    }
+}
+
+int urlcache_checkout(
+    const char*        cacheRoot,
+    const char*        url,
+    const char*        sha256,
+    const char*        path,
+    const char* const* envp)
+{
+    char entry[PATH_MAX];
+    char staging[PATH_MAX];
+    char key[128];
+    char arguments[PATH_MAX * 2 + 32];
+    int  lock;
+    int  status;
+
+    if (url == NULL || path == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    // Without a cache the archive is extracted straight into place. The same goes
+    // for sources that are not pinned by a digest, as nothing guarantees the url
+    // still serves the content that was cached.
+    if (cacheRoot == NULL || sha256 == NULL) {
+        snprintf(&staging[0], sizeof(staging), "%s.tmp", path);
+        return __fetch(url, sha256, &staging[0], path, envp);
+    }
+
+    __cache_key(sha256, &key[0], sizeof(key));
+    snprintf(&entry[0], sizeof(entry), "%s/%s", cacheRoot, &key[0]);
+    snprintf(&staging[0], sizeof(staging), "%s.tmp", &entry[0]);
+
+    lock = __entry_lock(&entry[0]);
+    if (lock < 0) {
+        return -1;
+    }
+
+    // The extracted tree is never modified once in place, so if it exists
+    // both the download and the extraction can be skipped
+    if (platform_isdir(&entry[0]) == 0) {
+        VLOG_DEBUG("bakectl", "urlcache_checkout: %s found in cache\n", url);
+        status = 0;
+    } else {
+        status = __fetch(url, sha256, &staging[0], &entry[0], envp);
+    }
+    __entry_unlock(lock);
+    if (status) {
+        return -1;
+    }
+
+    // The source is copied out of the cache, as source scripts and builds are
+    // free to modify it. Reflinks make this cheap on filesystems supporting it.
+    status = platform_mkdir(path);
+    if (status) {
+        VLOG_ERROR("bakectl", "urlcache_checkout: failed to create %s\n", path);
+        return -1;
+    }
+
+    snprintf(&arguments[0], sizeof(arguments), "-a --reflink=auto %s/. %s", &entry[0], path);
+    status = platform_spawn("cp", &arguments[0], envp, &(struct platform_spawn_options) { 0 });
+    if (status) {
+        VLOG_ERROR("bakectl", "urlcache_checkout: failed to copy %s into %s\n", &entry[0], path);
+        errno = EIO;
+        return -1;
+    }
+    return 0;
+}
+
+#else
+
+int urlcache_checkout(
+    const char*        cacheRoot,
+    const char*        url,
+    const char*        sha256,
+    const char*        path,
+    const char* const* envp)
+{
+    (void)cacheRoot;
+    (void)url;
+    (void)sha256;
+    (void)path;
+    (void)envp;
+    errno = ENOTSUP;
+    return -1;
+}
+
+#endif
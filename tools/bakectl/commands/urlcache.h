@@ -0,0 +1,49 @@
+/**
+ * Copyright, Philip Meulengracht
+ *
+ * This program is free software : you can redistribute it and / or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation ? , either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ * 
+ */
+
+#ifndef __BAKECTL_URLCACHE_H__
+#define __BAKECTL_URLCACHE_H__
+
+// The source cache is mapped in by the host, and is shared between all
+// build containers. It holds the extracted contents of each downloaded url.
+#define BAKECTL_SOURCE_CACHE_PATH "/chef/cache/sources"
+
+/**
+ * @brief Materializes the contents of the url at the given path. Archives (.tar, .tar.gz,
+ * .tar.xz, .tar.bz2, .tar.zst) are extracted while being downloaded, .zip archives are
+ * extracted after the download, and anything else is stored as a single file. If the
+ * archive has a single top-level directory, its contents are used instead.
+ * When a cache is provided and the source is pinned by a digest, the extracted tree is
+ * stored in the cache keyed by the digest, and later calls only copy it. Sources without
+ * a digest are always downloaded, as the content behind the url may change.
+ * @param cacheRoot The directory holding the extracted trees, may be NULL to extract directly.
+ * @param url The url to download, any scheme supported by libcurl can be used.
+ * @param sha256 The expected hex encoded sha256 of the downloaded content, may be NULL.
+ * @param path The path that receives the contents, it must not exist.
+ * @param envp The environment for the extraction tools.
+ * @return 0 on success, -1 on failure with errno set.
+ */
+extern int urlcache_checkout(
+    const char*        cacheRoot,
+    const char*        url,
+    const char*        sha256,
+    const char*        path,
+    const char* const* envp
+);
+
+#endif //!__BAKECTL_URLCACHE_H__
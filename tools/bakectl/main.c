@@ -21,12 +21,14 @@
 #include <chef/dirs.h>
 #include <chef/platform.h>
 #include <chef/recipe.h>
+#include <chef/trace.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <signal.h>
 #include <vlog.h>
 #include "chef-config.h"
+#include "commands/agent.h"
 #include "commands/commands.h"
 
 extern int init_main(int argc, char** argv, struct __bakelib_context* context, struct bakectl_command_options* options);
@@ -34,18 +36,21 @@ extern int source_main(int argc, char** argv, struct __bakelib_context* context,
 extern int build_main(int argc, char** argv, struct __bakelib_context* context, struct bakectl_command_options* options);
 extern int clean_main(int argc, char** argv, struct __bakelib_context* context, struct bakectl_command_options* options);
 extern int stage_main(int argc, char** argv, struct __bakelib_context* context, struct bakectl_command_options* options);
+extern int serve_main(int argc, char** argv, struct __bakelib_context* context, struct bakectl_command_options* options);
 
 struct command_handler {
     char* name;
     int (*handler)(int argc, char** argv, struct __bakelib_context* context, struct bakectl_command_options* options);
+    int   agent; // whether the command can be forwarded to a running agent
 };
 
 static struct command_handler g_commands[] = {
-    { "init", init_main },
-    { "source", source_main },
-    { "build",  build_main },
-    { "clean",  clean_main },
-    { "stage",  stage_main },
+    { "init",   init_main,   0 },
+    { "source", source_main, 1 },
+    { "build",  build_main,  1 },
+    { "clean",  clean_main,  1 },
+    { "stage",  stage_main,  0 },
+    { "serve",  serve_main,  0 },
 };
 
 static void __print_help(void)
@@ -61,6 +66,7 @@ static void __print_help(void)
     printf("  build       runs the build backend of the specified part and step\n");
     printf("  clean       runs the clean backend of the specified part and step\n");
     printf("  stage       stages the runtime ingredients\n");
+    printf("  serve       starts an agent that executes source/build/clean requests\n");
     printf("\n");
     printf("Options:\n");
     printf("  -r, --recipe\n");
@@ -212,6 +218,7 @@ int main(int argc, char** argv, char** envp)
     int                            logLevel = VLOG_LEVEL_DEBUG;
     struct recipe*                 recipe = NULL;
     struct __bakelib_context*      context = NULL;
+    struct chef_trace_span         span;
     void*                          buffer;
     size_t                         length;
     
@@ -233,6 +240,12 @@ int main(int argc, char** argv, char** envp)
             return -1;
         }
 
+        // If an agent is running in this container, it already has the recipe and
+        // build context loaded, so let it execute the command instead.
+        if (command->agent && bakectl_agent_forward(argc - 1, &argv[1], &status) == 0) {
+            return status;
+        }
+
         if (argc > 2) {
             for (int i = 2; i < argc; i++) {
                 if (!strcmp(argv[i], "-r") || !strcmp(argv[i], "--recipe")) {
@@ -264,6 +277,11 @@ int main(int argc, char** argv, char** envp)
     vlog_initialize((enum vlog_level)logLevel);
     vlog_set_output_options(stdout, VLOG_OUTPUT_OPTION_NODECO);
 
+    // bake requests tracing of the steps through the environment
+    if (chef_trace_enable_from_environment("bakectl")) {
+        VLOG_WARNING("bakectl", "failed to enable tracing\n");
+    }
+
     // initialize the dir library
     status = chef_dirs_initialize(CHEF_DIR_SCOPE_BAKECTL);
     if (status) {
@@ -291,7 +309,7 @@ int main(int argc, char** argv, char** envp)
         goto cleanup;
     }
 
-    status = recipe_parse(buffer, length, &recipe);
+    status = recipe_load(RECIPE_CACHE_DIRECTORY, buffer, length, &recipe);
     free(buffer);
     if (status) {
         VLOG_ERROR("bakectl", "failed to parse recipe\n");
@@ -299,15 +317,20 @@ int main(int argc, char** argv, char** envp)
     }
 
     // create bake context
-    context = __bakelib_context_new(recipe, recipePath, (const char* const*)envp);
+    // the context takes ownership of the recipe path
+    context = __bakelib_context_new(recipe, platform_strdup(recipePath), (const char* const*)envp);
     if (context == NULL) {
         VLOG_ERROR("bakectl", "failed to create bake context\n");
         goto cleanup;
     }
 
+    chef_trace_begin(&span);
     status = command->handler(argc, argv, context, &options);
+    chef_trace_end(&span, "bakectl", "bakectl %s", command->name);
 
 cleanup:
+    chef_trace_flush();
+    chef_trace_disable();
     __bakelib_context_delete(context);
     recipe_destroy(recipe);
     vlog_cleanup();
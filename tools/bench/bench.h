@@ -0,0 +1,144 @@
+/**
+ * Copyright, Philip Meulengracht
+ *
+ * This program is free software : you can redistribute it and / or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation ? , either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ * 
+ */
+
+#ifndef __CHEF_BENCH_H__
+#define __CHEF_BENCH_H__
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdint.h>
+
+struct bench_context {
+    // work_dir is a scratch directory owned by the benchmark run, every case
+    // gets its own sub-directory in here.
+    const char*  work_dir;
+    // seed for the synthetic data generators, the same seed always produces
+    // the same trees and recipes.
+    unsigned int seed;
+    // scale multiplies the size of the synthetic data sets.
+    int          scale;
+};
+
+struct bench_case {
+    const char* name;
+    // unit describes what the items reported by run are, i.e bytes, files.
+    const char* unit;
+    const char* description;
+
+    // setup is invoked once before any timing, and prepares the state needed
+    // by run. The state is passed to all other callbacks.
+    int  (*setup)(struct bench_context* context, const char* directory, void** stateOut);
+    // run is the timed region, it is invoked for both warmup and measured
+    // iterations, and reports the number of items processed.
+    int  (*run)(void* state, uint64_t* itemsOut);
+    // reset is optional, and is invoked between iterations outside of the
+    // timed region to restore state changed by run.
+    int  (*reset)(void* state);
+    void (*teardown)(void* state);
+};
+
+struct bench_result {
+    const struct bench_case* bench;
+    uint64_t*                samples; // nanoseconds
+    int                      sample_count;
+    uint64_t                 items;
+
+    uint64_t min;
+    uint64_t max;
+    uint64_t median;
+    uint64_t p90;
+    double   mean;
+    double   stddev;
+};
+
+/**
+ * @brief Retrieves the list of available benchmark cases.
+ */
+extern const struct bench_case* const* bench_cases(int* countOut);
+
+/**
+ * @brief Returns a monotonic timestamp in nanoseconds.
+ */
+extern uint64_t bench_now(void);
+
+/**
+ * @brief Runs a single benchmark case with the provided number of warmup and
+ * measured iterations, and computes statistics for the measured iterations.
+ * 
+ * @param[In]  context     The benchmark context.
+ * @param[In]  bench       The case to run.
+ * @param[In]  warmup      Number of iterations that are run but not measured.
+ * @param[In]  repetitions Number of measured iterations.
+ * @param[Out] result      The result of the run, must be released with bench_result_destroy.
+ * @return int 0 on success, -1 on failure with errno set.
+ */
+extern int bench_run(struct bench_context* context, const struct bench_case* bench,
+    int warmup, int repetitions, struct bench_result* result);
+extern void bench_result_destroy(struct bench_result* result);
+
+/**
+ * @brief Serializes the results to the provided file in a stable JSON format, so
+ * results from two runs can be compared with a plain diff.
+ */
+extern int bench_write_results(FILE* stream, struct bench_context* context, int warmup,
+    int repetitions, struct bench_result* results, int count);
+
+/**
+ * @brief Deterministic pseudo random generator used by the synthetic data
+ * generators.
+ */
+struct bench_random {
+    uint64_t state;
+};
+
+extern void     bench_random_init(struct bench_random* random, unsigned int seed);
+extern uint32_t bench_random_next(struct bench_random* random);
+extern uint32_t bench_random_range(struct bench_random* random, uint32_t min, uint32_t max);
+
+struct bench_tree_options {
+    int    depth;
+    int    directories; // sub-directories per directory
+    int    files;       // files per directory
+    size_t min_size;
+    size_t max_size;
+    // symlinks controls whether every directory also gets a symlink to one
+    // of its files, only on platforms that support it.
+    int    symlinks;
+};
+
+struct bench_tree_stats {
+    uint64_t files;
+    uint64_t directories;
+    uint64_t bytes;
+};
+
+/**
+ * @brief Generates a synthetic file tree at the given path. The file contents
+ * are a mix of repeated text and random data, to give compressors a realistic
+ * amount of work.
+ */
+extern int bench_synth_tree(const char* path, struct bench_tree_options* options,
+    unsigned int seed, struct bench_tree_stats* statsOut);
+
+/**
+ * @brief Generates a synthetic recipe in YAML with the given number of
+ * parts and steps per part. The returned buffer must be freed.
+ */
+extern char* bench_synth_recipe(int parts, int steps, unsigned int seed, size_t* lengthOut);
+
+#endif //!__CHEF_BENCH_H__
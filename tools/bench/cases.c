@@ -0,0 +1,724 @@
+/**
+ * Copyright, Philip Meulengracht
+ *
+ * This program is free software : you can redistribute it and / or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation ? , either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ * 
+ */
+
+#include <chef/ingredient.h>
+#include <chef/list.h>
+#include <chef/pack.h>
+#include <chef/platform.h>
+#include <chef/recipe.h>
+#include <errno.h>
+#include <inventory.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vafs/vafs.h>
+#include <vafs/directory.h>
+#include <vafs/file.h>
+#include <vlog.h>
+#include "bench.h"
+
+// matches the largest read the kernel issues against a FUSE mount by default
+#define __VAFS_READ_SIZE (128 * 1024)
+
+// ============================================================================
+// Shared helpers
+// ============================================================================
+
+static void __bench_tree_options(struct bench_context* context, struct bench_tree_options* options)
+{
+    options->depth = 2;
+    options->directories = 4;
+    options->files = 8;
+    options->min_size = 1024;
+    options->max_size = 64 * 1024 * (size_t)context->scale;
+    options->symlinks = 1;
+}
+
+static int __bench_pack_tree(const char* input, const char* output, const char* name)
+{
+    struct __pack_options options = { 0 };
+    struct list           commands;
+
+    list_init(&commands);
+
+    options.name = name;
+    options.output_dir = output;
+    options.input_dir = input;
+    options.platform = CHEF_PLATFORM_STR;
+    options.architecture = CHEF_ARCHITECTURE_STR;
+    options.type = CHEF_PACKAGE_TYPE_APPLICATION;
+    options.base = "ubuntu:24";
+    options.summary = "Synthetic benchmark pack";
+    options.description = "Generated by chef-bench";
+    options.version = "1.0.0";
+    options.license = "MIT";
+    options.maintainer = "chef-bench";
+    options.maintainer_email = "bench@chef.local";
+    options.commands = &commands;
+    return bake_pack(&options);
+}
+
+// ============================================================================
+// pack.create: bake_pack of a synthetic tree
+// ============================================================================
+
+struct __pack_state {
+    char*    input;
+    char*    output;
+    char*    pack;
+    uint64_t bytes;
+};
+
+static void __pack_state_delete(struct __pack_state* state)
+{
+    if (state == NULL) {
+        return;
+    }
+    free(state->input);
+    free(state->output);
+    free(state->pack);
+    free(state);
+}
+
+static int __pack_state_new(struct bench_context* context, const char* directory, struct __pack_state** stateOut)
+{
+    struct __pack_state*      state;
+    struct bench_tree_options options;
+    struct bench_tree_stats   stats;
+
+    state = calloc(1, sizeof(struct __pack_state));
+    if (state == NULL) {
+        return -1;
+    }
+
+    state->input = strpathcombine(directory, "input");
+    state->output = strpathcombine(directory, "output");
+    state->pack = strpathcombine(state->output, "bench.pack");
+    if (state->input == NULL || state->output == NULL || state->pack == NULL) {
+        __pack_state_delete(state);
+        return -1;
+    }
+
+    __bench_tree_options(context, &options);
+    if (bench_synth_tree(state->input, &options, context->seed, &stats) || platform_mkdir(state->output)) {
+        __pack_state_delete(state);
+        return -1;
+    }
+
+    state->bytes = stats.bytes;
+    *stateOut = state;
+    return 0;
+}
+
+static int __pack_create_setup(struct bench_context* context, const char* directory, void** stateOut)
+{
+    return __pack_state_new(context, directory, (struct __pack_state**)stateOut);
+}
+
+static int __pack_create_run(void* state, uint64_t* itemsOut)
+{
+    struct __pack_state* pack = state;
+    int                  status;
+
+    status = __bench_pack_tree(pack->input, pack->output, "bench");
+    if (status == 0) {
+        *itemsOut = pack->bytes;
+    }
+    return status;
+}
+
+static int __pack_create_reset(void* state)
+{
+    struct __pack_state* pack = state;
+    if (platform_unlink(pack->pack) && errno != ENOENT) {
+        return -1;
+    }
+    return 0;
+}
+
+static void __pack_teardown(void* state)
+{
+    __pack_state_delete(state);
+}
+
+static const struct bench_case g_bench_pack_create = {
+    "pack.create", "bytes",
+    "bake_pack of a synthetic file tree, including compression",
+    __pack_create_setup, __pack_create_run, __pack_create_reset, __pack_teardown
+};
+
+// ============================================================================
+// pack.unpack: ingredient_open + ingredient_unpack of a synthetic pack
+// ============================================================================
+
+struct __unpack_state {
+    struct __pack_state* pack;
+    char*                target;
+};
+
+static int __pack_unpack_setup(struct bench_context* context, const char* directory, void** stateOut)
+{
+    struct __unpack_state* state;
+
+    state = calloc(1, sizeof(struct __unpack_state));
+    if (state == NULL) {
+        return -1;
+    }
+
+    state->target = strpathcombine(directory, "unpacked");
+    if (state->target == NULL || __pack_state_new(context, directory, &state->pack)) {
+        free(state->target);
+        free(state);
+        return -1;
+    }
+
+    if (__bench_pack_tree(state->pack->input, state->pack->output, "bench")) {
+        __pack_state_delete(state->pack);
+        free(state->target);
+        free(state);
+        return -1;
+    }
+
+    *stateOut = state;
+    return 0;
+}
+
+static int __pack_unpack_run(void* state, uint64_t* itemsOut)
+{
+    struct __unpack_state* unpack = state;
+    struct ingredient*     ingredient;
+    int                    status;
+
+    status = ingredient_open(unpack->pack->pack, &ingredient);
+    if (status) {
+        return status;
+    }
+
+    status = ingredient_unpack(ingredient, unpack->target, NULL, NULL);
+    ingredient_close(ingredient);
+    if (status == 0) {
+        *itemsOut = unpack->pack->bytes;
+    }
+    return status;
+}
+
+static int __pack_unpack_reset(void* state)
+{
+    struct __unpack_state* unpack = state;
+    platform_rmdir(unpack->target);
+    return platform_mkdir(unpack->target);
+}
+
+static void __pack_unpack_teardown(void* state)
+{
+    struct __unpack_state* unpack = state;
+    if (unpack == NULL) {
+        return;
+    }
+    __pack_state_delete(unpack->pack);
+    free(unpack->target);
+    free(unpack);
+}
+
+static const struct bench_case g_bench_pack_unpack = {
+    "pack.unpack", "bytes",
+    "ingredient_open and ingredient_unpack of a synthetic pack",
+    __pack_unpack_setup, __pack_unpack_run, __pack_unpack_reset, __pack_unpack_teardown
+};
+
+// ============================================================================
+// vafs.read: the call sequence the FUSE layer issues when a mounted
+// pack is read sequentially, without requiring FUSE itself
+// ============================================================================
+
+struct __vafs_state {
+    struct __pack_state* pack;
+    struct ingredient*   ingredient;
+    char*                buffer;
+};
+
+static int __vafs_read_setup(struct bench_context* context, const char* directory, void** stateOut)
+{
+    struct __vafs_state* state;
+
+    state = calloc(1, sizeof(struct __vafs_state));
+    if (state == NULL) {
+        return -1;
+    }
+
+    state->buffer = malloc(__VAFS_READ_SIZE);
+    if (state->buffer == NULL || __pack_state_new(context, directory, &state->pack)) {
+        free(state->buffer);
+        free(state);
+        return -1;
+    }
+
+    // ingredient_open takes care of installing the decompression filter
+    if (__bench_pack_tree(state->pack->input, state->pack->output, "bench") ||
+        ingredient_open(state->pack->pack, &state->ingredient)) {
+        __pack_state_delete(state->pack);
+        free(state->buffer);
+        free(state);
+        return -1;
+    }
+
+    *stateOut = state;
+    return 0;
+}
+
+static int __vafs_read_directory(struct __vafs_state* state, const char* path, uint64_t* bytes)
+{
+    struct VaFsDirectoryHandle* directory;
+    struct VaFsEntry            entry;
+    int                         status;
+
+    status = vafs_directory_open(state->ingredient->vafs, path, &directory);
+    if (status) {
+        return status;
+    }
+
+    while (vafs_directory_read(directory, &entry) == 0) {
+        char* entryPath = strpathcombine(path, entry.Name);
+        if (entryPath == NULL) {
+            status = -1;
+            break;
+        }
+
+        if (entry.Type == VaFsEntryType_Directory) {
+            status = __vafs_read_directory(state, entryPath, bytes);
+        } else if (entry.Type == VaFsEntryType_File) {
+            struct VaFsFileHandle* file;
+            long                   offset = 0;
+
+            // open, then seek + read for every request like the FUSE read handler
+            status = vafs_directory_open_file(directory, entry.Name, &file);
+            if (status == 0) {
+                for (;;) {
+                    size_t read;
+                    status = vafs_file_seek(file, offset, SEEK_SET);
+                    if (status) {
+                        break;
+                    }
+                    read = vafs_file_read(file, state->buffer, __VAFS_READ_SIZE);
+                    if (read == 0) {
+                        break;
+                    }
+                    offset += (long)read;
+                }
+                vafs_file_close(file);
+                *bytes += (uint64_t)offset;
+            }
+        }
+        free(entryPath);
+        if (status) {
+            break;
+        }
+    }
+
+    vafs_directory_close(directory);
+    return status;
+}
+
+static int __vafs_read_run(void* state, uint64_t* itemsOut)
+{
+    return __vafs_read_directory(state, "/", itemsOut);
+}
+
+static void __vafs_read_teardown(void* state)
+{
+    struct __vafs_state* vafs = state;
+    if (vafs == NULL) {
+        return;
+    }
+    ingredient_close(vafs->ingredient);
+    __pack_state_delete(vafs->pack);
+    free(vafs->buffer);
+    free(vafs);
+}
+
+static const struct bench_case g_bench_vafs_read = {
+    "vafs.read", "bytes",
+    "sequential 128K seek+read of every file in a pack, as served through FUSE",
+    __vafs_read_setup, __vafs_read_run, NULL, __vafs_read_teardown
+};
+
+// ============================================================================
+// recipe.parse: parsing of a large synthetic recipe
+// ============================================================================
+
+#define __RECIPE_PARSES_PER_RUN 50
+
+struct __recipe_state {
+    char*  yaml;
+    size_t length;
+    char*  cache;
+};
+
+static int __recipe_parse_setup(struct bench_context* context, const char* directory, void** stateOut)
+{
+    struct __recipe_state* state;
+
+    state = calloc(1, sizeof(struct __recipe_state));
+    if (state == NULL) {
+        return -1;
+    }
+
+    state->yaml = bench_synth_recipe(16 * context->scale, 6, context->seed, &state->length);
+    if (state->yaml == NULL) {
+        free(state);
+        return -1;
+    }
+
+    *stateOut = state;
+    return 0;
+}
+
+static int __recipe_parse_run(void* state, uint64_t* itemsOut)
+{
+    struct __recipe_state* recipe = state;
+
+    for (int i = 0; i < __RECIPE_PARSES_PER_RUN; i++) {
+        struct recipe* parsed;
+        int            status;
+
+        status = recipe_parse(recipe->yaml, recipe->length, &parsed);
+        if (status) {
+            return status;
+        }
+        recipe_destroy(parsed);
+    }
+    *itemsOut = __RECIPE_PARSES_PER_RUN;
+    return 0;
+}
+
+static void __recipe_parse_teardown(void* state)
+{
+    struct __recipe_state* recipe = state;
+    if (recipe == NULL) {
+        return;
+    }
+    free(recipe->yaml);
+    free(recipe->cache);
+    free(recipe);
+}
+
+static const struct bench_case g_bench_recipe_parse = {
+    "recipe.parse", "recipes",
+    "recipe_parse and recipe_destroy of a synthetic multi-part recipe",
+    __recipe_parse_setup, __recipe_parse_run, NULL, __recipe_parse_teardown
+};
+
+static int __recipe_load_setup(struct bench_context* context, const char* directory, void** stateOut)
+{
+    struct __recipe_state* state;
+    struct recipe*         loaded;
+    int                    status;
+
+    status = __recipe_parse_setup(context, directory, (void**)&state);
+    if (status) {
+        return status;
+    }
+
+    state->cache = strpathcombine(directory, "recipes");
+    if (state->cache == NULL) {
+        __recipe_parse_teardown(state);
+        return -1;
+    }
+
+    // the first load parses the yaml and stores the compiled recipe
+    status = recipe_load(state->cache, state->yaml, state->length, &loaded);
+    if (status) {
+        __recipe_parse_teardown(state);
+        return status;
+    }
+    recipe_destroy(loaded);
+
+    *stateOut = state;
+    return 0;
+}
+
+static int __recipe_load_run(void* state, uint64_t* itemsOut)
+{
+    struct __recipe_state* recipe = state;
+
+    for (int i = 0; i < __RECIPE_PARSES_PER_RUN; i++) {
+        struct recipe* loaded;
+        int            status;
+
+        status = recipe_load(recipe->cache, recipe->yaml, recipe->length, &loaded);
+        if (status) {
+            return status;
+        }
+        recipe_destroy(loaded);
+    }
+    *itemsOut = __RECIPE_PARSES_PER_RUN;
+    return 0;
+}
+
+static const struct bench_case g_bench_recipe_load = {
+    "recipe.load", "recipes",
+    "recipe_load and recipe_destroy of the same recipe from the compiled recipe cache",
+    __recipe_load_setup, __recipe_load_run, NULL, __recipe_parse_teardown
+};
+
+// ============================================================================
+// files.getfiles / files.scandir: directory enumeration
+// ============================================================================
+
+static int __files_setup(struct bench_context* context, const char* directory, void** stateOut)
+{
+    struct bench_tree_options options;
+    char*                     input;
+
+    input = strpathcombine(directory, "tree");
+    if (input == NULL) {
+        return -1;
+    }
+
+    // a wide tree of small files, enumeration cost is what matters here
+    options.depth = 3;
+    options.directories = 6;
+    options.files = 12 * context->scale;
+    options.min_size = 0;
+    options.max_size = 256;
+    options.symlinks = 1;
+    if (bench_synth_tree(input, &options, context->seed, NULL)) {
+        free(input);
+        return -1;
+    }
+
+    *stateOut = input;
+    return 0;
+}
+
+static int __files_getfiles_run(void* state, uint64_t* itemsOut)
+{
+    struct list files;
+    int         status;
+
+    list_init(&files);
+    status = platform_getfiles(state, 1, &files);
+    if (status == 0) {
+        *itemsOut = (uint64_t)files.count;
+    }
+    platform_getfiles_destroy(&files);
+    return status;
+}
+
+static int __files_scandir_run(void* state, uint64_t* itemsOut)
+{
+    struct platform_scandir scan;
+    int                     status;
+
+    status = platform_scandir(state, PLATFORM_SCANDIR_RECURSIVE | PLATFORM_SCANDIR_STAT, 0, &scan);
+    if (status) {
+        return status;
+    }
+    *itemsOut = (uint64_t)scan.count;
+    platform_scandir_destroy(&scan);
+    return 0;
+}
+
+static void __files_teardown(void* state)
+{
+    free(state);
+}
+
+static const struct bench_case g_bench_files_getfiles = {
+    "files.getfiles", "files",
+    "recursive platform_getfiles of a wide synthetic tree",
+    __files_setup, __files_getfiles_run, NULL, __files_teardown
+};
+
+static const struct bench_case g_bench_files_scandir = {
+    "files.scandir", "files",
+    "recursive platform_scandir with stat of a wide synthetic tree",
+    __files_setup, __files_scandir_run, NULL, __files_teardown
+};
+
+// ============================================================================
+// spawn.capture: line capture of a chatty child process
+// ============================================================================
+
+#if defined(__linux__) || defined(__unix__)
+#define __SPAWN_LINES 50000
+
+static void __spawn_line(const char* line, size_t length, enum platform_spawn_output_type type, void* context)
+{
+    (void)line;
+    (void)length;
+    (void)type;
+    (*(uint64_t*)context)++;
+}
+
+static int __spawn_setup(struct bench_context* context, const char* directory, void** stateOut)
+{
+    char* arguments = malloc(128);
+    if (arguments == NULL) {
+        return -1;
+    }
+    snprintf(arguments, 128, "-c \"yes chef-bench-output-line | head -n %d\"", __SPAWN_LINES * context->scale);
+    *stateOut = arguments;
+    return 0;
+}
+
+static int __spawn_run(void* state, uint64_t* itemsOut)
+{
+    struct platform_spawn_options options = { 0 };
+    uint64_t                      lines = 0;
+    int                           status;
+
+    options.line_handler = __spawn_line;
+    options.line_context = &lines;
+    status = platform_spawn("/bin/sh", state, NULL, &options);
+    if (status == 0) {
+        *itemsOut = lines;
+    }
+    return status;
+}
+
+static void __spawn_teardown(void* state)
+{
+    free(state);
+}
+
+static const struct bench_case g_bench_spawn_capture = {
+    "spawn.capture", "lines",
+    "platform_spawn with line capture of a child producing many lines",
+    __spawn_setup, __spawn_run, NULL, __spawn_teardown
+};
+#endif
+
+// ============================================================================
+// store.inventory: loading and lookups in a populated inventory
+// ============================================================================
+
+struct __inventory_state {
+    char* path;
+    int   packs;
+};
+
+static int __inventory_setup(struct bench_context* context, const char* directory, void** stateOut)
+{
+    struct __inventory_state* state;
+    struct store_inventory*   inventory;
+    int                       status;
+
+    state = calloc(1, sizeof(struct __inventory_state));
+    if (state == NULL) {
+        return -1;
+    }
+    state->path = platform_strdup(directory);
+    state->packs = 500 * context->scale;
+
+    status = inventory_load(state->path, &inventory);
+    if (status) {
+        free(state->path);
+        free(state);
+        return -1;
+    }
+
+    for (int i = 0; i < state->packs && status == 0; i++) {
+        struct store_inventory_pack* pack;
+        char                         name[64];
+        char                         path[128];
+
+        snprintf(&name[0], sizeof(name), "package-%d", i / 4);
+        snprintf(&path[0], sizeof(path), "/var/chef/store/package-%d-%d.pack", i / 4, i % 4);
+        status = inventory_add(inventory, &path[0], "bench", &name[0],
+            CHEF_PLATFORM_STR, CHEF_ARCHITECTURE_STR, "stable", (i % 4) + 1, &pack);
+    }
+
+    if (status == 0) {
+        status = inventory_save(inventory);
+    }
+    inventory_free(inventory);
+    if (status) {
+        free(state->path);
+        free(state);
+        return -1;
+    }
+
+    *stateOut = state;
+    return 0;
+}
+
+static int __inventory_run(void* state, uint64_t* itemsOut)
+{
+    struct __inventory_state* inventoryState = state;
+    struct store_inventory*   inventory;
+    int                       status;
+
+    status = inventory_load(inventoryState->path, &inventory);
+    if (status) {
+        return status;
+    }
+
+    for (int i = 0; i < inventoryState->packs; i++) {
+        struct store_inventory_pack* pack;
+        char                         name[64];
+
+        snprintf(&name[0], sizeof(name), "package-%d", i / 4);
+        status = inventory_get_pack(inventory, "bench", &name[0],
+            CHEF_PLATFORM_STR, CHEF_ARCHITECTURE_STR, "stable", (i % 4) + 1, &pack);
+        if (status) {
+            break;
+        }
+    }
+    inventory_free(inventory);
+    if (status == 0) {
+        *itemsOut = (uint64_t)inventoryState->packs;
+    }
+    return status;
+}
+
+static void __inventory_teardown(void* state)
+{
+    struct __inventory_state* inventory = state;
+    if (inventory == NULL) {
+        return;
+    }
+    free(inventory->path);
+    free(inventory);
+}
+
+static const struct bench_case g_bench_store_inventory = {
+    "store.inventory", "lookups",
+    "inventory_load and a lookup of every pack in a populated inventory",
+    __inventory_setup, __inventory_run, NULL, __inventory_teardown
+};
+
+static const struct bench_case* const g_cases[] = {
+    &g_bench_pack_create,
+    &g_bench_pack_unpack,
+    &g_bench_vafs_read,
+    &g_bench_recipe_parse,
+    &g_bench_recipe_load,
+    &g_bench_files_getfiles,
+    &g_bench_files_scandir,
+#if defined(__linux__) || defined(__unix__)
+    &g_bench_spawn_capture,
+#endif
+    &g_bench_store_inventory
+};
+
+const struct bench_case* const* bench_cases(int* countOut)
+{
+    *countOut = (int)(sizeof(g_cases) / sizeof(g_cases[0]));
+    return &g_cases[0];
+}
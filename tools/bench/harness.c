@@ -0,0 +1,280 @@
+/**
+ * Copyright, Philip Meulengracht
+ *
+ * This program is free software : you can redistribute it and / or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation ? , either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ * 
+ */
+
+#include <chef/platform.h>
+#include <errno.h>
+#include <jansson.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <vlog.h>
+#include "chef-config.h"
+#include "bench.h"
+
+uint64_t bench_now(void)
+{
+    struct timespec ts;
+#if defined(CLOCK_MONOTONIC)
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+#else
+    timespec_get(&ts, TIME_UTC);
+#endif
+    return ((uint64_t)ts.tv_sec * 1000000000ULL) + (uint64_t)ts.tv_nsec;
+}
+
+static int __compare_u64(const void* lh, const void* rh)
+{
+    uint64_t a = *(const uint64_t*)lh;
+    uint64_t b = *(const uint64_t*)rh;
+    return (a > b) - (a < b);
+}
+
+static void __compute_stats(struct bench_result* result)
+{
+    uint64_t* sorted;
+    double    sum = 0.0;
+    double    variance = 0.0;
+    int       count = result->sample_count;
+
+    if (count == 0) {
+        return;
+    }
+
+    sorted = malloc(sizeof(uint64_t) * count);
+    if (sorted == NULL) {
+        return;
+    }
+    memcpy(sorted, result->samples, sizeof(uint64_t) * count);
+    qsort(sorted, count, sizeof(uint64_t), __compare_u64);
+
+    for (int i = 0; i < count; i++) {
+        sum += (double)sorted[i];
+    }
+    result->mean = sum / count;
+
+    for (int i = 0; i < count; i++) {
+        double diff = (double)sorted[i] - result->mean;
+        variance += diff * diff;
+    }
+    result->stddev = count > 1 ? sqrt(variance / (count - 1)) : 0.0;
+
+    result->min = sorted[0];
+    result->max = sorted[count - 1];
+    if (count & 1) {
+        result->median = sorted[count / 2];
+    } else {
+        result->median = (sorted[(count / 2) - 1] + sorted[count / 2]) / 2;
+    }
+    // nearest-rank percentile
+    result->p90 = sorted[(int)ceil(0.9 * count) - 1];
+    free(sorted);
+}
+
+static int __run_once(const struct bench_case* bench, void* state, uint64_t* elapsedOut, uint64_t* itemsOut)
+{
+    uint64_t start, end;
+    int      status;
+
+    if (bench->reset != NULL) {
+        status = bench->reset(state);
+        if (status) {
+            VLOG_ERROR("bench", "%s: failed to reset state\n", bench->name);
+            return status;
+        }
+    }
+
+    *itemsOut = 0;
+    start = bench_now();
+    status = bench->run(state, itemsOut);
+    end = bench_now();
+    if (status) {
+        VLOG_ERROR("bench", "%s: iteration failed: %s\n", bench->name, strerror(errno));
+        return status;
+    }
+    *elapsedOut = end - start;
+    return 0;
+}
+
+int bench_run(struct bench_context* context, const struct bench_case* bench,
+    int warmup, int repetitions, struct bench_result* result)
+{
+    char*    directory;
+    void*    state = NULL;
+    uint64_t elapsed;
+    uint64_t items;
+    int      status;
+
+    if (context == NULL || bench == NULL || result == NULL || repetitions <= 0) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    memset(result, 0, sizeof(struct bench_result));
+    result->bench = bench;
+    result->samples = calloc(repetitions, sizeof(uint64_t));
+    if (result->samples == NULL) {
+        return -1;
+    }
+
+    directory = strpathcombine(context->work_dir, bench->name);
+    if (directory == NULL) {
+        return -1;
+    }
+
+    // always start from a clean directory, the synthetic data is generated
+    // by the setup of each case
+    platform_rmdir(directory);
+    status = platform_mkdir(directory);
+    if (status) {
+        VLOG_ERROR("bench", "%s: failed to create %s\n", bench->name, directory);
+        free(directory);
+        return -1;
+    }
+
+    status = bench->setup(context, directory, &state);
+    if (status) {
+        VLOG_ERROR("bench", "%s: setup failed: %s\n", bench->name, strerror(errno));
+        goto cleanup;
+    }
+
+    for (int i = 0; i < warmup; i++) {
+        status = __run_once(bench, state, &elapsed, &items);
+        if (status) {
+            goto cleanup;
+        }
+    }
+
+    for (int i = 0; i < repetitions; i++) {
+        status = __run_once(bench, state, &elapsed, &items);
+        if (status) {
+            goto cleanup;
+        }
+        result->samples[i] = elapsed;
+        result->sample_count++;
+        result->items = items;
+    }
+    __compute_stats(result);
+
+cleanup:
+    if (bench->teardown != NULL) {
+        bench->teardown(state);
+    }
+    platform_rmdir(directory);
+    free(directory);
+    return status;
+}
+
+void bench_result_destroy(struct bench_result* result)
+{
+    if (result == NULL) {
+        return;
+    }
+    free(result->samples);
+    result->samples = NULL;
+}
+
+static json_t* __serialize_result(struct bench_result* result)
+{
+    json_t* root;
+    json_t* samples;
+    double  throughput = 0.0;
+
+    root = json_object();
+    if (root == NULL) {
+        return NULL;
+    }
+
+    samples = json_array();
+    if (samples == NULL) {
+        json_decref(root);
+        return NULL;
+    }
+
+    for (int i = 0; i < result->sample_count; i++) {
+        json_array_append_new(samples, json_integer((json_int_t)result->samples[i]));
+    }
+
+    if (result->median != 0) {
+        throughput = ((double)result->items * 1000000000.0) / (double)result->median;
+    }
+
+    json_object_set_new(root, "name", json_string(result->bench->name));
+    json_object_set_new(root, "unit", json_string(result->bench->unit));
+    json_object_set_new(root, "items", json_integer((json_int_t)result->items));
+    json_object_set_new(root, "min_ns", json_integer((json_int_t)result->min));
+    json_object_set_new(root, "max_ns", json_integer((json_int_t)result->max));
+    json_object_set_new(root, "median_ns", json_integer((json_int_t)result->median));
+    json_object_set_new(root, "p90_ns", json_integer((json_int_t)result->p90));
+    json_object_set_new(root, "mean_ns", json_real(result->mean));
+    json_object_set_new(root, "stddev_ns", json_real(result->stddev));
+    json_object_set_new(root, "items_per_second", json_real(throughput));
+    json_object_set_new(root, "samples_ns", samples);
+    return root;
+}
+
+int bench_write_results(FILE* stream, struct bench_context* context, int warmup,
+    int repetitions, struct bench_result* results, int count)
+{
+    json_t* root;
+    json_t* config;
+    json_t* benchmarks;
+    int     status;
+
+    root = json_object();
+    config = json_object();
+    benchmarks = json_array();
+    if (root == NULL || config == NULL || benchmarks == NULL) {
+        json_decref(root);
+        json_decref(config);
+        json_decref(benchmarks);
+        errno = ENOMEM;
+        return -1;
+    }
+
+    json_object_set_new(config, "warmup", json_integer(warmup));
+    json_object_set_new(config, "repetitions", json_integer(repetitions));
+    json_object_set_new(config, "scale", json_integer(context->scale));
+    json_object_set_new(config, "seed", json_integer(context->seed));
+
+    for (int i = 0; i < count; i++) {
+        json_t* result = __serialize_result(&results[i]);
+        if (result == NULL) {
+            json_decref(root);
+            json_decref(config);
+            json_decref(benchmarks);
+            errno = ENOMEM;
+            return -1;
+        }
+        json_array_append_new(benchmarks, result);
+    }
+
+    json_object_set_new(root, "schema", json_integer(1));
+    json_object_set_new(root, "version", json_string(PROJECT_VER));
+    json_object_set_new(root, "platform", json_string(CHEF_PLATFORM_STR));
+    json_object_set_new(root, "architecture", json_string(CHEF_ARCHITECTURE_STR));
+    json_object_set_new(root, "config", config);
+    json_object_set_new(root, "benchmarks", benchmarks);
+
+    status = json_dumpf(root, stream, JSON_INDENT(2) | JSON_PRESERVE_ORDER);
+    if (status == 0) {
+        fputc('\n', stream);
+    }
+    json_decref(root);
+    return status;
+}
@@ -0,0 +1,251 @@
+/**
+ * Copyright, Philip Meulengracht
+ *
+ * This program is free software : you can redistribute it and / or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation ? , either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ * 
+ */
+
+#include <chef/platform.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vlog.h>
+#include "chef-config.h"
+#include "bench.h"
+
+static void __print_help(void)
+{
+    printf("Usage: chef-bench [options] [filter...]\n");
+    printf("\n");
+    printf("Runs the chef benchmark suite against synthetic data generated locally. No network\n");
+    printf("access or containers are required. If one or more filters are given, only cases whose\n");
+    printf("name starts with one of the filters are run, i.e 'pack' or 'files.scandir'.\n");
+    printf("\n");
+    printf("Options:\n");
+    printf("  -o, --output <file>\n");
+    printf("      Write the results as JSON to the given file, default is stdout\n");
+    printf("  -w, --warmup <count>\n");
+    printf("      Number of untimed iterations before measuring, default is 2\n");
+    printf("  -r, --repetitions <count>\n");
+    printf("      Number of measured iterations, default is 10\n");
+    printf("  -s, --scale <factor>\n");
+    printf("      Multiplies the size of the synthetic data sets, default is 1\n");
+    printf("      --seed <seed>\n");
+    printf("      Seed for the synthetic data generators, default is 1\n");
+    printf("      --work-dir <path>\n");
+    printf("      Scratch directory for synthetic data, default is a temporary directory\n");
+    printf("  -l, --list\n");
+    printf("      List the available benchmarks\n");
+    printf("  -h, --help\n");
+    printf("      Print this help message\n");
+    printf("  -v, --version\n");
+    printf("      Print the version of chef-bench\n");
+}
+
+static int __parse_count(const char* name, const char* value, int minimum, int* valueOut)
+{
+    char* end;
+    long  parsed;
+
+    if (value == NULL) {
+        fprintf(stderr, "chef-bench: %s requires a value\n", name);
+        return -1;
+    }
+
+    errno = 0;
+    parsed = strtol(value, &end, 10);
+    if (errno || *end != '\0' || parsed < minimum || parsed > 1000000) {
+        fprintf(stderr, "chef-bench: invalid value for %s: %s\n", name, value);
+        return -1;
+    }
+    *valueOut = (int)parsed;
+    return 0;
+}
+
+static int __matches_filters(const char* name, char** filters, int filterCount)
+{
+    if (filterCount == 0) {
+        return 1;
+    }
+
+    for (int i = 0; i < filterCount; i++) {
+        if (strncmp(name, filters[i], strlen(filters[i])) == 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int main(int argc, char** argv, char** envp)
+{
+    const struct bench_case* const* cases;
+    struct bench_context            context = { 0 };
+    struct bench_result*            results;
+    const char*                     outputPath = NULL;
+    char*                           workDir = NULL;
+    char*                           tmpDir = NULL;
+    char**                          filters;
+    int                             filterCount = 0;
+    int                             caseCount;
+    int                             resultCount = 0;
+    int                             warmup = 2;
+    int                             repetitions = 10;
+    int                             seed = 1;
+    int                             status = 0;
+    FILE*                           output = stdout;
+
+    context.scale = 1;
+    cases = bench_cases(&caseCount);
+
+    filters = calloc(argc, sizeof(char*));
+    results = calloc(caseCount, sizeof(struct bench_result));
+    if (filters == NULL || results == NULL) {
+        fprintf(stderr, "chef-bench: out of memory\n");
+        return -1;
+    }
+
+    for (int i = 1; i < argc; i++) {
+        const char* value = (i + 1) < argc ? argv[i + 1] : NULL;
+
+        if (!strcmp(argv[i], "-h") || !strcmp(argv[i], "--help")) {
+            __print_help();
+            return 0;
+        } else if (!strcmp(argv[i], "-v") || !strcmp(argv[i], "--version")) {
+            printf("chef-bench: version " PROJECT_VER "\n");
+            return 0;
+        } else if (!strcmp(argv[i], "-l") || !strcmp(argv[i], "--list")) {
+            for (int j = 0; j < caseCount; j++) {
+                printf("%-18s %s\n", cases[j]->name, cases[j]->description);
+            }
+            return 0;
+        } else if (!strcmp(argv[i], "-o") || !strcmp(argv[i], "--output")) {
+            if (value == NULL) {
+                fprintf(stderr, "chef-bench: %s requires a value\n", argv[i]);
+                return -1;
+            }
+            outputPath = value;
+            i++;
+        } else if (!strcmp(argv[i], "-w") || !strcmp(argv[i], "--warmup")) {
+            if (__parse_count(argv[i], value, 0, &warmup)) {
+                return -1;
+            }
+            i++;
+        } else if (!strcmp(argv[i], "-r") || !strcmp(argv[i], "--repetitions")) {
+            if (__parse_count(argv[i], value, 1, &repetitions)) {
+                return -1;
+            }
+            i++;
+        } else if (!strcmp(argv[i], "-s") || !strcmp(argv[i], "--scale")) {
+            if (__parse_count(argv[i], value, 1, &context.scale)) {
+                return -1;
+            }
+            i++;
+        } else if (!strcmp(argv[i], "--seed")) {
+            if (__parse_count(argv[i], value, 0, &seed)) {
+                return -1;
+            }
+            i++;
+        } else if (!strcmp(argv[i], "--work-dir")) {
+            if (value == NULL) {
+                fprintf(stderr, "chef-bench: %s requires a value\n", argv[i]);
+                return -1;
+            }
+            workDir = platform_strdup(value);
+            i++;
+        } else if (argv[i][0] == '-') {
+            fprintf(stderr, "chef-bench: unknown option %s\n", argv[i]);
+            return -1;
+        } else {
+            filters[filterCount++] = argv[i];
+        }
+    }
+
+    if (workDir == NULL) {
+        tmpDir = platform_tmpdir();
+        if (tmpDir == NULL) {
+            fprintf(stderr, "chef-bench: failed to create temporary directory\n");
+            return -1;
+        }
+        workDir = strpathcombine(tmpDir, "chef-bench");
+        if (workDir == NULL) {
+            fprintf(stderr, "chef-bench: out of memory\n");
+            return -1;
+        }
+    }
+
+    context.work_dir = workDir;
+    context.seed = (unsigned int)seed;
+
+    // only errors are of interest, anything else would disturb the measurements,
+    // and stdout is reserved for the results
+    vlog_initialize(VLOG_LEVEL_ERROR);
+    vlog_remove_output(stdout);
+    vlog_add_output(stderr, 0);
+
+    if (platform_mkdir(workDir)) {
+        fprintf(stderr, "chef-bench: failed to create work directory %s\n", workDir);
+        status = -1;
+        goto cleanup;
+    }
+
+    for (int i = 0; i < caseCount; i++) {
+        if (!__matches_filters(cases[i]->name, filters, filterCount)) {
+            continue;
+        }
+
+        fprintf(stderr, "chef-bench: running %s\n", cases[i]->name);
+        status = bench_run(&context, cases[i], warmup, repetitions, &results[resultCount]);
+        if (status) {
+            fprintf(stderr, "chef-bench: %s failed\n", cases[i]->name);
+            bench_result_destroy(&results[resultCount]);
+            goto cleanup;
+        }
+        resultCount++;
+    }
+
+    if (resultCount == 0) {
+        fprintf(stderr, "chef-bench: no benchmarks matched\n");
+        status = -1;
+        goto cleanup;
+    }
+
+    if (outputPath != NULL) {
+        output = fopen(outputPath, "w");
+        if (output == NULL) {
+            fprintf(stderr, "chef-bench: failed to open %s: %s\n", outputPath, strerror(errno));
+            status = -1;
+            goto cleanup;
+        }
+    }
+
+    status = bench_write_results(output, &context, warmup, repetitions, results, resultCount);
+    if (output != stdout) {
+        fclose(output);
+    }
+
+cleanup:
+    for (int i = 0; i < resultCount; i++) {
+        bench_result_destroy(&results[i]);
+    }
+    free(results);
+    free(filters);
+    free(workDir);
+    if (tmpDir != NULL) {
+        platform_rmdir(tmpDir);
+        free(tmpDir);
+    }
+    vlog_cleanup();
+    return status;
+}
@@ -0,0 +1,323 @@
+/**
+ * Copyright, Philip Meulengracht
+ *
+ * This program is free software : you can redistribute it and / or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation ? , either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ * 
+ */
+
+#include <chef/platform.h>
+#include <errno.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vlog.h>
+#include "bench.h"
+
+static const char* g_words[] = {
+    "chef", "recipe", "ingredient", "pack", "build", "source", "oven", "kitchen",
+    "step", "generate", "install", "library", "binary", "include", "runtime", "store"
+};
+
+void bench_random_init(struct bench_random* random, unsigned int seed)
+{
+    // splitmix the seed, so seeds close to each other still give
+    // unrelated sequences, and the state is never zero
+    uint64_t z = (uint64_t)seed + 0x9E3779B97F4A7C15ULL;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    random->state = (z ^ (z >> 31)) | 1;
+}
+
+uint32_t bench_random_next(struct bench_random* random)
+{
+    // xorshift64*
+    uint64_t x = random->state;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    random->state = x;
+    return (uint32_t)((x * 0x2545F4914F6CDD1DULL) >> 32);
+}
+
+uint32_t bench_random_range(struct bench_random* random, uint32_t min, uint32_t max)
+{
+    if (max <= min) {
+        return min;
+    }
+    return min + (bench_random_next(random) % (max - min + 1));
+}
+
+static int __write_file(const char* path, size_t size, struct bench_random* random)
+{
+    char   buffer[4096];
+    FILE*  file;
+    size_t written = 0;
+
+    file = fopen(path, "wb");
+    if (file == NULL) {
+        return -1;
+    }
+
+    while (written < size) {
+        size_t chunk = size - written;
+        size_t index = 0;
+        if (chunk > sizeof(buffer)) {
+            chunk = sizeof(buffer);
+        }
+
+        // roughly half of every block is text and half is noise
+        while (index < chunk) {
+            if (bench_random_next(random) & 1) {
+                const char* word = g_words[bench_random_next(random) % (sizeof(g_words) / sizeof(g_words[0]))];
+                size_t      length = strlen(word);
+                if (index + length + 1 > chunk) {
+                    length = chunk - index - 1;
+                }
+                memcpy(&buffer[index], word, length);
+                index += length;
+                buffer[index++] = ' ';
+            } else {
+                uint32_t value = bench_random_next(random);
+                for (int i = 0; i < 4 && index < chunk; i++) {
+                    buffer[index++] = (char)(value >> (i * 8));
+                }
+            }
+        }
+
+        if (fwrite(buffer, 1, chunk, file) != chunk) {
+            fclose(file);
+            return -1;
+        }
+        written += chunk;
+    }
+    fclose(file);
+    return 0;
+}
+
+static int __synth_directory(const char* path, int level, struct bench_tree_options* options,
+    struct bench_random* random, struct bench_tree_stats* stats)
+{
+    char name[64];
+    int  status;
+
+    status = platform_mkdir(path);
+    if (status) {
+        VLOG_ERROR("bench", "__synth_directory: failed to create %s\n", path);
+        return -1;
+    }
+    stats->directories++;
+
+    for (int i = 0; i < options->files; i++) {
+        char*  filePath;
+        size_t size = bench_random_range(random, (uint32_t)options->min_size, (uint32_t)options->max_size);
+
+        snprintf(&name[0], sizeof(name), "file-%03d.dat", i);
+        filePath = strpathcombine(path, &name[0]);
+        if (filePath == NULL) {
+            return -1;
+        }
+
+        status = __write_file(filePath, size, random);
+        free(filePath);
+        if (status) {
+            VLOG_ERROR("bench", "__synth_directory: failed to write %s\n", &name[0]);
+            return -1;
+        }
+        stats->files++;
+        stats->bytes += size;
+    }
+
+#if defined(__linux__) || defined(__unix__)
+    if (options->symlinks && options->files > 0) {
+        char* linkPath = strpathcombine(path, "link.dat");
+        if (linkPath == NULL) {
+            return -1;
+        }
+        status = platform_symlink(linkPath, "file-000.dat", 0);
+        free(linkPath);
+        if (status) {
+            VLOG_ERROR("bench", "__synth_directory: failed to create symlink in %s\n", path);
+            return -1;
+        }
+    }
+#endif
+
+    if (level >= options->depth) {
+        return 0;
+    }
+
+    for (int i = 0; i < options->directories; i++) {
+        char* subPath;
+
+        snprintf(&name[0], sizeof(name), "dir-%03d", i);
+        subPath = strpathcombine(path, &name[0]);
+        if (subPath == NULL) {
+            return -1;
+        }
+
+        status = __synth_directory(subPath, level + 1, options, random, stats);
+        free(subPath);
+        if (status) {
+            return status;
+        }
+    }
+    return 0;
+}
+
+int bench_synth_tree(const char* path, struct bench_tree_options* options,
+    unsigned int seed, struct bench_tree_stats* statsOut)
+{
+    struct bench_random     random;
+    struct bench_tree_stats stats = { 0 };
+    int                     status;
+
+    if (path == NULL || options == NULL || options->min_size > options->max_size) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    bench_random_init(&random, seed);
+    status = __synth_directory(path, 0, options, &random, &stats);
+    if (status == 0 && statsOut != NULL) {
+        *statsOut = stats;
+    }
+    return status;
+}
+
+struct __text_buffer {
+    char*  data;
+    size_t length;
+    size_t capacity;
+};
+
+static int __text_append(struct __text_buffer* text, const char* format, ...)
+{
+    va_list args;
+    int     written;
+
+    for (;;) {
+        size_t available = text->capacity - text->length;
+
+        va_start(args, format);
+        written = vsnprintf(text->data + text->length, available, format, args);
+        va_end(args);
+        if (written < 0) {
+            return -1;
+        }
+
+        if ((size_t)written < available) {
+            text->length += written;
+            return 0;
+        }
+
+        char* data = realloc(text->data, text->capacity * 2);
+        if (data == NULL) {
+            return -1;
+        }
+        text->data = data;
+        text->capacity *= 2;
+    }
+}
+
+char* bench_synth_recipe(int parts, int steps, unsigned int seed, size_t* lengthOut)
+{
+    struct bench_random  random;
+    struct __text_buffer text;
+    int                  status = 0;
+
+    text.capacity = 16 * 1024;
+    text.length = 0;
+    text.data = malloc(text.capacity);
+    if (text.data == NULL) {
+        return NULL;
+    }
+
+    bench_random_init(&random, seed);
+
+    status |= __text_append(&text,
+        "name: bench-recipe\n"
+        "author: chef-bench\n"
+        "email: bench@chef.local\n"
+        "version: 1.0.0\n"
+        "license: MIT\n"
+        "\n"
+        "platforms:\n"
+        "  - name: linux\n"
+        "    base: ubuntu:24\n"
+        "    architectures: [amd64, arm64]\n"
+        "\n"
+        "environment:\n"
+        "  build:\n"
+        "    confinement: true\n"
+        "\n"
+        "recipes:\n"
+    );
+
+    for (int i = 0; i < parts && status == 0; i++) {
+        status |= __text_append(&text,
+            "  - name: part-%d\n"
+            "    source:\n"
+            "      type: path\n"
+            "      path: src/part-%d\n"
+            "    steps:\n",
+            i, i
+        );
+        for (int j = 0; j < steps; j++) {
+            int arguments = (int)bench_random_range(&random, 1, 6);
+
+            status |= __text_append(&text,
+                "    - name: step-%d\n"
+                "      type: %s\n"
+                "      system: %s\n",
+                j, j == 0 ? "generate" : "build", j == 0 ? "cmake" : "make"
+            );
+            if (j > 0) {
+                status |= __text_append(&text, "      depends: [step-%d]\n", j - 1);
+            }
+            status |= __text_append(&text, "      arguments:\n");
+            for (int k = 0; k < arguments; k++) {
+                status |= __text_append(&text, "        - -D%s_%u=%s\n",
+                    g_words[bench_random_next(&random) % (sizeof(g_words) / sizeof(g_words[0]))],
+                    bench_random_next(&random) % 1000,
+                    g_words[bench_random_next(&random) % (sizeof(g_words) / sizeof(g_words[0]))]
+                );
+            }
+        }
+    }
+
+    status |= __text_append(&text,
+        "\n"
+        "packs:\n"
+        "- name: bench-pack\n"
+        "  type: application\n"
+        "  summary: Synthetic benchmark pack\n"
+        "  description: |\n"
+        "    Generated by chef-bench\n"
+        "  commands:\n"
+        "  - name: bench\n"
+        "    path: /usr/bin/bench\n"
+        "    type: executable\n"
+    );
+
+    if (status) {
+        free(text.data);
+        return NULL;
+    }
+
+    if (lengthOut != NULL) {
+        *lengthOut = text.length;
+    }
+    return text.data;
+}
@@ -37,6 +37,10 @@ static void __print_help(void)
     printf("      The publisher that the package should be published under, defaults only if there is one publisher\n");
     printf("  -c, --channel\n");
     printf("      The channel that should be published to, default is devel\n");
+    printf("  --part-size\n");
+    printf("      The size of each upload part (e.g. 8M) for a resumable upload in parts, default is 0 which uploads in a single request\n");
+    printf("  -j, --connections\n");
+    printf("      The number of parts to upload concurrently, default is 4\n");
     printf("  -h, --help\n");
     printf("      Print this help message\n");
 }
@@ -100,11 +104,13 @@ static int __ensure_publisher_valid(char** publisherNameOut)
 
 int publish_main(int argc, char** argv)
 {
-    struct chef_publish_params params    = { 0 };
-    struct chef_package*       package   = NULL;
-    struct chef_version*       version   = NULL;
-    char*                      packPath  = NULL;
-    char*                      publisher = NULL;
+    struct chef_publish_params params      = { 0 };
+    struct chef_package*       package     = NULL;
+    struct chef_version*       version     = NULL;
+    char*                      packPath    = NULL;
+    char*                      publisher   = NULL;
+    uint64_t                   partSize    = 0;
+    uint64_t                   connections = 4;
     int                        status;
 
     // set default channel
@@ -119,6 +125,10 @@ int publish_main(int argc, char** argv)
                 continue;
             } else if (!__parse_string_switch(argv, argc, &i, "-p", 2, "--publisher", 11, NULL, &publisher)) {
                 continue;
+            } else if (!__parse_quantity_switch(argv, argc, &i, "--part-size", 11, "--part-size", 11, partSize, &partSize)) {
+                continue;
+            } else if (!__parse_quantity_switch(argv, argc, &i, "-j", 2, "--connections", 13, connections, &connections)) {
+                continue;
             } else {
                 if (packPath != NULL) {
                     printf("only one pack path can be specified\n");
@@ -150,8 +160,10 @@ int publish_main(int argc, char** argv)
     printf("version:            %d.%d.%d\n", version->major, version->minor, version->patch);
 
     // set the parameter values
-    params.package = package->package;
-    params.version = version;
+    params.package     = package->package;
+    params.version     = version;
+    params.part_size   = (size_t)partSize;
+    params.connections = (int)connections;
 
     // initialize chefclient
     status = chefclient_initialize();
@@ -23,6 +23,8 @@
 #include <string.h>
 #include <stdlib.h>
 
+#include "served.h"
+
 static char** __rebuild_args(int argc, char** argv, const char* arg0, int argIndex)
 {
     char** result;
@@ -72,6 +74,19 @@ static int __spawn_command(int argc, char** argv, char** envp, const char* conta
             .envp = (const char* const*)envp
         }
     );
+    if (status && (errno == ENOENT || errno == ECONNREFUSED)) {
+        // The container is not running, served may have deferred loading it
+        // until the application was used
+        if (served_load_container(containerName) == 0) {
+            status = containerv_join(containerName, commandPath, 
+                &(struct containerv_join_options){
+                    .cwd  = workingDirectory,
+                    .argv = (const char* const*)rebuildArgv,
+                    .envp = (const char* const*)envp
+                }
+            );
+        }
+    }
     if (status) {
         fprintf(stderr, "serve-exec: %s: failed with exit-code %i\n", commandPath, status);
     }
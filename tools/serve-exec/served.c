@@ -0,0 +1,177 @@
+/**
+ * Copyright, Philip Meulengracht
+ *
+ * This program is free software : you can redistribute it and / or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation ? , either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ * 
+ */
+
+#include <errno.h>
+#include <gracht/link/socket.h>
+#include <gracht/client.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// client protocol
+#include "chef_served_service_client.h"
+
+#include "served.h"
+
+#if defined(__linux__)
+#include <sys/un.h>
+
+static const char* g_servedPath = "/tmp/served";
+
+static void __init_socket_config(struct gracht_link_socket* link)
+{
+    struct sockaddr_un addr = { 0 };
+    
+    addr.sun_family = AF_LOCAL;
+    strncpy(addr.sun_path, g_servedPath, sizeof(addr.sun_path));
+    addr.sun_path[sizeof(addr.sun_path) - 1] = '\0';
+
+    gracht_link_socket_set_type(link, gracht_link_stream_based);
+    gracht_link_socket_set_connect_address(link, (const struct sockaddr_storage*)&addr, sizeof(struct sockaddr_un));
+    gracht_link_socket_set_domain(link, AF_LOCAL);
+}
+
+#elif defined(_WIN32)
+#include <windows.h>
+
+static void __init_socket_config(struct gracht_link_socket* link)
+{
+    struct sockaddr_in addr = { 0 };
+    
+    // initialize the WSA library
+    gracht_link_socket_setup();
+
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+    addr.sin_port = htons(4335);
+
+    gracht_link_socket_set_type(link, gracht_link_stream_based);
+    gracht_link_socket_set_connect_address(link, (const struct sockaddr_storage*)&addr, sizeof(struct sockaddr_in));
+}
+#endif
+
+static int __served_connect(gracht_client_t** clientOut)
+{
+    struct gracht_link_socket*         link;
+    struct gracht_client_configuration clientConfiguration;
+    gracht_client_t*                   client = NULL;
+    int                                status;
+
+    gracht_client_configuration_init(&clientConfiguration);
+    
+    gracht_link_socket_create(&link);
+    __init_socket_config(link);
+
+    gracht_client_configuration_set_link(&clientConfiguration, (struct gracht_link*)link);
+
+    status = gracht_client_create(&clientConfiguration, &client);
+    if (status) {
+        return status;
+    }
+
+    status = gracht_client_register_protocol(client, &chef_served_client_protocol);
+    if (status) {
+        gracht_client_shutdown(client);
+        return status;
+    }
+
+    status = gracht_client_connect(client);
+    if (status) {
+        gracht_client_shutdown(client);
+        return status;
+    }
+
+    *clientOut = client;
+    return 0;
+}
+
+int served_load_container(const char* containerName)
+{
+    gracht_client_t*              client;
+    struct gracht_message_context context;
+    char                          packageName[256];
+    char*                         separator;
+    int                           result = 0;
+    int                           status;
+
+    // containers are named publisher.package, while packages are named
+    // publisher/package
+    if (strlen(containerName) >= sizeof(packageName)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    strcpy(&packageName[0], containerName);
+    separator = strchr(&packageName[0], '.');
+    if (separator == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+    *separator = '/';
+
+    status = __served_connect(&client);
+    if (status) {
+        return -1;
+    }
+
+    status = chef_served_load(client, &context, &packageName[0]);
+    if (status == 0) {
+        gracht_client_wait_message(client, &context, GRACHT_MESSAGE_BLOCK);
+        chef_served_load_result(client, &context, &result);
+    }
+    gracht_client_shutdown(client);
+
+    if (status) {
+        return -1;
+    }
+    if (result) {
+        errno = result;
+        return -1;
+    }
+    return 0;
+}
+
+// serve-exec only issues requests, events from served are ignored
+void chef_served_event_transaction_started_invocation(gracht_client_t* client, const struct chef_transaction_started* info)
+{
+    (void)client;
+    (void)info;
+}
+
+void chef_served_event_transaction_state_changed_invocation(gracht_client_t* client, const struct chef_transaction_state_changed* info)
+{
+    (void)client;
+    (void)info;
+}
+
+void chef_served_event_transaction_completed_invocation(gracht_client_t* client, const struct chef_transaction_completed* info)
+{
+    (void)client;
+    (void)info;
+}
+
+void chef_served_event_transaction_io_progress_invocation(gracht_client_t* client, const struct chef_transaction_io_progress* info)
+{
+    (void)client;
+    (void)info;
+}
+
+void chef_served_event_transaction_log_invocation(gracht_client_t* client, const struct chef_transaction_log* info)
+{
+    (void)client;
+    (void)info;
+}
@@ -0,0 +1,31 @@
+/**
+ * Copyright, Philip Meulengracht
+ *
+ * This program is free software : you can redistribute it and / or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation ? , either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ * 
+ */
+
+#ifndef __SERVE_EXEC_SERVED_H__
+#define __SERVE_EXEC_SERVED_H__
+
+/**
+ * @brief Asks served to load the container of an application that was not
+ * loaded during startup.
+ *
+ * @param containerName The name of the container in the form publisher.package
+ * @return int 0 when the container is available, -1 with errno set on failure
+ */
+extern int served_load_container(const char* containerName);
+
+#endif //!__SERVE_EXEC_SERVED_H__
@@ -39,7 +39,9 @@ static const char* g_installMsgs[] = {
 
 static void __print_help(void)
 {
-    printf("Usage: serve install <pack> [options]\n");
+    printf("Usage: serve install <pack> [<pack> ...] [options]\n");
+    printf("  Several packs from the store can be installed at once, they are\n");
+    printf("  downloaded concurrently and installed together\n");
     printf("Options:\n");
     printf("  -C, --channel\n");
     printf("      Install from a specific channel, default: stable\n");
@@ -149,6 +151,54 @@ static int __verify_package(const char* path, const char* proof)
     return 0;
 }
 
+static int __install_batch(const char** packages, int count, const char* channel)
+{
+    struct chef_served_install_options* options;
+    gracht_client_t*                    client;
+    int                                 status;
+
+    options = calloc(count, sizeof(struct chef_served_install_options));
+    if (options == NULL) {
+        return -1;
+    }
+
+    for (int i = 0; i < count; i++) {
+        struct platform_stat stats;
+
+        // local packages need to be verified one by one
+        if (platform_stat(packages[i], &stats) == 0) {
+            fprintf(stderr, "local packages cannot be installed together with others: %s\n", packages[i]);
+            free(options);
+            return -1;
+        }
+        options[i].package = (char*)packages[i];
+        options[i].channel = (char*)channel;
+    }
+
+    status = __chef_client_initialize(&client);
+    if (status != 0) {
+        printf("failed to initialize client: %s\n", strerror(status));
+        free(options);
+        return status;
+    }
+
+    status = chef_served_install_batch(client, NULL, &(struct chef_served_install_batch_options) {
+        .packages = options,
+        .packages_count = (uint32_t)count
+    });
+    if (status != 0) {
+        printf("communication error: %i\n", status);
+        goto cleanup;
+    }
+
+    gracht_client_wait_message(client, NULL, GRACHT_MESSAGE_BLOCK);
+
+cleanup:
+    gracht_client_shutdown(client);
+    free(options);
+    return status;
+}
+
 int install_main(int argc, char** argv)
 {
     struct chef_served_install_options installOptions = { 0 };
@@ -158,14 +208,22 @@ int install_main(int argc, char** argv)
     uint64_t                           revision;
     const char*                        package   = NULL;
     char*                              fullpath  = NULL;
+    const char**                       packages;
+    int                                packagesCount = 0;
 
     // set default channel
     installOptions.channel = "stable";
 
+    packages = calloc(argc, sizeof(const char*));
+    if (packages == NULL) {
+        return -1;
+    }
+
     if (argc > 2) {
         for (int i = 2; i < argc; i++) {
             if (!strcmp(argv[i], "-h") || !strcmp(argv[i], "--help")) {
                 __print_help();
+                free(packages);
                 return 0;
             } else if (!__parse_string_switch(argv, argc, &i, "-C", 2, "--channel", 9, NULL, (char**)&installOptions.channel)) {
                 continue;
@@ -175,23 +233,31 @@ int install_main(int argc, char** argv)
                 installOptions.revision = (int)revision;
                 continue;
             } else if (argv[i][0] != '-') {
-                if (package == NULL) {
-                    package = argv[i];
-                } else {
-                    printf("unknown option: %s\n", argv[i]);
-                    __print_help();
-                    return -1;
-                }
+                packages[packagesCount++] = argv[i];
             }
         }
     }
 
-    if (package == NULL) {
+    if (packagesCount == 0) {
         printf("no package specified\n");
         __print_help();
+        free(packages);
         return -1;
     }
 
+    if (packagesCount > 1) {
+        if (installOptions.revision != 0 || installOptions.proof != NULL) {
+            printf("revision and proof can only be specified when installing a single package\n");
+            free(packages);
+            return -1;
+        }
+        status = __install_batch(packages, packagesCount, installOptions.channel);
+        free(packages);
+        return status;
+    }
+    package = packages[0];
+    free(packages);
+
     // is the package a path? otherwise try to download from
     // official repo
     if (platform_stat(package, &stats) == 0) {